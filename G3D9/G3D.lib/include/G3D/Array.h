@@ -5,7 +5,7 @@
   \cite Portions written by Aaron Orenstein, a@orenstein.name
  
   \created 2001-03-11
-  \edited  2012-03-21
+  \edited  2026-10-17
 
   Copyright 2000-2012, Morgan McGuire, http://graphics.cs.williams.edu
   All rights reserved.
@@ -1409,9 +1409,11 @@ return( lhs < rhs? true : false );
     /** Ensures that future append() calls can grow up to size \a n without allocating memory.*/
     void reserve(int n) {
         debugAssert(n >= size());
-        const int oldSize = size();
-        resize(n);
-        resize(oldSize, false);
+        if (size_t(n) > numAllocated) {
+            // Allocate without constructing the new elements
+            numAllocated = n;
+            realloc(num);
+        }
     }
 
 };
@@ -4,7 +4,7 @@
  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
  
  \created 2001-08-09
- \edited  2011-08-19
+ \edited  2026-10-17
 
  Copyright 2000-2012, Morgan McGuire.
  All rights reserved.
@@ -36,6 +36,7 @@
 #include "G3D/g3dmath.h"
 #include "G3D/debug.h"
 #include "G3D/System.h"
+#include "G3D/MemoryMappedFile.h"
 
 
 namespace G3D {
@@ -58,6 +59,13 @@ namespace G3D {
  before reading.  For a C-array, they require the pointer to reference
  a memory block at least large enough to hold <I>n</I> elements.
 
+ Large files on disk are memory-mapped rather than copied into a heap
+ buffer, so opening a multi-gigabyte file costs neither the memory nor
+ the time to read it up front; pages are brought in by the operating
+ system as they are touched.  When the file's endian-ness matches the
+ machine's, the viewX methods (e.g., viewFloat32) return pointers
+ directly into the file instead of copying.
+
  Most classes define serialize/deserialize methods that use BinaryInput,
  BinaryOutput, TextInput, and TextOutput.  There are text serializer 
  functions for primitive types (e.g. int, std::string, float, double) but not 
@@ -126,6 +134,10 @@ private:
      */
     bool            m_freeBuffer;
 
+    /** Keeps the file or zipfile mapped while m_buffer points into it
+        (for large files on disk and uncompressed files inside zipfiles). */
+    MemoryMappedFile::Ref m_mappedFile;
+
     /** Ensures that we are able to read at least minLength from startPosition (relative
         to start of file). */
     void loadIntoMemory(int64 startPosition, int64 minLength = 0);
@@ -146,6 +158,11 @@ public:
     /** false, constant to use with the copyMemory option */
     static const bool       NO_COPY;
 
+    /** Files on disk at least this long are memory-mapped instead of
+        read into a heap buffer.  Below this size a single read is cheaper
+        than setting up the mapping and taking the page faults. */
+    static const int64      MIN_MAPPED_LENGTH = 256 * 1024;
+
     /**
        If the file cannot be opened, a zero length buffer is presented.
        Automatically opens files that are inside zipfiles.
@@ -153,11 +170,17 @@ public:
        @param compressed Set to true if and only if the file was
        compressed using BinaryOutput's zlib compression.  This has
        nothing to do with whether the input is in a zipfile.
+
+       @param access Read-ahead hint for files that are memory-mapped
+       (see MIN_MAPPED_LENGTH).  Use RANDOM_ACCESS for files that are
+       navigated with setPosition, such as indexed caches.  The file must
+       not be truncated by another process while it is mapped.
     */
     BinaryInput(
         const std::string&  filename,
         G3DEndian           fileEndian,
-        bool                compressed = false);
+        bool                compressed = false,
+        MemoryMappedFile::AccessHint access = MemoryMappedFile::SEQUENTIAL_ACCESS);
 
     /**
      Creates input stream from an in memory source.
@@ -232,9 +255,15 @@ public:
         return m_pos + m_alreadyRead;
     }
 
+    /** True if the data are read in place from a memory-mapped file
+        rather than from a heap buffer. */
+    bool isMemoryMapped() const {
+        return m_mappedFile.notNull();
+    }
+
     /**
      Returns a pointer to the internal memory buffer.
-     May throw an exception for huge files.
+     May throw an exception for huge files that are not memory-mapped.
      */
     const uint8* getCArray() {
         if (m_alreadyRead > 0 || m_bufferLength < m_length) {
@@ -440,6 +469,33 @@ public:
     DECLARE_READER(Float32, float32)
     DECLARE_READER(Float64, float64)    
 #   undef DECLARE_READER
+
+    /**
+     Reads n elements and returns a pointer to them.  When no byte
+     swapping is needed the pointer refers directly to the file's data
+     and nothing is copied; otherwise the elements are read into \a
+     scratch and its storage is returned.
+
+     The pointer remains valid until the BinaryInput is destroyed or
+     \a scratch is modified, except for huge files that were not
+     memory-mapped, for which a later read may replace the buffer.
+     The returned pointer is not necessarily aligned to the element size
+     on platforms that permit unaligned access.
+     */
+#   define DECLARE_VIEW(ucase, lcase)\
+    const lcase* view##ucase(int64 n, Array<lcase>& scratch);
+
+    DECLARE_VIEW(UInt8,   uint8)
+    DECLARE_VIEW(Int8,    int8)
+    DECLARE_VIEW(UInt16,  uint16)
+    DECLARE_VIEW(Int16,   int16)
+    DECLARE_VIEW(UInt32,  uint32)
+    DECLARE_VIEW(Int32,   int32)
+    DECLARE_VIEW(UInt64,  uint64)
+    DECLARE_VIEW(Int64,   int64)
+    DECLARE_VIEW(Float32, float32)
+    DECLARE_VIEW(Float64, float64)
+#   undef DECLARE_VIEW
 };
 
 
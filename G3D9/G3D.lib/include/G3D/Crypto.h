@@ -5,7 +5,7 @@
  
 
   \created 2006-03-29
-  \edited  2011-06-21
+  \edited  2026-10-17
  */
 
 #ifndef G3D_Crypto_h
@@ -90,6 +90,46 @@ public:
 };
 
 
+/** See G3D::Crypto::hash128 */
+class Hash128 {
+public:
+
+    uint64  value[2];
+
+    Hash128() {
+        value[0] = 0;
+        value[1] = 0;
+    }
+
+    Hash128(uint64 v0, uint64 v1) {
+        value[0] = v0;
+        value[1] = v1;
+    }
+
+    explicit Hash128(class BinaryInput& b);
+
+    bool operator==(const Hash128& other) const {
+        return (value[0] == other.value[0]) && (value[1] == other.value[1]);
+    }
+
+    inline bool operator!=(const Hash128& other) const {
+        return !(*this == other);
+    }
+
+    /** 32 hexadecimal digits, e.g., for use in a cache filename */
+    std::string toString() const;
+
+    void deserialize(class BinaryInput& b);
+
+    void serialize(class BinaryOutput& b) const;
+
+    static size_t hashCode(const Hash128& key) {
+        // The bits are already well mixed
+        return size_t(key.value[0]);
+    }
+};
+
+
 /** Cryptography and hashing helper functions */
 class Crypto {
 public:
@@ -98,11 +138,87 @@ public:
      Computes the CRC32 value of a byte array.  CRC32 is designed to be a hash
      function that produces different values for similar strings.
 
-     This implementation is compatible with PKZIP and GZIP.
+     This implementation is compatible with PKZIP and GZIP.  On
+     processors with PCLMULQDQ it folds 64 bytes per iteration with
+     carry-less multiplication.
+
+     \param crc The result of a previous call, to continue computing the
+     CRC of a longer stream.  The CRC of a whole array is the same as
+     that of any sequence of calls over its consecutive pieces.
 
-     Based on http://www.gamedev.net/reference/programming/features/crc32/
+     \sa crc32c, parallelCRC32
     */
-    static uint32 crc32(const void* bytes, size_t numBytes);
+    static uint32 crc32(const void* bytes, size_t numBytes, uint32 crc = 0);
+
+    /**
+     Computes the CRC-32C (Castagnoli) value of a byte array, as used by
+     iSCSI, ext4, and SSE4.2.  This is faster than crc32 on processors
+     with SSE4.2 and has slightly better error detection, but is not
+     compatible with PKZIP.
+
+     \param crc The result of a previous call, as for crc32.
+     */
+    static uint32 crc32c(const void* bytes, size_t numBytes, uint32 crc = 0);
+
+    /** Given <code>crcA = crc32(A, lengthA)</code> and <code>crcB = crc32(B, lengthB)</code>,
+        returns the crc32 of the concatenation of A and B in O(log lengthB) time. */
+    static uint32 crc32Combine(uint32 crcA, uint32 crcB, uint64 lengthB);
+
+    /** The crc32c version of crc32Combine */
+    static uint32 crc32cCombine(uint32 crcA, uint32 crcB, uint64 lengthB);
+
+    /**
+     A fast, non-cryptographic 128-bit hash (MurmurHash3 x64_128), for
+     detecting changes in data such as cache keys.  Unlike crc32 and md5
+     this is not a standard checksum; do not use it where an adversary
+     can choose the input.  Multi-byte words are read in little-endian
+     order, so the values differ on big-endian machines.
+
+     \sa parallelHash128
+     */
+    static Hash128 hash128(const void* bytes, size_t numBytes, uint64 seed = 0);
+
+    /** The first 64 bits of hash128 */
+    static uint64 hash64(const void* bytes, size_t numBytes, uint64 seed = 0) {
+        return hash128(bytes, numBytes, seed).value[0];
+    }
+
+    /**
+     Computes the crc32 of a large array using several threads from
+     ThreadPool.  The result is identical to crc32(bytes, numBytes).
+
+     \param maxThreads Maximum number of threads, including the calling
+     one.  Defaults to ThreadPool::NUM_CORES, which uses every core.
+     */
+    static uint32 parallelCRC32(const void* bytes, size_t numBytes, int maxThreads = -100);
+
+    /** Computes the crc32 of the remainder of \a b, leaving it at the end of the
+        input.  Huge files are processed in blocks so that they need not fit in memory. */
+    static uint32 parallelCRC32(class BinaryInput& b, int maxThreads = -100);
+
+    /** The crc32c version of parallelCRC32 */
+    static uint32 parallelCRC32C(const void* bytes, size_t numBytes, int maxThreads = -100);
+
+    static uint32 parallelCRC32C(class BinaryInput& b, int maxThreads = -100);
+
+    /**
+     A tree hash built from hash128: the input is divided into
+     HASH_CHUNK_SIZE chunks that are hashed concurrently, and the chunk
+     hashes are then hashed together.  The result depends only on the
+     data, not on the number of threads, and equals hash128(bytes,
+     numBytes) for inputs no larger than one chunk.  This is a
+     different function than hash128 for larger inputs.
+     */
+    static Hash128 parallelHash128(const void* bytes, size_t numBytes, int maxThreads = -100);
+
+    /** Hashes the remainder of \a b, leaving it at the end of the input.
+        Equal to parallelHash128 of the same bytes in memory. */
+    static Hash128 parallelHash128(class BinaryInput& b, int maxThreads = -100);
+
+    /** Size of the chunks processed in parallel by parallelCRC32,
+        parallelCRC32C, and parallelHash128.  Part of the definition of
+        parallelHash128, so never change it. */
+    enum {HASH_CHUNK_SIZE = 1024 * 1024};
 
     /**
      Computes the MD5 hash (message digest) of a byte stream, as defined by
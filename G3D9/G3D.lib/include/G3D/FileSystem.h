@@ -4,7 +4,7 @@
  \author Morgan McGuire, http://graphics.cs.williams.edu
  
  \author  2002-06-06
- \edited  2012-03-26
+ \edited  2026-10-17
  */
 #ifndef G3D_FileSystem_h
 #define G3D_FileSystem_h
@@ -14,6 +14,10 @@
 #include "G3D/Table.h"
 #include "G3D/Set.h"
 #include "G3D/GMutex.h"
+#include "G3D/MemoryMappedFile.h"
+
+// Forward declaration of the libzip archive handle
+struct zip;
 
 namespace G3D {
 
@@ -41,6 +45,10 @@ namespace G3D {
  The extension requirement allows G3D to quickly identify whether a path could enter a
  zipfile without forcing it to open all parent directories for reading.
 
+ Zipfiles are kept open and memory mapped after their first use, with an index of
+ their contents, so that loading many small files from one archive does not reparse
+ the archive each time.  See readFromZipfile().
+
  \sa FilePath
 */
 class FileSystem {
@@ -99,6 +107,71 @@ private:
         Entry(const char* n) : name(n), type(UNKNOWN) {}
     };
 
+    /** A file inside a zipfile, as recorded in the zipfile's central directory */
+    class ZipfileEntry {
+    public:
+        /** Name inside the zipfile, with forward slashes */
+        std::string             name;
+
+        /** Uncompressed length in bytes */
+        int64                   size;
+
+        int64                   compressedSize;
+
+        /** ZIP_CM_STORE or ZIP_CM_DEFLATE, unless headerOffset is -1 */
+        int                     method;
+
+        /** Offset of the entry's local header within the zipfile, or -1 if the
+            entry cannot be read directly from the mapping (e.g., it is encrypted)
+            and must be read through libzip. */
+        int64                   headerOffset;
+
+        ZipfileEntry() : size(0), compressedSize(0), method(0), headerOffset(-1) {}
+    };
+
+    /** A zipfile that has been opened and indexed. */
+    class Zipfile {
+    public:
+        /** NULL if the zipfile could not be mapped or its directory could not be parsed,
+            in which case all entries are read through libzip. */
+        MemoryMappedFile::Ref   mapping;
+
+        /** libzip handle, opened on demand.  The index of an entry in the entry
+            array is its libzip index. */
+        struct zip*             z;
+
+        Array<ZipfileEntry>     entry;
+
+        /** Maps lowercase names to indices in entry, since names inside zipfiles 
+            are matched without regard to case */
+        Table<std::string, int> index;
+
+        /** Modification time and length of the zipfile when it was opened, 
+            for detecting changes on disk */
+        int64                   modified;
+        int64                   fileSize;
+
+        /** When the zipfile on disk was last compared against modified and fileSize */
+        double                  lastChecked;
+
+        Zipfile() : z(NULL), modified(0), fileSize(0), lastChecked(0) {}
+        ~Zipfile();
+
+        /** Indexes the zipfile.  Returns false if it could not be opened. */
+        bool open(const std::string& filename);
+
+        /** Returns false if the central directory is in a format that requires libzip (e.g., zip64) */
+        bool parseDirectory();
+
+        /** Returns NULL if there is no entry named \a name */
+        const ZipfileEntry* find(const std::string& name) const;
+
+    private:
+        // Not implemented on purpose, don't use
+        Zipfile(const Zipfile&);
+        Zipfile& operator=(const Zipfile&);
+    };
+
     class Dir {
     public:
         
@@ -123,7 +196,7 @@ private:
 ) const;
 
         /** Compute the contents of nodeArray from this zipfile. */
-        void computeZipListing(const std::string& zipfile, const std::string& pathInsideZipfile);
+        void computeZipListing(const Zipfile* zipfile, const std::string& pathInsideZipfile);
 
         Dir() : exists(false), isZipfile(false), inZipfile(false), lastChecked(0) {}
     };
@@ -132,6 +205,13 @@ private:
         On Windows, all paths are lowercase */
     Table<std::string, Dir>     m_cache;
 
+    /** Open zipfiles, indexed by the same keys as m_cache */
+    Table<std::string, Zipfile*> m_zipfileCache;
+
+    /** Returns the indexed zipfile, opening it if it is not cached or has
+        changed on disk.  Returns NULL if \a path is not a readable zipfile. */
+    Zipfile* getZipfile(const std::string& path);
+
     /** Update the cache entry for path if it is not already present.
      \param forceUpdate If true, always override the current cache value.*/
     Dir& getContents(const std::string& path, bool forceUpdate);
@@ -139,6 +219,8 @@ private:
     /** Don't allow public construction. */
     FileSystem();
 
+    ~FileSystem();
+
     static FileSystem& instance();
     static GMutex      mutex;
 
@@ -245,6 +327,11 @@ private:
     /** Returns the length of the file in bytes, or -1 if the file could not be opened. */
     int64 _size(const std::string& path);
 
+    /** Returns the modification time of the file in seconds since
+        1970, or -1 if the file does not exist.  For a file inside a
+        zipfile, this is the modification time of the zipfile. */
+    int64 _lastModified(const std::string& path);
+
     /** Called from list() */
     void listHelper(const std::string& shortSpec, const std::string& parentPath, Array<std::string>& result, const ListSettings& settings);
 
@@ -363,6 +450,23 @@ public:
         return b;
     }
 
+    /** 
+      \brief Reads the file \a path, which is inside \a zipfile.
+
+      Files stored without compression are not copied: \a data points
+      directly into a memory mapping of the zipfile, and \a mapping
+      keeps that mapping alive.  The data is then read-only and may have
+      any alignment.  Compressed files are inflated into a buffer
+      allocated with System::alignedMalloc that the caller must release
+      with System::alignedFree, and \a mapping is set to NULL.
+
+      Throws std::string if the file cannot be read.
+
+      \param zipfile The zipfile part of \a path, as returned by inZipfile().
+     */
+    static void readFromZipfile(const std::string& path, const std::string& zipfile, uint8*& data, 
+                                int64& length, MemoryMappedFile::Ref& mapping);
+
     /** \copydoc _setCacheLifetime */
     void setCacheLifetime(float t) {
         mutex.lock();
@@ -454,6 +558,14 @@ public:
         return i;
     }
 
+    /** \copydoc _lastModified */
+    static int64 lastModified(const std::string& path) {
+        mutex.lock();
+        int64 i = instance()._lastModified(path);
+        mutex.unlock();
+        return i;
+    }
+
     /** \copydoc _list */
     static void list(const std::string& spec, Array<std::string>& result,
         const ListSettings& listSettings = ListSettings()) {
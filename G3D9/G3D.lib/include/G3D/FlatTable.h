@@ -0,0 +1,692 @@
+/**
+  \file G3D/FlatTable.h
+
+  Open-addressing hash table with contiguous storage.
+
+  \created 2026-10-17
+  \edited  2026-10-17
+ */
+
+#ifndef G3D_FlatTable_h
+#define G3D_FlatTable_h
+
+#include <cstddef>
+#include <new>
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/debug.h"
+#include "G3D/System.h"
+#include "G3D/g3dmath.h"
+#include "G3D/EqualsTrait.h"
+#include "G3D/HashTrait.h"
+#include "G3D/MemoryManager.h"
+
+#ifdef _MSC_VER
+#   pragma warning (push)
+    // Debug name too long warning
+#   pragma warning (disable : 4786)
+#endif
+
+namespace G3D {
+
+/**
+ \brief An unordered data structure mapping keys to values that stores all
+ entries in one contiguous array.
+
+ FlatTable has the same interface and the same HashTrait / EqualsTrait
+ requirements as G3D::Table and can replace it at most call sites.  It uses
+ Robin Hood linear probing: each slot stores the entry together with the
+ hash code of its key and its distance from the key's home slot, so a lookup
+ walks consecutive memory and only calls EqualsFunc when hash codes match.
+ Removal shifts the following entries back instead of leaving tombstones.
+
+ Compared to Table, FlatTable performs no allocation per element and
+ touches far fewer cache lines per lookup.  The tradeoffs are:
+
+ - Inserting or removing any key may move other entries, so pointers and
+   references returned by getPointer(), getCreate(), and iterators are
+   only valid until the next set(), getCreate(), or remove().
+ - Key and Value must be copyable and assignable.
+ - Iteration visits every slot, so it costs O(capacity) rather than O(size).
+
+ \sa G3D::Table
+ */
+template<class Key, class Value, class HashFunc = HashTrait<Key>, class EqualsFunc = EqualsTrait<Key> >
+class FlatTable {
+public:
+
+    /**
+     The pairs returned by iterator.
+     */
+    class Entry {
+    public:
+        Key    key;
+        Value  value;
+        Entry() {}
+        Entry(const Key& k) : key(k) {}
+        Entry(const Key& k, const Value& v) : key(k), value(v) {}
+        bool operator==(const Entry &peer) const { return (key == peer.key && value == peer.value); }
+        bool operator!=(const Entry &peer) const { return !operator==(peer); }
+    };
+
+private:
+
+    typedef FlatTable<Key, Value, HashFunc, EqualsFunc> ThisType;
+
+    /** One position in the table.  The hash code and probe distance are
+        stored next to the entry so that a lookup usually touches a single
+        cache line. */
+    class Slot {
+    public:
+        /** Mixed hash code of the key */
+        uint32      hashCode;
+
+        /** Distance from the home slot for hashCode, or EMPTY */
+        int32       distance;
+
+        /** Raw storage for an Entry, which is only constructed when
+            distance != EMPTY */
+        union {
+            char    bytes[sizeof(Entry)];
+            double  alignDouble;
+            void*   alignPointer;
+        } storage;
+
+        Entry& entry() {
+            return *reinterpret_cast<Entry*>(storage.bytes);
+        }
+
+        const Entry& entry() const {
+            return *reinterpret_cast<const Entry*>(storage.bytes);
+        }
+    };
+
+    enum {EMPTY = -1, MIN_CAPACITY = 16};
+
+    /** Number of elements in the table.*/
+    size_t              m_size;
+
+    /** Length of m_slot.  Always zero or a power of two. */
+    size_t              m_capacity;
+
+    Slot*               m_slot;
+
+    MemoryManager::Ref  m_memoryManager;
+
+    void* alloc(size_t s) const {
+        return m_memoryManager->alloc(s);
+    }
+
+    void free(void* p) const {
+        return m_memoryManager->free(p);
+    }
+
+    /** Spreads the entropy of user hash codes, which often have
+        poor low-order bits (e.g., pointers and small ints), across
+        all 32 bits. */
+    static uint32 mixHash(size_t h) {
+        uint32 x = (uint32)h;
+#       ifdef G3D_64BIT
+            x ^= (uint32)((uint64)h >> 32);
+#       endif
+        // Fibonacci hashing moves entropy to the high bits, and the
+        // shift folds them back into the low bits used for indexing
+        x *= 0x9E3779B1;
+        return x ^ (x >> 16);
+    }
+
+    size_t mask() const {
+        return m_capacity - 1;
+    }
+
+    /** Allocates empty storage for \a capacity slots. */
+    void allocate(size_t capacity) {
+        debugAssert(isPow2((int)capacity));
+        m_capacity = capacity;
+        m_slot = (Slot*)alloc(sizeof(Slot) * capacity);
+        alwaysAssertM(m_slot != NULL, "MemoryManager::alloc returned NULL. Out of memory.");
+        for (size_t i = 0; i < capacity; ++i) {
+            m_slot[i].distance = EMPTY;
+        }
+    }
+
+    /** Destroys all entries and frees the arrays. */
+    void freeMemory() {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (m_slot[i].distance != EMPTY) {
+                m_slot[i].entry().~Entry();
+            }
+        }
+        if (m_capacity > 0) {
+            free(m_slot);
+        }
+        m_slot     = NULL;
+        m_capacity = 0;
+        m_size     = 0;
+    }
+
+    /** Returns the index of key, or m_capacity if not present. */
+    size_t find(const Key& key) const {
+        if (m_size == 0) {
+            return m_capacity;
+        }
+
+        const uint32 code = mixHash(HashFunc::hashCode(key));
+        size_t i = code & mask();
+
+        // Robin Hood invariant: once we reach a slot closer to its home
+        // than we are to ours, the key cannot appear later.
+        for (int32 d = 0; m_slot[i].distance >= d; ++d) {
+            if ((m_slot[i].hashCode == code) && EqualsFunc::equals(m_slot[i].entry().key, key)) {
+                return i;
+            }
+            i = (i + 1) & mask();
+        }
+
+        return m_capacity;
+    }
+
+    /** Inserts a copy of \a e, which must not already be present, and returns
+        its index.  Does not grow the table. */
+    size_t insertNew(uint32 code, const Entry& e) {
+        debugAssert(m_size < m_capacity);
+
+        // Find the first slot that is empty or whose occupant is
+        // closer to its home than we are to ours
+        size_t i = code & mask();
+        int32  d = 0;
+        while (m_slot[i].distance >= d) {
+            i = (i + 1) & mask();
+            ++d;
+        }
+
+        // Find the end of the cluster
+        size_t last = i;
+        while (m_slot[last].distance != EMPTY) {
+            last = (last + 1) & mask();
+        }
+
+        if (last != i) {
+            // Entries within a cluster are sorted by home slot, so
+            // displacing "richer" entries is the same as shifting the rest
+            // of the cluster forward by one.
+            size_t prev = (last - 1) & mask();
+            new (&m_slot[last].entry()) Entry(m_slot[prev].entry());
+            m_slot[last].hashCode = m_slot[prev].hashCode;
+            m_slot[last].distance = m_slot[prev].distance + 1;
+
+            for (size_t j = prev; j != i; j = prev) {
+                prev = (j - 1) & mask();
+                m_slot[j].entry() = m_slot[prev].entry();
+                m_slot[j].hashCode = m_slot[prev].hashCode;
+                m_slot[j].distance = m_slot[prev].distance + 1;
+            }
+            // Construct rather than assign so that the new entry does not
+            // inherit state, such as allocated storage, from the old one
+            m_slot[i].entry().~Entry();
+            new (&m_slot[i].entry()) Entry(e);
+        } else {
+            new (&m_slot[i].entry()) Entry(e);
+        }
+
+        m_slot[i].hashCode = code;
+        m_slot[i].distance = d;
+        ++m_size;
+
+        return i;
+    }
+
+    /** Removes the entry at index \a i by shifting the rest of its cluster back. */
+    void removeAt(size_t i) {
+        size_t next = (i + 1) & mask();
+        while (m_slot[next].distance > 0) {
+            m_slot[i].entry() = m_slot[next].entry();
+            m_slot[i].hashCode = m_slot[next].hashCode;
+            m_slot[i].distance = m_slot[next].distance - 1;
+            i = next;
+            next = (i + 1) & mask();
+        }
+
+        m_slot[i].entry().~Entry();
+        m_slot[i].distance = EMPTY;
+        --m_size;
+    }
+
+    /** Rehashes all entries into \a newCapacity slots. */
+    void resize(size_t newCapacity) {
+        Slot*  oldSlot     = m_slot;
+        size_t oldCapacity = m_capacity;
+
+        allocate(newCapacity);
+        m_size = 0;
+
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldSlot[i].distance != EMPTY) {
+                insertNew(oldSlot[i].hashCode, oldSlot[i].entry());
+                oldSlot[i].entry().~Entry();
+            }
+        }
+
+        if (oldCapacity > 0) {
+            free(oldSlot);
+        }
+    }
+
+    /** Grows if inserting one more element would exceed a load factor of 7/8. */
+    void reserveOneMore() {
+        if ((m_size + 1) * 8 > m_capacity * 7) {
+            resize(iMax(MIN_CAPACITY, (int)m_capacity * 2));
+        }
+    }
+
+    void copyFrom(const ThisType& h) {
+        if (&h == this) {
+            return;
+        }
+
+        debugAssert(m_slot == NULL);
+        if (h.m_capacity == 0) {
+            return;
+        }
+
+        allocate(h.m_capacity);
+        for (size_t i = 0; i < m_capacity; ++i) {
+            m_slot[i].hashCode = h.m_slot[i].hashCode;
+            m_slot[i].distance = h.m_slot[i].distance;
+            if (m_slot[i].distance != EMPTY) {
+                new (&m_slot[i].entry()) Entry(h.m_slot[i].entry());
+            }
+        }
+        m_size = h.m_size;
+    }
+
+public:
+
+    /**
+     Creates an empty hash table using the default MemoryManager.
+     */
+    FlatTable() : m_size(0), m_capacity(0), m_slot(NULL) {
+        m_memoryManager = MemoryManager::create();
+    }
+
+    /** Changes the internal memory manager to m */
+    void clearAndSetMemoryManager(const MemoryManager::Ref& m) {
+        clear();
+        debugAssert(m_slot == NULL);
+        m_memoryManager = m;
+    }
+
+    /**
+        Recommends that the table resize to anticipate at least this number of elements.
+     */
+    void setSizeHint(size_t n) {
+        size_t s = MIN_CAPACITY;
+        while (s * 7 < n * 8) {
+            s *= 2;
+        }
+        if (s > m_capacity) {
+            resize(s);
+        }
+    }
+
+    /**
+       Destroys all of the memory allocated by the table, but does <B>not</B>
+       call delete on keys or values if they are pointers.
+    */
+    virtual ~FlatTable() {
+        freeMemory();
+    }
+
+    /** Uses the default memory manager */
+    FlatTable(const ThisType& h) : m_size(0), m_capacity(0), m_slot(NULL) {
+        m_memoryManager = MemoryManager::create();
+        copyFrom(h);
+    }
+
+    FlatTable& operator=(const ThisType& h) {
+        // No need to copy if the argument is this
+        if (this != &h) {
+            freeMemory();
+            copyFrom(h);
+        }
+        return *this;
+    }
+
+    /**
+     Returns the longest probe sequence, which is the analog of the deepest
+     bucket for G3D::Table.
+     */
+    size_t debugGetDeepestBucketSize() const {
+        size_t deepest = 0;
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (m_slot[i].distance != EMPTY) {
+                deepest = iMax((int)deepest, m_slot[i].distance + 1);
+            }
+        }
+        return deepest;
+    }
+
+    /**
+     Returns the average number of slots examined by a successful lookup.
+     */
+    float debugGetAverageBucketSize() const {
+        if (m_size == 0) {
+            return 0.0f;
+        }
+        uint64 sum = 0;
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (m_slot[i].distance != EMPTY) {
+                sum += m_slot[i].distance + 1;
+            }
+        }
+        return (float)((double)sum / m_size);
+    }
+
+    /** Fraction of slots that are occupied; always at most 7/8. */
+    double debugGetLoad() const {
+        return (m_capacity == 0) ? 0.0 : (double)size() / m_capacity;
+    }
+
+    /**
+     Returns the number of slots.
+     */
+    size_t debugGetNumBuckets() const {
+        return m_capacity;
+    }
+
+    /**
+     C++ STL style iterator variable.  See begin().
+     */
+    class Iterator {
+    private:
+        friend class FlatTable<Key, Value, HashFunc, EqualsFunc>;
+
+        size_t              index;
+        size_t              m_capacity;
+        Slot*               m_slot;
+        bool                isDone;
+
+        /**
+         Creates the end iterator.
+         */
+        Iterator() : index(0), m_capacity(0), m_slot(NULL), isDone(true) {}
+
+        Iterator(size_t capacity, Slot* slot) :
+            index(0), m_capacity(capacity), m_slot(slot), isDone(false) {
+            findNext();
+        }
+
+        /** Advances index to the next occupied slot, starting at index. */
+        void findNext() {
+            while ((index < m_capacity) && (m_slot[index].distance == EMPTY)) {
+                ++index;
+            }
+            if (index >= m_capacity) {
+                index  = 0;
+                isDone = true;
+            }
+        }
+
+    public:
+        inline bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+        bool operator==(const Iterator& other) const {
+            if (other.isDone || isDone) {
+                // Common case; check against isDone.
+                return (isDone == other.isDone);
+            } else {
+                return (m_slot == other.m_slot) && (index == other.index);
+            }
+        }
+
+        /**
+         Pre increment.
+         */
+        Iterator& operator++() {
+            debugAssert(! isDone);
+            ++index;
+            findNext();
+            return *this;
+        }
+
+        /**
+         Post increment (slower than preincrement).
+         */
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++(*this);
+            return old;
+        }
+
+        const Entry& operator*() const {
+            return m_slot[index].entry();
+        }
+
+        Entry* operator->() const {
+            debugAssert(! isDone);
+            return &m_slot[index].entry();
+        }
+
+        operator Entry*() const {
+            debugAssert(! isDone);
+            return &m_slot[index].entry();
+        }
+
+        bool isValid() const {
+            return ! isDone;
+        }
+
+        /** @deprecated  Use isValid */
+        bool hasMore() const {
+            return ! isDone;
+        }
+    };
+
+
+    /**
+     C++ STL style iterator method.  Returns the first Entry, which
+     contains a key and value.  Use preincrement (++entry) to get to
+     the next element.  Do not modify the table while iterating.
+     */
+    Iterator begin() const {
+        return Iterator(m_capacity, m_slot);
+    }
+
+    /**
+     C++ STL style iterator method.  Returns one after the last iterator
+     element.
+     */
+    const Iterator end() const {
+        return Iterator();
+    }
+
+    /**
+     Removes all elements and frees the storage.
+     */
+    void clear() {
+        freeMemory();
+    }
+
+    /**
+     Returns the number of keys.
+     */
+    size_t size() const {
+        return m_size;
+    }
+
+    /**
+     If you insert a pointer into the key or value of a table, you are
+     responsible for deallocating the object eventually.
+     */
+    void set(const Key& key, const Value& value) {
+        getCreateEntry(key).value = value;
+    }
+
+    /** If @a key is present, sets @a removedKey and @a removedValue to the
+        element being removed and returns true.  Otherwise returns false
+        and does not write to them. */
+    bool getRemove(const Key& key, Key& removedKey, Value& removedValue) {
+        const size_t i = find(key);
+        if (i == m_capacity) {
+            return false;
+        }
+        removedKey   = m_slot[i].entry().key;
+        removedValue = m_slot[i].entry().value;
+        removeAt(i);
+        return true;
+    }
+
+    /**
+    Removes an element from the table if it is present.
+    @return true if the element was found and removed, otherwise  false
+    */
+    bool remove(const Key& key) {
+        const size_t i = find(key);
+        if (i == m_capacity) {
+            return false;
+        }
+        removeAt(i);
+        return true;
+    }
+
+    /** If a value that is EqualsFunc to @a key is present, returns a pointer to the
+        version stored in the data structure, otherwise returns NULL.
+     */
+    const Key* getKeyPointer(const Key& key) const {
+        const size_t i = find(key);
+        return (i == m_capacity) ? NULL : &(m_slot[i].entry().key);
+    }
+
+    /**
+     Returns the value associated with key.
+     @deprecated Use get(key, val) or getPointer(key)
+     */
+    Value& get(const Key& key) const {
+        const size_t i = find(key);
+        debugAssertM(i != m_capacity, "Key not found");
+        return m_slot[i].entry().value;
+    }
+
+    /** Returns a pointer to the element if it exists, or NULL if it does not.
+        The pointer is invalidated by the next insertion or removal.
+     */
+    Value* getPointer(const Key& key) const {
+        const size_t i = find(key);
+        return (i == m_capacity) ? NULL : &(m_slot[i].entry().value);
+    }
+
+    /**
+     If the key is present in the table, val is set to the associated value and returns true.
+     If the key is not present, returns false.
+     */
+    bool get(const Key& key, Value& val) const {
+        const size_t i = find(key);
+        if (i == m_capacity) {
+            return false;
+        }
+        val = m_slot[i].entry().value;
+        return true;
+    }
+
+    /** Called by getCreate() and set()
+
+        \param created Set to true if the entry was created by this method.
+    */
+    Entry& getCreateEntry(const Key& key, bool& created) {
+        size_t i = find(key);
+        if (i != m_capacity) {
+            created = false;
+            return m_slot[i].entry();
+        }
+
+        reserveOneMore();
+        created = true;
+        i = insertNew(mixHash(HashFunc::hashCode(key)), Entry(key));
+        return m_slot[i].entry();
+    }
+
+    Entry& getCreateEntry(const Key& key) {
+        bool ignore;
+        return getCreateEntry(key, ignore);
+    }
+
+    /** Returns the current value that key maps to, creating it if necessary.*/
+    Value& getCreate(const Key& key) {
+        return getCreateEntry(key).value;
+    }
+
+    /** \param created True if the element was created. */
+    Value& getCreate(const Key& key, bool& created) {
+        return getCreateEntry(key, created).value;
+    }
+
+    /**
+     Returns true if key is in the table.
+     */
+    bool containsKey(const Key& key) const {
+        return find(key) != m_capacity;
+    }
+
+    /**
+     Short syntax for get.
+     */
+    inline Value& operator[](const Key &key) const {
+        return get(key);
+    }
+
+    void getKeys(Array<Key>& keyArray) const {
+        keyArray.resize(0, DONT_SHRINK_UNDERLYING_ARRAY);
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (m_slot[i].distance != EMPTY) {
+                keyArray.append(m_slot[i].entry().key);
+            }
+        }
+    }
+
+    Array<Key> getKeys() const {
+        Array<Key> keyArray;
+        getKeys(keyArray);
+        return keyArray;
+    }
+
+    /**
+     Calls delete on all of the keys and then clears the table.
+     */
+    void deleteKeys() {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (m_slot[i].distance != EMPTY) {
+                delete m_slot[i].entry().key;
+                m_slot[i].entry().key = NULL;
+            }
+        }
+        clear();
+    }
+
+    /**
+     Calls delete on all of the values.  This is unsafe--
+     do not call unless you know that each value appears
+     at most once.
+
+     Does not clear the table, so you are left with a table
+     of NULL pointers.
+     */
+    void deleteValues() {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (m_slot[i].distance != EMPTY) {
+                delete m_slot[i].entry().value;
+                m_slot[i].entry().value = NULL;
+            }
+        }
+    }
+};
+
+} // namespace
+
+#ifdef _MSC_VER
+#   pragma warning (pop)
+#endif
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ \file FrameMemoryManager.h
+
+ \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+ \created 2026-10-17
+ \edited  2026-10-17
+
+ Copyright 2000-2012, Morgan McGuire.
+ All rights reserved.
+ */
+
+#ifndef G3D_FrameMemoryManager_h
+#define G3D_FrameMemoryManager_h
+
+#include "G3D/platform.h"
+#include "G3D/MemoryManager.h"
+
+namespace G3D {
+
+/**
+  \brief Per-thread arena for temporary arrays that live no longer than one frame.
+
+  alloc() bumps a pointer through blocks that are kept from frame to
+  frame, and free() only counts.  Whenever every allocation has been
+  freed, the arena rewinds to the start of its first block, so an
+  Array or Table that is created and destroyed inside one function
+  reuses the same memory on every call.  If a frame needed more than
+  one block, the blocks are replaced by a single block of the total
+  size on the next rewind, so in steady state no frame calls into the
+  general heap.
+
+  Each thread has its own instance, returned by current().  Memory
+  from it must be freed on the same thread and before the end of the
+  frame.  RenderDevice::beginFrame and RenderDevice::endFrame call
+  beginFrame() and endFrame() on the rendering thread's instance.
+
+  Example:
+  \code
+  Array<Plane> clipPlanes;
+  clipPlanes.clearAndSetMemoryManager(FrameMemoryManager::current());
+  \endcode
+
+  <b>Not threadsafe</b>: use only the calling thread's current().
+
+  \sa AreaMemoryManager, MemoryManager
+ */
+class FrameMemoryManager : public MemoryManager {
+public:
+
+    typedef ReferenceCountedPointer<FrameMemoryManager> Ref;
+
+    /** Counters for one frame */
+    class Stats {
+    public:
+        /** Calls to alloc() */
+        int             allocations;
+
+        /** Sum of the sizes passed to alloc(), after rounding up to the alignment */
+        size_t          bytes;
+
+        /** Most arena memory in use at one time */
+        size_t          peakBytes;
+
+        /** Calls to System::malloc on this thread since beginFrame(),
+            from any source, including blocks for this arena.  Zero in
+            steady state when every per-frame temporary uses the arena. */
+        int             heapAllocations;
+
+        Stats() : allocations(0), bytes(0), peakBytes(0), heapAllocations(0) {}
+    };
+
+private:
+
+    enum {ALIGNMENT = 16};
+
+    class Block {
+    public:
+        uint8*          data;
+        size_t          size;
+    };
+
+    /** Grown with ::realloc */
+    Block*              m_block;
+    int                 m_numBlocks;
+    int                 m_maxBlocks;
+
+    /** Index into m_block of the block being allocated from */
+    int                 m_currentBlock;
+
+    /** Bytes used in m_block[m_currentBlock] */
+    size_t              m_used;
+
+    /** Bytes used in the blocks before m_currentBlock */
+    size_t              m_usedBefore;
+
+    size_t              m_blockSize;
+
+    /** alloc() calls minus free() calls */
+    int                 m_liveAllocations;
+
+    bool                m_inFrame;
+
+    /** System::mallocCount() at beginFrame() */
+    int64               m_frameStartMallocCount;
+
+    Stats               m_frameStats;
+    Stats               m_lastFrameStats;
+
+    FrameMemoryManager(size_t blockSize);
+
+    /** Appends a block of at least \a s bytes */
+    void addBlock(size_t s);
+
+    /** Called when there are no live allocations */
+    void rewind();
+
+public:
+
+    /** The calling thread's arena, created on the first call from
+        each thread.  It is not released when the thread exits. */
+    static FrameMemoryManager::Ref current();
+
+    ~FrameMemoryManager();
+
+    /** Returns 16-byte aligned memory from the arena */
+    virtual void* alloc(size_t s);
+
+    /** Memory is reclaimed when all allocations have been freed */
+    virtual void free(void* x);
+
+    virtual bool isThreadsafe() const;
+
+    /** Resets the counters returned by frameStats() */
+    void beginFrame();
+
+    /** Copies frameStats() to lastFrameStats() and rewinds the arena.
+        Asserts in debug builds if an allocation outlives the frame;
+        in that case the arena rewinds once it is freed. */
+    void endFrame();
+
+    /** Counters since beginFrame() */
+    Stats frameStats() const;
+
+    /** Counters for the frame most recently ended by endFrame() */
+    const Stats& lastFrameStats() const {
+        return m_lastFrameStats;
+    }
+
+    /** Total size of the blocks held by the arena */
+    size_t capacity() const;
+
+    /** Number of allocations that have not been freed */
+    int liveAllocations() const {
+        return m_liveAllocations;
+    }
+};
+
+}
+
+#endif
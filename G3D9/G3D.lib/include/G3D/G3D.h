@@ -69,6 +69,8 @@
 #include "G3D/stringutils.h"
 #include "G3D/prompt.h"
 #include "G3D/Table.h"
+#include "G3D/FlatTable.h"
+#include "G3D/MemoryMappedFile.h"
 #include "G3D/FileSystem.h"
 #include "G3D/Set.h"
 #include "G3D/GUniqueID.h"
@@ -93,6 +95,7 @@
 #include "G3D/MemoryManager.h"
 #include "G3D/BlockPoolMemoryManager.h"
 #include "G3D/AreaMemoryManager.h"
+#include "G3D/FrameMemoryManager.h"
 #include "G3D/BumpMapPreprocess.h"
 #include "G3D/CubeFace.h"
 
@@ -134,6 +137,8 @@ template<class T> struct HashTrait< G3D::ReferenceCountedPointer<T> > {
 #include "G3D/AtomicInt32.h"
 #include "G3D/GThread.h"
 #include "G3D/ThreadSet.h"
+#include "G3D/ThreadPool.h"
+#include "G3D/ZoneProfiler.h"
 #include "G3D/RegistryUtil.h"
 #include "G3D/Any.h"
 #include "G3D/XML.h"
@@ -151,7 +156,10 @@ template<class T> struct HashTrait< G3D::ReferenceCountedPointer<T> > {
 #include "G3D/Matrix.h"
 #include "G3D/ImageFormat.h"
 #include "G3D/ImageBuffer.h"
+#include "G3D/ImageResampler.h"
+#include "G3D/ImagePreprocessor.h"
 #include "G3D/typeutils.h"
+#include "G3D/radixSort.h"
 #include "G3D/SpeedLoad.h"
 #include "G3D/ParseMTL.h"
 #include "G3D/ParseOBJ.h"
@@ -2,7 +2,7 @@
   @file GThread.h
  
   @created 2005-09-22
-  @edited  2010-09-10
+  @edited  2026-10-17
 
  */
 
@@ -12,6 +12,7 @@
 #include "G3D/platform.h"
 #include "G3D/ReferenceCount.h"
 #include "G3D/ThreadSet.h"
+#include "G3D/ThreadPool.h"
 #include "G3D/Vector2int32.h"
 #include "G3D/SpawnBehavior.h"
 #include <string>
@@ -81,68 +82,16 @@ protected:
      void (Class::*method1)(int x, int y),
      void (Class::*method2)(int x, int y, int threadID),
      int                 maxThreads) {
-        /** For use by runConcurrently2D. Designed for arbitrary iteration, although only used for
-            interlaced rows in the current implementation. */
-        class Worker : public GThread {
-        public:
-            /** Start for this thread, which differs from the others */
-            const int                 threadID;
-            const Vector2int32        start;
-            const Vector2int32        upTo;
-            const Vector2int32        stride;
-            Class*                    object;
-            void             (Class::*method1)(int x, int y);
-            void             (Class::*method2)(int x, int y, int threadID);
-            
-            Worker(int                 threadID,
-                   const Vector2int32& start, 
-                   const Vector2int32& upTo, 
-                   Class*              object,
-                   void (Class::*method1)(int x, int y),
-                   void (Class::*method2)(int x, int y, int threadID),
-                   const Vector2int32& stride) : 
-                GThread("runConcurrently2D worker"),
-                threadID(threadID),
-                start(start),
-                upTo(upTo), 
-                stride(stride),
-                object(object), 
-                method1(method1),
-                method2(method2) {}
-            
-            virtual void threadMain() {
-                for (int y = start.y; y < upTo.y; y += stride.y) {
-                    // Run whichever method was provided
-                    if (method1) {
-                        for (int x = start.x; x < upTo.x; x += stride.x) {
-                            (object->*method1)(x, y);
-                        }
-                    } else {
-                        for (int x = start.x; x < upTo.x; x += stride.x) {
-                            (object->*method2)(x, y, threadID);
-                        }
-                    }
-                }
-            }
-        };
-        
-        // Create a group of threads
-        if (maxThreads == NUM_CORES) {
-            maxThreads = numCores();
-        }
 
-        const int numRows = upTo.y - start.y;
-        const int numThreads = min(maxThreads, numRows);
-        const Vector2int32 stride(1, numThreads);
-        ThreadSet threadSet;
-        for (int t = 0; t < numThreads; ++t) {
-            threadSet.insert(new Worker(t, start + Vector2int32(0, t), upTo, object, method1, method2, stride));
+        if (maxThreads == NUM_CORES) {
+            maxThreads = ThreadPool::NUM_CORES;
         }
 
-        // Run the threads, reusing the current thread and blocking until
-        // all complete
-        threadSet.start(USE_CURRENT_THREAD);
-        threadSet.waitForCompletion();
+        // Each row is one tile, so that rows with very different costs
+        // are balanced by work stealing and x increases within each call
+        // sequence on a thread.
+        ThreadPool::MethodBody<Class> body(object, method1, method2);
+        ThreadPool::parallelFor2D(body, start, upTo, Vector2int32(upTo.x - start.x, 1), maxThreads);
     }
 
 public:
@@ -211,6 +160,10 @@ public:
         <code>start.y <= y < upTo.y</code>.  Iteration is row major,
         so each thread can expect to see successivly increasing x values.
 
+        The rows are executed on the persistent G3D::ThreadPool, so
+        no threads are created per call and rows are redistributed
+        between threads when some take much longer than others.
+
         \param maxThreads Maximum number of threads to use.  By default at
         most one thread per processor core will be used.
 
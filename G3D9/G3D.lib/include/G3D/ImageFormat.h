@@ -4,7 +4,7 @@
   \maintainer Morgan McGuire, http://graphics.cs.williams.edu
 
   \created 2003-05-23
-  \edited  2011-06-23
+  \edited  2026-10-17
 */
 
 #ifndef GLG3D_ImageFormat_H
@@ -390,6 +390,17 @@ public:
 
     static const ImageFormat* YUV444();
 
+    /** 8-bit raw camera sensor data with the named 2x2 color filter
+        pattern, read left to right and top to bottom.  Width and height
+        must be even.  These are CPU-only formats for ImageFormat::convert. */
+    static const ImageFormat* BAYER_RGGB8();
+
+    static const ImageFormat* BAYER_GRBG8();
+
+    static const ImageFormat* BAYER_GBRG8();
+
+    static const ImageFormat* BAYER_BGGR8();
+
     /**
      NULL pointer; indicates that the G3D::Texture class should choose
      either RGBA8 or RGB8 depending on the presence of an alpha channel
@@ -453,6 +464,10 @@ public:
                         const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits,
                         bool invertY = false, BayerAlgorithm bayerAlg = BayerAlgorithm::MHC);
 
+    /** Converts \a width pixels of a single unpadded row.  Returns true if a conversion was available.
+        \sa convert */
+    static bool convertRow(const void* srcBytes, const ImageFormat* srcFormat, void* dstBytes, const ImageFormat* dstFormat, int width);
+
     /* Checks if a conversion between two formats is available. */
     static bool conversionAvailable(const ImageFormat* srcFormat, int srcRowPadBits, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY = false);
 
@@ -0,0 +1,110 @@
+/**
+  \file G3D/ImagePreprocessor.h
+
+  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+  \created 2026-10-17
+  \edited  2026-10-17
+*/
+
+#ifndef G3D_ImagePreprocessor_h
+#define G3D_ImagePreprocessor_h
+
+#include "G3D/platform.h"
+#include "G3D/Color4.h"
+#include "G3D/ImageBuffer.h"
+#include "G3D/BumpMapPreprocess.h"
+
+namespace G3D {
+
+/**
+ \brief Per-pixel preparation of images before they become textures:
+ modulation, gamma adjustment, min/max/mean statistics, and normal map
+ generation, all in one pass over the image.
+
+ The image is processed in bands of rows that are split across
+ ThreadPool.  Each band is adjusted and then measured while it is still
+ in cache, so every source pixel is read from memory once.
+
+ R8, RG8, L8, LA8, RGB8, RGBA8 and their 32-bit floating-point
+ equivalents are processed directly, with SSE2 statistics.  Other
+ formats that ImageFormat::convert can take to RGBA32F and back are
+ processed through RGBA32F one row at a time; see supports().
+
+ This is the implementation of Texture::Preprocess, but it does not
+ require OpenGL.
+ */
+class ImagePreprocessor {
+public:
+
+    class Settings {
+    public:
+        /** Multiplies each channel.  Applied before gammaAdjust.  The
+            luminance of L and LA formats is multiplied by modulate.r. */
+        Color4                      modulate;
+
+        /** Each unit-scale channel, including alpha, is raised to this
+            power after modulation.  Values at or below zero in
+            floating-point images are unchanged. */
+        float                       gammaAdjust;
+
+        /** If true, fill the Stats passed to apply() */
+        bool                        computeMinMaxMean;
+
+        /** If true, the result is an RGBA8 normal map computed from
+            the first channel of the adjusted image, treated as a
+            tileable bump map.  The alpha channel is the bump height.
+            See BumpMapPreprocess. */
+        bool                        computeNormalMap;
+
+        BumpMapPreprocess           bumpMapPreprocess;
+
+        Settings() : modulate(Color4::one()), gammaAdjust(1.0f), computeMinMaxMean(true), computeNormalMap(false) {}
+
+        /** True if modulate or gammaAdjust change pixel values */
+        bool adjustsColor() const {
+            return (modulate != Color4::one()) || (gammaAdjust != 1.0f);
+        }
+    };
+
+    /** Statistics of the processed image, on a unit scale for
+        normalized formats.  Channels that the format lacks are 0,
+        except that alpha is 1.  Luminance is reported in r, g, and b. */
+    class Stats {
+    public:
+        Color4                      minval;
+        Color4                      maxval;
+        Color4                      meanval;
+
+        Stats() : minval(Color4::nan()), maxval(Color4::nan()), meanval(Color4::nan()) {}
+    };
+
+private:
+
+    ImagePreprocessor();
+
+public:
+
+    /** True if images in \a format can be processed */
+    static bool supports(const ImageFormat* format);
+
+    /** Processes the tightly-packed \a width x \a height image at \a src.
+
+        Returns a new image, in \a format (or RGBA8 for a normal map),
+        if Settings::adjustsColor() or Settings::computeNormalMap.
+        Otherwise returns NULL and only computes \a stats.  Also
+        returns NULL, with NaN \a stats, if the format is not supported.
+        3D images may be passed as a single image of height * depth rows
+        unless computing a normal map. */
+    static ImageBuffer::Ref apply
+    (const void*                    src,
+     int                            width,
+     int                            height,
+     const ImageFormat*             format,
+     const Settings&                settings,
+     Stats&                         stats);
+};
+
+} // namespace G3D
+
+#endif
@@ -0,0 +1,134 @@
+/**
+  \file G3D/ImageResampler.h
+
+  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+  \created 2026-10-17
+  \edited  2026-10-17
+*/
+
+#ifndef G3D_ImageResampler_h
+#define G3D_ImageResampler_h
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/ImageBuffer.h"
+#include "G3D/enumclass.h"
+
+namespace G3D {
+
+/**
+ \brief High-quality CPU image scaling and MIP-map chain generation.
+
+ Resizes with a separable filter: first along rows, then along
+ columns.  When minifying, the filter is widened by the scale factor so
+ that it also acts as the low-pass filter.  Pixels past the edge of the
+ image are clamped to the edge.
+
+ Filtering happens on RGBA32F pixels in a linear color space.  Images
+ in 8-bit normalized formats are assumed to be sRGB encoded (unless
+ Settings::gammaCorrect is false) and are converted to linear values
+ before filtering and back afterwards, so that minified images keep
+ their brightness.  Alpha is always linear.  Floating-point images are
+ assumed to be linear.
+
+ Any format that ImageFormat::convert can take to RGBA32F and back is
+ supported; see supports().  Large images are split across
+ ThreadPool, and the inner loops use SSE.  No OpenGL context is
+ required.
+
+ \code
+ ImageBuffer::Ref half = ImageResampler::resample(image, image->width() / 2, image->height() / 2);
+
+ Array<ImageBuffer::Ref> mip;
+ ImageResampler::mipChain(image, mip);
+ \endcode
+ */
+class ImageResampler {
+public:
+
+    class Filter {
+    public:
+        enum Value {
+            /** Averages the source pixels under each destination pixel.
+                Exact for 2:1 reduction, but blocky when magnifying. */
+            BOX,
+
+            /** Windowed sinc with three lobes.  Sharp, with slight ringing. */
+            LANCZOS3,
+
+            /** Sinc windowed by a Kaiser window (alpha = 4) with three lobes.
+                Less ringing than LANCZOS3 and almost as sharp. */
+            KAISER
+        };
+
+    private:
+        static const char* toString(int i, Value& v) {
+            static const char* str[] = {"BOX", "LANCZOS3", "KAISER", NULL};
+            static const Value val[] = {BOX, LANCZOS3, KAISER};
+            const char* s = str[i];
+            if (s) {
+                v = val[i];
+            }
+            return s;
+        }
+
+        Value value;
+
+    public:
+
+        G3D_DECLARE_ENUM_CLASS_METHODS(Filter);
+    };
+
+    class Settings {
+    public:
+        Filter          filter;
+
+        /** If true, treat the color channels of 8-bit normalized
+            formats as sRGB encoded.  Formats with COLOR_SPACE_SRGB are
+            always decoded. */
+        bool            gammaCorrect;
+
+        Settings() : filter(Filter::LANCZOS3), gammaCorrect(true) {}
+    };
+
+private:
+
+    ImageResampler();
+
+public:
+
+    /** True if images in \a format can be resampled */
+    static bool supports(const ImageFormat* format);
+
+    /** Returns a \a width x \a height image in the same format as \a src,
+        or NULL if the format is not supported. */
+    static ImageBuffer::Ref resample(const ImageBuffer::Ref& src, int width, int height, const Settings& settings = Settings());
+
+    /** Resamples tightly-packed or padded rows in place of
+        ImageBuffers.  The padding arguments are the same as those of
+        ImageFormat::convert.  Returns false if the format is not
+        supported. */
+    static bool resample
+    (const void*            srcBytes,
+     int                    srcWidth,
+     int                    srcHeight,
+     int                    srcRowPadBits,
+     const ImageFormat*     format,
+     void*                  dstBytes,
+     int                    dstWidth,
+     int                    dstHeight,
+     int                    dstRowPadBits,
+     const Settings&        settings = Settings());
+
+    /** Sets \a levels to the full MIP-map chain of \a src: level 0 is
+        \a src itself and each following level halves each dimension
+        (rounding down, but not below 1) until reaching 1x1.  Each level
+        is filtered from the previous one at full precision.  Leaves
+        \a levels empty if the format is not supported. */
+    static void mipChain(const ImageBuffer::Ref& src, Array<ImageBuffer::Ref>& levels, const Settings& settings = Settings());
+};
+
+} // namespace G3D
+
+#endif
@@ -4,7 +4,7 @@
   @maintainer Morgan McGuire, http://graphics.cs.williams.edu
   @cite Backtrace by Aaron Orenstein
   @created 2001-08-04
-  @edited  2005-11-04
+  @edited  2026-10-17
  */
 
 #ifndef G3D_LOG_H
@@ -13,13 +13,50 @@
 #include <stdio.h>
 #include <string>
 #include "G3D/platform.h"
+#include "G3D/AtomicInt32.h"
 
 #ifndef G3D_WIN32
     #include <stdarg.h>
 #endif
 
+/** \def G3D_MIN_LOG_LEVEL
+    Calls to logDebugPrintf, logInfoPrintf, logWarningPrintf, and
+    logErrorPrintf below this level are compiled out, including the
+    evaluation of their arguments.  Defaults to G3D_LOG_LEVEL_DEBUG in
+    debug builds and G3D_LOG_LEVEL_INFO otherwise.  Define it before
+    including G3D to change it. */
+#define G3D_LOG_LEVEL_DEBUG   0
+#define G3D_LOG_LEVEL_INFO    1
+#define G3D_LOG_LEVEL_WARNING 2
+#define G3D_LOG_LEVEL_ERROR   3
+#define G3D_LOG_LEVEL_NONE    4
+
+#ifndef G3D_MIN_LOG_LEVEL
+#   ifdef G3D_DEBUG
+#       define G3D_MIN_LOG_LEVEL G3D_LOG_LEVEL_DEBUG
+#   else
+#       define G3D_MIN_LOG_LEVEL G3D_LOG_LEVEL_INFO
+#   endif
+#endif
+
+/** logPrintf at G3D_LOG_LEVEL_DEBUG.  Use like a function. */
+#define logDebugPrintf   if (G3D_MIN_LOG_LEVEL > G3D_LOG_LEVEL_DEBUG) {} else ::G3D::logPrintf
+
+/** logPrintf at G3D_LOG_LEVEL_INFO */
+#define logInfoPrintf    if (G3D_MIN_LOG_LEVEL > G3D_LOG_LEVEL_INFO) {} else ::G3D::logPrintf
+
+/** logPrintf at G3D_LOG_LEVEL_WARNING */
+#define logWarningPrintf if (G3D_MIN_LOG_LEVEL > G3D_LOG_LEVEL_WARNING) {} else ::G3D::logPrintf
+
+/** logPrintf at G3D_LOG_LEVEL_ERROR */
+#define logErrorPrintf   if (G3D_MIN_LOG_LEVEL > G3D_LOG_LEVEL_ERROR) {} else ::G3D::logPrintf
+
 namespace G3D {
 
+namespace _internal {
+class LogQueue;
+}
+
 /** Prints to the common system log, log.txt, which is usually 
     in the working directory of the program.  If your disk is 
     not writable or is slow, it will attempt to write to "c:/tmp/log.txt" or
@@ -33,6 +70,9 @@ namespace G3D {
     Many G3D routines write useful warnings and debugging information to the
     system log, which makes it a good first place to go when tracking down
     a problem.
+
+    If the common log is asynchronous, this returns once the
+    output is queued; see Log::setAsynchronous.
      */
 void logPrintf(const char* fmt, ...);
 
@@ -44,10 +84,32 @@ void logLazyPrintf(const char* fmt, ...);
  is the "common log" and can be accessed with the static
  method common().  If you access common() and a common log
  does not yet exist, one is created for you.
+
+ By default every message is written and flushed before the method
+ returns.  In asynchronous mode (setAsynchronous()) messages are
+ instead copied into a fixed-size lock-free queue, and a background
+ thread writes them to the file in batches and flushes once per
+ batch.  Each message is written contiguously, even when many
+ threads log at once.  A producer only blocks if the queue is full.
+ Messages too large for half of the queue are written directly
+ instead, still contiguously.  Asynchronous logs are flushed when
+ the program exits.  When it crashes with a signal such as SIGSEGV
+ or SIGABRT, the messages still in the queue are written without
+ taking any locks; messages that the background thread was writing
+ at that moment may be lost.
  */
 class Log {
 private:
 
+    /** Non-NULL in asynchronous mode */
+    _internal::LogQueue* volatile queue;
+
+    /** Number of threads between beginProducing() and endProducing() */
+    AtomicInt32             activeProducers;
+
+    /** Nonzero while setAsynchronous(false) writes out the old queue */
+    AtomicInt32             retiring;
+
     /**
      Log messages go here.
      */
@@ -59,6 +121,21 @@ private:
 
     int                     stripFromStackBottom;
 
+    /** Writes or enqueues \a length bytes, followed by a newline if
+        \a newline is true */
+    void write(const char* text, int length, bool newline, bool flush);
+
+    /** Returns the queue and keeps setAsynchronous(false) from
+        deleting it until endProducing(), or returns NULL in
+        synchronous mode once every queued message has been written */
+    _internal::LogQueue* beginProducing();
+
+    /** Call after a non-NULL beginProducing() */
+    void endProducing();
+
+    /** Blocks while setAsynchronous(false) is writing out the queue */
+    void waitForRetiredQueue();
+
 public:
 
     /**
@@ -74,10 +151,34 @@ public:
     virtual ~Log();
 
     /**
-     Returns the handle to the file log.
+     Returns the handle to the file log.  In asynchronous mode, call
+     flush() before writing to it directly.
      */
     FILE* getFile() const;
 
+    /**
+     In asynchronous mode, producers format into a queue and a
+     background thread writes to the file.  Disabling asynchronous mode
+     flushes the queue and stops the thread.
+
+     @param queueBytes Approximate size of the queue.  Messages longer
+     than half of it are written synchronously.
+
+     Disabling may be called while other threads are logging; they
+     finish with the queue before it is released.
+     */
+    void setAsynchronous(bool asynchronous, int queueBytes = 1024 * 1024);
+
+    bool asynchronous() const {
+        return queue != NULL;
+    }
+
+    /**
+     Blocks until every message that this thread has logged is
+     written to the file and flushed.  Called automatically at exit.
+     */
+    void flush();
+
     /**
      Marks the beginning of a logfile section.
      */
@@ -91,7 +192,7 @@ public:
     void __cdecl printf(const char* fmt, ...) G3D_CHECK_PRINTF_METHOD_ARGS;
 
     void __cdecl vprintf(const char*, va_list argPtr) G3D_CHECK_VPRINTF_METHOD_ARGS;
-    /** Does not flush */
+    /** Does not flush.  In asynchronous mode, the same as vprintf. */
     void __cdecl lazyvprintf(const char*, va_list argPtr) G3D_CHECK_VPRINTF_METHOD_ARGS;
 
     static Log* common();
@@ -5,7 +5,7 @@
 
  @maintainer Morgan McGuire, morgan@cs.brown.edu
  @created 2004-10-10
- @edited  2009-03-24
+ @edited  2026-10-17
  */
 #ifndef G3D_Map2D_h
 #define G3D_Map2D_h
@@ -20,6 +20,7 @@
 #include "G3D/GThread.h"
 #include "G3D/Rect2D.h"
 #include "G3D/WrapMode.h"
+#include "G3D/ThreadPool.h"
 
 #include <string>
 
@@ -76,6 +77,66 @@ DECLARE_COMPUTE_TYPE( Color4uint8,  Color4)
 #undef DECLARE_COMPUTE_TYPE
 
 namespace G3D {
+namespace _internal {
+
+/** Number of 32-bit float channels if the type is stored as packed floats, otherwise 0.
+    Map2D samples batches of these types with SIMD kernels. */
+template<typename Storage> class _GetFloatChannels {
+public:
+    enum {value = 0};
+};
+
+} // _internal
+} // G3D
+
+#define DECLARE_FLOAT_CHANNELS(StorageType, numChannels)          \
+namespace G3D {                                                   \
+    namespace _internal {                                         \
+        template<> class _GetFloatChannels < StorageType > {      \
+        public:                                                   \
+            enum {value = numChannels};                           \
+        };                                                        \
+    }                                                             \
+}
+
+DECLARE_FLOAT_CHANNELS( float32,  1)
+DECLARE_FLOAT_CHANNELS( Color1,   1)
+DECLARE_FLOAT_CHANNELS( Vector2,  2)
+DECLARE_FLOAT_CHANNELS( Vector3,  3)
+DECLARE_FLOAT_CHANNELS( Color3,   3)
+DECLARE_FLOAT_CHANNELS( Vector4,  4)
+DECLARE_FLOAT_CHANNELS( Color4,   4)
+#undef DECLARE_FLOAT_CHANNELS
+
+namespace G3D {
+namespace _internal {
+
+/** Catmull-Rom spline weights of the four control points around
+    fraction \a s on [0, 1), in single precision. */
+inline void map2DCatmullRomWeights(float s, float* c) {
+    const float s2 = s * s;
+    c[0] = s * (-0.5f + s * (1.0f - 0.5f * s));
+    c[1] = 1.0f + s2 * (-2.5f + 1.5f * s);
+    c[2] = s * (0.5f + s * (2.0f - 1.5f * s));
+    c[3] = s2 * (-0.5f + 0.5f * s);
+}
+
+/** Batch bilinear or bicubic sampling of a \a width x \a height image
+    of \a channels packed floats per pixel.  Writes \a channels floats
+    per sample to \a result.  Uses SSE2 when available and ThreadPool
+    for large batches.  See Map2D::bilinear(const Vector2*, Compute*, int, WrapMode). */
+void map2DSampleFloat
+(const float*       data,
+ int                width,
+ int                height,
+ int                channels,
+ WrapMode           wrap,
+ bool               bicubic,
+ const Vector2*     pos,
+ int                n,
+ float*             result);
+
+} // _internal
 
 /**
   Map of values across a discrete 2D plane.  Can be thought of as a generic class for 2D images, 
@@ -229,6 +290,185 @@ protected:
         }
     }
 
+    /** Number of samples per task of the batch sampling loops */
+    enum {SAMPLES_PER_TASK = 4096};
+
+    /** Approximate number of pixels per task of forEachPixel() and map() */
+    enum {PIXELS_PER_TASK = 16 * 1024};
+
+    /** get() with the wrap mode resolved at compile time */
+    template<WrapMode::Value wrap>
+    inline const Storage& wrappedGet(int x, int y) const {
+        if (((uint32)x < w) && ((uint32)y < h)) {
+            return data[x + y * w];
+        } else if (wrap == WrapMode::CLAMP) {
+            return fastGet(iClamp(x, 0, w - 1), iClamp(y, 0, h - 1));
+        } else if (wrap == WrapMode::TILE) {
+            return fastGet(iWrap(x, w), iWrap(y, h));
+        } else if (wrap == WrapMode::ZERO) {
+            return ZERO;
+        } else {
+            return const_cast<Type*>(this)->slowGet(x, y, wrap);
+        }
+    }
+
+    /** Same arithmetic as bilinear(float, float, WrapMode) */
+    template<WrapMode::Value wrap>
+    void bilinearRange(const Vector2* pos, Compute* result, int begin, int end) const {
+        for (int k = begin; k < end; ++k) {
+            const int i = iFloor(pos[k].x);
+            const int j = iFloor(pos[k].y);
+
+            const float fX = pos[k].x - i;
+            const float fY = pos[k].y - j;
+
+            const Compute& t0 = wrappedGet<wrap>(i, j);
+            const Compute& t1 = wrappedGet<wrap>(i + 1, j);
+            const Compute& t2 = wrappedGet<wrap>(i, j + 1);
+            const Compute& t3 = wrappedGet<wrap>(i + 1, j + 1);
+
+            result[k] = lerp(lerp(t0, t1, fX), lerp(t2, t3, fX), fY);
+        }
+    }
+
+    /** Catmull-Rom interpolation with the weights computed once per sample */
+    template<WrapMode::Value wrap>
+    void bicubicRange(const Vector2* pos, Compute* result, int begin, int end) const {
+        for (int k = begin; k < end; ++k) {
+            const int i = iFloor(pos[k].x);
+            const int j = iFloor(pos[k].y);
+
+            float wx[4], wy[4];
+            _internal::map2DCatmullRomWeights(pos[k].x - i, wx);
+            _internal::map2DCatmullRomWeights(pos[k].y - j, wy);
+
+            Compute sum(ZERO);
+            for (int v = 0; v < 4; ++v) {
+                Compute row(ZERO);
+                for (int u = 0; u < 4; ++u) {
+                    row += Compute(wrappedGet<wrap>(i + u - 1, j + v - 1)) * wx[u];
+                }
+                sum += row * wy[v];
+            }
+            result[k] = sum;
+        }
+    }
+
+    /** Parallel loop body for batch sampling of types without a SIMD kernel */
+    class BatchSampler {
+    public:
+        const Map2D*        map;
+        const Vector2*      pos;
+        Compute*            result;
+        int                 n;
+        WrapMode            wrap;
+        bool                bicubic;
+
+        BatchSampler(const Map2D* map, const Vector2* pos, Compute* result, int n, WrapMode wrap, bool bicubic) :
+            map(map), pos(pos), result(result), n(n), wrap(wrap), bicubic(bicubic) {}
+
+        template<WrapMode::Value m>
+        void runRange(int begin, int end) {
+            if (bicubic) {
+                map->template bicubicRange<m>(pos, result, begin, end);
+            } else {
+                map->template bilinearRange<m>(pos, result, begin, end);
+            }
+        }
+
+        void run(int task, int threadID) {
+            (void)threadID;
+            const int begin = task * SAMPLES_PER_TASK;
+            const int end   = G3D::min(n, begin + (int)SAMPLES_PER_TASK);
+            switch (wrap) {
+            case WrapMode::CLAMP:  runRange<WrapMode::CLAMP>(begin, end);  break;
+            case WrapMode::TILE:   runRange<WrapMode::TILE>(begin, end);   break;
+            case WrapMode::ZERO:   runRange<WrapMode::ZERO>(begin, end);   break;
+            case WrapMode::IGNORE: runRange<WrapMode::IGNORE>(begin, end); break;
+            default:               runRange<WrapMode::ERROR>(begin, end);  break;
+            }
+        }
+    };
+
+    void sampleBatch(const Vector2* pos, Compute* result, int n, WrapMode wrap, bool bicubic) const {
+        if (n <= 0) {
+            return;
+        }
+
+        enum {CHANNELS = _internal::_GetFloatChannels<Storage>::value};
+        if ((CHANNELS > 0) && (sizeof(Storage) == CHANNELS * sizeof(float))) {
+            const float* src = reinterpret_cast<const float*>(data.getCArray());
+            if (((int)_internal::_GetFloatChannels<Compute>::value == (int)CHANNELS) && (sizeof(Compute) == sizeof(Storage))) {
+                // Compute has the same layout as Storage
+                _internal::map2DSampleFloat(src, w, h, CHANNELS, wrap, bicubic, pos, n, reinterpret_cast<float*>(result));
+            } else {
+                Array<float> temp;
+                temp.resize(n * CHANNELS);
+                _internal::map2DSampleFloat(src, w, h, CHANNELS, wrap, bicubic, pos, n, temp.getCArray());
+                const Storage* t = reinterpret_cast<const Storage*>(temp.getCArray());
+                for (int i = 0; i < n; ++i) {
+                    result[i] = Compute(t[i]);
+                }
+            }
+        } else {
+            BatchSampler sampler(this, pos, result, n, wrap, bicubic);
+            ThreadPool::parallelFor(0, (n + SAMPLES_PER_TASK - 1) / SAMPLES_PER_TASK, &sampler, &BatchSampler::run);
+        }
+    }
+
+    /** Parallel loop body for forEachPixel() */
+    template<class Functor, class Value>
+    class PixelLoop {
+    public:
+        Value*              data;
+        int                 width;
+        int                 height;
+        int                 rowsPerTask;
+        const Functor*      f;
+
+        PixelLoop(Value* data, int width, int height, int rowsPerTask, const Functor* f) :
+            data(data), width(width), height(height), rowsPerTask(rowsPerTask), f(f) {}
+
+        void run(int task, int threadID) {
+            (void)threadID;
+            const int upTo = G3D::min(height, (task + 1) * rowsPerTask);
+            for (int y = task * rowsPerTask; y < upTo; ++y) {
+                Value* row = data + y * width;
+                for (int x = 0; x < width; ++x) {
+                    (*f)(x, y, row[x]);
+                }
+            }
+        }
+    };
+
+    /** Parallel loop body for map() */
+    template<class Functor, class Source>
+    class MapLoop {
+    public:
+        const Source*       src;
+        Storage*            dst;
+        int                 n;
+        const Functor*      f;
+
+        MapLoop(const Source* src, Storage* dst, int n, const Functor* f) :
+            src(src), dst(dst), n(n), f(f) {}
+
+        void run(int task, int threadID) {
+            (void)threadID;
+            const int upTo = G3D::min(n, (task + 1) * (int)PIXELS_PER_TASK);
+            for (int i = task * PIXELS_PER_TASK; i < upTo; ++i) {
+                dst[i] = (*f)(src[i]);
+            }
+        }
+    };
+
+    template<class Functor, class Value>
+    void runPixelLoop(Value* p, const Functor& f) const {
+        const int rowsPerTask = G3D::max(1, (int)PIXELS_PER_TASK / G3D::max(1, (int)w));
+        PixelLoop<Functor, Value> loop(p, w, h, rowsPerTask, &f);
+        ThreadPool::parallelFor(0, ((int)h + rowsPerTask - 1) / rowsPerTask, &loop, &PixelLoop<Functor, Value>::run);
+    }
+
 public:
 
     /** Unsafe access to the underlying data structure with no wrapping support; requires that (x, y) is in bounds. */
@@ -454,6 +694,45 @@ public:
         setChanged(true);
     }
 
+    /** Invokes \a f(x, y, value) for every pixel, where value is a
+        Storage& that \a f may modify.  Bands of rows run concurrently
+        on ThreadPool, so \a f must not write shared state without
+        synchronization.  Sets the changed flag.
+
+        \code
+        class Exposure {
+        public:
+            float scale;
+            void operator()(int x, int y, Color3& c) const { c *= scale; }
+        };
+        image->forEachPixel(exposure);
+        \endcode
+     */
+    template<class Functor>
+    void forEachPixel(const Functor& f) {
+        runPixelLoop(data.getCArray(), f);
+        setChanged(true);
+    }
+
+    /** Invokes \a f(x, y, value) for every pixel, where value is a
+        const Storage&, concurrently on ThreadPool. */
+    template<class Functor>
+    void forEachPixel(const Functor& f) const {
+        runPixelLoop(data.getCArray(), f);
+    }
+
+    /** Resizes this map to the dimensions of \a src and sets every
+        pixel to \a f(src pixel), concurrently on ThreadPool.  For
+        example, computes the luminance of an Image3 into an Image1. */
+    template<class S, class C, class Functor>
+    void map(const Map2D<S, C>& src, const Functor& f) {
+        resize(src.width(), src.height());
+        const int n = w * h;
+        MapLoop<Functor, S> loop(src.getCArray(), data.getCArray(), n, &f);
+        ThreadPool::parallelFor(0, (n + PIXELS_PER_TASK - 1) / PIXELS_PER_TASK, &loop, &MapLoop<Functor, S>::run);
+        setChanged(true);
+    }
+
     /** flips if @a flip is true*/
     void maybeFlipVertical(bool flip) {
         if (flip) {
@@ -597,6 +876,36 @@ public:
         return bilinear(p.x, p.y, wrap);
     }
 
+    /**
+      Sets <code>result[i] = bilinear(pos[i], wrap)</code> for each of
+      the \a n positions.  The wrap mode is resolved once per batch
+      instead of once per texel, and large batches are split across
+      ThreadPool.
+
+      Maps of packed floats (float32, Color1, Color3, Color4, and
+      Vector2-4, which includes Image1, Image3, and Image4) are sampled
+      four positions at a time with SSE2.  Their results are identical
+      to the single-sample method except for Map2D<float32>, which
+      interpolates in float rather than its float64 Compute type.
+     */
+    void bilinear(const Vector2* pos, Compute* result, int n, WrapMode wrap) const {
+        sampleBatch(pos, result, n, wrap, false);
+    }
+
+    void bilinear(const Vector2* pos, Compute* result, int n) const {
+        sampleBatch(pos, result, n, _wrapMode, false);
+    }
+
+    /** Resizes \a result to match \a pos */
+    void bilinear(const Array<Vector2>& pos, Array<Compute>& result, WrapMode wrap) const {
+        result.resize(pos.size());
+        sampleBatch(pos.getCArray(), result.getCArray(), pos.size(), wrap, false);
+    }
+
+    void bilinear(const Array<Vector2>& pos, Array<Compute>& result) const {
+        bilinear(pos, result, _wrapMode);
+    }
+
     /**
      Uses Catmull-Rom splines to interpolate between grid
      values.  Guaranteed to match nearest(x, y) at integers.
@@ -635,6 +944,31 @@ public:
         return bicubic(p.x, p.y, _wrapMode);
     }
 
+    /**
+      Sets <code>result[i] = bicubic(pos[i], wrap)</code> for each of
+      the \a n positions, with the same batching as
+      bilinear(const Vector2*, Compute*, int, WrapMode).  The spline
+      weights are computed in single precision, so results may differ
+      from the single-sample method in the last few bits.
+     */
+    void bicubic(const Vector2* pos, Compute* result, int n, WrapMode wrap) const {
+        sampleBatch(pos, result, n, wrap, true);
+    }
+
+    void bicubic(const Vector2* pos, Compute* result, int n) const {
+        sampleBatch(pos, result, n, _wrapMode, true);
+    }
+
+    /** Resizes \a result to match \a pos */
+    void bicubic(const Array<Vector2>& pos, Array<Compute>& result, WrapMode wrap) const {
+        result.resize(pos.size());
+        sampleBatch(pos.getCArray(), result.getCArray(), pos.size(), wrap, true);
+    }
+
+    void bicubic(const Array<Vector2>& pos, Array<Compute>& result) const {
+        bicubic(pos, result, _wrapMode);
+    }
+
     /** Pixel width */
     inline int32 width() const {
         return (int32)w;
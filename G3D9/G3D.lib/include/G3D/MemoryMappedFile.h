@@ -0,0 +1,92 @@
+/**
+  \file G3D/MemoryMappedFile.h
+
+  \created 2026-10-17
+  \edited  2026-10-17
+
+  Copyright 2000-2012, Morgan McGuire.
+  All rights reserved.
+ */
+#ifndef G3D_MemoryMappedFile_h
+#define G3D_MemoryMappedFile_h
+
+#include "G3D/platform.h"
+#include "G3D/ReferenceCount.h"
+#include <string>
+
+namespace G3D {
+
+/**
+ \brief Read-only view of an entire file through the virtual memory system.
+
+ Pages are loaded by the operating system on first access and are
+ shared with the file cache, so mapping a file costs neither a heap
+ allocation nor a copy.  The mapping stays valid for as long as a
+ reference to this object exists.
+
+ \sa BinaryInput, FileSystem
+ */
+class MemoryMappedFile : public ReferenceCountedObject {
+public:
+    typedef ReferenceCountedPointer<MemoryMappedFile> Ref;
+
+    /** Tells the operating system how the pages will be touched so
+        that it can choose a read-ahead policy. */
+    enum AccessHint {
+        /** Moderate read-ahead */
+        NORMAL_ACCESS,
+
+        /** Aggressive read-ahead; pages behind the reader may be dropped early */
+        SEQUENTIAL_ACCESS,
+
+        /** No read-ahead */
+        RANDOM_ACCESS
+    };
+
+private:
+
+    std::string         m_filename;
+    const uint8*        m_data;
+    int64               m_size;
+
+#   ifdef G3D_WIN32
+        /** HANDLE of the file mapping object */
+        void*           m_mapping;
+#   endif
+
+    MemoryMappedFile(const std::string& filename);
+
+    // Not implemented on purpose, don't use
+    MemoryMappedFile(const MemoryMappedFile&);
+    MemoryMappedFile& operator=(const MemoryMappedFile&);
+
+public:
+
+    /** Returns NULL if the file does not exist or cannot be mapped
+        (e.g., because it does not fit in the address space). */
+    static Ref create(const std::string& filename, AccessHint hint = NORMAL_ACCESS);
+
+    /** Changes the read-ahead policy for the whole mapping.  This is
+        only a hint and may be ignored on some platforms. */
+    void advise(AccessHint hint);
+
+    virtual ~MemoryMappedFile();
+
+    const std::string& filename() const {
+        return m_filename;
+    }
+
+    /** Start of the file.  NULL if the file is empty. */
+    const uint8* data() const {
+        return m_data;
+    }
+
+    /** Length of the file in bytes */
+    int64 size() const {
+        return m_size;
+    }
+};
+
+} // namespace G3D
+
+#endif
@@ -4,7 +4,7 @@
  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
 
  \created 2011-07-23
- \edited  2011-07-23
+ \edited  2026-10-17
 
  Copyright 2002-2011, Morgan McGuire.
  All rights reserved.
@@ -31,6 +31,34 @@ class BinaryInput;
 The input file is required to contain only vertex and (face or triStrip) elements, in that order.
 Each may have any number of properties.
 
+The header is compiled into a decoding plan before any data is read.
+Vertices whose properties are all floats are read with a single bulk
+copy (plus a byte swap if the file's endian-ness differs from the
+machine's), other fixed-size vertex layouts are decoded a column at a
+time, and the common face layout of a uchar count followed by int
+indices is decoded directly from the file buffer.
+
+parse() decodes the whole file.  To process a file that is too large to
+hold in memory in decoded form, call parseHeader() and then
+readVertexBatch() and readFaceBatch() (or readTriStripBatch()) until
+they return zero:
+
+\code
+ParsePLY ply;
+BinaryInput bi(filename, G3D_LITTLE_ENDIAN);
+ply.parseHeader(bi);
+
+Array<float> vertex;
+while (ply.readVertexBatch(bi, vertex, 100000) > 0) {
+    ... vertex[v * ply.vertexProperty.size() + p] is property p of vertex v in this batch
+}
+
+Array<ParsePLY::Face> face;
+while (ply.readFaceBatch(bi, face, 100000) > 0) {
+    ...
+}
+\endcode
+
 \cite http://paulbourke.net/dataformats/ply/
 
 \sa G3D::ParseMTL, G3D::ParseOBJ, G3D::ArticulatedModel
@@ -109,12 +137,47 @@ public:
 
 private:
 
+    /** Byte offset of each vertex property within a vertex.  Only used
+        when m_vertexStride is nonzero. */
+    Array<int>      m_vertexOffset;
+
+    /** Bytes per vertex, or zero if the vertices contain lists and must
+        be decoded one property at a time */
+    int             m_vertexStride;
+
+    /** True if every vertex property is a float */
+    bool            m_allFloatVertices;
+
+    /** Number of face or tristrip properties before and after the
+        vertex_index list */
+    int             m_numPropertiesBeforeIndex;
+    int             m_numPropertiesAfterIndex;
+
+    /** True if the only face or tristrip property is the vertex_index
+        list, with a one-byte length and four-byte indices */
+    bool            m_packedIndexList;
+
+    /** Number of vertices and faces (or tristrips) decoded so far */
+    int             m_numVerticesRead;
+    int             m_numFacesRead;
+
     static void parseProperty(const std::string& s, Property& prop);
     static float readAsFloat(const Property& prop, BinaryInput& bi);
 
     void readHeader(BinaryInput& bi);
-    void readVertexList(BinaryInput& bi);
-    void readFaceList(BinaryInput& bi);
+
+    /** Computes the decoding plan from the properties */
+    void compileDecoders(BinaryInput& bi);
+
+    /** Decodes the next \a n vertices into \a data */
+    void readVertices(BinaryInput& bi, float* data, int n);
+
+    /** Decodes the next \a n faces into \a face, or tristrips into \a
+        triStrip; the other must be NULL */
+    void readFaces(BinaryInput& bi, Face* face, TriStrip* triStrip, int n);
+
+    /** readFaces() when m_packedIndexList is true */
+    void readPackedFaces(BinaryInput& bi, Face* face, TriStrip* triStrip, int n);
 
 public:
     
@@ -124,8 +187,27 @@ public:
 
     ~ParsePLY();
 
+    /** Reads the entire file.  The endian-ness of \a bi is restored afterward. */
     void parse(BinaryInput& bi);
 
+    /** Reads only the header, leaving \a bi at the first vertex, and sets
+        its endian-ness to that of the file.  Use with readVertexBatch()
+        and readFaceBatch() or readTriStripBatch() to stream the file.
+        vertexData, faceArray, and triStripArray are not allocated. */
+    void parseHeader(BinaryInput& bi);
+
+    /** Decodes up to \a maxVertices of the vertices that follow those
+        already read into \a data, in the same layout as vertexData, and
+        returns the number decoded.  Returns zero after the last vertex. */
+    int readVertexBatch(BinaryInput& bi, Array<float>& data, int maxVertices);
+
+    /** Decodes up to \a maxFaces faces into \a face and returns the number
+        decoded.  All vertices must have been read first. */
+    int readFaceBatch(BinaryInput& bi, Array<Face>& face, int maxFaces);
+
+    /** Decodes up to \a maxTriStrips tristrips into \a triStrip and returns
+        the number decoded.  All vertices must have been read first. */
+    int readTriStripBatch(BinaryInput& bi, Array<TriStrip>& triStrip, int maxTriStrips);
 };
 
 
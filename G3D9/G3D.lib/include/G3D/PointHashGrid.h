@@ -3,7 +3,7 @@
 
    \maintainer Morgan McGuire, http://graphics.cs.williams.edu
    \created 2008-07-01
-   \edited  2010-11-28
+   \edited  2026-10-17
 
    Copyright 2000-2012, Morgan McGuire.
    All rights reserved.
@@ -17,7 +17,7 @@
 #include "G3D/Vector3.h"
 #include "G3D/Vector3int32.h"
 #include "G3D/Array.h"
-#include "G3D/Table.h"
+#include "G3D/FlatTable.h"
 #include "G3D/AABox.h"
 #include "G3D/Sphere.h"
 #include "G3D/SmallArray.h"
@@ -107,7 +107,7 @@ private:
 
     /** One cell of the grid. */
     typedef SmallArray<Entry, expectedCellSize> Cell;
-    typedef Table<Point3int32, Cell >           CellTable;
+    typedef FlatTable<Point3int32, Cell >       CellTable;
 
     /** The cube of +/-1 along each dimension. Initialized by initOffsetArray.*/
     Vector3int32        m_offsetArray[3*3*3];
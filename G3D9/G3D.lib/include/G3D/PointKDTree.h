@@ -4,7 +4,7 @@
   @maintainer Morgan McGuire, http://graphics.cs.williams.edu
  
   @created 2004-01-11
-  @edited  2008-11-02
+  @edited  2026-10-17
 
   Copyright 2000-2009, Morgan McGuire.
   All rights reserved.
@@ -431,6 +431,213 @@ protected:
         }
     };
 
+    /** Node of the contiguous layout built by compact().  The subtree rooted
+        at a node occupies a contiguous range of flatNode, beginning
+        with the node itself, and its values are a contiguous range of
+        flatHandle. */
+    class FlatNode {
+    public:
+        float               splitLocation;
+        int                 splitAxis;
+
+        /** Indices into flatNode, or -1 */
+        int                 child[2];
+
+        /** Range of flatHandle holding the values at this node */
+        int                 firstHandle;
+        int                 numHandles;
+    };
+
+    Array<FlatNode>         flatNode;
+    Array<Handle>           flatHandle;
+
+    /** True if flatNode and flatHandle match the pointer tree */
+    bool                    flatValid;
+
+    /** Appends node and its children to flatNode in depth-first order
+        and returns the index of node. */
+    int compactNode(const Node* node) {
+        const int index = flatNode.size();
+        flatNode.next();
+        flatNode[index].splitLocation = node->splitLocation;
+        flatNode[index].splitAxis     = node->splitAxis;
+        flatNode[index].firstHandle   = flatHandle.size();
+        flatNode[index].numHandles    = node->valueArray.size();
+        flatHandle.append(node->valueArray);
+
+        for (int c = 0; c < 2; ++c) {
+            const int childIndex = (node->child[c] == NULL) ? -1 : compactNode(node->child[c]);
+            flatNode[index].child[c] = childIndex;
+        }
+        return index;
+    }
+
+    void invalidateFlat() {
+        if (flatValid) {
+            flatNode.fastClear();
+            flatHandle.fastClear();
+            flatValid = false;
+        }
+    }
+
+    /** Visits every node that may contain a value within
+        sqrt(visitor.maxDistanceSquared()) of visitor.center, nearer
+        children first.  The search radius may shrink during traversal. */
+    template<class Visitor>
+    static void visitNode(const Node* node, Visitor& visitor) {
+        visitor.accept(node->valueArray.getCArray(), node->valueArray.size());
+
+        const float d = visitor.center[node->splitAxis] - node->splitLocation;
+        const int nearChild = (d < 0) ? 0 : 1;
+        if (node->child[nearChild] != NULL) {
+            visitNode(node->child[nearChild], visitor);
+        }
+        if ((node->child[1 - nearChild] != NULL) && (square(d) <= visitor.maxDistanceSquared())) {
+            visitNode(node->child[1 - nearChild], visitor);
+        }
+    }
+
+    /** Same as visitNode, on the compact layout */
+    template<class Visitor>
+    void visitFlatNode(int index, Visitor& visitor) const {
+        const FlatNode& node = flatNode[index];
+        visitor.accept(flatHandle.getCArray() + node.firstHandle, node.numHandles);
+
+        const float d = visitor.center[node.splitAxis] - node.splitLocation;
+        const int nearChild = (d < 0) ? 0 : 1;
+        if (node.child[nearChild] != -1) {
+            visitFlatNode(node.child[nearChild], visitor);
+        }
+        if ((node.child[1 - nearChild] != -1) && (square(d) <= visitor.maxDistanceSquared())) {
+            visitFlatNode(node.child[1 - nearChild], visitor);
+        }
+    }
+
+    template<class Visitor>
+    void visit(Visitor& visitor) const {
+        if (flatValid) {
+            if (flatNode.size() > 0) {
+                visitFlatNode(0, visitor);
+            }
+        } else if (root != NULL) {
+            visitNode(root, visitor);
+        }
+    }
+
+    /** Invokes a callback on every value within a fixed radius */
+    template<class Callback>
+    class SphereVisitor {
+    public:
+        Vector3             center;
+        float               radiusSquared;
+        Callback&           callback;
+
+        SphereVisitor(const Sphere& sphere, Callback& callback) :
+            center(sphere.center), radiusSquared(square(sphere.radius)), callback(callback) {}
+
+        float maxDistanceSquared() const {
+            return radiusSquared;
+        }
+
+        void accept(const Handle* handle, int n) {
+            for (int i = 0; i < n; ++i) {
+                const float d2 = (handle[i].position() - center).squaredLength();
+                if (d2 <= radiusSquared) {
+                    callback(handle[i].value, d2);
+                }
+            }
+        }
+    };
+
+    /** Appends to an array; used to implement getIntersectingMembers(const Sphere&) */
+    class AppendCallback {
+    public:
+        Array<T>&           members;
+
+        AppendCallback(Array<T>& m) : members(m) {}
+
+        void operator()(const T& value, float distanceSquared) {
+            (void)distanceSquared;
+            members.append(value);
+        }
+    };
+
+    /** Maintains the k nearest values seen so far as a max-heap on
+        distance, stored directly in the caller's output arrays. */
+    class KNearestVisitor {
+    public:
+        Vector3             center;
+        int                 k;
+        float               maxRadiusSquared;
+        Array<T>&           value;
+        Array<float>&       distanceSquared;
+
+        KNearestVisitor(const Vector3& c, int k, float maxDistance, Array<T>& v, Array<float>& d) :
+            center(c), k(k), maxRadiusSquared(square(maxDistance)), value(v), distanceSquared(d) {}
+
+        float maxDistanceSquared() const {
+            // Once the heap is full, only values nearer than the
+            // farthest one found so far can be accepted
+            return (value.size() < k) ? maxRadiusSquared : distanceSquared[0];
+        }
+
+        void swap(int i, int j) {
+            std::swap(value[i], value[j]);
+            std::swap(distanceSquared[i], distanceSquared[j]);
+        }
+
+        /** Restores the heap property below i for a heap of length n */
+        void siftDown(int i, int n) {
+            while (true) {
+                int largest = i;
+                const int a = 2 * i + 1;
+                const int b = a + 1;
+                if ((a < n) && (distanceSquared[a] > distanceSquared[largest])) {
+                    largest = a;
+                }
+                if ((b < n) && (distanceSquared[b] > distanceSquared[largest])) {
+                    largest = b;
+                }
+                if (largest == i) {
+                    return;
+                }
+                swap(i, largest);
+                i = largest;
+            }
+        }
+
+        void accept(const Handle* handle, int n) {
+            for (int i = 0; i < n; ++i) {
+                const float d2 = (handle[i].position() - center).squaredLength();
+                if (value.size() < k) {
+                    if (d2 <= maxRadiusSquared) {
+                        // Sift up
+                        int j = value.size();
+                        value.append(handle[i].value);
+                        distanceSquared.append(d2);
+                        while ((j > 0) && (distanceSquared[(j - 1) / 2] < distanceSquared[j])) {
+                            swap(j, (j - 1) / 2);
+                            j = (j - 1) / 2;
+                        }
+                    }
+                } else if (d2 < distanceSquared[0]) {
+                    // Replace the farthest
+                    value[0] = handle[i].value;
+                    distanceSquared[0] = d2;
+                    siftDown(0, k);
+                }
+            }
+        }
+
+        /** Converts the heap into an array sorted by increasing distance */
+        void sort() {
+            for (int n = value.size() - 1; n > 0; --n) {
+                swap(0, n);
+                siftDown(0, n);
+            }
+        }
+    };
+
     /**
      Recursively subdivides the subarray.
 
@@ -564,10 +771,10 @@ public:
 
     /** To construct a balanced tree, insert the elements and then call
       PointKDTree::balance(). */
-    PointKDTree() : root(NULL) {}
+    PointKDTree() : flatValid(false), root(NULL) {}
 
 
-    PointKDTree(const PointKDTree& src) : root(NULL) {
+    PointKDTree(const PointKDTree& src) : flatValid(false), root(NULL) {
         *this = src;
     }
 
@@ -576,6 +783,9 @@ public:
         delete root;
         // Clone tree takes care of filling out the memberTable.
         root = cloneTree(src.root);
+        flatNode   = src.flatNode;
+        flatHandle = src.flatHandle;
+        flatValid  = src.flatValid;
         return *this;
     }
 
@@ -589,6 +799,7 @@ public:
      */
     void clear() {
         memberTable.clear();
+        invalidateFlat();
         delete root;
         root = NULL;
     }
@@ -596,6 +807,7 @@ public:
     /** Removes all elements of the set while maintaining the structure of the tree */
     void clearData() {
         memberTable.clear();
+        invalidateFlat();
         Array<Node*> stack;
         stack.push(root);
         while (stack.size() > 0) {
@@ -627,6 +839,7 @@ public:
         }
 
         Handle h(value);
+        invalidateFlat();
 
         if (root == NULL) {
             // This is the first node; create a root node
@@ -649,6 +862,7 @@ public:
     void insert(const Array<T>& valueArray) {
         // Pre-size the member table to avoid multiple allocations
         memberTable.setSizeHint(valueArray.size() + size());
+        invalidateFlat();
 
         if (root == NULL) {
             // Optimized case for an empty tree; don't bother
@@ -696,6 +910,7 @@ public:
             "Tried to remove an element from a "
             "PointKDTree that was not present");
 
+        invalidateFlat();
         Array<Handle>& list = memberTable[value]->valueArray;
 
         // Find the element and remove it
@@ -747,6 +962,8 @@ public:
      setting a number of <B>mean</B> (average) splits.  numMeanSplits = MAX_INT
      creates a full oct-tree, which tends to optimize peak performance (some areas of the scene will terminate after few recursive splits) at the expense of
      peak performance. 
+
+     Balancing also compacts the tree; see compact().
      */
     void balance(int valuesPerNode = 40, int numMeanSplits = 3) {
         if (root == NULL) {
@@ -771,6 +988,34 @@ public:
 #       ifdef _DEBUG
             root->verifyNode(Vector3::minFinite(), Vector3::maxFinite());
 #       endif
+
+        compact();
+    }
+
+
+    /**
+     Copies the nodes and values into contiguous arrays in depth-first
+     order, which makes kNearest(), forEachMemberInSphere(), and
+     getIntersectingMembers(const Sphere&) substantially faster on large
+     trees.  Called automatically by balance().
+
+     The compact layout stores a second copy of every value and is
+     discarded by the next insert(), remove(), update(), or clear(),
+     after which queries use the slower pointer-based nodes until the
+     tree is compacted again.
+     */
+    void compact() {
+        invalidateFlat();
+        if (root != NULL) {
+            flatHandle.reserve((int)size());
+            compactNode(root);
+        }
+        flatValid = true;
+    }
+
+    /** True if queries are using the layout created by compact() */
+    bool isCompact() const {
+        return flatValid;
     }
 
 private:
@@ -1070,14 +1315,80 @@ public:
       @param members The results are appended to this array.
      */
     void getIntersectingMembers(const Sphere& sphere, Array<T>& members) const {
-        if (root == NULL) {
+        AppendCallback callback(members);
+        forEachMemberInSphere(sphere, callback);
+    }
+
+
+    /**
+      Invokes <code>callback(const T& value, float distanceSquared)</code> for
+      every member within the sphere, in no particular order, without
+      allocating memory.   distanceSquared is the squared distance from
+      the center of the sphere to the member's position.
+
+      Example:
+      \code
+      class Gather {
+      public:
+          Power3 sum;
+          void operator()(const Photon* p, float distanceSquared) { sum += p->power; }
+      };
+
+      Gather g;
+      photonMap.forEachMemberInSphere(Sphere(X, r), g);
+      \endcode
+     */
+    template<class Callback>
+    void forEachMemberInSphere(const Sphere& sphere, Callback& callback) const {
+        SphereVisitor<Callback> visitor(sphere, callback);
+        visit(visitor);
+    }
+
+
+    /**
+      Finds the \a k members nearest to \a point.
+
+      \param members Set to the results, sorted by increasing distance from
+      \a point.  Contains fewer than \a k elements if the tree is smaller or
+      if \a maxDistance excludes some members.
+
+      \param distanceSquared Set to the squared distance from \a point to each
+      element of \a members.  The last element is the search radius needed
+      for density estimation, e.g., in photon mapping.
+
+      \param maxDistance Members farther than this are ignored.  A tight bound
+      makes the search faster.
+
+      Does not allocate memory when \a members and \a distanceSquared already
+      have capacity for \a k elements, so they may be reused across calls.
+     */
+    void kNearest
+    (const Vector3&     point,
+     int                k,
+     Array<T>&          members,
+     Array<float>&      distanceSquared,
+     float              maxDistance = finf()) const {
+
+        members.fastClear();
+        distanceSquared.fastClear();
+        if (k <= 0) {
             return;
         }
 
-        AABox box;
-        sphere.getBounds(box);
-        root->getIntersectingMembers(box, sphere, members);
+        KNearestVisitor visitor(point, k, maxDistance, members, distanceSquared);
+        visit(visitor);
+        visitor.sort();
+    }
+
 
+    /** \copydoc kNearest */
+    void kNearest
+    (const Vector3&     point,
+     int                k,
+     Array<T>&          members,
+     float              maxDistance = finf()) const {
+        Array<float> distanceSquared;
+        kNearest(point, k, members, distanceSquared, maxDistance);
     }
 
 
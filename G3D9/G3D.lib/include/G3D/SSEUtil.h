@@ -0,0 +1,73 @@
+/**
+  \file G3D/SSEUtil.h
+
+  SIMD configuration and parallel image-loop sizes shared by G3D's
+  source files.  Not included by G3D.h.
+
+  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+  \created 2026-10-17
+  \edited  2026-10-17
+
+  Copyright 2000-2012, Morgan McGuire.
+  All rights reserved.
+ */
+#ifndef G3D_SSEUtil_h
+#define G3D_SSEUtil_h
+
+#include "G3D/platform.h"
+
+/** \def G3D_SSE
+    Defined when the SSE intrinsics of xmmintrin.h may be used without
+    a runtime check.  SSE is available on every x86 target that G3D
+    supports, so this is only undefined on other architectures and when
+    the compiler has been told not to use SSE. */
+#if defined(G3D_WIN32) || defined(__SSE__)
+#   define G3D_SSE
+#   include <xmmintrin.h>
+#endif
+
+/** \def G3D_RUNTIME_SIMD
+    Defined when functions marked with G3D_SSE_TARGET,
+    G3D_SSE2_TARGET, G3D_SSSE3_TARGET, or G3D_SSE42_TARGET may use the
+    intrinsics of those instruction sets, regardless of the compiler's
+    command line.  G3D_SSE42_TARGET also enables the PCLMULQDQ
+    carry-less multiply.  Call such a function only after checking
+    System::hasSSE2() and its relatives.  GCC and clang only compile the
+    intrinsics inside functions marked with the target attribute; MSVC
+    compiles them anywhere. */
+#if defined(_MSC_VER) && (_MSC_VER >= 1600) && (defined(_M_IX86) || defined(_M_X64))
+#   define G3D_RUNTIME_SIMD
+#   define G3D_SSE_TARGET
+#   define G3D_SSE2_TARGET
+#   define G3D_SSSE3_TARGET
+#   define G3D_SSE42_TARGET
+#elif (defined(__clang__) || (defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9))))) && \
+      (defined(__i386__) || defined(__x86_64__))
+#   define G3D_RUNTIME_SIMD
+#   define G3D_SSE_TARGET   __attribute__((target("sse")))
+#   define G3D_SSE2_TARGET  __attribute__((target("sse2")))
+#   define G3D_SSSE3_TARGET __attribute__((target("ssse3")))
+#   define G3D_SSE42_TARGET __attribute__((target("sse4.2,pclmul")))
+#endif
+
+#ifdef G3D_RUNTIME_SIMD
+#   include <xmmintrin.h>
+#   include <emmintrin.h>
+#   include <tmmintrin.h>
+#   include <nmmintrin.h>
+#   include <wmmintrin.h>
+#endif
+
+namespace G3D {
+
+/** Below this many pixels, waking the ThreadPool for an image loop
+    costs more than it saves */
+static const int MIN_PARALLEL_PIXELS = 256 * 256;
+
+/** Approximate number of pixels in each task of a parallel image loop */
+static const int PIXELS_PER_TILE = 16 * 1024;
+
+}
+
+#endif
@@ -8,7 +8,7 @@
   \cite Michael Herf http://www.stereopsis.com/memcpy.html
 
   \created 2003-01-25
-  \edited  2010-09-25
+  \edited  2026-10-17
  */
 
 #ifndef G3D_System_h
@@ -104,6 +104,9 @@ private:
     bool           m_hasSSE;
     bool           m_hasSSE2;
     bool           m_hasSSE3;
+    bool           m_hasSSSE3;
+    bool           m_hasSSE42;
+    bool           m_hasPCLMUL;
     bool           m_has3DNOW;
     bool           m_has3DNOW2;
     bool           m_hasAMDMMX;
@@ -209,6 +212,21 @@ public:
         return instance().m_hasSSE3;
     }
 
+    /** True if the processor supports the SSSE3 instructions, including PSHUFB */
+    inline static bool hasSSSE3() {
+        return instance().m_hasSSSE3;
+    }
+
+    /** True if the processor supports the SSE4.2 instructions, including CRC32 */
+    inline static bool hasSSE42() {
+        return instance().m_hasSSE42;
+    }
+
+    /** True if the processor supports the PCLMULQDQ carry-less multiplication instruction */
+    inline static bool hasPCLMUL() {
+        return instance().m_hasPCLMUL;
+    }
+
     inline static bool hasMMX() {
         return instance().m_hasMMX;
     }
@@ -244,13 +262,18 @@ public:
     static std::string currentDateString();
 
     /**
-       Uses pooled storage to optimize small allocations (1 byte to 5
+       Uses pooled storage to optimize small allocations (1 byte to 4
        kilobytes).  Can be 10x to 100x faster than calling ::malloc or
        new.
+
+       Each thread keeps its own free lists, so small allocations
+       usually take no lock, even when many threads allocate at once.
+       Memory may be freed on a different thread than the one that
+       allocated it.
        
        The result must be freed with free.
        
-       Threadsafe on Win32.
+       Threadsafe.
        
        @sa calloc realloc OutOfMemoryCallback free
     */
@@ -269,16 +292,32 @@ public:
     static std::string mallocPerformance();
     static void resetMallocPerformanceCounters();
 
+    /** Number of calls to System::malloc, including those made by
+        calloc, realloc, and alignedMalloc, on the calling thread since
+        it started.  Never reset, so the difference between two calls
+        counts the heap allocations of the code between them. */
+    static int64 mallocCount();
+
     /** 
        Returns a string describing the current usage of the buffer pools used for
        optimizing System::malloc.
      */
     static std::string mallocStatus();
 
+    /**
+     Returns the free blocks cached by the calling thread to the pool
+     shared by all threads and releases the thread's cache.
+
+     G3D::GThread calls this automatically when threadMain() returns.
+     Threads that are created by other means and that use
+     System::malloc should call it before they exit.
+     */
+    static void mallocFlushThreadCache();
+
     /**
      Free data allocated with System::malloc.
 
-     Threadsafe on Win32.
+     Threadsafe.
      */
     static void free(void* p);
 
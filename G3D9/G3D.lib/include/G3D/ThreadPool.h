@@ -0,0 +1,276 @@
+/**
+  \file G3D/ThreadPool.h
+
+  \created 2026-10-17
+  \edited  2026-10-17
+ */
+
+#ifndef G3D_ThreadPool_h
+#define G3D_ThreadPool_h
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/GMutex.h"
+#include "G3D/Vector2int32.h"
+
+namespace G3D {
+
+namespace _internal {
+class ThreadPoolWorker;
+class ThreadPoolSemaphore;
+}
+
+/**
+ \brief A process-wide set of persistent worker threads that execute
+ data-parallel loops.
+
+ The first call to parallelFor() or parallelFor2D() creates
+ System::numCores() - 1 worker threads that live until the program
+ exits.  The calling thread always participates in the loop, so there
+ is no thread creation cost per call.
+
+ The iteration space is divided into tiles of \a grainSize
+ elements.  Each participating thread receives a contiguous band of
+ tiles in its own queue and processes them in order.  When a thread
+ runs out of work it steals half of the remaining tiles from another
+ thread, so loops whose iterations have very different costs stay
+ balanced.
+
+ Only one parallel loop executes on the pool at a time.  A loop
+ started from inside the body of another loop runs serially on the
+ calling thread.
+
+ Example:
+ \code
+ class Blur {
+ public:
+     void filterRow(int y, int threadID) { ... }
+
+     void filterAll() {
+         ThreadPool::parallelFor(0, height, this, &Blur::filterRow);
+     }
+ };
+ \endcode
+
+ \sa G3D::GThread::runConcurrently2D, G3D::ThreadSet
+ */
+class ThreadPool {
+public:
+
+    enum {
+        /** Tells parallelFor() and parallelFor2D() to use every thread in the pool.
+            Equal to GThread::NUM_CORES. */
+        NUM_CORES = -100
+    };
+
+    /** The work performed by a parallel loop.  Subclass this to avoid
+        the per-element member function call of the template versions
+        of parallelFor(). */
+    class Body {
+    public:
+        virtual ~Body() {}
+
+        /** Evaluate every element with <code>start.x <= x < upTo.x</code> and
+            <code>start.y <= y < upTo.y</code>.  Invoked concurrently on
+            disjoint tiles.
+
+            \param threadID In the range [0, maxThreads).  No two concurrent
+            invocations share a threadID, so it may be used to index
+            per-thread state. */
+        virtual void run(const Vector2int32& start, const Vector2int32& upTo, int threadID) = 0;
+    };
+
+private:
+
+    friend class _internal::ThreadPoolWorker;
+    friend class GThread;
+
+    /** Tiles that one participating thread has not yet started.
+        The owner takes from begin; thieves take from end. */
+    class TileQueue {
+    public:
+        Spinlock            lock;
+        int                 begin;
+        int                 end;
+        /** Avoid false sharing between adjacent queues */
+        char                pad[64 - sizeof(Spinlock) - 2 * sizeof(int)];
+
+        TileQueue() : begin(0), end(0) {}
+    };
+
+    /** Evaluates a member function for each element of a tile */
+    template<class Class>
+    class MethodBody : public Body {
+    public:
+        Class*              object;
+        void       (Class::*method1)(int x, int y);
+        void       (Class::*method2)(int x, int y, int threadID);
+
+        MethodBody
+        (Class* object,
+         void (Class::*method1)(int x, int y),
+         void (Class::*method2)(int x, int y, int threadID)) :
+            object(object), method1(method1), method2(method2) {}
+
+        virtual void run(const Vector2int32& start, const Vector2int32& upTo, int threadID) {
+            if (method1) {
+                for (int y = start.y; y < upTo.y; ++y) {
+                    for (int x = start.x; x < upTo.x; ++x) {
+                        (object->*method1)(x, y);
+                    }
+                }
+            } else {
+                for (int y = start.y; y < upTo.y; ++y) {
+                    for (int x = start.x; x < upTo.x; ++x) {
+                        (object->*method2)(x, y, threadID);
+                    }
+                }
+            }
+        }
+    };
+
+    /** Evaluates a member function for each element of a 1D tile */
+    template<class Class>
+    class MethodBody1D : public Body {
+    public:
+        Class*              object;
+        void       (Class::*method)(int i, int threadID);
+
+        MethodBody1D(Class* object, void (Class::*method)(int i, int threadID)) :
+            object(object), method(method) {}
+
+        virtual void run(const Vector2int32& start, const Vector2int32& upTo, int threadID) {
+            for (int i = start.x; i < upTo.x; ++i) {
+                (object->*method)(i, threadID);
+            }
+        }
+    };
+
+    /** Serializes concurrent calls to run() from different threads */
+    GMutex                              m_submitLock;
+
+    Array<_internal::ThreadPoolWorker*> m_worker;
+
+    /** Woken once per worker that should join the current loop */
+    _internal::ThreadPoolSemaphore*     m_wake;
+
+    /** Signalled once by each worker when it leaves the current loop */
+    _internal::ThreadPoolSemaphore*     m_done;
+
+    /** One per participating thread of the current loop */
+    TileQueue*                          m_queue;
+
+    /** Number of threads working on the current loop, including the caller */
+    int                                 m_numParticipants;
+
+    /** Hands out threadIDs to workers as they join the current loop */
+    AtomicInt32                         m_nextThreadID;
+
+    /** Current loop */
+    Body*                               m_body;
+    Vector2int32                        m_start;
+    Vector2int32                        m_upTo;
+    Vector2int32                        m_grainSize;
+    int                                 m_tilesPerRow;
+
+    ThreadPool();
+
+    /** Not implemented on purpose, don't use */
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    static ThreadPool& instance();
+
+    /** Executes tiles, stealing when the local queue runs dry, until
+        no tiles remain in any queue. */
+    void participate(int threadID);
+
+    /** Returns false if there is no work left anywhere */
+    bool takeTile(int threadID, int& tile);
+
+    void runTile(int tile, int threadID);
+
+    void run(Body& body, const Vector2int32& start, const Vector2int32& upTo, const Vector2int32& grainSize, int maxThreads);
+
+public:
+
+    /** Total number of threads that can execute a loop, including the calling thread.*/
+    static int numThreads();
+
+    /**
+       Evaluates \a body on tiles covering <code>start.x <= x < upTo.x</code>,
+       <code>start.y <= y < upTo.y</code> using multiple threads and blocks until
+       all tiles have completed.
+
+       \param grainSize Extent of each tile.  Smaller tiles balance
+       better; larger tiles have less scheduling overhead.  Each
+       tile should represent at least a few microseconds of work.
+
+       \param maxThreads Maximum number of threads to use, including the current one.
+     */
+    static void parallelFor2D
+    (Body&               body,
+     const Vector2int32& start,
+     const Vector2int32& upTo,
+     const Vector2int32& grainSize = Vector2int32(16, 16),
+     int                 maxThreads = NUM_CORES) {
+        instance().run(body, start, upTo, grainSize, maxThreads);
+    }
+
+    /** Evaluates \a object->\a method(\a x, \a y, \a threadID) for every
+        <code>start.x <= x < upTo.x</code> and <code>start.y <= y < upTo.y</code>.
+        Within a tile, iteration is row major. */
+    template<class Class>
+    static void parallelFor2D
+    (const Vector2int32& start,
+     const Vector2int32& upTo,
+     Class*              object,
+     void (Class::*method)(int x, int y, int threadID),
+     const Vector2int32& grainSize = Vector2int32(16, 16),
+     int                 maxThreads = NUM_CORES) {
+        MethodBody<Class> body(object, static_cast<void (Class::*)(int, int)>(NULL), method);
+        instance().run(body, start, upTo, grainSize, maxThreads);
+    }
+
+    /** Evaluates \a object->\a method(\a x, \a y) for every
+        <code>start.x <= x < upTo.x</code> and <code>start.y <= y < upTo.y</code>. */
+    template<class Class>
+    static void parallelFor2D
+    (const Vector2int32& start,
+     const Vector2int32& upTo,
+     Class*              object,
+     void (Class::*method)(int x, int y),
+     const Vector2int32& grainSize = Vector2int32(16, 16),
+     int                 maxThreads = NUM_CORES) {
+        MethodBody<Class> body(object, method, static_cast<void (Class::*)(int, int, int)>(NULL));
+        instance().run(body, start, upTo, grainSize, maxThreads);
+    }
+
+    /** Evaluates \a body on intervals covering <code>start <= i < upTo</code>.
+        The x components of the arguments to Body::run hold the interval. */
+    static void parallelFor
+    (Body&               body,
+     int                 start,
+     int                 upTo,
+     int                 grainSize = 1,
+     int                 maxThreads = NUM_CORES) {
+        instance().run(body, Vector2int32(start, 0), Vector2int32(upTo, 1), Vector2int32(grainSize, 1), maxThreads);
+    }
+
+    /** Evaluates \a object->\a method(\a i, \a threadID) for every <code>start <= i < upTo</code>. */
+    template<class Class>
+    static void parallelFor
+    (int                 start,
+     int                 upTo,
+     Class*              object,
+     void (Class::*method)(int i, int threadID),
+     int                 grainSize = 1,
+     int                 maxThreads = NUM_CORES) {
+        MethodBody1D<Class> body(object, method);
+        instance().run(body, Vector2int32(start, 0), Vector2int32(upTo, 1), Vector2int32(grainSize, 1), maxThreads);
+    }
+};
+
+} // namespace G3D
+
+#endif
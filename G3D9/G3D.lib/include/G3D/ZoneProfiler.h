@@ -0,0 +1,231 @@
+/**
+  \file G3D/ZoneProfiler.h
+
+  \created 2026-10-17
+  \edited  2026-10-17
+
+  Copyright 2000-2012, Morgan McGuire.
+  All rights reserved.
+ */
+#ifndef G3D_ZoneProfiler_h
+#define G3D_ZoneProfiler_h
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/G3DGameUnits.h"
+#include <string>
+
+namespace G3D {
+
+/**
+ \brief Low-overhead, thread-aware CPU profiler for nested zones of code.
+
+ Each zone is registered once by name and then identified by a small
+ integer, so entering and leaving a zone never allocates or compares
+ strings.  Every thread appends timestamped begin/end events to its own
+ fixed-size ring buffer without taking any locks; when a buffer fills,
+ the oldest events are overwritten.  Zones may nest arbitrarily.
+
+ The recorded events can be summarized as a call tree
+ (getStatistics()) or exported in the Chrome trace-event JSON format
+ (saveChromeTrace()) for viewing in chrome://tracing or Perfetto, which
+ shows each thread on its own timeline.  ThreadPool (and therefore
+ GThread::runConcurrently2D) records a zone for each thread's share of
+ every parallel loop.
+
+ Recording is disabled by default; while disabled, a zone costs one
+ branch.  While enabled, each zone appends two events and reads the
+ processor's time stamp counter for each.
+
+ Each thread's ring buffer is allocated when it first records a zone.
+ When a thread exits (see releaseThread()), its buffer is kept so that
+ its events can still be exported, and is reused by the next thread
+ that records a zone, so short-lived threads do not accumulate buffers.
+
+ \code
+ void Scene::update() {
+     G3D_PROFILE_ZONE("Scene::update");
+     ...
+     {
+         G3D_PROFILE_ZONE("Scene::update physics");
+         ...
+     }
+ }
+
+ ZoneProfiler::setEnabled(true);
+ ...
+ ZoneProfiler::saveChromeTrace("trace.json");
+ \endcode
+
+ \sa G3D::Profiler, G3D::Stopwatch
+ */
+class ZoneProfiler {
+public:
+
+    /** Capacity of each thread's ring buffer, in events.  Every zone
+        records two events. */
+    enum {EVENTS_PER_THREAD = 1 << 16};
+
+    /** Aggregated timing for one node of the merged call tree */
+    class Statistics {
+    public:
+        /** Index of the zone, as returned by registerZone() */
+        int             zone;
+
+        /** Name of the zone */
+        std::string     name;
+
+        /** Index of the parent node in the array returned by
+            getStatistics(), or -1 for a root */
+        int             parent;
+
+        /** 0 for roots */
+        int             depth;
+
+        /** Number of times the zone completed in this context */
+        int             count;
+
+        /** Wall-clock time inside the zone, including its children, summed
+            over all threads */
+        RealTime        totalTime;
+
+        /** totalTime minus the totalTime of the children */
+        RealTime        selfTime;
+    };
+
+    /** Enters a zone on construction and leaves it on destruction. */
+    class Scope {
+    private:
+        int             m_zone;
+
+        // Not implemented on purpose, don't use
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+
+    public:
+        explicit Scope(int zone) : m_zone(zone) {
+            ZoneProfiler::begin(zone);
+        }
+
+        /** Registers \a name on first use and stores its ID in \a zone,
+            which must be a static int initialized to -1.  Registration
+            is idempotent, so threads that race here store the same ID. */
+        Scope(volatile int& zone, const char* name) {
+            if (zone < 0) {
+                zone = ZoneProfiler::registerZone(name);
+            }
+            m_zone = zone;
+            ZoneProfiler::begin(m_zone);
+        }
+
+        ~Scope() {
+            ZoneProfiler::end(m_zone);
+        }
+    };
+
+    /** Returns the ID for \a name, registering it if necessary.  Calling
+        this again with the same name and category returns the same ID.
+        Threadsafe, but takes a lock; call once per zone and store the
+        result (G3D_PROFILE_ZONE does this automatically).
+
+        \param category Used by trace viewers to filter events. */
+    static int registerZone(const std::string& name, const std::string& category = "G3D");
+
+    /** Name that registerZone() was called with */
+    static std::string zoneName(int zone);
+
+private:
+
+    /** Read on every zone edge, so the check is inlined into callers */
+    static volatile bool s_enabled;
+
+    static void record(int zone, uint32 isEnd);
+
+public:
+
+    /** Enters \a zone on the current thread */
+    static void begin(int zone) {
+        if (s_enabled) {
+            record(zone, 0);
+        }
+    }
+
+    /** Leaves the innermost zone on the current thread, which must be \a zone */
+    static void end(int zone) {
+        if (s_enabled) {
+            record(zone, 1);
+        }
+    }
+
+    /** Returns the calling thread's ring buffer for reuse by a later
+        thread.  The thread's events remain visible until then.
+
+        G3D::GThread calls this automatically when threadMain() returns.
+        Threads that are created by other means and that record zones
+        should call it before they exit. */
+    static void releaseThread();
+
+    /** Names the current thread in exported traces.  The default name is
+        "Thread N", in the order that threads first record a zone. */
+    static void setThreadName(const std::string& name);
+
+    static bool enabled();
+
+    /** Starting and stopping recording does not discard events.  Zones
+        that are open when recording stops appear unfinished. */
+    static void setEnabled(bool e);
+
+    /** Discards all events recorded so far.  Zones that are open on any
+        thread when this is called appear unstarted in later exports. */
+    static void clear();
+
+    /** Replays the recorded events of every thread and merges them into a
+        single call tree, listed in depth-first order. */
+    static void getStatistics(Array<Statistics>& stats);
+
+    /** Returns the recorded events in the Chrome trace-event JSON format */
+    static std::string chromeTrace();
+
+    /** Writes chromeTrace() to \a filename */
+    static void saveChromeTrace(const std::string& filename);
+};
+
+} // namespace G3D
+
+#define G3D_ZONE_CONCAT2(a, b) a##b
+#define G3D_ZONE_CONCAT(a, b) G3D_ZONE_CONCAT2(a, b)
+
+/** \def G3D_PROFILE_ZONE
+    Records the rest of the enclosing block as a zone of the ZoneProfiler.
+    \a name must be the same every time the statement executes.
+
+    The zone ID is a constant-initialized static, so unlike a static with
+    a dynamic initializer it is safe to reach from several threads at once
+    on compilers without thread-safe local statics (e.g., MSVC 2010). */
+#define G3D_PROFILE_ZONE(name) \
+    static volatile int G3D_ZONE_CONCAT(g3dZoneID, __LINE__) = -1; \
+    ::G3D::ZoneProfiler::Scope G3D_ZONE_CONCAT(g3dZoneScope, __LINE__)(G3D_ZONE_CONCAT(g3dZoneID, __LINE__), name)
+
+/** \def G3D_DEFINE_PROFILE_ZONE
+    Defines a namespace-scope static zone ID named \a id, registered
+    during static initialization.  Use with G3D_PROFILE_ZONE_ID on paths
+    where even the first-use check of G3D_PROFILE_ZONE matters.
+
+    \code
+    G3D_DEFINE_PROFILE_ZONE(updateZone, "Scene::update");
+
+    void Scene::update() {
+        G3D_PROFILE_ZONE_ID(updateZone);
+        ...
+    }
+    \endcode */
+#define G3D_DEFINE_PROFILE_ZONE(id, name) \
+    static const int id = ::G3D::ZoneProfiler::registerZone(name)
+
+/** \def G3D_PROFILE_ZONE_ID
+    Records the rest of the enclosing block as the zone \a id, defined
+    by G3D_DEFINE_PROFILE_ZONE. */
+#define G3D_PROFILE_ZONE_ID(id) \
+    ::G3D::ZoneProfiler::Scope G3D_ZONE_CONCAT(g3dZoneScope, __LINE__)(id)
+
+#endif
@@ -353,6 +353,20 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE hPrev, LPSTR szCmdLine, int sw) {\
 #    define G3D_END_PACKED_CLASS(byteAlign)  ;
 #endif
 
+/** \def G3D_THREAD_LOCAL
+    Declares a static or global variable of POD type (e.g., an int or pointer)
+    that has a separate copy on each thread.
+
+    \code
+    static G3D_THREAD_LOCAL int depth = 0;
+    \endcode
+*/
+#ifdef _MSC_VER
+#    define G3D_THREAD_LOCAL __declspec(thread)
+#else
+#    define G3D_THREAD_LOCAL __thread
+#endif
+
 
 
 // Define to disable FFMPEG.  This is a temporary feature while we debug the Windows 64-bit build 
@@ -0,0 +1,75 @@
+/**
+  \file G3D/radixSort.h
+
+  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+  \created 2026-10-17
+  \edited  2026-10-17
+*/
+#ifndef G3D_radixSort_h
+#define G3D_radixSort_h
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+
+namespace G3D {
+
+/** \brief A 64-bit key and the index of the element that it orders.
+
+    Build an array of these for the objects to be sorted, radixSort()
+    it, and then visit the objects by index.  This avoids copying or
+    comparing the objects themselves.
+
+    \sa radixSort, floatSortKey */
+class SortKey {
+public:
+    uint64          key;
+    int             index;
+
+    SortKey() {}
+
+    SortKey(uint64 k, int i) : key(k), index(i) {}
+
+    inline bool operator<(const SortKey& other) const {
+        return key < other.key;
+    }
+
+    inline bool operator>(const SortKey& other) const {
+        return key > other.key;
+    }
+};
+
+
+/** \brief Maps \a f to an unsigned integer whose order matches the
+    order of the floats, so that floats can be radix sorted or packed
+    into the bits of a SortKey.
+
+    -0 sorts before +0.  NaN sorts beyond the infinities, on the side
+    of its sign bit. */
+inline uint32 floatSortKey(float f) {
+    union {
+        float       f;
+        uint32      u;
+    } bits;
+    bits.f = f;
+
+    // Negative floats are in reverse order, and all precede the positive ones
+    return (bits.u & 0x80000000) ? ~bits.u : (bits.u | 0x80000000);
+}
+
+
+/** \brief Stable least-significant-digit radix sort of \a array into
+    increasing order of SortKey::key.
+
+    Runs in linear time: one pass to histogram all eight bytes of the
+    keys, and then one scatter pass for each byte.  Bytes that are
+    the same for every key are skipped, so keys that only use their
+    low 32 bits cost half as much to sort as full 64-bit ones.  Small
+    arrays use an insertion sort.
+
+    The scratch buffer is allocated from FrameMemoryManager::current(). */
+void radixSort(Array<SortKey>& array);
+
+} // namespace G3D
+
+#endif
@@ -4,7 +4,7 @@
   \maintainer Morgan McGuire, http://graphics.cs.williams.edu
 
   \created 2011-06-10
-  \edited  2011-06-10
+  \edited  2026-10-17
 
   Copyright 2000-2012, Morgan McGuire.
   All rights reserved.
@@ -29,9 +29,18 @@ namespace G3D {
  Array< Array<Surface::Ref> > derivedArray;
  categorizeByDerivedType<Surface::Ref>(all, derivedArray);
  \endcode
+
+ The subarrays use the same MemoryManager as \a derivedArray.
+
+ \param tableMemoryManager Allocates the temporary table of types.
+ Callers that are already using FrameMemoryManager::current() for \a
+ derivedArray should pass it here as well.
  */
 template<class PointerType>
-void categorizeByDerivedType(const Array<PointerType>& all, Array< Array<PointerType> >& derivedArray) {
+void categorizeByDerivedType
+(const Array<PointerType>&      all,
+ Array< Array<PointerType> >&   derivedArray,
+ const MemoryManager::Ref&      tableMemoryManager = AreaMemoryManager::create(100 * 1024)) {
     derivedArray.fastClear();
 
     // Allocate space for the worst case, so that we don't have to copy arrays
@@ -39,9 +48,7 @@ void categorizeByDerivedType(const Array<PointerType>& all, Array< Array<Pointer
     derivedArray.reserve(all.size());
 
     Table<std::type_info *const, int> typeInfoToIndex;
-    // Allocate the table elements in a memory area that can be cleared all at once
-    // without invoking destructors.
-    typeInfoToIndex.clearAndSetMemoryManager(AreaMemoryManager::create(100 * 1024));
+    typeInfoToIndex.clearAndSetMemoryManager(tableMemoryManager);
 
     for (int s = 0; s < all.size(); ++s) {
         const PointerType& instance = all[s];
@@ -52,7 +59,7 @@ void categorizeByDerivedType(const Array<PointerType>& all, Array< Array<Pointer
             // This is the first time that we've encountered this subclass.
             // Allocate the next element of subclassArray to hold it.
             index = derivedArray.size();
-            derivedArray.next();
+            derivedArray.next().clearAndSetMemoryManager(derivedArray.memoryManager());
         }
         derivedArray[index].append(instance);
     }
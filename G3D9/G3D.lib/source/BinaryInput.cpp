@@ -5,7 +5,7 @@
  Copyright 2001-2007, Morgan McGuire.  All rights reserved.
  
  @created 2001-08-09
- @edited  2010-03-05
+ @edited  2026-10-17
 
 
   <PRE>
@@ -112,7 +112,8 @@ BinaryInput::BinaryInput(
 BinaryInput::BinaryInput
 (const std::string&  filename,
  G3DEndian           fileEndian,
- bool                compressed) :
+ bool                compressed,
+ MemoryMappedFile::AccessHint access) :
     m_filename(filename),
     m_bitPos(0),
     m_bitString(0),
@@ -132,40 +133,42 @@ BinaryInput::BinaryInput
         FileSystem::markFileUsed(m_filename);
         FileSystem::markFileUsed(zipfile);
 
-        // Zipfiles require Unix-style slashes
-        std::string internalFile = FilePath::canonicalize(m_filename.substr(zipfile.length() + 1));
-        struct zip* z = zip_open(zipfile.c_str(), ZIP_CHECKCONS, NULL);
-        {
-            struct zip_stat info;
-            zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-            zip_stat(z, internalFile.c_str(), ZIP_FL_NOCASE, &info);
-            m_bufferLength = m_length = info.size;
-            // sets machines up to use MMX, if they want
-            m_buffer = reinterpret_cast<uint8*>(System::alignedMalloc(m_length, 16));
-            struct zip_file* zf = zip_fopen( z, internalFile.c_str(), ZIP_FL_NOCASE );
-            if (zf == NULL) {
-                throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
-            } else {
-                const int64 bytesRead = zip_fread( zf, m_buffer, m_length );
-                debugAssertM(bytesRead == m_length,
-                             internalFile + " was corrupt because it unzipped to the wrong size.");
-                (void)bytesRead;
-                zip_fclose( zf );
-            }
-        }
-        zip_close( z );
+        FileSystem::readFromZipfile(m_filename, zipfile, m_buffer, m_length, m_mappedFile);
+        m_bufferLength = m_length;
+
+        // Uncompressed files inside zipfiles are read in place from the mapped zipfile
+        m_freeBuffer = m_mappedFile.isNull();
 
         if (compressed) {
             decompress();
         }
 
-        m_freeBuffer = true;
         return;
     }
 
     // Figure out how big the file is and verify that it exists.
     m_length = FileSystem::size(m_filename);
 
+    if (m_length >= MIN_MAPPED_LENGTH) {
+        // Read in place from the page cache.  If mapping fails (e.g., the
+        // file is larger than the address space), fall back to reading
+        // chunks into a heap buffer.
+        m_mappedFile = MemoryMappedFile::create(m_filename, access);
+        if (m_mappedFile.notNull() && (m_mappedFile->size() == m_length)) {
+            FileSystem::markFileUsed(m_filename);
+            m_buffer = const_cast<uint8*>(m_mappedFile->data());
+            m_bufferLength = m_length;
+            m_freeBuffer = false;
+
+            if (compressed) {
+                // Inflate directly from the mapping
+                decompress();
+            }
+            return;
+        }
+        m_mappedFile = NULL;
+    }
+
     // Read the file into memory
     FILE* file = FileSystem::fopen(m_filename.c_str(), "rb");
 
@@ -247,7 +250,13 @@ void BinaryInput::decompress() {
     debugAssertM(result == Z_OK, "BinaryInput/zlib detected corruption in " + m_filename); 
     (void)result;
     
-    System::alignedFree(tempBuffer);
+    if (m_freeBuffer) {
+        System::alignedFree(tempBuffer);
+    }
+
+    // The decompressed buffer is always owned
+    m_freeBuffer = true;
+    m_mappedFile = NULL;
 }
 
 
@@ -609,14 +618,25 @@ IMPLEMENT_READER(Int8,    int8)
 #undef IMPLEMENT_READER
 
 
+/** Reverses the bytes of each of the n elements of size S at data */
+template<int S>
+static void swapBytesInPlace(void* data, int64 n) {
+    uint8* p = (uint8*)data;
+    for (int64 i = 0; i < n; ++i, p += S) {
+        for (int j = 0; j < S / 2; ++j) {
+            const uint8 t = p[j];
+            p[j] = p[S - 1 - j];
+            p[S - 1 - j] = t;
+        }
+    }
+}
+
+
 #define IMPLEMENT_READER(ucase, lcase)\
 void BinaryInput::read##ucase(lcase* out, int64 n) {\
+    readBytes(out, sizeof(lcase) * n);\
     if (m_swapBytes) {\
-        for (int64 i = 0; i < n; ++i) {\
-            out[i] = read##ucase();\
-        }\
-    } else {\
-        readBytes(out, sizeof(lcase) * n);\
+        swapBytesInPlace<sizeof(lcase)>(out, n);\
     }\
 }
 
@@ -632,5 +652,40 @@ IMPLEMENT_READER(Float64, float64)
 
 #undef IMPLEMENT_READER
 
+
+#ifdef G3D_ALLOW_UNALIGNED_WRITES
+#   define G3D_VIEW_IS_ALIGNED(ptr, lcase) true
+#else
+#   define G3D_VIEW_IS_ALIGNED(ptr, lcase) ((uintptr_t(ptr) % sizeof(lcase)) == 0)
+#endif
+
+#define IMPLEMENT_VIEW(ucase, lcase)\
+const lcase* BinaryInput::view##ucase(int64 n, Array<lcase>& scratch) {\
+    const int64 bytes = sizeof(lcase) * n;\
+    prepareToRead(bytes);\
+    const lcase* ptr = (const lcase*)(m_buffer + m_pos);\
+    if (((sizeof(lcase) == 1) || ! m_swapBytes) && G3D_VIEW_IS_ALIGNED(ptr, lcase)) {\
+        m_pos += bytes;\
+        return ptr;\
+    } else {\
+        read##ucase(scratch, n);\
+        return scratch.getCArray();\
+    }\
+}
+
+IMPLEMENT_VIEW(UInt8,   uint8)
+IMPLEMENT_VIEW(Int8,    int8)
+IMPLEMENT_VIEW(UInt16,  uint16)
+IMPLEMENT_VIEW(Int16,   int16)
+IMPLEMENT_VIEW(UInt32,  uint32)
+IMPLEMENT_VIEW(Int32,   int32)
+IMPLEMENT_VIEW(UInt64,  uint64)
+IMPLEMENT_VIEW(Int64,   int64)
+IMPLEMENT_VIEW(Float32, float32)
+IMPLEMENT_VIEW(Float64, float64)
+
+#undef IMPLEMENT_VIEW
+#undef G3D_VIEW_IS_ALIGNED
+
 } // namespace G3D
 
@@ -11,7 +11,6 @@
 #include "G3D/platform.h"
 #include "G3D/Crypto.h"
 #include "G3D/g3dmath.h"
-#include <zlib.h>
 
 namespace G3D {
     
@@ -63,9 +62,4 @@ int Crypto::numSmallPrimes() {
     return 303;
 }
 
-uint32 Crypto::crc32(const void* byte, size_t numBytes) {
-    alwaysAssertM(numBytes < 0xFFFFFFFF, "Not implemented for arrays larger than 2^32 bytes");
-    return ::crc32(::crc32(0, Z_NULL, 0), static_cast<const Bytef *>(byte), (int)numBytes);
-}
-
 } // G3D
@@ -0,0 +1,585 @@
+/**
+ \file Crypto_hash.cpp
+
+ CRC32, CRC32C, and 128-bit hashing, with hardware and multithreaded paths.
+
+ \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+ \created 2026-10-17
+ \edited  2026-10-17
+ */
+
+#include "G3D/platform.h"
+#include "G3D/Crypto.h"
+#include "G3D/BinaryInput.h"
+#include "G3D/BinaryOutput.h"
+#include "G3D/ThreadPool.h"
+#include "G3D/format.h"
+#include "G3D/SSEUtil.h"
+#include <cstring>
+#include <zlib.h>
+
+namespace G3D {
+
+Hash128::Hash128(class BinaryInput& b) {
+    deserialize(b);
+}
+
+
+void Hash128::deserialize(class BinaryInput& b) {
+    value[0] = b.readUInt64();
+    value[1] = b.readUInt64();
+}
+
+
+void Hash128::serialize(class BinaryOutput& b) const {
+    b.writeUInt64(value[0]);
+    b.writeUInt64(value[1]);
+}
+
+
+std::string Hash128::toString() const {
+    return format("%08x%08x%08x%08x",
+                  uint32(value[0] >> 32), uint32(value[0]),
+                  uint32(value[1] >> 32), uint32(value[1]));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CRC
+
+/** Reversed CRC-32C (Castagnoli) polynomial */
+static const uint32 CRC32C_POLYNOMIAL = 0x82F63B78;
+
+/** Reversed CRC-32 (IEEE 802.3) polynomial */
+static const uint32 CRC32_POLYNOMIAL  = 0xEDB88320;
+
+/** Slicing-by-8 tables for the software CRC32C.  Entry [k][b] is the CRC
+    of byte b followed by k zero bytes. */
+class CRC32CTable {
+public:
+    uint32 table[8][256];
+
+    CRC32CTable() {
+        for (int b = 0; b < 256; ++b) {
+            uint32 c = b;
+            for (int i = 0; i < 8; ++i) {
+                c = (c & 1) ? ((c >> 1) ^ CRC32C_POLYNOMIAL) : (c >> 1);
+            }
+            table[0][b] = c;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (int b = 0; b < 256; ++b) {
+                const uint32 c = table[k - 1][b];
+                table[k][b] = (c >> 8) ^ table[0][c & 0xFF];
+            }
+        }
+    }
+};
+
+static const CRC32CTable crc32cTable;
+
+
+static uint32 crc32cSoftware(const uint8* p, size_t n, uint32 crc) {
+    const uint32 (*t)[256] = crc32cTable.table;
+    crc = ~crc;
+    while (n >= 8) {
+        const uint32 a = crc ^ (uint32(p[0]) | (uint32(p[1]) << 8) | (uint32(p[2]) << 16) | (uint32(p[3]) << 24));
+        crc = t[7][a & 0xFF] ^ t[6][(a >> 8) & 0xFF] ^ t[5][(a >> 16) & 0xFF] ^ t[4][a >> 24] ^
+              t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+        p += 8;
+        n -= 8;
+    }
+    while (n > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+        ++p;
+        --n;
+    }
+    return ~crc;
+}
+
+
+#ifdef G3D_RUNTIME_SIMD
+
+G3D_SSE42_TARGET static uint32 crc32cHardware(const uint8* p, size_t n, uint32 crc) {
+    crc = ~crc;
+    while ((n > 0) && ((size_t(p) & 7) != 0)) {
+        crc = _mm_crc32_u8(crc, *p);
+        ++p;
+        --n;
+    }
+
+#   ifdef G3D_64BIT
+    uint64 c = crc;
+    while (n >= 8) {
+        c = _mm_crc32_u64(c, *reinterpret_cast<const uint64*>(p));
+        p += 8;
+        n -= 8;
+    }
+    crc = uint32(c);
+#   else
+    while (n >= 4) {
+        crc = _mm_crc32_u32(crc, *reinterpret_cast<const uint32*>(p));
+        p += 4;
+        n -= 4;
+    }
+#   endif
+
+    while (n > 0) {
+        crc = _mm_crc32_u8(crc, *p);
+        ++p;
+        --n;
+    }
+    return ~crc;
+}
+
+
+/**
+ CRC32 of \a n bytes, where n >= 64 and is a multiple of 16, by folding
+ four 128-bit lanes with carry-less multiplication and a final Barrett
+ reduction.  \a crc is the internal (inverted) state.
+
+ \cite Gopal et al., Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction, Intel 2009
+ */
+G3D_SSE42_TARGET static uint32 crc32Fold(const uint8* p, size_t n, uint32 crc) {
+    // x^(4*128+32) mod P, x^(4*128-32) mod P, etc., bit-reflected
+    static const uint64 k1k2[] = {0x0154442bd4ULL, 0x01c6e41596ULL};
+    static const uint64 k3k4[] = {0x01751997d0ULL, 0x00ccaa009eULL};
+    static const uint64 k5k0[] = {0x0163cd6124ULL, 0x0000000000ULL};
+    static const uint64 poly[] = {0x01db710641ULL, 0x01f7011641ULL};
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(int(crc)));
+    x0 = _mm_loadu_si128((const __m128i*)k1k2);
+    p += 64;
+    n -= 64;
+
+    // Fold 64 bytes at a time
+    while (n >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        p += 64;
+        n -= 64;
+    }
+
+    // Fold the four lanes into one
+    x0 = _mm_loadu_si128((const __m128i*)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Fold the remaining 16-byte blocks
+    while (n >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)p);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        p += 16;
+        n -= 16;
+    }
+
+    // 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_loadu_si128((const __m128i*)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return uint32(_mm_extract_epi32(x1, 1));
+}
+
+#endif
+
+
+uint32 Crypto::crc32(const void* bytes, size_t numBytes, uint32 crc) {
+    const uint8* p = static_cast<const uint8*>(bytes);
+
+#   ifdef G3D_RUNTIME_SIMD
+    if ((numBytes >= 64) && System::hasPCLMUL() && System::hasSSE42()) {
+        const size_t n = numBytes & ~size_t(15);
+        crc = ~crc32Fold(p, n, ~crc);
+        p += n;
+        numBytes -= n;
+    }
+#   endif
+
+    // zlib takes a 32-bit length
+    while (numBytes > 0) {
+        const uInt n = uInt(G3D::min(numBytes, size_t(1) << 30));
+        crc = uint32(::crc32(crc, static_cast<const Bytef*>(p), n));
+        p += n;
+        numBytes -= n;
+    }
+    return crc;
+}
+
+
+uint32 Crypto::crc32c(const void* bytes, size_t numBytes, uint32 crc) {
+    const uint8* p = static_cast<const uint8*>(bytes);
+#   ifdef G3D_RUNTIME_SIMD
+    if (System::hasSSE42()) {
+        return crc32cHardware(p, numBytes, crc);
+    }
+#   endif
+    return crc32cSoftware(p, numBytes, crc);
+}
+
+
+/** Multiplies the 32x32 GF(2) matrix \a mat by \a vec */
+static uint32 gf2MatrixTimes(const uint32* mat, uint32 vec) {
+    uint32 sum = 0;
+    while (vec != 0) {
+        if ((vec & 1) != 0) {
+            sum ^= *mat;
+        }
+        vec >>= 1;
+        ++mat;
+    }
+    return sum;
+}
+
+
+static void gf2MatrixSquare(uint32* square, const uint32* mat) {
+    for (int n = 0; n < 32; ++n) {
+        square[n] = gf2MatrixTimes(mat, mat[n]);
+    }
+}
+
+
+/** Computes the GF(2) matrix that appends \a length zero bytes to a CRC,
+    by repeated squaring of the one-zero-bit operator.  After zlib's
+    crc32_combine.  Appending n zero bytes to the CRC of A and then adding
+    the CRC of an n-byte B gives the CRC of AB. */
+static void crcZerosOperator(uint32 polynomial, uint64 length, uint32* op) {
+    uint32 power[32];
+    uint32 temp[32];
+
+    // The operator for one zero bit, then two, four, and eight
+    power[0] = polynomial;
+    for (int n = 1; n < 32; ++n) {
+        power[n] = uint32(1) << (n - 1);
+    }
+    gf2MatrixSquare(temp, power);
+    gf2MatrixSquare(power, temp);
+    gf2MatrixSquare(temp, power);
+    System::memcpy(power, temp, sizeof(power));
+
+    // Identity
+    for (int n = 0; n < 32; ++n) {
+        op[n] = uint32(1) << n;
+    }
+
+    while (length != 0) {
+        if ((length & 1) != 0) {
+            for (int n = 0; n < 32; ++n) {
+                temp[n] = gf2MatrixTimes(power, op[n]);
+            }
+            System::memcpy(op, temp, sizeof(temp));
+        }
+        length >>= 1;
+
+        if (length != 0) {
+            gf2MatrixSquare(temp, power);
+            System::memcpy(power, temp, sizeof(temp));
+        }
+    }
+}
+
+
+static uint32 crcCombine(uint32 polynomial, uint32 crcA, uint32 crcB, uint64 lengthB) {
+    if (lengthB == 0) {
+        return crcA;
+    }
+    uint32 op[32];
+    crcZerosOperator(polynomial, lengthB, op);
+    return gf2MatrixTimes(op, crcA) ^ crcB;
+}
+
+
+uint32 Crypto::crc32Combine(uint32 crcA, uint32 crcB, uint64 lengthB) {
+    return crcCombine(CRC32_POLYNOMIAL, crcA, crcB, lengthB);
+}
+
+
+uint32 Crypto::crc32cCombine(uint32 crcA, uint32 crcB, uint64 lengthB) {
+    return crcCombine(CRC32C_POLYNOMIAL, crcA, crcB, lengthB);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// MurmurHash3
+
+static inline uint64 rotl64(uint64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+
+static inline uint64 fmix64(uint64 k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+
+Hash128 Crypto::hash128(const void* bytes, size_t numBytes, uint64 seed) {
+    // MurmurHash3_x64_128 by Austin Appleby, placed in the public domain
+    static const uint64 c1 = 0x87c37b91114253d5ULL;
+    static const uint64 c2 = 0x4cf5ad432745937fULL;
+
+    const uint8* p = static_cast<const uint8*>(bytes);
+    const size_t numBlocks = numBytes / 16;
+
+    uint64 h1 = seed;
+    uint64 h2 = seed;
+
+    for (size_t i = 0; i < numBlocks; ++i, p += 16) {
+        uint64 k1, k2;
+        memcpy(&k1, p, 8);
+        memcpy(&k2, p + 8, 8);
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    uint64 k1 = 0;
+    uint64 k2 = 0;
+
+    switch (numBytes & 15) {
+    case 15: k2 ^= uint64(p[14]) << 48;
+    case 14: k2 ^= uint64(p[13]) << 40;
+    case 13: k2 ^= uint64(p[12]) << 32;
+    case 12: k2 ^= uint64(p[11]) << 24;
+    case 11: k2 ^= uint64(p[10]) << 16;
+    case 10: k2 ^= uint64(p[ 9]) << 8;
+    case  9: k2 ^= uint64(p[ 8]);
+             k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+
+    case  8: k1 ^= uint64(p[ 7]) << 56;
+    case  7: k1 ^= uint64(p[ 6]) << 48;
+    case  6: k1 ^= uint64(p[ 5]) << 40;
+    case  5: k1 ^= uint64(p[ 4]) << 32;
+    case  4: k1 ^= uint64(p[ 3]) << 24;
+    case  3: k1 ^= uint64(p[ 2]) << 16;
+    case  2: k1 ^= uint64(p[ 1]) << 8;
+    case  1: k1 ^= uint64(p[ 0]);
+             k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= uint64(numBytes);
+    h2 ^= uint64(numBytes);
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    return Hash128(h1, h2);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Parallel
+
+namespace _internal {
+
+/** Hashes each HASH_CHUNK_SIZE chunk of a memory range on ThreadPool */
+class ChunkHasher {
+public:
+    enum Function {CRC32, CRC32C, HASH128};
+
+    Function        function;
+    const uint8*    data;
+    size_t          numBytes;
+
+    /** Per-chunk results, for CRC32 and CRC32C */
+    uint32*         crc;
+
+    /** Per-chunk results, for HASH128 */
+    Hash128*        hash;
+
+    ChunkHasher(Function f, const uint8* d, size_t n, uint32* c, Hash128* h) :
+        function(f), data(d), numBytes(n), crc(c), hash(h) {}
+
+    static int numChunks(size_t numBytes) {
+        return int((numBytes + Crypto::HASH_CHUNK_SIZE - 1) / Crypto::HASH_CHUNK_SIZE);
+    }
+
+    size_t chunkLength(int i) const {
+        return G3D::min(size_t(Crypto::HASH_CHUNK_SIZE), numBytes - size_t(i) * Crypto::HASH_CHUNK_SIZE);
+    }
+
+    void hashChunk(int i, int threadID) {
+        (void)threadID;
+        const uint8* p = data + size_t(i) * Crypto::HASH_CHUNK_SIZE;
+        const size_t n = chunkLength(i);
+        switch (function) {
+        case CRC32:
+            crc[i] = Crypto::crc32(p, n);
+            break;
+
+        case CRC32C:
+            crc[i] = Crypto::crc32c(p, n);
+            break;
+
+        case HASH128:
+            hash[i] = Crypto::hash128(p, n);
+            break;
+        }
+    }
+
+    void run(int maxThreads) {
+        ThreadPool::parallelFor(0, numChunks(numBytes), this, &ChunkHasher::hashChunk, 1, maxThreads);
+    }
+};
+
+
+/** Continues the CRC \a crc of the preceding data over \a numBytes more */
+static uint32 parallelCRC(ChunkHasher::Function function, uint32 crc, const uint8* data, size_t numBytes, int maxThreads) {
+    if (numBytes <= size_t(Crypto::HASH_CHUNK_SIZE)) {
+        return (function == ChunkHasher::CRC32) ? Crypto::crc32(data, numBytes, crc) : Crypto::crc32c(data, numBytes, crc);
+    }
+
+    Array<uint32> chunkCRC;
+    chunkCRC.resize(ChunkHasher::numChunks(numBytes));
+    ChunkHasher hasher(function, data, numBytes, chunkCRC.getCArray(), NULL);
+    hasher.run(maxThreads);
+
+    // Every chunk but the last has the same length, so build the
+    // operator that appends a chunk's worth of zeros once
+    const uint32 polynomial = (function == ChunkHasher::CRC32) ? CRC32_POLYNOMIAL : CRC32C_POLYNOMIAL;
+    uint32 op[32];
+    crcZerosOperator(polynomial, Crypto::HASH_CHUNK_SIZE, op);
+
+    for (int i = 0; i < chunkCRC.size() - 1; ++i) {
+        crc = gf2MatrixTimes(op, crc) ^ chunkCRC[i];
+    }
+    return crcCombine(polynomial, crc, chunkCRC.last(), hasher.chunkLength(chunkCRC.size() - 1));
+}
+
+
+/** Appends the hashes of each chunk of \a data to \a chunkHash */
+static void parallelChunkHash(const uint8* data, size_t numBytes, int maxThreads, Array<Hash128>& chunkHash) {
+    const int first = chunkHash.size();
+    chunkHash.resize(first + ChunkHasher::numChunks(numBytes));
+    ChunkHasher hasher(ChunkHasher::HASH128, data, numBytes, NULL, chunkHash.getCArray() + first);
+    if (numBytes <= size_t(Crypto::HASH_CHUNK_SIZE)) {
+        if (numBytes > 0) {
+            hasher.hashChunk(0, 0);
+        }
+    } else {
+        hasher.run(maxThreads);
+    }
+}
+
+
+static Hash128 rootHash(const Array<Hash128>& chunkHash, uint64 numBytes) {
+    if (chunkHash.size() == 0) {
+        return Crypto::hash128(NULL, 0);
+    } else if (chunkHash.size() == 1) {
+        return chunkHash[0];
+    } else {
+        // Distinguish the root from a leaf with the same contents by seeding with the total length
+        return Crypto::hash128(chunkHash.getCArray(), sizeof(Hash128) * chunkHash.size(), numBytes);
+    }
+}
+
+
+/** Bytes of a BinaryInput processed at once; a multiple of HASH_CHUNK_SIZE */
+static const int64 BLOCK_SIZE = 64 * Crypto::HASH_CHUNK_SIZE;
+
+static uint32 parallelCRC(ChunkHasher::Function function, BinaryInput& b, int maxThreads) {
+    uint32 crc = 0;
+    Array<uint8> scratch;
+    while (b.getPosition() < b.size()) {
+        const int64 n = G3D::min(b.size() - b.getPosition(), BLOCK_SIZE);
+        crc = parallelCRC(function, crc, b.viewUInt8(n, scratch), size_t(n), maxThreads);
+    }
+    return crc;
+}
+
+} // namespace _internal
+
+
+uint32 Crypto::parallelCRC32(const void* bytes, size_t numBytes, int maxThreads) {
+    return _internal::parallelCRC(_internal::ChunkHasher::CRC32, 0, static_cast<const uint8*>(bytes), numBytes, maxThreads);
+}
+
+
+uint32 Crypto::parallelCRC32(BinaryInput& b, int maxThreads) {
+    return _internal::parallelCRC(_internal::ChunkHasher::CRC32, b, maxThreads);
+}
+
+
+uint32 Crypto::parallelCRC32C(const void* bytes, size_t numBytes, int maxThreads) {
+    return _internal::parallelCRC(_internal::ChunkHasher::CRC32C, 0, static_cast<const uint8*>(bytes), numBytes, maxThreads);
+}
+
+
+uint32 Crypto::parallelCRC32C(BinaryInput& b, int maxThreads) {
+    return _internal::parallelCRC(_internal::ChunkHasher::CRC32C, b, maxThreads);
+}
+
+
+Hash128 Crypto::parallelHash128(const void* bytes, size_t numBytes, int maxThreads) {
+    Array<Hash128> chunkHash;
+    _internal::parallelChunkHash(static_cast<const uint8*>(bytes), numBytes, maxThreads, chunkHash);
+    return _internal::rootHash(chunkHash, numBytes);
+}
+
+
+Hash128 Crypto::parallelHash128(BinaryInput& b, int maxThreads) {
+    Array<Hash128> chunkHash;
+    Array<uint8> scratch;
+    const uint64 numBytes = uint64(b.size() - b.getPosition());
+    while (b.getPosition() < b.size()) {
+        const int64 n = G3D::min(b.size() - b.getPosition(), _internal::BLOCK_SIZE);
+        _internal::parallelChunkHash(b.viewUInt8(n, scratch), size_t(n), maxThreads, chunkHash);
+    }
+    return _internal::rootHash(chunkHash, numBytes);
+}
+
+} // namespace G3D
@@ -4,7 +4,7 @@
  \author Morgan McGuire, http://graphics.cs.williams.edu
  
  \author  2002-06-06
- \edited  2010-10-10
+ \edited  2026-10-17
  */
 #include "G3D/FileSystem.h"
 #include "G3D/System.h"
@@ -13,6 +13,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include "zip.h"
+#include <zlib.h>
 #include "G3D/g3dfnmatch.h"
 #include "G3D/BinaryInput.h"
 #include "G3D/BinaryOutput.h"
@@ -63,6 +64,293 @@ void FileSystem::cleanup() {
 
 FileSystem::FileSystem() : m_cacheLifetime(10) {}
 
+
+FileSystem::~FileSystem() {
+    for (Table<std::string, Zipfile*>::Iterator it = m_zipfileCache.begin(); it.isValid(); ++it) {
+        delete it->value;
+    }
+    m_zipfileCache.clear();
+}
+
+/////////////////////////////////////////////////////////////
+
+/** Zipfiles store all integers in little-endian order, with no alignment */
+static inline uint32 readZipUInt16(const uint8* p) {
+    return uint32(p[0]) | (uint32(p[1]) << 8);
+}
+
+
+static inline uint32 readZipUInt32(const uint8* p) {
+    return uint32(p[0]) | (uint32(p[1]) << 8) | (uint32(p[2]) << 16) | (uint32(p[3]) << 24);
+}
+
+
+FileSystem::Zipfile::~Zipfile() {
+    if (z != NULL) {
+        zip_close(z);
+        z = NULL;
+    }
+}
+
+
+bool FileSystem::Zipfile::open(const std::string& filename) {
+    mapping = MemoryMappedFile::create(filename);
+
+    if (mapping.isNull() || ! parseDirectory()) {
+        // Fall back to libzip for building the index
+        mapping = NULL;
+        entry.clear();
+
+        z = zip_open(filename.c_str(), ZIP_CHECKCONS, NULL);
+        if (z == NULL) {
+            return false;
+        }
+
+        const int count = zip_get_num_files(z);
+        entry.resize(count);
+        for (int i = 0; i < count; ++i) {
+            struct zip_stat info;
+            zip_stat_init(&info);
+            zip_stat_index(z, i, ZIP_FL_NOCASE, &info);
+
+            ZipfileEntry& e = entry[i];
+            e.name           = info.name;
+            e.size           = info.size;
+            e.compressedSize = info.comp_size;
+            e.method         = info.comp_method;
+            e.headerOffset   = -1;
+        }
+    }
+
+    index.clear();
+    for (int i = 0; i < entry.size(); ++i) {
+        bool created = false;
+        int& j = index.getCreate(toLower(FilePath::canonicalize(entry[i].name)), created);
+        if (created) {
+            // If there are duplicate names, libzip finds the first
+            j = i;
+        }
+    }
+
+    return true;
+}
+
+
+bool FileSystem::Zipfile::parseDirectory() {
+    const uint8* data   = mapping->data();
+    const int64  length = mapping->size();
+
+    // The end of central directory record is 22 bytes, followed by
+    // a comment of up to 64 kB.  Search backwards for its signature.
+    int64 end = -1;
+    for (int64 i = length - 22; (i >= 0) && (i >= length - 22 - 0xFFFF); --i) {
+        if (readZipUInt32(data + i) == 0x06054b50) {
+            end = i;
+            break;
+        }
+    }
+    if (end == -1) {
+        return false;
+    }
+
+    const int   count  = readZipUInt16(data + end + 10);
+    const int64 size   = readZipUInt32(data + end + 12);
+    int64       offset = readZipUInt32(data + end + 16);
+
+    if ((count == 0xFFFF) || (offset == 0xFFFFFFFF) || (offset + size > end)) {
+        // Zip64 or a prefixed (e.g., self-extracting) archive
+        return false;
+    }
+
+    entry.resize(count);
+    for (int i = 0; i < count; ++i) {
+        const uint8* header = data + offset;
+        if ((offset + 46 > end) || (readZipUInt32(header) != 0x02014b50)) {
+            return false;
+        }
+
+        const uint32 flags          = readZipUInt16(header + 8);
+        const int    nameLength     = readZipUInt16(header + 28);
+        const int    extraLength    = readZipUInt16(header + 30);
+        const int    commentLength  = readZipUInt16(header + 32);
+
+        // The lengths come from the file; reject a truncated or corrupt directory
+        const int64  next           = offset + 46 + nameLength + extraLength + commentLength;
+        if (next > end) {
+            return false;
+        }
+
+        ZipfileEntry& e = entry[i];
+        e.method         = readZipUInt16(header + 10);
+        e.compressedSize = readZipUInt32(header + 20);
+        e.size           = readZipUInt32(header + 24);
+        e.headerOffset   = readZipUInt32(header + 42);
+        e.name.assign((const char*)header + 46, nameLength);
+
+        const bool encrypted = (flags & 1) != 0;
+        const bool zip64     = (e.size == 0xFFFFFFFF) || (e.compressedSize == 0xFFFFFFFF) || 
+                               (e.headerOffset == 0xFFFFFFFF);
+        if (encrypted || zip64 || ((e.method != ZIP_CM_STORE) && (e.method != ZIP_CM_DEFLATE))) {
+            e.headerOffset = -1;
+        }
+
+        offset = next;
+    }
+
+    return true;
+}
+
+
+const FileSystem::ZipfileEntry* FileSystem::Zipfile::find(const std::string& name) const {
+    const int* i = index.getPointer(toLower(FilePath::canonicalize(name)));
+    return (i == NULL) ? NULL : &entry[*i];
+}
+
+
+FileSystem::Zipfile* FileSystem::getZipfile(const std::string& path) {
+    const std::string& key = 
+#   if defined(G3D_WIN32)
+        FilePath::canonicalize(FilePath::removeTrailingSlash(toLower(FilePath::canonicalize(_resolve(path)))));
+#   else
+        FilePath::canonicalize(FilePath::removeTrailingSlash(FilePath::canonicalize(_resolve(path))));
+#   endif
+
+    const RealTime now = System::time();
+    Zipfile** cached = m_zipfileCache.getPointer(key);
+    if ((cached != NULL) && (now <= (*cached)->lastChecked + m_cacheLifetime)) {
+        return *cached;
+    }
+
+    struct stat64 st;
+    const bool exists = (stat64(key.c_str(), &st) != -1);
+
+    if (cached != NULL) {
+        Zipfile* z = *cached;
+        if (exists && (z->modified == int64(st.st_mtime)) && (z->fileSize == int64(st.st_size))) {
+            z->lastChecked = now;
+            return z;
+        }
+
+        // The zipfile changed or was removed.  Readers still holding its
+        // mapping keep the old contents alive.
+        delete z;
+        m_zipfileCache.remove(key);
+    }
+
+    if (! exists) {
+        return NULL;
+    }
+
+    Zipfile* z = new Zipfile();
+    if (! z->open(key)) {
+        delete z;
+        return NULL;
+    }
+    z->modified    = st.st_mtime;
+    z->fileSize    = st.st_size;
+    z->lastChecked = now;
+    m_zipfileCache.set(key, z);
+
+    return z;
+}
+
+
+void FileSystem::readFromZipfile
+(const std::string&     path, 
+ const std::string&     zipfile, 
+ uint8*&                data, 
+ int64&                 length, 
+ MemoryMappedFile::Ref& mapping) {
+
+    data    = NULL;
+    length  = 0;
+    mapping = NULL;
+
+    // Zipfiles require Unix-style slashes
+    const std::string& internalFile = FilePath::canonicalize(path.substr(zipfile.length() + 1));
+
+    // Find the entry while holding the lock, but decompress after releasing it
+    ZipfileEntry          e;
+    MemoryMappedFile::Ref m;
+
+    mutex.lock();
+    {
+        Zipfile* z = instance().getZipfile(zipfile);
+        const ZipfileEntry* found = (z == NULL) ? NULL : z->find(internalFile);
+        if (found == NULL) {
+            mutex.unlock();
+            throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
+        }
+
+        if ((found->headerOffset == -1) || z->mapping.isNull()) {
+            // Read through libzip, which shares one file handle per zipfile
+            if (z->z == NULL) {
+                z->z = zip_open(FilePath::removeTrailingSlash(zipfile).c_str(), ZIP_CHECKCONS, NULL);
+            }
+            struct zip_file* zf = (z->z == NULL) ? NULL : zip_fopen_index(z->z, int(found - z->entry.getCArray()), 0);
+            if (zf == NULL) {
+                mutex.unlock();
+                throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
+            }
+
+            length = found->size;
+            data = (uint8*)System::alignedMalloc(length, 16);
+            const int64 bytesRead = zip_fread(zf, data, length);
+            debugAssertM(bytesRead == length,
+                         internalFile + " was corrupt because it unzipped to the wrong size.");
+            (void)bytesRead;
+            zip_fclose(zf);
+            mutex.unlock();
+            return;
+        }
+
+        e = *found;
+        m = z->mapping;
+    }
+    mutex.unlock();
+
+    // Skip the local header, whose name and extra field lengths may differ from the central directory's
+    const uint8* header = m->data() + e.headerOffset;
+    int64 start = -1;
+    if ((e.headerOffset + 30 <= m->size()) && (readZipUInt32(header) == 0x04034b50)) {
+        start = e.headerOffset + 30 + readZipUInt16(header + 26) + readZipUInt16(header + 28);
+    }
+    if ((start == -1) || (start + e.compressedSize > m->size())) {
+        throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" is corrupt.";
+    }
+
+    length = e.size;
+    if (e.method == ZIP_CM_STORE) {
+        // Zero copy
+        data    = const_cast<uint8*>(m->data() + start);
+        mapping = m;
+        return;
+    }
+
+    data = (uint8*)System::alignedMalloc(max(length, int64(1)), 16);
+
+    // Raw deflate stream (no zlib header)
+    z_stream stream;
+    System::memset(&stream, 0, sizeof(stream));
+    stream.next_in   = const_cast<Bytef*>(m->data() + start);
+    stream.avail_in  = uInt(e.compressedSize);
+    stream.next_out  = data;
+    stream.avail_out = uInt(length);
+
+    bool ok = (inflateInit2(&stream, -MAX_WBITS) == Z_OK);
+    if (ok) {
+        ok = (inflate(&stream, Z_FINISH) == Z_STREAM_END) && (int64(stream.total_out) == length);
+        inflateEnd(&stream);
+    }
+
+    if (! ok) {
+        System::alignedFree(data);
+        data   = NULL;
+        length = 0;
+        throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" is corrupt.";
+    }
+}
+
 /////////////////////////////////////////////////////////////
 
 bool FileSystem::Dir::contains(const std::string& f, bool caseSensitive) const {
@@ -80,20 +368,17 @@ bool FileSystem::Dir::contains(const std::string& f, bool caseSensitive) const {
 }
 
     
-void FileSystem::Dir::computeZipListing(const std::string& zipfile, const std::string& _pathInsideZipfile) {
+void FileSystem::Dir::computeZipListing(const Zipfile* zipfile, const std::string& _pathInsideZipfile) {
+    if (zipfile == NULL) {
+        return;
+    }
+
     const std::string& pathInsideZipfile = FilePath::canonicalize(_pathInsideZipfile);
-    struct zip* z = zip_open( FilePath::removeTrailingSlash(zipfile).c_str(), ZIP_CHECKCONS, NULL );
-    debugAssert(z);
 
-    int count = zip_get_num_files( z );
     Set<std::string> alreadyAdded;
-    for (int i = 0; i < count; ++i) {
-        struct zip_stat info;
-        zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-        zip_stat_index( z, i, ZIP_FL_NOCASE, &info );
-        
+    for (int i = 0; i < zipfile->entry.size(); ++i) {
         // Fully-qualified name of a file inside zipfile
-        std::string name = FilePath::canonicalize(info.name);
+        std::string name = FilePath::canonicalize(zipfile->entry[i].name);
 
         if (beginsWith(name, pathInsideZipfile)) {
             // We found something inside the directory we were looking for,
@@ -128,9 +413,6 @@ void FileSystem::Dir::computeZipListing(const std::string& zipfile, const std::s
             }
         }
     }
-    
-    zip_close(z);
-    z = NULL;
 }
 
 
@@ -232,14 +514,14 @@ FileSystem::Dir& FileSystem::getContents(const std::string& path, bool forceUpda
             if (exists && isZipfile(path)) {
                 // This is a zipfile; get its root
                 dir.isZipfile = true;                
-                dir.computeZipListing(path, "");
+                dir.computeZipListing(getZipfile(path), "");
 
             } else if (inZipfile(path, zip)) {
 
                 // There is a zipfile somewhere in the path.  Does
                 // the rest of the path exist inside the zipfile?
                 dir.inZipfile = true;
-                dir.computeZipListing(zip, path.substr(zip.length() + 1));
+                dir.computeZipListing(getZipfile(zip), path.substr(zip.length() + 1));
             }
         }        
     }
@@ -336,6 +618,11 @@ void FileSystem::_clearCache(const std::string& _path) {
 
     if ((path == "") || FilePath::isRoot(path)) {
         m_cache.clear();
+
+        for (Table<std::string, Zipfile*>::Iterator it = m_zipfileCache.begin(); it.isValid(); ++it) {
+            delete it->value;
+        }
+        m_zipfileCache.clear();
     } else {
         Array<std::string> keys;
         m_cache.getKeys(keys);
@@ -354,6 +641,16 @@ void FileSystem::_clearCache(const std::string& _path) {
                 m_cache.remove(keys[k]);
             }
         }
+
+        keys.fastClear();
+        m_zipfileCache.getKeys(keys);
+        for (int k = 0; k < keys.size(); ++k) {
+            const std::string& key = keys[k];
+            if ((key == prefix) || beginsWith(key, prefixSlash)) {
+                delete m_zipfileCache[key];
+                m_zipfileCache.remove(key);
+            }
+        }
     }
 }
 
@@ -581,22 +878,11 @@ int64 FileSystem::_size(const std::string& _filename) {
     int result = stat64(filename.c_str(), &st);
     
     if (result == -1) {
-        std::string zip, contents;
-        if (zipfileExists(filename, zip, contents)) {
-            int64 requiredMem;
-            
-            struct zip *z = zip_open( zip.c_str(), ZIP_CHECKCONS, NULL );
-            debugAssertM(z != NULL, zip + ": zip open failed.");
-            {
-                struct zip_stat info;
-                zip_stat_init( &info );    // Docs unclear if zip_stat_init is required.
-                int success = zip_stat( z, contents.c_str(), ZIP_FL_NOCASE, &info );
-                (void) success;
-                debugAssertM(success == 0, zip + ": " + contents + ": zip stat failed.");
-                requiredMem = info.size;
-            }
-            zip_close(z);
-            return requiredMem;
+        std::string zip;
+        if (_inZipfile(filename, zip)) {
+            const Zipfile* z = getZipfile(zip);
+            const ZipfileEntry* e = (z == NULL) ? NULL : z->find(filename.substr(zip.length() + 1));
+            return (e == NULL) ? -1 : e->size;
         } else {
             return -1;
         }
@@ -606,6 +892,23 @@ int64 FileSystem::_size(const std::string& _filename) {
 }
 
 
+int64 FileSystem::_lastModified(const std::string& _filename) {
+    const std::string& filename = FilePath::canonicalize(FilePath::expandEnvironmentVariables(_filename));
+
+    struct stat64 st;
+    if (stat64(filename.c_str(), &st) != -1) {
+        return st.st_mtime;
+    }
+
+    std::string zip;
+    if (_inZipfile(filename, zip) && _exists(filename) && (stat64(zip.c_str(), &st) != -1)) {
+        return st.st_mtime;
+    }
+
+    return -1;
+}
+
+
 void FileSystem::listHelper
 (const std::string&  shortSpec,
  const std::string&  parentPath, 
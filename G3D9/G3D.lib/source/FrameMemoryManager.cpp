@@ -0,0 +1,176 @@
+/**
+ \file FrameMemoryManager.cpp
+
+ \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+ \created 2026-10-17
+ \edited  2026-10-17
+
+ Copyright 2000-2012, Morgan McGuire.
+ All rights reserved.
+ */
+
+#include "G3D/FrameMemoryManager.h"
+#include "G3D/System.h"
+#include "G3D/debugAssert.h"
+#include <stdlib.h>
+
+namespace G3D {
+
+/** The calling thread's arena.  A pointer to a heap-allocated Ref
+    because thread-local variables cannot have constructors. */
+static G3D_THREAD_LOCAL FrameMemoryManager::Ref* currentFrameMemoryManager = NULL;
+
+
+FrameMemoryManager::Ref FrameMemoryManager::current() {
+    if (currentFrameMemoryManager == NULL) {
+        currentFrameMemoryManager = new FrameMemoryManager::Ref(new FrameMemoryManager(64 * 1024));
+    }
+    return *currentFrameMemoryManager;
+}
+
+
+FrameMemoryManager::FrameMemoryManager(size_t blockSize) :
+    m_block(NULL),
+    m_numBlocks(0),
+    m_maxBlocks(0),
+    m_currentBlock(0),
+    m_used(0),
+    m_usedBefore(0),
+    m_blockSize(blockSize),
+    m_liveAllocations(0),
+    m_inFrame(false),
+    m_frameStartMallocCount(0) {
+}
+
+
+FrameMemoryManager::~FrameMemoryManager() {
+    debugAssertM(m_liveAllocations == 0, "FrameMemoryManager destroyed with live allocations");
+    for (int b = 0; b < m_numBlocks; ++b) {
+        System::alignedFree(m_block[b].data);
+    }
+    ::free(m_block);
+}
+
+
+bool FrameMemoryManager::isThreadsafe() const {
+    return false;
+}
+
+
+size_t FrameMemoryManager::capacity() const {
+    size_t total = 0;
+    for (int b = 0; b < m_numBlocks; ++b) {
+        total += m_block[b].size;
+    }
+    return total;
+}
+
+
+void FrameMemoryManager::addBlock(size_t s) {
+    if (m_numBlocks == m_maxBlocks) {
+        m_maxBlocks = max(8, m_maxBlocks * 2);
+        m_block = (Block*)::realloc(m_block, sizeof(Block) * m_maxBlocks);
+        alwaysAssertM(m_block != NULL, "Out of memory");
+    }
+
+    Block& block = m_block[m_numBlocks];
+    block.size = max(s, m_blockSize);
+    block.data = (uint8*)System::alignedMalloc(block.size, ALIGNMENT);
+    alwaysAssertM(block.data != NULL, "Out of memory");
+    ++m_numBlocks;
+}
+
+
+void* FrameMemoryManager::alloc(size_t s) {
+    // Round up so that every allocation stays aligned
+    s = (s + ALIGNMENT - 1) & ~size_t(ALIGNMENT - 1);
+
+    if ((m_numBlocks == 0) || (m_used + s > m_block[m_currentBlock].size)) {
+        // Move to the next block that is large enough, skipping the
+        // remainder of this one
+        if (m_numBlocks > 0) {
+            m_usedBefore += m_block[m_currentBlock].size;
+            ++m_currentBlock;
+        }
+        while ((m_currentBlock < m_numBlocks) && (m_block[m_currentBlock].size < s)) {
+            m_usedBefore += m_block[m_currentBlock].size;
+            ++m_currentBlock;
+        }
+        if (m_currentBlock == m_numBlocks) {
+            addBlock(s);
+        }
+        m_used = 0;
+    }
+
+    void* ptr = m_block[m_currentBlock].data + m_used;
+    m_used += s;
+
+    ++m_liveAllocations;
+    ++m_frameStats.allocations;
+    m_frameStats.bytes += s;
+    m_frameStats.peakBytes = max(m_frameStats.peakBytes, m_usedBefore + m_used);
+
+    return ptr;
+}
+
+
+void FrameMemoryManager::free(void* x) {
+    if (x == NULL) {
+        return;
+    }
+
+    debugAssertM(m_liveAllocations > 0, "FrameMemoryManager::free called more times than alloc");
+    --m_liveAllocations;
+    if (m_liveAllocations == 0) {
+        rewind();
+    }
+}
+
+
+void FrameMemoryManager::rewind() {
+    if (m_numBlocks > 1) {
+        // Replace the blocks with one that holds all of them, so that
+        // the same sequence of allocations fits without growing
+        const size_t total = capacity();
+        for (int b = 0; b < m_numBlocks; ++b) {
+            System::alignedFree(m_block[b].data);
+        }
+        m_numBlocks = 0;
+        addBlock(total);
+    }
+
+    m_currentBlock = 0;
+    m_used         = 0;
+    m_usedBefore   = 0;
+}
+
+
+void FrameMemoryManager::beginFrame() {
+    debugAssertM(! m_inFrame, "Mismatched calls to FrameMemoryManager::beginFrame/endFrame");
+    m_inFrame = true;
+    m_frameStats = Stats();
+    m_frameStartMallocCount = System::mallocCount();
+}
+
+
+FrameMemoryManager::Stats FrameMemoryManager::frameStats() const {
+    Stats s = m_frameStats;
+    s.heapAllocations = int(System::mallocCount() - m_frameStartMallocCount);
+    return s;
+}
+
+
+void FrameMemoryManager::endFrame() {
+    debugAssertM(m_inFrame, "Mismatched calls to FrameMemoryManager::beginFrame/endFrame");
+    m_inFrame = false;
+    m_lastFrameStats = frameStats();
+
+    debugAssertM(m_liveAllocations == 0,
+                 "Memory from FrameMemoryManager::current() was not freed before the end of the frame");
+    if (m_liveAllocations == 0) {
+        rewind();
+    }
+}
+
+}
@@ -4,7 +4,7 @@
   \author Morgan McGuire, http://graphics.cs.williams.edu
  
   \created 2005-07-20
-  \edited  2012-07-08
+  \edited  2026-10-17
 */
 #include "G3D/GCamera.h"
 #include "G3D/platform.h"
@@ -15,6 +15,7 @@
 #include "G3D/Matrix4.h"
 #include "G3D/Any.h"
 #include "G3D/stringutils.h"
+#include "G3D/FrameMemoryManager.h"
 
 namespace G3D {
 
@@ -442,7 +443,10 @@ void GCamera::getClipPlanes(
     const Rect2D&       viewport,
     Array<Plane>&       clip) const {
 
+    // The frustum is only needed for this call
     Frustum fr;
+    fr.vertexPos.clearAndSetMemoryManager(FrameMemoryManager::current());
+    fr.faceArray.clearAndSetMemoryManager(FrameMemoryManager::current());
     frustum(viewport, fr);
     clip.resize(fr.faceArray.size(), DONT_SHRINK_UNDERLYING_ARRAY);
     for (int f = 0; f < clip.size(); ++f) {
@@ -4,13 +4,14 @@
  GThread class.
 
  @created 2005-09-24
- @edited  2010-09-22
+ @edited  2026-10-17
  */
 
 #include "G3D/GThread.h"
 #include "G3D/System.h"
 #include "G3D/debugAssert.h"
 #include "G3D/GMutex.h"
+#include "G3D/ZoneProfiler.h"
 
 namespace G3D {
 
@@ -170,6 +171,8 @@ DWORD WINAPI GThread::internalThreadProc(LPVOID param) {
     debugAssert(current->m_event);
     current->m_status = STATUS_RUNNING;
     current->threadMain();
+    System::mallocFlushThreadCache();
+    ZoneProfiler::releaseThread();
     current->m_status = STATUS_COMPLETED;
     ::SetEvent(current->m_event);
     return 0;
@@ -179,6 +182,8 @@ void* GThread::internalThreadProc(void* param) {
     GThread* current = reinterpret_cast<GThread*>(param);
     current->m_status = STATUS_RUNNING;
     current->threadMain();
+    System::mallocFlushThreadCache();
+    ZoneProfiler::releaseThread();
     current->m_status = STATUS_COMPLETED;
     return (void*)NULL;
 }
@@ -4,7 +4,7 @@
  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
  
  \created 2003-05-23
- \edited  2012-02-26
+ \edited  2026-10-17
  */
 
 #include "GLG3D/glheaders.h"
@@ -429,13 +429,17 @@ const ImageFormat* ImageFormat::fromCode(ImageFormat::Code code) {
         return ImageFormat::RGBA32UI();
 
     case ImageFormat::CODE_BAYER_RGGB8:
-        // TODO
+        return ImageFormat::BAYER_RGGB8();
+
     case ImageFormat::CODE_BAYER_GRBG8:
-        // TODO
+        return ImageFormat::BAYER_GRBG8();
+
     case ImageFormat::CODE_BAYER_GBRG8:
-        // TODO
+        return ImageFormat::BAYER_GBRG8();
+
     case ImageFormat::CODE_BAYER_BGGR8:
-        // TODO
+        return ImageFormat::BAYER_BGGR8();
+
     case ImageFormat::CODE_BAYER_RGGB32F:
         // TODO
     case ImageFormat::CODE_BAYER_GRBG32F:
@@ -647,9 +651,9 @@ DEFINE_TEXTUREFORMAT_METHOD(R16F,       1, UNCOMP_FORMAT,   GL_R16F,
 
 DEFINE_TEXTUREFORMAT_METHOD(RG16F,      2, UNCOMP_FORMAT,   GL_RG16F,           GL_RG,     0,  0,  16, 16,  0,  0,  0, 32, 32,      GL_FLOAT, OPAQUE_FORMAT, FLOATING_POINT_FORMAT, ImageFormat::CODE_RG16F, ImageFormat::COLOR_SPACE_RGB);
 
-DEFINE_TEXTUREFORMAT_METHOD(R32F,       1, UNCOMP_FORMAT,   GL_R32F,            GL_R,      0,  0,  32, 0,  0,  0,  0, 16, 16,       GL_FLOAT, OPAQUE_FORMAT, FLOATING_POINT_FORMAT, ImageFormat::CODE_R32F, ImageFormat::COLOR_SPACE_RGB);
+DEFINE_TEXTUREFORMAT_METHOD(R32F,       1, UNCOMP_FORMAT,   GL_R32F,            GL_R,      0,  0,  32, 0,  0,  0,  0, 32, 32,       GL_FLOAT, OPAQUE_FORMAT, FLOATING_POINT_FORMAT, ImageFormat::CODE_R32F, ImageFormat::COLOR_SPACE_RGB);
 
-DEFINE_TEXTUREFORMAT_METHOD(RG32F,      2, UNCOMP_FORMAT,   GL_RG32F,           GL_RG,     0,  0,  32, 32,  0,  0,  0, 16, 16,      GL_FLOAT, OPAQUE_FORMAT, FLOATING_POINT_FORMAT, ImageFormat::CODE_RG32F, ImageFormat::COLOR_SPACE_RGB);
+DEFINE_TEXTUREFORMAT_METHOD(RG32F,      2, UNCOMP_FORMAT,   GL_RG32F,           GL_RG,     0,  0,  32, 32,  0,  0,  0, 64, 64,      GL_FLOAT, OPAQUE_FORMAT, FLOATING_POINT_FORMAT, ImageFormat::CODE_RG32F, ImageFormat::COLOR_SPACE_RGB);
 
 DEFINE_TEXTUREFORMAT_METHOD(RGB5,       3, UNCOMP_FORMAT,   GL_RGB5,            GL_RGBA,    0,  0,  5,  5,  5,  0,  0, 16, 16,      GL_UNSIGNED_BYTE, OPAQUE_FORMAT, NORMALIZED_FIXED_POINT_FORMAT, ImageFormat::CODE_RGB5, ImageFormat::COLOR_SPACE_RGB);
 
@@ -743,4 +747,15 @@ DEFINE_TEXTUREFORMAT_METHOD(YUV420_PLANAR,  3, UNCOMP_FORMAT,   GL_NONE,    GL_N
 DEFINE_TEXTUREFORMAT_METHOD(YUV422,         3, UNCOMP_FORMAT,   GL_NONE,    GL_NONE, 0, 0, 0, 0, 0, 0, 0, 16, 16,  GL_UNSIGNED_BYTE, OPAQUE_FORMAT, NORMALIZED_FIXED_POINT_FORMAT, ImageFormat::CODE_YUV422, ImageFormat::COLOR_SPACE_YUV);
 DEFINE_TEXTUREFORMAT_METHOD(YUV444,         3, UNCOMP_FORMAT,   GL_NONE,    GL_NONE, 0, 0, 0, 0, 0, 0, 0, 24, 24,  GL_UNSIGNED_BYTE, OPAQUE_FORMAT, NORMALIZED_FIXED_POINT_FORMAT, ImageFormat::CODE_YUV444, ImageFormat::COLOR_SPACE_YUV);
 
+#define DEFINE_BAYER_FORMAT_METHOD(enumname, pattern)                                                                                   \
+    const ImageFormat* ImageFormat::enumname() {                                                                                           \
+        static const ImageFormat format(1, UNCOMP_FORMAT, GL_NONE, GL_NONE, 0, 0, 0, 0, 0, 0, 0, 8, 8, GL_UNSIGNED_BYTE, OPAQUE_FORMAT,     \
+                                        NORMALIZED_FIXED_POINT_FORMAT, ImageFormat::CODE_##enumname, ImageFormat::COLOR_SPACE_RGB, pattern); \
+    return &format; }
+
+DEFINE_BAYER_FORMAT_METHOD(BAYER_RGGB8, BAYER_PATTERN_RGGB);
+DEFINE_BAYER_FORMAT_METHOD(BAYER_GRBG8, BAYER_PATTERN_GRBG);
+DEFINE_BAYER_FORMAT_METHOD(BAYER_GBRG8, BAYER_PATTERN_GBRG);
+DEFINE_BAYER_FORMAT_METHOD(BAYER_BGGR8, BAYER_PATTERN_BGGR);
+
 }
@@ -5,13 +5,20 @@
 #include "G3D/Color1.h"
 #include "G3D/Color3.h"
 #include "G3D/Color4.h"
-
+#include "G3D/ThreadPool.h"
+#include "G3D/SSEUtil.h"
 
 namespace G3D {
 
 // this is the signature for all conversion routines (same parameters as ImageFormat::convert)
 typedef void (*ConvertFunc)(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg);
 
+// this is the signature for conversion routines in which each output row
+// depends only on the same input row.  convert() applies these to every
+// row itself, handling padding and invertY, and splits large images
+// across threads.
+typedef void (*RowConvertFunc)(const void* src, void* dst, int width);
+
 // this defines the conversion routines for converting between compatible formats
 static const int NUM_CONVERT_IMAGE_FORMATS = 5;
 struct ConvertAttributes {
@@ -21,31 +28,39 @@ struct ConvertAttributes {
     bool                m_handlesSourcePadding;
     bool                m_handlesDestPadding;
     bool                m_handleInvertY;
+
+    /** If non-NULL, used instead of m_converter */
+    RowConvertFunc      m_rowConverter;
 };
 
 // forward declare the converters we can use them below
 #define DECLARE_CONVERT_FUNC(name) static void name(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg);
-
-DECLARE_CONVERT_FUNC(l8_to_rgb8);
-DECLARE_CONVERT_FUNC(l32f_to_rgb8);
-DECLARE_CONVERT_FUNC(rgb8_to_rgba8);
-DECLARE_CONVERT_FUNC(rgb8_to_bgr8);
-DECLARE_CONVERT_FUNC(rgb8_to_rgba32f);
-DECLARE_CONVERT_FUNC(bgr8_to_rgb8);
-DECLARE_CONVERT_FUNC(bgr8_to_rgba8);
-DECLARE_CONVERT_FUNC(bgr8_to_rgba32f);
-DECLARE_CONVERT_FUNC(rgba8_to_rgb8);
-DECLARE_CONVERT_FUNC(rgba8_to_bgr8);
-DECLARE_CONVERT_FUNC(rgba8_to_rgba32f);
-DECLARE_CONVERT_FUNC(rgb32f_to_rgba32f);
-DECLARE_CONVERT_FUNC(rgba32f_to_rgb8);
-DECLARE_CONVERT_FUNC(rgba32f_to_rgba8);
-DECLARE_CONVERT_FUNC(rgba32f_to_bgr8);
-DECLARE_CONVERT_FUNC(rgba32f_to_rgb32f);
+#define DECLARE_ROW_CONVERT_FUNC(name) static void name(const void* src, void* dst, int width);
+
+DECLARE_ROW_CONVERT_FUNC(l8_to_rgb8);
+DECLARE_ROW_CONVERT_FUNC(l32f_to_rgb8);
+DECLARE_ROW_CONVERT_FUNC(rgb8_to_rgba8);
+DECLARE_ROW_CONVERT_FUNC(rgb8_to_bgr8);
+DECLARE_ROW_CONVERT_FUNC(rgb8_to_rgba32f);
+DECLARE_ROW_CONVERT_FUNC(bgr8_to_rgb8);
+DECLARE_ROW_CONVERT_FUNC(bgr8_to_rgba8);
+DECLARE_ROW_CONVERT_FUNC(bgr8_to_rgba32f);
+DECLARE_ROW_CONVERT_FUNC(rgba8_to_rgb8);
+DECLARE_ROW_CONVERT_FUNC(rgba8_to_bgr8);
+DECLARE_ROW_CONVERT_FUNC(rgba8_to_rgba32f);
+DECLARE_ROW_CONVERT_FUNC(rgb32f_to_rgba32f);
+DECLARE_ROW_CONVERT_FUNC(rgba32f_to_rgb8);
+DECLARE_ROW_CONVERT_FUNC(rgba32f_to_rgba8);
+DECLARE_ROW_CONVERT_FUNC(rgba32f_to_bgr8);
+DECLARE_ROW_CONVERT_FUNC(rgba32f_to_rgb32f);
 DECLARE_CONVERT_FUNC(rgba32f_to_bayer_rggb8);
 DECLARE_CONVERT_FUNC(rgba32f_to_bayer_gbrg8);
 DECLARE_CONVERT_FUNC(rgba32f_to_bayer_grbg8);
 DECLARE_CONVERT_FUNC(rgba32f_to_bayer_bggr8);
+DECLARE_CONVERT_FUNC(bayer_rggb8_to_rgb8);
+DECLARE_CONVERT_FUNC(bayer_gbrg8_to_rgb8);
+DECLARE_CONVERT_FUNC(bayer_grbg8_to_rgb8);
+DECLARE_CONVERT_FUNC(bayer_bggr8_to_rgb8);
 DECLARE_CONVERT_FUNC(bayer_rggb8_to_rgba32f);
 DECLARE_CONVERT_FUNC(bayer_gbrg8_to_rgba32f);
 DECLARE_CONVERT_FUNC(bayer_grbg8_to_rgba32f);
@@ -62,61 +77,65 @@ static const ConvertAttributes sConvertMappings[] = {
 
     // RGB -> RGB color space
     // L8 ->
-    {l8_to_rgb8,        {ImageFormat::CODE_L8, ImageFormat::CODE_NONE},         {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, false, false, true},
+    {NULL, {ImageFormat::CODE_L8, ImageFormat::CODE_NONE},         {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, true, true, true, l8_to_rgb8},
 
     // L32F ->
-    {l32f_to_rgb8,      {ImageFormat::CODE_L32F, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, false, false, true},
+    {NULL, {ImageFormat::CODE_L32F, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, true, true, true, l32f_to_rgb8},
 
     // RGB8 ->
-    {rgb8_to_rgba8,     {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE}, false, false, true},
-    {rgb8_to_bgr8,      {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE}, false, false, true},
-    {rgb8_to_rgba32f,   {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, false, true},
+    {NULL, {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE}, true, true, true, rgb8_to_rgba8},
+    {NULL, {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE}, true, true, true, rgb8_to_bgr8},
+    {NULL, {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, true, true, rgb8_to_rgba32f},
 
     // BGR8 ->
-    {bgr8_to_rgb8,      {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, false, false, true},
-    {bgr8_to_rgba8,     {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE}, false, false, true},
-    {bgr8_to_rgba32f,   {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, false, true},
+    {NULL, {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, true, true, true, bgr8_to_rgb8},
+    {NULL, {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE}, true, true, true, bgr8_to_rgba8},
+    {NULL, {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE},       {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, true, true, bgr8_to_rgba32f},
 
     // RGBA8 ->
-    {rgba8_to_rgb8,     {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE},      {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, false, false, true},
-    {rgba8_to_bgr8,     {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE},      {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE}, false, false, true},
-    {rgba8_to_rgba32f,  {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE},      {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, false, true},
+    {NULL, {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE},      {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, true, true, true, rgba8_to_rgb8},
+    {NULL, {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE},      {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE}, true, true, true, rgba8_to_bgr8},
+    {NULL, {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE},      {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, true, true, rgba8_to_rgba32f},
 
     // RGB32F ->
-    {rgb32f_to_rgba32f, {ImageFormat::CODE_RGB32F, ImageFormat::CODE_NONE},     {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, false, true},
+    {NULL, {ImageFormat::CODE_RGB32F, ImageFormat::CODE_NONE},     {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, true, true, rgb32f_to_rgba32f},
 
     // RGBA32F ->
-    {rgba32f_to_rgb8,   {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, false, true, true},
-    {rgba32f_to_rgba8,  {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE}, false, true, true},
-    {rgba32f_to_bgr8,   {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},    {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE}, false, true, true},
-    {rgba32f_to_rgb32f, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGB32F, ImageFormat::CODE_NONE}, false, true, true},
+    {NULL, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, true, true, true, rgba32f_to_rgb8},
+    {NULL, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGBA8, ImageFormat::CODE_NONE}, true, true, true, rgba32f_to_rgba8},
+    {NULL, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},    {ImageFormat::CODE_BGR8, ImageFormat::CODE_NONE}, true, true, true, rgba32f_to_bgr8},
+    {NULL, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGB32F, ImageFormat::CODE_NONE}, true, true, true, rgba32f_to_rgb32f},
     
     // RGB -> BAYER color space
-    {rgba32f_to_bayer_rggb8, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},       {ImageFormat::CODE_BAYER_RGGB8, ImageFormat::CODE_NONE}, false, true, true},
-    {rgba32f_to_bayer_gbrg8, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},       {ImageFormat::CODE_BAYER_GBRG8, ImageFormat::CODE_NONE}, false, true, true},
-    {rgba32f_to_bayer_grbg8, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},       {ImageFormat::CODE_BAYER_GRBG8, ImageFormat::CODE_NONE}, false, true, true},
-    {rgba32f_to_bayer_bggr8, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},       {ImageFormat::CODE_BAYER_BGGR8, ImageFormat::CODE_NONE}, false, true, true},
+    {rgba32f_to_bayer_rggb8, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},       {ImageFormat::CODE_BAYER_RGGB8, ImageFormat::CODE_NONE}, false, true, true, NULL},
+    {rgba32f_to_bayer_gbrg8, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},       {ImageFormat::CODE_BAYER_GBRG8, ImageFormat::CODE_NONE}, false, true, true, NULL},
+    {rgba32f_to_bayer_grbg8, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},       {ImageFormat::CODE_BAYER_GRBG8, ImageFormat::CODE_NONE}, false, true, true, NULL},
+    {rgba32f_to_bayer_bggr8, {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE},       {ImageFormat::CODE_BAYER_BGGR8, ImageFormat::CODE_NONE}, false, true, true, NULL},
 
     // BAYER -> RGB color space
-    {bayer_rggb8_to_rgba32f, {ImageFormat::CODE_BAYER_RGGB8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, false, false, true},
-    {bayer_gbrg8_to_rgba32f, {ImageFormat::CODE_BAYER_GBRG8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, false, false, true},
-    {bayer_grbg8_to_rgba32f, {ImageFormat::CODE_BAYER_GRBG8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, false, false, true},
-    {bayer_bggr8_to_rgba32f, {ImageFormat::CODE_BAYER_BGGR8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, false, false, true},
+    {bayer_rggb8_to_rgb8,    {ImageFormat::CODE_BAYER_RGGB8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, true, true, true, NULL},
+    {bayer_gbrg8_to_rgb8,    {ImageFormat::CODE_BAYER_GBRG8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, true, true, true, NULL},
+    {bayer_grbg8_to_rgb8,    {ImageFormat::CODE_BAYER_GRBG8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, true, true, true, NULL},
+    {bayer_bggr8_to_rgb8,    {ImageFormat::CODE_BAYER_BGGR8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, true, true, true, NULL},
+    {bayer_rggb8_to_rgba32f, {ImageFormat::CODE_BAYER_RGGB8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, true, true, NULL},
+    {bayer_gbrg8_to_rgba32f, {ImageFormat::CODE_BAYER_GBRG8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, true, true, NULL},
+    {bayer_grbg8_to_rgba32f, {ImageFormat::CODE_BAYER_GRBG8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, true, true, NULL},
+    {bayer_bggr8_to_rgba32f, {ImageFormat::CODE_BAYER_BGGR8, ImageFormat::CODE_NONE},   {ImageFormat::CODE_RGBA32F, ImageFormat::CODE_NONE}, true, true, true, NULL},
 
     // RGB <-> YUV color space
-    {rgb8_to_yuv420p, {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},     {ImageFormat::CODE_YUV420_PLANAR, ImageFormat::CODE_NONE}, false, false, false},
-    {rgb8_to_yuv422, {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},      {ImageFormat::CODE_YUV422, ImageFormat::CODE_NONE}, false, false, false},
-    {rgb8_to_yuv444, {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},      {ImageFormat::CODE_YUV444, ImageFormat::CODE_NONE}, false, false, false},
-    {yuv420p_to_rgb8, {ImageFormat::CODE_YUV420_PLANAR, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, false, false, false},
-    {yuv422_to_rgb8, {ImageFormat::CODE_YUV422, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, false, false, false},
-    {yuv444_to_rgb8, {ImageFormat::CODE_YUV444, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, false, false, false},
+    {rgb8_to_yuv420p, {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},     {ImageFormat::CODE_YUV420_PLANAR, ImageFormat::CODE_NONE}, false, false, false, NULL},
+    {rgb8_to_yuv422, {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},      {ImageFormat::CODE_YUV422, ImageFormat::CODE_NONE}, false, false, false, NULL},
+    {rgb8_to_yuv444, {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE},      {ImageFormat::CODE_YUV444, ImageFormat::CODE_NONE}, false, false, false, NULL},
+    {yuv420p_to_rgb8, {ImageFormat::CODE_YUV420_PLANAR, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, false, false, false, NULL},
+    {yuv422_to_rgb8, {ImageFormat::CODE_YUV422, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, false, false, false, NULL},
+    {yuv444_to_rgb8, {ImageFormat::CODE_YUV444, ImageFormat::CODE_NONE},    {ImageFormat::CODE_RGB8, ImageFormat::CODE_NONE}, false, false, false, NULL},
 };
 
-static ConvertFunc findConverter(TextureFormat::Code sourceCode, TextureFormat::Code destCode, bool needsSourcePadding, bool needsDestPadding, bool needsInvertY) {
+static const ConvertAttributes* findConverter(TextureFormat::Code sourceCode, TextureFormat::Code destCode, bool needsSourcePadding, bool needsDestPadding, bool needsInvertY) {
     int numRoutines = sizeof(sConvertMappings) / sizeof(ConvertAttributes);
     for (int routineIndex = 0; routineIndex < numRoutines; ++routineIndex) {
         int sourceIndex = 0;
-        ConvertAttributes routine = sConvertMappings[routineIndex];
+        const ConvertAttributes& routine = sConvertMappings[routineIndex];
 
         while (routine.m_sourceFormats[sourceIndex] != ImageFormat::CODE_NONE) {
             // check for matching source
@@ -133,7 +152,7 @@ static ConvertFunc findConverter(TextureFormat::Code sourceCode, TextureFormat::
                         (!needsInvertY || (routine.m_handleInvertY == needsInvertY))) {
 
                         // found compatible converter
-                        return routine.m_converter;
+                        return &routine;
                     }
                     ++destIndex;
                 }
@@ -145,21 +164,112 @@ static ConvertFunc findConverter(TextureFormat::Code sourceCode, TextureFormat::
     return NULL;
 }
 
-bool conversionAvailable(const ImageFormat* srcFormat, int srcRowPadBits, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY = false) {
+
+namespace _internal {
+
+/** Applies one RowConvertFunc to every row of an image, or two in
+    sequence through a one-row RGBA32F buffer */
+class ImageRowConverter {
+public:
+    RowConvertFunc      first;
+
+    /** NULL for a direct conversion */
+    RowConvertFunc      second;
+
+    const uint8*        src;
+    uint8*              dst;
+    int                 width;
+    int                 height;
+    size_t              srcStride;
+    size_t              dstStride;
+    bool                invertY;
+
+    /** width pixels per thread, for two-step conversions */
+    Color4*             intermediate;
+
+    void convertRow(int y, int threadID) {
+        const uint8* s = src + srcStride * y;
+        uint8* d = dst + dstStride * (invertY ? (height - 1 - y) : y);
+        if (second) {
+            Color4* row = intermediate + size_t(width) * threadID;
+            first(s, row, width);
+            second(row, d, width);
+        } else {
+            first(s, d, width);
+        }
+    }
+};
+
+} // namespace _internal
+
+
+/** Applies \a first, and then \a second if it is not NULL, to each row of
+    the image, using several threads for large images. */
+static void convertRows(RowConvertFunc first, RowConvertFunc second, 
+                        const void* srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits,
+                        void* dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY) {
+    debugAssertM(srcRowPadBits % 8 == 0, "Source row padding must be a multiple of 8 bits for this format");
+    debugAssertM(dstRowPadBits % 8 == 0, "Destination row padding must be a multiple of 8 bits for this format");
+
+    _internal::ImageRowConverter converter;
+    converter.first     = first;
+    converter.second    = second;
+    converter.src       = static_cast<const uint8*>(srcBytes);
+    converter.dst       = static_cast<uint8*>(dstBytes);
+    converter.width     = srcWidth;
+    converter.height    = srcHeight;
+    converter.srcStride = (size_t(srcWidth) * srcFormat->cpuBitsPerPixel + srcRowPadBits) / 8;
+    converter.dstStride = (size_t(srcWidth) * dstFormat->cpuBitsPerPixel + dstRowPadBits) / 8;
+    converter.invertY   = invertY;
+
+    const int numThreads = (srcWidth * srcHeight >= MIN_PARALLEL_PIXELS) ? ThreadPool::numThreads() : 1;
+
+    Array<Color4> intermediate;
+    if (second) {
+        intermediate.resize(srcWidth * numThreads);
+    }
+    converter.intermediate = intermediate.getCArray();
+
+    if (numThreads == 1) {
+        for (int y = 0; y < srcHeight; ++y) {
+            converter.convertRow(y, 0);
+        }
+    } else {
+        ThreadPool::parallelFor(0, srcHeight, &converter, &_internal::ImageRowConverter::convertRow, 
+                                iMax(1, PIXELS_PER_TILE / iMax(srcWidth, 1)), numThreads);
+    }
+}
+
+
+/** Runs a single converter on the whole image */
+static void applyConverter(const ConvertAttributes* converter, const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
+    if (converter->m_rowConverter) {
+        convertRows(converter->m_rowConverter, NULL, srcBytes[0], srcWidth, srcHeight, srcFormat, srcRowPadBits, dstBytes[0], dstFormat, dstRowPadBits, invertY);
+    } else {
+        converter->m_converter(srcBytes, srcWidth, srcHeight, srcFormat, srcRowPadBits, dstBytes, dstFormat, dstRowPadBits, invertY, bayerAlg);
+    }
+}
+
+
+bool ImageFormat::conversionAvailable(const ImageFormat* srcFormat, int srcRowPadBits, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY) {
     bool conversionAvailable = false;
 
     // check if a conversion is available
     if ( (srcFormat->code == dstFormat->code) && (srcRowPadBits == dstRowPadBits) && !invertY) {
         conversionAvailable = true;
+    } else if (findConverter(srcFormat->code, dstFormat->code, srcRowPadBits > 0, dstRowPadBits > 0, invertY) != NULL) {
+        conversionAvailable = true;
     } else {
-        ConvertFunc directConverter = findConverter(srcFormat->code, dstFormat->code, srcRowPadBits > 0, dstRowPadBits > 0, invertY);
-
-        conversionAvailable = (directConverter != NULL);
+        // convert() can go through RGBA32F
+        conversionAvailable = 
+            (findConverter(srcFormat->code, ImageFormat::CODE_RGBA32F, srcRowPadBits > 0, false, false) != NULL) &&
+            (findConverter(ImageFormat::CODE_RGBA32F, dstFormat->code, false, dstRowPadBits > 0, invertY) != NULL);
     }
 
     return conversionAvailable;
 }
 
+
 bool ImageFormat::convert(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits,
                           const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, 
                           bool invertY, BayerAlgorithm bayerAlg) {
@@ -176,24 +286,30 @@ bool ImageFormat::convert(const Array<const void*>& srcBytes, int srcWidth, int
         // then look for conversion to intermediate
         // and then from intermediate to dest.
         // intermediate format is RGBA32F
-        ConvertFunc directConverter = findConverter(srcFormat->code, dstFormat->code, srcRowPadBits > 0, dstRowPadBits > 0, invertY);
+        const ConvertAttributes* directConverter = findConverter(srcFormat->code, dstFormat->code, srcRowPadBits > 0, dstRowPadBits > 0, invertY);
 
         // if we have a direct converter, use it, otherwise find intermdiate path
         if (directConverter) {
-            directConverter(srcBytes, srcWidth, srcHeight, srcFormat, srcRowPadBits, dstBytes, dstFormat, dstRowPadBits, invertY, bayerAlg);
+            applyConverter(directConverter, srcBytes, srcWidth, srcHeight, srcFormat, srcRowPadBits, dstBytes, dstFormat, dstRowPadBits, invertY, bayerAlg);
             conversionAvailable = true;
         } else {
-            ConvertFunc toInterConverter = findConverter(srcFormat->code, ImageFormat::CODE_RGBA32F, srcRowPadBits > 0, false, false);;
-            ConvertFunc fromInterConverter = findConverter(ImageFormat::CODE_RGBA32F, dstFormat->code, false, dstRowPadBits > 0, invertY);;
+            const ConvertAttributes* toInterConverter = findConverter(srcFormat->code, ImageFormat::CODE_RGBA32F, srcRowPadBits > 0, false, false);
+            const ConvertAttributes* fromInterConverter = findConverter(ImageFormat::CODE_RGBA32F, dstFormat->code, false, dstRowPadBits > 0, invertY);
 
             if (toInterConverter && fromInterConverter) {
-                Array<void*> tmp;
-                tmp.append(System::malloc(srcWidth * srcHeight * ImageFormat::RGBA32F()->cpuBitsPerPixel * 8));
-
-                toInterConverter(srcBytes, srcWidth, srcHeight, srcFormat, srcRowPadBits, tmp, ImageFormat::RGBA32F(), 0, false, bayerAlg);
-                fromInterConverter(reinterpret_cast<Array<const void*>&>(tmp), srcWidth, srcHeight, ImageFormat::RGBA32F(), 0, dstBytes, dstFormat, dstRowPadBits, invertY, bayerAlg);
-
-                System::free(tmp[0]);
+                if (toInterConverter->m_rowConverter && fromInterConverter->m_rowConverter) {
+                    // Only one row of the intermediate image exists at a time
+                    convertRows(toInterConverter->m_rowConverter, fromInterConverter->m_rowConverter, 
+                                srcBytes[0], srcWidth, srcHeight, srcFormat, srcRowPadBits, dstBytes[0], dstFormat, dstRowPadBits, invertY);
+                } else {
+                    Array<void*> tmp;
+                    tmp.append(System::malloc(srcWidth * srcHeight * ImageFormat::RGBA32F()->cpuBitsPerPixel / 8));
+
+                    applyConverter(toInterConverter, srcBytes, srcWidth, srcHeight, srcFormat, srcRowPadBits, tmp, ImageFormat::RGBA32F(), 0, false, bayerAlg);
+                    applyConverter(fromInterConverter, reinterpret_cast<Array<const void*>&>(tmp), srcWidth, srcHeight, ImageFormat::RGBA32F(), 0, dstBytes, dstFormat, dstRowPadBits, invertY, bayerAlg);
+
+                    System::free(tmp[0]);
+                }
 
                 conversionAvailable = true;
             }
@@ -204,328 +320,408 @@ bool ImageFormat::convert(const Array<const void*>& srcBytes, int srcWidth, int
 }
 
 
+bool ImageFormat::convertRow(const void* srcBytes, const ImageFormat* srcFormat, void* dstBytes, const ImageFormat* dstFormat, int width) {
+    Array<const void*> s;
+    s.append(srcBytes);
+    Array<void*> d;
+    d.append(dstBytes);
+    return convert(s, width, 1, srcFormat, 0, d, dstFormat, 0);
+}
+
+
 // *******************
-// RGB -> RGB color space conversions
+// Row converters: RGB -> RGB color space conversions
 // *******************
 
-// L8 ->
-static void l8_to_rgb8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    (void)bayerAlg;
-    (void)dstRowPadBits;
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const unorm8* src = static_cast<const unorm8*>(srcBytes[0]);
-    for (int y = 0; y < srcHeight; ++y) {
-        for (int x = 0; x < srcWidth; ++x) {
-            int i = (invertY) ? ((srcHeight-1-y) * srcWidth +x) : (y * srcWidth + x);
-            int i3 = i * 3;
-
-            dst[i3 + 0] = src[i]; 
-            dst[i3 + 1] = src[i]; 
-            dst[i3 + 2] = src[i]; 
-        }
-    }
-}
+// Each of these converts a single row.  The SIMD versions process as
+// many whole blocks as fit in the row and return the number of pixels
+// that they converted; the caller finishes the row with scalar code.
 
-// L32F ->
-static void l32f_to_rgb8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    int srcIndex = 0;
-    int dstByteOffset = 0;
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const float* src = static_cast<const float*>(srcBytes[0]);
+#ifdef G3D_RUNTIME_SIMD
 
-    for (int y = 0; y < srcHeight; ++y) {
-        if (invertY) {
-            srcIndex = srcWidth * (srcHeight - y - 1);
-        }
-        
-        for (int x = 0; x < srcWidth; ++x, ++srcIndex, dstByteOffset += 3) {
-            Color3unorm8&  d = *reinterpret_cast<Color3unorm8*>(dst + dstByteOffset);
-            const float s = src[srcIndex];
-            const unorm8 c(s);
-            d = Color3unorm8(c, c, c);
-        }
-    } 
+G3D_SSE2_TARGET static inline __m128i shuffleMask(int b0, int b1, int b2, int b3, int b4, int b5, int b6, int b7,
+                                  int b8, int b9, int b10, int b11, int b12, int b13, int b14, int b15) {
+    return _mm_setr_epi8(char(b0), char(b1), char(b2), char(b3), char(b4), char(b5), char(b6), char(b7),
+                         char(b8), char(b9), char(b10), char(b11), char(b12), char(b13), char(b14), char(b15));
 }
 
-// RGB8 ->
-static void rgb8_to_rgba8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const unorm8* src = static_cast<const unorm8*>(srcBytes[0]);
-    for (int y = 0; y < srcHeight; ++y) {
-        for (int x = 0; x < srcWidth; ++x) {
-            int i = (invertY) ? ((srcHeight-1-y) * srcWidth +x) : (y * srcWidth + x);
-            int i3 = i * 3;
-            int i4 = i3 + i; 
-
-            dst[i4 + 0] = src[i3 + 0]; 
-            dst[i4 + 1] = src[i3 + 1]; 
-            dst[i4 + 2] = src[i3 + 2]; 
-            dst[i4 + 3] = unorm8::one(); 
-        }
+/** Index that makes PSHUFB write zero */
+#define Z 0x80
+
+#define RGB8_TO_RGBA8_MASK  shuffleMask(0, 1, 2, Z, 3, 4, 5, Z, 6, 7, 8, Z, 9, 10, 11, Z)
+#define BGR8_TO_RGBA8_MASK  shuffleMask(2, 1, 0, Z, 5, 4, 3, Z, 8, 7, 6, Z, 11, 10, 9, Z)
+#define RGBA8_TO_RGB8_MASK  shuffleMask(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, Z, Z, Z, Z)
+#define RGBA8_TO_BGR8_MASK  shuffleMask(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, Z, Z, Z, Z)
+
+G3D_SSSE3_TARGET static int l8_to_rgb8_ssse3(const uint8* src, uint8* dst, int width) {
+    const __m128i m0 = shuffleMask(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m128i m1 = shuffleMask(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    const __m128i m2 = shuffleMask(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(src + x));
+        __m128i* d = (__m128i*)(dst + 3 * x);
+        _mm_storeu_si128(d,     _mm_shuffle_epi8(v, m0));
+        _mm_storeu_si128(d + 1, _mm_shuffle_epi8(v, m1));
+        _mm_storeu_si128(d + 2, _mm_shuffle_epi8(v, m2));
     }
+    return x;
 }
 
-static void rgb8_to_bgr8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const unorm8* src = static_cast<const unorm8*>(srcBytes[0]);
-    for (int y = 0; y < srcHeight; ++y) {
-        for (int x = 0; x < srcWidth; ++x) {
-            int i = (invertY) ? ((srcHeight-1-y) * srcWidth +x) : (y * srcWidth + x);
-            int i3 = i * 3;
-            dst[i3 + 0] = src[i3 + 2];
-            dst[i3 + 1] = src[i3 + 1];
-            dst[i3 + 2] = src[i3 + 0];
-        }
+
+/** Expands 3-byte pixels to 4 bytes with opaque alpha, four at a time */
+G3D_SSSE3_TARGET static int rgb8_to_rgba8_ssse3(const uint8* src, uint8* dst, int width, bool swapRedBlue) {
+    const __m128i mask  = swapRedBlue ? BGR8_TO_RGBA8_MASK : RGB8_TO_RGBA8_MASK;
+    const __m128i alpha = _mm_set1_epi32(int(0xFF000000));
+    int x = 0;
+    // Each iteration reads 16 bytes but uses 12
+    for (; 3 * x + 16 <= 3 * width; x += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(src + 3 * x));
+        _mm_storeu_si128((__m128i*)(dst + 4 * x), _mm_or_si128(_mm_shuffle_epi8(v, mask), alpha));
     }
+    return x;
 }
 
-static void rgb8_to_rgba32f(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    debugAssertM(srcRowPadBits % 8 == 0, "Source row padding must be a multiple of 8 bits for this format");
 
-    int dstIndex = 0;
-    int srcByteOffset = 0;
-    int srcRowPadBytes = srcRowPadBits / 8;
-    Color4* dst = static_cast<Color4*>(dstBytes[0]);
-    const unorm8* src = static_cast<const unorm8*>(srcBytes[0]);
-
-    for (int y = 0; y < srcHeight; ++y) {
-        if (invertY) {
-            dstIndex = srcWidth * (srcHeight - 1 - y);
-        }
-        for (int x = 0; x < srcWidth; ++x, ++dstIndex, srcByteOffset += 3) {
-            const Color3unorm8& s = *reinterpret_cast<const Color3unorm8*>(src + srcByteOffset);
-            dst[dstIndex] = Color4(Color3(s), 1.0f);
-        }
-        srcByteOffset += srcRowPadBytes;
+/** Drops the alpha channel of four pixels at a time */
+G3D_SSSE3_TARGET static int rgba8_to_rgb8_ssse3(const uint8* src, uint8* dst, int width, bool swapRedBlue) {
+    const __m128i mask = swapRedBlue ? RGBA8_TO_BGR8_MASK : RGBA8_TO_RGB8_MASK;
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 4 * x)), mask);
+        uint8* d = dst + 3 * x;
+        _mm_storel_epi64((__m128i*)d, v);
+        const int32 last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+        System::memcpy(d + 8, &last, 4);
     }
+    return x;
 }
 
-// BGR8 ->
-static void bgr8_to_rgb8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const unorm8* src = static_cast<const unorm8*>(srcBytes[0]);
-    for (int y = 0; y < srcHeight; ++y) {
-        for (int x = 0; x < srcWidth; ++x) {
-            int i = (invertY) ? ((srcHeight-1-y) * srcWidth +x) : (y * srcWidth + x);
-            int i3 = i * 3;
-            dst[i3 + 0] = src[i3 + 2];
-            dst[i3 + 1] = src[i3 + 1];
-            dst[i3 + 2] = src[i3 + 0];
-        }
-    }
-}
 
-static void bgr8_to_rgba8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const unorm8* src = static_cast<const unorm8*>(srcBytes[0]);
-    for (int y = 0; y < srcHeight; ++y) {
-        for (int x = 0; x < srcWidth; ++x) {
-            int i = (invertY) ? ((srcHeight-1-y) * srcWidth +x) : (y * srcWidth + x);
-            int i3 = i * 3;
-            int i4 = i3 + i; 
-
-            dst[i4 + 0] = src[i3 + 2]; 
-            dst[i4 + 1] = src[i3 + 1]; 
-            dst[i4 + 2] = src[i3 + 0]; 
-            dst[i4 + 3] = unorm8::one(); 
-        }
+/** Swaps red and blue in five 3-byte pixels at a time */
+G3D_SSSE3_TARGET static int rgb8_to_bgr8_ssse3(const uint8* src, uint8* dst, int width) {
+    const __m128i mask = shuffleMask(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    int x = 0;
+    // Each iteration writes 16 bytes.  The last byte belongs to the next
+    // pixel and is overwritten by the next iteration or the scalar loop.
+    for (; 3 * x + 16 <= 3 * width; x += 5) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(src + 3 * x));
+        _mm_storeu_si128((__m128i*)(dst + 3 * x), _mm_shuffle_epi8(v, mask));
     }
+    return x;
 }
 
-static void bgr8_to_rgba32f(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    debugAssertM(srcRowPadBits % 8 == 0, "Source row padding must be a multiple of 8 bits for this format");
 
-    int dstIndex = 0;
-    int srcByteOffset = 0;
-    int srcRowPadBytes = srcRowPadBits / 8;
-    Color4* dst = static_cast<Color4*>(dstBytes[0]);
-    const unorm8* src = static_cast<const unorm8*>(srcBytes[0]);
+/** Converts four RGBA8 pixels in \a v to RGBA32F */
+G3D_SSE2_TARGET static inline void storeRGBA8AsRGBA32F(__m128i v, float* dst) {
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128  scale = _mm_set1_ps(1.0f / 255.0f);
+    const __m128i lo = _mm_unpacklo_epi8(v, zero);
+    const __m128i hi = _mm_unpackhi_epi8(v, zero);
+    _mm_storeu_ps(dst,      _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+    _mm_storeu_ps(dst + 4,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+    _mm_storeu_ps(dst + 8,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+    _mm_storeu_ps(dst + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+}
 
-    for (int y = 0; y < srcHeight; ++y) {
-        if (invertY) {
-            dstIndex = srcWidth * (srcHeight - 1 - y);
-        }
 
-        for (int x = 0; x < srcWidth; ++x, ++dstIndex, srcByteOffset += 3) {
-            const Color3unorm8& s = *reinterpret_cast<const Color3unorm8*>(src + srcByteOffset);
-            dst[dstIndex] = Color4(Color3(s).bgr(), 1.0f);
-        }
-        srcByteOffset += srcRowPadBytes;
+G3D_SSE2_TARGET static int rgba8_to_rgba32f_sse2(const uint8* src, float* dst, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        storeRGBA8AsRGBA32F(_mm_loadu_si128((const __m128i*)(src + 4 * x)), dst + 4 * x);
     }
+    return x;
 }
 
-// RGBA8 ->
-static void rgba8_to_rgb8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const unorm8* src = static_cast<const unorm8*>(srcBytes[0]);
-    for (int y = 0; y < srcHeight; ++y) {
-        for (int x = 0; x < srcWidth; ++x) {
-            int i = (invertY) ? ((srcHeight-1-y) * srcWidth +x) : (y * srcWidth + x);
-            int i3 = i * 3;
-            int i4 = i3 + i;
 
-            dst[i3 + 0] = src[i4 + 0]; 
-            dst[i3 + 1] = src[i4 + 1]; 
-            dst[i3 + 2] = src[i4 + 2]; 
-        }
+G3D_SSSE3_TARGET static int rgb8_to_rgba32f_ssse3(const uint8* src, float* dst, int width, bool swapRedBlue) {
+    const __m128i mask  = swapRedBlue ? BGR8_TO_RGBA8_MASK : RGB8_TO_RGBA8_MASK;
+    const __m128i alpha = _mm_set1_epi32(int(0xFF000000));
+    int x = 0;
+    for (; 3 * x + 16 <= 3 * width; x += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(src + 3 * x));
+        storeRGBA8AsRGBA32F(_mm_or_si128(_mm_shuffle_epi8(v, mask), alpha), dst + 4 * x);
     }
+    return x;
 }
 
-static void rgba8_to_bgr8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const unorm8* src = static_cast<const unorm8*>(srcBytes[0]);
-    for (int y = 0; y < srcHeight; ++y) {
-        for (int x = 0; x < srcWidth; ++x) {
-            int i = (invertY) ? ((srcHeight-1-y) * srcWidth +x) : (y * srcWidth + x);
-            int i3 = i * 3;
-            int i4 = i3 + i;
 
-            dst[i3 + 0] = src[i4 + 2]; 
-            dst[i3 + 1] = src[i4 + 1]; 
-            dst[i3 + 2] = src[i4 + 0]; 
-        }
+/** Converts four RGBA32F pixels to RGBA8 with the same rounding as unorm8(float) */
+G3D_SSE2_TARGET static inline __m128i loadRGBA32FAsRGBA8(const float* src) {
+    const __m128 zero  = _mm_setzero_ps();
+    const __m128 one   = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half  = _mm_set1_ps(0.5f);
+    __m128i c[4];
+    for (int i = 0; i < 4; ++i) {
+        const __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + 4 * i), zero), one);
+        c[i] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
     }
+    return _mm_packus_epi16(_mm_packs_epi32(c[0], c[1]), _mm_packs_epi32(c[2], c[3]));
 }
 
-static void rgba8_to_rgba32f(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    debugAssertM(srcRowPadBits % 8 == 0, "Source row padding must be a multiple of 8 bits for this format");
 
-    int dstIndex = 0;
-    int srcByteOffset = 0;
-    int srcRowPadBytes = srcRowPadBits / 8;
-    Color4* dst = static_cast<Color4*>(dstBytes[0]);
-    const unorm8* src = static_cast<const unorm8*>(srcBytes[0]);
+G3D_SSE2_TARGET static int rgba32f_to_rgba8_sse2(const float* src, uint8* dst, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        _mm_storeu_si128((__m128i*)(dst + 4 * x), loadRGBA32FAsRGBA8(src + 4 * x));
+    }
+    return x;
+}
 
-    for (int y = 0; y < srcHeight; ++y) {
-        if (invertY) {
-            dstIndex = srcWidth * (srcHeight - 1 - y);
-        }
 
-        for (int x = 0; x < srcWidth; ++x, ++dstIndex, srcByteOffset += 4) {
-            const Color4unorm8& s = *reinterpret_cast<const Color4unorm8*>(src + srcByteOffset);
-            dst[dstIndex] = Color4(s);
-        }
-        srcByteOffset += srcRowPadBytes;
+G3D_SSSE3_TARGET static int rgba32f_to_rgb8_ssse3(const float* src, uint8* dst, int width, bool swapRedBlue) {
+    const __m128i mask = swapRedBlue ? RGBA8_TO_BGR8_MASK : RGBA8_TO_RGB8_MASK;
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i v = _mm_shuffle_epi8(loadRGBA32FAsRGBA8(src + 4 * x), mask);
+        uint8* d = dst + 3 * x;
+        _mm_storel_epi64((__m128i*)d, v);
+        const int32 last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+        System::memcpy(d + 8, &last, 4);
     }
+    return x;
 }
 
-// RGB32F ->
-static void rgb32f_to_rgba32f(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    debugAssertM(srcRowPadBits % 8 == 0, "Source row padding must be a multiple of 8 bits for this format");
+#endif // G3D_RUNTIME_SIMD
 
-    int dstIndex = 0;
-    int srcByteOffset = 0;
-    int srcRowPadBytes = srcRowPadBits / 8;
-    Color4* dst = static_cast<Color4*>(dstBytes[0]);
-    const unorm8* src = static_cast<const unorm8*>(srcBytes[0]);
-
-    for (int y = 0; y < srcHeight; ++y) {
-        if (invertY) {
-            dstIndex = srcWidth * (srcHeight - 1 - y);
-        }
+// Runtime checks for the SIMD row converters
+#ifdef G3D_RUNTIME_SIMD
+#   define USE_SSE2     System::hasSSE2()
+#   define USE_SSSE3    System::hasSSSE3()
+#else
+#   define USE_SSE2     false
+#   define USE_SSSE3    false
+#endif
 
-        for (int x = 0; x < srcWidth; ++x, ++dstIndex, srcByteOffset += 3 * sizeof(float)) {
-            const Color3& s = *reinterpret_cast<const Color3*>(src + srcByteOffset);
-            dst[dstIndex] = Color4(Color3(s), 1.0f);
-        }
-        srcByteOffset += srcRowPadBytes;
+// L8 ->
+static void l8_to_rgb8(const void* _src, void* _dst, int width) {
+    const uint8* src = static_cast<const uint8*>(_src);
+    uint8* dst = static_cast<uint8*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSSE3) {
+        x = l8_to_rgb8_ssse3(src, dst, width);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[3 * x + 0] = src[x];
+        dst[3 * x + 1] = src[x];
+        dst[3 * x + 2] = src[x];
     }
 }
 
-// RGBA32F ->
-static void rgba32f_to_rgb8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    debugAssertM(dstRowPadBits % 8 == 0, "Destination row padding must be a multiple of 8 bits for this format");
+// L32F ->
+static void l32f_to_rgb8(const void* _src, void* _dst, int width) {
+    const float* src = static_cast<const float*>(_src);
+    Color3unorm8* dst = static_cast<Color3unorm8*>(_dst);
+    for (int x = 0; x < width; ++x) {
+        const unorm8 c(src[x]);
+        dst[x] = Color3unorm8(c, c, c);
+    }
+}
 
-    int srcIndex = 0;
-    int dstByteOffset = 0;
-    int dstRowPadBytes = dstRowPadBits / 8;
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const Color4* src = static_cast<const Color4*>(srcBytes[0]);
+// RGB8 ->
+static void rgb8_to_rgba8(const void* _src, void* _dst, int width) {
+    const uint8* src = static_cast<const uint8*>(_src);
+    uint8* dst = static_cast<uint8*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSSE3) {
+        x = rgb8_to_rgba8_ssse3(src, dst, width, false);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[4 * x + 0] = src[3 * x + 0];
+        dst[4 * x + 1] = src[3 * x + 1];
+        dst[4 * x + 2] = src[3 * x + 2];
+        dst[4 * x + 3] = 0xFF;
+    }
+}
 
-    for (int y = 0; y < srcHeight; ++y) {
-        if (invertY) {
-            srcIndex = srcWidth * (srcHeight - y - 1);
-        }
-        
-        for (int x = 0; x < srcWidth; ++x, ++srcIndex, dstByteOffset += 3) {
-            Color3unorm8&  d = *reinterpret_cast<Color3unorm8*>(dst + dstByteOffset);
-            const Color4& s = src[srcIndex];
+static void rgb8_to_bgr8(const void* _src, void* _dst, int width) {
+    const uint8* src = static_cast<const uint8*>(_src);
+    uint8* dst = static_cast<uint8*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSSE3) {
+        x = rgb8_to_bgr8_ssse3(src, dst, width);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[3 * x + 0] = src[3 * x + 2];
+        dst[3 * x + 1] = src[3 * x + 1];
+        dst[3 * x + 2] = src[3 * x + 0];
+    }
+}
 
-            d = Color3unorm8(s.rgb());
-        }
-        dstByteOffset += dstRowPadBytes;
-    } 
+static void rgb8_to_rgba32f(const void* _src, void* _dst, int width) {
+    const Color3unorm8* src = static_cast<const Color3unorm8*>(_src);
+    Color4* dst = static_cast<Color4*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSSE3) {
+        x = rgb8_to_rgba32f_ssse3(reinterpret_cast<const uint8*>(src), reinterpret_cast<float*>(dst), width, false);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[x] = Color4(Color3(src[x]), 1.0f);
+    }
 }
 
-static void rgba32f_to_rgba8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    debugAssertM(dstRowPadBits % 8 == 0, "Destination row padding must be a multiple of 8 bits for this format");
+// BGR8 ->
+static void bgr8_to_rgb8(const void* src, void* dst, int width) {
+    rgb8_to_bgr8(src, dst, width);
+}
 
-    int srcIndex = 0;
-    int dstByteOffset = 0;
-    int dstRowPadBytes = dstRowPadBits / 8;
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const Color4* src = static_cast<const Color4*>(srcBytes[0]);
+static void bgr8_to_rgba8(const void* _src, void* _dst, int width) {
+    const uint8* src = static_cast<const uint8*>(_src);
+    uint8* dst = static_cast<uint8*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSSE3) {
+        x = rgb8_to_rgba8_ssse3(src, dst, width, true);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[4 * x + 0] = src[3 * x + 2];
+        dst[4 * x + 1] = src[3 * x + 1];
+        dst[4 * x + 2] = src[3 * x + 0];
+        dst[4 * x + 3] = 0xFF;
+    }
+}
 
-    for (int y = 0; y < srcHeight; ++y) {
-        if (invertY) {
-            srcIndex = srcWidth * (srcHeight - 1 - y);
-        }
-        for (int x = 0; x < srcWidth; ++x, ++srcIndex, dstByteOffset += 4) {
-            Color4unorm8&  d = *reinterpret_cast<Color4unorm8*>(dst + dstByteOffset);
-            const Color4& s = src[srcIndex];
+static void bgr8_to_rgba32f(const void* _src, void* _dst, int width) {
+    const Color3unorm8* src = static_cast<const Color3unorm8*>(_src);
+    Color4* dst = static_cast<Color4*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSSE3) {
+        x = rgb8_to_rgba32f_ssse3(reinterpret_cast<const uint8*>(src), reinterpret_cast<float*>(dst), width, true);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[x] = Color4(Color3(src[x]).bgr(), 1.0f);
+    }
+}
 
-            d = Color4unorm8(s);
-        }
-        dstByteOffset += dstRowPadBytes;
-    } 
+// RGBA8 ->
+static void rgba8_to_rgb8(const void* _src, void* _dst, int width) {
+    const uint8* src = static_cast<const uint8*>(_src);
+    uint8* dst = static_cast<uint8*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSSE3) {
+        x = rgba8_to_rgb8_ssse3(src, dst, width, false);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[3 * x + 0] = src[4 * x + 0];
+        dst[3 * x + 1] = src[4 * x + 1];
+        dst[3 * x + 2] = src[4 * x + 2];
+    }
 }
 
-static void rgba32f_to_bgr8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    debugAssertM(dstRowPadBits % 8 == 0, "Destination row padding must be a multiple of 8 bits for this format");
+static void rgba8_to_bgr8(const void* _src, void* _dst, int width) {
+    const uint8* src = static_cast<const uint8*>(_src);
+    uint8* dst = static_cast<uint8*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSSE3) {
+        x = rgba8_to_rgb8_ssse3(src, dst, width, true);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[3 * x + 0] = src[4 * x + 2];
+        dst[3 * x + 1] = src[4 * x + 1];
+        dst[3 * x + 2] = src[4 * x + 0];
+    }
+}
 
-    int srcIndex = 0;
-    int dstByteOffset = 0;
-    int dstRowPadBytes = dstRowPadBits / 8;
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const Color4* src = static_cast<const Color4*>(srcBytes[0]);
+static void rgba8_to_rgba32f(const void* _src, void* _dst, int width) {
+    const Color4unorm8* src = static_cast<const Color4unorm8*>(_src);
+    Color4* dst = static_cast<Color4*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSE2) {
+        x = rgba8_to_rgba32f_sse2(reinterpret_cast<const uint8*>(src), reinterpret_cast<float*>(dst), width);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[x] = Color4(src[x]);
+    }
+}
 
-    for (int y = 0; y < srcHeight; ++y) {
-        if (invertY) {
-            srcIndex = srcWidth * (srcHeight - y - 1);
-        }
-        
-        for (int x = 0; x < srcWidth; ++x, ++srcIndex, dstByteOffset += 3) {
-            Color3unorm8&  d = *reinterpret_cast<Color3unorm8*>(dst + dstByteOffset);
-            const Color4& s = src[srcIndex];
+// RGB32F ->
+static void rgb32f_to_rgba32f(const void* _src, void* _dst, int width) {
+    const Color3* src = static_cast<const Color3*>(_src);
+    Color4* dst = static_cast<Color4*>(_dst);
+    for (int x = 0; x < width; ++x) {
+        dst[x] = Color4(src[x], 1.0f);
+    }
+}
 
-            d = Color3unorm8(s.rgb()).bgr();
-        }
-        dstByteOffset += dstRowPadBytes;
-    } 
+// RGBA32F ->
+static void rgba32f_to_rgb8(const void* _src, void* _dst, int width) {
+    const Color4* src = static_cast<const Color4*>(_src);
+    Color3unorm8* dst = static_cast<Color3unorm8*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSSE3) {
+        x = rgba32f_to_rgb8_ssse3(reinterpret_cast<const float*>(src), reinterpret_cast<uint8*>(dst), width, false);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[x] = Color3unorm8(src[x].rgb());
+    }
 }
 
-static void rgba32f_to_rgb32f(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    debugAssertM(dstRowPadBits % 8 == 0, "Destination row padding must be a multiple of 8 bits for this format");
+static void rgba32f_to_rgba8(const void* _src, void* _dst, int width) {
+    const Color4* src = static_cast<const Color4*>(_src);
+    Color4unorm8* dst = static_cast<Color4unorm8*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSE2) {
+        x = rgba32f_to_rgba8_sse2(reinterpret_cast<const float*>(src), reinterpret_cast<uint8*>(dst), width);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[x] = Color4unorm8(src[x]);
+    }
+}
 
-    int srcIndex = 0;
-    int dstByteOffset = 0;
-    int dstRowPadBytes = dstRowPadBits / 8;
-    unorm8* dst = static_cast<unorm8*>(dstBytes[0]);
-    const Color4* src = static_cast<const Color4*>(srcBytes[0]);
+static void rgba32f_to_bgr8(const void* _src, void* _dst, int width) {
+    const Color4* src = static_cast<const Color4*>(_src);
+    Color3unorm8* dst = static_cast<Color3unorm8*>(_dst);
+    int x = 0;
+#   ifdef G3D_RUNTIME_SIMD
+    if (USE_SSSE3) {
+        x = rgba32f_to_rgb8_ssse3(reinterpret_cast<const float*>(src), reinterpret_cast<uint8*>(dst), width, true);
+    }
+#   endif
+    for (; x < width; ++x) {
+        dst[x] = Color3unorm8(src[x].rgb()).bgr();
+    }
+}
 
-    for (int y = 0; y < srcHeight; ++y) {
-        if (invertY) {
-            srcIndex = srcWidth * (srcHeight - 1 - y);
-        }
-        for (int x = 0; x < srcWidth; ++x, ++srcIndex, dstByteOffset += 3 * sizeof(float)) {
-            Color3& d = *reinterpret_cast<Color3*>(dst + dstByteOffset);
-            const Color4& s = src[srcIndex];        
-            d = s.rgb();
-        }
-        dstByteOffset += dstRowPadBytes;
-    } 
+static void rgba32f_to_rgb32f(const void* _src, void* _dst, int width) {
+    const Color4* src = static_cast<const Color4*>(_src);
+    Color3* dst = static_cast<Color3*>(_dst);
+    for (int x = 0; x < width; ++x) {
+        dst[x] = src[x].rgb();
+    }
 }
 
+#undef USE_SSE2
+#undef USE_SSSE3
+#ifdef G3D_RUNTIME_SIMD
+#   undef Z
+#   undef RGB8_TO_RGBA8_MASK
+#   undef BGR8_TO_RGBA8_MASK
+#   undef RGBA8_TO_RGB8_MASK
+#   undef RGBA8_TO_BGR8_MASK
+#endif
+
 // *******************
 // RGB <-> YUV color space conversions
 // *******************
@@ -744,289 +940,127 @@ static void yuv444_to_rgb8(const Array<const void*>& srcBytes, int srcWidth, int
 // but several are impulses because needed output at that 
 // location *is* the input (e.g., G_GRG and G_BGG).
 //
-// The following 5x5 row-major filters are named as output_input.
-
-// Green
-static const float G_GRR[5][5] =
-    {{     0.0f,      0.0f,     -1.0f,      0.0f,      0.0f},
-     {     0.0f,      0.0f,      2.0f,      0.0f,      0.0f},
-     {    -1.0f,      2.0f,      4.0f,      2.0f,     -1.0f},
-     {     0.0f,      0.0f,      2.0f,      0.0f,      0.0f},
-     {     0.0f,      0.0f,     -1.0f,      0.0f,      0.0f}};
-
-static const float G_BGB[5][5] =
-    {{     0.0f,      0.0f,     -1.0f,      0.0f,      0.0f},
-     {     0.0f,      0.0f,      2.0f,      0.0f,      0.0f},
-     {    -1.0f,      2.0f,      4.0f,      2.0f,     -1.0f},
-     {     0.0f,      0.0f,      2.0f,      0.0f,      0.0f},
-     {     0.0f,      0.0f,     -1.0f,      0.0f,      0.0f}};
-
-// Red 
-//(the caption in the paper is wrong for this case:
-// "R row B column really means R row G column"
-static const float R_GRG[5][5] =
-    {{     0.0f,      0.0f,      0.5f,      0.0f,      0.0f},
-     {     0.0f,     -1.0f,      0.0f,     -1.0f,      0.0f},
-     {    -1.0f,      4.0f,      5.0f,      4.0f,     -1.0f},
-     {     0.0f,     -1.0f,      0.0f,     -1.0f,      0.0f},
-     {     0.0f,      0.0f,      0.5f,      0.0f,      0.0f}};
-
-static const float R_BGG[5][5] =
-    {{     0.0f,      0.0f,     -1.0f,      0.0f,      0.0f},
-     {     0.0f,     -1.0f,      4.0f,     -1.0f,      0.0f},
-     {     0.5f,      0.0f,      5.0f,      0.0f,      0.5f},
-     {     0.0f,     -1.0f,      4.0f,     -1.0f,      0.0f},
-     {     0.0f,      0.0f,     -1.0f,      0.0f,      0.0f}};
-
-static const float R_BGB[5][5] =
-    {{     0.0f,      0.0f, -3.0f/2.0f,      0.0f,      0.0f},
-     {     0.0f,      2.0f,      0.0f,      2.0f,      0.0f},
-     {-3.0f/2.0f,      0.0f,      6.0f,      0.0f, -3.0f/2.0f},
-     {     0.0f,      2.0f,      0.0f,      2.0f,      0.0f},
-     {     0.0f,      0.0f, -3.0f/2.0f,      0.0f,      0.0f}};
-
-
-// Blue 
-//(the caption in the paper is wrong for this case:
-// "B row R column really means B row G column")
-#define B_BGG R_GRG
-#define B_GRG R_BGG
-#define B_GRR R_BGB
+// Only four distinct 5x5 filters remain, named here by the shape of
+// the same-color neighbors that they interpolate from.  The paper gives
+// them with weights summing to 8; they are doubled here so that every
+// weight is an integer, and the result is divided by 16 with rounding:
+//
+//   C  = center                      H1 = left + right
+//   H2 = two left + two right        V1 = up + down
+//   V2 = two up + two down           D  = the four diagonal neighbors
+//
+//   CROSS = 8C + 4(H1 + V1) - 2(H2 + V2)         G at R and B
+//   DIAG  = 12C + 4D - 3(H2 + V2)                R at B and B at R
+//   HORIZ = 10C + 8H1 - 2D - 2H2 + V2            R at G in an R row, B at G in a B row
+//   VERT  = 10C + 8V1 - 2D - 2V2 + H2            B at G in an R row, R at G in a B row
+//
+// (The caption in the paper is wrong for HORIZ: "R row B column" really
+// means R row G column.)  Every intermediate fits in 16 bits.
 
-// =====================================================================
-// Helper methods
-// =====================================================================
+/** Maps a doubled-weight filter response to an 8-bit value */
+static inline uint8 mhcRound(int sum) {
+    return uint8(iClamp((sum + 8) >> 4, 0, 255));
+}
 
 
-/** Applies a 5x5 filter to monochrome image I (wrapping at the boundaries) */
-static unorm8 applyFilter(const unorm8*    I,
-             int             x,
-             int             y,
-             int             w,
-             int             h,
-             const float     filter[5][5]) {
-    
-    debugAssert(isEven(w));
-    debugAssert(isEven(h));
-    
-    float sum = 0.0f;
-    float denom = 0.0f;
-    
-    for (int dy = 0; dy < 5; ++dy) {
-    int offset = ((y + dy + h - 2) % h) * w;
-    
-    for (int dx = 0; dx < 5; ++dx) {
-        float f = filter[dy][dx];
-        sum += f * (float)I[((x + dx + w - 2) % w) + offset];
-        denom += f;
-    }
+/** Demosaics the pixel at (x, y) of a Bayer image whose red samples
+    are at columns and rows with the parity of (redX, redY), wrapping
+    around the image at the boundaries. */
+static Color3unorm8 mhcPixel(const uint8* src, size_t stride, int w, int h, int redX, int redY, int x, int y) {
+    const int xm2 = (x + w - 2) % w, xm1 = (x + w - 1) % w, xp1 = (x + 1) % w, xp2 = (x + 2) % w;
+    const uint8* r0 = src + stride * ((y + h - 2) % h);
+    const uint8* r1 = src + stride * ((y + h - 1) % h);
+    const uint8* r2 = src + stride * y;
+    const uint8* r3 = src + stride * ((y + 1) % h);
+    const uint8* r4 = src + stride * ((y + 2) % h);
+
+    const int C  = r2[x];
+    const int H1 = r2[xm1] + r2[xp1];
+    const int H2 = r2[xm2] + r2[xp2];
+    const int V1 = r1[x] + r3[x];
+    const int V2 = r0[x] + r4[x];
+    const int D  = r1[xm1] + r1[xp1] + r3[xm1] + r3[xp1];
+
+    // Is this a red or blue sample (vs. green), and is it in a red row?
+    const bool redRow   = ((y ^ redY) & 1) == 0;
+    const bool onColor  = (((x ^ redX) & 1) == 0) == redRow;
+
+    // The row's own color, green, and the other color
+    int own, green, other;
+    if (onColor) {
+        own   = C << 4;
+        green = 8 * C + 4 * (H1 + V1) - 2 * (H2 + V2);
+        other = 12 * C + 4 * D - 3 * (H2 + V2);
+    } else {
+        own   = 10 * C + 8 * H1 - 2 * D - 2 * H2 + V2;
+        green = C << 4;
+        other = 10 * C + 8 * V1 - 2 * D - 2 * V2 + H2;
     }
-    
-    return unorm8(sum / denom);
-}
 
-/** Helper method for Bayer grbg and bggr --> rgb8 */
-static void swapRedAndBlue(int N, Color3unorm8* out) {
-    for (int i = N - 1; i >= 0; --i) {
-    unorm8 tmp = out[i].r;
-    out[i].r = out[i].b;
-    out[i].b = tmp;
+    Color3unorm8 c;
+    c.g = unorm8::fromBits(mhcRound(green));
+    if (redRow) {
+        c.r = unorm8::fromBits(mhcRound(own));
+        c.b = unorm8::fromBits(mhcRound(other));
+    } else {
+        c.r = unorm8::fromBits(mhcRound(other));
+        c.b = unorm8::fromBits(mhcRound(own));
     }
+    return c;
 }
 
 // RGB -> BAYER color space
 
 // =====================================================================
-// rgb8 --> bayer helpers
+// rgba32f (-->rgb8) --> bayer converter implementations
 // =====================================================================
-static void rgb8_to_bayer_rggb8(const int w, const int h, 
-                const unorm8* src, unorm8* dst) {
-    Color3unorm8* srcColor = (Color3unorm8*)src;
-    Color1unorm8* dstColor = (Color1unorm8*)dst;
-
-    // Top row pixels
-    for (int y = 0; y < h - 1; y += 2) {
-        int offset = y * w;
-
-        // Top left pixels
-        for(int x = 0; x < w - 1; x += 2) {
-            dstColor[x + offset] = Color1unorm8(srcColor[x + offset].r);
-        }
 
-        // Top right pixels
-        for(int x = 1; x < w - 1; x += 2) {
-            dstColor[x + offset] = Color1unorm8(srcColor[x + offset].g);
-        }
-        }
+/** Samples an RGBA32F image into an 8-bit Bayer image with red samples at
+    (redX, redY) mod 2 in the destination, one row at a time. */
+static void rgba32f_to_bayer8(int redX, int redY, const void* srcBytes, int srcWidth, int srcHeight,
+                              void* dstBytes, int dstRowPadBits, bool invertY) {
+    debugAssertM(dstRowPadBits % 8 == 0, "Destination row padding must be a multiple of 8 bits for this format");
 
-        // Bottom row pixels
-        for (int y = 1; y < h - 1; y += 2) {
-        int offset = y * w;
+    const size_t dstStride = size_t(srcWidth) + dstRowPadBits / 8;
+    Array<Color3unorm8> rgb;
+    rgb.resize(srcWidth);
 
-        // Bottom left pixels
-        for (int x = 0; x < w - 1; x += 2) {
-            dstColor[x + offset] = Color1unorm8(srcColor[x + offset].g);
-        }
+    for (int y = 0; y < srcHeight; ++y) {
+        const int srcY = invertY ? (srcHeight - 1 - y) : y;
+        rgba32f_to_rgb8(static_cast<const Color4*>(srcBytes) + size_t(srcWidth) * srcY, rgb.getCArray(), srcWidth);
 
-        // Bottom right pixels
-        for (int x = 1; x < w - 1; x += 2) {
-            dstColor[x + offset] = Color1unorm8(srcColor[x + offset].b);
+        uint8* dst = static_cast<uint8*>(dstBytes) + dstStride * y;
+        const bool redRow = ((y & 1) == redY);
+        for (int x = 0; x < srcWidth; ++x) {
+            const Color3unorm8& c = rgb[x];
+            if (((x & 1) == redX) == redRow) {
+                // Red in a red row, blue in a blue row
+                dst[x] = (redRow ? c.r : c.b).bits();
+            } else {
+                dst[x] = c.g.bits();
+            }
         }
     }
 }
 
-
-static void rgb8_to_bayer_grbg8(const int w, const int h, 
-                const unorm8* src, unorm8* dst) {
-    Color3unorm8* srcColor = (Color3unorm8*)src;
-    Color1unorm8* dstColor = (Color1unorm8*)dst;
-
-    // Top row pixels
-    for (int y = 0; y < h - 1; y += 2) {
-    int offset = y * w;
-
-    // Top left pixels
-    for (int x = 0; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].g);
-    }
-
-    // Top right pixels
-    for (int x = 1; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].r);
-    }
-    }
-
-    // Bottom row pixels
-    for (int y = 1; y < h - 1; y += 2) {
-    int offset = y * w;
-
-    // Bottom left pixels
-    for (int x = 0; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].b);
-    }
-
-    // Bottom right pixels
-    for (int x = 1; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].g);
-    }
-    }
-}
-
-
-static void rgb8_to_bayer_bggr8(const int w, const int h, 
-                const unorm8* src, unorm8* dst) {
-    Color3unorm8* srcColor = (Color3unorm8*)src;
-    Color1unorm8* dstColor = (Color1unorm8*)dst;
-
-    // Top row pixels
-    for (int y = 0; y < h - 1; y += 2) {
-    int offset = y * w;
-
-    // Top left pixels
-    for (int x = 0; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].b);
-    }
-
-    // Top right pixels
-    for (int x = 1; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].g);
-    }
-    }
-
-    // Bottom row pixels
-    for (int y = 1; y < h - 1; y += 2) {
-    int offset = y * w;
-
-    // Bottom left pixels
-    for(int x = 0; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].g);
-    }
-
-    // Bottom right pixels
-    for(int x = 1; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].r);
-    }
-    }
-}
-
-
-static void rgb8_to_bayer_gbrg8(const int w, const int h, 
-                const unorm8* src, unorm8* dst) {
-    Color3unorm8* srcColor = (Color3unorm8*)src;
-    Color1unorm8* dstColor = (Color1unorm8*)dst;
-
-    // Top row pixels
-    for(int y = 0; y < h - 1; y += 2) {
-    int offset = y * w;
-
-    // Top left pixels
-    for(int x = 0; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].g);
-    }
-
-    // Top right pixels
-    for(int x = 1; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].b);
-    }
-    }
-
-    // Bottom row pixels
-    for(int y = 1; y < h - 1; y += 2) {
-    int offset = y * w;
-
-    // Bottom left pixels
-    for(int x = 0; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].r);
-    }
-
-    // Bottom right pixels
-    for(int x = 1; x < w - 1; x += 2) {
-        dstColor[x + offset] = Color1unorm8(srcColor[x + offset].g);
-    }
-    }
-}
-
-// =====================================================================
-// rgba32f (-->rgb8) --> bayer converter implementations
-// =====================================================================
 static void rgba32f_to_bayer_rggb8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    Array<void*> tmp;
-    tmp.append(System::malloc(srcWidth * srcHeight * sizeof(Color3unorm8)));
-
-    rgba32f_to_rgb8(srcBytes, srcWidth, srcHeight, ImageFormat::RGBA32F(), 0, tmp, ImageFormat::RGB8(), 0, invertY, bayerAlg);
-    rgb8_to_bayer_rggb8(srcWidth, srcHeight, static_cast<unorm8*>(tmp[0]), static_cast<unorm8*>(dstBytes[0]));
-
-    System::free(tmp[0]);
+    (void)srcFormat; (void)srcRowPadBits; (void)dstFormat; (void)bayerAlg;
+    rgba32f_to_bayer8(0, 0, srcBytes[0], srcWidth, srcHeight, dstBytes[0], dstRowPadBits, invertY);
 }
 
 static void rgba32f_to_bayer_gbrg8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    Array<void*> tmp;
-    tmp.append(System::malloc(srcWidth * srcHeight * sizeof(Color3unorm8)));
-
-    rgba32f_to_rgb8(srcBytes, srcWidth, srcHeight, ImageFormat::RGBA32F(), 0, tmp, ImageFormat::RGB8(), 0, invertY, bayerAlg);
-    rgb8_to_bayer_grbg8(srcWidth, srcHeight, static_cast<unorm8*>(tmp[0]), static_cast<unorm8*>(dstBytes[0]));
-
-    System::free(tmp[0]);
+    (void)srcFormat; (void)srcRowPadBits; (void)dstFormat; (void)bayerAlg;
+    rgba32f_to_bayer8(0, 1, srcBytes[0], srcWidth, srcHeight, dstBytes[0], dstRowPadBits, invertY);
 }
 
 static void rgba32f_to_bayer_grbg8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    Array<void*> tmp;
-    tmp.append(System::malloc(srcWidth * srcHeight * sizeof(Color3unorm8)));
-
-    rgba32f_to_rgb8(srcBytes, srcWidth, srcHeight, ImageFormat::RGBA32F(), 0, tmp, ImageFormat::RGB8(), 0, invertY, bayerAlg);
-    rgb8_to_bayer_gbrg8(srcWidth, srcHeight, static_cast<unorm8*>(tmp[0]), static_cast<unorm8*>(dstBytes[0]));
-
-    System::free(tmp[0]);
+    (void)srcFormat; (void)srcRowPadBits; (void)dstFormat; (void)bayerAlg;
+    rgba32f_to_bayer8(1, 0, srcBytes[0], srcWidth, srcHeight, dstBytes[0], dstRowPadBits, invertY);
 }
 
 static void rgba32f_to_bayer_bggr8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    Array<void*> tmp;
-    tmp.append(System::malloc(srcWidth * srcHeight * sizeof(Color3unorm8)));
-
-    rgba32f_to_rgb8(srcBytes, srcWidth, srcHeight, ImageFormat::RGBA32F(), 0, tmp, ImageFormat::RGB8(), 0, invertY, bayerAlg);
-    rgb8_to_bayer_bggr8(srcWidth, srcHeight, static_cast<unorm8*>(tmp[0]), static_cast<unorm8*>(dstBytes[0]));
-
-    System::free(tmp[0]);
+    (void)srcFormat; (void)srcRowPadBits; (void)dstFormat; (void)bayerAlg;
+    rgba32f_to_bayer8(1, 1, srcBytes[0], srcWidth, srcHeight, dstBytes[0], dstRowPadBits, invertY);
 }
 
 // BAYER -> RGB color space
@@ -1034,274 +1068,246 @@ static void rgba32f_to_bayer_bggr8(const Array<const void*>& srcBytes, int srcWi
 // =====================================================================
 // bayer --> rgb8 helpers
 // =====================================================================
-static void bayer_rggb8_to_rgb8_mhc(int w, int h, 
-                    const unorm8* in, unorm8* _out) {
-    debugAssert(in != _out);
-
-    Color3unorm8* out = (Color3unorm8*)_out;
-
-    for (int y = 0; y < h; ++y) {
-
-    // Row beginning in the input array.
-    int offset = y * w;
 
-    // RG row
-    for (int x = 0; x < w; ++x, ++out) {
-        // R pixel
-        {
-        out->r = in[x + offset];
-        out->g = applyFilter(in, x, y, w, h, G_GRR);
-        out->b = applyFilter(in, x, y, w, h, B_GRR);
+#ifdef G3D_RUNTIME_SIMD
+
+/** Demosaics 16 pixels at a time of an interior row, starting at even
+    x = 2.  r points to the five source rows centered on this one.
+    Returns the first x that was not written; the caller finishes the
+    row and its borders with mhcPixel. */
+G3D_SSSE3_TARGET static int bayerMHCRow_ssse3(const uint8* const r[5], int w, bool redRow, bool colorAtEven, Color3unorm8* out) {
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(8);
+
+    // 0xFF in the bytes of red or blue samples
+    const __m128i onColor = colorAtEven ? _mm_set1_epi16(0x00FF) : _mm_set1_epi16(short(0xFF00));
+
+    // PSHUFB masks that interleave planar R, G, and B into 48 bytes
+    __m128i interleave[3][3];
+    for (int k = 0; k < 3; ++k) {
+        uint8 m[3][16];
+        for (int j = 0; j < 16; ++j) {
+            const int i = 16 * k + j;
+            for (int c = 0; c < 3; ++c) {
+                m[c][j] = (i % 3 == c) ? uint8(i / 3) : uint8(0x80);
+            }
         }
-        ++x; ++out;
-
-        // G pixel
-        {
-        out->r = applyFilter(in, x, y, w, h, R_GRG);
-        out->g = in[x + offset];
-        out->b = applyFilter(in, x, y, w, h, B_GRG);
+        for (int c = 0; c < 3; ++c) {
+            interleave[k][c] = _mm_loadu_si128((const __m128i*)m[c]);
         }
     }
 
-    ++y;
-    offset += w;
-
-    // GB row
-    for (int x = 0; x < w; ++x, ++out) {
-        // G pixel
-        {
-        out->r = applyFilter(in, x, y, w, h, R_BGG);
-        out->g = in[x + offset];
-        out->b = applyFilter(in, x, y, w, h, B_BGG);
+    int x = 2;
+    for (; x + 16 <= w - 2; x += 16) {
+        const __m128i c8    = _mm_loadu_si128((const __m128i*)(r[2] + x));
+        const __m128i l1    = _mm_loadu_si128((const __m128i*)(r[2] + x - 1));
+        const __m128i r1    = _mm_loadu_si128((const __m128i*)(r[2] + x + 1));
+        const __m128i l2    = _mm_loadu_si128((const __m128i*)(r[2] + x - 2));
+        const __m128i r2    = _mm_loadu_si128((const __m128i*)(r[2] + x + 2));
+        const __m128i u1    = _mm_loadu_si128((const __m128i*)(r[1] + x));
+        const __m128i d1    = _mm_loadu_si128((const __m128i*)(r[3] + x));
+        const __m128i u2    = _mm_loadu_si128((const __m128i*)(r[0] + x));
+        const __m128i d2    = _mm_loadu_si128((const __m128i*)(r[4] + x));
+        const __m128i ul    = _mm_loadu_si128((const __m128i*)(r[1] + x - 1));
+        const __m128i ur    = _mm_loadu_si128((const __m128i*)(r[1] + x + 1));
+        const __m128i dl    = _mm_loadu_si128((const __m128i*)(r[3] + x - 1));
+        const __m128i dr    = _mm_loadu_si128((const __m128i*)(r[3] + x + 1));
+
+        // Filter responses for the low and high eight pixels, in 16 bits
+        __m128i cross[2], diag[2], horiz[2], vert[2];
+        for (int half = 0; half < 2; ++half) {
+#           define WIDEN(v) (half ? _mm_unpackhi_epi8(v, zero) : _mm_unpacklo_epi8(v, zero))
+            const __m128i C   = WIDEN(c8);
+            const __m128i H1  = _mm_add_epi16(WIDEN(l1), WIDEN(r1));
+            const __m128i H2  = _mm_add_epi16(WIDEN(l2), WIDEN(r2));
+            const __m128i V1  = _mm_add_epi16(WIDEN(u1), WIDEN(d1));
+            const __m128i V2  = _mm_add_epi16(WIDEN(u2), WIDEN(d2));
+            const __m128i D   = _mm_add_epi16(_mm_add_epi16(WIDEN(ul), WIDEN(ur)), _mm_add_epi16(WIDEN(dl), WIDEN(dr)));
+#           undef WIDEN
+            const __m128i HV2 = _mm_add_epi16(H2, V2);
+            const __m128i C8  = _mm_slli_epi16(C, 3);
+            const __m128i C10 = _mm_add_epi16(C8, _mm_add_epi16(C, C));
+            const __m128i D2  = _mm_add_epi16(D, D);
+
+            // 8C + 4(H1 + V1) - 2(H2 + V2)
+            cross[half] = _mm_sub_epi16(_mm_add_epi16(C8, _mm_slli_epi16(_mm_add_epi16(H1, V1), 2)), _mm_add_epi16(HV2, HV2));
+
+            // 12C + 4D - 3(H2 + V2)
+            diag[half]  = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(C8, _mm_slli_epi16(C, 2)), _mm_slli_epi16(D, 2)), 
+                                        _mm_add_epi16(HV2, _mm_add_epi16(HV2, HV2)));
+
+            // 10C + 8H1 - 2D - 2H2 + V2
+            horiz[half] = _mm_add_epi16(_mm_sub_epi16(_mm_add_epi16(C10, _mm_slli_epi16(H1, 3)), _mm_add_epi16(D2, _mm_add_epi16(H2, H2))), V2);
+
+            // 10C + 8V1 - 2D - 2V2 + H2
+            vert[half]  = _mm_add_epi16(_mm_sub_epi16(_mm_add_epi16(C10, _mm_slli_epi16(V1, 3)), _mm_add_epi16(D2, _mm_add_epi16(V2, V2))), H2);
         }
-        ++x; ++out;
 
-        // B pixel
-        {
-        out->r = applyFilter(in, x, y, w, h, R_BGB);
-        out->g = applyFilter(in, x, y, w, h, G_BGB);
-        out->b = in[x + offset];
+#       define ROUND_PACK(v) _mm_packus_epi16(_mm_srai_epi16(_mm_add_epi16(v[0], round), 4), _mm_srai_epi16(_mm_add_epi16(v[1], round), 4))
+#       define SELECT(mask, a, b) _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b))
+        const __m128i own   = SELECT(onColor, c8, ROUND_PACK(horiz));
+        const __m128i green = SELECT(onColor, ROUND_PACK(cross), c8);
+        const __m128i other = SELECT(onColor, ROUND_PACK(diag), ROUND_PACK(vert));
+#       undef SELECT
+#       undef ROUND_PACK
+
+        const __m128i red  = redRow ? own : other;
+        const __m128i blue = redRow ? other : own;
+        __m128i* d = (__m128i*)(out + x);
+        for (int k = 0; k < 3; ++k) {
+            _mm_storeu_si128(d + k, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(red, interleave[k][0]), 
+                                                              _mm_shuffle_epi8(green, interleave[k][1])),
+                                                 _mm_shuffle_epi8(blue, interleave[k][2])));
         }
     }
-    }
+    return x;
 }
 
+#endif // G3D_RUNTIME_SIMD
+
+
+namespace _internal {
+
+/** Malvar-He-Cutler demosaicing of a Bayer image into RGB8 rows.  Rows
+    are independent, so bands of rows run on separate threads. */
+class BayerDemosaicer {
+public:
+    const uint8*        src;
+    size_t              srcStride;
+    int                 width;
+    int                 height;
+
+    /** Parity of the columns and rows that hold red samples */
+    int                 redX;
+    int                 redY;
+
+    uint8*              dst;
+    size_t              dstStride;
+    bool                invertY;
+
+    /** If not NULL, converts each RGB8 row to the destination format */
+    RowConvertFunc      rowConverter;
+
+    /** width pixels per thread, when rowConverter is not NULL */
+    Color3unorm8*       intermediate;
+
+    void demosaicRow(int y, int threadID) {
+        uint8* d = dst + dstStride * (invertY ? (height - 1 - y) : y);
+        Color3unorm8* out = rowConverter ? (intermediate + size_t(width) * threadID) : reinterpret_cast<Color3unorm8*>(d);
+        const bool redRow = ((y ^ redY) & 1) == 0;
+
+        // The SIMD loop handles the interior; mhcPixel handles the two
+        // pixels nearest each border, where the filter wraps
+        int x = 0;
+        int interiorEnd = 2;
+#       ifdef G3D_RUNTIME_SIMD
+        if ((y >= 2) && (y < height - 2) && System::hasSSSE3()) {
+            const uint8* r[5] = {src + srcStride * (y - 2), src + srcStride * (y - 1), src + srcStride * y, 
+                                 src + srcStride * (y + 1), src + srcStride * (y + 2)};
+            // Red or blue is at even x in a red row with red at even x, or in a blue row with red at odd x
+            interiorEnd = bayerMHCRow_ssse3(r, width, redRow, (redX == 0) == redRow, out);
+        }
+#       endif
 
-
-static void bayer_gbrg8_to_rgb8_mhc(int w, int h, 
-                    const unorm8* in, unorm8* _out) {
-
-    debugAssert(in != _out);
-
-    Color3unorm8* out = (Color3unorm8*)_out;
-
-    for (int y = 0; y < h; ++y) {
-
-    // Row beginning in the input array.
-    int offset = y * w;
-
-    // GB row
-    for (int x = 0; x < w; ++x, ++out) {
-        // G pixel
-        {
-        out->r = applyFilter(in, x, y, w, h, R_BGG);
-        out->g = in[x + offset];
-        out->b = applyFilter(in, x, y, w, h, B_BGG);
+        for (; x < 2; ++x) {
+            out[x] = mhcPixel(src, srcStride, width, height, redX, redY, x, y);
+        }
+        for (x = interiorEnd; x < width; ++x) {
+            out[x] = mhcPixel(src, srcStride, width, height, redX, redY, x, y);
         }
-        ++x; ++out;
 
-        // B pixel
-        {
-        out->r = applyFilter(in, x, y, w, h, R_BGB);
-        out->g = applyFilter(in, x, y, w, h, G_BGB);
-        out->b = in[x + offset];
+        if (rowConverter) {
+            rowConverter(out, d, width);
         }
     }
-    }
-}
+};
 
+} // namespace _internal
+
+
+/** Demosaics an 8-bit Bayer image with red samples at (redX, redY)
+    mod 2.  The result is RGB8, or is converted from RGB8 by \a rowConverter
+    one row at a time. */
+static void bayer8_to_rgb8_mhc(int redX, int redY, const void* srcBytes, int srcWidth, int srcHeight, int srcRowPadBits,
+                               RowConvertFunc rowConverter, void* dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY) {
+    debugAssertM(isEven(srcWidth) && isEven(srcHeight), "Bayer images must have even dimensions");
+    debugAssertM((srcRowPadBits % 8 == 0) && (dstRowPadBits % 8 == 0), "Row padding must be a multiple of 8 bits for this format");
+
+    _internal::BayerDemosaicer demosaicer;
+    demosaicer.src          = static_cast<const uint8*>(srcBytes);
+    demosaicer.srcStride    = size_t(srcWidth) + srcRowPadBits / 8;
+    demosaicer.width        = srcWidth;
+    demosaicer.height       = srcHeight;
+    demosaicer.redX         = redX;
+    demosaicer.redY         = redY;
+    demosaicer.dst          = static_cast<uint8*>(dstBytes);
+    demosaicer.dstStride    = (size_t(srcWidth) * dstFormat->cpuBitsPerPixel + dstRowPadBits) / 8;
+    demosaicer.invertY      = invertY;
+    demosaicer.rowConverter = rowConverter;
+
+    const int numThreads = (srcWidth * srcHeight >= MIN_PARALLEL_PIXELS) ? ThreadPool::numThreads() : 1;
+
+    Array<Color3unorm8> intermediate;
+    if (rowConverter) {
+        intermediate.resize(srcWidth * numThreads);
+    }
+    demosaicer.intermediate = intermediate.getCArray();
 
-static void bayer_grbg8_to_rgb8_mhc(int w, int h, 
-                    const unorm8* in, unorm8* _out) {
-    // Run the equivalent function for red
-    bayer_gbrg8_to_rgb8_mhc(w, h, in, _out);
+    if (numThreads == 1) {
+        for (int y = 0; y < srcHeight; ++y) {
+            demosaicer.demosaicRow(y, 0);
+        }
+    } else {
+        ThreadPool::parallelFor(0, srcHeight, &demosaicer, &_internal::BayerDemosaicer::demosaicRow, 
+                                iMax(1, PIXELS_PER_TILE / iMax(srcWidth, 1)), numThreads);
+    }
+}
 
-    // Now swap red and blue
-    swapRedAndBlue(w * h, (Color3unorm8*)_out);
+// =====================================================================
+// bayer --> rgb8 and rgba32f converter implementations
+// =====================================================================
+static void bayer_rggb8_to_rgb8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
+    (void)srcFormat; (void)bayerAlg;
+    bayer8_to_rgb8_mhc(0, 0, srcBytes[0], srcWidth, srcHeight, srcRowPadBits, NULL, dstBytes[0], dstFormat, dstRowPadBits, invertY);
 }
 
+static void bayer_gbrg8_to_rgb8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
+    (void)srcFormat; (void)bayerAlg;
+    bayer8_to_rgb8_mhc(0, 1, srcBytes[0], srcWidth, srcHeight, srcRowPadBits, NULL, dstBytes[0], dstFormat, dstRowPadBits, invertY);
+}
 
-static void bayer_bggr8_to_rgb8_mhc(int w, int h, 
-                    const unorm8* in, unorm8* _out) {
-    // Run the equivalent function for red
-    bayer_rggb8_to_rgb8_mhc(w, h, in, _out);
+static void bayer_grbg8_to_rgb8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
+    (void)srcFormat; (void)bayerAlg;
+    bayer8_to_rgb8_mhc(1, 0, srcBytes[0], srcWidth, srcHeight, srcRowPadBits, NULL, dstBytes[0], dstFormat, dstRowPadBits, invertY);
+}
 
-    // Now swap red and blue
-    swapRedAndBlue(w * h, (Color3unorm8*)_out);
+static void bayer_bggr8_to_rgb8(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
+    (void)srcFormat; (void)bayerAlg;
+    bayer8_to_rgb8_mhc(1, 1, srcBytes[0], srcWidth, srcHeight, srcRowPadBits, NULL, dstBytes[0], dstFormat, dstRowPadBits, invertY);
 }
 
-// =====================================================================
-// bayer (--> rgb8) --> rgba32f converter implementations
-// =====================================================================
 static void bayer_rggb8_to_rgba32f(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    Array<void*> tmp;
-    tmp.append(System::malloc(srcWidth * srcHeight * sizeof(Color3unorm8)));
-
-    bayer_rggb8_to_rgb8_mhc(srcWidth, srcHeight, static_cast<const unorm8*>(srcBytes[0]), static_cast<unorm8*>(tmp[0]));
-    rgb8_to_rgba32f(reinterpret_cast<Array<const void*>&>(tmp), srcWidth, srcHeight, ImageFormat::RGB8(), 0, dstBytes, ImageFormat::RGBA32F(), 0, invertY, bayerAlg);
-
-    System::free(tmp[0]);
+    (void)srcFormat; (void)bayerAlg;
+    bayer8_to_rgb8_mhc(0, 0, srcBytes[0], srcWidth, srcHeight, srcRowPadBits, rgb8_to_rgba32f, dstBytes[0], dstFormat, dstRowPadBits, invertY);
 }
 
 static void bayer_gbrg8_to_rgba32f(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    Array<void*> tmp;
-    tmp.append(System::malloc(srcWidth * srcHeight * sizeof(Color3unorm8)));
-
-    bayer_grbg8_to_rgb8_mhc(srcWidth, srcHeight, static_cast<const unorm8*>(srcBytes[0]), static_cast<unorm8*>(tmp[0]));
-    rgb8_to_rgba32f(reinterpret_cast<Array<const void*>&>(tmp), srcWidth, srcHeight, ImageFormat::RGB8(), 0, dstBytes, ImageFormat::RGBA32F(), 0, invertY, bayerAlg);
-
-    System::free(tmp[0]);
+    (void)srcFormat; (void)bayerAlg;
+    bayer8_to_rgb8_mhc(0, 1, srcBytes[0], srcWidth, srcHeight, srcRowPadBits, rgb8_to_rgba32f, dstBytes[0], dstFormat, dstRowPadBits, invertY);
 }
 
 static void bayer_grbg8_to_rgba32f(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    Array<void*> tmp;
-    tmp.append(System::malloc(srcWidth * srcHeight * sizeof(Color3unorm8)));
-
-    bayer_gbrg8_to_rgb8_mhc(srcWidth, srcHeight, static_cast<const unorm8*>(srcBytes[0]), static_cast<unorm8*>(tmp[0]));
-    rgb8_to_rgba32f(reinterpret_cast<Array<const void*>&>(tmp), srcWidth, srcHeight, ImageFormat::RGB8(), 0, dstBytes, ImageFormat::RGBA32F(), 0, invertY, bayerAlg);
-
-    System::free(tmp[0]);
+    (void)srcFormat; (void)bayerAlg;
+    bayer8_to_rgb8_mhc(1, 0, srcBytes[0], srcWidth, srcHeight, srcRowPadBits, rgb8_to_rgba32f, dstBytes[0], dstFormat, dstRowPadBits, invertY);
 }
 
 static void bayer_bggr8_to_rgba32f(const Array<const void*>& srcBytes, int srcWidth, int srcHeight, const ImageFormat* srcFormat, int srcRowPadBits, const Array<void*>& dstBytes, const ImageFormat* dstFormat, int dstRowPadBits, bool invertY, ImageFormat::BayerAlgorithm bayerAlg) {
-    Array<void*> tmp;
-    tmp.append(System::malloc(srcWidth * srcHeight * sizeof(Color3unorm8)));
-
-    bayer_bggr8_to_rgb8_mhc(srcWidth, srcHeight, static_cast<const unorm8*>(srcBytes[0]), static_cast<unorm8*>(tmp[0]));
-    rgb8_to_rgba32f(reinterpret_cast<Array<const void*>&>(tmp), srcWidth, srcHeight, ImageFormat::RGB8(), 0, dstBytes, ImageFormat::RGBA32F(), 0, invertY, bayerAlg);
-
-    System::free(tmp[0]);
+    (void)srcFormat; (void)bayerAlg;
+    bayer8_to_rgb8_mhc(1, 1, srcBytes[0], srcWidth, srcHeight, srcRowPadBits, rgb8_to_rgba32f, dstBytes[0], dstFormat, dstRowPadBits, invertY);
 }
 
 
 
-
-
-    // TODO: The following region is commented out because so far
-    // those conversions are not used anywhere else. Until it is
-    // decided that such conversions are not needed, this region
-    // remains commented out.
-
-
-// // =====================================================================
-// // bayer --> bgr8 
-// // =====================================================================
-
-// static void bayer_rggb8_to_bgr8_mhc(int w, int h, 
-//                     const unorm8* in, unorm8* _out) {
-//     debugAssert(in != _out);
-
-//     Color3unorm8* out = (Color3unorm8*)_out;
-
-//     for (int y = 0; y < h; ++y) {
-
-//     // Row beginning in the input array.
-//     int offset = y * w;
-
-//     // RG row
-//     for (int x = 0; x < w; ++x, ++out) {
-//         // R pixel
-//         {
-//         out->b = in[x + offset];
-//         out->g = applyFilter(in, x, y, w, h, G_GRR);
-//         out->r = applyFilter(in, x, y, w, h, B_GRR);
-//         }
-//         ++x; ++out;
-
-//         // G pixel
-//         {
-//         out->b = applyFilter(in, x, y, w, h, R_GRG);
-//         out->g = in[x + offset];
-//         out->r = applyFilter(in, x, y, w, h, B_GRG);
-//         }
-//     }
-
-//     ++y;
-//     offset += w;
-
-//     // GB row
-//     for (int x = 0; x < w; ++x, ++out) {
-//         // G pixel
-//         {
-//         out->b = applyFilter(in, x, y, w, h, R_BGG);
-//         out->g = in[x + offset];
-//         out->r = applyFilter(in, x, y, w, h, B_BGG);
-//         }
-//         ++x; ++out;
-
-//         // B pixel
-//         {
-//         out->b = applyFilter(in, x, y, w, h, R_BGB);
-//         out->g = applyFilter(in, x, y, w, h, G_BGB);
-//         out->r = in[x + offset];
-//         }
-//     }
-//     }
-// }
-
-
-// static void bayer_gbrg8_to_bgr8_mhc(int w, int h, 
-//                     const unorm8* in, unorm8* _out) {
-
-//     debugAssert(in != _out);
-
-//     Color3unorm8* out = (Color3unorm8*)_out;
-
-//     for (int y = 0; y < h; ++y) {
-
-//     // Row beginning in the input array.
-//     int offset = y * w;
-
-//     // GB row
-//     for (int x = 0; x < srcWidth; ++x, ++out) {
-//         // G pixel
-//         {
-//         out->b = applyFilter(in, x, y, w, h, R_BGG);
-//         out->g = in[x + offset];
-//         out->r = applyFilter(in, x, y, w, h, B_BGG);
-//         }
-//         ++x; ++out;
-
-//         // B pixel
-//         {
-//         out->b = applyFilter(in, x, y, w, h, R_BGB);
-//         out->g = applyFilter(in, x, y, w, h, G_BGB);
-//         out->r = in[x + offset];
-//         }
-//     }
-//     }
-// }
-
-// static void bayer_grbg8_to_bgr8_mhc(int w, int h, 
-//                     const unorm8* in, unorm8* _out) {
-//     // Run the equivalent function for red
-//     bayer_gbrg8_to_bgr8_mhc(w, h, in, _out);
-
-//     // Now swap red and blue
-//     swapRedAndBlue(srcWidth * h, (Color3unorm8*)_out);
-// }
-
-// static void bayer_bggr8_to_bgr8_mhc(int w, int h, 
-//                     const unorm8* in, unorm8* _out) {
-//     // Run the equivalent function for red
-//     bayer_rggb8_to_bgr8_mhc(w, h, in, _out);
-
-//     // Now swap red and blue
-//     swapRedAndBlue(srcWidth * h, (Color3unorm8*)_out);
-// }
-
-
-
 ///////////////////////////////////////////////////
 
 } // namespace G3D
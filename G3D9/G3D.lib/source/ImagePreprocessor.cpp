@@ -0,0 +1,593 @@
+/**
+  \file G3D/ImagePreprocessor.cpp
+
+  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+  \created 2026-10-17
+  \edited  2026-10-17
+*/
+
+#include "G3D/ImagePreprocessor.h"
+#include "G3D/ImageFormat.h"
+#include "G3D/Color4unorm8.h"
+#include "G3D/Vector3.h"
+#include "G3D/ThreadPool.h"
+#include "G3D/System.h"
+#include "G3D/g3dmath.h"
+#include "G3D/SSEUtil.h"
+
+namespace G3D {
+
+// Bands of a normal map also read the row above and below, so keep them tall
+static const int MIN_NORMAL_MAP_BAND_ROWS = 16;
+
+
+/** How the channels of a directly-processed format are stored */
+class PixelLayout {
+public:
+    /** 0 for formats processed through RGBA32F */
+    int             channels;
+
+    /** 32-bit float channels if true, otherwise 8-bit normalized */
+    bool            floatingPoint;
+
+    /** L or LA */
+    bool            luminance;
+
+    explicit PixelLayout(const ImageFormat* format) : channels(0), floatingPoint(false), luminance(false) {
+        switch (format->code) {
+        case ImageFormat::CODE_R8:      channels = 1; break;
+        case ImageFormat::CODE_RG8:     channels = 2; break;
+        case ImageFormat::CODE_RGB8:    channels = 3; break;
+        case ImageFormat::CODE_RGBA8:   channels = 4; break;
+        case ImageFormat::CODE_L8:      channels = 1; luminance = true; break;
+        case ImageFormat::CODE_LA8:     channels = 2; luminance = true; break;
+        case ImageFormat::CODE_R32F:    channels = 1; floatingPoint = true; break;
+        case ImageFormat::CODE_RG32F:   channels = 2; floatingPoint = true; break;
+        case ImageFormat::CODE_RGB32F:  channels = 3; floatingPoint = true; break;
+        case ImageFormat::CODE_RGBA32F: channels = 4; floatingPoint = true; break;
+        case ImageFormat::CODE_L32F:    channels = 1; floatingPoint = true; luminance = true; break;
+        case ImageFormat::CODE_LA32F:   channels = 2; floatingPoint = true; luminance = true; break;
+        default:;
+        }
+    }
+
+    /** Index into a Color4 (e.g., Settings::modulate) of stored channel \a c */
+    int colorIndex(int c) const {
+        return (luminance && (c == 1)) ? 3 : c;
+    }
+
+    /** Expands per-channel values to RGBA the way conversion to RGBA32F does */
+    Color4 expand(const float* v) const {
+        if (channels == 0) {
+            return Color4(v[0], v[1], v[2], v[3]);
+        } else if (luminance) {
+            return Color4(v[0], v[0], v[0], (channels == 2) ? v[1] : 1.0f);
+        } else {
+            return Color4(v[0], (channels > 1) ? v[1] : 0.0f, (channels > 2) ? v[2] : 0.0f, (channels > 3) ? v[3] : 1.0f);
+        }
+    }
+};
+
+
+namespace _internal {
+
+/** Statistics of up to four channels over one band */
+class BandStats {
+public:
+    float           minval[4];
+    float           maxval[4];
+    double          sum[4];
+
+    BandStats() {
+        for (int c = 0; c < 4; ++c) {
+            minval[c] = finf();
+            maxval[c] = -finf();
+            sum[c]    = 0.0;
+        }
+    }
+
+    void merge(const BandStats& other) {
+        for (int c = 0; c < 4; ++c) {
+            minval[c] = min(minval[c], other.minval[c]);
+            maxval[c] = max(maxval[c], other.maxval[c]);
+            sum[c]   += other.sum[c];
+        }
+    }
+};
+
+} // namespace _internal
+
+
+/** Merges \a n interleaved 8-bit values with \a channels channels into \a stats, on a unit scale */
+static void byteStats_scalar(const uint8* p, size_t n, int channels, _internal::BandStats& stats) {
+    int mn[4] = {255, 255, 255, 255};
+    int mx[4] = {0, 0, 0, 0};
+    uint64 sum[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < n; i += channels) {
+        for (int c = 0; c < channels; ++c) {
+            const int v = p[i + c];
+            mn[c] = iMin(mn[c], v);
+            mx[c] = iMax(mx[c], v);
+            sum[c] += v;
+        }
+    }
+    for (int c = 0; c < channels; ++c) {
+        stats.minval[c] = min(stats.minval[c], mn[c] * (1.0f / 255.0f));
+        stats.maxval[c] = max(stats.maxval[c], mx[c] * (1.0f / 255.0f));
+        stats.sum[c]   += double(sum[c]) / 255.0;
+    }
+}
+
+
+static void floatStats_scalar(const float* p, size_t n, int channels, _internal::BandStats& stats) {
+    for (size_t i = 0; i < n; i += channels) {
+        for (int c = 0; c < channels; ++c) {
+            const float v = p[i + c];
+            stats.minval[c] = min(stats.minval[c], v);
+            stats.maxval[c] = max(stats.maxval[c], v);
+            stats.sum[c]   += v;
+        }
+    }
+}
+
+
+#ifdef G3D_RUNTIME_SIMD
+
+// The SSE2 loops step through 48 bytes or 12 floats at a time: three
+// registers in which each lane always holds the same channel, because
+// 48 and 12 are multiples of every channel count.
+
+G3D_SSE2_TARGET static void byteStats_sse2(const uint8* p, size_t n, int channels, _internal::BandStats& stats) {
+    const size_t numChunks = n / 48;
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i mn[3], mx[3], sum32[3][4];
+    for (int k = 0; k < 3; ++k) {
+        mn[k] = _mm_set1_epi8(char(0xFF));
+        mx[k] = zero;
+        for (int q = 0; q < 4; ++q) {
+            sum32[k][q] = zero;
+        }
+    }
+
+    size_t chunk = 0;
+    while (chunk < numChunks) {
+        // 16-bit sums of at most 256 bytes cannot overflow
+        const size_t end = min(numChunks, chunk + 256);
+        __m128i sum16[3][2];
+        for (int k = 0; k < 3; ++k) {
+            sum16[k][0] = sum16[k][1] = zero;
+        }
+        for (; chunk < end; ++chunk) {
+            const __m128i* src = reinterpret_cast<const __m128i*>(p + 48 * chunk);
+            for (int k = 0; k < 3; ++k) {
+                const __m128i v = _mm_loadu_si128(src + k);
+                mn[k] = _mm_min_epu8(mn[k], v);
+                mx[k] = _mm_max_epu8(mx[k], v);
+                sum16[k][0] = _mm_add_epi16(sum16[k][0], _mm_unpacklo_epi8(v, zero));
+                sum16[k][1] = _mm_add_epi16(sum16[k][1], _mm_unpackhi_epi8(v, zero));
+            }
+        }
+        for (int k = 0; k < 3; ++k) {
+            sum32[k][0] = _mm_add_epi32(sum32[k][0], _mm_unpacklo_epi16(sum16[k][0], zero));
+            sum32[k][1] = _mm_add_epi32(sum32[k][1], _mm_unpackhi_epi16(sum16[k][0], zero));
+            sum32[k][2] = _mm_add_epi32(sum32[k][2], _mm_unpacklo_epi16(sum16[k][1], zero));
+            sum32[k][3] = _mm_add_epi32(sum32[k][3], _mm_unpackhi_epi16(sum16[k][1], zero));
+        }
+    }
+
+    if (numChunks > 0) {
+        // Lane i of each array is byte i of the 48-byte chunk
+        uint8  laneMin[48], laneMax[48];
+        uint32 laneSum[48];
+        for (int k = 0; k < 3; ++k) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(laneMin + 16 * k), mn[k]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(laneMax + 16 * k), mx[k]);
+            for (int q = 0; q < 4; ++q) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(laneSum + 16 * k + 4 * q), sum32[k][q]);
+            }
+        }
+        for (int i = 0; i < 48; ++i) {
+            const int c = i % channels;
+            stats.minval[c] = min(stats.minval[c], laneMin[i] * (1.0f / 255.0f));
+            stats.maxval[c] = max(stats.maxval[c], laneMax[i] * (1.0f / 255.0f));
+            stats.sum[c]   += laneSum[i] / 255.0;
+        }
+    }
+
+    byteStats_scalar(p + 48 * numChunks, n - 48 * numChunks, channels, stats);
+}
+
+
+G3D_SSE2_TARGET static void floatStats_sse2(const float* p, size_t n, int channels, _internal::BandStats& stats) {
+    const size_t numChunks = n / 12;
+    if (numChunks > 0) {
+        __m128 mn[3], mx[3], sum[3];
+        for (int k = 0; k < 3; ++k) {
+            mn[k]  = _mm_set1_ps(finf());
+            mx[k]  = _mm_set1_ps(-finf());
+            sum[k] = _mm_setzero_ps();
+        }
+        for (size_t chunk = 0; chunk < numChunks; ++chunk) {
+            for (int k = 0; k < 3; ++k) {
+                const __m128 v = _mm_loadu_ps(p + 12 * chunk + 4 * k);
+                mn[k]  = _mm_min_ps(mn[k], v);
+                mx[k]  = _mm_max_ps(mx[k], v);
+                sum[k] = _mm_add_ps(sum[k], v);
+            }
+        }
+
+        float laneMin[12], laneMax[12], laneSum[12];
+        for (int k = 0; k < 3; ++k) {
+            _mm_storeu_ps(laneMin + 4 * k, mn[k]);
+            _mm_storeu_ps(laneMax + 4 * k, mx[k]);
+            _mm_storeu_ps(laneSum + 4 * k, sum[k]);
+        }
+        for (int i = 0; i < 12; ++i) {
+            const int c = i % channels;
+            stats.minval[c] = min(stats.minval[c], laneMin[i]);
+            stats.maxval[c] = max(stats.maxval[c], laneMax[i]);
+            stats.sum[c]   += laneSum[i];
+        }
+    }
+
+    floatStats_scalar(p + 12 * numChunks, n - 12 * numChunks, channels, stats);
+}
+
+#endif // G3D_RUNTIME_SIMD
+
+
+static void byteStats(const uint8* p, size_t n, int channels, _internal::BandStats& stats) {
+#   ifdef G3D_RUNTIME_SIMD
+    if (System::hasSSE2()) {
+        byteStats_sse2(p, n, channels, stats);
+        return;
+    }
+#   endif
+    byteStats_scalar(p, n, channels, stats);
+}
+
+
+static void floatStats(const float* p, size_t n, int channels, _internal::BandStats& stats) {
+#   ifdef G3D_RUNTIME_SIMD
+    if (System::hasSSE2()) {
+        floatStats_sse2(p, n, channels, stats);
+        return;
+    }
+#   endif
+    floatStats_scalar(p, n, channels, stats);
+}
+
+
+/** Looks up each channel of \a n interleaved bytes in its own table */
+template<int channels>
+static void adjustBytes(const uint8* src, size_t n, const uint8 (*table)[256], uint8* dst) {
+    for (size_t i = 0; i < n; i += channels) {
+        for (int c = 0; c < channels; ++c) {
+            dst[i + c] = table[c][src[i + c]];
+        }
+    }
+}
+
+
+namespace _internal {
+
+/** One call to ImagePreprocessor::apply, processed in bands of rows */
+class ImagePreprocessJob {
+public:
+    const uint8*            src;
+    const ImageFormat*      format;
+    PixelLayout             layout;
+    int                     width;
+    int                     height;
+    size_t                  rowBytes;
+
+    /** Adjusted image, or NULL if not writing one */
+    uint8*                  dst;
+
+    /** Normal map, or NULL if not computing one */
+    Color4unorm8*           normal;
+
+    bool                    adjust;
+    Color4                  modulate;
+    float                   gamma;
+
+    /** Adjustment of each 8-bit stored channel */
+    uint8                   table[4][256];
+
+    bool                    computeStats;
+    Array<BandStats>        bandStats;
+
+    /** Normal map constants; see BumpMap::computeNormalMap */
+    float                   elevationInvScale;
+    bool                    lowPassFilter;
+    bool                    scaleZByNz;
+
+    int                     rowsPerBand;
+
+    /** Per-thread RGBA32F row and normal map heights */
+    Array<float>            scratch;
+    int                     scratchPerThread;
+
+    ImagePreprocessJob(const void* s, int w, int h, const ImageFormat* f, const ImagePreprocessor::Settings& settings) :
+        src(static_cast<const uint8*>(s)), format(f), layout(f), width(w), height(h),
+        rowBytes(size_t(w) * f->cpuBitsPerPixel / 8), dst(NULL), normal(NULL),
+        adjust(settings.adjustsColor()), modulate(settings.modulate), gamma(settings.gammaAdjust),
+        computeStats(settings.computeMinMaxMean), elevationInvScale(0), lowPassFilter(false),
+        scaleZByNz(false), rowsPerBand(1), scratchPerThread(0) {
+
+        if (adjust && (layout.channels > 0) && ! layout.floatingPoint) {
+            for (int c = 0; c < layout.channels; ++c) {
+                const float m = modulate[layout.colorIndex(c)];
+                for (int i = 0; i < 256; ++i) {
+                    const float s = pow((i * m) / 255.0f, gamma) * 255;
+                    table[c][i] = uint8(iClamp(iRound(s), 0, 255));
+                }
+            }
+        }
+
+        if (settings.computeNormalMap) {
+            const BumpMapPreprocess& bump = settings.bumpMapPreprocess;
+            float whiteHeightInPixels = bump.zExtentPixels;
+            if (whiteHeightInPixels < 0.0f) {
+                // Scale so that a gradient ramp over the whole image becomes a 45-degree angle
+                whiteHeightInPixels = max(width, height) * -whiteHeightInPixels;
+            }
+            debugAssert(whiteHeightInPixels >= 0);
+            elevationInvScale = 255.0f / whiteHeightInPixels;
+            lowPassFilter     = bump.lowPassFilter;
+            scaleZByNz        = bump.scaleZByNz;
+        }
+    }
+
+    /** Applies modulate and gamma to one floating-point value */
+    float adjustValue(float v, float m) const {
+        v *= m;
+        return ((gamma != 1.0f) && (v > 0.0f)) ? pow(v, gamma) : v;
+    }
+
+    float* threadScratch(int threadID) {
+        return scratch.getCArray() + size_t(scratchPerThread) * threadID;
+    }
+
+    /** Adjusts one row through RGBA32F into \a rgba */
+    void adjustRowGeneric(int y, Color4* rgba) const {
+        ImageFormat::convertRow(src + rowBytes * y, format, rgba, ImageFormat::RGBA32F(), width);
+        if (adjust) {
+            for (int x = 0; x < width; ++x) {
+                Color4& c = rgba[x];
+                c = Color4(adjustValue(c.r, modulate.r), adjustValue(c.g, modulate.g),
+                           adjustValue(c.b, modulate.b), adjustValue(c.a, modulate.a));
+            }
+        }
+    }
+
+    /** Writes the adjusted first channel of row \a y, scaled so that 1.0 is 255 */
+    void heightRow(int y, float* h, Color4* rgba) const {
+        const int channels = layout.channels;
+        if (channels == 0) {
+            adjustRowGeneric(y, rgba);
+            for (int x = 0; x < width; ++x) {
+                h[x] = rgba[x].r * 255.0f;
+            }
+        } else if (layout.floatingPoint) {
+            const float* p = reinterpret_cast<const float*>(src + rowBytes * y);
+            for (int x = 0; x < width; ++x) {
+                h[x] = (adjust ? adjustValue(p[x * channels], modulate.r) : p[x * channels]) * 255.0f;
+            }
+        } else {
+            const uint8* p = src + rowBytes * y;
+            for (int x = 0; x < width; ++x) {
+                h[x] = adjust ? table[0][p[x * channels]] : p[x * channels];
+            }
+        }
+    }
+
+    void colorBand(int y0, int y1, BandStats& stats, int threadID) {
+        const int channels = layout.channels;
+        const size_t n = size_t(y1 - y0) * width * channels;
+
+        if (channels == 0) {
+            Color4* rgba = reinterpret_cast<Color4*>(threadScratch(threadID));
+            for (int y = y0; y < y1; ++y) {
+                adjustRowGeneric(y, rgba);
+                if (computeStats) {
+                    floatStats(reinterpret_cast<const float*>(rgba), size_t(width) * 4, 4, stats);
+                }
+                if (dst) {
+                    ImageFormat::convertRow(rgba, ImageFormat::RGBA32F(), dst + rowBytes * y, format, width);
+                }
+            }
+
+        } else if (layout.floatingPoint) {
+            const float* in = reinterpret_cast<const float*>(src + rowBytes * y0);
+            if (adjust) {
+                float* out = reinterpret_cast<float*>(dst + rowBytes * y0);
+                float m[4];
+                for (int c = 0; c < channels; ++c) {
+                    m[c] = modulate[layout.colorIndex(c)];
+                }
+                for (size_t i = 0; i < n; i += channels) {
+                    for (int c = 0; c < channels; ++c) {
+                        out[i + c] = adjustValue(in[i + c], m[c]);
+                    }
+                }
+                in = out;
+            }
+            if (computeStats) {
+                floatStats(in, n, channels, stats);
+            }
+
+        } else {
+            const uint8* in = src + rowBytes * y0;
+            if (adjust) {
+                uint8* out = dst + rowBytes * y0;
+                switch (channels) {
+                case 1:  adjustBytes<1>(in, n, table, out); break;
+                case 2:  adjustBytes<2>(in, n, table, out); break;
+                case 3:  adjustBytes<3>(in, n, table, out); break;
+                default: adjustBytes<4>(in, n, table, out); break;
+                }
+                in = out;
+            }
+            if (computeStats) {
+                byteStats(in, n, channels, stats);
+            }
+        }
+    }
+
+    void normalBand(int y0, int y1, BandStats& stats, int threadID) {
+        const int w = width;
+        float* heights = threadScratch(threadID);
+        Color4* rgba = reinterpret_cast<Color4*>(heights + size_t(rowsPerBand + 2) * w);
+
+        // Heights of rows y0 - 1 through y1, wrapping around the image
+        for (int r = 0; r < y1 - y0 + 2; ++r) {
+            const int y = ((y0 - 1 + r) % height + height) % height;
+            heightRow(y, heights + size_t(r) * w, rgba);
+        }
+
+        // The scale of each filter row is 4, the filter width is two pixels,
+        // and the "normal" range is 0-255.
+        const float z = 4 * 2 * elevationInvScale;
+
+        for (int y = y0; y < y1; ++y) {
+            const float* up   = heights + size_t(y - y0) * w;
+            const float* mid  = up + w;
+            const float* down = mid + w;
+            Color4unorm8* N   = normal + size_t(y) * w;
+
+            for (int x = 0; x < w; ++x) {
+                const int xl = (x == 0) ? (w - 1) : (x - 1);
+                const int xr = (x == w - 1) ? 0 : (x + 1);
+
+                // Sobel filter.  Y is written directly into the
+                // x-component so that no cross product is needed.
+                //
+                //  [ -1 -2 -1 ]
+                //  [  0  0  0 ]
+                //  [  1  2  1 ]
+                Vector3 delta;
+                delta.y = -(up[xl] + up[x] * 2 + up[xr] - down[xl] - down[x] * 2 - down[xr]);
+                delta.x = -(-up[xl] + up[xr] - mid[xl] * 2 + mid[xr] * 2 - down[xl] + down[xr]);
+                delta.z = z;
+                delta = delta.direction();
+
+                float H;
+                if (lowPassFilter) {
+                    H = (up[xl] + up[x] + up[xr] + mid[xl] + mid[x] + mid[xr] + down[xl] + down[x] + down[xr]) / (255.0f * 9.0f);
+                } else {
+                    H = mid[x] * (1.0f / 255.0f);
+                }
+
+                if (scaleZByNz) {
+                    // delta.z cannot be negative
+                    H *= delta.z;
+                }
+
+                // Pack into byte range
+                delta = delta * 0.5f + Vector3(0.5f, 0.5f, 0.5f);
+                N[x] = Color4unorm8(unorm8(delta.x), unorm8(delta.y), unorm8(delta.z), unorm8(H));
+            }
+        }
+
+        if (computeStats) {
+            byteStats(reinterpret_cast<const uint8*>(normal + size_t(y0) * w), size_t(y1 - y0) * w * 4, 4, stats);
+        }
+    }
+
+    void processBand(int band, int threadID) {
+        const int y0 = band * rowsPerBand;
+        const int y1 = min(height, y0 + rowsPerBand);
+        if (normal) {
+            normalBand(y0, y1, bandStats[band], threadID);
+        } else {
+            colorBand(y0, y1, bandStats[band], threadID);
+        }
+    }
+
+    void run() {
+        const int numThreads = (width * height >= MIN_PARALLEL_PIXELS) ? ThreadPool::numThreads() : 1;
+
+        rowsPerBand = iMax(1, PIXELS_PER_TILE / width);
+        if (normal) {
+            rowsPerBand = iMax(rowsPerBand, MIN_NORMAL_MAP_BAND_ROWS);
+        }
+        const int numBands = (height + rowsPerBand - 1) / rowsPerBand;
+        bandStats.resize(numBands);
+
+        // Room for an RGBA32F row, plus heights for a normal map band
+        scratchPerThread = 4 * width + (normal ? (rowsPerBand + 2) * width : 0);
+        scratch.resize(scratchPerThread * numThreads);
+
+        if (numThreads == 1) {
+            for (int b = 0; b < numBands; ++b) {
+                processBand(b, 0);
+            }
+        } else {
+            ThreadPool::parallelFor(0, numBands, this, &ImagePreprocessJob::processBand, 1, numThreads);
+        }
+    }
+};
+
+} // namespace _internal
+
+
+bool ImagePreprocessor::supports(const ImageFormat* format) {
+    return (! format->compressed) &&
+        ((PixelLayout(format).channels > 0) ||
+         (ImageFormat::conversionAvailable(format, 0, ImageFormat::RGBA32F(), 0) &&
+          ImageFormat::conversionAvailable(ImageFormat::RGBA32F(), 0, format, 0)));
+}
+
+
+ImageBuffer::Ref ImagePreprocessor::apply
+(const void*                    src,
+ int                            width,
+ int                            height,
+ const ImageFormat*             format,
+ const Settings&                settings,
+ Stats&                         stats) {
+
+    stats = Stats();
+    if (! supports(format) || (width <= 0) || (height <= 0)) {
+        return NULL;
+    }
+
+    _internal::ImagePreprocessJob job(src, width, height, format, settings);
+
+    ImageBuffer::Ref result;
+    if (settings.computeNormalMap) {
+        result = ImageBuffer::create(width, height, ImageFormat::RGBA8());
+        job.normal = static_cast<Color4unorm8*>(result->buffer());
+    } else if (job.adjust) {
+        result = ImageBuffer::create(width, height, format);
+        job.dst = static_cast<uint8*>(result->buffer());
+    } else if (! settings.computeMinMaxMean) {
+        return NULL;
+    }
+
+    job.run();
+
+    if (settings.computeMinMaxMean) {
+        _internal::BandStats total;
+        for (int b = 0; b < job.bandStats.size(); ++b) {
+            total.merge(job.bandStats[b]);
+        }
+
+        // Normal maps and RGBA32F rows have four channels in order
+        const PixelLayout& layout = (settings.computeNormalMap ? PixelLayout(ImageFormat::RGBA8()) : job.layout);
+        float mean[4];
+        for (int c = 0; c < 4; ++c) {
+            mean[c] = float(total.sum[c] / (double(width) * height));
+        }
+        stats.minval  = layout.expand(total.minval);
+        stats.maxval  = layout.expand(total.maxval);
+        stats.meanval = layout.expand(mean);
+    }
+
+    return result;
+}
+
+} // namespace G3D
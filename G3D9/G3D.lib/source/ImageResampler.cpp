@@ -0,0 +1,568 @@
+/**
+  \file G3D/ImageResampler.cpp
+
+  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+  \created 2026-10-17
+  \edited  2026-10-17
+*/
+
+#include "G3D/ImageResampler.h"
+#include "G3D/ImageFormat.h"
+#include "G3D/Color4.h"
+#include "G3D/ThreadPool.h"
+#include "G3D/System.h"
+#include "G3D/g3dmath.h"
+#include "G3D/SSEUtil.h"
+#include <algorithm>
+
+namespace G3D {
+
+static float sinc(float x) {
+    if (fabs(x) < 1e-6f) {
+        return 1.0f;
+    }
+    x *= pif();
+    return sinf(x) / x;
+}
+
+
+/** Modified Bessel function of the first kind, order zero */
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    const double q = x * x / 4.0;
+    for (int k = 1; term > sum * 1e-12; ++k) {
+        term *= q / (double(k) * double(k));
+        sum += term;
+    }
+    return sum;
+}
+
+
+/** Radius of the filter kernel at unit scale */
+static float filterRadius(ImageResampler::Filter filter) {
+    return (filter == ImageResampler::Filter::BOX) ? 0.5f : 3.0f;
+}
+
+
+static float evaluateFilter(ImageResampler::Filter filter, float x) {
+    switch (filter) {
+    case ImageResampler::Filter::BOX:
+        return ((x >= -0.5f) && (x < 0.5f)) ? 1.0f : 0.0f;
+
+    case ImageResampler::Filter::LANCZOS3:
+        return (fabs(x) < 3.0f) ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+
+    case ImageResampler::Filter::KAISER:
+        {
+            static const double alpha = 4.0;
+            static const double normalization = 1.0 / besselI0(alpha);
+            const float t = x / 3.0f;
+            if (fabs(t) >= 1.0f) {
+                return 0.0f;
+            }
+            return sinc(x) * float(besselI0(alpha * sqrt(1.0 - t * t)) * normalization);
+        }
+
+    default:
+        debugAssertM(false, "Unknown filter");
+        return 0.0f;
+    }
+}
+
+
+/** sRGB <-> linear for 8-bit channels */
+class SRGBTable {
+public:
+    /** Linear value of each 8-bit code */
+    float       toLinear[256];
+
+    /** threshold[c] is the smallest linear value that encodes to code c + 1 */
+    float       threshold[255];
+
+    enum {NUM_BUCKETS = 4096};
+
+    /** bucket[i] is the code of linear value i / NUM_BUCKETS.  The sRGB
+        curve rises by less than one code across each bucket. */
+    uint8       bucket[NUM_BUCKETS + 1];
+
+    SRGBTable() {
+        for (int c = 0; c < 256; ++c) {
+            toLinear[c] = decode(c / 255.0);
+        }
+        for (int c = 0; c < 255; ++c) {
+            threshold[c] = decode((c + 0.5) / 255.0);
+        }
+        for (int i = 0; i <= NUM_BUCKETS; ++i) {
+            bucket[i] = uint8(std::upper_bound(threshold, threshold + 255, float(i) / NUM_BUCKETS) - threshold);
+        }
+    }
+
+    static float decode(double v) {
+        return float((v <= 0.04045) ? (v / 12.92) : pow((v + 0.055) / 1.055, 2.4));
+    }
+
+    /** Returns the 8-bit sRGB code for linear \a v */
+    uint8 encode(float v) const {
+        v = clamp(v, 0.0f, 1.0f);
+        int c = bucket[int(v * NUM_BUCKETS)];
+        while ((c < 255) && (threshold[c] <= v)) {
+            ++c;
+        }
+        return uint8(c);
+    }
+
+    /** Returns the 8-bit sRGB code for linear \a v, as a float on [0, 1] */
+    float fromLinear(float v) const {
+        return encode(v) * (1.0f / 255.0f);
+    }
+
+    static const SRGBTable& instance() {
+        static const SRGBTable table;
+        return table;
+    }
+};
+
+
+/** 3 or 4 for RGB8 and RGBA8, whose bytes the sRGB paths read and write directly, otherwise 0 */
+static int byteChannels(const ImageFormat* format) {
+    switch (format->code) {
+    case ImageFormat::CODE_RGB8:
+        return 3;
+    case ImageFormat::CODE_RGBA8:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+
+namespace _internal {
+
+/** Filter taps for every destination pixel along one axis.  Taps that
+    fall off the edge of the image are folded onto the edge pixel, so
+    each destination pixel reads count[i] consecutive source pixels
+    beginning at first[i]. */
+class ResampleAxis {
+public:
+    /** Stride of weight */
+    int             taps;
+    Array<int>      first;
+    Array<int>      count;
+    Array<float>    weight;
+
+    ResampleAxis(int srcSize, int dstSize, ImageResampler::Filter filter) {
+        const float scale       = float(dstSize) / float(srcSize);
+
+        // Widen the filter when minifying so that it removes the
+        // frequencies that the destination cannot represent
+        const float filterScale = max(1.0f, 1.0f / scale);
+        const float radius      = filterRadius(filter) * filterScale;
+
+        taps = iCeil(2.0f * radius) + 1;
+        first.resize(dstSize);
+        count.resize(dstSize);
+        weight.resize(dstSize * taps);
+
+        for (int i = 0; i < dstSize; ++i) {
+            // Center of destination pixel i in source pixel coordinates
+            const float center = (i + 0.5f) / scale - 0.5f;
+            const int lo = iCeil(center - radius);
+            const int hi = iFloor(center + radius);
+
+            float* w = weight.getCArray() + i * taps;
+            for (int k = 0; k < taps; ++k) {
+                w[k] = 0.0f;
+            }
+            first[i] = iClamp(lo, 0, srcSize - 1);
+            int last = first[i];
+            float total = 0.0f;
+            for (int j = lo; j <= hi; ++j) {
+                const float f = evaluateFilter(filter, (j - center) / filterScale);
+                if (f != 0.0f) {
+                    const int s = iClamp(j, 0, srcSize - 1);
+                    w[s - first[i]] += f;
+                    last = max(last, s);
+                    total += f;
+                }
+            }
+
+            if (total == 0.0f) {
+                // Only possible for a box that lands between samples; use the nearest one
+                first[i] = iClamp(iRound(center), 0, srcSize - 1);
+                w[0] = 1.0f;
+                last = first[i];
+                total = 1.0f;
+            }
+
+            count[i] = last - first[i] + 1;
+            debugAssert(count[i] <= taps);
+            for (int k = 0; k < count[i]; ++k) {
+                w[k] /= total;
+            }
+        }
+    }
+};
+
+
+/** One resampling: a horizontal pass from the source into tmp, and a
+    vertical pass from tmp into the destination.  The source is either
+    encoded bytes or linear RGBA32F pixels, and the destination is
+    encoded bytes, linear pixels, or both. */
+class ImageResampleJob {
+public:
+    /** NULL if the source is srcLinear */
+    const uint8*        srcBytes;
+    size_t              srcStride;
+    const ImageFormat*  srcFormat;
+    const Color4*       srcLinear;
+    int                 srcWidth;
+    int                 srcHeight;
+
+    /** NULL if there is no encoded destination */
+    uint8*              dstBytes;
+    size_t              dstStride;
+    const ImageFormat*  dstFormat;
+
+    /** NULL if there is no linear destination */
+    Color4*             dstLinear;
+    int                 dstWidth;
+    int                 dstHeight;
+
+    /** Decode and encode the color channels as sRGB */
+    bool                srgb;
+
+    const ResampleAxis* horizontal;
+    const ResampleAxis* vertical;
+
+    /** dstWidth x srcHeight */
+    Color4*             tmp;
+
+    /** srcWidth + dstWidth pixels per thread */
+    Color4*             scratch;
+
+    Color4* threadScratch(int threadID) const {
+        return scratch + size_t(srcWidth + dstWidth) * threadID;
+    }
+
+    void horizontalRow(int y, int threadID);
+    void verticalRow(int y, int threadID);
+    void run();
+};
+
+} // namespace _internal
+
+
+#ifdef G3D_RUNTIME_SIMD
+
+G3D_SSE_TARGET static void filterRow_sse(const Color4* src, const _internal::ResampleAxis& axis, int dstWidth, Color4* dst) {
+    for (int x = 0; x < dstWidth; ++x) {
+        const float* w = axis.weight.getCArray() + x * axis.taps;
+        const float* s = reinterpret_cast<const float*>(src + axis.first[x]);
+        const int n = axis.count[x];
+        __m128 sum = _mm_mul_ps(_mm_set1_ps(w[0]), _mm_loadu_ps(s));
+        for (int k = 1; k < n; ++k) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(s + 4 * k)));
+        }
+        _mm_storeu_ps(reinterpret_cast<float*>(dst + x), sum);
+    }
+}
+
+
+/** dst = w * src, or dst += w * src */
+G3D_SSE_TARGET static void accumulateRow_sse(const Color4* src, float w, int width, bool overwrite, Color4* dst) {
+    const float* s = reinterpret_cast<const float*>(src);
+    float* d = reinterpret_cast<float*>(dst);
+    const __m128 weight = _mm_set1_ps(w);
+    if (overwrite) {
+        for (int x = 0; x < 4 * width; x += 4) {
+            _mm_storeu_ps(d + x, _mm_mul_ps(weight, _mm_loadu_ps(s + x)));
+        }
+    } else {
+        for (int x = 0; x < 4 * width; x += 4) {
+            _mm_storeu_ps(d + x, _mm_add_ps(_mm_loadu_ps(d + x), _mm_mul_ps(weight, _mm_loadu_ps(s + x))));
+        }
+    }
+}
+
+#endif // G3D_RUNTIME_SIMD
+
+
+static void filterRow(const Color4* src, const _internal::ResampleAxis& axis, int dstWidth, Color4* dst) {
+#   ifdef G3D_RUNTIME_SIMD
+    if (System::hasSSE()) {
+        filterRow_sse(src, axis, dstWidth, dst);
+        return;
+    }
+#   endif
+    for (int x = 0; x < dstWidth; ++x) {
+        const float* w = axis.weight.getCArray() + x * axis.taps;
+        const Color4* s = src + axis.first[x];
+        Color4 sum = s[0] * w[0];
+        for (int k = 1; k < axis.count[x]; ++k) {
+            sum += s[k] * w[k];
+        }
+        dst[x] = sum;
+    }
+}
+
+
+static void accumulateRow(const Color4* src, float w, int width, bool overwrite, Color4* dst) {
+#   ifdef G3D_RUNTIME_SIMD
+    if (System::hasSSE()) {
+        accumulateRow_sse(src, w, width, overwrite, dst);
+        return;
+    }
+#   endif
+    if (overwrite) {
+        for (int x = 0; x < width; ++x) {
+            dst[x] = src[x] * w;
+        }
+    } else {
+        for (int x = 0; x < width; ++x) {
+            dst[x] += src[x] * w;
+        }
+    }
+}
+
+
+void _internal::ImageResampleJob::horizontalRow(int y, int threadID) {
+    const Color4* row = NULL;
+    if (srcBytes) {
+        Color4* decoded = threadScratch(threadID);
+        const uint8* bytes = srcBytes + srcStride * y;
+        const int channels = byteChannels(srcFormat);
+        if (srgb && (channels > 0)) {
+            // Decode the common 8-bit formats directly
+            const float* toLinear = SRGBTable::instance().toLinear;
+            for (int x = 0; x < srcWidth; ++x, bytes += channels) {
+                decoded[x] = Color4(toLinear[bytes[0]], toLinear[bytes[1]], toLinear[bytes[2]],
+                                    (channels == 4) ? (bytes[3] * (1.0f / 255.0f)) : 1.0f);
+            }
+        } else {
+            ImageFormat::convertRow(bytes, srcFormat, decoded, ImageFormat::RGBA32F(), srcWidth);
+        }
+        if (srgb && (channels == 0)) {
+            const float* toLinear = SRGBTable::instance().toLinear;
+            for (int x = 0; x < srcWidth; ++x) {
+                Color4& c = decoded[x];
+                c.r = toLinear[iClamp(iRound(c.r * 255.0f), 0, 255)];
+                c.g = toLinear[iClamp(iRound(c.g * 255.0f), 0, 255)];
+                c.b = toLinear[iClamp(iRound(c.b * 255.0f), 0, 255)];
+            }
+        }
+        row = decoded;
+    } else {
+        row = srcLinear + size_t(srcWidth) * y;
+    }
+
+    filterRow(row, *horizontal, dstWidth, tmp + size_t(dstWidth) * y);
+}
+
+
+void _internal::ImageResampleJob::verticalRow(int y, int threadID) {
+    Color4* out = dstLinear ? (dstLinear + size_t(dstWidth) * y) : (threadScratch(threadID) + srcWidth);
+
+    const float* w = vertical->weight.getCArray() + y * vertical->taps;
+    const int first = vertical->first[y];
+    for (int k = 0; k < vertical->count[y]; ++k) {
+        accumulateRow(tmp + size_t(dstWidth) * (first + k), w[k], dstWidth, k == 0, out);
+    }
+
+    if (dstBytes) {
+        const int channels = byteChannels(dstFormat);
+        if (srgb && (channels > 0)) {
+            const SRGBTable& table = SRGBTable::instance();
+            uint8* bytes = dstBytes + dstStride * y;
+            for (int x = 0; x < dstWidth; ++x, bytes += channels) {
+                const Color4& c = out[x];
+                bytes[0] = table.encode(c.r);
+                bytes[1] = table.encode(c.g);
+                bytes[2] = table.encode(c.b);
+                if (channels == 4) {
+                    bytes[3] = uint8(iClamp(iRound(c.a * 255.0f), 0, 255));
+                }
+            }
+            return;
+        }
+
+        if (srgb) {
+            Color4* encoded = threadScratch(threadID) + srcWidth;
+            const SRGBTable& table = SRGBTable::instance();
+            for (int x = 0; x < dstWidth; ++x) {
+                const Color4& c = out[x];
+                encoded[x] = Color4(table.fromLinear(c.r), table.fromLinear(c.g), table.fromLinear(c.b), c.a);
+            }
+            out = encoded;
+        }
+        ImageFormat::convertRow(out, ImageFormat::RGBA32F(), dstBytes + dstStride * y, dstFormat, dstWidth);
+    }
+}
+
+
+void _internal::ImageResampleJob::run() {
+    // Create the table before any worker needs it
+    SRGBTable::instance();
+
+    const int numThreads = (max(srcWidth * srcHeight, dstWidth * dstHeight) >= MIN_PARALLEL_PIXELS) ? ThreadPool::numThreads() : 1;
+
+    Array<Color4> tmpArray;
+    tmpArray.resize(dstWidth * srcHeight);
+    tmp = tmpArray.getCArray();
+
+    Array<Color4> scratchArray;
+    scratchArray.resize((srcWidth + dstWidth) * numThreads);
+    scratch = scratchArray.getCArray();
+
+    if (numThreads == 1) {
+        for (int y = 0; y < srcHeight; ++y) {
+            horizontalRow(y, 0);
+        }
+        for (int y = 0; y < dstHeight; ++y) {
+            verticalRow(y, 0);
+        }
+    } else {
+        ThreadPool::parallelFor(0, srcHeight, this, &ImageResampleJob::horizontalRow,
+                                iMax(1, PIXELS_PER_TILE / srcWidth), numThreads);
+        ThreadPool::parallelFor(0, dstHeight, this, &ImageResampleJob::verticalRow,
+                                iMax(1, PIXELS_PER_TILE / dstWidth), numThreads);
+    }
+
+    tmp = NULL;
+    scratch = NULL;
+}
+
+
+/** The format with the same bytes that ImageFormat::convert understands */
+static const ImageFormat* storageFormat(const ImageFormat* format) {
+    return (format->code == ImageFormat::CODE_SRGB8) ? ImageFormat::RGB8() : format;
+}
+
+
+/** True if filtering in \a format should decode and encode sRGB */
+static bool isSRGB(const ImageFormat* format, const ImageResampler::Settings& settings) {
+    const bool is8Bit =
+        (format->numberFormat == ImageFormat::NORMALIZED_FIXED_POINT_FORMAT) &&
+        ((format->redBits == 8) || (format->luminanceBits == 8));
+    return is8Bit && (settings.gammaCorrect || (format->colorSpace == ImageFormat::COLOR_SPACE_SRGB));
+}
+
+
+bool ImageResampler::supports(const ImageFormat* format) {
+    format = storageFormat(format);
+    return (format->code == ImageFormat::CODE_RGBA32F) ||
+        (ImageFormat::conversionAvailable(format, 0, ImageFormat::RGBA32F(), 0) &&
+         ImageFormat::conversionAvailable(ImageFormat::RGBA32F(), 0, format, 0));
+}
+
+
+bool ImageResampler::resample
+(const void*            srcBytes,
+ int                    srcWidth,
+ int                    srcHeight,
+ int                    srcRowPadBits,
+ const ImageFormat*     format,
+ void*                  dstBytes,
+ int                    dstWidth,
+ int                    dstHeight,
+ int                    dstRowPadBits,
+ const Settings&        settings) {
+
+    debugAssert((srcWidth > 0) && (srcHeight > 0) && (dstWidth > 0) && (dstHeight > 0));
+    debugAssertM((srcRowPadBits % 8 == 0) && (dstRowPadBits % 8 == 0), "Row padding must be a multiple of 8 bits");
+
+    if (! supports(format)) {
+        return false;
+    }
+
+    const _internal::ResampleAxis horizontal(srcWidth, dstWidth, settings.filter);
+    const _internal::ResampleAxis vertical(srcHeight, dstHeight, settings.filter);
+
+    _internal::ImageResampleJob job;
+    job.srcBytes    = static_cast<const uint8*>(srcBytes);
+    job.srcStride   = (size_t(srcWidth) * format->cpuBitsPerPixel + srcRowPadBits) / 8;
+    job.srcFormat   = storageFormat(format);
+    job.srcLinear   = NULL;
+    job.srcWidth    = srcWidth;
+    job.srcHeight   = srcHeight;
+    job.dstBytes    = static_cast<uint8*>(dstBytes);
+    job.dstStride   = (size_t(dstWidth) * format->cpuBitsPerPixel + dstRowPadBits) / 8;
+    job.dstFormat   = storageFormat(format);
+    job.dstLinear   = NULL;
+    job.dstWidth    = dstWidth;
+    job.dstHeight   = dstHeight;
+    job.srgb        = isSRGB(format, settings);
+    job.horizontal  = &horizontal;
+    job.vertical    = &vertical;
+    job.run();
+
+    return true;
+}
+
+
+ImageBuffer::Ref ImageResampler::resample(const ImageBuffer::Ref& src, int width, int height, const Settings& settings) {
+    debugAssertM(src->depth() == 1, "Cannot resample 3D images");
+    if (! supports(src->format())) {
+        return NULL;
+    }
+
+    const ImageBuffer::Ref dst = ImageBuffer::create(width, height, src->format(), MemoryManager::create(), 1, src->rowAlignment());
+    const int bitsPerRow = src->format()->cpuBitsPerPixel;
+    resample(src->buffer(), src->width(), src->height(), src->stride() * 8 - src->width() * bitsPerRow, src->format(),
+             dst->buffer(), width, height, dst->stride() * 8 - width * bitsPerRow, settings);
+    return dst;
+}
+
+
+void ImageResampler::mipChain(const ImageBuffer::Ref& src, Array<ImageBuffer::Ref>& levels, const Settings& settings) {
+    debugAssertM(src->depth() == 1, "Cannot build MIP maps of 3D images");
+    levels.fastClear();
+    if (! supports(src->format())) {
+        return;
+    }
+    levels.append(src);
+
+    const ImageFormat* format = storageFormat(src->format());
+
+    // Linear versions of the previous and current levels, alternating
+    Array<Color4> linear[2];
+
+    int width  = src->width();
+    int height = src->height();
+    while ((width > 1) || (height > 1)) {
+        const int nextWidth  = max(1, width / 2);
+        const int nextHeight = max(1, height / 2);
+
+        const _internal::ResampleAxis horizontal(width, nextWidth, settings.filter);
+        const _internal::ResampleAxis vertical(height, nextHeight, settings.filter);
+        const ImageBuffer::Ref level = ImageBuffer::create(nextWidth, nextHeight, src->format(), MemoryManager::create(), 1, src->rowAlignment());
+        const Array<Color4>& previous = linear[levels.size() & 1];
+        Array<Color4>& current = linear[(levels.size() + 1) & 1];
+        current.resize(nextWidth * nextHeight);
+
+        _internal::ImageResampleJob job;
+        job.srcBytes    = (levels.size() == 1) ? static_cast<const uint8*>(src->buffer()) : NULL;
+        job.srcStride   = src->stride();
+        job.srcFormat   = format;
+        job.srcLinear   = previous.getCArray();
+        job.srcWidth    = width;
+        job.srcHeight   = height;
+        job.dstBytes    = static_cast<uint8*>(level->buffer());
+        job.dstStride   = level->stride();
+        job.dstFormat   = format;
+        job.dstLinear   = current.getCArray();
+        job.dstWidth    = nextWidth;
+        job.dstHeight   = nextHeight;
+        job.srgb        = isSRGB(src->format(), settings);
+        job.horizontal  = &horizontal;
+        job.vertical    = &vertical;
+        job.run();
+
+        levels.append(level);
+        width  = nextWidth;
+        height = nextHeight;
+    }
+}
+
+} // namespace G3D
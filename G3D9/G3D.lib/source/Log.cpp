@@ -3,7 +3,7 @@
 
   @maintainer Morgan McGuire, http://graphics.cs.williams.edu
   @created 2001-08-04
-  @edited  2010-01-15
+  @edited  2026-10-17
  */
 
 #include "G3D/platform.h"
@@ -12,16 +12,369 @@
 #include "G3D/Array.h"
 #include "G3D/fileutils.h"
 #include "G3D/FileSystem.h"
+#include "G3D/AtomicInt32.h"
+#include "G3D/GMutex.h"
+#include "G3D/GThread.h"
+#include "G3D/System.h"
 #include <time.h>
+#include <signal.h>
+#include <stdlib.h>
 
 #ifdef G3D_WIN32
     #include <imagehlp.h>
+    #include <io.h>
 #else
     #include <stdarg.h>
+    #include <unistd.h>
 #endif
 
 namespace G3D {
 
+namespace _internal {
+
+/** Gives up the processor for about \a ms milliseconds.  System::sleep
+    busy-waits for short intervals, which a background thread must
+    not do. */
+static void logYield(int ms) {
+#   ifdef G3D_WIN32
+        Sleep(ms);
+#   else
+        usleep(ms * 1000);
+#   endif
+}
+
+
+/** One slot of the LogQueue ring */
+class LogRecord {
+public:
+    enum {TEXT_SIZE = 120};
+
+    /** Equal to the position of the slot when it is free for a
+        producer, and one more than that once the producer has filled
+        it.  The consumer frees it by advancing it a full lap. */
+    AtomicInt32     sequence;
+
+    int32           length;
+
+    char            text[TEXT_SIZE];
+};
+
+
+/** \brief Bounded multiple-producer, single-consumer ring of LogRecords.
+
+    Producers reserve a run of consecutive records with one
+    compare-and-set on the head, copy their message into them, and
+    publish each record through its sequence number.  Because the
+    consumer frees records in order, a run is free whenever its last
+    record is.  The records of one message are therefore adjacent in
+    the output.
+
+    Whoever holds drainLock may consume: normally the LogWriter
+    thread, and also Log::flush.  A message too large to fit in half
+    of the ring is instead written directly while holding drainLock. */
+class LogQueue {
+public:
+
+    FILE*           file;
+
+    /** Descriptor of file, for the crash handler */
+    int             fd;
+
+    LogRecord*      record;
+
+    /** Power of two */
+    uint32          capacity;
+
+    /** Next position to reserve */
+    AtomicInt32     head;
+
+    /** Next position to consume.  Guarded by drainLock. */
+    uint32          tail;
+
+    GMutex          drainLock;
+
+    /** Output is copied here and written in one fwrite. Guarded by drainLock. */
+    Array<char>     batch;
+
+    AtomicInt32     stop;
+
+    GThreadRef      writer;
+
+    LogQueue(FILE* f, int queueBytes) : file(f), fd(fileno(f)), head(0), tail(0), stop(0) {
+        capacity = 64;
+        while (capacity * sizeof(LogRecord) < (size_t)queueBytes) {
+            capacity *= 2;
+        }
+        record = new LogRecord[capacity];
+        for (uint32 i = 0; i < capacity; ++i) {
+            record[i].sequence = int32(i);
+        }
+        batch.resize(64 * 1024);
+    }
+
+    ~LogQueue() {
+        delete[] record;
+    }
+
+    LogRecord& slot(uint32 position) {
+        return record[position & (capacity - 1)];
+    }
+
+    /** Reserves \a n consecutive records and returns the first position */
+    uint32 reserve(uint32 n) {
+        debugAssert(n <= capacity);
+        int attempts = 0;
+        while (true) {
+            const uint32 pos = uint32(head.value());
+            const uint32 last = pos + n - 1;
+            const int32 lag = int32(uint32(slot(last).sequence.value()) - last);
+
+            if (lag == 0) {
+                if (uint32(head.compareAndSet(int32(pos), int32(pos + n))) == pos) {
+                    return pos;
+                }
+            } else if (lag < 0) {
+                // Full; wait for the writer
+                ++attempts;
+                logYield((attempts > 100) ? 1 : 0);
+            }
+            // Otherwise another producer took the records; retry
+        }
+    }
+
+    /** Copies \a length bytes, and then a newline if requested, into the queue */
+    void push(const char* text, int length, bool newline) {
+        const uint32 total = uint32(length) + (newline ? 1 : 0);
+        if (total == 0) {
+            // reserve() cannot claim zero records
+            return;
+        }
+        const uint32 numRecords = (total + LogRecord::TEXT_SIZE - 1) / LogRecord::TEXT_SIZE;
+
+        if (numRecords > capacity / 2) {
+            // Too large to reserve at once without risking waiting for
+            // the whole ring.  Holding drainLock keeps the writer from
+            // interleaving queued records with this message.
+            drainLock.lock();
+            drain();
+            fwrite(text, 1, length, file);
+            if (newline) {
+                fputc('\n', file);
+            }
+            fflush(file);
+            drainLock.unlock();
+            return;
+        }
+
+        const uint32 pos = reserve(numRecords);
+        int copied = 0;
+        for (uint32 i = 0; i < numRecords; ++i) {
+            LogRecord& r = slot(pos + i);
+            const int c = iMin(length - copied, LogRecord::TEXT_SIZE);
+            System::memcpy(r.text, text + copied, c);
+            copied += c;
+            r.length = c;
+            if (newline && (copied == length) && (c < LogRecord::TEXT_SIZE)) {
+                r.text[c] = '\n';
+                ++r.length;
+                newline = false;
+            }
+
+            // Publish (the locked add is also a write barrier)
+            r.sequence.add(1);
+        }
+    }
+
+    /** Writes every consecutive published record.  Call with drainLock held.
+        Returns the number of records written. */
+    int drain() {
+        int numRecords = 0;
+        int batchLength = 0;
+        char* out = batch.getCArray();
+
+        while (true) {
+            LogRecord& r = slot(tail);
+
+            // Compare-and-set to the same value reads the sequence with a barrier
+            const uint32 published = tail + 1;
+            if (uint32(r.sequence.compareAndSet(int32(published), int32(published))) != published) {
+                break;
+            }
+
+            if (batchLength + r.length > batch.size()) {
+                fwrite(out, 1, batchLength, file);
+                batchLength = 0;
+            }
+            System::memcpy(out + batchLength, r.text, r.length);
+            batchLength += r.length;
+
+            // Free the record for the next lap
+            r.sequence.add(int32(capacity - 1));
+            ++tail;
+            ++numRecords;
+        }
+
+        if (batchLength > 0) {
+            fwrite(out, 1, batchLength, file);
+        }
+        if (numRecords > 0) {
+            fflush(file);
+        }
+        return numRecords;
+    }
+
+    /** Writes the published records that the writer has not yet
+        consumed straight to the file descriptor, bypassing stdio.
+        Takes no locks and never waits, so it is safe in a signal
+        handler.  Records in a batch that the writer was in the middle
+        of writing when the signal arrived may be lost. */
+    void writeOnCrash() const {
+        uint32 position = tail;
+        while (true) {
+            const LogRecord& r = record[position & (capacity - 1)];
+            if (uint32(r.sequence.value()) != position + 1) {
+                break;
+            }
+#           ifdef G3D_WIN32
+                _write(fd, r.text, r.length);
+#           else
+                if (::write(fd, r.text, r.length) < 0) {
+                    break;
+                }
+#           endif
+            ++position;
+        }
+    }
+
+    /** Writes everything reserved before the call.  Gives up after
+        about \a maxAttempts tries, which only happens if a producer
+        stopped in the middle of a message (e.g., it crashed). */
+    void flush(int maxAttempts) {
+        const uint32 target = uint32(head.value());
+        for (int attempt = 0; attempt < maxAttempts; ++attempt) {
+            if (drainLock.tryLock()) {
+                drain();
+                const bool done = (int32(tail - target) >= 0);
+                drainLock.unlock();
+                if (done) {
+                    return;
+                }
+            }
+            logYield((attempt > 100) ? 1 : 0);
+        }
+    }
+};
+
+
+/** Background thread that batches LogQueue output to the file */
+class LogWriter : public GThread {
+private:
+    LogQueue*       m_queue;
+
+public:
+
+    LogWriter(LogQueue* queue) : GThread("Log writer"), m_queue(queue) {}
+
+protected:
+
+    virtual void threadMain() {
+        while (m_queue->stop.value() == 0) {
+            m_queue->drainLock.lock();
+            const int n = m_queue->drain();
+            m_queue->drainLock.unlock();
+
+            if (n == 0) {
+                logYield(1);
+            }
+        }
+    }
+};
+
+
+/** Logs in asynchronous mode, which are flushed at exit */
+static Array<Log*>* asynchronousLog = NULL;
+static Spinlock asynchronousLogLock;
+
+/** Queues of the asynchronous logs, which the crash handler reads
+    without locking.  Each entry is written with a single store, so the
+    handler sees either NULL or a complete queue. */
+enum {MAX_CRASH_QUEUES = 32};
+static LogQueue* volatile crashQueue[MAX_CRASH_QUEUES];
+
+static const int crashSignal[] = {SIGSEGV, SIGABRT, SIGFPE, SIGILL};
+static const int numCrashSignals = sizeof(crashSignal) / sizeof(crashSignal[0]);
+typedef void (__cdecl *SignalHandler)(int);
+static SignalHandler previousHandler[numCrashSignals];
+
+static void __cdecl flushAsynchronousLogsAtExit() {
+    if (asynchronousLog != NULL) {
+        for (int i = 0; i < asynchronousLog->size(); ++i) {
+            (*asynchronousLog)[i]->flush();
+        }
+    }
+}
+
+
+static void __cdecl flushAsynchronousLogsOnCrash(int sig) {
+    // Only async-signal-safe calls are allowed here
+    for (int i = 0; i < MAX_CRASH_QUEUES; ++i) {
+        const LogQueue* queue = crashQueue[i];
+        if (queue != NULL) {
+            queue->writeOnCrash();
+        }
+    }
+
+    // Let the previous handler, or the default one, terminate the program
+    for (int i = 0; i < numCrashSignals; ++i) {
+        if (crashSignal[i] == sig) {
+            signal(sig, ((previousHandler[i] == SIG_ERR) || (previousHandler[i] == SIG_IGN)) ? SIG_DFL : previousHandler[i]);
+        }
+    }
+    raise(sig);
+}
+
+
+static void registerAsynchronousLog(Log* log, LogQueue* queue) {
+    asynchronousLogLock.lock();
+    if (asynchronousLog == NULL) {
+        asynchronousLog = new Array<Log*>();
+        atexit(flushAsynchronousLogsAtExit);
+        for (int i = 0; i < numCrashSignals; ++i) {
+            previousHandler[i] = signal(crashSignal[i], flushAsynchronousLogsOnCrash);
+        }
+    }
+    asynchronousLog->append(log);
+
+    // Logs beyond the first MAX_CRASH_QUEUES are still flushed at exit
+    for (int i = 0; i < MAX_CRASH_QUEUES; ++i) {
+        if (crashQueue[i] == NULL) {
+            crashQueue[i] = queue;
+            break;
+        }
+    }
+    asynchronousLogLock.unlock();
+}
+
+
+static void unregisterAsynchronousLog(Log* log, LogQueue* queue) {
+    asynchronousLogLock.lock();
+    if (asynchronousLog != NULL) {
+        const int i = asynchronousLog->findIndex(log);
+        if (i != -1) {
+            asynchronousLog->fastRemove(i);
+        }
+    }
+    for (int i = 0; i < MAX_CRASH_QUEUES; ++i) {
+        if (crashQueue[i] == queue) {
+            crashQueue[i] = NULL;
+        }
+    }
+    asynchronousLogLock.unlock();
+}
+
+} // namespace _internal
+
+
 void logPrintf(const char* fmt, ...) {
     va_list arg_list;
     va_start(arg_list, fmt);
@@ -40,6 +393,9 @@ void logLazyPrintf(const char* fmt, ...) {
 Log* Log::commonLog = NULL;
 
 Log::Log(const std::string& filename, int stripFromStackBottom) : 
+    queue(NULL),
+    activeProducers(0),
+    retiring(0),
     stripFromStackBottom(stripFromStackBottom) {
 
     this->filename = filename;
@@ -80,6 +436,7 @@ Log::Log(const std::string& filename, int stripFromStackBottom) :
 Log::~Log() {
     section("Shutdown");
     println("Closing log file");
+    setAsynchronous(false);
     
     // Make sure we don't leave a dangling pointer
     if (Log::commonLog == this) {
@@ -110,9 +467,109 @@ std::string Log::getCommonLogFilename() {
 }
 
 
+void Log::setAsynchronous(bool a, int queueBytes) {
+    if (a == asynchronous()) {
+        return;
+    }
+
+    if (a) {
+        _internal::LogQueue* q = new _internal::LogQueue(logFile, queueBytes);
+        q->writer = new _internal::LogWriter(q);
+        q->writer->start();
+        _internal::registerAsynchronousLog(this, q);
+        queue = q;
+    } else {
+        // Synchronous writes must wait for this thread's queued
+        // messages, so that each thread's output stays in order
+        _internal::LogQueue* q = queue;
+        retiring = 1;
+        queue = NULL;
+        _internal::unregisterAsynchronousLog(this, q);
+
+        // Wait for producers that read the old queue pointer before it
+        // was cleared.  The locked compare-and-set also orders the
+        // store to queue before the load of the count.
+        while (activeProducers.compareAndSet(0, 0) != 0) {
+            _internal::logYield(0);
+        }
+
+        q->stop = 1;
+        q->writer->waitForCompletion();
+
+        // Anything enqueued after the writer's last pass
+        q->drainLock.lock();
+        q->drain();
+        q->drainLock.unlock();
+
+        delete q;
+        retiring = 0;
+    }
+}
+
+
+_internal::LogQueue* Log::beginProducing() {
+    if (queue == NULL) {
+        waitForRetiredQueue();
+        return NULL;
+    }
+
+    // Announce before rereading, so that setAsynchronous(false) either
+    // sees this producer or this producer sees the cleared pointer
+    activeProducers.increment();
+    _internal::LogQueue* q = queue;
+    if (q == NULL) {
+        activeProducers.decrement();
+        waitForRetiredQueue();
+    }
+    return q;
+}
+
+
+void Log::waitForRetiredQueue() {
+    while (retiring.value() != 0) {
+        _internal::logYield(0);
+    }
+}
+
+
+void Log::endProducing() {
+    activeProducers.decrement();
+}
+
+
+void Log::flush() {
+    _internal::LogQueue* q = beginProducing();
+    if (q != NULL) {
+        q->flush(10000);
+        endProducing();
+    } else {
+        fflush(logFile);
+    }
+}
+
+
+void Log::write(const char* text, int length, bool newline, bool flush) {
+    _internal::LogQueue* q = beginProducing();
+    if (q != NULL) {
+        q->push(text, length, newline);
+        endProducing();
+    } else {
+        fwrite(text, 1, length, logFile);
+        if (newline) {
+            fputc('\n', logFile);
+        }
+        if (flush) {
+            fflush(logFile);
+        }
+    }
+}
+
+
 void Log::section(const std::string& s) {
-    fprintf(logFile, "_____________________________________________________\n");
-    fprintf(logFile, "\n    ###    %s    ###\n\n", s.c_str());
+    const std::string& text = 
+        "_____________________________________________________\n"
+        "\n    ###    " + s + "    ###\n\n";
+    write(text.c_str(), (int)text.size(), false, false);
 }
 
 
@@ -125,25 +582,60 @@ void __cdecl Log::printf(const char* fmt, ...) {
 
 
 void __cdecl Log::vprintf(const char* fmt, va_list argPtr) {
-    vfprintf(logFile, fmt, argPtr);
-    fflush(logFile);
+    if (queue == NULL) {
+        waitForRetiredQueue();
+        vfprintf(logFile, fmt, argPtr);
+        fflush(logFile);
+        return;
+    }
+
+    // Format on the stack to keep the heap out of the producer's path
+    // when possible
+    char stackBuffer[512];
+    const int bufferSize = sizeof(stackBuffer);
+    int length = 0;
+
+#   ifdef _MSC_VER
+        // MSVC does not support va_copy, but it can reuse argPtr
+        length = _vscprintf(fmt, argPtr);
+        if (length < bufferSize) {
+            vsprintf(stackBuffer, fmt, argPtr);
+        }
+#   else
+        va_list argPtrCopy;
+        va_copy(argPtrCopy, argPtr);
+        length = vsnprintf(stackBuffer, bufferSize, fmt, argPtrCopy);
+        va_end(argPtrCopy);
+#   endif
+
+    if (length < 0) {
+        return;
+    } else if (length < bufferSize) {
+        write(stackBuffer, length, false, true);
+    } else {
+        const std::string& s = vformat(fmt, argPtr);
+        write(s.c_str(), (int)s.size(), false, true);
+    }
 }
 
 
 void __cdecl Log::lazyvprintf(const char* fmt, va_list argPtr) {
-    vfprintf(logFile, fmt, argPtr);
+    if (queue == NULL) {
+        waitForRetiredQueue();
+        vfprintf(logFile, fmt, argPtr);
+    } else {
+        vprintf(fmt, argPtr);
+    }
 }
 
 
 void Log::print(const std::string& s) {
-    fprintf(logFile, "%s", s.c_str());
-    fflush(logFile);
+    write(s.c_str(), (int)s.size(), false, true);
 }
 
 
 void Log::println(const std::string& s) {
-    fprintf(logFile, "%s\n", s.c_str());
-    fflush(logFile);
+    write(s.c_str(), (int)s.size(), true, true);
 }
 
 }
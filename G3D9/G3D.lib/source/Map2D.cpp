@@ -0,0 +1,346 @@
+/**
+  \file G3D/Map2D.cpp
+
+  Batch sampling of Map2D images whose pixels are packed floats.
+
+  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+  \created 2026-10-17
+  \edited  2026-10-17
+*/
+
+#include "G3D/Map2D.h"
+#include "G3D/ThreadPool.h"
+#include "G3D/System.h"
+#include "G3D/format.h"
+#include "G3D/SSEUtil.h"
+
+namespace G3D {
+namespace _internal {
+
+// Number of samples in each task of the parallel loop
+static const int SAMPLES_PER_TASK = 4096;
+
+// Read for out-of-bounds texels under WrapMode::ZERO and WrapMode::IGNORE
+static const float zeroTexel[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+
+#ifdef G3D_RUNTIME_SIMD
+
+/** iFloor of four floats */
+G3D_SSE2_TARGET static inline __m128i floor_sse2(__m128 x) {
+    const __m128i t = _mm_cvttps_epi32(x);
+    // Truncation rounds negative non-integers up; subtract one from those lanes
+    return _mm_add_epi32(t, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(t), x)));
+}
+
+
+/** map2DCatmullRomWeights for four fractions, with the same operation order */
+G3D_SSE2_TARGET static inline void catmullRomWeights_sse2(__m128 s, __m128* c) {
+    const __m128 s2 = _mm_mul_ps(s, s);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    c[0] = _mm_mul_ps(s, _mm_add_ps(_mm_set1_ps(-0.5f), _mm_mul_ps(s, _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(half, s)))));
+    c[1] = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(s2, _mm_add_ps(_mm_set1_ps(-2.5f), _mm_mul_ps(threeHalves, s))));
+    c[2] = _mm_mul_ps(s, _mm_add_ps(half, _mm_mul_ps(s, _mm_sub_ps(_mm_set1_ps(2.0f), _mm_mul_ps(threeHalves, s)))));
+    c[3] = _mm_mul_ps(s2, _mm_add_ps(_mm_set1_ps(-0.5f), _mm_mul_ps(half, s)));
+}
+
+
+/** Loads channel \a c of the texels at \a tap[0..3], one per lane.  SSE2
+    has no gather instruction, so this is four scalar loads. */
+G3D_SSE2_TARGET static inline __m128 gather_sse2(const float* const* tap, int stride, int c) {
+    return _mm_setr_ps(tap[0][c], tap[stride][c], tap[2 * stride][c], tap[3 * stride][c]);
+}
+
+#endif // G3D_RUNTIME_SIMD
+
+
+/** Samples a Map2D of 1-4 packed floats per pixel.  Each task of the
+    parallel loop handles SAMPLES_PER_TASK consecutive positions. */
+class FloatMapSampler {
+public:
+    const float*        data;
+    int                 width;
+    int                 height;
+    int                 channels;
+    WrapMode            wrap;
+    bool                bicubic;
+    const Vector2*      pos;
+    float*              result;
+    int                 n;
+
+    /** Address of texel (x, y) under a wrap mode known at compile time,
+        matching Map2D::get */
+    template<WrapMode::Value m>
+    const float* texel(int x, int y) const {
+        if (((uint32)x < (uint32)width) && ((uint32)y < (uint32)height)) {
+            return data + (size_t(y) * width + x) * channels;
+        }
+
+        switch (m) {
+        case WrapMode::CLAMP:
+            return data + (size_t(iClamp(y, 0, height - 1)) * width + iClamp(x, 0, width - 1)) * channels;
+
+        case WrapMode::TILE:
+            return data + (size_t(iWrap(y, height)) * width + iWrap(x, width)) * channels;
+
+        case WrapMode::ERROR:
+            alwaysAssertM(false, format("Index out of bounds: (%d, %d), w = %d, h = %d",
+                                        x, y, width, height));
+            // intentionally fall through
+        default:
+            return zeroTexel;
+        }
+    }
+
+    /** The four texels from (i, j) to (i + 1, j + 1), row major */
+    template<WrapMode::Value m>
+    void bilinearTaps(int i, int j, const float** tap) const {
+        if ((i >= 0) && (j >= 0) && (i + 1 < width) && (j + 1 < height)) {
+            tap[0] = data + (size_t(j) * width + i) * channels;
+            tap[1] = tap[0] + channels;
+            tap[2] = tap[0] + size_t(width) * channels;
+            tap[3] = tap[2] + channels;
+        } else {
+            tap[0] = texel<m>(i, j);
+            tap[1] = texel<m>(i + 1, j);
+            tap[2] = texel<m>(i, j + 1);
+            tap[3] = texel<m>(i + 1, j + 1);
+        }
+    }
+
+    /** The sixteen texels from (i - 1, j - 1) to (i + 2, j + 2), row major */
+    template<WrapMode::Value m>
+    void bicubicTaps(int i, int j, const float** tap) const {
+        if ((i >= 1) && (j >= 1) && (i + 2 < width) && (j + 2 < height)) {
+            const float* corner = data + (size_t(j - 1) * width + (i - 1)) * channels;
+            for (int v = 0; v < 4; ++v) {
+                const float* row = corner + size_t(v) * width * channels;
+                for (int u = 0; u < 4; ++u) {
+                    tap[v * 4 + u] = row + u * channels;
+                }
+            }
+        } else {
+            for (int v = 0; v < 4; ++v) {
+                for (int u = 0; u < 4; ++u) {
+                    tap[v * 4 + u] = texel<m>(i + u - 1, j + v - 1);
+                }
+            }
+        }
+    }
+
+    /** Same arithmetic as Map2D::bilinear on Color3 */
+    template<WrapMode::Value m>
+    void bilinearRange(int begin, int end) const {
+        for (int k = begin; k < end; ++k) {
+            const int i = iFloor(pos[k].x);
+            const int j = iFloor(pos[k].y);
+            const float fX = pos[k].x - i;
+            const float fY = pos[k].y - j;
+
+            const float* tap[4];
+            bilinearTaps<m>(i, j, tap);
+
+            float* out = result + size_t(k) * channels;
+            for (int c = 0; c < channels; ++c) {
+                const float A = tap[0][c] + (tap[1][c] - tap[0][c]) * fX;
+                const float B = tap[2][c] + (tap[3][c] - tap[2][c]) * fX;
+                out[c] = A + (B - A) * fY;
+            }
+        }
+    }
+
+    template<WrapMode::Value m>
+    void bicubicRange(int begin, int end) const {
+        for (int k = begin; k < end; ++k) {
+            const int i = iFloor(pos[k].x);
+            const int j = iFloor(pos[k].y);
+            float wx[4], wy[4];
+            map2DCatmullRomWeights(pos[k].x - i, wx);
+            map2DCatmullRomWeights(pos[k].y - j, wy);
+
+            const float* tap[16];
+            bicubicTaps<m>(i, j, tap);
+
+            float* out = result + size_t(k) * channels;
+            for (int c = 0; c < channels; ++c) {
+                float sum = 0.0f;
+                for (int v = 0; v < 4; ++v) {
+                    const float* const* t = tap + v * 4;
+                    const float row = t[0][c] * wx[0] + t[1][c] * wx[1] + t[2][c] * wx[2] + t[3][c] * wx[3];
+                    sum += row * wy[v];
+                }
+                out[c] = sum;
+            }
+        }
+    }
+
+#ifdef G3D_RUNTIME_SIMD
+
+    /** Writes four samples of one channel */
+    G3D_SSE2_TARGET void store_sse2(__m128 value, int k, int c) const {
+        if (channels == 1) {
+            _mm_storeu_ps(result + k, value);
+        } else {
+            float v[4];
+            _mm_storeu_ps(v, value);
+            float* out = result + size_t(k) * channels + c;
+            out[0]            = v[0];
+            out[channels]     = v[1];
+            out[2 * channels] = v[2];
+            out[3 * channels] = v[3];
+        }
+    }
+
+    /** Four samples at a time, one per lane, with a scalar tail.  Gives
+        exactly the same results as bilinearRange. */
+    template<WrapMode::Value m>
+    G3D_SSE2_TARGET void bilinearRange_sse2(int begin, int end) const {
+        int k = begin;
+        for (; k + 4 <= end; k += 4) {
+            const __m128 p01 = _mm_loadu_ps(&pos[k].x);
+            const __m128 p23 = _mm_loadu_ps(&pos[k + 2].x);
+            const __m128 x = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 y = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1));
+            const __m128i i = floor_sse2(x);
+            const __m128i j = floor_sse2(y);
+            const __m128 fX = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+            const __m128 fY = _mm_sub_ps(y, _mm_cvtepi32_ps(j));
+
+            int ii[4], jj[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(ii), i);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(jj), j);
+
+            // tap[lane * 4 + corner]
+            const float* tap[16];
+            for (int lane = 0; lane < 4; ++lane) {
+                bilinearTaps<m>(ii[lane], jj[lane], tap + lane * 4);
+            }
+
+            for (int c = 0; c < channels; ++c) {
+                const __m128 t0 = gather_sse2(tap + 0, 4, c);
+                const __m128 t1 = gather_sse2(tap + 1, 4, c);
+                const __m128 t2 = gather_sse2(tap + 2, 4, c);
+                const __m128 t3 = gather_sse2(tap + 3, 4, c);
+                const __m128 A = _mm_add_ps(t0, _mm_mul_ps(_mm_sub_ps(t1, t0), fX));
+                const __m128 B = _mm_add_ps(t2, _mm_mul_ps(_mm_sub_ps(t3, t2), fX));
+                store_sse2(_mm_add_ps(A, _mm_mul_ps(_mm_sub_ps(B, A), fY)), k, c);
+            }
+        }
+        bilinearRange<m>(k, end);
+    }
+
+    /** Four samples at a time, one per lane, with a scalar tail.  Gives
+        exactly the same results as bicubicRange. */
+    template<WrapMode::Value m>
+    G3D_SSE2_TARGET void bicubicRange_sse2(int begin, int end) const {
+        int k = begin;
+        for (; k + 4 <= end; k += 4) {
+            const __m128 p01 = _mm_loadu_ps(&pos[k].x);
+            const __m128 p23 = _mm_loadu_ps(&pos[k + 2].x);
+            const __m128 x = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 y = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1));
+            const __m128i i = floor_sse2(x);
+            const __m128i j = floor_sse2(y);
+            __m128 wx[4], wy[4];
+            catmullRomWeights_sse2(_mm_sub_ps(x, _mm_cvtepi32_ps(i)), wx);
+            catmullRomWeights_sse2(_mm_sub_ps(y, _mm_cvtepi32_ps(j)), wy);
+
+            int ii[4], jj[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(ii), i);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(jj), j);
+
+            // tap[lane * 16 + v * 4 + u]
+            const float* tap[64];
+            for (int lane = 0; lane < 4; ++lane) {
+                bicubicTaps<m>(ii[lane], jj[lane], tap + lane * 16);
+            }
+
+            for (int c = 0; c < channels; ++c) {
+                __m128 sum = _mm_setzero_ps();
+                for (int v = 0; v < 4; ++v) {
+                    const float* const* t = tap + v * 4;
+                    __m128 row = _mm_mul_ps(gather_sse2(t + 0, 16, c), wx[0]);
+                    row = _mm_add_ps(row, _mm_mul_ps(gather_sse2(t + 1, 16, c), wx[1]));
+                    row = _mm_add_ps(row, _mm_mul_ps(gather_sse2(t + 2, 16, c), wx[2]));
+                    row = _mm_add_ps(row, _mm_mul_ps(gather_sse2(t + 3, 16, c), wx[3]));
+                    sum = _mm_add_ps(sum, _mm_mul_ps(row, wy[v]));
+                }
+                store_sse2(sum, k, c);
+            }
+        }
+        bicubicRange<m>(k, end);
+    }
+
+#endif // G3D_RUNTIME_SIMD
+
+    template<WrapMode::Value m>
+    void runRange(int begin, int end) const {
+#       ifdef G3D_RUNTIME_SIMD
+        if (System::hasSSE2()) {
+            if (bicubic) {
+                bicubicRange_sse2<m>(begin, end);
+            } else {
+                bilinearRange_sse2<m>(begin, end);
+            }
+            return;
+        }
+#       endif
+
+        if (bicubic) {
+            bicubicRange<m>(begin, end);
+        } else {
+            bilinearRange<m>(begin, end);
+        }
+    }
+
+    void run(int task, int threadID) {
+        (void)threadID;
+        const int begin = task * SAMPLES_PER_TASK;
+        const int end   = min(n, begin + SAMPLES_PER_TASK);
+        switch (wrap) {
+        case WrapMode::CLAMP: runRange<WrapMode::CLAMP>(begin, end); break;
+        case WrapMode::TILE:  runRange<WrapMode::TILE>(begin, end);  break;
+        case WrapMode::ERROR: runRange<WrapMode::ERROR>(begin, end); break;
+        default:
+            // ZERO and IGNORE both read zero outside the image
+            runRange<WrapMode::ZERO>(begin, end);
+            break;
+        }
+    }
+};
+
+
+void map2DSampleFloat
+(const float*       data,
+ int                width,
+ int                height,
+ int                channels,
+ WrapMode           wrap,
+ bool               bicubic,
+ const Vector2*     pos,
+ int                n,
+ float*             result) {
+
+    debugAssert((channels >= 1) && (channels <= 4));
+    if (n <= 0) {
+        return;
+    }
+
+    FloatMapSampler sampler;
+    sampler.data     = data;
+    sampler.width    = width;
+    sampler.height   = height;
+    sampler.channels = channels;
+    sampler.wrap     = wrap;
+    sampler.bicubic  = bicubic;
+    sampler.pos      = pos;
+    sampler.result   = result;
+    sampler.n        = n;
+
+    ThreadPool::parallelFor(0, (n + SAMPLES_PER_TASK - 1) / SAMPLES_PER_TASK, &sampler, &FloatMapSampler::run);
+}
+
+} // namespace _internal
+} // namespace G3D
@@ -0,0 +1,145 @@
+/**
+  \file G3D/MemoryMappedFile.cpp
+
+  \created 2026-10-17
+  \edited  2026-10-17
+
+  Copyright 2000-2012, Morgan McGuire.
+  All rights reserved.
+ */
+#include "G3D/MemoryMappedFile.h"
+#include "G3D/debugAssert.h"
+
+#ifndef G3D_WIN32
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <sys/types.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+namespace G3D {
+
+MemoryMappedFile::MemoryMappedFile(const std::string& filename) :
+    m_filename(filename),
+    m_data(NULL),
+    m_size(0)
+#   ifdef G3D_WIN32
+    , m_mapping(NULL)
+#   endif
+    {}
+
+
+MemoryMappedFile::Ref MemoryMappedFile::create(const std::string& filename, AccessHint hint) {
+    MemoryMappedFile* m = new MemoryMappedFile(filename);
+
+#   ifdef G3D_WIN32
+        DWORD flags = FILE_ATTRIBUTE_NORMAL;
+        if (hint == SEQUENTIAL_ACCESS) {
+            flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+        } else if (hint == RANDOM_ACCESS) {
+            flags |= FILE_FLAG_RANDOM_ACCESS;
+        }
+
+        HANDLE file = ::CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                    OPEN_EXISTING, flags, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            delete m;
+            return NULL;
+        }
+
+        LARGE_INTEGER size;
+        if (! ::GetFileSizeEx(file, &size)) {
+            ::CloseHandle(file);
+            delete m;
+            return NULL;
+        }
+        m->m_size = size.QuadPart;
+
+        if (m->m_size > 0) {
+            // The mapping object keeps the file open
+            m->m_mapping = ::CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (m->m_mapping != NULL) {
+                m->m_data = (const uint8*)::MapViewOfFile(m->m_mapping, FILE_MAP_READ, 0, 0, 0);
+            }
+        }
+        ::CloseHandle(file);
+#   else
+        const int file = ::open(filename.c_str(), O_RDONLY);
+        if (file == -1) {
+            delete m;
+            return NULL;
+        }
+
+        struct stat st;
+        if (::fstat(file, &st) == -1) {
+            ::close(file);
+            delete m;
+            return NULL;
+        }
+        m->m_size = st.st_size;
+
+        // Files larger than the address space cannot be mapped
+        if ((m->m_size > 0) && (uint64(m->m_size) <= uint64(size_t(-1)))) {
+            void* p = ::mmap(NULL, size_t(m->m_size), PROT_READ, MAP_PRIVATE, file, 0);
+            if (p != MAP_FAILED) {
+                m->m_data = (const uint8*)p;
+            }
+        }
+
+        // The mapping remains valid after the descriptor is closed
+        ::close(file);
+#   endif
+
+    if ((m->m_size > 0) && (m->m_data == NULL)) {
+        delete m;
+        return NULL;
+    }
+
+    if (hint != NORMAL_ACCESS) {
+        m->advise(hint);
+    }
+
+    return m;
+}
+
+
+void MemoryMappedFile::advise(AccessHint hint) {
+#   ifdef G3D_WIN32
+        // Windows takes the hint from the flags used to open the file
+        (void)hint;
+#   else
+        if (m_data == NULL) {
+            return;
+        }
+
+        int advice = MADV_NORMAL;
+        if (hint == SEQUENTIAL_ACCESS) {
+            advice = MADV_SEQUENTIAL;
+        } else if (hint == RANDOM_ACCESS) {
+            advice = MADV_RANDOM;
+        }
+
+        // Failure only costs performance
+        ::madvise(const_cast<uint8*>(m_data), size_t(m_size), advice);
+#   endif
+}
+
+
+MemoryMappedFile::~MemoryMappedFile() {
+#   ifdef G3D_WIN32
+        if (m_data != NULL) {
+            ::UnmapViewOfFile(m_data);
+        }
+        if (m_mapping != NULL) {
+            ::CloseHandle(m_mapping);
+        }
+#   else
+        if (m_data != NULL) {
+            ::munmap(const_cast<uint8*>(m_data), size_t(m_size));
+        }
+#   endif
+    m_data = NULL;
+}
+
+} // namespace G3D
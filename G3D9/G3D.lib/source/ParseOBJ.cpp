@@ -3,7 +3,7 @@
 
  \author Morgan McGuire, http://graphics.cs.williams.edu
  \created 2011-07-16
- \edited  2011-08-22
+ \edited  2026-10-17
  
  Copyright 2000-2012, Morgan McGuire.
  All rights reserved.
@@ -13,11 +13,107 @@
 #include "G3D/FileSystem.h"
 #include "G3D/stringutils.h"
 #include "G3D/TextInput.h"
+#include "G3D/ThreadPool.h"
+#include "G3D/ZoneProfiler.h"
 
 namespace G3D {
 
+namespace _internal {
 
-void ParseOBJ::parse(const char* ptr, size_t len, const std::string& basePath) {
+/** Parses the chunks of a parallel ParseOBJ::parse */
+class ParseOBJChunkBody : public ThreadPool::Body {
+public:
+    const Array<ParseOBJ*>&     chunk;
+
+    /** Chunk i is the text from boundary[i] to boundary[i + 1] */
+    const Array<const char*>&   boundary;
+
+    ParseOBJChunkBody(const Array<ParseOBJ*>& c, const Array<const char*>& b) : chunk(c), boundary(b) {}
+
+    virtual void run(const Vector2int32& start, const Vector2int32& upTo, int threadID) {
+        (void)threadID;
+        for (int i = start.x; i < upTo.x; ++i) {
+            chunk[i]->parseChunk(boundary[i], int(boundary[i + 1] - boundary[i]));
+        }
+    }
+};
+
+
+/** Consecutive faces of one chunk that belong to the same mesh */
+class ParseOBJFaceRun {
+public:
+    int                 chunk;
+    int                 begin;
+    int                 end;
+    ParseOBJ::Mesh*     mesh;
+
+    /** Index in mesh->faceArray of the face at begin */
+    int                 destination;
+
+    ParseOBJFaceRun() {}
+
+    ParseOBJFaceRun(int c, int b, int e, ParseOBJ::Mesh* m, int d) :
+        chunk(c), begin(b), end(e), mesh(m), destination(d) {}
+};
+
+
+/** Copies the faces of each run into their meshes, converting relative
+    indices to absolute ones */
+class ParseOBJMergeBody : public ThreadPool::Body {
+public:
+    const Array<ParseOBJ*>&         chunk;
+    const Array<ParseOBJFaceRun>&   faceRun;
+
+    /** Number of each attribute that precede each chunk */
+    const Array<int>&               vertexBase;
+    const Array<int>&               texCoordBase;
+    const Array<int>&               normalBase;
+
+    ParseOBJMergeBody
+    (const Array<ParseOBJ*>&        c,
+     const Array<ParseOBJFaceRun>&  r,
+     const Array<int>&              v,
+     const Array<int>&              t,
+     const Array<int>&              n) :
+        chunk(c), faceRun(r), vertexBase(v), texCoordBase(t), normalBase(n) {}
+
+    virtual void run(const Vector2int32& start, const Vector2int32& upTo, int threadID) {
+        (void)threadID;
+        for (int r = start.x; r < upTo.x; ++r) {
+            const ParseOBJFaceRun& R = faceRun[r];
+            const ParseOBJ* src = chunk[R.chunk];
+            Array<ParseOBJ::Face>& dst = R.mesh->faceArray;
+
+            for (int f = R.begin; f < R.end; ++f) {
+                ParseOBJ::Face& face = dst[R.destination + f - R.begin];
+                face = src->m_deferredFace[f];
+
+                if (src->m_hasRelativeIndex) {
+                    for (int i = 0; i < face.size(); ++i) {
+                        ParseOBJ::Index& index = face[i];
+                        index.vertex   = ParseOBJ::decodeRelativeIndex(index.vertex,   vertexBase[R.chunk]);
+                        index.texCoord = ParseOBJ::decodeRelativeIndex(index.texCoord, texCoordBase[R.chunk]);
+                        index.normal   = ParseOBJ::decodeRelativeIndex(index.normal,   normalBase[R.chunk]);
+                    }
+                }
+            }
+        }
+    }
+};
+
+} // namespace _internal
+
+
+ParseOBJ::ParseOBJ() :
+    nextCharacter(NULL),
+    remainingCharacters(0),
+    m_line(1),
+    m_deferCommands(false),
+    m_hasRelativeIndex(false),
+    m_failed(false) {}
+
+
+void ParseOBJ::parse(const char* ptr, size_t len, const std::string& basePath, int maxThreads) {
     vertexArray.clear();
     normalArray.clear();
     texCoordArray.clear();
@@ -29,8 +125,19 @@ void ParseOBJ::parse(const char* ptr, size_t len, const std::string& basePath) {
 
     m_basePath = basePath;
 
+    alwaysAssertM(len < 0x7FFFFFFF, "Cannot handle more than 2GB of input text.");
+
+    if (maxThreads == ThreadPool::NUM_CORES) {
+        maxThreads = ThreadPool::numThreads();
+    }
+    // Several chunks per thread so that dense and sparse parts of the file balance
+    const int numChunks = iMin(int(len / MIN_CHUNK_LENGTH), 4 * maxThreads);
+    if ((maxThreads > 1) && (numChunks > 1)) {
+        parseParallel(ptr, len, numChunks, maxThreads);
+        return;
+    }
+
     nextCharacter = ptr;
-    alwaysAssertM(len < 0xFFFFFFFF, "Cannot handle more than 4GB of input text.");
     remainingCharacters = (int)len;
     m_line = 1;
 
@@ -48,7 +155,157 @@ void ParseOBJ::parse(const char* ptr, size_t len, const std::string& basePath) {
 }
 
 
-void ParseOBJ::parse(BinaryInput& bi, const std::string& basePath) {
+void ParseOBJ::parseChunk(const char* ptr, int len) {
+    m_deferCommands = true;
+    nextCharacter = ptr;
+    remainingCharacters = len;
+    m_line = 1;
+
+    try {
+        while (remainingCharacters > 0) {
+            maybeReadWhitespace();
+            const Command command = readCommand();
+            processCommand(command);
+        }
+    } catch (const ParseError& e) {
+        // Rethrown on the calling thread by parseParallel
+        m_failed = true;
+        m_error = e;
+    }
+}
+
+
+void ParseOBJ::parseParallel(const char* ptr, size_t len, int numChunks, int maxThreads) {
+    G3D_PROFILE_ZONE("ParseOBJ::parseParallel");
+
+    // Split just after newlines so that every chunk starts at the
+    // beginning of a line
+    const char* end = ptr + len;
+    Array<const char*> boundary;
+    boundary.append(ptr);
+    for (int c = 1; c < numChunks; ++c) {
+        const char* p = G3D::max(ptr + len * c / numChunks, boundary.last());
+        while ((p < end) && (*p != '\n')) {
+            ++p;
+        }
+        if (p < end) {
+            ++p;
+        }
+        boundary.append(p);
+    }
+    boundary.append(end);
+
+    Array<ParseOBJ*> chunk;
+    chunk.resize(numChunks);
+    for (int c = 0; c < numChunks; ++c) {
+        chunk[c] = new ParseOBJ();
+        chunk[c]->m_filename = m_filename;
+    }
+
+    try {
+        {
+            _internal::ParseOBJChunkBody body(chunk, boundary);
+            ThreadPool::parallelFor(body, 0, numChunks, 1, maxThreads);
+        }
+
+        // Report the first error, with its line number relative to the whole file
+        int line = 0;
+        for (int c = 0; c < numChunks; ++c) {
+            if (chunk[c]->m_failed) {
+                ParseError e = chunk[c]->m_error;
+                e.line += line;
+                throw e;
+            }
+            line += chunk[c]->m_line - 1;
+        }
+        m_line = line + 1;
+
+        // Concatenate the vertex attributes
+        Array<int> vertexBase, texCoordBase, normalBase;
+        vertexBase.append(0);
+        texCoordBase.append(0);
+        normalBase.append(0);
+        for (int c = 0; c < numChunks; ++c) {
+            vertexBase.append(vertexBase.last() + chunk[c]->vertexArray.size());
+            texCoordBase.append(texCoordBase.last() + chunk[c]->texCoordArray.size());
+            normalBase.append(normalBase.last() + chunk[c]->normalArray.size());
+        }
+        vertexArray.resize(vertexBase.last());
+        texCoordArray.resize(texCoordBase.last());
+        normalArray.resize(normalBase.last());
+        for (int c = 0; c < numChunks; ++c) {
+            const ParseOBJ* k = chunk[c];
+            System::memcpy(vertexArray.getCArray() + vertexBase[c], k->vertexArray.getCArray(), sizeof(Point3) * k->vertexArray.size());
+            System::memcpy(texCoordArray.getCArray() + texCoordBase[c], k->texCoordArray.getCArray(), sizeof(Point2) * k->texCoordArray.size());
+            System::memcpy(normalArray.getCArray() + normalBase[c], k->normalArray.getCArray(), sizeof(Vector3) * k->normalArray.size());
+        }
+
+        // Replay the group and material commands in file order to assign
+        // each run of faces to its mesh, exactly as a serial parse would
+        const int maxRunLength = 16384;
+        Array<_internal::ParseOBJFaceRun> run;
+        Table<Mesh*, int> meshSize;
+        for (int c = 0; c < numChunks; ++c) {
+            const ParseOBJ* k = chunk[c];
+            int face = 0;
+            for (int d = 0; d <= k->m_deferredCommand.size(); ++d) {
+                const int next = (d < k->m_deferredCommand.size()) ? k->m_deferredCommand[d].faceCount : k->m_deferredFace.size();
+                if (next > face) {
+                    Mesh* mesh = currentMesh();
+                    bool created = false;
+                    int& size = meshSize.getCreate(mesh, created);
+                    if (created) {
+                        size = 0;
+                    }
+                    // Split long runs so that the copy balances across threads
+                    for (int f = face; f < next; f += maxRunLength) {
+                        run.append(_internal::ParseOBJFaceRun(c, f, iMin(f + maxRunLength, next), mesh, size + f - face));
+                    }
+                    size += next - face;
+                    face = next;
+                }
+
+                if (d < k->m_deferredCommand.size()) {
+                    const DeferredCommand& command = k->m_deferredCommand[d];
+                    switch (command.command) {
+                    case GROUP:
+                        setGroup(command.name);
+                        break;
+
+                    case USEMTL:
+                        setMaterial(command.name);
+                        break;
+
+                    case MTLLIB:
+                        loadMaterialLibrary(command.name);
+                        break;
+
+                    default:
+                        debugAssertM(false, "Unexpected deferred command");
+                    }
+                }
+            }
+        }
+
+        for (Table<Mesh*, int>::Iterator it = meshSize.begin(); it.hasMore(); ++it) {
+            debugAssert(it->key->faceArray.size() == 0);
+            it->key->faceArray.resize(it->value);
+        }
+
+        {
+            _internal::ParseOBJMergeBody body(chunk, run, vertexBase, texCoordBase, normalBase);
+            ThreadPool::parallelFor(body, 0, run.size(), 1, maxThreads);
+        }
+    } catch (...) {
+        chunk.invokeDeleteOnAllElements();
+        throw;
+    }
+
+    chunk.invokeDeleteOnAllElements();
+}
+
+
+void ParseOBJ::parse(BinaryInput& bi, const std::string& basePath, int maxThreads) {
     m_filename = bi.getFilename();
 
     std::string bp = basePath;
@@ -57,7 +314,7 @@ void ParseOBJ::parse(BinaryInput& bi, const std::string& basePath) {
     }    
 
     parse((const char*)bi.getCArray() + bi.getPosition(),
-          bi.getLength() - bi.getPosition(), bp);
+          bi.getLength() - bi.getPosition(), bp, maxThreads);
 }
 
 
@@ -204,13 +461,13 @@ ParseOBJ::Command ParseOBJ::readCommand() {
 }
 
 
-void ParseOBJ::readFace() {
+ParseOBJ::Mesh* ParseOBJ::currentMesh() {
     // Ensure that we have a material
     if (m_currentMaterial.isNull()) {
         m_currentMaterial = m_currentMaterialLibrary.materialTable["default"];
     }
 
-    // Mnsure that we have a group
+    // Ensure that we have a group
     if (m_currentGroup.isNull()) {
         // Create a group named "default", per the OBJ specification
         m_currentGroup = Group::create();
@@ -233,7 +490,83 @@ void ParseOBJ::readFace() {
         m_currentMesh = m;
     }
 
-    Face& face = m_currentMesh->faceArray.next();
+    return m_currentMesh.pointer();
+}
+
+
+void ParseOBJ::setGroup(const std::string& groupName) {
+    Group::Ref& g = groupTable.getCreate(groupName);
+
+    if (g.isNull()) {
+        // Newly created
+        g = Group::create();
+        g->name = groupName;
+    }
+
+    m_currentGroup = g;
+
+    // The mesh belongs to the previous group
+    m_currentMesh = NULL;
+}
+
+
+void ParseOBJ::setMaterial(const std::string& materialName) {
+    m_currentMaterial = getMaterial(materialName);
+
+    // Force re-obtaining or creating of the appropriate mesh
+    m_currentMesh = NULL;
+}
+
+
+void ParseOBJ::loadMaterialLibrary(const std::string& filename) {
+    TextInput ti2(FilePath::concat(m_basePath, filename));
+    m_currentMaterialLibrary.parse(ti2);
+}
+
+
+void ParseOBJ::deferCommand(Command command, const std::string& name) {
+    DeferredCommand& d = m_deferredCommand.next();
+    d.command   = command;
+    d.name      = name;
+    d.faceCount = m_deferredFace.size();
+}
+
+
+int ParseOBJ::makeZeroBased(int index, int arraySize) {
+    if (index > 0) {
+        return index - 1;
+    } else if (m_deferCommands) {
+        // The number of elements before this chunk is not yet known
+        m_hasRelativeIndex = true;
+        return encodeRelativeIndex(index + arraySize);
+    } else {
+        // Negative; make relative to the current end of the array.
+        // -1 will be the last element, so just add the size of the array.
+        return index + arraySize;
+    }
+}
+
+
+double ParseOBJ::scaleByPowerOfTen(double x, int e) {
+    // Every power of ten up to 10^22 is exactly representable as a double
+    static const double exact[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    if (x == 0.0) {
+        return x;
+    } else if ((e >= 0) && (e <= 22)) {
+        return x * exact[e];
+    } else if ((e < 0) && (e >= -22)) {
+        return x / exact[-e];
+    } else {
+        return x * ::pow(10.0, double(e));
+    }
+}
+
+
+void ParseOBJ::readFace() {
+    Face& face = m_deferCommands ? m_deferredFace.next() : currentMesh()->faceArray.next();
 
     const int vertexArraySize   = vertexArray.size();
     const int texCoordArraySize = texCoordArray.size();
@@ -245,15 +578,7 @@ void ParseOBJ::readFace() {
         Index& index = face.next();
 
         // Read index
-        index.vertex = readInt();
-        if (index.vertex > 0) {
-            // Make 0-based
-            --index.vertex;
-        } else {
-            // Negative; make relative to the current end of the array.
-            // -1 will be the last element, so just add the size of the array.
-            index.vertex += vertexArraySize;
-        }
+        index.vertex = makeZeroBased(readInt(), vertexArraySize);
 
         if ((remainingCharacters > 0) && (*nextCharacter == '/')) {
             // Read the slash
@@ -262,16 +587,7 @@ void ParseOBJ::readFace() {
             if (remainingCharacters > 0) {
                 if (*nextCharacter != '/') {
                     // texcoord index
-                    index.texCoord = readInt();
-                    if (index.texCoord > 0) {
-                        // Make 0-based
-                        --index.texCoord;
-                    } else {
-                        // Negative; make relative to the current end
-                        // of the array.  -1 will be the last element,
-                        // so just add the size of the array.
-                        index.texCoord += texCoordArraySize;
-                    }
+                    index.texCoord = makeZeroBased(readInt(), texCoordArraySize);
                 }
 
                 if ((remainingCharacters > 0) && (*nextCharacter == '/')) {
@@ -279,17 +595,7 @@ void ParseOBJ::readFace() {
                     consumeCharacter();
 
                     // normal index
-                    index.normal = readInt();
-                    if (index.normal > 0) {
-                        // Make 0-based
-                        --index.normal;
-                    } else {
-                        // Negative; make relative to the current
-                        // end of the array.  -1 will be the last
-                        // element, so just add the size of the
-                        // array.
-                        index.normal += normalArraySize;
-                    }       
+                    index.normal = makeZeroBased(readInt(), normalArraySize);
                 }
             }
         }
@@ -331,17 +637,12 @@ void ParseOBJ::processCommand(const Command command) {
     case GROUP:
         {
             // Change group
-            std::string groupName = readName();
-
-            Group::Ref& g = groupTable.getCreate(groupName);
-
-            if (g.isNull()) {
-                // Newly created
-                g = Group::create();
-                g->name = groupName;
+            const std::string& groupName = readName();
+            if (m_deferCommands) {
+                deferCommand(command, groupName);
+            } else {
+                setGroup(groupName);
             }
-
-            m_currentGroup = g;
         }
         // Consume anything else on this line
         readUntilNewline();
@@ -351,10 +652,11 @@ void ParseOBJ::processCommand(const Command command) {
         {
             // Change the mesh within the group
             const std::string& materialName = readName();
-            m_currentMaterial = getMaterial(materialName);
-
-            // Force re-obtaining or creating of the appropriate mesh
-            m_currentMesh = NULL;
+            if (m_deferCommands) {
+                deferCommand(command, materialName);
+            } else {
+                setMaterial(materialName);
+            }
         }
         // Consume anything else on this line
         readUntilNewline();
@@ -363,11 +665,12 @@ void ParseOBJ::processCommand(const Command command) {
     case MTLLIB:
         {
             // Specify material library 
-            std::string mtlFilename = readName();
-            mtlFilename = FilePath::concat(m_basePath, mtlFilename);
-
-            TextInput ti2(mtlFilename);
-            m_currentMaterialLibrary.parse(ti2);
+            const std::string& mtlFilename = readName();
+            if (m_deferCommands) {
+                deferCommand(command, mtlFilename);
+            } else {
+                loadMaterialLibrary(mtlFilename);
+            }
         }
         // Consume anything else on this line
         readUntilNewline();
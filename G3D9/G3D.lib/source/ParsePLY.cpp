@@ -3,7 +3,7 @@
 
  \author Morgan McGuire, http://graphics.cs.williams.edu
  \created 2011-07-23
- \edited  2011-07-23
+ \edited  2026-10-17
  
  Copyright 2000-2012, Morgan McGuire.
  All rights reserved.
@@ -13,10 +13,24 @@
 #include "G3D/FileSystem.h"
 #include "G3D/stringutils.h"
 #include "G3D/ParseError.h"
+#include "G3D/System.h"
 
 namespace G3D {
     
-ParsePLY::ParsePLY() : vertexData(NULL), faceArray(NULL), triStripArray(NULL) {}
+ParsePLY::ParsePLY() : 
+    numVertices(0),
+    numFaces(0),
+    numTriStrips(0),
+    vertexData(NULL), 
+    faceArray(NULL), 
+    triStripArray(NULL),
+    m_vertexStride(0),
+    m_allFloatVertices(false),
+    m_numPropertiesBeforeIndex(0),
+    m_numPropertiesAfterIndex(0),
+    m_packedIndexList(false),
+    m_numVerticesRead(0),
+    m_numFacesRead(0) {}
 
 
 void ParsePLY::clear() {
@@ -27,6 +41,10 @@ void ParsePLY::clear() {
     delete[] triStripArray;
     triStripArray = NULL;
     numVertices = numFaces = numTriStrips = 0;
+    vertexProperty.fastClear();
+    faceOrTriStripProperty.fastClear();
+    m_vertexOffset.fastClear();
+    m_numVerticesRead = m_numFacesRead = 0;
 }
 
 
@@ -38,20 +56,62 @@ ParsePLY::~ParsePLY() {
 void ParsePLY::parse(BinaryInput& bi) {
     const G3DEndian oldEndian = bi.endian();
 
-    clear();
-    readHeader(bi);
+    parseHeader(bi);
 
     vertexData = new float[numVertices * vertexProperty.size()];
     faceArray = new Face[numFaces];
     triStripArray = new TriStrip[numTriStrips];
 
-    readVertexList(bi);
-    readFaceList(bi);
+    readVertices(bi, vertexData, numVertices);
+    if (numFaces > 0) {
+        readFaces(bi, faceArray, NULL, numFaces);
+    } else {
+        readFaces(bi, NULL, triStripArray, numTriStrips);
+    }
 
     bi.setEndian(oldEndian);
 }
 
 
+void ParsePLY::parseHeader(BinaryInput& bi) {
+    clear();
+    readHeader(bi);
+    compileDecoders(bi);
+}
+
+
+int ParsePLY::readVertexBatch(BinaryInput& bi, Array<float>& data, int maxVertices) {
+    const int n = iMin(maxVertices, numVertices - m_numVerticesRead);
+    data.resize(n * vertexProperty.size(), false);
+    if (n > 0) {
+        readVertices(bi, data.getCArray(), n);
+    }
+    return n;
+}
+
+
+int ParsePLY::readFaceBatch(BinaryInput& bi, Array<Face>& face, int maxFaces) {
+    debugAssertM(m_numVerticesRead == numVertices, "Must read all vertices before faces");
+    const int n = iMin(maxFaces, numFaces - m_numFacesRead);
+    face.resize(n, false);
+    if (n > 0) {
+        readFaces(bi, face.getCArray(), NULL, n);
+    }
+    return n;
+}
+
+
+int ParsePLY::readTriStripBatch(BinaryInput& bi, Array<TriStrip>& triStrip, int maxTriStrips) {
+    debugAssertM(m_numVerticesRead == numVertices, "Must read all vertices before tristrips");
+    const int n = iMin(maxTriStrips, numTriStrips - m_numFacesRead);
+    triStrip.resize(n, false);
+    if (n > 0) {
+        readFaces(bi, NULL, triStrip.getCArray(), n);
+    }
+    return n;
+}
+
+
 ParsePLY::DataType ParsePLY::parseDataType(const char* t) {
     static const char* names[] = {"char", "uchar", "short", "ushort", "int", "uint", "float", "double", "list", NULL};
 
@@ -129,7 +189,7 @@ void ParsePLY::readHeader(BinaryInput& bi) {
             // Ignore this line
             s = bi.readStringNewline();
 
-        } if (beginsWith(s, "element vertex ")) {
+        } else if (beginsWith(s, "element vertex ")) {
             if (readVertex) {
                 throw std::string("Already defined vertex.");
             }
@@ -246,80 +306,288 @@ float ParsePLY::readAsFloat(const Property& prop, BinaryInput& bi) {
 }
 
 
-void ParsePLY::readVertexList(BinaryInput& bi) {
-    const int N = vertexProperty.size();
-    int i = 0;
-    for (int v = 0; v < numVertices; ++v) {
-        for (int p = 0; p < N; ++p) {
-            vertexData[i] = readAsFloat(vertexProperty[p], bi);
-            ++i;
+void ParsePLY::compileDecoders(BinaryInput& bi) {
+    // Vertices
+    m_allFloatVertices = true;
+    m_vertexStride = 0;
+    m_vertexOffset.resize(vertexProperty.size());
+    for (int p = 0; p < vertexProperty.size(); ++p) {
+        const DataType type = vertexProperty[p].type;
+        m_allFloatVertices = m_allFloatVertices && (type == float_type);
+        if (type == list_type) {
+            // Variable length; decode property by property
+            m_vertexStride = 0;
+            m_allFloatVertices = false;
+            break;
         }
+        m_vertexOffset[p] = m_vertexStride;
+        m_vertexStride += (int)byteSize(type);
     }
-}
-
 
-void ParsePLY::readFaceList(BinaryInput& bi) {
-    // How many properties are there before and after
-    // the vertex_index list?
-    int numBefore = 0, numAfter = faceOrTriStripProperty.size() - 2;
+    // Faces.  How many properties are there before and after the
+    // vertex_index list?
+    m_numPropertiesBeforeIndex = 0;
+    m_numPropertiesAfterIndex = faceOrTriStripProperty.size() - 1;
+    m_packedIndexList = false;
 
     bool found = false;
-    for (int p = 0; p < faceOrTriStripProperty.size(); ++p) {
+    for (int p = 0; (p < faceOrTriStripProperty.size()) && ! found; ++p) {
         if ((faceOrTriStripProperty[p].name == "vertex_index") || 
             (faceOrTriStripProperty[p].name == "vertex_indices")) {
             found = true;
         } else {
-            ++numBefore;
-            --numAfter;
+            ++m_numPropertiesBeforeIndex;
+            --m_numPropertiesAfterIndex;
         }
     }
 
     if (! found) {
-        throw ParseError(bi.getFilename(), bi.getPosition(), "No vertex_index or vertex_indices property on faces in this PLY file");
+        if (numFaces + numTriStrips > 0) {
+            throw ParseError(bi.getFilename(), bi.getPosition(), "No vertex_index or vertex_indices property on faces in this PLY file");
+        }
+        return;
+    }
+
+    const Property& index = faceOrTriStripProperty[m_numPropertiesBeforeIndex];
+    m_packedIndexList = 
+        (faceOrTriStripProperty.size() == 1) &&
+        (byteSize(index.listLengthType) == 1) &&
+        ((index.listElementType == int_type) || (index.listElementType == uint_type));
+}
+
+
+/** Reads a T that may be unaligned, reversing its bytes if \a swap is true */
+template<class T, bool swap>
+static inline T loadScalar(const uint8* src) {
+    T x;
+    if (swap) {
+        uint8 b[sizeof(T)];
+        for (int i = 0; i < (int)sizeof(T); ++i) {
+            b[i] = src[sizeof(T) - 1 - i];
+        }
+        System::memcpy(&x, b, sizeof(T));
+    } else {
+        System::memcpy(&x, src, sizeof(T));
+    }
+    return x;
+}
+
+
+/** Converts one property of \a n packed vertices to float */
+template<class T, bool swap>
+static void decodeColumn(const uint8* src, int srcStride, float* dst, int dstStride, int n) {
+    for (int v = 0; v < n; ++v, src += srcStride, dst += dstStride) {
+        *dst = (float)loadScalar<T, swap>(src);
     }
+}
+
+
+template<bool swap>
+static void decodeColumn(ParsePLY::DataType type, const uint8* src, int srcStride, float* dst, int dstStride, int n) {
+    switch (type) {
+    case ParsePLY::char_type:
+        decodeColumn<int8, swap>(src, srcStride, dst, dstStride, n);
+        break;
+
+    case ParsePLY::uchar_type:
+        decodeColumn<uint8, swap>(src, srcStride, dst, dstStride, n);
+        break;
+
+    case ParsePLY::short_type:
+        decodeColumn<int16, swap>(src, srcStride, dst, dstStride, n);
+        break;
 
-    // Only one of these is nonzero
-    const int num = max(numFaces, numTriStrips);
+    case ParsePLY::ushort_type:
+        decodeColumn<uint16, swap>(src, srcStride, dst, dstStride, n);
+        break;
+
+    case ParsePLY::int_type:
+        decodeColumn<int32, swap>(src, srcStride, dst, dstStride, n);
+        break;
 
-    for (int f = 0; f < num; ++f) {
+    case ParsePLY::uint_type:
+        decodeColumn<uint32, swap>(src, srcStride, dst, dstStride, n);
+        break;
+
+    case ParsePLY::float_type:
+        decodeColumn<float32, swap>(src, srcStride, dst, dstStride, n);
+        break;
+
+    case ParsePLY::double_type:
+        decodeColumn<float64, swap>(src, srcStride, dst, dstStride, n);
+        break;
+
+    default:
+        debugAssertM(false, "Illegal data type for a packed vertex");
+    }
+}
+
+
+void ParsePLY::readVertices(BinaryInput& bi, float* data, int n) {
+    debugAssert(m_numVerticesRead + n <= numVertices);
+    m_numVerticesRead += n;
+    const int N = vertexProperty.size();
+
+    if (m_allFloatVertices) {
+        // The decoded layout is identical to the file's
+        bi.readFloat32(data, int64(n) * N);
+
+    } else if (m_vertexStride > 0) {
+        // Decode a window of vertices at a time, one property at a time,
+        // directly from the file's buffer
+        const bool swap = (bi.endian() != System::machineEndian());
+        const int windowLength = iMax(1, (1024 * 1024) / m_vertexStride);
+        Array<uint8> scratch;
+        for (int v = 0; v < n; v += windowLength) {
+            const int count = iMin(windowLength, n - v);
+            const uint8* src = bi.viewUInt8(int64(count) * m_vertexStride, scratch);
+            float* dst = data + int64(v) * N;
+            for (int p = 0; p < N; ++p) {
+                if (swap) {
+                    decodeColumn<true>(vertexProperty[p].type, src + m_vertexOffset[p], m_vertexStride, dst + p, N, count);
+                } else {
+                    decodeColumn<false>(vertexProperty[p].type, src + m_vertexOffset[p], m_vertexStride, dst + p, N, count);
+                }
+            }
+        }
+
+    } else {
+        // Lists may appear, so every property must be parsed in sequence
+        int i = 0;
+        for (int v = 0; v < n; ++v) {
+            for (int p = 0; p < N; ++p) {
+                data[i] = readAsFloat(vertexProperty[p], bi);
+                ++i;
+            }
+        }
+    }
+}
+
+
+void ParsePLY::readFaces(BinaryInput& bi, Face* face, TriStrip* triStrip, int n) {
+    debugAssert((face == NULL) != (triStrip == NULL));
+    debugAssert(m_numFacesRead + n <= iMax(numFaces, numTriStrips));
+    m_numFacesRead += n;
+
+    if (m_packedIndexList) {
+        readPackedFaces(bi, face, triStrip, n);
+        return;
+    }
+
+    for (int f = 0; f < n; ++f) {
         int p = 0;
         // Ignore properties before.  Each one might contain lists and therefore
         // have variable length, so we actually have to parse this data even
         // though we throw it away.
-        for (int i = 0; i < numBefore; ++i) {
+        for (int i = 0; i < m_numPropertiesBeforeIndex; ++i) {
             (void)readAsFloat(faceOrTriStripProperty[p], bi);
             ++p;
         }
 
         // Now read the index list
         const Property& prop = faceOrTriStripProperty[p];
+        ++p;
         const int len = readAs<int>(prop.listLengthType, bi);
 
-        if (numFaces > 0) {
+        if (face != NULL) {
             // Read one face
-            Face& face = faceArray[f];
+            Face& dst = face[f];
+            dst.resize(len, false);
             for (int i = 0; i < len; ++i) {
                 const int index = readAs<int>(prop.listElementType, bi);
                 debugAssert(index >= 0 && index < numVertices);
-                face.append(index);
+                dst[i] = index;
             }
         } else {
             // Read one tristrip
-            TriStrip& triStrip = triStripArray[f];
+            TriStrip& dst = triStrip[f];
+            dst.resize(len, false);
             for (int i = 0; i < len; ++i) {
                 const int index = readAs<int>(prop.listElementType, bi);
                 debugAssert(index >= -1 && index < numVertices);  // -1 = "restart tristrip"
-                triStrip.append(index);
+                dst[i] = index;
             }
         }
 
         // Ignore properties after
-        for (int i = 0; i < numAfter; ++i) {
+        for (int i = 0; i < m_numPropertiesAfterIndex; ++i) {
             (void)readAsFloat(faceOrTriStripProperty[p], bi);
             ++p;
         }
     }
 }
 
+
+template<bool swap>
+static inline void decodeIndices(const uint8* src, int len, ParsePLY::Face& dst) {
+    dst.resize(len, false);
+    for (int i = 0; i < len; ++i) {
+        dst[i] = (int)loadScalar<uint32, swap>(src + 4 * i);
+    }
+}
+
+
+template<bool swap>
+static inline void decodeIndices(const uint8* src, int len, ParsePLY::TriStrip& dst) {
+    dst.resize(len, false);
+    System::memcpy(dst.getCArray(), src, 4 * len);
+    if (swap) {
+        uint32* index = (uint32*)dst.getCArray();
+        for (int i = 0; i < len; ++i) {
+            index[i] = flipEndian32(index[i]);
+        }
+    }
+}
+
+
+/** Decodes up to \a n lists of a one-byte length followed by four-byte
+    indices from [begin, end).  Returns a pointer to the first list that
+    was not decoded because it is incomplete, and adds the number decoded to \a f. */
+template<bool swap, class List>
+static const uint8* decodeIndexLists(const uint8* begin, const uint8* end, List* list, int n, int& f) {
+    const uint8* src = begin;
+    while ((f < n) && (src < end)) {
+        const int len = *src;
+        const uint8* index = src + 1;
+        if (index + 4 * len > end) {
+            break;
+        }
+        decodeIndices<swap>(index, len, list[f]);
+        src = index + 4 * len;
+        ++f;
+    }
+    return src;
+}
+
+
+void ParsePLY::readPackedFaces(BinaryInput& bi, Face* face, TriStrip* triStrip, int n) {
+    const bool swap = (bi.endian() != System::machineEndian());
+
+    // Faces are variable length, so view a window of the file, decode
+    // the complete faces within it, and then rewind to the first
+    // incomplete one.  Single-byte views never copy.
+    const int64 windowLength = 1024 * 1024;
+    Array<uint8> scratch;
+    int f = 0;
+    while (f < n) {
+        const int64 start = bi.getPosition();
+        const int64 length = G3D::min(windowLength, bi.getLength() - start);
+        const uint8* begin = bi.viewUInt8(length, scratch);
+        const uint8* end = begin + length;
+
+        const uint8* next = NULL;
+        if (face != NULL) {
+            next = swap ? decodeIndexLists<true>(begin, end, face, n, f) : decodeIndexLists<false>(begin, end, face, n, f);
+        } else {
+            next = swap ? decodeIndexLists<true>(begin, end, triStrip, n, f) : decodeIndexLists<false>(begin, end, triStrip, n, f);
+        }
+
+        if ((next == begin) && (f < n)) {
+            throw ParseError(bi.getFilename(), start, "PLY file ends in the middle of a face");
+        }
+        bi.setPosition(start + (next - begin));
+    }
+}
+
 } // G3D
 
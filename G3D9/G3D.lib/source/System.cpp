@@ -11,7 +11,7 @@
   determine if we can safely call the routines that use that assembly.
 
   \created 2003-01-25
-  \edited  2012-01-05
+  \edited  2026-10-17
  */
 
 #include "G3D/platform.h"
@@ -112,6 +112,9 @@ System::System() :
     m_hasSSE(false),
     m_hasSSE2(false),
     m_hasSSE3(false),
+    m_hasSSSE3(false),
+    m_hasSSE42(false),
+    m_hasPCLMUL(false),
     m_has3DNOW(false),
     m_has3DNOW2(false),
     m_hasAMDMMX(false),
@@ -599,6 +602,9 @@ void System::getStandardProcessorExtensions() {
     // Bit 28 is HTT; not checked by G3D
 
     m_hasSSE3     = checkBit(ecxreg, 0);
+    m_hasPCLMUL   = checkBit(ecxreg, 1);
+    m_hasSSSE3    = checkBit(ecxreg, 9);
+    m_hasSSE42    = checkBit(ecxreg, 20);
 
     if (m_highestCPUIDFunction >= CPUID_EXTENDED_FEATURES) {
         cpuid(CPUID_EXTENDED_FEATURES, eaxreg, ebxreg, ecxreg, features);
@@ -986,350 +992,302 @@ RealTime System::time() {
 #define REALPTR_TO_USERPTR(x)   ((uint8*)(x) + sizeof(size_t))
 #define USERPTR_TO_REALPTR(x)   ((uint8*)(x) - sizeof(size_t))
 #define USERSIZE_TO_REALSIZE(x)       ((x) + sizeof(size_t))
-#define REALSIZE_FROM_USERPTR(u) (*(size_t*)USERPTR_TO_REALPTR(ptr) + sizeof(size_t))
-#define USERSIZE_FROM_USERPTR(u) (*(size_t*)USERPTR_TO_REALPTR(ptr))
+#define REALSIZE_FROM_USERPTR(u) (*(size_t*)USERPTR_TO_REALPTR(u) + sizeof(size_t))
+#define USERSIZE_FROM_USERPTR(u) (*(size_t*)USERPTR_TO_REALPTR(u))
 
-class BufferPool {
+/** Thread-local free list of the blocks of one size class */
+class BufferPoolCacheClass {
 public:
+    void*       head;
+    int         count;
+};
 
-    /** Only store buffers up to these sizes (in bytes) in each pool->
-        Different pools have different management strategies.
 
-        A large block is preallocated for tiny buffers; they are used with
-        tremendous frequency.  Other buffers are allocated as demanded.
-        Tiny buffers are 128 bytes long because that seems to align well with
-        cache sizes on many machines.
-      */
-    enum {tinyBufferSize = 128, smallBufferSize = 1024, medBufferSize = 4096};
+/** Allocation counters kept by each thread.  Only the owning thread writes them. */
+class BufferPoolCounters {
+public:
+    int         totalMallocs;
+    int         mallocsFromHeap;
 
-    /** 
-       Most buffers we're allowed to store.
-       250000 * 128  = 32 MB (preallocated)
-        10000 * 1024 = 10 MB (allocated on demand)
-         1024 * 4096 =  4 MB (allocated on demand)
-     */
-    enum {maxTinyBuffers = 250000, maxSmallBuffers = 10000, maxMedBuffers = 1024};
+    /** Number of times that an empty thread cache was refilled from the shared pool */
+    int         refills;
 
-private:
+    /** Number of times that an empty thread cache was refilled with a new slab */
+    int         slabs;
 
-    /** Pointer given to the program.  Unless in the tiny heap, the user size of the block is stored right in front of the pointer as a uint32.*/
-    typedef void* UserPtr;
-
-    /** Actual block allocated on the heap */
-    typedef void* RealPtr;
+    /** Bytes currently allocated on the heap (for blocks larger than BufferPool::maxPooledSize).
+        May be negative for a single thread if it frees memory allocated by another. */
+    int64       heapBytes;
 
-    class MemBlock {
-    public:
-        UserPtr     ptr;
-        size_t      bytes;
+    void add(const BufferPoolCounters& c) {
+        totalMallocs    += c.totalMallocs;
+        mallocsFromHeap += c.mallocsFromHeap;
+        refills         += c.refills;
+        slabs           += c.slabs;
+        heapBytes       += c.heapBytes;
+    }
 
-        inline MemBlock() : ptr(NULL), bytes(0) {}
-        inline MemBlock(UserPtr p, size_t b) : ptr(p), bytes(b) {}
-    };
+    void resetPerformance() {
+        totalMallocs    = 0;
+        mallocsFromHeap = 0;
+        refills         = 0;
+        slabs           = 0;
+    }
+};
 
-    MemBlock smallPool[maxSmallBuffers];
-    int smallPoolSize;
 
-    MemBlock medPool[maxMedBuffers];
-    int medPoolSize;
+/** Per-thread state of the BufferPool.  Allocated with ::calloc, so all fields start at zero. */
+class BufferPoolThreadCache {
+public:
+    enum {numClasses = 28};
 
-    /** The tiny pool is a single block of storage into which all tiny
-        objects are allocated.  This provides better locality for
-        small objects and avoids the search time, since all tiny
-        blocks are exactly the same size. */
-    void* tinyPool[maxTinyBuffers];
-    int tinyPoolSize;
+    BufferPoolCacheClass    cls[numClasses];
+    BufferPoolCounters      counters;
 
-    /** Pointer to the data in the tiny pool */
-    void* tinyHeap;
+    /** Next cache in BufferPool's registry */
+    BufferPoolThreadCache*  next;
+};
 
-    Spinlock            m_lock;
 
-    void lock() {
-        m_lock.lock();
-    }
+/** The calling thread's cache, created on its first call to System::malloc or System::free */
+static G3D_THREAD_LOCAL BufferPoolThreadCache* currentThreadCache = NULL;
 
-    void unlock() {
-        m_lock.unlock();
-    }
 
-#if 0 //-----------------------------------------------old mutex
+/** Returns the old value of *p, which equals comperand if the exchange was performed.
+    Full memory barrier. */
+static inline void* atomicCompareAndSetPointer(void* volatile* p, void* comperand, void* exchange) {
 #   ifdef G3D_WIN32
-    CRITICAL_SECTION    mutex;
+        return InterlockedCompareExchangePointer((PVOID volatile*)p, exchange, comperand);
 #   else
-    pthread_mutex_t     mutex;
+        return __sync_val_compare_and_swap(p, comperand, exchange);
 #   endif
+}
 
-    /** Provide synchronization between threads */
-    void lock() {
-#       ifdef G3D_WIN32
-            EnterCriticalSection(&mutex);
-#       else
-            pthread_mutex_lock(&mutex);
-#       endif
-    }
 
-    void unlock() {
-#       ifdef G3D_WIN32
-            LeaveCriticalSection(&mutex);
-#       else
-            pthread_mutex_unlock(&mutex);
-#       endif
-    }
-#endif //-------------------------------------------old mutex
+/** Sets *p = x and returns the old value. Full memory barrier. */
+static inline void* atomicExchangePointer(void* volatile* p, void* x) {
+#   ifdef G3D_WIN32
+        return InterlockedExchangePointer((PVOID volatile*)p, x);
+#   else
+        __sync_synchronize();
+        return __sync_lock_test_and_set(p, x);
+#   endif
+}
 
-    /** 
-     Malloc out of the tiny heap. Returns NULL if allocation failed.
-     */
-    inline UserPtr tinyMalloc(size_t bytes) {
-        // Note that we ignore the actual byte size
-        // and create a constant size block.
-        (void)bytes;
-        assert(tinyBufferSize >= bytes);
 
-        UserPtr ptr = NULL;
+/**
+ Small-object allocator behind System::malloc.
 
-        if (tinyPoolSize > 0) {
-            --tinyPoolSize;
+ Requests up to maxPooledSize bytes are rounded up to one of numClasses
+ size classes (16-byte steps up to 128 bytes, then four classes per
+ power of two, so at most 25% of a block is wasted).  Each thread keeps
+ a free list per size class, so the common case of malloc and free
+ takes no lock and issues no atomic operation.
 
-            // Return the old last pointer from the freelist
-            ptr = tinyPool[tinyPoolSize];
+ When a thread's list for a class runs empty it takes a batch of blocks
+ from a lock-free shared stack of batches for that class, or carves a
+ new slab if the shared stack is empty.  When a thread's list grows
+ beyond two batches, one batch is pushed back onto the shared stack.
+ This bounds the memory that a thread can hoard and lets blocks that
+ are allocated on one thread and freed on another flow back.
 
-#           ifdef G3D_DEBUG
-                if (tinyPoolSize > 0) {
-                    assert(tinyPool[tinyPoolSize - 1] != ptr); 
-                     //   "System::malloc heap corruption detected: "
-                     //   "the last two pointers on the freelist are identical (during tinyMalloc).");
-                }
-#           endif
+ The shared stacks are only pushed with compare-and-set and only popped
+ by exchanging the whole stack with NULL (pushing the remainder back),
+ which avoids the ABA problem without tagged pointers.
 
-            // NULL out the entry to help detect corruption
-            tinyPool[tinyPoolSize] = NULL;
-        }
+ Slabs are never returned to the operating system.  Larger requests
+ go directly to ::malloc.
+ */
+class BufferPool {
+public:
 
-        return ptr;
-    }
+    enum {
+        /** Largest request served from the size classes */
+        maxPooledSize   = 4096,
 
-    /** Returns true if this is a pointer into the tiny heap. */
-    bool inTinyHeap(UserPtr ptr) {
-        return 
-            (ptr >= tinyHeap) && 
-            (ptr < (uint8*)tinyHeap + maxTinyBuffers * tinyBufferSize);
-    }
+        numClasses      = BufferPoolThreadCache::numClasses,
 
-    void tinyFree(UserPtr ptr) {
-        assert(ptr);
-        assert(tinyPoolSize < maxTinyBuffers);
- //           "Tried to free a tiny pool buffer when the tiny pool freelist is full.");
+        /** Bytes in front of each pooled block.  The size is stored in the
+            last sizeof(size_t) bytes, just as for heap blocks; the padding keeps 
+            pooled blocks 16-byte aligned. */
+        headerSize      = 16,
 
-#       ifdef G3D_DEBUG
-            if (tinyPoolSize > 0) {
-                UserPtr prevOnHeap = tinyPool[tinyPoolSize - 1];
-                assert(prevOnHeap != ptr); 
-//                    "System::malloc heap corruption detected: "
-//                    "the last two pointers on the freelist are identical (during tinyFree).");
-            }
-#       endif
+        /** Approximate size of the chunks that new blocks are carved from.
+            Small slabs keep the blocks that a thread recycles close together. */
+        slabSize        = 16 * 1024
+    };
 
-        assert(tinyPool[tinyPoolSize] == NULL);
+private:
 
-        // Put the pointer back into the free list
-        tinyPool[tinyPoolSize] = ptr;
-        ++tinyPoolSize;
+    /** Pointer given to the program. The capacity of the block is stored right in front of the pointer as a size_t.*/
+    typedef void* UserPtr;
 
-    }
+    /** Actual block allocated on the heap */
+    typedef void* RealPtr;
 
-    void flushPool(MemBlock* pool, int& poolSize) {
-        for (int i = 0; i < poolSize; ++i) {
-            bytesAllocated -= USERSIZE_TO_REALSIZE(pool[i].bytes);
-            ::free(USERPTR_TO_REALPTR(pool[i].ptr));
-            pool[i].ptr = NULL;
-            pool[i].bytes = 0;
-        }
-        poolSize = 0;
-    }
+    /** Lock-free stack of batches of free blocks of one size class.
+        Padded to a cache line to avoid false sharing between classes. */
+    class SharedStack {
+    public:
+        void* volatile  head;
+        AtomicInt32     numBlocks;
+        AtomicInt32     numSlabs;
+        uint8           pad[64 - sizeof(void*) - 2 * sizeof(AtomicInt32)];
+    };
 
+    SharedStack             m_shared[numClasses];
 
-    /** Allocate out of a specific pool.  Return NULL if no suitable 
-        memory was found. */
-    UserPtr malloc(MemBlock* pool, int& poolSize, size_t bytes) {
+    /** Capacity of the blocks in each class */
+    size_t                  m_classSize[numClasses];
 
-        // OPT: find the smallest block that satisfies the request.
+    /** Number of blocks moved between a thread and the shared stack at once */
+    int                     m_batchSize[numClasses];
 
-        // See if there's something we can use in the buffer pool.
-        // Search backwards since usually we'll re-use the last one.
-        for (int i = (int)poolSize - 1; i >= 0; --i) {
-            if (pool[i].bytes >= bytes) {
-                // We found a suitable entry in the pool.
+    /** Number of blocks in each slab (at least one batch) */
+    int                     m_slabBlocks[numClasses];
 
-                // No need to offset the pointer; it is already offset
-                UserPtr ptr = pool[i].ptr;
+    /** Protects m_registry and m_retired.  Only taken when threads start and
+        exit and when reporting statistics. */
+    Spinlock                m_registryLock;
 
-                // Remove this element from the pool, replacing it with
-                // the one from the end (same as Array::fastRemove)
-                --poolSize;
-                pool[i] = pool[poolSize];
+    /** All live thread caches, for statistics */
+    BufferPoolThreadCache*  m_registry;
 
-                return ptr;
-            }
-        }
+    /** Counters of threads that have exited */
+    BufferPoolCounters      m_retired;
 
-        return NULL;
+    /** Free blocks are linked through their first word */
+    static inline void*& nextBlock(void* block) {
+        return ((void**)block)[0];
     }
 
-public:
-
-    /** Count of memory allocations that have occurred. */
-    int totalMallocs;
-    int mallocsFromTinyPool;
-    int mallocsFromSmallPool;
-    int mallocsFromMedPool;
-
-    /** Amount of memory currently allocated (according to the application). 
-        This does not count the memory still remaining in the buffer pool,
-        but does count extra memory required for rounding off to the size
-        of a buffer.
-        Primarily useful for detecting leaks.*/
-    // TODO: make me an atomic int!
-    volatile size_t bytesAllocated;
-
-    BufferPool() {
-        totalMallocs         = 0;
-
-        mallocsFromTinyPool  = 0;
-        mallocsFromSmallPool = 0;
-        mallocsFromMedPool   = 0;
-
-        bytesAllocated       = 0;
-
-        tinyPoolSize         = 0;
-        tinyHeap             = NULL;
-
-        smallPoolSize        = 0;
-
-        medPoolSize          = 0;
-
-
-        // Initialize the tiny heap as a bunch of pointers into one
-        // pre-allocated buffer.
-        tinyHeap = ::malloc(maxTinyBuffers * tinyBufferSize);
-        for (int i = 0; i < maxTinyBuffers; ++i) {
-            tinyPool[i] = (uint8*)tinyHeap + (tinyBufferSize * i);
-        }
-        tinyPoolSize = maxTinyBuffers;
-
-#if 0        ///---------------------------------- old mutex
-#       ifdef G3D_WIN32
-            InitializeCriticalSection(&mutex);
-#       else
-            pthread_mutex_init(&mutex, NULL);
-#       endif
-#endif        ///---------------------------------- old mutex
+    /** The first block of a batch on a shared stack links to the next batch through its second word */
+    static inline void*& nextBatch(void* block) {
+        return ((void**)block)[1];
     }
 
-
-    ~BufferPool() {
-        ::free(tinyHeap);
-        flushPool(smallPool, smallPoolSize);
-        flushPool(medPool, medPoolSize);
-#if 0 //-------------------------------- old mutex
-#       ifdef G3D_WIN32
-            DeleteCriticalSection(&mutex);
-#       else
-            // No destruction on pthreads
-#       endif
-#endif //--------------------------------old mutex
+    /** The size of a batch is stored in the second word of its second block,
+        since the first block already holds both links. */
+    static inline int batchCount(void* batch) {
+        void* second = nextBlock(batch);
+        return (second == NULL) ? 1 : (int)(intptr_t)nextBatch(second);
     }
 
-    
-    UserPtr realloc(UserPtr ptr, size_t bytes) {
-        if (ptr == NULL) {
-            return malloc(bytes);
-        }
-
-        if (inTinyHeap(ptr)) {
-            if (bytes <= tinyBufferSize) {
-                // The old pointer actually had enough space.
-                return ptr;
-            } else {
-                // Free the old pointer and malloc
-                
-                UserPtr newPtr = malloc(bytes);
-                System::memcpy(newPtr, ptr, tinyBufferSize);
-                tinyFree(ptr);
-                return newPtr;
-
-            }
+    /** O(1) map from a request size (1 to maxPooledSize bytes) to its size class */
+    static inline int sizeClass(size_t bytes) {
+        if (bytes <= 128) {
+            return (int(bytes) + 15) / 16 - 1;
         } else {
-            // In one of our heaps.
-
-            // See how big the block really was
-            size_t userSize = USERSIZE_FROM_USERPTR(ptr);
-            if (bytes <= userSize) {
-                // The old block was big enough.
-                return ptr;
-            }
-
-            // Need to reallocate and move
-            UserPtr newPtr = malloc(bytes);
-            System::memcpy(newPtr, ptr, userSize);
-            free(ptr);
-            return newPtr;
+            const int log = highestBit(uint32(bytes - 1));
+            return 8 + (log - 7) * 4 + int(((bytes - 1) >> (log - 2)) & 3);
         }
     }
 
+    inline BufferPoolThreadCache* threadCache() {
+        BufferPoolThreadCache* cache = currentThreadCache;
+        if (cache == NULL) {
+            cache = createThreadCache();
+        }
+        return cache;
+    }
 
-    UserPtr malloc(size_t bytes) {
-        lock();
-        ++totalMallocs;
+    BufferPoolThreadCache* createThreadCache() {
+        BufferPoolThreadCache* cache = (BufferPoolThreadCache*)::calloc(1, sizeof(BufferPoolThreadCache));
+        alwaysAssertM(cache != NULL, "Out of memory while creating the System::malloc thread cache");
 
-        if (bytes <= tinyBufferSize) {
+        m_registryLock.lock();
+        cache->next = m_registry;
+        m_registry = cache;
+        m_registryLock.unlock();
 
-            UserPtr ptr = tinyMalloc(bytes);
+        currentThreadCache = cache;
+        return cache;
+    }
 
-            if (ptr) {
-                ++mallocsFromTinyPool;
-                unlock();
-                return ptr;
-            }
+    /** Pushes the chain of batches first...last onto the shared stack */
+    void pushBatches(int c, void* first, void* last) {
+        void* volatile* head = &m_shared[c].head;
+        void* old;
+        do {
+            old = *head;
+            nextBatch(last) = old;
+        } while (atomicCompareAndSetPointer(head, old, first) != old);
+    }
 
-        } 
-        
-        // Failure to allocate a tiny buffer is allowed to flow
-        // through to a small buffer
-        if (bytes <= smallBufferSize) {
-            
-            UserPtr ptr = malloc(smallPool, smallPoolSize, bytes);
+    /** Moves the first n blocks of the thread's list for class c to the shared stack */
+    void releaseBatch(BufferPoolThreadCache* cache, int c, int n) {
+        BufferPoolCacheClass& local = cache->cls[c];
+        debugAssert(n > 0 && n <= local.count);
 
-            if (ptr) {
-                ++mallocsFromSmallPool;
-                unlock();
-                return ptr;
-            }
+        void* first = local.head;
+        void* last  = first;
+        for (int i = 1; i < n; ++i) {
+            last = nextBlock(last);
+        }
+        local.head = nextBlock(last);
+        local.count -= n;
+        nextBlock(last) = NULL;
 
-        } else if (bytes <= medBufferSize) {
-            // Note that a small allocation failure does *not* fall
-            // through into a medium allocation because that would
-            // waste the medium buffer's resources.
+        if (n > 1) {
+            nextBatch(nextBlock(first)) = (void*)(intptr_t)n;
+        }
 
-            UserPtr ptr = malloc(medPool, medPoolSize, bytes);
+        m_shared[c].numBlocks.add(n);
+        pushBatches(c, first, first);
+    }
 
-            if (ptr) {
-                ++mallocsFromMedPool;
-                unlock();
-                debugAssertM(ptr != NULL, "BufferPool::malloc returned NULL");
-                return ptr;
+    /** Called when the thread's list for class c is empty.  Returns false if out of memory. */
+    bool refill(BufferPoolThreadCache* cache, int c) {
+        BufferPoolCacheClass& local = cache->cls[c];
+        debugAssert(local.count == 0);
+
+        SharedStack& shared = m_shared[c];
+        void* batch = (shared.head == NULL) ? NULL : atomicExchangePointer(&shared.head, NULL);
+
+        if (batch != NULL) {
+            // Keep the first batch and return the rest
+            void* rest = nextBatch(batch);
+            if (rest != NULL) {
+                void* last = rest;
+                while (nextBatch(last) != NULL) {
+                    last = nextBatch(last);
+                }
+                pushBatches(c, rest, last);
             }
+
+            local.head  = batch;
+            local.count = batchCount(batch);
+            shared.numBlocks.add(-local.count);
+            ++cache->counters.refills;
+            return true;
         }
 
-        bytesAllocated += USERSIZE_TO_REALSIZE(bytes);
-        unlock();
+        // Carve a new slab
+        const size_t stride = headerSize + m_classSize[c];
+        const int n = m_slabBlocks[c];
+        uint8* slab = (uint8*)allocateFromOS(n * stride);
+        if (slab == NULL) {
+            return false;
+        }
+        shared.numSlabs.increment();
+
+        void* head = NULL;
+        for (int i = n - 1; i >= 0; --i) {
+            UserPtr ptr = slab + i * stride + headerSize;
+            USERSIZE_FROM_USERPTR(ptr) = m_classSize[c];
+            nextBlock(ptr) = head;
+            head = ptr;
+        }
 
-        // Heap allocate
+        local.head  = head;
+        local.count = n;
+        ++cache->counters.slabs;
+        return true;
+    }
 
-        // Allocate 4 extra bytes for our size header (unfortunate,
-        // since malloc already added its own header).
-        RealPtr ptr = ::malloc(USERSIZE_TO_REALSIZE(bytes));
+    /** ::malloc that invokes System::outOfMemoryCallback on failure */
+    RealPtr allocateFromOS(size_t bytes) {
+        RealPtr ptr = ::malloc(bytes);
 
         if (ptr == NULL) {
 #           ifdef G3D_WIN32
@@ -1337,35 +1295,114 @@ public:
                 alwaysAssertM(_CrtCheckMemory() == TRUE, "Heap corruption detected.");
 #           endif
 
-            // Flush memory pools to try and recover space
-            flushPool(smallPool, smallPoolSize);
-            flushPool(medPool, medPoolSize);
-            ptr = ::malloc(USERSIZE_TO_REALSIZE(bytes));
-        }
-
-        if (ptr == NULL) {
             if ((System::outOfMemoryCallback() != NULL) &&
-                (System::outOfMemoryCallback()(USERSIZE_TO_REALSIZE(bytes), true) == true)) {
+                (System::outOfMemoryCallback()(bytes, true) == true)) {
                 // Re-attempt the malloc
-                ptr = ::malloc(USERSIZE_TO_REALSIZE(bytes));
+                ptr = ::malloc(bytes);
             }
         }
 
         if (ptr == NULL) {
             if (System::outOfMemoryCallback() != NULL) {
                 // Notify the application
-                System::outOfMemoryCallback()(USERSIZE_TO_REALSIZE(bytes), false);
+                System::outOfMemoryCallback()(bytes, false);
             }
 #           ifdef G3D_DEBUG
-            debugPrintf("::malloc(%d) returned NULL\n", (int)USERSIZE_TO_REALSIZE(bytes));
+            debugPrintf("::malloc(%d) returned NULL\n", (int)bytes);
 #           endif
             debugAssertM(ptr != NULL, 
                          "::malloc returned NULL. Either the "
                          "operating system is out of memory or the "
                          "heap is corrupt.");
+        }
+
+        return ptr;
+    }
+
+    /** Sum of the counters of all threads */
+    BufferPoolCounters totalCounters() {
+        m_registryLock.lock();
+        BufferPoolCounters total = m_retired;
+        for (BufferPoolThreadCache* cache = m_registry; cache != NULL; cache = cache->next) {
+            total.add(cache->counters);
+        }
+        m_registryLock.unlock();
+        return total;
+    }
+
+public:
+
+    BufferPool() : m_registry(NULL) {
+        System::memset(m_shared, 0, sizeof(m_shared));
+        System::memset(&m_retired, 0, sizeof(m_retired));
+
+        for (int c = 0; c < numClasses; ++c) {
+            if (c < 8) {
+                m_classSize[c] = (c + 1) * 16;
+            } else {
+                const int log = 7 + (c - 8) / 4;
+                m_classSize[c] = size_t(5 + (c - 8) % 4) << (log - 2);
+            }
+            debugAssert(sizeClass(m_classSize[c]) == c);
+
+            // Move about 16 kB at a time
+            m_batchSize[c] = iClamp(int(16 * 1024 / m_classSize[c]), 8, 64);
+            m_slabBlocks[c] = iMax(int(slabSize / (headerSize + m_classSize[c])), m_batchSize[c]);
+        }
+        debugAssert(m_classSize[numClasses - 1] == maxPooledSize);
+    }
+
+    
+    UserPtr realloc(UserPtr ptr, size_t bytes) {
+        if (ptr == NULL) {
+            return malloc(bytes);
+        }
+
+        // See how big the block really was
+        size_t userSize = USERSIZE_FROM_USERPTR(ptr);
+        if (bytes <= userSize) {
+            // The old block was big enough.
+            return ptr;
+        }
+
+        // Need to reallocate and move
+        UserPtr newPtr = malloc(bytes);
+        if (newPtr != NULL) {
+            System::memcpy(newPtr, ptr, userSize);
+            free(ptr);
+        }
+        return newPtr;
+    }
+
+
+    UserPtr malloc(size_t bytes) {
+        BufferPoolThreadCache* cache = threadCache();
+        ++cache->counters.totalMallocs;
+
+        if (bytes <= maxPooledSize) {
+            const int c = sizeClass(max(bytes, size_t(1)));
+            BufferPoolCacheClass& local = cache->cls[c];
+
+            if ((local.head != NULL) || refill(cache, c)) {
+                UserPtr ptr = local.head;
+                local.head = nextBlock(ptr);
+                --local.count;
+                return ptr;
+            } else {
+                return NULL;
+            }
+        }
+
+        ++cache->counters.mallocsFromHeap;
+
+        // Heap allocate, with an extra size_t for our size header
+        // (unfortunate, since malloc already added its own header).
+        RealPtr ptr = allocateFromOS(USERSIZE_TO_REALSIZE(bytes));
+        if (ptr == NULL) {
             return NULL;
         }
 
+        cache->counters.heapBytes += USERSIZE_TO_REALSIZE(bytes);
         ((size_t*)ptr)[0] = bytes;
 
         return REALPTR_TO_USERPTR(ptr);
@@ -1380,64 +1417,113 @@ public:
 
         assert(isValidPointer(ptr));
 
-        if (inTinyHeap(ptr)) {
-            lock();
-            tinyFree(ptr);
-            unlock();
-            return;
-        }
+        BufferPoolThreadCache* cache = threadCache();
+        const size_t bytes = USERSIZE_FROM_USERPTR(ptr);
+
+        if (bytes <= maxPooledSize) {
+            const int c = sizeClass(bytes);
+            debugAssertM(m_classSize[c] == bytes, 
+                         "System::free heap corruption detected: invalid block header.");
+            BufferPoolCacheClass& local = cache->cls[c];
+            debugAssertM(local.head != ptr, 
+                         "System::free heap corruption detected: the same block was freed twice.");
 
-        size_t bytes = USERSIZE_FROM_USERPTR(ptr);
+            nextBlock(ptr) = local.head;
+            local.head = ptr;
+            ++local.count;
 
-        lock();
-        if (bytes <= smallBufferSize) {
-            if (smallPoolSize < maxSmallBuffers) {
-                smallPool[smallPoolSize] = MemBlock(ptr, bytes);
-                ++smallPoolSize;
-                unlock();
-                return;
+            if (local.count > 2 * m_batchSize[c]) {
+                releaseBatch(cache, c, m_batchSize[c]);
             }
-        } else if (bytes <= medBufferSize) {
-            if (medPoolSize < maxMedBuffers) {
-                medPool[medPoolSize] = MemBlock(ptr, bytes);
-                ++medPoolSize;
-                unlock();
-                return;
+        } else {
+            cache->counters.heapBytes -= USERSIZE_TO_REALSIZE(bytes);
+            ::free(USERPTR_TO_REALPTR(ptr));
+        }
+    }
+
+
+    /** Returns the calling thread's cached blocks to the shared pool and releases its cache. */
+    void flushThreadCache() {
+        BufferPoolThreadCache* cache = currentThreadCache;
+        if (cache == NULL) {
+            return;
+        }
+
+        for (int c = 0; c < numClasses; ++c) {
+            while (cache->cls[c].count > 0) {
+                releaseBatch(cache, c, min(cache->cls[c].count, m_batchSize[c]));
             }
         }
-        bytesAllocated -= USERSIZE_TO_REALSIZE(bytes);
-        unlock();
 
-        // Free; the buffer pools are full or this is too big to store.
-        ::free(USERPTR_TO_REALPTR(ptr));
+        m_registryLock.lock();
+        BufferPoolThreadCache** prev = &m_registry;
+        while (*prev != cache) {
+            prev = &(*prev)->next;
+        }
+        *prev = cache->next;
+        m_retired.add(cache->counters);
+        m_registryLock.unlock();
+
+        currentThreadCache = NULL;
+        ::free(cache);
+    }
+
+
+    void resetPerformanceCounters() {
+        m_registryLock.lock();
+        m_retired.resetPerformance();
+        for (BufferPoolThreadCache* cache = m_registry; cache != NULL; cache = cache->next) {
+            cache->counters.resetPerformance();
+        }
+        m_registryLock.unlock();
     }
 
-    std::string performance() const {
-        if (totalMallocs > 0) {
-            int pooled = mallocsFromTinyPool +
-                         mallocsFromSmallPool + 
-                         mallocsFromMedPool;
-
-            int total = totalMallocs;
-
-            return format("malloc performance: %5.1f%% <= %db, %5.1f%% <= %db, "
-                          "%5.1f%% <= %db, %5.1f%% > %db",
-                          100.0 * mallocsFromTinyPool  / total,
-                          BufferPool::tinyBufferSize,
-                          100.0 * mallocsFromSmallPool / total,
-                          BufferPool::smallBufferSize,
-                          100.0 * mallocsFromMedPool   / total,
-                          BufferPool::medBufferSize,
-                          100.0 * (1.0 - (double)pooled / total),
-                          BufferPool::medBufferSize);
+
+    std::string performance() {
+        const BufferPoolCounters total = totalCounters();
+
+        if (total.totalMallocs > 0) {
+            const double pooled = total.totalMallocs - total.mallocsFromHeap;
+            const double n = total.totalMallocs;
+
+            return format("malloc performance: %5.1f%% thread cache, %5.1f%% shared pool, "
+                          "%5.1f%% new slab, %5.1f%% > %db",
+                          100.0 * (pooled - total.refills - total.slabs) / n,
+                          100.0 * total.refills / n,
+                          100.0 * total.slabs / n,
+                          100.0 * total.mallocsFromHeap / n,
+                          (int)maxPooledSize);
         } else {
             return "No System::malloc calls made yet.";
         }
     }
 
-    std::string status() const {
-        return format("preallocated shared buffers: %5d/%d x %db",
-            maxTinyBuffers - tinyPoolSize, maxTinyBuffers, tinyBufferSize);
+
+    std::string status() {
+        int    numThreads = 0;
+        size_t threadBytes = 0;
+
+        m_registryLock.lock();
+        for (BufferPoolThreadCache* cache = m_registry; cache != NULL; cache = cache->next) {
+            ++numThreads;
+            for (int c = 0; c < numClasses; ++c) {
+                threadBytes += cache->cls[c].count * m_classSize[c];
+            }
+        }
+        m_registryLock.unlock();
+
+        size_t sharedBytes = 0;
+        size_t slabBytes = 0;
+        for (int c = 0; c < numClasses; ++c) {
+            sharedBytes += m_shared[c].numBlocks.value() * m_classSize[c];
+            slabBytes   += m_shared[c].numSlabs.value() * m_slabBlocks[c] * (headerSize + m_classSize[c]);
+        }
+
+        return format("pooled buffers: %d kB in slabs, %d kB free in %d thread caches, "
+                      "%d kB free in shared pool; %d kB on heap",
+                      int(slabBytes / 1024),
+                      int(threadBytes / 1024), numThreads, int(sharedBytes / 1024),
+                      int(totalCounters().heapBytes / 1024));
     }
 };
 
@@ -1446,8 +1532,21 @@ public:
 // is deallocated.
 static BufferPool* bufferpool = NULL;
 
+#ifndef NO_BUFFERPOOL
+inline void initMem() {
+    // Putting the test here ensures that the system is always
+    // initialized, even when globals are being allocated.
+    static bool initialized = false;
+    if (! initialized) {
+        bufferpool = new BufferPool();
+        initialized = true;
+    }
+}
+#endif
+
 std::string System::mallocPerformance() {    
 #ifndef NO_BUFFERPOOL
+    initMem();
     return bufferpool->performance();
 #else
     return "NO_BUFFERPOOL";
@@ -1456,6 +1555,7 @@ std::string System::mallocPerformance() {
 
 std::string System::mallocStatus() {    
 #ifndef NO_BUFFERPOOL
+    initMem();
     return bufferpool->status();
 #else
     return "NO_BUFFERPOOL";
@@ -1465,28 +1565,32 @@ std::string System::mallocStatus() {
 
 void System::resetMallocPerformanceCounters() {
 #ifndef NO_BUFFERPOOL
-    bufferpool->totalMallocs         = 0;
-    bufferpool->mallocsFromMedPool   = 0;
-    bufferpool->mallocsFromSmallPool = 0;
-    bufferpool->mallocsFromTinyPool  = 0;
+    initMem();
+    bufferpool->resetPerformanceCounters();
 #endif
 }
 
 
+/** Counted outside of the BufferPool so that NO_BUFFERPOOL builds and
+    resetMallocPerformanceCounters() do not affect it */
+static G3D_THREAD_LOCAL int64 threadMallocCount = 0;
+
+int64 System::mallocCount() {
+    return threadMallocCount;
+}
+
+
+void System::mallocFlushThreadCache() {
 #ifndef NO_BUFFERPOOL
-inline void initMem() {
-    // Putting the test here ensures that the system is always
-    // initialized, even when globals are being allocated.
-    static bool initialized = false;
-    if (! initialized) {
-        bufferpool = new BufferPool();
-        initialized = true;
+    if (bufferpool != NULL) {
+        bufferpool->flushThreadCache();
     }
-}
 #endif
+}
 
 
 void* System::malloc(size_t bytes) {
+    ++threadMallocCount;
 #ifndef NO_BUFFERPOOL
     initMem();
     return bufferpool->malloc(bytes);
@@ -1694,6 +1798,9 @@ void System::describeSystem(
         var(t, "hasSSE", System::hasSSE());
         var(t, "hasSSE2", System::hasSSE2());
         var(t, "hasSSE3", System::hasSSE3());
+        var(t, "hasSSSE3", System::hasSSSE3());
+        var(t, "hasSSE42", System::hasSSE42());
+        var(t, "hasPCLMUL", System::hasPCLMUL());
         var(t, "has3DNow", System::has3DNow());
         var(t, "hasRDTSC", System::hasRDTSC());
         var(t, "numCores", System::numCores());
@@ -0,0 +1,278 @@
+/**
+ \file ThreadPool.cpp
+
+ \created 2026-10-17
+ \edited  2026-10-17
+ */
+
+#include "G3D/ThreadPool.h"
+#include "G3D/GThread.h"
+#include "G3D/System.h"
+#include "G3D/debugAssert.h"
+#include "G3D/ZoneProfiler.h"
+#include "G3D/format.h"
+
+#ifndef G3D_WIN32
+#   include <pthread.h>
+#endif
+
+namespace G3D {
+
+/** True on a thread that is currently executing a tile, used to
+    serialize nested loops instead of deadlocking on the pool. */
+static G3D_THREAD_LOCAL bool insideParallelFor = false;
+
+namespace _internal {
+
+/** Counting semaphore used to park idle workers. */
+class ThreadPoolSemaphore {
+private:
+#   ifdef G3D_WIN32
+    HANDLE              m_handle;
+#   else
+    pthread_mutex_t     m_mutex;
+    pthread_cond_t      m_cond;
+    int                 m_count;
+#   endif
+
+public:
+
+    ThreadPoolSemaphore() {
+#       ifdef G3D_WIN32
+            m_handle = ::CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+            debugAssert(m_handle);
+#       else
+            m_count = 0;
+            pthread_mutex_init(&m_mutex, NULL);
+            pthread_cond_init(&m_cond, NULL);
+#       endif
+    }
+
+    ~ThreadPoolSemaphore() {
+#       ifdef G3D_WIN32
+            ::CloseHandle(m_handle);
+#       else
+            pthread_cond_destroy(&m_cond);
+            pthread_mutex_destroy(&m_mutex);
+#       endif
+    }
+
+    void signal(int n) {
+        if (n <= 0) {
+            return;
+        }
+#       ifdef G3D_WIN32
+            ::ReleaseSemaphore(m_handle, n, NULL);
+#       else
+            pthread_mutex_lock(&m_mutex);
+            m_count += n;
+            if (n == 1) {
+                pthread_cond_signal(&m_cond);
+            } else {
+                pthread_cond_broadcast(&m_cond);
+            }
+            pthread_mutex_unlock(&m_mutex);
+#       endif
+    }
+
+    void wait() {
+#       ifdef G3D_WIN32
+            ::WaitForSingleObject(m_handle, INFINITE);
+#       else
+            pthread_mutex_lock(&m_mutex);
+            while (m_count == 0) {
+                pthread_cond_wait(&m_cond, &m_mutex);
+            }
+            --m_count;
+            pthread_mutex_unlock(&m_mutex);
+#       endif
+    }
+};
+
+
+class ThreadPoolWorker : public GThread {
+private:
+    ThreadPool*     m_pool;
+    int             m_index;
+
+public:
+
+    ThreadPoolWorker(ThreadPool* pool, int index) : GThread("ThreadPool worker"), m_pool(pool), m_index(index) {}
+
+protected:
+
+    virtual void threadMain() {
+        ZoneProfiler::setThreadName(format("ThreadPool worker %d", m_index));
+        insideParallelFor = true;
+        while (true) {
+            m_pool->m_wake->wait();
+            // Threads 1..n-1 are workers; the submitting thread is always 0
+            const int threadID = m_pool->m_nextThreadID.add(1);
+            debugAssert(threadID < m_pool->m_numParticipants);
+            m_pool->participate(threadID);
+            m_pool->m_done->signal(1);
+        }
+    }
+};
+
+} // namespace _internal
+
+
+ThreadPool::ThreadPool() :
+    m_wake(new _internal::ThreadPoolSemaphore()),
+    m_done(new _internal::ThreadPoolSemaphore()),
+    m_numParticipants(0),
+    m_nextThreadID(0),
+    m_body(NULL),
+    m_tilesPerRow(0) {
+
+    const int n = iMax(1, System::numCores());
+    m_queue = new TileQueue[n];
+
+    for (int i = 0; i < n - 1; ++i) {
+        // Workers are never deleted; they block on m_wake when there
+        // is no loop executing.
+        _internal::ThreadPoolWorker* w = new _internal::ThreadPoolWorker(this, i + 1);
+        m_worker.append(w);
+        w->start(USE_NEW_THREAD);
+    }
+}
+
+
+ThreadPool& ThreadPool::instance() {
+    // Intentionally leaked so that parked workers never observe a
+    // destroyed pool during static destruction.
+    static ThreadPool* pool = new ThreadPool();
+    return *pool;
+}
+
+
+int ThreadPool::numThreads() {
+    return instance().m_worker.size() + 1;
+}
+
+
+bool ThreadPool::takeTile(int threadID, int& tile) {
+    TileQueue& mine = m_queue[threadID];
+
+    mine.lock.lock();
+    if (mine.begin < mine.end) {
+        tile = mine.begin;
+        ++mine.begin;
+        mine.lock.unlock();
+        return true;
+    }
+    mine.lock.unlock();
+
+    // Steal half of the remaining tiles from the first thread that has
+    // any, visiting the others in round-robin order.
+    for (int i = 1; i < m_numParticipants; ++i) {
+        TileQueue& victim = m_queue[(threadID + i) % m_numParticipants];
+
+        victim.lock.lock();
+        const int remaining = victim.end - victim.begin;
+        if (remaining > 0) {
+            const int first = victim.end - (remaining + 1) / 2;
+            const int last  = victim.end;
+            victim.end = first;
+            victim.lock.unlock();
+
+            tile = first;
+            if (last - first > 1) {
+                mine.lock.lock();
+                mine.begin = first + 1;
+                mine.end   = last;
+                mine.lock.unlock();
+            }
+            return true;
+        }
+        victim.lock.unlock();
+    }
+
+    return false;
+}
+
+
+void ThreadPool::runTile(int tile, int threadID) {
+    const int tx = tile % m_tilesPerRow;
+    const int ty = tile / m_tilesPerRow;
+
+    const Vector2int32 tileStart(m_start.x + tx * m_grainSize.x, m_start.y + ty * m_grainSize.y);
+    const Vector2int32 tileUpTo(iMin(tileStart.x + m_grainSize.x, m_upTo.x),
+                                iMin(tileStart.y + m_grainSize.y, m_upTo.y));
+
+    m_body->run(tileStart, tileUpTo, threadID);
+}
+
+
+G3D_DEFINE_PROFILE_ZONE(parallelForZone, "ThreadPool::parallelFor");
+
+void ThreadPool::participate(int threadID) {
+    G3D_PROFILE_ZONE_ID(parallelForZone);
+    int tile = 0;
+    while (takeTile(threadID, tile)) {
+        runTile(tile, threadID);
+    }
+}
+
+
+void ThreadPool::run
+(Body&               body,
+ const Vector2int32& start,
+ const Vector2int32& upTo,
+ const Vector2int32& grainSize,
+ int                 maxThreads) {
+
+    if ((upTo.x <= start.x) || (upTo.y <= start.y)) {
+        return;
+    }
+
+    const Vector2int32 grain(iClamp(grainSize.x, 1, upTo.x - start.x),
+                             iClamp(grainSize.y, 1, upTo.y - start.y));
+    const int tilesPerRow = (upTo.x - start.x + grain.x - 1) / grain.x;
+    const int numRows     = (upTo.y - start.y + grain.y - 1) / grain.y;
+    const int numTiles    = tilesPerRow * numRows;
+
+    if (maxThreads == NUM_CORES) {
+        maxThreads = m_worker.size() + 1;
+    }
+    const int numParticipants = iMin(iMin(maxThreads, m_worker.size() + 1), numTiles);
+
+    if (insideParallelFor || (numParticipants <= 1)) {
+        // Run serially on this thread
+        body.run(start, upTo, 0);
+        return;
+    }
+
+    GMutexLock lock(&m_submitLock);
+
+    m_body            = &body;
+    m_start           = start;
+    m_upTo            = upTo;
+    m_grainSize       = grain;
+    m_tilesPerRow     = tilesPerRow;
+    m_numParticipants = numParticipants;
+    m_nextThreadID    = 1;
+
+    // Give each thread a contiguous band of tiles for coherence
+    for (int t = 0; t < numParticipants; ++t) {
+        m_queue[t].begin = (int)((int64)numTiles * t / numParticipants);
+        m_queue[t].end   = (int)((int64)numTiles * (t + 1) / numParticipants);
+    }
+
+    m_wake->signal(numParticipants - 1);
+
+    insideParallelFor = true;
+    participate(0);
+    insideParallelFor = false;
+
+    // The body is owned by the caller, so wait until every worker
+    // has finished its last tile.
+    for (int t = 1; t < numParticipants; ++t) {
+        m_done->wait();
+    }
+
+    m_body = NULL;
+}
+
+} // namespace G3D
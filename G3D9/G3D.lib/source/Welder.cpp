@@ -4,191 +4,459 @@
  \author Morgan McGuire, Kyle Whitson, Corey Taylor
 
  \created 2008-07-30
- \edited  2011-07-04
+ \edited  2026-10-17
  */
 
 #include "G3D/platform.h"
 #include "G3D/Vector2.h"
 #include "G3D/Vector3.h"
-#include "G3D/Sphere.h"
-#include "G3D/PointHashGrid.h"
+#include "G3D/Vector3int32.h"
+#include "G3D/AABox.h"
 #include "G3D/Welder.h"
-#include "G3D/Stopwatch.h" // for profiling
-#include "G3D/AreaMemoryManager.h"
+#include "G3D/ThreadPool.h"
+#include "G3D/System.h"
 #include "G3D/Any.h"
 #include "G3D/stringutils.h"
 #include "G3D/BinaryInput.h"
 #include "G3D/BinaryOutput.h"
 
-namespace G3D { namespace _internal{
+namespace G3D { namespace _internal {
 
 // Uncomment to print information that can help with performance
 // profiling.
-#define VERBOSE
+//#define VERBOSE
 
-/** Used by WeldHelper2::smoothNormals. */
-class VN {
+/** The cells of a PointHashGrid with the given cell width that a sphere
+    query visits, in the order that it visits them.  Used to reproduce the
+    order in which PointHashGrid::SphereIterator returns points. */
+class WeldQueryOrder {
 public:
-    Vector3         vertex;
-    Vector3         normal;
+    float           invCellWidth;
+    Vector3int32    lo;
+    Vector3int32    hi;
+
+    WeldQueryOrder(float cellWidth) : invCellWidth(1.0f / cellWidth) {}
+
+    inline void getCellCoord(const Point3& p, Vector3int32& c) const {
+        for (int a = 0; a < 3; ++a) {
+            c[a] = iFloor(p[a] * invCellWidth);
+        }
+    }
+
+    /** Begins a query for the sphere at \a center with \a radius */
+    inline void set(const Point3& center, float radius) {
+        const Vector3 extent(radius, radius, radius);
+        getCellCoord(center - extent, lo);
+        getCellCoord(center + extent, hi);
+    }
 
-    VN() {}
-    VN(const Vector3& v, const Vector3& n) : vertex(v), normal(n) {}
+    /** Returns the position of \a p's cell in the visiting order, or -1
+        if the query does not visit that cell */
+    inline int64 rank(const Point3& p) const {
+        Vector3int32 c;
+        getCellCoord(p, c);
+        if ((c.x < lo.x) || (c.y < lo.y) || (c.z < lo.z) ||
+            (c.x > hi.x) || (c.y > hi.y) || (c.z > hi.z)) {
+            return -1;
+        }
+        // x varies fastest
+        return (int64(c.z - lo.z) * (hi.y - lo.y + 1) + (c.y - lo.y)) * int64(hi.x - lo.x + 1) + (c.x - lo.x);
+    }
 };
 
-/** Used by WeldHelper::getIndex to maintain a list of vertices by location. */
-class VNTi {
+
+/** A point found by a neighbor query, ordered as PointHashGrid would
+    visit it */
+class WeldMatch {
 public:
-    Vector3         vertex;
-    Vector3         normal;
-    Vector2         texCoord;
+    int64           rank;
     int             index;
 
-    VNTi() : index(0) {}
+    WeldMatch() {}
+    WeldMatch(int64 r, int i) : rank(r), index(i) {}
 
-    VNTi(const Vector3& v, const Vector3& n, const Vector2& t, int i) : 
-        vertex(v), normal(n), texCoord(t), index(i) {}
+    inline bool operator<(const WeldMatch& other) const {
+        return (rank < other.rank) || ((rank == other.rank) && (index < other.index));
+    }
 };
 
 
-}} // G3D
+/** Points bucketed into a uniform grid of cubic cells for neighbor
+    queries.  The cells are found by radix-sorting the packed cell
+    coordinates of all points, so building is linear time and no memory is
+    allocated per point.  Within a cell, points appear in increasing
+    index order. */
+class WeldGrid {
+public:
 
-template <> struct HashTrait <G3D::_internal::VN> {
-    static size_t hashCode(const G3D::_internal::VN& k) { return static_cast<size_t>(k.vertex.hashCode()); }
-};
-template <> struct HashTrait <G3D::_internal::VNTi> {
-    static size_t hashCode(const G3D::_internal::VNTi& k) { return static_cast<size_t>(k.vertex.hashCode()); }
-};
+    /** A contiguous run of sortedIndex for one occupied cell */
+    class Cell {
+    public:
+        uint64          key;
+        int             begin;
+        int             end;
+    };
 
+private:
 
-template<> struct EqualsTrait <G3D::_internal::VN> {
-    static bool equals(const G3D::_internal::VN& a, const G3D::_internal::VN& b) { return a.vertex == b.vertex; }
-};
-template<> struct EqualsTrait <G3D::_internal::VNTi> {
-    static bool equals(const G3D::_internal::VNTi& a, const G3D::_internal::VNTi& b) { return a.vertex == b.vertex; }
-};
+    float               m_invCellWidth;
 
-template<> struct PositionTrait<G3D::_internal::VN> {
-    static void getPosition(const G3D::_internal::VN& v, G3D::Vector3& p) { p = v.vertex; }
-};
-template<> struct PositionTrait<G3D::_internal::VNTi> {
-    static void getPosition(const G3D::_internal::VNTi& v, G3D::Vector3& p) { p = v.vertex; }
-};
+    /** Cell coordinate of the low corner of the bounds */
+    Vector3int32        m_lo;
 
-namespace G3D { namespace _internal {
+    /** Number of cells along each axis */
+    Vector3int32        m_extent;
 
-class WeldHelper {
-private:
-    /** Used by getIndex and updateTriLists. Deallocating this is slow. */
-    PointHashGrid<VNTi>     weldGrid;
+    /** Bit positions of the y and z cell coordinates in a key */
+    int                 m_shiftY;
+    int                 m_shiftZ;
 
-    Array<Vector3>*         outputVertexArray;
-    Array<Vector3>*         outputNormalArray;
-    Array<Vector2>*         outputTexCoordArray;
+    /** Open-addressing hash table of occupied cells, indexed by key */
+    Array<Cell>         m_table;
+    uint64              m_tableMask;
 
-    float                   vertexWeldRadius;
-    /** Squared radius allowed for welding similar normals. */
-    float                   normalWeldRadius2;
-    float                   texCoordWeldRadius2;
+    static inline uint64 hash(uint64 key) {
+        return (key * 0x9E3779B97F4A7C15ULL) >> 20;
+    }
 
-    float                   normalSmoothingAngle;
+    /** Sorts (key, index) pairs by key with a stable least-significant-digit
+        radix sort over the low \a numBits bits */
+    static void radixSort(Array<uint64>& key, Array<int>& index, int numBits) {
+        const int DIGIT_BITS = 11;
+        const int NUM_BUCKETS = 1 << DIGIT_BITS;
+        const int n = key.size();
+
+        Array<uint64> key2;
+        Array<int>    index2;
+        key2.resize(n);
+        index2.resize(n);
+        Array<int>    count;
+        count.resize(NUM_BUCKETS);
+
+        for (int shift = 0; shift < numBits; shift += DIGIT_BITS) {
+            System::memset(count.getCArray(), 0, sizeof(int) * NUM_BUCKETS);
+            for (int i = 0; i < n; ++i) {
+                ++count[int(key[i] >> shift) & (NUM_BUCKETS - 1)];
+            }
 
-    /**
-     Returns the index of the vertex in 
-     outputVertexArray/outputNormalArray/outputTexCoordArray
-     that is within the global tolerances of v,n,t. If there 
-     is no such vertex, adds it to the arrays and returns that index.
+            // Skip digits that are the same for every key
+            if (count[int(key[0] >> shift) & (NUM_BUCKETS - 1)] == n) {
+                continue;
+            }
 
-     Called from updateTriLists().
-     */
-    int getIndex(const Vector3& v, const Vector3& n, const Vector2& t) {
-        PointHashGrid<VNTi>::SphereIterator it = 
-                weldGrid.beginSphereIntersection(Sphere(v, vertexWeldRadius));
-
-        if (n.isZero()) {
-            // Don't bother trying to match the surface normal, since this vertex has no surface normal.
-            while (it.isValid()) {
-                if ((t - it->texCoord).squaredLength() <= texCoordWeldRadius2) {
-                    // This is the vertex
-                    return it->index;
-                }
-                ++it;
+            int sum = 0;
+            for (int b = 0; b < NUM_BUCKETS; ++b) {
+                const int c = count[b];
+                count[b] = sum;
+                sum += c;
             }
-        } else {
-            while (it.isValid()) {
-                if (((n - it->normal).squaredLength() <= normalWeldRadius2) &&
-                    ((t - it->texCoord).squaredLength() <= texCoordWeldRadius2)) {
-                    // This is the vertex
-                    return it->index;
-                }
-                ++it;
+
+            for (int i = 0; i < n; ++i) {
+                const int dst = count[int(key[i] >> shift) & (NUM_BUCKETS - 1)]++;
+                key2[dst]   = key[i];
+                index2[dst] = index[i];
             }
+            key.swap(key2);
+            index.swap(index2);
         }
+    }
 
-        // Note that a sliver triangle processed before its neighbors may reach here
-        // with a zero length normal.
+public:
 
-        // The vertex does not exist. Create it.
-        const int i = outputVertexArray->size();
-        outputVertexArray->append(v);
-        outputNormalArray->append(n);
-        outputTexCoordArray->append(t);
+    /** Indices of all points, sorted by cell */
+    Array<int>          sortedIndex;
 
-        // Store in the grid so that it will be remembered.
-        weldGrid.insert(VNTi(v, n, t, i));
+    inline void getCellCoord(const Point3& p, Vector3int32& c) const {
+        for (int a = 0; a < 3; ++a) {
+            c[a] = iFloor(p[a] * m_invCellWidth);
+        }
+    }
 
-        return i;
+    /** Returns NULL if no point is in cell \a c */
+    inline const Cell* find(const Vector3int32& c) const {
+        const Vector3int32 d(c.x - m_lo.x, c.y - m_lo.y, c.z - m_lo.z);
+        if ((uint32(d.x) >= uint32(m_extent.x)) || (uint32(d.y) >= uint32(m_extent.y)) || 
+            (uint32(d.z) >= uint32(m_extent.z))) {
+            return NULL;
+        }
+        const uint64 key = uint64(d.x) | (uint64(d.y) << m_shiftY) | (uint64(d.z) << m_shiftZ);
+        for (uint64 h = hash(key) & m_tableMask; true; h = (h + 1) & m_tableMask) {
+            const Cell& cell = m_table[int(h)];
+            if (cell.begin < 0) {
+                return NULL;
+            } else if (cell.key == key) {
+                return &cell;
+            }
+        }
     }
 
+    /** \param cellWidth Suggested cell width.  It is increased if
+        necessary to pack the cell coordinates into 64 bits. */
+    void build(const Array<Point3>& point, float cellWidth) {
+        const int n = point.size();
+        sortedIndex.resize(n);
+        m_table.fastClear();
+        m_extent = Vector3int32(0, 0, 0);
+        if (n == 0) {
+            return;
+        }
 
-    /**
-     Updates each indexArray to refer to vertices in the
-     outputVertexArray.
+        AABox bounds(point[0]);
+        for (int i = 1; i < n; ++i) {
+            bounds.merge(point[i]);
+        }
 
-     Called from process()
-     */
-    void updateTriLists
-    (Array<Array<int>*>&         indexArrayArray, 
-     const Array<Vector3>&       vertexArray,
-     const Array<Vector3>&       normalArray,
-     const Array<Vector2>&       texCoordArray) {
-     
-#       ifdef VERBOSE
-            debugPrintf("WeldHelper::updateTriLists\n");
-#       endif
-          
-        // Compute a hash grid so that we can find neighbors quickly.
-        // It begins empty and is extended as the tri lists are iterated
-        // through.
-        weldGrid.clear();
+        // At most 2^21 cells on each axis
+        const float maxExtent = bounds.extent().max();
+        while (maxExtent / cellWidth > float(1 << 20)) {
+            cellWidth *= 2.0f;
+        }
+        m_invCellWidth = 1.0f / cellWidth;
+
+        Vector3int32 hi;
+        getCellCoord(bounds.low(), m_lo);
+        getCellCoord(bounds.high(), hi);
+
+        int bits[3];
+        for (int a = 0; a < 3; ++a) {
+            m_extent[a] = hi[a] - m_lo[a] + 1;
+            bits[a] = 0;
+            while ((1 << bits[a]) < m_extent[a]) {
+                ++bits[a];
+            }
+        }
+        m_shiftY = bits[0];
+        m_shiftZ = bits[0] + bits[1];
+
+        Array<uint64> key;
+        key.resize(n);
+        for (int i = 0; i < n; ++i) {
+            Vector3int32 c;
+            getCellCoord(point[i], c);
+            key[i] = uint64(c.x - m_lo.x) | (uint64(c.y - m_lo.y) << m_shiftY) | (uint64(c.z - m_lo.z) << m_shiftZ);
+            sortedIndex[i] = i;
+        }
+        radixSort(key, sortedIndex, m_shiftZ + bits[2]);
 
-        // Process all triLists
-        int numTriLists = indexArrayArray.size();
-        int u = 0;
-        for (int t = 0; t < numTriLists; ++t) {
-            if (indexArrayArray[t] != NULL) {
-                Array<int>& triList = *(indexArrayArray[t]);
+        // Count the cells
+        int numCells = 1;
+        for (int i = 1; i < n; ++i) {
+            numCells += (key[i] != key[i - 1]) ? 1 : 0;
+        }
 
-                // For all vertices in this list
-                for (int v = 0; v < triList.size(); ++v) {
-                    // This vertex mapped to u in the flatVertexArray
-                    triList[v] = getIndex(vertexArray[u], normalArray[u], texCoordArray[u]);
+        int tableSize = 16;
+        while (tableSize < 2 * numCells) {
+            tableSize *= 2;
+        }
+        m_table.resize(tableSize);
+        m_tableMask = tableSize - 1;
+        for (int t = 0; t < tableSize; ++t) {
+            m_table[t].begin = -1;
+        }
 
-                    /*
-    #           ifdef G3D_DEBUG
-                {
-                    int i = triList[v];
-                    Vector3 N = normalArray[i];
-                    debugAssertM(N.length() > 0.9f, "Produced non-unit normal");
+        for (int begin = 0; begin < n; ) {
+            int end = begin + 1;
+            while ((end < n) && (key[end] == key[begin])) {
+                ++end;
+            }
+
+            uint64 h = hash(key[begin]) & m_tableMask;
+            while (m_table[int(h)].begin >= 0) {
+                h = (h + 1) & m_tableMask;
+            }
+            Cell& cell = m_table[int(h)];
+            cell.key   = key[begin];
+            cell.begin = begin;
+            cell.end   = end;
+
+            begin = end;
+        }
+    }
+
+    /** Appends every point with index less than \a upTo (and, if \a
+        filter is not NULL, filter[index] >= 0) that is within the sphere
+        and that \a order visits.  This grid may have a different cell
+        width than \a order. */
+    void findInSphere
+    (const Array<Point3>&   point,
+     const Point3&          center,
+     float                  radius,
+     float                  radius2,
+     const WeldQueryOrder&  order,
+     int                    upTo,
+     const int*             filter,
+     Array<WeldMatch>&      match) const {
+
+        // Enlarge the search slightly so that rounding in the distance test
+        // cannot admit a point from a cell outside of the box
+        const float margin = radius * (1.0f / 1024.0f) + max(abs(center.x), abs(center.y), abs(center.z)) * (1.0f / (1 << 20));
+        const Vector3 extent(radius + margin, radius + margin, radius + margin);
+        Vector3int32 lo, hi;
+        getCellCoord(center - extent, lo);
+        getCellCoord(center + extent, hi);
+
+        Vector3int32 c;
+        for (c.z = lo.z; c.z <= hi.z; ++c.z) {
+            for (c.y = lo.y; c.y <= hi.y; ++c.y) {
+                for (c.x = lo.x; c.x <= hi.x; ++c.x) {
+                    const Cell* cell = find(c);
+                    if (cell == NULL) {
+                        continue;
+                    }
+                    for (int i = cell->begin; i < cell->end; ++i) {
+                        const int w = sortedIndex[i];
+                        if (w >= upTo) {
+                            // Indices increase within a cell
+                            break;
+                        }
+                        if (((filter == NULL) || (filter[w] >= 0)) &&
+                            ((center - point[w]).squaredMagnitude() <= radius2)) {
+                            const int64 r = order.rank(point[w]);
+                            if (r >= 0) {
+                                match.append(WeldMatch(r, w));
+                            }
+                        }
+                    }
                 }
-    #           endif
-                */
-                    ++u;
+            }
+        }
+    }
+};
+
+
+/** Computes the face normal of each triangle and stores it at its three vertices */
+class WeldFaceNormalBody : public ThreadPool::Body {
+public:
+    const Array<Vector3>&   vertexArray;
+    Array<Vector3>&         faceNormalArray;
+
+    WeldFaceNormalBody(const Array<Vector3>& v, Array<Vector3>& n) : vertexArray(v), faceNormalArray(n) {}
+
+    virtual void run(const Vector2int32& start, const Vector2int32& upTo, int threadID) {
+        (void)threadID;
+        for (int t = start.x; t < upTo.x; ++t) {
+            const int v = 3 * t;
+            const Vector3& e0 = vertexArray[v + 1] - vertexArray[v];
+            const Vector3& e1 = vertexArray[v + 2] - vertexArray[v];
+
+            // Note that the length may be zero in the case of sliver polygons, e.g.,
+            // those correcting a T-junction.  Scale up by 256 to avoid underflow when
+            // multiplying very small edges
+            const Vector3& n  = (e0.cross(e1 * 256.0f)).directionOrZero();
+            faceNormalArray[v] = faceNormalArray[v + 1] = faceNormalArray[v + 2] = n;
+        }
+    }
+};
+
+
+/** Averages each normal with the normals of nearby vertices that are within the cutoff angle */
+class WeldSmoothBody : public ThreadPool::Body {
+public:
+    const WeldGrid&         grid;
+    const Array<Point3>&    vertexArray;
+    const Array<Vector3>&   normalArray;
+    Array<Vector3>&         smoothNormalArray;
+    float                   vertexWeldRadius;
+    float                   cosThresholdAngle;
+
+    WeldSmoothBody
+    (const WeldGrid&        g,
+     const Array<Point3>&   v,
+     const Array<Vector3>&  n,
+     Array<Vector3>&        s,
+     float                  r,
+     float                  c) :
+        grid(g), vertexArray(v), normalArray(n), smoothNormalArray(s), vertexWeldRadius(r), cosThresholdAngle(c) {}
+
+    virtual void run(const Vector2int32& start, const Vector2int32& upTo, int threadID) {
+        (void)threadID;
+        const bool exact = (vertexWeldRadius == 0);
+        const float radius2 = square(vertexWeldRadius);
+
+        // PointHashGrid uses cells as wide as the weld radius.  With a zero
+        // radius, only vertices with identical positions are averaged.
+        WeldQueryOrder order(exact ? 1.0f : vertexWeldRadius);
+        Array<WeldMatch> match;
+        
+        for (int v = start.x; v < upTo.x; ++v) {
+            const Point3& center = vertexArray[v];
+            match.fastClear();
+
+            if (exact) {
+                Vector3int32 c;
+                grid.getCellCoord(center, c);
+                const WeldGrid::Cell* cell = grid.find(c);
+                for (int i = cell->begin; i < cell->end; ++i) {
+                    const int w = grid.sortedIndex[i];
+                    if (memcmp(&vertexArray[w], &center, sizeof(Point3)) == 0) {
+                        match.append(WeldMatch(0, w));
+                    }
+                }
+            } else {
+                order.set(center, vertexWeldRadius);
+                grid.findInSphere(vertexArray, center, vertexWeldRadius, radius2, order, vertexArray.size(), NULL, match);
+                // Cells are usually visited in the same order, so this is
+                // nearly sorted already
+                insertionSort(match);
+            }
+            
+            // Compute the sum of all nearby normals within the cutoff angle.
+            Vector3 sum;
+            const Vector3& original = normalArray[v];
+            for (int m = 0; m < match.size(); ++m) {
+                const Vector3& N = normalArray[match[m].index];
+                const float cosAngle = N.dot(original);
+                    
+                if (cosAngle > cosThresholdAngle) {
+                    // This normal is close enough to consider.  Avoid underflow by scaling up
+                    sum += (N * 256.0f);
                 }
             }
+                
+            const Vector3& average = sum.directionOrZero();
+                
+            const bool indeterminate = average.isZero();
+            // Never "smooth" a normal so far that it points backwards
+            const bool backFacing    = original.dot(average) < 0;
+                
+            if (indeterminate || backFacing) {
+                // Revert to the face normal
+                smoothNormalArray[v] = original;
+            } else {
+                // Average available normals
+                smoothNormalArray[v] = average;
+            }
+        }
+    }
+
+    static void insertionSort(Array<WeldMatch>& match) {
+        for (int i = 1; i < match.size(); ++i) {
+            const WeldMatch m = match[i];
+            int j = i - 1;
+            while ((j >= 0) && (m < match[j])) {
+                match[j + 1] = match[j];
+                --j;
+            }
+            match[j + 1] = m;
         }
     }
 
+};
+
+
+/** Implements Welder::weld.  Produces the same result as bucketing the
+    vertices in PointHashGrid, but finds neighbors in a radix-sorted grid
+    and averages normals in parallel. */
+class WeldHelper {
+private:
+
+    float                   vertexWeldRadius;
+    /** Squared radius allowed for welding similar normals. */
+    float                   normalWeldRadius2;
+    float                   texCoordWeldRadius2;
+
+    float                   normalSmoothingAngle;
+
     /** Expands the indexed triangle lists into a triangle list.
 
         Called from process() */
@@ -216,39 +484,94 @@ private:
         }
     }
 
-    /** For every three vertices, compute the face normal and store it three times.
-        Sliver triangles have a zero surface normal, which we will later take to
-        match *any* surface normal. */
-    void computeFaceNormals
-    (const Array<Vector3>&  vertexArray, 
-     Array<Vector3>&        faceNormalArray) {
+
+    /**
+     Updates each indexArray to refer to vertices in the output arrays.
+     Each vertex is merged with the first earlier output vertex that a
+     PointHashGrid with cells max(vertexWeldRadius, 0.1) wide would
+     visit and that is within the tolerances, or else becomes a new
+     output vertex.
+
+     Called from process()
+     */
+    void updateTriLists
+    (Array<Array<int>*>&         indexArrayArray, 
+     const WeldGrid&             grid,
+     const Array<Vector3>&       vertexArray,
+     const Array<Vector3>&       normalArray,
+     const Array<Vector2>&       texCoordArray,
+     Array<Vector3>&             outputVertexArray,
+     Array<Vector3>&             outputNormalArray,
+     Array<Vector2>&             outputTexCoordArray) {
+     
 #       ifdef VERBOSE
-            debugPrintf("WeldHelper::computeFaceNormals\n");
+            debugPrintf("WeldHelper::updateTriLists\n");
 #       endif
 
-        debugAssertM(vertexArray.size() % 3 == 0, "Input is not a triangle soup");
-        debugAssertM(faceNormalArray.size() == 0, "Output must start empty.");
+        // Index in the output of each unrolled vertex that created an
+        // output vertex, and -1 for the others
+        Array<int> outputIndex;
+        outputIndex.resize(vertexArray.size());
 
-        for (int v = 0; v < vertexArray.size(); v += 3) {
-            const Vector3& e0 = vertexArray[v + 1] - vertexArray[v];
-            const Vector3& e1 = vertexArray[v + 2] - vertexArray[v];
+        WeldQueryOrder order(max(vertexWeldRadius, 0.1f));
+        const float radius2 = square(vertexWeldRadius);
+        Array<WeldMatch> match;
 
-            // Note that the length may be zero in the case of sliver polygons, e.g.,
-            // those correcting a T-junction.  Scale up by 256 to avoid underflow when
-            // multiplying very small edges
-            const Vector3& n  = (e0.cross(e1 * 256.0f)).directionOrZero();
+        int u = 0;
+        for (int t = 0; t < indexArrayArray.size(); ++t) {
+            if (indexArrayArray[t] == NULL) {
+                continue;
+            }
+            Array<int>& triList = *(indexArrayArray[t]);
+
+            for (int v = 0; v < triList.size(); ++v, ++u) {
+                const Vector3& p = vertexArray[u];
+                const Vector3& n = normalArray[u];
+                const Vector2& tc = texCoordArray[u];
+
+                match.fastClear();
+                order.set(p, vertexWeldRadius);
+                grid.findInSphere(vertexArray, p, vertexWeldRadius, radius2, order, u, outputIndex.getCArray(), match);
+
+                // Find the first candidate in PointHashGrid order that matches
+                const WeldMatch* best = NULL;
+                for (int m = 0; m < match.size(); ++m) {
+                    const int w = match[m].index;
+                    // Don't bother trying to match the surface normal if this vertex has no surface normal.
+                    if ((n.isZero() || ((n - normalArray[w]).squaredLength() <= normalWeldRadius2)) &&
+                        ((tc - texCoordArray[w]).squaredLength() <= texCoordWeldRadius2) &&
+                        ((best == NULL) || (match[m] < *best))) {
+                        best = &match[m];
+                    }
+                }
 
-            // Append the normal once per vertex.
-            faceNormalArray.append(n, n, n);
+                if (best != NULL) {
+                    triList[v] = outputIndex[best->index];
+                    outputIndex[u] = -1;
+                } else {
+                    // Note that a sliver triangle processed before its neighbors may reach here
+                    // with a zero length normal.
+
+                    // The vertex does not exist. Create it.
+                    const int i = outputVertexArray.size();
+                    outputVertexArray.append(p);
+                    outputNormalArray.append(n);
+                    outputTexCoordArray.append(tc);
+                    outputIndex[u] = i;
+                    triList[v] = i;
+                }
+            }
         }
     }
 
+
     /**
      Computes @a smoothNormalArray, whose elements are those of normalArray averaged
      with neighbors within the angular cutoff.
      */
     void smoothNormals
-    (const Array<Point3>& vertexArray, 
+    (const WeldGrid&       grid,
+     const Array<Point3>&  vertexArray, 
      const Array<Vector3>& normalArray, 
      Array<Vector3>&       smoothNormalArray) {
         if (normalSmoothingAngle <= 0) {
@@ -260,114 +583,11 @@ private:
             debugPrintf("WeldHelper::smoothNormals\n");
 #       endif
 
-        // Create an area memory manager for fast deallocation
-        MemoryManager::Ref mm = AreaMemoryManager::create(iRound(sizeof(VN) * normalArray.size() * 1.5));
-
-        const float cosThresholdAngle = (float)cos(normalSmoothingAngle);
-
         debugAssert(vertexArray.size() == normalArray.size());
         smoothNormalArray.resize(normalArray.size());
 
-        if (vertexWeldRadius == 0) {
-            // Look for vertices with the exactly identical normal only
-#           ifdef VERBOSE
-                debugPrintf("Taking fast path\n");
-#           endif
-
-            // Maximum expected faces that meet at a vertex
-            static const int k = 8;
-
-            // Maps vertices to the indices of normals at that vertex
-            Table<Point3, SmallArray<Vector3, k> > normalTable;
-            for (int v = 0; v < vertexArray.size(); ++v) {
-                bool ignore = false;
-                SmallArray<Vector3, k>& list = normalTable.getCreate(vertexArray[v], ignore);
-                list.append(normalArray[v]);
-            }
-
-            for (int v = 0; v < vertexArray.size(); ++v) {
-                Vector3 sum;
-
-                const Vector3& original = normalArray[v];
-
-                const SmallArray<Vector3, k>& list = normalTable[vertexArray[v]];
-
-                for (int i = 0; i < list.size(); ++i) {
-                    const Vector3& N = list[i];
-                    const float cosAngle = N.dot(original);
-
-                    if (cosAngle > cosThresholdAngle) {
-                        // This normal is close enough to consider.  Avoid underflow by scaling up
-                        sum += (N * 256.0f);
-                    }
-                }
-
-                const Vector3& average = sum.directionOrZero();
-
-                const bool indeterminate = average.isZero();
-                // Never "smooth" a normal so far that it points backwards
-                const bool backFacing    = original.dot(average) < 0;
-                
-                if (indeterminate || backFacing) {
-                    // Revert to the face normal
-                    smoothNormalArray[v] = original;
-                } else {
-                    // Average available normals
-                    smoothNormalArray[v] = average;
-                }
-            }
-
-        } else {
-            // Non-zero vertex normal welding
-#           ifdef VERBOSE
-                debugPrintf("Taking slower weld path because vertexWeldRadius = %f\n",
-                            vertexWeldRadius);
-#           endif
-
-            // Compute a hash grid so that we can find neighbors quickly.
-            alwaysAssertM(vertexWeldRadius > 0, "Cannot smooth with zero vertex weld radius");
-            PointHashGrid<VN> grid(vertexWeldRadius, mm);
-            for (int v = 0; v < normalArray.size(); ++v) {
-                grid.insert(VN(vertexArray[v], normalArray[v]));
-            }
-            
-            // OPT: this step could be done on multiple threads
-            for (int v = 0; v < normalArray.size(); ++v) {            
-                // Compute the sum of all nearby normals within the cutoff angle.
-                // Search within the vertexWeldRadius, since those are the vertices
-                // that will collapse to the same point.
-                PointHashGrid<VN>::SphereIterator it = 
-                    grid.beginSphereIntersection(Sphere(vertexArray[v], vertexWeldRadius));
-                
-                Vector3 sum;
-                
-                const Vector3& original = normalArray[v];
-                while (it.isValid()) {
-                    const Vector3& N = it->normal;
-                    const float cosAngle = N.dot(original);
-                    
-                    if (cosAngle > cosThresholdAngle) {
-                        // This normal is close enough to consider.  Avoid underflow by scaling up
-                        sum += (N * 256.0f);
-                    }
-                    ++it;
-                }
-                
-                const Vector3& average = sum.directionOrZero();
-                
-                const bool indeterminate = average.isZero();
-                // Never "smooth" a normal so far that it points backwards
-                const bool backFacing    = original.dot(average) < 0;
-                
-                if (indeterminate || backFacing) {
-                    // Revert to the face normal
-                    smoothNormalArray[v] = original;
-                } else {
-                    // Average available normals
-                    smoothNormalArray[v] = average;
-                }
-            }
-        }
+        WeldSmoothBody body(grid, vertexArray, normalArray, smoothNormalArray, vertexWeldRadius, (float)cos(normalSmoothingAngle));
+        ThreadPool::parallelFor(body, 0, vertexArray.size(), 1024);
     }
 
 public:
@@ -409,15 +629,12 @@ public:
                 "Input arrays are not parallel.");
         }
 
-        // Create an area memory manager for fast deallocation
         Array<Vector3> unrolledVertexArray;
         Array<Vector3> unrolledFaceNormalArray;
         Array<Vector3> unrolledSmoothNormalArray;
         Array<Vector2> unrolledTexCoordArray;
 
         unrolledVertexArray.reserve(vertexArray.size());
-        unrolledFaceNormalArray.reserve(vertexArray.size());
-        unrolledSmoothNormalArray.reserve(vertexArray.size());
         unrolledTexCoordArray.reserve(vertexArray.size());
 
         if (! hasTexCoords) {
@@ -429,26 +646,32 @@ public:
         unroll(indexArrayArray, vertexArray, texCoordArray, 
             unrolledVertexArray, unrolledTexCoordArray);
 
-        // Put the output back into the input slots. 
-        outputVertexArray   = &vertexArray;
-        outputNormalArray   = &normalArray;
-        outputTexCoordArray = &texCoordArray;
-        outputVertexArray->fastClear();
-        outputNormalArray->fastClear();
-        outputTexCoordArray->fastClear();
+        vertexArray.fastClear();
+        normalArray.fastClear();
+        texCoordArray.fastClear();
 
         // For every three vertices, generate their face normal and store it at 
         // each vertex. The output array has the same length as the input.
-        computeFaceNormals(unrolledVertexArray, unrolledFaceNormalArray);
+        debugAssertM(unrolledVertexArray.size() % 3 == 0, "Input is not a triangle soup");
+        unrolledFaceNormalArray.resize(unrolledVertexArray.size());
+        {
+            WeldFaceNormalBody body(unrolledVertexArray, unrolledFaceNormalArray);
+            ThreadPool::parallelFor(body, 0, unrolledVertexArray.size() / 3, 1024);
+        }
+
+        // Cells twice the radius are usually visited in groups of eight
+        WeldGrid grid;
+        grid.build(unrolledVertexArray, (vertexWeldRadius > 0) ? 2.0f * vertexWeldRadius : 0.1f);
 
         // Compute smooth normals at vertices.
         if (unrolledFaceNormalArray.size() > 0) {
-            smoothNormals(unrolledVertexArray, unrolledFaceNormalArray, unrolledSmoothNormalArray);
+            smoothNormals(grid, unrolledVertexArray, unrolledFaceNormalArray, unrolledSmoothNormalArray);
             unrolledFaceNormalArray.clear();
         }
 
         // Regenerate the triangle lists
-        updateTriLists(indexArrayArray, unrolledVertexArray, unrolledSmoothNormalArray, unrolledTexCoordArray);
+        updateTriLists(indexArrayArray, grid, unrolledVertexArray, unrolledSmoothNormalArray, unrolledTexCoordArray,
+                       vertexArray, normalArray, texCoordArray);
 
         if (! hasTexCoords) {
             // Throw away the generated texCoords
@@ -456,12 +679,9 @@ public:
         }
     }
 
-    WeldHelper(float vertRadius) :
-        weldGrid(max(vertRadius, 0.1f), AreaMemoryManager::create()),
-        vertexWeldRadius(vertRadius) {
-    }
-
+    WeldHelper(float vertRadius) : vertexWeldRadius(vertRadius) {}
 };
+
 } // Internal
 
 
@@ -0,0 +1,452 @@
+/**
+  \file ZoneProfiler.cpp
+
+  \created 2026-10-17
+  \edited  2026-10-17
+
+  Copyright 2000-2012, Morgan McGuire.
+  All rights reserved.
+ */
+#include "G3D/ZoneProfiler.h"
+#include "G3D/AtomicInt32.h"
+#include "G3D/GMutex.h"
+#include "G3D/System.h"
+#include "G3D/Table.h"
+#include "G3D/fileutils.h"
+#include "G3D/format.h"
+#include "G3D/debugAssert.h"
+
+#ifdef _MSC_VER
+#   include <intrin.h>
+#   pragma intrinsic(_ReadWriteBarrier)
+#elif defined(__i386__) || defined(__x86_64__)
+#   include <x86intrin.h>
+#endif
+
+namespace G3D {
+
+/** Keeps the compiler from moving stores across this point.  On x86 the
+    hardware never reorders stores with other stores, so this is enough
+    to publish an event before the index that covers it. */
+static inline void compilerBarrier() {
+#   ifdef _MSC_VER
+        _ReadWriteBarrier();
+#   else
+        asm volatile ("" ::: "memory");
+#   endif
+}
+
+/** The time stamp counter, read directly.  System::getCycleCount uses
+    QueryPerformanceCounter on 64-bit Windows, which costs several times
+    as much as rdtsc. */
+static inline uint64 timestamp() {
+#   if (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))) || defined(__i386__) || defined(__x86_64__)
+        return __rdtsc();
+#   else
+        return System::getCycleCount();
+#   endif
+}
+
+namespace _internal {
+
+class ZoneEvent {
+public:
+    uint64          cycles;
+    uint32          zone;
+    uint32          isEnd;
+};
+
+
+/** A zone that has begun but not ended during replay */
+class ZoneOpen {
+public:
+    /** Index of the call tree node */
+    int             node;
+    uint32          zone;
+    uint64          cycles;
+
+    /** Total time of the children that have ended */
+    RealTime        childTime;
+};
+
+
+class ZoneInfo {
+public:
+    std::string     name;
+    std::string     category;
+};
+
+
+/** Ring buffer of events for one thread.  Only the owning thread writes
+    events and head; readers tolerate events being overwritten while they
+    copy.  When the thread exits, the buffer is passed on to the next
+    thread that records a zone. */
+class ZoneThreadBuffer {
+public:
+    /** EVENTS_PER_THREAD events */
+    ZoneEvent*      event;
+
+    /** Number of events ever recorded, modulo 2^32 */
+    AtomicInt32     head;
+
+    /** Events before this index were discarded by clear().
+        Protected by the registry lock. */
+    uint32          start;
+
+    int             threadID;
+
+    /** Protected by the registry lock */
+    std::string     name;
+
+    ZoneThreadBuffer(int id) : head(0), start(0), threadID(id), name(format("Thread %d", id)) {
+        // calloc so that pages are only committed as they are touched
+        event = (ZoneEvent*)::calloc(ZoneProfiler::EVENTS_PER_THREAD, sizeof(ZoneEvent));
+        debugAssert(event);
+    }
+};
+
+
+class ZoneRegistry {
+public:
+    GMutex                      lock;
+    Array<ZoneInfo>             zone;
+    Array<ZoneThreadBuffer*>    thread;
+
+    /** Elements of thread whose threads have exited.  Their events
+        remain visible until another thread takes the buffer over. */
+    Array<ZoneThreadBuffer*>    released;
+
+    /** ID for the next thread that records a zone */
+    int                         nextThreadID;
+
+    /** Cycle count and time when the registry was created, for converting
+        cycle counts to seconds */
+    uint64                      baseCycles;
+    RealTime                    baseTime;
+
+    ZoneRegistry() : nextThreadID(0), baseCycles(timestamp()), baseTime(System::time()) {}
+};
+
+} // namespace _internal
+
+using _internal::ZoneEvent;
+using _internal::ZoneThreadBuffer;
+using _internal::ZoneRegistry;
+
+volatile bool ZoneProfiler::s_enabled = false;
+
+static G3D_THREAD_LOCAL ZoneThreadBuffer* currentZoneBuffer = NULL;
+
+
+static ZoneRegistry& registry() {
+    // Intentionally leaked so that threads still running during static
+    // destruction can record safely.
+    static ZoneRegistry* r = new ZoneRegistry();
+    return *r;
+}
+
+
+/** Returns the buffer for the current thread, taking over the buffer of
+    an exited thread or creating one if necessary */
+static ZoneThreadBuffer* threadBuffer() {
+    if (currentZoneBuffer == NULL) {
+        ZoneRegistry& r = registry();
+        GMutexLock lock(&r.lock);
+        const int id = r.nextThreadID;
+        ++r.nextThreadID;
+        if (r.released.size() > 0) {
+            ZoneThreadBuffer* b = r.released.pop();
+            // Discard the previous thread's events
+            b->start    = (uint32)b->head.value();
+            b->threadID = id;
+            b->name     = format("Thread %d", id);
+            currentZoneBuffer = b;
+        } else {
+            currentZoneBuffer = new ZoneThreadBuffer(id);
+            r.thread.append(currentZoneBuffer);
+        }
+    }
+    return currentZoneBuffer;
+}
+
+
+void ZoneProfiler::record(int zone, uint32 isEnd) {
+    ZoneThreadBuffer* b = currentZoneBuffer;
+    if (b == NULL) {
+        b = threadBuffer();
+    }
+
+    const uint32 h = (uint32)b->head.value();
+    ZoneEvent& e = b->event[h & (ZoneProfiler::EVENTS_PER_THREAD - 1)];
+    e.cycles = timestamp();
+    e.zone   = zone;
+    e.isEnd  = isEnd;
+
+    compilerBarrier();
+    b->head = (int32)(h + 1);
+}
+
+
+int ZoneProfiler::registerZone(const std::string& name, const std::string& category) {
+    ZoneRegistry& r = registry();
+    GMutexLock lock(&r.lock);
+
+    for (int i = 0; i < r.zone.size(); ++i) {
+        if ((r.zone[i].name == name) && (r.zone[i].category == category)) {
+            return i;
+        }
+    }
+
+    _internal::ZoneInfo& info = r.zone.next();
+    info.name     = name;
+    info.category = category;
+    return r.zone.size() - 1;
+}
+
+
+std::string ZoneProfiler::zoneName(int zone) {
+    ZoneRegistry& r = registry();
+    GMutexLock lock(&r.lock);
+    debugAssert(zone >= 0 && zone < r.zone.size());
+    return r.zone[zone].name;
+}
+
+
+void ZoneProfiler::releaseThread() {
+    ZoneThreadBuffer* b = currentZoneBuffer;
+    if (b != NULL) {
+        ZoneRegistry& r = registry();
+        GMutexLock lock(&r.lock);
+        r.released.append(b);
+        currentZoneBuffer = NULL;
+    }
+}
+
+
+void ZoneProfiler::setThreadName(const std::string& name) {
+    ZoneThreadBuffer* b = threadBuffer();
+    ZoneRegistry& r = registry();
+    GMutexLock lock(&r.lock);
+    b->name = name;
+}
+
+
+bool ZoneProfiler::enabled() {
+    return s_enabled;
+}
+
+
+void ZoneProfiler::setEnabled(bool e) {
+    // Establish the time base before the first event
+    registry();
+    s_enabled = e;
+}
+
+
+void ZoneProfiler::clear() {
+    ZoneRegistry& r = registry();
+    GMutexLock lock(&r.lock);
+    for (int t = 0; t < r.thread.size(); ++t) {
+        r.thread[t]->start = (uint32)r.thread[t]->head.value();
+    }
+}
+
+
+/** Copies the valid events of one thread, oldest first.  The caller must
+    hold the registry lock. */
+static void snapshot(const ZoneThreadBuffer* b, Array<ZoneEvent>& out) {
+    out.fastClear();
+
+    const uint32 capacity = ZoneProfiler::EVENTS_PER_THREAD;
+    const uint32 head = (uint32)b->head.value();
+    uint32 first = b->start;
+    if (head - first > capacity) {
+        first = head - capacity;
+    }
+
+    out.resize(head - first);
+    for (uint32 i = first; i != head; ++i) {
+        out[i - first] = b->event[i & (capacity - 1)];
+    }
+
+    // The owner may have wrapped around onto the oldest events while they
+    // were being copied
+    const uint32 newHead = (uint32)b->head.value();
+    if (newHead - first > capacity) {
+        const int overwritten = iMin(out.size(), int(newHead - first - capacity));
+        out.remove(0, overwritten);
+    }
+}
+
+
+/** Seconds per unit of timestamp() */
+static double secondsPerCycle(const ZoneRegistry& r) {
+    // Measure over at least 10 ms for accuracy
+    RealTime now = System::time();
+    while (now - r.baseTime < 0.01) {
+        System::sleep(0.002);
+        now = System::time();
+    }
+    const uint64 cycles = timestamp();
+    return (now - r.baseTime) / double(cycles - r.baseCycles);
+}
+
+
+void ZoneProfiler::getStatistics(Array<Statistics>& stats) {
+    ZoneRegistry& r = registry();
+    GMutexLock lock(&r.lock);
+    const double spc = secondsPerCycle(r);
+
+    // Nodes in order of discovery, keyed by (parent node, zone)
+    Array<Statistics>   node;
+    Table<uint64, int>  nodeIndex;
+
+    Array<_internal::ZoneOpen> stack;
+    Array<ZoneEvent>    event;
+
+    for (int t = 0; t < r.thread.size(); ++t) {
+        snapshot(r.thread[t], event);
+        stack.fastClear();
+
+        for (int i = 0; i < event.size(); ++i) {
+            const ZoneEvent& e = event[i];
+            if (! e.isEnd) {
+                const int parent = (stack.size() > 0) ? stack.last().node : -1;
+                const uint64 key = (uint64(uint32(parent + 1)) << 32) | e.zone;
+                bool created = false;
+                int& n = nodeIndex.getCreate(key, created);
+                if (created) {
+                    n = node.size();
+                    Statistics& s = node.next();
+                    s.zone      = e.zone;
+                    s.name      = r.zone[e.zone].name;
+                    s.parent    = parent;
+                    s.depth     = stack.size();
+                    s.count     = 0;
+                    s.totalTime = 0;
+                    s.selfTime  = 0;
+                }
+                _internal::ZoneOpen& o = stack.next();
+                o.node      = n;
+                o.zone      = e.zone;
+                o.cycles    = e.cycles;
+                o.childTime = 0;
+            } else if ((stack.size() > 0) && (stack.last().zone == e.zone)) {
+                const _internal::ZoneOpen o = stack.pop();
+                const RealTime dt = double(e.cycles - o.cycles) * spc;
+                Statistics& s = node[o.node];
+                ++s.count;
+                s.totalTime += dt;
+                s.selfTime  += dt - o.childTime;
+                if (stack.size() > 0) {
+                    stack.last().childTime += dt;
+                }
+            }
+            // Otherwise the matching begin was overwritten or cleared
+        }
+    }
+
+    // Emit in depth-first order
+    Array< Array<int> > children;
+    children.resize(node.size() + 1);
+    for (int n = 0; n < node.size(); ++n) {
+        children[node[n].parent + 1].append(n);
+    }
+
+    stats.fastClear();
+    Array<int> newIndex;
+    newIndex.resize(node.size());
+    Array<int> todo;
+    for (int c = children[0].size() - 1; c >= 0; --c) {
+        todo.append(children[0][c]);
+    }
+    while (todo.size() > 0) {
+        const int n = todo.pop();
+        newIndex[n] = stats.size();
+        stats.append(node[n]);
+        if (node[n].parent >= 0) {
+            stats.last().parent = newIndex[node[n].parent];
+        }
+        const Array<int>& child = children[n + 1];
+        for (int c = child.size() - 1; c >= 0; --c) {
+            todo.append(child[c]);
+        }
+    }
+}
+
+
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        const char c = s[i];
+        if ((c == '"') || (c == '\\')) {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            out += format("\\u%04x", (int)c);
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+
+std::string ZoneProfiler::chromeTrace() {
+    ZoneRegistry& r = registry();
+    GMutexLock lock(&r.lock);
+    const double usPerCycle = secondsPerCycle(r) * 1e6;
+
+    Array<std::string> name;
+    Array<std::string> category;
+    for (int z = 0; z < r.zone.size(); ++z) {
+        name.append(jsonEscape(r.zone[z].name));
+        category.append(jsonEscape(r.zone[z].category));
+    }
+
+    std::string s = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    Array<ZoneEvent> event;
+
+    for (int t = 0; t < r.thread.size(); ++t) {
+        const ZoneThreadBuffer* b = r.thread[t];
+
+        if (! first) {
+            s += ",\n";
+        }
+        first = false;
+        s += format("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    b->threadID, jsonEscape(b->name).c_str());
+
+        snapshot(b, event);
+        int depth = 0;
+        for (int i = 0; i < event.size(); ++i) {
+            const ZoneEvent& e = event[i];
+            if (e.isEnd) {
+                if (depth == 0) {
+                    // The matching begin was overwritten or cleared
+                    continue;
+                }
+                --depth;
+            } else {
+                ++depth;
+            }
+
+            // Events before the time base are clamped to it
+            const double us = (e.cycles > r.baseCycles) ? double(e.cycles - r.baseCycles) * usPerCycle : 0.0;
+            s += format(",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                        name[e.zone].c_str(), category[e.zone].c_str(), e.isEnd ? 'E' : 'B', us, b->threadID);
+        }
+    }
+
+    s += "\n]}\n";
+    return s;
+}
+
+
+void ZoneProfiler::saveChromeTrace(const std::string& filename) {
+    writeWholeFile(filename, chromeTrace());
+}
+
+} // namespace G3D
@@ -4,7 +4,7 @@
  @author Morgan McGuire, graphics3d.com
  
  @author  2002-06-06
- @edited  2010-02-05
+ @edited  2026-10-17
  */
 
 #include <cstring>
@@ -131,33 +131,21 @@ std::string readWholeFile(const std::string& filename) {
         // In zipfile
         FileSystem::markFileUsed(zipfile);
 
-        // Zipfiles require Unix-style slashes
-        std::string internalFile = FilePath::canonicalize(filename.substr(zipfile.length() + 1));
-        struct zip* z = zip_open(zipfile.c_str(), ZIP_CHECKCONS, NULL);
-        {
-            struct zip_stat info;
-            zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-            zip_stat(z, internalFile.c_str(), ZIP_FL_NOCASE, &info);
-
-            // Add NULL termination
-            char* buffer = reinterpret_cast<char*>(System::alignedMalloc(info.size + 1, 16));
-            buffer[info.size] = '\0';
-
-            struct zip_file* zf = zip_fopen( z, internalFile.c_str(), ZIP_FL_NOCASE );
-            if (zf == NULL) {
-                throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
-            } else {
-                const int64 bytesRead = zip_fread( zf, buffer, (info.size));
-                debugAssertM((int64)bytesRead == info.size,
-                             internalFile + " was corrupt because it unzipped to the wrong size.");
-                (void)bytesRead;
-                zip_fclose( zf );
-            }
-            // Copy the string
-            s = buffer;
-            System::alignedFree(buffer);
+        uint8* data = NULL;
+        int64 length = 0;
+        MemoryMappedFile::Ref mapping;
+        FileSystem::readFromZipfile(filename, zipfile, data, length, mapping);
+
+        // Copy the string, stopping at the first NULL as for files on disk
+        s.assign((const char*)data, size_t(length));
+        const size_t end = s.find('\0');
+        if (end != std::string::npos) {
+            s.resize(end);
+        }
+
+        if (mapping.isNull()) {
+            System::alignedFree(data);
         }
-        zip_close( z );
     }
 
     return s;
@@ -0,0 +1,97 @@
+/**
+ \file radixSort.cpp
+
+ \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+ \created 2026-10-17
+ \edited  2026-10-17
+
+ Copyright 2000-2012, Morgan McGuire.
+ All rights reserved.
+ */
+
+#include "G3D/radixSort.h"
+#include "G3D/FrameMemoryManager.h"
+#include "G3D/System.h"
+
+namespace G3D {
+
+/** Below this size, insertion sort beats the fixed cost of the histograms */
+static const int RADIX_SORT_MIN_SIZE = 64;
+
+static void insertionSort(SortKey* a, int n) {
+    for (int i = 1; i < n; ++i) {
+        const SortKey x = a[i];
+        int j = i - 1;
+        while ((j >= 0) && (a[j].key > x.key)) {
+            a[j + 1] = a[j];
+            --j;
+        }
+        a[j + 1] = x;
+    }
+}
+
+
+void radixSort(Array<SortKey>& array) {
+    const int n = array.size();
+    if (n < RADIX_SORT_MIN_SIZE) {
+        insertionSort(array.getCArray(), n);
+        return;
+    }
+
+    // Histogram every byte in a single pass over the keys
+    static const int NUM_DIGITS = 8;
+    uint32 count[NUM_DIGITS][256];
+    System::memset(count, 0, sizeof(count));
+
+    const SortKey* in = array.getCArray();
+    for (int i = 0; i < n; ++i) {
+        uint64 k = in[i].key;
+        for (int d = 0; d < NUM_DIGITS; ++d) {
+            ++count[d][k & 0xFF];
+            k >>= 8;
+        }
+    }
+
+    Array<SortKey> scratch;
+    scratch.clearAndSetMemoryManager(FrameMemoryManager::current());
+
+    SortKey* src = array.getCArray();
+    SortKey* dst = NULL;
+
+    for (int d = 0; d < NUM_DIGITS; ++d) {
+        const int shift = 8 * d;
+        uint32* bucket = count[d];
+
+        if (bucket[(src[0].key >> shift) & 0xFF] == (uint32)n) {
+            // Every key has the same value for this byte
+            continue;
+        }
+
+        if (dst == NULL) {
+            scratch.resize(n);
+            dst = scratch.getCArray();
+        }
+
+        // Exclusive prefix sum gives the first output position of each bucket
+        uint32 sum = 0;
+        for (int b = 0; b < 256; ++b) {
+            const uint32 c = bucket[b];
+            bucket[b] = sum;
+            sum += c;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            const SortKey& s = src[i];
+            dst[bucket[(s.key >> shift) & 0xFF]++] = s;
+        }
+
+        std::swap(src, dst);
+    }
+
+    if (src != array.getCArray()) {
+        System::memcpy(array.getCArray(), src, sizeof(SortKey) * n);
+    }
+}
+
+} // namespace G3D
@@ -3,7 +3,7 @@
 
  \author Morgan McGuire, http://graphics.cs.williams.edu
  \created 2011-07-19
- \edited  2011-08-26
+ \edited  2026-10-17
  
  Copyright 2000-2012, Morgan McGuire.
  All rights reserved.
@@ -21,6 +21,7 @@
 #include "G3D/Table.h"
 #include "G3D/constants.h"
 #include "G3D/PhysicsFrameSpline.h"
+#include "G3D/Crypto.h"
 #include "GLG3D/CPUVertexArray.h"
 #include "GLG3D/Material.h"
 #include "GLG3D/VertexRange.h"
@@ -314,7 +315,23 @@ public:
 
         } obj;
 
-        Specification() : stripMaterials(false), mergeMeshesByMaterial(false), scale(1.0f) {}
+        /** If true, load() keeps the result of loading, preprocessing,
+            and cleaning the geometry in a binary cache file beside \a
+            filename (or beside the zipfile that contains it), and
+            later loads of the same file with the same Specification
+            read that cache instead.  The cache is
+            rebuilt when the contents of \a filename change.  Files
+            that \a filename references, such as textures and MTL
+            files, are not checked.
+
+            The cache is specific to the machine's byte order and this
+            version of G3D; see G3D::SpeedLoad.
+
+            Default: false
+         */
+        bool                        useCache;
+
+        Specification() : stripMaterials(false), mergeMeshesByMaterial(false), scale(1.0f), useCache(false) {}
 
         /**
         Example:
@@ -773,6 +790,21 @@ protected:
 
     void load(const Specification& specification);
 
+    /** Returns the name of the cache file for \a specification and sets
+        \a key to the hash of everything besides the source file that
+        the cached data depends on.  Returns the empty string if \a
+        specification cannot be cached.  Called from load() */
+    static std::string cacheFilename(const Specification& specification, MD5Hash& key);
+
+    /** Replaces this model with the contents of a cache file written
+        by saveCache.  Returns false, leaving this model empty, if the
+        file is missing, was written for a different \a key, or \a
+        sourceFilename changed since. */
+    bool loadCache(const std::string& filename, const MD5Hash& key, const std::string& sourceFilename);
+
+    /** Returns false if this model cannot be cached or the file could not be written */
+    bool saveCache(const std::string& filename, const MD5Hash& key, const std::string& sourceFilename) const;
+
     ArticulatedModel() : m_nextID(1) {}
 
     Mesh* mesh(const Instruction::Identifier& part, const Instruction::Identifier& mesh);
@@ -7,7 +7,7 @@
  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
 
  \created 2002-08-07
- \edited  2012-07-08
+ \edited  2026-10-17
 
  Copyright 2000-2012, Morgan McGuire.
  All rights reserved.
@@ -33,6 +33,8 @@
 #include "GLG3D/tesselate.h"
 #include "GLG3D/GApp.h"
 #include "GLG3D/Surface.h"
+#include "GLG3D/SurfaceCuller.h"
+#include "GLG3D/OcclusionCuller.h"
 #include "GLG3D/MD2Model.h"
 #include "GLG3D/MD3Model.h"
 #include "GLG3D/OSWindow.h"
@@ -2,7 +2,7 @@
  \file   GLG3D/Material.h
  \author Morgan McGuire, http://graphics.cs.williams.edu
  \date   2008-08-10
- \edited 2012-03-16
+ \edited 2026-10-17
 */
 #ifndef GLG3D_Material_h
 #define GLG3D_Material_h
@@ -478,6 +478,11 @@ public:
         return m_bump;
     }
 
+    /** May be NULL */
+    const MapComponent<Image4>::Ref& customMap() const {
+        return m_customMap;
+    }
+
     /** \copydoc Material::Specification::setDepthWriteHintDistance */
     float depthWriteHintDistance() const {
         return m_depthWriteHintDistance;
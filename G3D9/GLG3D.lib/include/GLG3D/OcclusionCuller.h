@@ -0,0 +1,159 @@
+/**
+  \file GLG3D/OcclusionCuller.h
+
+  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+  \created 2026-10-17
+  \edited  2026-10-17
+*/
+#ifndef G3D_OcclusionCuller_h
+#define G3D_OcclusionCuller_h
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/Vector3.h"
+#include "G3D/Matrix4.h"
+#include "G3D/Rect2D.h"
+#include "GLG3D/Surface.h"
+
+namespace G3D {
+
+class GCamera;
+class Box;
+class AABox;
+
+/**
+ \brief Software occlusion culling against a low-resolution depth buffer on the CPU.
+
+ Rasterize a few large occluders, such as the walls of a BSPMap or
+ simplified building shells, and then test the bounds of many
+ Surface%s against the result to find those that are entirely hidden
+ behind them.  This requires no GPU, so it works in headless builds
+ and tests.
+
+ Occluders are rasterized at pixel centers, and each covered pixel
+ receives the farthest depth of the triangle's plane within the
+ pixel, so that it stores a distance beyond which everything near
+ the pixel is hidden.  A max-depth mip hierarchy over the buffer lets
+ a bounding box be tested against at most 2x2 texels of the level at
+ which its screen rectangle is one or two texels across.
+ Rasterization processes four pixels at a time with SSE when it is
+ available.
+
+ A bound is only reported as occluded when the pixel centers that
+ enclose its screen rectangle are all covered by occluders nearer
+ than the nearest point of the bound.  This is exact for a single
+ occluder triangle; gaps between occluders that are narrower than a
+ pixel may be missed.  Bounds that cross the near plane are never
+ occluded.  Occluders must be opaque, and should not themselves be
+ culled by the results.
+
+ \code
+ OcclusionCuller occlusion;
+ occlusion.setCamera(camera, rd->viewport());
+ occlusion.rasterizeOccluders(occluderArray);
+ Surface::cull(camera, rd->viewport(), posed3D, visible);
+ occlusion.cull(visible);
+ \endcode
+
+ <b>Not threadsafe</b>
+
+ \sa Surface::cull, SurfaceCuller
+ */
+class OcclusionCuller {
+private:
+
+    int                     m_width;
+    int                     m_height;
+
+    /** Maps world space to (x * w, y * w, w), where (x, y) are
+        pixel coordinates and w is the distance along the view axis */
+    Matrix4                 m_worldToScreen;
+
+    /** Distance to the near plane */
+    float                   m_near;
+
+    /** m_level[0] is the depth buffer and m_level[i] stores the
+        maximum of each 2x2 block of m_level[i - 1].  Each level is
+        stored in rows of at least four floats. */
+    mutable Array< Array<float> > m_level;
+
+    mutable bool            m_hierarchyDirty;
+
+    int                     m_numOccluderTriangles;
+
+    int levelWidth(int L) const {
+        return max(m_width >> L, 1);
+    }
+
+    int levelHeight(int L) const {
+        return max(m_height >> L, 1);
+    }
+
+    /** Row stride of level L, in floats */
+    int levelStride(int L) const {
+        return max(levelWidth(L), 4);
+    }
+
+    /** Rasterizes a triangle in screen space.  Each vertex is (x, y, 1 / w). */
+    void rasterizeScreenTriangle(const Vector3& v0, const Vector3& v1, const Vector3& v2);
+
+    /** Clips a world-space triangle to the near plane and rasterizes it */
+    void rasterizeTriangle(const Vector4& a, const Vector4& b, const Vector4& c);
+
+    void buildHierarchy() const;
+
+public:
+
+    /** \param width, height Resolution of the depth buffer.  Must be
+        powers of two.  The camera's viewport is stretched to fit it. */
+    OcclusionCuller(int width = 256, int height = 128);
+
+    /** Clears the depth buffer and sets the view for subsequent calls */
+    void setCamera(const GCamera& camera, const Rect2D& viewport);
+
+    int width() const {
+        return m_width;
+    }
+
+    int height() const {
+        return m_height;
+    }
+
+    /** Number of occluder triangles rasterized since setCamera() */
+    int numOccluderTriangles() const {
+        return m_numOccluderTriangles;
+    }
+
+    /** Rasterizes an indexed, world-space triangle list, e.g., from
+        BSPMap::getTriangles.  Winding is ignored. */
+    void rasterizeOccluders(const Array<Vector3>& vertex, const Array<int>& index);
+
+    /** Rasterizes \a vertex transformed by \a cframe */
+    void rasterizeOccluders(const Array<Vector3>& vertex, const Array<int>& index, const CFrame& cframe);
+
+    /** Rasterizes the triangles of \a occluderArray, obtained with Surface::getTris */
+    void rasterizeOccluders(const Array<Surface::Ref>& occluderArray);
+
+    /** Distance along the view axis beyond which everything in pixel
+        (x, y) of \a level is hidden.  Infinite where there is no
+        occluder. */
+    float depth(int x, int y, int level = 0) const;
+
+    int numLevels() const {
+        return m_level.size();
+    }
+
+    /** True if \a box is entirely hidden by the occluders */
+    bool isOccluded(const Box& box) const;
+
+    bool isOccluded(const AABox& box) const;
+
+    /** Removes the Surface%s whose world-space bounding boxes are
+        occluded from \a surfaceArray.  Does not preserve order. */
+    void cull(Array<Surface::Ref>& surfaceArray, bool previous = false) const;
+};
+
+} // namespace G3D
+
+#endif
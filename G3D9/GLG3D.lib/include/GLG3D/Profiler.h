@@ -3,7 +3,7 @@
   @author Morgan McGuire, http://graphics.cs.williams.edu
   
  @created 2009-01-01
- @edited  2009-11-05
+ @edited  2026-10-17
 
  Copyright 2000-2009, Morgan McGuire.
  All rights reserved.
@@ -32,6 +32,8 @@ namespace G3D {
     more than a few pixels of a font from "CPU" when reading them in the
     code.
 
+    For nested CPU timing on multiple threads, see G3D::ZoneProfiler.
+
     \beta
 
  */
@@ -8,7 +8,7 @@
 
   \maintainer Morgan McGuire, http://graphics.cs.williams.edu
   \created 2001-05-29
-  \edited  2012-03-20
+  \edited  2026-10-17
 
   Copyright 2000-2012, Morgan McGuire
 */
@@ -678,7 +678,8 @@ public:
                       TEX_CURRENT};
 
     /**
-     Call to begin the rendering frame.
+     Call to begin the rendering frame.  Also begins a frame of the
+     calling thread's FrameMemoryManager.
      */
     void beginFrame();
 
@@ -4,7 +4,7 @@
   \maintainer Morgan McGuire, http://graphics.cs.williams.edu
 
   \created 2008-11-12
-  \edited  2012-03-16
+  \edited  2026-10-17
  
  Copyright 2000-2012, Morgan McGuire.
  All rights reserved.
@@ -387,6 +387,9 @@ public:
     virtual void renderShadowMappedLightPass(RenderDevice* rd, const GLight& light, const ShadowMap::Ref& shadowMap) const;
     
     virtual bool depthWriteHint(float distanceToCamera) const override;
+
+    /** Identifies the Material */
+    virtual uint32 materialSortKey() const override;
        
     virtual bool renderSuperShaderPass
     (RenderDevice* rd, 
@@ -401,6 +404,14 @@ public:
      const GBuffer::Ref&          gbuffer,
      const CFrame&                previousCameraFrame) const override;
 
+    virtual void renderIntoGBufferHomogeneous
+    (RenderDevice*                rd, 
+     const Array<Surface::Ref>&   surfaceArray,
+     int                          begin,
+     int                          end,
+     const GBuffer::Ref&          gbuffer,
+     const CFrame&                previousCameraFrame) const override;
+
     virtual void renderDepthOnlyHomogeneous
     (RenderDevice*                rd, 
      const Array<Surface::Ref>&   surfaceArray) const override;
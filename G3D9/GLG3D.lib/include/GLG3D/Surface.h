@@ -4,7 +4,7 @@
   \maintainer Morgan McGuire, http://graphics.cs.williams.edu
 
   \created 2003-11-15
-  \edited  2012-01-03
+  \edited  2026-10-17
  */ 
 
 #ifndef GLG3D_Surface_h
@@ -191,6 +191,15 @@ public:
         return ! hasTransmission();
     }
 
+    /** Identifies the material or shader state used to render this
+        surface, so that sortByDerivedType() can group Surface%s that
+        share it.  Surfaces with equal keys should be cheap to render
+        consecutively; unequal surfaces may collide.  The default
+        implementation returns 0. */
+    virtual uint32 materialSortKey() const {
+        return 0;
+    }
+
     ///////////////////////////////////////////////////////////////////////
     // Aggregate methods
 
@@ -313,6 +322,27 @@ public:
      const GBuffer::Ref&          gbuffer,
      const CFrame&                previousCameraFrame) const {}//= 0;
 
+    /** 
+    \brief Render the instances of \a surfaceArray from \a begin up
+    to but not including \a end, which must all have the same
+    most-derived type as \a this.  renderIntoGBuffer calls this with
+    each type's range of its sorted array.
+
+    The default implementation copies the range into a temporary array
+    and invokes the overload above, so subclasses that only override
+    that overload still render.  Override this as well to render the
+    range in place.
+
+    \sa renderIntoGBuffer
+    */
+    virtual void renderIntoGBufferHomogeneous
+    (RenderDevice*                rd,
+     const Array<Surface::Ref>&   surfaceArray,
+     int                          begin,
+     int                          end,
+     const GBuffer::Ref&          gbuffer,
+     const CFrame&                previousCameraFrame) const;
+
     /** \brief Rendering a set of surfaces in wireframe, using the
        current blending mode.  This is primarily used for debugging.
        
@@ -347,8 +377,8 @@ public:
      Culling must be performed by the caller, since this can be used for both 2D and
      3D rendering.
 
-     Sorts and then renders front-to-back using current stencil and
-     depth operations.
+     Sorts with sortByDerivedType() and then renders each derived
+     type front-to-back using current stencil and depth operations.
 
      \param previousCameraFrame Used for rendering
      GBuffer::CS_POSITION_CHANGE frames.
@@ -362,10 +392,9 @@ public:
      const CFrame&               previousCameraFrame = CFrame());
 
     /** 
-      Divides the inModels into a front-to-back sorted array of opaque
-      models and a back-to-front sorted array of potentially
-      transparent models.  Any data originally in the output arrays is
-      cleared.
+      Sorts \a surfaces by the distance of their bounding sphere
+      centers along \a wsLookVector, nearest first.  The sort is a
+      radixSort() of the distances and is stable.
 
       \param wsLookVector Sort axis; usually the -Z axis of the camera.
      */
@@ -373,6 +402,28 @@ public:
     (Array<Surface::Ref>&       surfaces, 
      const Vector3&             wsLookVector);
 
+    /**
+      Groups \a surfaces by most-derived type with a single
+      radixSort() of 64-bit keys that pack the type, materialSortKey()
+      and the distance along \a wsLookVector, so that each group can
+      be passed to the homogeneous rendering methods.  The groups are
+      ordered by their nearest member, and the members of a group are
+      sorted front-to-back, or by material and then front-to-back if
+      \a groupByMaterial is true.
+
+      This replaces sortFrontToBack() followed by
+      categorizeByDerivedType(), which compares and copies every
+      Surface::Ref several times.
+
+      \param typeStart Receives the index of the first Surface of each
+      group, followed by surfaces.size().
+     */
+    static void sortByDerivedType
+    (Array<Surface::Ref>&       surfaces, 
+     const Vector3&             wsLookVector,
+     Array<int>&                typeStart,
+     bool                       groupByMaterial = false);
+
 
     static void sortBackToFront
     (Array<Surface::Ref>&       surfaces, 
@@ -425,7 +476,8 @@ public:
      bool                       onlyShadowCasters = false);
 
 
-    /** Computes the array of models that can be seen by \a camera*/
+    /** Computes the array of models that can be seen by \a camera.
+        For large arrays that persist across frames, SurfaceCuller is faster. */
     static void cull
     (const class GCamera&       camera, 
      const class Rect2D&        viewport, 
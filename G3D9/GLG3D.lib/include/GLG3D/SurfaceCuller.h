@@ -0,0 +1,165 @@
+/**
+  \file GLG3D/SurfaceCuller.h
+
+  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+  \created 2026-10-17
+  \edited  2026-10-17
+*/
+#ifndef G3D_SurfaceCuller_h
+#define G3D_SurfaceCuller_h
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/Plane.h"
+#include "G3D/Vector3.h"
+#include "GLG3D/Surface.h"
+
+namespace G3D {
+
+class GCamera;
+class Rect2D;
+
+/**
+ \brief Frustum culling for large arrays of Surface%s that persist across frames.
+
+ Surface::cull makes two virtual calls and transforms a bounding
+ sphere for every Surface on every call.  SurfaceCuller instead keeps
+ the world-space bounding spheres in structure-of-arrays form and
+ only recomputes them for Surface%s that changed.  The spheres are
+ ordered along a Morton curve and grouped into clusters of
+ CLUSTER_SIZE with a bounding box each.  Culling first tests the
+ cluster boxes, skipping clusters that are entirely outside a plane
+ and accepting clusters that are entirely inside all planes, and then
+ tests the remaining spheres four at a time with SSE.
+
+ A Surface is considered changed if setSurfaceArray() receives a
+ different pointer at its index than on the previous call, or if
+ setDirty() was called for it.  Surface%s are normally immutable once
+ posed, so a scene that poses static models once and reuses their
+ Surface%s only pays for the animated ones.  Surface%s with infinite
+ or non-finite bounds are never culled.
+
+ The results agree with culling each sphere by Plane::distance;
+ Surface::cull uses a slightly different formula and may differ for
+ spheres that touch a plane to within floating-point precision.
+
+ \code
+ SurfaceCuller culler;
+ ...
+ // Each frame
+ culler.setSurfaceArray(posed3D);
+ culler.cull(camera, rd->viewport(), visible);
+ \endcode
+
+ <b>Not threadsafe</b>
+
+ \sa Surface::cull
+ */
+class SurfaceCuller {
+public:
+
+    enum {CLUSTER_SIZE = 32};
+
+private:
+
+    /** Axis-aligned bounds of CLUSTER_SIZE consecutive slots */
+    class Cluster {
+    public:
+        Point3          center;
+        Vector3         extent;
+
+        /** False if any member has non-finite bounds, in which case
+            the cluster box is ignored and every member is tested */
+        bool            finite;
+    };
+
+    bool                    m_previous;
+
+    Array<Surface::Ref>     m_surfaceArray;
+
+    /** Slot of each index in m_surfaceArray */
+    Array<int>              m_slot;
+
+    /** Index into m_surfaceArray of each slot */
+    Array<int>              m_index;
+
+    /** World-space sphere of each slot, padded to a multiple of
+        CLUSTER_SIZE with spheres that are never visible.  Non-finite
+        spheres are stored with an infinite radius. */
+    Array<float>            m_x;
+    Array<float>            m_y;
+    Array<float>            m_z;
+    Array<float>            m_radius;
+
+    Array<Cluster>          m_cluster;
+
+    /** Indices whose bounds must be recomputed */
+    Array<int>              m_dirty;
+    Array<bool>             m_isDirty;
+
+    /** Sum of the extents of the finite clusters, which measures how
+        well they fit their members */
+    float                   m_totalExtent;
+
+    /** m_totalExtent after the last rebuild() */
+    float                   m_builtExtent;
+
+    bool                    m_needsRebuild;
+
+    /** Recomputes the bounds of m_surfaceArray[index] into its slot */
+    void updateBounds(int index);
+
+    /** Recomputes the order of the slots and all cluster bounds.
+        Invoked when the clusters have grown to twice their size at the
+        previous rebuild. */
+    void rebuild();
+
+    void updateCluster(int c);
+
+    /** Brings the bounds and clusters up to date */
+    void update();
+
+public:
+
+    SurfaceCuller();
+
+    /** Sets the Surface%s to be culled.  Bounds are only recomputed
+        for indices whose Surface differs from the previous call and
+        for those marked by setDirty().
+
+        \param previous Cull the "previous" bounds of each Surface;
+        see Surface.  Changing this marks every Surface as changed. */
+    void setSurfaceArray(const Array<Surface::Ref>& surfaceArray, bool previous = false);
+
+    /** Call when the pose of surfaceArray()[index] changed without
+        the Surface pointer changing */
+    void setDirty(int index);
+
+    /** Marks every Surface as changed */
+    void setAllDirty();
+
+    const Array<Surface::Ref>& surfaceArray() const {
+        return m_surfaceArray;
+    }
+
+    int size() const {
+        return m_surfaceArray.size();
+    }
+
+    /** Appends the indices into surfaceArray() of the Surface%s that
+        are not entirely behind any of \a clipPlanes.  The order is
+        unspecified. \a visibleIndex is cleared first. */
+    void cull(const Array<Plane>& clipPlanes, Array<int>& visibleIndex);
+
+    /** Sets \a visible to the Surface%s that can be seen by \a camera,
+        in unspecified order. */
+    void cull
+    (const GCamera&         camera,
+     const Rect2D&          viewport,
+     Array<Surface::Ref>&   visible);
+};
+
+} // namespace G3D
+
+#endif
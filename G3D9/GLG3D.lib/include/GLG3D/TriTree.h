@@ -4,7 +4,7 @@
   \maintainer Morgan McGuire, http://graphics.cs.williams.edu
 
   \created 2009-06-10
-  \edited  2009-06-29
+  \edited  2026-10-17
 */
 #ifndef G3D_TriTree_h
 #define G3D_TriTree_h
@@ -15,8 +15,10 @@
 #include "G3D/AABox.h"
 #include "G3D/Ray.h"
 #include "G3D/MemoryManager.h"
+#include "G3D/AreaMemoryManager.h"
 #include "G3D/Array.h"
 #include "G3D/SmallArray.h"
+#include "G3D/Table.h"
 #include "G3D/Intersect.h"
 #include "G3D/CollisionDetection.h"
 #include "GLG3D/Tri.h"
@@ -92,8 +94,9 @@ public:
            could be found. */
         int                valuesPerLeaf;
 
-        /** SAH uses an approximation to the published heuristic to
-            reduce splitting from \f$O(n^2)\f$ to
+        /** SAH uses an approximation to the published heuristic that
+            sorts the Tris into a fixed number of bins along each axis,
+            reducing splitting from \f$O(n^2)\f$ to
             \f$O(n)\f$.  When the number of Tris to be
             divided at a node falls below accurateSAHCountThreshold,
             it switches to the full heuristic for increased accuracy.
@@ -134,9 +137,23 @@ public:
         /** Max tris per node of any node */
         int largestNode;
 
+        /** Seconds spent building the tree in setContents */
+        float buildTime;
+
+        /** Number of threads that built the tree */
+        int numBuildThreads;
+
+        /** Number of subtrees that were built concurrently after the top
+            levels of the tree were split */
+        int numParallelSubtrees;
+
+        /** Bytes reserved for Nodes and their Tri lists */
+        size_t nodeBytes;
+
         Stats() : numLeaves(0), numTris(0), numNodes(0), shallowestLeaf(100000),
                   shallowestNodeOverMin(100000), averageValuesPerLeaf(0), 
-                  depth(0), largestNode(0) {}
+                  depth(0), largestNode(0), buildTime(0), numBuildThreads(0),
+                  numParallelSubtrees(0), nodeBytes(0) {}
     };
 
 private:
@@ -247,6 +264,10 @@ private:
     };
 
 
+    /** Construction state shared by all Nodes.  Collects the subtrees
+        that are built concurrently. */
+    class Builder;
+
     /** Does not have to be deleted; has no constructor. */
     struct ValueArray {
         /** Each Tri may point out of the Node, because it has been
@@ -267,12 +288,21 @@ private:
     
     class Node {
     private:
+
+        /** For intersectPacket */
+        friend class TriTree;
         
         /** Bounds on this node and all of its children */
         AABox            bounds;
 
         /** Position along the split axis */
         float            splitLocation;
+
+        /** Surface area heuristic cost of tracing this subtree, relative
+            to the cost of a ray that hits its bounds, when it was built.
+            Uses the bounds of the unclipped Tris so that refit() can
+            compare against it to measure degradation. */
+        float            buildCost;
         
         /** Stores the child pointer in the high bits and the split
             axis in the low 2 bits. 
@@ -311,9 +341,13 @@ private:
             splitAxis, and then recurse into children.  Assumes bounds
             has been set.
             
-            Called from the constructor. */
+            Called from the constructor. 
+
+            \param builder If not NULL, children at or below
+            Builder::parallelDepth are handed to the builder instead of
+            being constructed immediately. */
         void split(Array<Poly>& original, const Settings& settings, 
-                   const MemoryManager::Ref& mm);
+                   const MemoryManager::Ref& mm, Builder* builder, int depth);
 
         /** Called from the constructor to choose a splitting plane
             and axis. Assumes that this->bounds is already set. */
@@ -323,16 +357,14 @@ private:
         float chooseMedianAreaSplitLocation(Array<Poly>& original, 
                                             Vector3::Axis axis);
 
-        struct FloatHashTrait {
-            static size_t hashCode(float k) { return *reinterpret_cast<size_t*>(&k); }
-        };
-
         float chooseSAHSplitLocation(Array<Poly>& source, Vector3::Axis axis, const Settings& settings);
 
         float chooseSAHSplitLocationAccurate(Array<Poly>& source, 
                                          Vector3::Axis axis, const Settings& settings);
 
-        float chooseSAHSplitLocationFast(Array<Poly>& source, Vector3::Axis axis, const Settings& settings);
+        /** Bins the polys by centroid and evaluates the SAH at each
+            bin boundary.  Large arrays are binned on multiple threads. */
+        float chooseSAHSplitLocationBinned(const Array<Poly>& source, Vector3::Axis axis);
 
         /** The SAHCost of tracing against just this array. */
         static float SAHCost(int size, float area, float containingArea);
@@ -349,7 +381,8 @@ private:
         */
         static float SAHCost(Vector3::Axis axis, float offset,
                              const Array<Poly>& original, float containingArea, 
-                             const Settings& settings);
+                             const Settings& settings,
+                             Array<Poly>& lowArray, Array<Poly>& highArray, Array<Poly>& spanArray);
 
         /** Called from intersect to determine which child the ray hits first.
 
@@ -404,7 +437,7 @@ private:
     public:
 
         Node(Array<Poly>& originals, const Settings& settings, 
-             const MemoryManager::Ref& mm);
+             const MemoryManager::Ref& mm, Builder* builder = NULL, int depth = 0);
 
         /** Call in lieu of delete to remove children.  Caller must
             free the Node itself.*/
@@ -425,6 +458,28 @@ private:
 
         void getStats(Stats& s, int level, int valuesPerNode) const;
 
+        /** Surface area heuristic cost of this node given the areas
+            and costs of its children */
+        float cost(float area, float valueArea, const float childArea[2], const float childCost[2]) const;
+
+        /** Computes the bounds of this subtree bottom-up from the
+            unclipped Tris at their current vertex positions and returns
+            the resulting cost.
+
+            If \a setBuildCost is true, stores the cost in buildCost for
+            each node.  Otherwise, stores the bounds and appends the
+            topmost nodes whose cost exceeds maxDegradation * buildCost
+            to \a degraded. */
+        float refit(const CPUVertexArray& vertexArray, bool setBuildCost, float maxDegradation, 
+                    Array<Node*>& degraded, AABox& newBounds);
+
+        /** Sets buildCost for this subtree and returns it */
+        float computeBuildCost(const CPUVertexArray& vertexArray);
+
+        /** Appends every Tri in this subtree to \a triArray, with
+            duplicates, and every Node to \a nodeArray */
+        void getContents(Array<const Tri*>& triArray, Array<Node*>& nodeArray);
+
         bool __fastcall intersectRay
         (const TriTree&  triTree,
          const Ray&      ray,
@@ -434,9 +489,43 @@ private:
          bool             twoSided) const;
     };
 
+    /** Four coherent rays traced together by intersectRays() */
+    class RayPacket;
+
+    /** Called from intersectRays() */
+    void intersectPacket(RayPacket& packet, bool exitOnAnyHit, bool twoSided) const;
+
+    /** Builds m_root from \a source, splitting the top levels on this
+        thread and the subtrees below them concurrently. Called from
+        setContents. */
+    void buildTree(Array<Poly>& source, const Settings& settings);
+
+    /** Rebuilds the subtree at \a node from its unclipped Tris.  Called from refit(). */
+    void rebuild(Node* node);
+
     /** Memory manager used to allocate Nodes and Tri arrays. */
     MemoryManager::Ref   m_memoryManager;
 
+    /** Memory for the Nodes and Tri arrays of the subtrees that were
+        built concurrently, one per subtree. */
+    Array<AreaMemoryManager::Ref> m_subtreeMemoryManager;
+
+    /** Memory for subtrees that were rebuilt by refit(), keyed by
+        the root of the subtree.  Released when that subtree or one of
+        its ancestors is rebuilt. */
+    Table<Node*, AreaMemoryManager::Ref> m_rebuiltMemoryManager;
+
+    float                m_buildTime;
+    int                  m_numBuildThreads;
+
+    /** From the last setContents() call, used to rebuild subtrees */
+    Settings             m_settings;
+
+    /** True once refit() has moved the Tris.  The children of a node
+        may then overlap, so traversal may not use the splitting plane
+        to order or cull them. */
+    bool                 m_refit;
+
     /** Allocated with m_memoryManager */
     Node*                m_root;
 
@@ -483,6 +572,31 @@ public:
                      ImageStorage newStorage = IMAGE_STORAGE_CURRENT, 
                      const Settings& settings = Settings());
 
+    /** \brief Updates the tree for moved vertices, e.g., for an
+        animated character, without rebuilding it.
+
+        The Tris keep their place in the tree and the bounds of every
+        node are recomputed bottom-up from the new positions.  Subtrees
+        whose surface area heuristic cost has grown by more than a
+        factor of \a maxDegradation since they were built are then
+        rebuilt; if that is the root, the whole tree is rebuilt.
+        Tracing a refit tree is slower than tracing a freshly built one
+        because the children of a node may overlap.
+
+        Tris with zero area when their subtree is rebuilt are dropped
+        from the tree until the next setContents().
+
+        \param vertexArray Must have the same vertices, in the same order,
+        as the one that the tree was built from.
+
+        \return The number of subtrees that were rebuilt */
+    int refit(const CPUVertexArray& vertexArray, float maxDegradation = 1.5f);
+
+    /** Uses Surface::getTris to extract the vertices from each surface
+        and then refits.  The surfaces must be the ones passed to
+        setContents(), in the same order, e.g., in a new pose. */
+    int refit(const Array<SurfaceRef>& surfaceArray, float maxDegradation = 1.5f);
+
     int size() const {
         return m_triArray.size();
     }
@@ -512,6 +626,43 @@ public:
      bool exitOnAnyHit = false,
      bool twoSided = false) const;
 
+    /** \brief Intersects many rays at once.  Equivalent to calling
+        intersectRay() on each element of \a rayArray, but much faster
+        for coherent rays such as primary and shadow rays.
+
+        Consecutive groups of four rays are traced together as an SSE
+        packet that shares a traversal stack and tests each triangle
+        against all four rays at once.  Order \a rayArray so that
+        neighboring rays are similar, e.g., in 2x2 pixel blocks.
+        Packets whose directions do not all lie in the same octant, and
+        any remaining rays, are traced individually.  Within a packet,
+        subtrees that only one ray still reaches are also traced
+        individually.
+
+        \param results Resized to <code>rayArray.size()</code> if it is
+        not already that size.  Elements retain their input fields,
+        such as Tri::Intersector::alphaTest.  As with intersectRay(),
+        an element whose ray hits nothing within its distance is not
+        modified.
+
+        \param distance On input, the maximum distance for each ray.
+        On output, the distance to the hit for each ray that hit.
+        Must be the same size as \a rayArray.
+     */
+    void intersectRays
+    (const Array<Ray>&          rayArray,
+     Array<Tri::Intersector>&   results,
+     Array<float>&              distance,
+     bool                       exitOnAnyHit = false,
+     bool                       twoSided = false) const;
+
+    /** Uses an unbounded distance for every ray. */
+    void intersectRays
+    (const Array<Ray>&          rayArray,
+     Array<Tri::Intersector>&   results,
+     bool                       exitOnAnyHit = false,
+     bool                       twoSided = false) const;
+
     /** Returns all triangles that intersect or are contained within
         the sphere (technically, this is a ball intersection). */
     void intersectSphere
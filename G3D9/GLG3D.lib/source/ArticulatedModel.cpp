@@ -3,7 +3,7 @@
 
  \author Morgan McGuire, http://graphics.cs.williams.edu
  \created 2011-07-19
- \edited  2011-11-22
+ \edited  2026-10-17
  
  Copyright 2000-2012, Morgan McGuire.
  All rights reserved.
@@ -15,6 +15,7 @@
 #include "GLG3D/ArticulatedModel.h"
 #include "G3D/Ray.h"
 #include "G3D/FileSystem.h"
+#include "G3D/Log.h"
 
 namespace G3D {
 
@@ -146,6 +147,15 @@ ArticulatedModel::Part* ArticulatedModel::part(const std::string& partName) {
 
 void ArticulatedModel::load(const Specification& specification) {
     Stopwatch timer;
+
+    MD5Hash cacheKey;
+    const std::string& cacheFile = specification.useCache ? cacheFilename(specification, cacheKey) : "";
+    if (! cacheFile.empty()) {
+        if (loadCache(cacheFile, cacheKey, specification.filename)) {
+            timer.after("load cache");
+            return;
+        }
+    }
     
     const std::string& ext = toLower(FilePath::ext(specification.filename));
 
@@ -185,6 +195,13 @@ void ArticulatedModel::load(const Specification& specification) {
     cleanGeometry(specification.cleanGeometrySettings);
     maybeCompactArrays();
     timer.after("cleanGeometry");
+
+    if (! cacheFile.empty()) {
+        if (! saveCache(cacheFile, cacheKey, specification.filename)) {
+            logPrintf("ArticulatedModel: could not write cache file '%s'\n", cacheFile.c_str());
+        }
+        timer.after("save cache");
+    }
 }
 
 
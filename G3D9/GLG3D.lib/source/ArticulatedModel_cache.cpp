@@ -0,0 +1,329 @@
+/**
+ \file GLG3D/source/ArticulatedModel_cache.cpp
+
+ \created 2026-10-17
+ \edited  2026-10-17
+
+ Copyright 2000-2012, Morgan McGuire.
+ All rights reserved.
+*/
+#include "GLG3D/ArticulatedModel.h"
+#include "G3D/SpeedLoad.h"
+#include "G3D/FileSystem.h"
+
+namespace G3D {
+
+/* Cache file layout, in the byte order of the machine that wrote it:
+
+   SpeedLoad header "ArticulatedModel"
+   uint32 BYTE_ORDER_MARK, uint32 CACHE_VERSION, uint32 sizeof(CPUVertexArray::Vertex)
+   MD5Hash key
+   int64 length and int64 modification time of the source file, MD5Hash of its contents
+   uint64 length of the whole file
+   name, m_nextID
+   materials, each a length followed by a Material SpeedLoad chunk
+   parts in m_partArray order, each with its meshes
+   indices of the root parts
+
+   Vertex and index arrays are stored as raw, 16-byte aligned memory
+   images, so loading them is a single copy out of the mapped file.
+
+   A cache whose recorded source length and modification time match the
+   source file is trusted without reading the source.  Only when they
+   differ is the source hashed and compared against the recorded hash. */
+
+enum {CACHE_VERSION = 2, BYTE_ORDER_MARK = 0x01020304, CACHE_ALIGNMENT = 16};
+
+static void writeAlignment(BinaryOutput& b) {
+    while (b.position() % CACHE_ALIGNMENT != 0) {
+        b.writeUInt8(0);
+    }
+}
+
+
+static void readAlignment(BinaryInput& b) {
+    b.skip((CACHE_ALIGNMENT - b.getPosition() % CACHE_ALIGNMENT) % CACHE_ALIGNMENT);
+}
+
+
+std::string ArticulatedModel::cacheFilename(const Specification& specification, MD5Hash& key) {
+    if (specification.filename.empty()) {
+        return "";
+    }
+
+    // Everything besides the source file that the loaded model depends on.
+    // The OBJ and BSP options are not part of Specification::toAny.
+    const std::string& settings =
+        format("%d %d %d %d %d\n", CACHE_VERSION, (int)sizeof(CPUVertexArray::Vertex), (int)System::machineEndian(),
+               (int)specification.obj.texCoord3DMode, (int)specification.bsp.preserveLightMapCoordinates) +
+        specification.toAny().unparse();
+    key = Crypto::md5(settings.c_str(), settings.size());
+
+    if (FileSystem::size(specification.filename) <= 0) {
+        return "";
+    }
+
+    // Files inside a zipfile are cached beside the zipfile
+    std::string base = specification.filename;
+    std::string zipfile;
+    if (FileSystem::inZipfile(base, zipfile)) {
+        base = zipfile + "." + FilePath::baseExt(base);
+    }
+
+    // Name the file by the settings alone, so that each Specification of
+    // the same source has its own cache and a changed source overwrites it
+    return base + format(".%02x%02x%02x%02x.amcache", key[0], key[1], key[2], key[3]);
+}
+
+
+static MD5Hash hashFile(const std::string& filename) {
+    BinaryInput source(filename, G3D_LITTLE_ENDIAN);
+    return Crypto::md5(source.getCArray(), (size_t)source.getLength());
+}
+
+
+bool ArticulatedModel::saveCache(const std::string& filename, const MD5Hash& key, const std::string& sourceFilename) const {
+    // Gather the distinct materials
+    Array<Material::Ref>        material;
+    Table<const Material*, int> materialIndex;
+    for (int p = 0; p < m_partArray.size(); ++p) {
+        const Array<Mesh*>& meshArray = m_partArray[p]->m_meshArray;
+        for (int m = 0; m < meshArray.size(); ++m) {
+            const Material::Ref& mat = meshArray[m]->material;
+            if (mat.notNull() && ! materialIndex.containsKey(mat.pointer())) {
+                if (mat->customMap().notNull()) {
+                    // Not supported by Material::speedSerialize
+                    return false;
+                }
+                materialIndex.set(mat.pointer(), material.size());
+                material.append(mat);
+            }
+        }
+    }
+
+    const int64 sourceLength   = FileSystem::size(sourceFilename);
+    const int64 sourceModified = FileSystem::lastModified(sourceFilename);
+    if (sourceLength <= 0) {
+        return false;
+    }
+    const MD5Hash& sourceHash  = hashFile(sourceFilename);
+
+    BinaryOutput b(filename, System::machineEndian());
+
+    SpeedLoad::writeHeader(b, "ArticulatedModel");
+    b.writeUInt32(BYTE_ORDER_MARK);
+    b.writeUInt32(CACHE_VERSION);
+    b.writeUInt32(sizeof(CPUVertexArray::Vertex));
+    key.serialize(b);
+    b.writeInt64(sourceLength);
+    b.writeInt64(sourceModified);
+    sourceHash.serialize(b);
+    const int64 lengthPosition = b.position();
+    b.writeUInt64(0);
+
+    b.writeString32(name);
+    b.writeInt32(m_nextID);
+
+    b.writeInt32(material.size());
+    for (int i = 0; i < material.size(); ++i) {
+        const int64 start = b.position();
+        b.writeUInt32(0);
+        SpeedLoadIdentifier ignore;
+        material[i]->speedSerialize(ignore, b);
+
+        // Material::speedCreate does not end at the end of the chunk when
+        // it reuses a cached Material, so record the length
+        const int64 end = b.position();
+        b.setPosition(start);
+        b.writeUInt32(uint32(end - start - 4));
+        b.setPosition(end);
+    }
+
+    Table<const Part*, int> partIndex;
+    for (int p = 0; p < m_partArray.size(); ++p) {
+        partIndex.set(m_partArray[p], p);
+    }
+
+    b.writeInt32(m_partArray.size());
+    for (int p = 0; p < m_partArray.size(); ++p) {
+        const Part* part = m_partArray[p];
+        b.writeString32(part->name);
+        b.writeInt32(part->id);
+        b.writeInt32(part->isRoot() ? -1 : partIndex[part->m_parent]);
+        part->cframe.serialize(b);
+        part->sphereBounds.serialize(b);
+        part->boxBounds.serialize(b);
+        b.writeBool8(part->m_hasTexCoord0);
+        b.writeBool8(part->m_hasTexCoord1);
+        b.writeInt32(part->m_triangleCount);
+
+        const CPUVertexArray& vertex = part->cpuVertexArray;
+        b.writeBool8(vertex.hasTexCoord0);
+        b.writeBool8(vertex.hasTexCoord1);
+        b.writeBool8(vertex.hasTangent);
+        b.writeInt32(vertex.vertex.size());
+        b.writeInt32(vertex.texCoord1.size());
+        writeAlignment(b);
+        b.writeBytes(vertex.vertex.getCArray(), sizeof(CPUVertexArray::Vertex) * vertex.vertex.size());
+        b.writeBytes(vertex.texCoord1.getCArray(), sizeof(Point2unorm16) * vertex.texCoord1.size());
+
+        b.writeInt32(part->m_child.size());
+        for (int c = 0; c < part->m_child.size(); ++c) {
+            b.writeInt32(partIndex[part->m_child[c]]);
+        }
+
+        b.writeInt32(part->m_meshArray.size());
+        for (int m = 0; m < part->m_meshArray.size(); ++m) {
+            const Mesh* mesh = part->m_meshArray[m];
+            b.writeString32(mesh->name);
+            b.writeInt32(mesh->id);
+            b.writeInt32(mesh->material.isNull() ? -1 : materialIndex[mesh->material.pointer()]);
+            b.writeInt32(mesh->primitive);
+            b.writeBool8(mesh->twoSided);
+            mesh->sphereBounds.serialize(b);
+            mesh->boxBounds.serialize(b);
+            b.writeInt32(mesh->cpuIndexArray.size());
+            writeAlignment(b);
+            b.writeBytes(mesh->cpuIndexArray.getCArray(), sizeof(int) * mesh->cpuIndexArray.size());
+        }
+    }
+
+    b.writeInt32(m_rootArray.size());
+    for (int r = 0; r < m_rootArray.size(); ++r) {
+        b.writeInt32(partIndex[m_rootArray[r]]);
+    }
+
+    const int64 length = b.position();
+    b.setPosition(lengthPosition);
+    b.writeUInt64(length);
+    b.setPosition(length);
+
+    b.commit();
+    FileSystem::clearCache(FilePath::parent(filename));
+    return b.ok();
+}
+
+
+bool ArticulatedModel::loadCache(const std::string& filename, const MD5Hash& key, const std::string& sourceFilename) {
+    if (! FileSystem::exists(filename)) {
+        return false;
+    }
+
+    BinaryInput b(filename, System::machineEndian());
+
+    // Validate the header before trusting any of the contents
+    const int64 headerLength = SpeedLoad::HEADER_LENGTH + 3 * 4 + 16 + 2 * 8 + 16 + 8;
+    if ((b.getLength() < headerLength) ||
+        (b.readString(SpeedLoad::HEADER_LENGTH) != "ArticulatedModel") ||
+        (b.readUInt32() != BYTE_ORDER_MARK) ||
+        (b.readUInt32() != CACHE_VERSION) ||
+        (b.readUInt32() != sizeof(CPUVertexArray::Vertex)) ||
+        (MD5Hash(b) != key)) {
+        return false;
+    }
+
+    const int64   sourceLength   = b.readInt64();
+    const int64   sourceModified = b.readInt64();
+    const MD5Hash sourceHash(b);
+    if ((b.readUInt64() != uint64(b.getLength())) ||
+        (FileSystem::size(sourceFilename) != sourceLength)) {
+        return false;
+    }
+
+    // A source whose time stamp changed may still have the same contents
+    if ((FileSystem::lastModified(sourceFilename) != sourceModified) &&
+        (hashFile(sourceFilename) != sourceHash)) {
+        return false;
+    }
+
+    name = b.readString32();
+    m_nextID = b.readInt32();
+
+    Array<Material::Ref> material;
+    material.resize(b.readInt32());
+    for (int i = 0; i < material.size(); ++i) {
+        const uint32 length = b.readUInt32();
+        const int64  end    = b.getPosition() + length;
+        SpeedLoadIdentifier ignore;
+        material[i] = Material::speedCreate(ignore, b);
+        b.setPosition(end);
+    }
+
+    // Create all parts before linking them to their parents and children
+    Array<int> parentIndex;
+    Array< Array<int> > childIndex;
+    const int numParts = b.readInt32();
+    parentIndex.resize(numParts);
+    childIndex.resize(numParts);
+    m_partArray.resize(numParts);
+    for (int p = 0; p < numParts; ++p) {
+        const std::string& partName = b.readString32();
+        const ID partID(b.readInt32());
+        Part* part = new Part(partName, NULL, partID);
+        m_partArray[p] = part;
+        m_partTable.set(part->id, part);
+
+        parentIndex[p] = b.readInt32();
+        part->cframe.deserialize(b);
+        part->sphereBounds.deserialize(b);
+        part->boxBounds.deserialize(b);
+        part->m_hasTexCoord0  = b.readBool8();
+        part->m_hasTexCoord1  = b.readBool8();
+        part->m_triangleCount = b.readInt32();
+
+        CPUVertexArray& vertex = part->cpuVertexArray;
+        vertex.hasTexCoord0 = b.readBool8();
+        vertex.hasTexCoord1 = b.readBool8();
+        vertex.hasTangent   = b.readBool8();
+        vertex.vertex.resize(b.readInt32());
+        vertex.texCoord1.resize(b.readInt32());
+        readAlignment(b);
+        b.readBytes(vertex.vertex.getCArray(), sizeof(CPUVertexArray::Vertex) * vertex.vertex.size());
+        b.readBytes(vertex.texCoord1.getCArray(), sizeof(Point2unorm16) * vertex.texCoord1.size());
+
+        childIndex[p].resize(b.readInt32());
+        for (int c = 0; c < childIndex[p].size(); ++c) {
+            childIndex[p][c] = b.readInt32();
+        }
+
+        const int numMeshes = b.readInt32();
+        for (int m = 0; m < numMeshes; ++m) {
+            const std::string& meshName = b.readString32();
+            const ID meshID(b.readInt32());
+            Mesh* mesh = new Mesh(meshName, meshID);
+            part->m_meshArray.append(mesh);
+            m_meshTable.set(mesh->id, mesh);
+
+            const int materialIndex = b.readInt32();
+            if (materialIndex >= 0) {
+                mesh->material = material[materialIndex];
+            }
+            mesh->primitive = PrimitiveType(b.readInt32());
+            mesh->twoSided  = b.readBool8();
+            mesh->sphereBounds.deserialize(b);
+            mesh->boxBounds.deserialize(b);
+            mesh->cpuIndexArray.resize(b.readInt32());
+            readAlignment(b);
+            b.readBytes(mesh->cpuIndexArray.getCArray(), sizeof(int) * mesh->cpuIndexArray.size());
+        }
+    }
+
+    for (int p = 0; p < numParts; ++p) {
+        Part* part = m_partArray[p];
+        if (parentIndex[p] >= 0) {
+            part->m_parent = m_partArray[parentIndex[p]];
+        }
+        for (int c = 0; c < childIndex[p].size(); ++c) {
+            part->m_child.append(m_partArray[childIndex[p][c]]);
+        }
+    }
+
+    m_rootArray.resize(b.readInt32());
+    for (int r = 0; r < m_rootArray.size(); ++r) {
+        m_rootArray[r] = m_partArray[b.readInt32()];
+    }
+
+    return true;
+}
+
+} // namespace G3D
@@ -3,7 +3,7 @@
 
  \author Morgan McGuire, http://graphics.cs.williams.edu
  \created 2011-07-18
- \edited  2011-07-22
+ \edited  2026-10-17
  
  Copyright 2000-2012, Morgan McGuire.
  All rights reserved.
@@ -47,6 +47,7 @@ ArticulatedModel::Specification::Specification(const Any& a) {
     r.getIfPresent("cleanGeometrySettings",     cleanGeometrySettings);
     r.getIfPresent("scale",                     scale);
     r.getIfPresent("preprocess",                preprocess);
+    r.getIfPresent("useCache",                  useCache);
 
     r.verifyDone();
 }
@@ -59,6 +60,7 @@ Any ArticulatedModel::Specification::toAny() const {
     a["mergeMeshesByMaterial"]     = mergeMeshesByMaterial;
     a["cleanGeometrySettings"]     = cleanGeometrySettings;
     a["scale"]                     = scale;
+    a["useCache"]                  = useCache;
 
     if (preprocess.size() > 0) {
         a["preprocess"] = Any(preprocess, "preprocess");
@@ -2,11 +2,12 @@
  \file    BumpMap.cpp
  \author  Morgan McGuire, http://graphics.cs.williams.edu
  \created 2009-03-25
- \edited  2011-06-28
+ \edited  2026-10-17
 */
 #include "GLG3D/BumpMap.h"
 #include "G3D/Any.h"
 #include "G3D/SpeedLoad.h"
+#include "G3D/ImagePreprocessor.h"
 
 namespace G3D {
 
@@ -131,99 +132,16 @@ ImageBuffer::Ref BumpMap::computeNormalMap
  const unorm8*       src,
  const BumpMapPreprocess& preprocess) {
 
-    ImageBuffer::Ref normal = ImageBuffer::create(width, height, ImageFormat::RGBA8());
-    float whiteHeightInPixels = preprocess.zExtentPixels;
-    bool lowPassBump          = preprocess.lowPassFilter;
-    bool scaleHeightByNz      = preprocess.scaleZByNz;
-    
-    if (whiteHeightInPixels < 0.0f) {
-        // Default setting scales so that a gradient ramp
-        // over the whole image becomes a 45-degree angle
-        
-        // Account for potentially non-square aspect ratios
-        whiteHeightInPixels = max(width, height) * -whiteHeightInPixels;
-    }
-
-    debugAssert(whiteHeightInPixels >= 0);
-
-    const int w = width;
-    const int h = height;
-    const int stride = channels;
-    
-    const unorm8* const B = src;
-    Color4unorm8* const N = static_cast<Color4unorm8*>(normal->buffer());
-
-    // 1/s for the scale factor that each ELEVATION should be multiplied by.
-    // We avoid actually multiplying by this and instead just divide it out of z.
-    float elevationInvScale = 255.0f / whiteHeightInPixels;
-
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x) {
-            // Index into normal map pixel
-            int i = x + y * w;
-
-            // Index into bump map *byte*
-            int j = stride * i;
-
-            Vector3 delta;
-
-            // Get a value from B (with wrapping lookup) relative to (x, y)
-            // and divide by 255
-#define ELEVATION(DX, DY)  ((int)(B[(((DX + x + w) % w) +               \
-                                     ((DY + y + h) % h) * w) * stride].bits()))
-
-
-            // Sobel filter to compute the normal.  
-            //
-            // Y Filter (X filter is the transpose)
-            //  [ -1 -2 -1 ]
-            //  [  0  0  0 ]
-            //  [  1  2  1 ]
+    const ImageFormat* format[] = {NULL, ImageFormat::L8(), ImageFormat::LA8(), ImageFormat::RGB8(), ImageFormat::RGBA8()};
+    debugAssertM((channels >= 1) && (channels <= 4), "1 to 4 channels needed to compute normal maps");
 
-            // Write the Y value directly into the x-component so we don't have
-            // to explicitly compute a cross product at the end.  Does not 
-            // go out of bounds because the above is computed mod (width, height)
-            delta.y = -( ELEVATION(-1, -1) * 1 +  ELEVATION( 0, -1) * 2 +  ELEVATION( 1, -1) * 1 +
-                        -ELEVATION(-1,  1) * 1 + -ELEVATION( 0,  1) * 2 + -ELEVATION( 1,  1) * 1);
-
-            delta.x = -(-ELEVATION(-1, -1) * 1 + ELEVATION( 1, -1) * 1 + 
-                        -ELEVATION(-1,  0) * 2 + ELEVATION( 1,  0) * 2 + 
-                        -ELEVATION(-1,  1) * 1 + ELEVATION( 1,  1) * 1);
-
-            // The scale of each filter row is 4, the filter width is two pixels,
-            // and the "normal" range is 0-255.
-            delta.z = 4 * 2 * elevationInvScale;
-
-            // Delta is now scaled in pixels; normalize 
-            delta = delta.direction();
-
-            // Copy over the bump value into the alpha channel.
-            float H = B[j];
-
-            if (lowPassBump) {
-                H = (ELEVATION(-1, -1) + ELEVATION( 0, -1) + ELEVATION(1, -1) +
-                     ELEVATION(-1,  0) + ELEVATION( 0,  0) + ELEVATION(1,  0) +
-                     ELEVATION(-1,  1) + ELEVATION( 0,  1) + ELEVATION(1,  1)) / (255.0f * 9.0f);
-            }
-#           undef ELEVATION
-
-            if (scaleHeightByNz) {
-                // delta.z can't possibly be negative, so we avoid actually
-                // computing the absolute value.
-                H *= delta.z;
-            }
-
-            N[i].a = unorm8(H);
-
-            // Pack into byte range
-            delta = delta * 0.5f + Vector3(0.5f, 0.5f, 0.5f);
-            N[i].r = unorm8(delta.x);
-            N[i].g = unorm8(delta.y);
-            N[i].b = unorm8(delta.z);
-        }
-    }
+    ImagePreprocessor::Settings settings;
+    settings.computeMinMaxMean = false;
+    settings.computeNormalMap  = true;
+    settings.bumpMapPreprocess = preprocess;
 
-    return normal;
+    ImagePreprocessor::Stats ignore;
+    return ImagePreprocessor::apply(src, width, height, format[channels], settings, ignore);
 }
 
 } // G3D
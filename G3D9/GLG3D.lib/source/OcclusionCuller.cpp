@@ -0,0 +1,357 @@
+/**
+  \file GLG3D/OcclusionCuller.cpp
+
+  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+  \created 2026-10-17
+  \edited  2026-10-17
+*/
+
+#include "G3D/GCamera.h"
+#include "G3D/Box.h"
+#include "G3D/AABox.h"
+#include "G3D/CoordinateFrame.h"
+#include "G3D/SSEUtil.h"
+#include "GLG3D/OcclusionCuller.h"
+#include "GLG3D/CPUVertexArray.h"
+#include "GLG3D/Tri.h"
+
+namespace G3D {
+
+OcclusionCuller::OcclusionCuller(int width, int height) :
+    m_width(width),
+    m_height(height),
+    m_near(0),
+    m_hierarchyDirty(false),
+    m_numOccluderTriangles(0) {
+
+    alwaysAssertM(isPow2(width) && isPow2(height) && (width >= 4),
+                  "OcclusionCuller resolution must be powers of two, at least four pixels wide");
+
+    int numLevels = 1;
+    while ((levelWidth(numLevels - 1) > 1) || (levelHeight(numLevels - 1) > 1)) {
+        ++numLevels;
+    }
+    m_level.resize(numLevels);
+    for (int L = 0; L < numLevels; ++L) {
+        m_level[L].resize(levelStride(L) * levelHeight(L));
+    }
+    setCamera(GCamera(), Rect2D::xywh(0, 0, (float)width, (float)height));
+}
+
+
+void OcclusionCuller::setCamera(const GCamera& camera, const Rect2D& viewport) {
+    Matrix4 projectUnit;
+    camera.getProjectUnitMatrix(viewport, projectUnit);
+
+    // Unit to pixel coordinates, keeping the homogeneous w from the
+    // projection, which is the distance along the view axis
+    const float sx = m_width * 0.5f;
+    const float sy = m_height * 0.5f;
+    const Matrix4 unitToScreen(sx,   0, 0, sx,
+                               0,  -sy, 0, sy,
+                               0,    0, 1, 0,
+                               0,    0, 0, 1);
+
+    m_worldToScreen = unitToScreen * projectUnit * camera.coordinateFrame().inverse().toMatrix4();
+    m_near = -camera.nearPlaneZ();
+
+    Array<float>& buffer = m_level[0];
+    for (int i = 0; i < buffer.size(); ++i) {
+        buffer[i] = finf();
+    }
+    m_hierarchyDirty = true;
+    m_numOccluderTriangles = 0;
+}
+
+
+void OcclusionCuller::rasterizeOccluders(const Array<Vector3>& vertex, const Array<int>& index) {
+    rasterizeOccluders(vertex, index, CFrame());
+}
+
+
+void OcclusionCuller::rasterizeOccluders(const Array<Vector3>& vertex, const Array<int>& index, const CFrame& cframe) {
+    const Matrix4& M = m_worldToScreen * cframe.toMatrix4();
+    for (int i = 0; i < index.size(); i += 3) {
+        rasterizeTriangle(M * Vector4(vertex[index[i]], 1.0f),
+                          M * Vector4(vertex[index[i + 1]], 1.0f),
+                          M * Vector4(vertex[index[i + 2]], 1.0f));
+    }
+}
+
+
+void OcclusionCuller::rasterizeOccluders(const Array<Surface::Ref>& occluderArray) {
+    CPUVertexArray vertexArray;
+    Array<Tri> triArray;
+    Surface::getTris(occluderArray, vertexArray, triArray);
+
+    for (int t = 0; t < triArray.size(); ++t) {
+        const Tri& tri = triArray[t];
+        rasterizeTriangle(m_worldToScreen * Vector4(tri.position(vertexArray, 0), 1.0f),
+                          m_worldToScreen * Vector4(tri.position(vertexArray, 1), 1.0f),
+                          m_worldToScreen * Vector4(tri.position(vertexArray, 2), 1.0f));
+    }
+}
+
+
+void OcclusionCuller::rasterizeTriangle(const Vector4& a, const Vector4& b, const Vector4& c) {
+    ++m_numOccluderTriangles;
+
+    const Vector4* in[3] = {&a, &b, &c};
+    int numInside = 0;
+    for (int i = 0; i < 3; ++i) {
+        numInside += (in[i]->w >= m_near) ? 1 : 0;
+    }
+
+    if (numInside == 0) {
+        return;
+    }
+
+    // Clip to the near plane, which is linear in homogeneous coordinates
+    Vector4 clipped[4];
+    int n = 0;
+    if (numInside == 3) {
+        clipped[0] = a;
+        clipped[1] = b;
+        clipped[2] = c;
+        n = 3;
+    } else {
+        for (int i = 0; i < 3; ++i) {
+            const Vector4& p = *in[i];
+            const Vector4& q = *in[(i + 1) % 3];
+            const bool pInside = (p.w >= m_near);
+            const bool qInside = (q.w >= m_near);
+            if (pInside) {
+                clipped[n++] = p;
+            }
+            if (pInside != qInside) {
+                const float t = (m_near - p.w) / (q.w - p.w);
+                clipped[n] = p + (q - p) * t;
+                clipped[n].w = m_near;
+                ++n;
+            }
+        }
+    }
+
+    Vector3 screen[4];
+    for (int i = 0; i < n; ++i) {
+        const float invW = 1.0f / clipped[i].w;
+        screen[i] = Vector3(clipped[i].x * invW, clipped[i].y * invW, invW);
+    }
+
+    for (int i = 2; i < n; ++i) {
+        rasterizeScreenTriangle(screen[0], screen[i - 1], screen[i]);
+    }
+    m_hierarchyDirty = true;
+}
+
+
+void OcclusionCuller::rasterizeScreenTriangle(const Vector3& v0, const Vector3& _v1, const Vector3& _v2) {
+    float area = (_v1.x - v0.x) * (_v2.y - v0.y) - (_v2.x - v0.x) * (_v1.y - v0.y);
+    if (! (abs(area) > 1e-12f)) {
+        // Degenerate, or NaN from an infinite vertex
+        return;
+    }
+
+    // Make the winding positive, so that all edge functions are positive inside
+    const bool flip = (area < 0);
+    const Vector3& v1 = flip ? _v2 : _v1;
+    const Vector3& v2 = flip ? _v1 : _v2;
+    area = abs(area);
+
+    // Bounds of the pixels whose centers the triangle could cover
+    const int x0 = iMax(iFloor(min(v0.x, v1.x, v2.x)), 0);
+    const int y0 = iMax(iFloor(min(v0.y, v1.y, v2.y)), 0);
+    const int x1 = iMin(iCeil(max(v0.x, v1.x, v2.x)), m_width) - 1;
+    const int y1 = iMin(iCeil(max(v0.y, v1.y, v2.y)), m_height) - 1;
+    if ((x0 > x1) || (y0 > y1)) {
+        return;
+    }
+
+    // Edge functions E(x, y) = A x + B y + C, positive inside.  A
+    // pixel is covered when its center is inside all three edges.
+    // Pixels on a shared edge are written by both triangles, so that
+    // adjacent occluders leave no cracks.
+    const Vector3* p[3] = {&v0, &v1, &v2};
+    float A[3], B[3], C[3];
+    for (int e = 0; e < 3; ++e) {
+        const Vector3& s = *p[e];
+        const Vector3& t = *p[(e + 1) % 3];
+        A[e] = s.y - t.y;
+        B[e] = t.x - s.x;
+        C[e] = -(A[e] * s.x + B[e] * s.y);
+    }
+
+    // 1 / w is linear in screen space.  The farthest point of a pixel
+    // has the smallest 1 / w, half of |a| + |b| below its center value.
+    // The triangle's smallest vertex 1 / w also bounds every pixel that
+    // it covers, which guards against round-off near the edges.
+    const float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+    const float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+    const float dzc  = v0.z - dzdx * v0.x - dzdy * v0.y - 0.5f * (abs(dzdx) + abs(dzdy));
+    const float minZ = min(v0.z, v1.z, v2.z);
+
+    Array<float>& buffer = m_level[0];
+    const int stride = levelStride(0);
+
+#   ifdef G3D_SSE
+        const __m128 laneX = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero  = _mm_setzero_ps();
+        const __m128 one   = _mm_set1_ps(1.0f);
+        const __m128 minZ4 = _mm_set1_ps(minZ);
+        const int xStart = x0 & ~3;
+
+        for (int y = y0; y <= y1; ++y) {
+            const float cy = y + 0.5f;
+            float* row = buffer.getCArray() + y * stride;
+
+            for (int x = xStart; x <= x1; x += 4) {
+                const __m128 cx = _mm_add_ps(_mm_set1_ps((float)x), laneX);
+
+                __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[0]), cx), _mm_set1_ps(B[0] * cy + C[0])), zero);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[1]), cx), _mm_set1_ps(B[1] * cy + C[1])), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[2]), cx), _mm_set1_ps(B[2] * cy + C[2])), zero));
+
+                if (_mm_movemask_ps(inside) == 0) {
+                    continue;
+                }
+
+                const __m128 z = _mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), cx), _mm_set1_ps(dzdy * cy + dzc)), minZ4);
+                const __m128 depth = _mm_div_ps(one, z);
+                const __m128 old = _mm_loadu_ps(row + x);
+                const __m128 nearer = _mm_min_ps(old, depth);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            }
+        }
+#   else
+        for (int y = y0; y <= y1; ++y) {
+            const float cy = y + 0.5f;
+            float* row = buffer.getCArray() + y * stride;
+
+            for (int x = x0; x <= x1; ++x) {
+                const float cx = x + 0.5f;
+                if ((A[0] * cx + (B[0] * cy + C[0]) >= 0) &&
+                    (A[1] * cx + (B[1] * cy + C[1]) >= 0) &&
+                    (A[2] * cx + (B[2] * cy + C[2]) >= 0)) {
+                    const float z = max(dzdx * cx + (dzdy * cy + dzc), minZ);
+                    row[x] = min(row[x], 1.0f / z);
+                }
+            }
+        }
+#   endif
+}
+
+
+void OcclusionCuller::buildHierarchy() const {
+    for (int L = 1; L < m_level.size(); ++L) {
+        const Array<float>& child = m_level[L - 1];
+        Array<float>& parent = m_level[L];
+        const int childStride = levelStride(L - 1);
+        const int childWidth  = levelWidth(L - 1);
+        const int childHeight = levelHeight(L - 1);
+        const int stride = levelStride(L);
+
+        for (int y = 0; y < levelHeight(L); ++y) {
+            const float* row0 = child.getCArray() + (2 * y) * childStride;
+            const float* row1 = child.getCArray() + iMin(2 * y + 1, childHeight - 1) * childStride;
+            float* out = parent.getCArray() + y * stride;
+            for (int x = 0; x < levelWidth(L); ++x) {
+                const int xa = 2 * x;
+                const int xb = iMin(2 * x + 1, childWidth - 1);
+                out[x] = max(max(row0[xa], row0[xb]), max(row1[xa], row1[xb]));
+            }
+        }
+    }
+    m_hierarchyDirty = false;
+}
+
+
+float OcclusionCuller::depth(int x, int y, int level) const {
+    debugAssert(level >= 0 && level < m_level.size());
+    debugAssert(x >= 0 && x < levelWidth(level) && y >= 0 && y < levelHeight(level));
+    if ((level > 0) && m_hierarchyDirty) {
+        buildHierarchy();
+    }
+    return m_level[level][y * levelStride(level) + x];
+}
+
+
+bool OcclusionCuller::isOccluded(const AABox& box) const {
+    return isOccluded(Box(box));
+}
+
+
+bool OcclusionCuller::isOccluded(const Box& box) const {
+    if (! box.isFinite()) {
+        return false;
+    }
+
+    // Screen-space rectangle and nearest distance of the corners
+    float nearest = finf();
+    float xMin = finf(), yMin = finf();
+    float xMax = -finf(), yMax = -finf();
+    for (int i = 0; i < 8; ++i) {
+        const Vector4& h = m_worldToScreen * Vector4(box.corner(i), 1.0f);
+        if (h.w < m_near) {
+            // Crosses the near plane
+            return false;
+        }
+        const float x = h.x / h.w;
+        const float y = h.y / h.w;
+        xMin = min(xMin, x);  xMax = max(xMax, x);
+        yMin = min(yMin, y);  yMax = max(yMax, y);
+        nearest = min(nearest, h.w);
+    }
+
+    if ((xMax < 0) || (yMax < 0) || (xMin >= m_width) || (yMin >= m_height)) {
+        // Off screen; frustum culling is responsible for this case
+        return false;
+    }
+
+    // Pixels whose centers enclose the rectangle.  An occluder
+    // triangle that covers all of those centers covers the whole
+    // rectangle, because both are convex.
+    const int x0 = iClamp(iFloor(xMin - 0.5f), 0, m_width - 1);
+    const int y0 = iClamp(iFloor(yMin - 0.5f), 0, m_height - 1);
+    const int x1 = iClamp(iFloor(xMax + 0.5f), 0, m_width - 1);
+    const int y1 = iClamp(iFloor(yMax + 0.5f), 0, m_height - 1);
+
+    if (m_hierarchyDirty) {
+        buildHierarchy();
+    }
+
+    // Coarsest level at which the rectangle spans at most 2x2 texels
+    int L = 0;
+    while (((x1 >> L) - (x0 >> L) > 1) || ((y1 >> L) - (y0 >> L) > 1)) {
+        ++L;
+    }
+
+    const Array<float>& level = m_level[L];
+    const int stride = levelStride(L);
+    for (int y = (y0 >> L); y <= (y1 >> L); ++y) {
+        for (int x = (x0 >> L); x <= (x1 >> L); ++x) {
+            if (! (nearest > level[y * stride + x])) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+void OcclusionCuller::cull(Array<Surface::Ref>& surfaceArray, bool previous) const {
+    for (int i = 0; i < surfaceArray.size(); ++i) {
+        CFrame cframe;
+        AABox box;
+        surfaceArray[i]->getCoordinateFrame(cframe, previous);
+        surfaceArray[i]->getObjectSpaceBoundingBox(box, previous);
+
+        if (box.isFinite() && isOccluded(cframe.toWorldSpace(box))) {
+            surfaceArray.fastRemove(i);
+            --i;
+        }
+    }
+}
+
+} // namespace G3D
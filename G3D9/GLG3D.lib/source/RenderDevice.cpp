@@ -4,7 +4,7 @@
  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
  
  \created 2001-07-08
- \edited  2011-06-12
+ \edited  2026-10-17
  */
 
 #include "G3D/platform.h"
@@ -12,6 +12,7 @@
 #include "G3D/Log.h"
 #include "G3D/GCamera.h"
 #include "G3D/FileSystem.h"
+#include "G3D/FrameMemoryManager.h"
 #include "GLG3D/glcalls.h"
 #include "GLG3D/RenderDevice.h"
 #include "GLG3D/Texture.h"
@@ -1382,6 +1383,8 @@ void RenderDevice::beginFrame() {
 
     ++m_beginEndFrame;
     debugAssertM(m_beginEndFrame == 1, "Mismatched calls to beginFrame/endFrame");
+
+    FrameMemoryManager::current()->beginFrame();
 }
 
 
@@ -1413,6 +1416,8 @@ void RenderDevice::endFrame() {
     --m_beginEndFrame;
     debugAssertM(m_beginEndFrame == 0, "Mismatched calls to beginFrame/endFrame");
 
+    FrameMemoryManager::current()->endFrame();
+
     // Schedule a swap buffer iff we are handling them automatically.
     m_swapGLBuffersPending = m_swapBuffersAutomatically;
 
@@ -4,12 +4,13 @@
   \maintainer Morgan McGuire, http://graphics.cs.williams.edu
 
   \created 2004-11-20
-  \edited  2011-06-13
+  \edited  2026-10-17
 
   Copyright 2001-2011, Morgan McGuire
  */
 #include "G3D/Log.h"
 #include "G3D/fileutils.h"
+#include "G3D/FrameMemoryManager.h"
 #include "GLG3D/SuperSurface.h"
 #include "GLG3D/Lighting.h"
 #include "GLG3D/RenderDevice.h"
@@ -122,14 +123,27 @@ void SuperSurface::renderIntoGBufferHomogeneous
 (RenderDevice*                rd, 
  Array<Surface::Ref>&         surfaceArray,
  const GBuffer::Ref&          gbuffer,
+ const CFrame&                previousCameraFrame) const {
+
+    renderIntoGBufferHomogeneous(rd, surfaceArray, 0, surfaceArray.size(), gbuffer, previousCameraFrame);
+}
+
+
+void SuperSurface::renderIntoGBufferHomogeneous
+(RenderDevice*                rd, 
+ const Array<Surface::Ref>&   surfaceArray,
+ int                          begin,
+ int                          end,
+ const GBuffer::Ref&          gbuffer,
  const CFrame&                previousCameraFrame) const {
 
     rd->pushState(); {
         rd->setShadeMode(RenderDevice::SHADE_SMOOTH);
         const RenderDevice::CullFace oldCullFace = rd->cullFace();
 
-        for (int s = 0; s < surfaceArray.size(); ++s) {
-            const SuperSurface::Ref& surface = surfaceArray[s].downcast<SuperSurface>();
+        for (int s = begin; s < end; ++s) {
+            // A raw pointer avoids touching the reference count of every Surface
+            const SuperSurface* surface = dynamic_cast<const SuperSurface*>(surfaceArray[s].pointer());
             debugAssertM(surface != NULL, 
                          "Non SuperSurface element of surfaceArray "
                          "in SuperSurface::renderIntoGBufferHomogeneous");
@@ -217,6 +231,7 @@ bool SuperSurface::depthWriteHint(float distanceToCamera) const {
 
 void SuperSurface::sortFrontToBack(Array<SuperSurface::Ref>& a, const Vector3& v) {
     Array<Surface::Ref> s;
+    s.clearAndSetMemoryManager(FrameMemoryManager::current());
     s.resize(a.size());
     for (int i = 0; i < s.size(); ++i) {
         s[i] = a[i];
@@ -1017,6 +1032,11 @@ bool SuperSurface::hasPartialCoverage() const {
 }
 
 
+uint32 SuperSurface::materialSortKey() const {
+    return uint32(HashTrait<Material*>::hashCode(m_gpuGeom->material.pointer()));
+}
+
+
 void SuperSurface::getCoordinateFrame(CoordinateFrame& c, bool previous) const {
     if (previous) {
         c = m_previousFrame;
@@ -1092,6 +1112,7 @@ void SuperSurface::getTrisHomogeneous(const Array<Surface::Ref>& surfaceArray, C
 
     // Maps already seen surface-owned vertexArrays to the vertex index offset in the CPUVertexArray
     Table<const CPUVertexArray*, uint32> indexOffsetTable;
+    indexOffsetTable.clearAndSetMemoryManager(FrameMemoryManager::current());
     const bool PREVIOUS = false;
 
     for (int i = 0; i < surfaceArray.size(); ++i) {
@@ -4,7 +4,7 @@
   \maintainer Morgan McGuire, http://graphics.cs.williams.edu
 
   \created 2003-11-15
-  \edited  2011-06-10
+  \edited  2026-10-17
  */ 
 
 #include "G3D/Sphere.h"
@@ -16,6 +16,9 @@
 #include "G3D/AABox.h"
 #include "G3D/Sphere.h"
 #include "G3D/typeutils.h"
+#include "G3D/FrameMemoryManager.h"
+#include "G3D/radixSort.h"
+#include "G3D/Table.h"
 #include "GLG3D/Surface.h"
 #include "GLG3D/RenderDevice.h"
 #include "GLG3D/SuperShader.h"
@@ -31,25 +34,41 @@ void Surface::renderIntoGBuffer
     const GBuffer::Ref&         gbuffer,
     const CFrame&               previousCameraFrame) {
 
-    // Sort front-to-back for best early-depth performance
-    // (we avoid an early depth pass because we don't know if the depth complexity warrants it)
-    sortFrontToBack(surfaceArray, rd->cameraToWorldMatrix().lookVector());
-
-    // Separate by type.  This preserves the sort order and ensures that the closest
-    // object will still render first.
-    Array< Array<Surface::Ref> > derivedTable;
-    categorizeByDerivedType(surfaceArray, derivedTable);
+    // Separate by type, and sort each type front-to-back for best early-depth performance
+    // (we avoid an early depth pass because we don't know if the depth complexity warrants it).
+    // The types are ordered so that the closest object will still render first.
+    Array<int> typeStart;
+    typeStart.clearAndSetMemoryManager(FrameMemoryManager::current());
+    sortByDerivedType(surfaceArray, rd->cameraToWorldMatrix().lookVector(), typeStart);
 
     rd->pushState(gbuffer->framebuffer());
-    for (int t = 0; t < derivedTable.size(); ++t) {
-        Array<Surface::Ref>& derivedArray = derivedTable[t];
-        debugAssertM(derivedArray.size() > 0, "categorizeByDerivedType produced an empty subarray");
-        derivedArray[0]->renderIntoGBufferHomogeneous(rd, derivedArray, gbuffer, previousCameraFrame);
+    for (int t = 0; t < typeStart.size() - 1; ++t) {
+        // Each type renders its own range of the sorted array in place
+        surfaceArray[typeStart[t]]->renderIntoGBufferHomogeneous
+            (rd, surfaceArray, typeStart[t], typeStart[t + 1], gbuffer, previousCameraFrame);
     }
     rd->popState();
 }
 
 
+void Surface::renderIntoGBufferHomogeneous
+   (RenderDevice*                rd,
+    const Array<Surface::Ref>&   surfaceArray,
+    int                          begin,
+    int                          end,
+    const GBuffer::Ref&          gbuffer,
+    const CFrame&                previousCameraFrame) const {
+
+    Array<Surface::Ref> range;
+    range.clearAndSetMemoryManager(FrameMemoryManager::current());
+    range.reserve(end - begin);
+    for (int s = begin; s < end; ++s) {
+        range.append(surfaceArray[s]);
+    }
+    renderIntoGBufferHomogeneous(rd, range, gbuffer, previousCameraFrame);
+}
+
+
 void Surface::sendGeometry(RenderDevice* rd, const Array<Surface::Ref>& surface3D) {
     rd->pushState();
     for (int i = 0; i < surface3D.size(); ++i) {
@@ -115,7 +134,8 @@ void Surface::renderWireframe(RenderDevice* rd, const Array<Surface::Ref>& surfa
     // Separate by type.  This preserves the sort order and ensures that the closest
     // object will still render first.
     Array< Array<Surface::Ref> > derivedTable;
-    categorizeByDerivedType(surfaceArray, derivedTable);
+    derivedTable.clearAndSetMemoryManager(FrameMemoryManager::current());
+    categorizeByDerivedType(surfaceArray, derivedTable, derivedTable.memoryManager());
 
     for (int t = 0; t < derivedTable.size(); ++t) {
         Array<Surface::Ref>& derivedArray = derivedTable[t];
@@ -142,6 +162,7 @@ void Surface::cull
     outModels.fastClear();
 
     Array<Plane> clipPlanes;
+    clipPlanes.clearAndSetMemoryManager(FrameMemoryManager::current());
     camera.getClipPlanes(viewport, clipPlanes);
     for (int i = 0; i < allModels.size(); ++i) {
         Sphere sphere;
@@ -165,6 +186,7 @@ void Surface::cull
  bool                       previous) {
      
     Array<Plane> clipPlanes;
+    clipPlanes.clearAndSetMemoryManager(FrameMemoryManager::current());
     camera.getClipPlanes(viewport, clipPlanes);
     for (int i = 0; i < allModels.size(); ++i) {
         Sphere sphere;
@@ -193,7 +215,8 @@ void Surface::renderDepthOnly
         rd->setColorWrite(false);
 
         Array< Array<Surface::Ref> > derivedTable;
-        categorizeByDerivedType(surfaceArray, derivedTable);
+        derivedTable.clearAndSetMemoryManager(FrameMemoryManager::current());
+        categorizeByDerivedType(surfaceArray, derivedTable, derivedTable.memoryManager());
 
         for (int t = 0; t < derivedTable.size(); ++t) {
             Array<Surface::Ref>& derivedArray = derivedTable[t];
@@ -439,48 +462,149 @@ void Surface2D::sortAndRender(RenderDevice* rd, Array<Surface2D::Ref>& posed2D)
 }
 
 
-class ModelSorter {
-public:
-    float                  sortKey;
-    Surface::Ref           model;
-
-    ModelSorter() {}
+/** Distance of the center of the bounding sphere of \a surface along \a axis */
+static float sortDistance(const Surface::Ref& surface, const Vector3& axis) {
+    Sphere sphere;
+    CFrame cframe;
+    surface->getCoordinateFrame(cframe, false);
+    surface->getObjectSpaceBoundingSphere(sphere, false);
+    return axis.dot(cframe.pointToWorldSpace(sphere.center));
+}
 
-    ModelSorter(const Surface::Ref& m, const Vector3& axis) : model(m) {
-        Sphere s;
-        CFrame c;
-        m->getCoordinateFrame(c, false);
-        m->getObjectSpaceBoundingSphere(s, false);
-        sortKey = axis.dot(c.pointToWorldSpace(s.center));
-    }
 
-    inline bool operator>(const ModelSorter& s) const {
-        return sortKey > s.sortKey;
-    }
+/** Reorders \a surface so that surface[i] becomes the old
+    surface[key[i].index].  Follows the cycles of the permutation so
+    that each Surface::Ref is only assigned once.  Destroys the indices
+    in \a key. */
+static void permute(Array<Surface::Ref>& surface, Array<SortKey>& key) {
+    for (int i = 0; i < key.size(); ++i) {
+        if (key[i].index == i) {
+            continue;
+        }
 
-    inline bool operator<(const ModelSorter& s) const {
-        return sortKey < s.sortKey;
+        const Surface::Ref temp = surface[i];
+        int j = i;
+        while (key[j].index != i) {
+            const int k = key[j].index;
+            surface[j] = surface[k];
+            key[j].index = j;
+            j = k;
+        }
+        surface[j] = temp;
+        key[j].index = j;
     }
-};
+}
 
 
 void Surface::sortFrontToBack
 (Array<Surface::Ref>& surface, 
  const Vector3&       wsLook) {
 
-    static Array<ModelSorter> sorter;
-    
+    Array<SortKey> key;
+    key.clearAndSetMemoryManager(FrameMemoryManager::current());
+    key.resize(surface.size());
+
+    for (int m = 0; m < surface.size(); ++m) {
+        key[m] = SortKey(floatSortKey(sortDistance(surface[m], wsLook)), m);
+    }
+
+    radixSort(key);
+    permute(surface, key);
+}
+
+
+void Surface::sortByDerivedType
+(Array<Surface::Ref>& surface, 
+ const Vector3&       wsLook,
+ Array<int>&          typeStart,
+ bool                 groupByMaterial) {
+
+    typeStart.fastClear();
+    if (surface.size() == 0) {
+        typeStart.append(0);
+        return;
+    }
+
+    MemoryManager::Ref frameMemory = FrameMemoryManager::current();
+
+    // Number the types in order of appearance.  Consecutive surfaces
+    // usually have the same type, so remember the last lookup.
+    Table<std::type_info* const, int> typeInfoToIndex;
+    typeInfoToIndex.clearAndSetMemoryManager(frameMemory);
+
+    Array<uint32> nearestOfType;
+    nearestOfType.clearAndSetMemoryManager(frameMemory);
+
+    Array<SortKey> key;
+    key.clearAndSetMemoryManager(frameMemory);
+    key.resize(surface.size());
+
+    const std::type_info* lastType = NULL;
+    int lastIndex = -1;
     for (int m = 0; m < surface.size(); ++m) {
-        sorter.append(ModelSorter(surface[m], wsLook));
+        const Surface::Ref& s = surface[m];
+        const std::type_info* type = &typeid(*s);
+        if (type != lastType) {
+            bool created = false;
+            int& index = typeInfoToIndex.getCreate(const_cast<std::type_info*>(type), created);
+            if (created) {
+                index = nearestOfType.size();
+                nearestOfType.append(0xFFFFFFFF);
+            }
+            lastType = type;
+            lastIndex = index;
+        }
+
+        const uint32 distance = floatSortKey(sortDistance(s, wsLook));
+        nearestOfType[lastIndex] = min(nearestOfType[lastIndex], distance);
+
+        uint64 material = 0;
+        if (groupByMaterial) {
+            const uint32 k = s->materialSortKey();
+            material = (k ^ (k >> 16)) & 0xFFFF;
+        }
+
+        // The type index goes in the top 16 bits for now
+        key[m] = SortKey((uint64(lastIndex) << 48) | (material << 32) | distance, m);
+    }
+
+    alwaysAssertM(nearestOfType.size() <= 0xFFFF, "Too many Surface subclasses for sortByDerivedType");
+
+    if (nearestOfType.size() > 1) {
+        // Replace each type index with the rank of the type's nearest
+        // member, so that the closest Surface still renders first
+        Array<SortKey> typeOrder;
+        typeOrder.clearAndSetMemoryManager(frameMemory);
+        typeOrder.resize(nearestOfType.size());
+        for (int t = 0; t < typeOrder.size(); ++t) {
+            typeOrder[t] = SortKey(nearestOfType[t], t);
+        }
+        radixSort(typeOrder);
+
+        Array<uint64> rank;
+        rank.clearAndSetMemoryManager(frameMemory);
+        rank.resize(typeOrder.size());
+        for (int r = 0; r < typeOrder.size(); ++r) {
+            rank[typeOrder[r].index] = uint64(r) << 48;
+        }
+
+        for (int m = 0; m < key.size(); ++m) {
+            uint64& k = key[m].key;
+            k = rank[int(k >> 48)] | (k & 0x0000FFFFFFFFFFFFULL);
+        }
     }
 
-    sorter.sort(SORT_INCREASING);
+    radixSort(key);
 
-    for (int m = 0; m < sorter.size(); ++m) {
-        surface[m] = sorter[m].model;
+    typeStart.append(0);
+    for (int m = 1; m < key.size(); ++m) {
+        if ((key[m].key >> 48) != (key[m - 1].key >> 48)) {
+            typeStart.append(m);
+        }
     }
+    typeStart.append(key.size());
 
-    sorter.fastClear();
+    permute(surface, key);
 }
 
 
@@ -762,7 +886,8 @@ void Surface2D::sort(Array<Surface2DRef>& array) {
 
 void Surface::getTris(const Array<Surface::Ref>& surfaceArray, CPUVertexArray& cpuVertexArray, Array<Tri>& triArray){
     Array< Array<Surface::Ref> > derivedTable;
-    categorizeByDerivedType(surfaceArray, derivedTable);
+    derivedTable.clearAndSetMemoryManager(FrameMemoryManager::current());
+    categorizeByDerivedType(surfaceArray, derivedTable, derivedTable.memoryManager());
     for (int t = 0; t < derivedTable.size(); ++t) {
         Array<Surface::Ref>& derivedArray = derivedTable[t];
         derivedArray[0]->getTrisHomogeneous(derivedArray, cpuVertexArray, triArray);
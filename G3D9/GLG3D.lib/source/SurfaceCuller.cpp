@@ -0,0 +1,415 @@
+/**
+  \file GLG3D/SurfaceCuller.cpp
+
+  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
+
+  \created 2026-10-17
+  \edited  2026-10-17
+*/
+
+#include "G3D/GCamera.h"
+#include "G3D/Rect2D.h"
+#include "G3D/Sphere.h"
+#include "G3D/CoordinateFrame.h"
+#include "G3D/FrameMemoryManager.h"
+#include "G3D/SSEUtil.h"
+#include "GLG3D/SurfaceCuller.h"
+
+namespace G3D {
+
+namespace _internal {
+
+/** Slot and Morton code of its sphere center, for ordering the slots */
+class CullerMortonKey {
+public:
+    uint32      code;
+    int         slot;
+
+    bool operator<(const CullerMortonKey& other) const {
+        return code < other.code;
+    }
+
+    bool operator>(const CullerMortonKey& other) const {
+        return code > other.code;
+    }
+};
+
+
+/** Spreads the low 10 bits of x so that there are two zero bits between each */
+static inline uint32 spreadBits(uint32 x) {
+    x &= 0x3FF;
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8))  & 0x0300F00F;
+    x = (x | (x << 4))  & 0x030C30C3;
+    x = (x | (x << 2))  & 0x09249249;
+    return x;
+}
+
+
+/** Plane in the form used by the per-sphere test: culled iff n . center - d < -radius */
+class CullerPlane {
+public:
+    float       nx, ny, nz, d;
+
+    CullerPlane() {}
+
+    CullerPlane(const Plane& plane) {
+        const Vector3& n = plane.normal();
+        nx = n.x;
+        ny = n.y;
+        nz = n.z;
+        d  = -plane.distance(Vector3::zero());
+    }
+};
+
+
+#ifdef G3D_SSE
+/** A CullerPlane with each coefficient replicated across four lanes.
+    Must be 16-byte aligned, as FrameMemoryManager allocations are. */
+class CullerPlane4 {
+public:
+    __m128      nx, ny, nz, d;
+};
+#endif
+
+} // namespace _internal
+
+using _internal::CullerMortonKey;
+using _internal::CullerPlane;
+
+
+SurfaceCuller::SurfaceCuller() : m_previous(false), m_totalExtent(0), m_builtExtent(0), m_needsRebuild(true) {}
+
+
+void SurfaceCuller::setSurfaceArray(const Array<Surface::Ref>& surfaceArray, bool previous) {
+    if ((surfaceArray.size() != m_surfaceArray.size()) || (previous != m_previous)) {
+        // Adding or removing a Surface renumbers the ones after it, so
+        // start over
+        m_previous = previous;
+        m_surfaceArray = surfaceArray;
+        m_isDirty.resize(m_surfaceArray.size());
+        m_dirty.fastClear();
+        m_needsRebuild = true;
+        return;
+    }
+
+    for (int i = 0; i < surfaceArray.size(); ++i) {
+        if (m_surfaceArray[i].pointer() != surfaceArray[i].pointer()) {
+            m_surfaceArray[i] = surfaceArray[i];
+            setDirty(i);
+        }
+    }
+}
+
+
+void SurfaceCuller::setDirty(int index) {
+    debugAssert(index >= 0 && index < m_surfaceArray.size());
+    if (! m_needsRebuild && ! m_isDirty[index]) {
+        m_isDirty[index] = true;
+        m_dirty.append(index);
+    }
+}
+
+
+void SurfaceCuller::setAllDirty() {
+    m_needsRebuild = true;
+    m_dirty.fastClear();
+}
+
+
+void SurfaceCuller::updateBounds(int index) {
+    const Surface::Ref& surface = m_surfaceArray[index];
+    CFrame cframe;
+    Sphere sphere;
+    surface->getCoordinateFrame(cframe, m_previous);
+    surface->getObjectSpaceBoundingSphere(sphere, m_previous);
+    sphere = cframe.toWorldSpace(sphere);
+
+    const int slot = m_slot[index];
+    if (isFinite(sphere.center.x) && isFinite(sphere.center.y) && isFinite(sphere.center.z) && isFinite(sphere.radius)) {
+        m_x[slot]      = sphere.center.x;
+        m_y[slot]      = sphere.center.y;
+        m_z[slot]      = sphere.center.z;
+        m_radius[slot] = sphere.radius;
+    } else {
+        m_x[slot]      = 0;
+        m_y[slot]      = 0;
+        m_z[slot]      = 0;
+        m_radius[slot] = finf();
+    }
+}
+
+
+void SurfaceCuller::updateCluster(int c) {
+    Cluster& cluster = m_cluster[c];
+    if (cluster.finite) {
+        m_totalExtent -= cluster.extent.sum();
+    }
+    cluster.finite = true;
+
+    Vector3 lo(finf(), finf(), finf());
+    Vector3 hi(-finf(), -finf(), -finf());
+    for (int slot = c * CLUSTER_SIZE; slot < (c + 1) * CLUSTER_SIZE; ++slot) {
+        if (m_index[slot] >= 0) {
+            const float r = m_radius[slot];
+            if (r == finf()) {
+                cluster.finite = false;
+                return;
+            }
+            lo.x = min(lo.x, m_x[slot] - r);  hi.x = max(hi.x, m_x[slot] + r);
+            lo.y = min(lo.y, m_y[slot] - r);  hi.y = max(hi.y, m_y[slot] + r);
+            lo.z = min(lo.z, m_z[slot] - r);  hi.z = max(hi.z, m_z[slot] + r);
+        }
+    }
+
+    cluster.center = (lo + hi) * 0.5f;
+    cluster.extent = (hi - lo) * 0.5f;
+    m_totalExtent += cluster.extent.sum();
+}
+
+
+void SurfaceCuller::rebuild() {
+    const int n = m_surfaceArray.size();
+    const int numClusters = (n + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    const int numSlots = numClusters * CLUSTER_SIZE;
+
+    // Order the slots along a Morton curve through the bounds of the
+    // finite centers.  Infinite spheres go to the end, so that they
+    // disable as few clusters as possible.
+    Vector3 lo(finf(), finf(), finf());
+    Vector3 hi(-finf(), -finf(), -finf());
+    for (int slot = 0; slot < n; ++slot) {
+        if (m_radius[slot] < finf()) {
+            lo.x = min(lo.x, m_x[slot]);  hi.x = max(hi.x, m_x[slot]);
+            lo.y = min(lo.y, m_y[slot]);  hi.y = max(hi.y, m_y[slot]);
+            lo.z = min(lo.z, m_z[slot]);  hi.z = max(hi.z, m_z[slot]);
+        }
+    }
+
+    Array<CullerMortonKey> key;
+    key.clearAndSetMemoryManager(FrameMemoryManager::current());
+    key.resize(n);
+    const Vector3 scale = Vector3(1023.0f, 1023.0f, 1023.0f) / (hi - lo).max(Vector3(1e-20f, 1e-20f, 1e-20f));
+    for (int slot = 0; slot < n; ++slot) {
+        key[slot].slot = slot;
+        if (m_radius[slot] < finf()) {
+            const Vector3 q = (Point3(m_x[slot], m_y[slot], m_z[slot]) - lo) * scale;
+            key[slot].code =
+                _internal::spreadBits(uint32(q.x)) |
+                (_internal::spreadBits(uint32(q.y)) << 1) |
+                (_internal::spreadBits(uint32(q.z)) << 2);
+        } else {
+            key[slot].code = 0xFFFFFFFF;
+        }
+    }
+    key.sort(SORT_INCREASING);
+
+    // Permute the slots
+    Array<float> x, y, z, radius;
+    Array<int> index;
+    x.resize(numSlots);
+    y.resize(numSlots);
+    z.resize(numSlots);
+    radius.resize(numSlots);
+    index.resize(numSlots);
+    for (int s = 0; s < n; ++s) {
+        const int old = key[s].slot;
+        x[s]      = m_x[old];
+        y[s]      = m_y[old];
+        z[s]      = m_z[old];
+        radius[s] = m_radius[old];
+        index[s]  = m_index[old];
+        m_slot[index[s]] = s;
+    }
+    for (int s = n; s < numSlots; ++s) {
+        // Padding that every plane culls
+        x[s] = y[s] = z[s] = 0;
+        radius[s] = -finf();
+        index[s] = -1;
+    }
+    m_x.swap(x);
+    m_y.swap(y);
+    m_z.swap(z);
+    m_radius.swap(radius);
+    m_index.swap(index);
+
+    m_cluster.resize(numClusters);
+    m_totalExtent = 0;
+    for (int c = 0; c < numClusters; ++c) {
+        m_cluster[c].finite = false;
+        updateCluster(c);
+    }
+    m_builtExtent = m_totalExtent;
+}
+
+
+void SurfaceCuller::update() {
+    const int n = m_surfaceArray.size();
+
+    if (m_needsRebuild) {
+        m_slot.resize(n);
+        m_index.resize(n);
+        m_x.resize(n);
+        m_y.resize(n);
+        m_z.resize(n);
+        m_radius.resize(n);
+        for (int i = 0; i < n; ++i) {
+            m_slot[i]  = i;
+            m_index[i] = i;
+            m_isDirty[i] = false;
+            updateBounds(i);
+        }
+        rebuild();
+        m_needsRebuild = false;
+        return;
+    }
+
+    if (m_dirty.size() == 0) {
+        return;
+    }
+
+    Array<int> dirtyCluster;
+    dirtyCluster.clearAndSetMemoryManager(FrameMemoryManager::current());
+    for (int d = 0; d < m_dirty.size(); ++d) {
+        const int i = m_dirty[d];
+        m_isDirty[i] = false;
+        updateBounds(i);
+        dirtyCluster.append(m_slot[i] / CLUSTER_SIZE);
+    }
+    m_dirty.fastClear();
+
+    // Refit each cluster with a changed member once
+    dirtyCluster.sort();
+    for (int d = 0; d < dirtyCluster.size(); ++d) {
+        if ((d == 0) || (dirtyCluster[d] != dirtyCluster[d - 1])) {
+            updateCluster(dirtyCluster[d]);
+        }
+    }
+
+    if (m_totalExtent > 2 * m_builtExtent) {
+        // Surfaces have moved far enough from their neighbors that
+        // the clusters no longer cull well
+        rebuild();
+    }
+}
+
+
+void SurfaceCuller::cull(const Array<Plane>& clipPlanes, Array<int>& visibleIndex) {
+    update();
+    visibleIndex.fastClear();
+
+    const int numPlanes = clipPlanes.size();
+    Array<CullerPlane> plane;
+    plane.clearAndSetMemoryManager(FrameMemoryManager::current());
+    plane.resize(numPlanes);
+    for (int p = 0; p < numPlanes; ++p) {
+        plane[p] = CullerPlane(clipPlanes[p]);
+    }
+
+#   ifdef G3D_SSE
+        Array<_internal::CullerPlane4> plane4;
+        plane4.clearAndSetMemoryManager(FrameMemoryManager::current());
+        plane4.resize(numPlanes);
+        for (int p = 0; p < numPlanes; ++p) {
+            plane4[p].nx = _mm_set1_ps(plane[p].nx);
+            plane4[p].ny = _mm_set1_ps(plane[p].ny);
+            plane4[p].nz = _mm_set1_ps(plane[p].nz);
+            plane4[p].d  = _mm_set1_ps(plane[p].d);
+        }
+        const __m128 zero = _mm_setzero_ps();
+#   endif
+
+    for (int c = 0; c < m_cluster.size(); ++c) {
+        const Cluster& cluster = m_cluster[c];
+        const int first = c * CLUSTER_SIZE;
+
+        if (cluster.finite) {
+            // Classify the box against each plane.  The slack keeps
+            // rounding in the box test from deciding spheres that the
+            // exact per-sphere test would decide differently.
+            bool outside = false;
+            bool inside = true;
+            for (int p = 0; (p < numPlanes) && ! outside; ++p) {
+                const CullerPlane& P = plane[p];
+                const float dot   = P.nx * cluster.center.x + P.ny * cluster.center.y + P.nz * cluster.center.z;
+                const float dist  = dot - P.d;
+                const float reach = abs(P.nx) * cluster.extent.x + abs(P.ny) * cluster.extent.y + abs(P.nz) * cluster.extent.z;
+                const float slack = 1e-5f * (abs(dot) + abs(P.d) + reach);
+                outside = (dist + reach < -slack);
+                inside  = inside && (dist - reach > slack);
+            }
+
+            if (outside) {
+                continue;
+            }
+
+            if (inside) {
+                for (int slot = first; slot < first + CLUSTER_SIZE; ++slot) {
+                    if (m_index[slot] >= 0) {
+                        visibleIndex.append(m_index[slot]);
+                    }
+                }
+                continue;
+            }
+        }
+
+#       ifdef G3D_SSE
+            for (int slot = first; slot < first + CLUSTER_SIZE; slot += 4) {
+                const __m128 x = _mm_loadu_ps(m_x.getCArray() + slot);
+                const __m128 y = _mm_loadu_ps(m_y.getCArray() + slot);
+                const __m128 z = _mm_loadu_ps(m_z.getCArray() + slot);
+                const __m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(m_radius.getCArray() + slot));
+
+                __m128 culled = _mm_setzero_ps();
+                for (int p = 0; p < numPlanes; ++p) {
+                    const _internal::CullerPlane4& P = plane4[p];
+                    const __m128 dist =
+                        _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(P.nx, x), _mm_mul_ps(P.ny, y)), _mm_mul_ps(P.nz, z)), P.d);
+                    culled = _mm_or_ps(culled, _mm_cmplt_ps(dist, negRadius));
+                }
+
+                int visible = ~_mm_movemask_ps(culled) & 0xF;
+                for (int i = 0; visible != 0; ++i, visible >>= 1) {
+                    // Planes cull the padding, but there may be no planes
+                    if ((visible & 1) && (m_index[slot + i] >= 0)) {
+                        visibleIndex.append(m_index[slot + i]);
+                    }
+                }
+            }
+#       else
+            for (int slot = first; slot < first + CLUSTER_SIZE; ++slot) {
+                bool culled = false;
+                for (int p = 0; (p < numPlanes) && ! culled; ++p) {
+                    const CullerPlane& P = plane[p];
+                    const float dist = P.nx * m_x[slot] + P.ny * m_y[slot] + P.nz * m_z[slot] - P.d;
+                    culled = (dist < -m_radius[slot]);
+                }
+                if (! culled && (m_index[slot] >= 0)) {
+                    visibleIndex.append(m_index[slot]);
+                }
+            }
+#       endif
+    }
+}
+
+
+void SurfaceCuller::cull
+(const GCamera&         camera,
+ const Rect2D&          viewport,
+ Array<Surface::Ref>&   visible) {
+
+    Array<Plane> clipPlanes;
+    clipPlanes.clearAndSetMemoryManager(FrameMemoryManager::current());
+    camera.getClipPlanes(viewport, clipPlanes);
+
+    Array<int> visibleIndex;
+    visibleIndex.clearAndSetMemoryManager(FrameMemoryManager::current());
+    cull(clipPlanes, visibleIndex);
+
+    visible.resize(visibleIndex.size(), DONT_SHRINK_UNDERLYING_ARRAY);
+    for (int i = 0; i < visibleIndex.size(); ++i) {
+        visible[i] = m_surfaceArray[visibleIndex[i]];
+    }
+}
+
+} // namespace G3D
@@ -4,7 +4,7 @@
  \author Morgan McGuire, http://graphics.cs.williams.edu
 
  \created 2001-02-28
- \edited  2012-04-21
+ \edited  2026-10-17
 */
 #include "G3D/Log.h"
 #include "G3D/Any.h"
@@ -14,6 +14,8 @@
 #include "G3D/FileSystem.h"
 #include "G3D/ThreadSet.h"
 #include "G3D/ImageFormat.h"
+#include "G3D/ImageResampler.h"
+#include "G3D/ImagePreprocessor.h"
 #include "G3D/CoordinateFrame.h"
 #include "GLG3D/glcalls.h"
 #include "GLG3D/Texture.h"
@@ -516,16 +518,12 @@ void Texture::generateMipMaps(){
 }
 
 
-/**
- Scales the intensity up or down of an entire image and gamma corrects.
- */
-static void modulateImage(ImageFormat::Code fmt, void* byte, int n, const Color4& brighten, float gamma);
-
 static GLenum dimensionToTarget(Texture::Dimension d);
 
 static void createTexture(
     GLenum          target,
     const uint8*    rawBytes,
+    const ImageFormat* bytesImageFormat,
     GLenum          bytesActualFormat,
     GLenum          bytesFormat,
     int             m_width,
@@ -537,17 +535,14 @@ static void createTexture(
     bool            compressed,
     bool            useNPOT,
     float           rescaleFactor,
-    GLenum          dataType,
-    bool            computeMinMaxMean,
-    Color4&         minval, 
-    Color4&         maxval, 
-    Color4&         meanval);
+    GLenum          dataType);
 
 
 
 static void createMipMapTexture(    
     GLenum          target,
     const uint8*    _bytes,
+    const ImageFormat* bytesImageFormat,
     int             bytesFormat,
     int             bytesBaseFormat,
     int             m_width,
@@ -555,11 +550,7 @@ static void createMipMapTexture(
     GLenum          ImageFormat,
     int             bytesFormatBytesPerPixel,
     float           rescaleFactor,
-    GLenum          bytesType,
-    bool            computeMinMaxMean,
-    Color4&         minval, 
-    Color4&         maxval, 
-    Color4&         meanval);
+    GLenum          bytesType);
 
 
 /////////////////////////////////////////////////////////////////////////////
@@ -1065,9 +1056,6 @@ Texture::Ref Texture::fromMemory(
     const Settings&                     settings,
     const Preprocess&                   preprocess) {
 
-    // For use computing normal maps
-    ImageBuffer::Ref normal;
-
     typedef Array< Array<const void*> > MipArray;
 
     float scaleFactor = preprocess.scaleFactor;
@@ -1086,61 +1074,75 @@ Texture::Ref Texture::fromMemory(
         debugAssertM(depth == 1, "Depth must be 1 for all textures that are not DIM_3D or DIM_3D_NPOT");
     }
 
-    if ((preprocess.modulate != Color4::one()) || (preprocess.gammaAdjust != 1.0f)) {
-        debugAssert((bytesFormat->code == ImageFormat::CODE_RGB8) ||
-                    (bytesFormat->code == ImageFormat::CODE_RGBA8) ||
-                    (bytesFormat->code == ImageFormat::CODE_L8));
+    // Modulate, gamma adjust, compute statistics, and compute the normal
+    // map in a single pass over each image
+    ImagePreprocessor::Settings pixelSettings;
+    pixelSettings.modulate          = preprocess.modulate;
+    pixelSettings.gammaAdjust       = preprocess.gammaAdjust;
+    pixelSettings.computeNormalMap  = preprocess.computeNormalMap;
+    pixelSettings.bumpMapPreprocess = preprocess.bumpMapPreprocess;
+    const bool rewritePixels = pixelSettings.adjustsColor() || pixelSettings.computeNormalMap;
 
-        // Allow brightening to fail silently in release mode
-        if (( bytesFormat->code == ImageFormat::CODE_L8) ||
-            ( bytesFormat->code == ImageFormat::CODE_RGB8) ||
-            ( bytesFormat->code == ImageFormat::CODE_RGBA8)) {
+    // Holds the images that replace the caller's data
+    Array<ImageBuffer::Ref> processed;
 
-            bytesPtr = new MipArray();
-            bytesPtr->resize(_bytes.size());
+    Color4 minval  = Color4::nan();
+    Color4 meanval = Color4::nan();
+    Color4 maxval  = Color4::nan();
 
-            for (int m = 0; m < bytesPtr->size(); ++m) {
-                Array<const void*>& face = (*bytesPtr)[m]; 
-                face.resize(_bytes[m].size());
-            
-                for (int f = 0; f < face.size(); ++f) {
-
-                    int numBytes = iCeil(width * height * depth * bytesFormat->cpuBitsPerPixel / 8.0f);
+    if (preprocess.computeNormalMap) {
+        debugAssertM(bytesFormat->compressed == false, "Cannot compute normal maps from compressed textures");
+        debugAssertM(bytesPtr->size() == 1, "Cannot specify mipmaps when computing normal maps automatically");
+        debugAssertM(depth == 1, "Cannot compute normal maps for 3D textures");
+    }
 
-                    // Allocate space for the converted image
-                    face[f] = System::alignedMalloc(numBytes, 16);
+    if (rewritePixels || preprocess.computeMinMaxMean) {
+        // Allow preprocessing to fail silently in release mode
+        debugAssertM(! rewritePixels || ImagePreprocessor::supports(bytesFormat), 
+                     "Cannot modulate, gamma adjust, or compute normal maps for " + bytesFormat->name() + " textures");
 
-                    // Copy the original data
-                    System::memcpy(const_cast<void*>(face[f]), _bytes[m][f], numBytes);
+        int mipWidth  = width;
+        int mipHeight = height;
+        for (int m = 0; (m < _bytes.size()) && (rewritePixels || (m == 0)); ++m) {
+            // Statistics are of the full-resolution image, over all faces
+            pixelSettings.computeMinMaxMean = preprocess.computeMinMaxMean && (m == 0);
+
+            for (int f = 0; f < _bytes[m].size(); ++f) {
+                ImagePreprocessor::Stats stats;
+                const ImageBuffer::Ref& result =
+                    ImagePreprocessor::apply(_bytes[m][f], mipWidth, mipHeight * depth, bytesFormat, pixelSettings, stats);
+
+                if (pixelSettings.computeMinMaxMean) {
+                    if (f == 0) {
+                        minval  = stats.minval;
+                        maxval  = stats.maxval;
+                        meanval = stats.meanval;
+                    } else {
+                        minval  = minval.min(stats.minval);
+                        maxval  = maxval.max(stats.maxval);
+                        meanval += stats.meanval;
+                    }
+                }
 
-                    // Apply the processing to the copy
-                    modulateImage
-                        (bytesFormat->code,
-                         const_cast<void*>(face[f]),
-                         numBytes,
-                         preprocess.modulate,
-                         preprocess.gammaAdjust);
+                if (result.notNull()) {
+                    if (bytesPtr == &_bytes) {
+                        bytesPtr = new MipArray(_bytes);
+                    }
+                    (*bytesPtr)[m][f] = result->buffer();
+                    processed.append(result);
                 }
             }
+
+            if (pixelSettings.computeMinMaxMean) {
+                meanval /= float(_bytes[m].size());
+            }
+
+            mipWidth  = iMax(1, mipWidth / 2);
+            mipHeight = iMax(1, mipHeight / 2);
         }
     }
 
     if (preprocess.computeNormalMap) {
-        debugAssertM(bytesFormat->redBits == 8 || bytesFormat->luminanceBits == 8, "To preprocess a texture with normal maps, 8-bit channels are required");
-        debugAssertM(bytesFormat->compressed == false, "Cannot compute normal maps from compressed textures");
-        debugAssertM(bytesFormat->floatingPoint == false, "Cannot compute normal maps from floating point textures");
-        debugAssertM(bytesFormat->numComponents == 1 || bytesFormat->numComponents == 3 || bytesFormat->numComponents == 4, "1, 3, or 4 channels needed to compute normal maps");
-        debugAssertM(bytesPtr->size() == 1, "Cannot specify mipmaps when computing normal maps automatically");
-
-        normal = BumpMap::computeNormalMap(width, height, bytesFormat->numComponents, 
-                                 reinterpret_cast<const unorm8*>((*bytesPtr)[0][0]),
-                                 preprocess.bumpMapPreprocess);
-        
-        // Replace the previous array with the data from our normal map
-        bytesPtr = new MipArray();
-        bytesPtr->resize(1);
-        (*bytesPtr)[0].append(normal->buffer());
-        
         bytesFormat = ImageFormat::RGBA8();
 
         if (desiredFormat == ImageFormat::AUTO()) {
@@ -1226,9 +1228,6 @@ Texture::Ref Texture::fromMemory(
 
         int mipWidth = width;
         int mipHeight = height;
-        Color4 minval = Color4::nan();
-        Color4 meanval = Color4::nan();
-        Color4 maxval = Color4::nan();
         for (int mipLevel = 0; mipLevel < numMipMaps; ++mipLevel) {
 
             const int numFaces = (*bytesPtr)[mipLevel].length();
@@ -1250,6 +1249,7 @@ Texture::Ref Texture::fromMemory(
 
                     createMipMapTexture(target, 
                                         reinterpret_cast<const uint8*>((*bytesPtr)[mipLevel][f]),
+                                        bytesFormat,
                                         bytesFormat->openGLFormat,
                                         bytesFormat->openGLBaseFormat,
                                         mipWidth, 
@@ -1257,9 +1257,7 @@ Texture::Ref Texture::fromMemory(
                                         desiredFormat->openGLFormat,
                                         bytesFormat->cpuBitsPerPixel / 8, 
                                         scaleFactor,
-                                        bytesFormat->openGLDataFormat,
-                                        preprocess.computeMinMaxMean,
-                                        minval, maxval, meanval);
+                                        bytesFormat->openGLDataFormat);
                     
                 } else {
 
@@ -1268,6 +1266,7 @@ Texture::Ref Texture::fromMemory(
                     debugAssertGLOk();
                     createTexture(target, 
                                   reinterpret_cast<const uint8*>((*bytesPtr)[mipLevel][f]), 
+                                  bytesFormat,
                                   bytesFormat->openGLFormat, 
                                   bytesFormat->openGLBaseFormat,
                                   mipWidth, 
@@ -1279,9 +1278,7 @@ Texture::Ref Texture::fromMemory(
                                   bytesFormat->compressed, 
                                   useNPOT, 
                                   scaleFactor,
-                                  bytesFormat->openGLDataFormat,
-                                  preprocess.computeMinMaxMean,
-                                  minval, maxval, meanval);
+                                  bytesFormat->openGLDataFormat);
                 }
                 debugAssertGLOk();
 
@@ -1331,19 +1328,7 @@ Texture::Ref Texture::fromMemory(
     t->m_mean   = meanval;
 
     if (bytesPtr != &_bytes) {
-
-        // We must free our own data
-        if (normal.notNull()) {
-            // The normal ImageBuffer is holding the data; do not free it because 
-            // the destructor will do so at the end of the method automatically.
-        } else {
-            for (int m = 0; m < bytesPtr->size(); ++m) {
-                Array<const void*>& face = (*bytesPtr)[m]; 
-                for (int f = 0; f < face.size(); ++f) {
-                    System::alignedFree(const_cast<void*>(face[f]));
-                }
-            }
-        }
+        // The images in processed hold the data
         delete bytesPtr;
         bytesPtr = NULL;
     }
@@ -2163,76 +2148,33 @@ static GLenum dimensionToTarget(Texture::Dimension d) {
 
 
 
-void computeStats
-(const uint8* rawBytes, 
- GLenum       bytesActualFormat, 
- int          width,
- int          height,
- Color4&      minval,
- Color4&      maxval,
- Color4&      meanval) {
-    minval  = Color4::nan();
-    maxval  = Color4::nan();
-    meanval = Color4::nan();
-    if (rawBytes == NULL) {
-        return;
-    }
-
-    float inv255Width = 1.0f / (width * 255);
-    switch (bytesActualFormat) {
-    case GL_RGB8:
-        {
-            Color3unorm8 mn = Color3unorm8::one();
-            Color3unorm8 mx = Color3unorm8::zero();
-            meanval = Color4::zero();
-            // Compute mean along rows to avoid overflow
-            for (int y = 0; y < height; ++y) {
-                const Color3unorm8* ptr = ((const Color3unorm8*)rawBytes) + (y * width);
-                uint32 r = 0, g = 0, b = 0;
-                for (int x = 0; x < width; ++x) {
-                    const Color3unorm8 i = ptr[x];
-                    mn = mn.min(i);
-                    mx = mx.max(i);
-                    r += i.r.bits(); g += i.g.bits(); b += i.b.bits();
-                }
-                meanval += Color4(float(r) * inv255Width, float(g) * inv255Width, float(b) * inv255Width, 1.0);
-            }
-            minval  = Color4(Color3(mn), 1.0f);
-            maxval  = Color4(Color3(mx), 1.0f);
-            meanval /= height;
-        }
-        break;
-
-    case GL_RGBA8:
-        {
-            // TODO: rewrite using SIMD PMAXUB and PMINUB to try and increase performance
-
-            meanval = Color4::zero();
-            Color4unorm8 mn = Color4unorm8::one();
-            Color4unorm8 mx = Color4unorm8::zero();
-            // Compute mean along rows to avoid overflow
-            for (int y = 0; y < height; ++y) {
-                const Color4unorm8* ptr = ((const Color4unorm8*)rawBytes) + (y * width);
-                uint32 r = 0, g = 0, b = 0, a = 0;
-                for (int x = 0; x < width; ++x) {
-                    const Color4unorm8 i = ptr[x];
-                    mn = mn.min(i);
-                    mx = mx.min(i);
-                    r += i.r.bits(); g += i.g.bits(); b += i.b.bits(); a += i.a.bits();
-                }
-                meanval += Color4(float(r) * inv255Width, float(g) * inv255Width, float(b) * inv255Width, float(a) * inv255Width);
-            }
-            minval = mn;
-            maxval = mx;
-            meanval = meanval / height;
-        }
-        break;
+/**
+ Resizes tightly-packed \a src into \a dst on the CPU with
+ ImageResampler, or with gluScaleImage for formats that ImageResampler
+ does not support.
+ */
+static void scaleImage(
+    const ImageFormat*  format,
+    GLenum              glFormat,
+    GLenum              dataType,
+    const uint8*        src,
+    int                 srcWidth,
+    int                 srcHeight,
+    uint8*              dst,
+    int                 dstWidth,
+    int                 dstHeight) {
 
-    default:
-        break;
+    ImageResampler::Settings settings;
+    // The data may be normals or heights rather than colors, so only
+    // formats that declare themselves sRGB are gamma corrected
+    settings.gammaCorrect = false;
+    if (! ImageResampler::resample(src, srcWidth, srcHeight, 0, format, dst, dstWidth, dstHeight, 0, settings)) {
+        // http://www.csee.umbc.edu/help/C++/opengl/man_pages/html/glu/scaleimage.html
+        gluScaleImage(glFormat, srcWidth, srcHeight, dataType, src, dstWidth, dstHeight, dataType, dst);
     }
 }
 
+
 /** 
    @param bytesFormat OpenGL base format.
 
@@ -2244,6 +2186,7 @@ void computeStats
 static void createTexture(
     GLenum          target,
     const uint8*    rawBytes,
+    const ImageFormat* bytesImageFormat,
     GLenum          bytesActualFormat,
     GLenum          bytesFormat,
     int             m_width,
@@ -2255,11 +2198,7 @@ static void createTexture(
     bool            compressed,
     bool            useNPOT,
     float           rescaleFactor,
-    GLenum          dataType,
-    bool            computeMinMaxMean,
-    Color4&         minval, 
-    Color4&         maxval, 
-    Color4&         meanval) {
+    GLenum          dataType) {
 
     uint8* bytes = const_cast<uint8*>(rawBytes);
 
@@ -2267,10 +2206,6 @@ static void createTexture(
     // the function.
     bool   freeBytes = false; 
     int maxSize = GLCaps::maxTextureSize();
-    if (computeMinMaxMean) {
-        computeStats(rawBytes, bytesActualFormat, m_width, m_height, minval, maxval, meanval);
-    }
-
     switch (target) {
     case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
     case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
@@ -2309,16 +2244,7 @@ static void createTexture(
                 freeBytes = true;
 
                 // Rescale the image to a power of 2
-                gluScaleImage(
-                    bytesFormat,
-                    oldWidth,
-                    oldHeight,
-                    dataType,
-                    rawBytes,
-                    m_width,
-                    m_height,
-                    dataType,
-                    bytes);
+                scaleImage(bytesImageFormat, bytesFormat, dataType, rawBytes, oldWidth, oldHeight, bytes, m_width, m_height);
             }
         }
 
@@ -2384,6 +2310,7 @@ static void createTexture(
 static void createMipMapTexture(    
     GLenum          target,
     const uint8*    _bytes,
+    const ImageFormat* bytesImageFormat,
     int             bytesFormat,
     int             bytesBaseFormat,
     int             m_width,
@@ -2391,15 +2318,7 @@ static void createMipMapTexture(
     GLenum          desiredFormat,
     int             bytesFormatBytesPerPixel,
     float           rescaleFactor,
-    GLenum          bytesType,
-    bool            computeMinMaxMean,
-    Color4&         minval, 
-    Color4&         maxval, 
-    Color4&         meanval) {
-
-    if (computeMinMaxMean) {
-        computeStats(_bytes, bytesFormat, m_width, m_height, minval, maxval, meanval);
-    }
+    GLenum          bytesType) {
 
     switch (target) {
     case GL_TEXTURE_2D:
@@ -2423,18 +2342,7 @@ static void createMipMapTexture(
                 freeBytes = true;
 
                 // Rescale the image to a power of 2
-
-                // http://www.csee.umbc.edu/help/C++/opengl/man_pages/html/glu/scaleimage.html
-                gluScaleImage(
-                    bytesBaseFormat,
-                    oldWidth,
-                    oldHeight,
-                    bytesType,
-                    _bytes,
-                    m_width,
-                    m_height,
-                    bytesType,
-                    (void*)bytes);
+                scaleImage(bytesImageFormat, bytesBaseFormat, bytesType, _bytes, oldWidth, oldHeight, const_cast<uint8*>(bytes), m_width, m_height);
             }
 
             alwaysAssertM(false, "CPU MIP-maps were removed in G3D 9.0");
@@ -2455,55 +2363,6 @@ static void createMipMapTexture(
 }
 
 
-static void modulateImage(ImageFormat::Code fmt, void* _byte, int n, const Color4& modulate, float gamma) {
-
-    debugAssert(
-        (fmt == ImageFormat::CODE_RGB8) ||
-        (fmt == ImageFormat::CODE_RGBA8) ||
-        (fmt == ImageFormat::CODE_R8) ||
-        (fmt == ImageFormat::CODE_L8));
-
-    uint8* byte = static_cast<uint8*>(_byte);
-
-    // Make a lookup table
-    uint8 adjust[4][256];
-    for (int c = 0; c < 4; ++c) {
-        for (int i = 0; i < 256; ++i) {
-            float s = pow((i * modulate[c]) / 255.0f, gamma) * 255;
-            adjust[c][i] = iClamp(iRound(s), 0, 255);
-        }
-    }
-
-    switch (fmt) {
-    case ImageFormat::CODE_RGBA8:
-        // 4 channels (we duplicate the loop so that it can be unrolled by the compiler)
-        for (int i = 0; i < n; ) {
-            for (int c = 0; c < 4; ++c, ++i) {
-                byte[i] = adjust[c][byte[i]];
-            }
-        }
-        break;
-
-    case ImageFormat::CODE_RGB8:
-        for (int i = 0; i < n; ) {
-            for (int c = 0; c < 3; ++c, ++i) {
-                byte[i] = adjust[c][byte[i]];
-            }
-        }
-        break;
-
-    case ImageFormat::CODE_R8:
-    case ImageFormat::CODE_L8:
-        for (int i = 0; i < n; ++i) {
-            byte[i] = adjust[0][byte[i]];
-        }
-        break;
-
-    default:;
-    }
-}
-
-
 /////////////////////////////////////////////////////
 Any Texture::Specification::toAny() const {
     Any a = Any(Any::TABLE, "Texture::Specification");
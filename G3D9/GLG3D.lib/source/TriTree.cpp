@@ -4,10 +4,13 @@
   \maintainer Morgan McGuire, http://graphics.cs.williams.edu
 
   \created 2009-06-10
-  \edited  2010-11-20
+  \edited  2026-10-17
 */
 
 #include "G3D/AreaMemoryManager.h"
+#include "G3D/ThreadPool.h"
+#include "G3D/System.h"
+#include "G3D/SSEUtil.h"
 #include "GLG3D/TriTree.h"
 #include "GLG3D/RenderDevice.h"
 #include "GLG3D/Draw.h"
@@ -15,6 +18,155 @@
 
 namespace G3D {
 
+/** Construction state shared by all Nodes of one setContents call.
+
+    The top parallelDepth levels of the tree are split on the calling
+    thread (with data-parallel SAH binning).  Nodes below that with
+    enough Tris are recorded as Subtrees instead of being constructed,
+    and are then built concurrently by the ThreadPool, each into its own
+    AreaMemoryManager so that no allocation is shared between threads. */
+class TriTree::Builder {
+public:
+
+    /** Don't bother building subtrees smaller than this concurrently */
+    enum {MIN_SUBTREE_SIZE = 256};
+
+    class Subtree {
+    public:
+        /** Uninitialized memory allocated by the parent */
+        Node*           node;
+
+        /** Heap copy of the Polys, deleted once the node is built */
+        Array<Poly>*    source;
+
+        int             depth;
+
+        bool operator<(const Subtree& other) const {
+            return source->size() < other.source->size();
+        }
+
+        bool operator>(const Subtree& other) const {
+            return source->size() > other.source->size();
+        }
+    };
+
+    const Settings&                 settings;
+
+    /** Nodes at this depth and below become Subtrees */
+    int                             parallelDepth;
+
+    Array<Subtree>                  subtreeArray;
+
+    /** One per subtree */
+    Array<AreaMemoryManager::Ref>   memoryManager;
+
+    /** Create roughly four subtrees per thread so that the ThreadPool can balance them */
+    Builder(const Settings& settings, int numThreads) : 
+        settings(settings), parallelDepth(iCeil(log2(4.0 * numThreads))) {}
+
+    /** Returns true if \a node will be constructed later by buildSubtree(),
+        in which case \a source has been copied. */
+    bool defer(Node* node, const Array<Poly>& source, int depth) {
+        if ((depth < parallelDepth) || (source.size() < MIN_SUBTREE_SIZE)) {
+            return false;
+        }
+
+        Subtree& subtree = subtreeArray.next();
+        subtree.node   = node;
+        subtree.source = new Array<Poly>();
+        subtree.source->append(source);
+        subtree.depth  = depth;
+        return true;
+    }
+
+    void buildSubtree(int i, int threadID) {
+        (void)threadID;
+        Subtree& subtree = subtreeArray[i];
+
+        // Leave room for the nodes and their tri lists, which grow with the number of splits
+        memoryManager[i] = AreaMemoryManager::create
+            (max(size_t(64 * 1024), subtree.source->size() * (sizeof(Node) + 2 * sizeof(Tri*)) * 4));
+
+        new (subtree.node) Node(*subtree.source, settings, memoryManager[i], NULL, subtree.depth);
+
+        delete subtree.source;
+        subtree.source = NULL;
+    }
+
+    /** Tris whose centroids fall within one slab of the node's bounds,
+        used by Node::chooseSAHSplitLocationBinned. */
+    class Bin {
+    public:
+        int         count;
+        Vector3     low;
+        Vector3     high;
+
+        Bin() : count(0), low(Vector3::inf()), high(-Vector3::inf()) {}
+
+        void insert(const Vector3& lo, const Vector3& hi) {
+            ++count;
+            low  = low.min(lo);
+            high = high.max(hi);
+        }
+
+        void merge(const Bin& other) {
+            count += other.count;
+            low  = low.min(other.low);
+            high = high.max(other.high);
+        }
+
+        float area() const {
+            return (count == 0) ? 0.0f : AABox(low, high).area();
+        }
+    };
+
+    /** Bins Polys by centroid.  Each thread writes its own set of bins. */
+    class Binner : public ThreadPool::Body {
+    public:
+        enum {NUM_BINS = 32};
+
+        const Array<Poly>&  source;
+        const Vector3::Axis axis;
+        const float         low;
+
+        /** Bins per unit distance along axis */
+        const float         scale;
+
+        /** NUM_BINS per thread */
+        Array<Bin>          bin;
+
+        Binner(const Array<Poly>& source, Vector3::Axis axis, float low, float extent, int numThreads) :
+            source(source), axis(axis), low(low), scale(NUM_BINS / extent) {
+            bin.resize(NUM_BINS * numThreads);
+        }
+
+        virtual void run(const Vector2int32& start, const Vector2int32& upTo, int threadID) {
+            Bin* threadBin = bin.getCArray() + threadID * NUM_BINS;
+            for (int i = start.x; i < upTo.x; ++i) {
+                const Poly& poly = source[i];
+                const float centroid = (poly.low()[axis] + poly.high()[axis]) * 0.5f;
+                const int b = iClamp(iFloor((centroid - low) * scale), 0, NUM_BINS - 1);
+                threadBin[b].insert(poly.low(), poly.high());
+            }
+        }
+
+        /** Merge the per-thread bins into the first NUM_BINS */
+        void reduce() {
+            for (int i = NUM_BINS; i < bin.size(); ++i) {
+                bin[i % NUM_BINS].merge(bin[i]);
+            }
+        }
+    };
+
+    /** Builds every deferred Subtree */
+    void run() {
+        // Largest first, so that small subtrees fill in the gaps at the end
+        subtreeArray.sort(SORT_DECREASING);
+        memoryManager.resize(subtreeArray.size());
+        ThreadPool::parallelFor(0, subtreeArray.size(), this, &Builder::buildSubtree);
+    }
+};
+
 
 const char* TriTree::algorithmName(SplitAlgorithm s) {
     const char* n[] = {"Mean extent", "Median area", "Median count", "SAH"};
@@ -67,10 +219,7 @@ void TriTree::setContents(const Array<Surface::Ref>& surfaceArray, ImageStorage
         }
     }
     
-    if (source.size() > 0) {
-        m_memoryManager = AreaMemoryManager::create();
-        m_root = new (m_memoryManager->alloc(sizeof(Node))) Node(source, settings, m_memoryManager);
-    }
+    buildTree(source, settings);
 
     //alwaysAssertM(m_triArray.size() == m_triArray.capacity(), "Allocated too much memory for the Tri Array");
     alwaysAssertM(m_cpuVertexArray.vertex.size() == m_cpuVertexArray.vertex.capacity(), "Allocated too much memory for the vertex array");
@@ -123,7 +272,8 @@ bool TriTree::Node::badSplit(int numOriginalSources, int numLow, int numHigh) {
 }
 
 
-void TriTree::Node::split(Array<Poly>& original, const Settings& settings, const MemoryManager::Ref& mm) {
+void TriTree::Node::split(Array<Poly>& original, const Settings& settings, 
+                          const MemoryManager::Ref& mm, Builder* builder, int depth) {
     // Order in which we'd like to split along axes
     Vector3::Axis preferredAxis[3];
     const Vector3& extent = bounds.extent();
@@ -138,7 +288,20 @@ void TriTree::Node::split(Array<Poly>& original, const Settings& settings, const
         preferredAxis[1] = temp;
     }
     
+    // Each poly lands in at most one of lowArray and highArray and at
+    // most once in spanArray, so allocate all three at once from an
+    // arena instead of growing them.  The arena is private to this
+    // call, so concurrent splits do not contend.
+    const int n = original.size();
+    const MemoryManager::Ref arena = AreaMemoryManager::create(sizeof(Poly) * 3 * n + 256);
     Array<Poly> lowArray, highArray, spanArray;
+    lowArray.clearAndSetMemoryManager(arena);
+    highArray.clearAndSetMemoryManager(arena);
+    spanArray.clearAndSetMemoryManager(arena);
+    lowArray.reserve(n);
+    highArray.reserve(n);
+    spanArray.reserve(n);
+
     for (int i = 0; i < 3; ++i) {
         lowArray.fastClear(); highArray.fastClear(); spanArray.fastClear();
         
@@ -172,8 +335,12 @@ void TriTree::Node::split(Array<Poly>& original, const Settings& settings, const
                           format("Pointer is not a multiple of four bytes: %d", (int)(long)ptr));
             packedChildAxis = reinterpret_cast<uintptr_t>(ptr) | static_cast<uintptr_t>(axis);
 
-            new (ptr) Node(lowArray, settings, mm);
-            new (ptr + 1) Node(highArray, settings, mm);
+            Array<Poly>* childArray[2] = {&lowArray, &highArray};
+            for (int c = 0; c < 2; ++c) {
+                if ((builder == NULL) || ! builder->defer(ptr + c, *childArray[c], depth + 1)) {
+                    new (ptr + c) Node(*childArray[c], settings, mm, builder, depth + 1);
+                }
+            }
             return;
         }
     }
@@ -251,118 +418,95 @@ float TriTree::Node::chooseSAHSplitLocation(Array<Poly>& source, Vector3::Axis a
     if (source.size() <= settings.accurateSAHCountThreshold) {
         return chooseSAHSplitLocationAccurate(source, axis, settings);
     } else {
-        return chooseSAHSplitLocationFast(source, axis, settings);
+        return chooseSAHSplitLocationBinned(source, axis);
     }
 }
 
 
-float TriTree::Node::chooseSAHSplitLocationFast(Array<Poly>& source, Vector3::Axis axis, const Settings& settings) {
-    (void)settings;
-    source.sort(HighComparator(axis));
-
-    // Find the unique splitting candidates in order; only consider high bounds
-    Array<float> splitPosition;
-
-    {
-        splitPosition.append(source[0].high()[axis]);
-        float c = splitPosition.last();
-        for (int i = 1; i < source.size(); ++i) {
-            const float h = source[i].high()[axis];
-            if (h > c) {
-                c = h;
-                splitPosition.append(h);
-            }
-        }
-        // Remove the last; it is the high end of the entire set and
-        // is not eligible as a splitting position.
-        splitPosition.popDiscard();
+float TriTree::Node::chooseSAHSplitLocationBinned(const Array<Poly>& source, Vector3::Axis axis) {
+    // Bin over the node bounds rather than the centroid bounds to
+    // avoid an extra pass over the polys
+    const float low    = bounds.low()[axis];
+    const float extent = bounds.extent()[axis];
+    if (extent <= 0.0f) {
+        return bounds.center()[axis];
     }
 
-    // Find the one-sided cost of each position by a sweep.
-    const int S = splitPosition.size();
-    Array<float> highCost;
-    highCost.resize(S);
+    // Only bin on multiple threads when the work dwarfs the scheduling
+    // overhead.  This is serial within concurrently-built subtrees anyway.
+    const int numThreads = (source.size() >= 16 * 1024) ? ThreadPool::numThreads() : 1;
+    Builder::Binner binner(source, axis, low, extent, numThreads);
+    ThreadPool::parallelFor(binner, 0, source.size(), 2048, numThreads);
+    binner.reduce();
+
+    const int K = Builder::Binner::NUM_BINS;
     const float containingArea = bounds.area();
 
-    // Sweep from above for the high-side cost
+    // Sweep from above for the high-side cost of splitting below each bin
+    float highCost[K];
     {
-        int i = source.size() - 1;
-        Vector3 low  = source[i].low();
-        Vector3 high = source[i].high();
-        --i;
-        // Iterate over splitting planes
-        for (int s = S - 1; s >= 0; --s) {
-            const float h = splitPosition[s];
-            while (source[i].high()[axis] > h) {
-                low  = low.min(source[i].low());
-                high = high.max(source[i].high());
-                --i;
-            }
-            highCost[s] = (source.size() - i) * AABox(low, high).area() / containingArea;
+        Builder::Bin above;
+        for (int b = K - 1; b > 0; --b) {
+            above.merge(binner.bin[b]);
+            highCost[b] = SAHCost(above.count, above.area(), containingArea);
         }
     }
 
-    // Must put at least this many triangles on each side to consider a split
-    const int minTrisPerSide = source.size() / 5;
-
-    // Sweep from below for the low-side cost, tracking the best as we go
-    float lowestCost = inf();
-    float lowestCostPosition = inf();
+    // Sweep from below, tracking the best boundary
+    float lowestCost = finf();
+    int   lowestCostBoundary = -1;
     {
-        int i = 0;
-        Vector3 low  = source[i].low();
-        Vector3 high = source[i].high();
-        ++i;
-        // Iterate over splitting planes
-        for (int s = 0; s < S; ++s) {
-            const float h = splitPosition[s];
-            while (source[i].high()[axis] <= h) {
-                low  = low.min(source[i].low());
-                high = high.max(source[i].high());
-                ++i;
-            }
-            const float lowCost = i * AABox(low, high).area() / containingArea;
-
-            // If there's a index big range within which all costs are
-            // all similar, then prefer splits closer to the median to
-            // keep the tree balanced.  This helps avoid splits that
-            // chop very few points off the end as well
-            const float bias = 0.1f * square(i - source.size() * 0.5f);
-
-            const float avoidSmall = 
-                ((i < minTrisPerSide) || (source.size() - i < minTrisPerSide)) ? 100.0f : 0.0f;
-
-            const float cost = lowCost + highCost[s] + bias + avoidSmall;
-            if (cost < lowestCost) {
-                lowestCost = cost;
-                lowestCostPosition = h;
+        Builder::Bin below;
+        for (int b = 1; b < K; ++b) {
+            below.merge(binner.bin[b - 1]);
+            if ((below.count > 0) && (below.count < source.size())) {
+                const float cost = SAHCost(below.count, below.area(), containingArea) + highCost[b];
+                if (cost < lowestCost) {
+                    lowestCost = cost;
+                    lowestCostBoundary = b;
+                }
             }
         }
     }
 
-    return lowestCostPosition;
+    if (lowestCostBoundary == -1) {
+        // All centroids are in a single bin
+        return bounds.center()[axis];
+    } else {
+        return low + lowestCostBoundary / binner.scale;
+    }
 }
 
 
 float TriTree::Node::chooseSAHSplitLocationAccurate(Array<Poly>& source, Vector3::Axis axis, const Settings& settings) {
     // Get the unique potential split locations
-    
-    Set<float, FloatHashTrait> positionSet;
-    positionSet.clearAndSetMemoryManager(AreaMemoryManager::create(sizeof(float) * 2 * source.size() + 200));
+    Array<float> position;
+    position.resize(source.size() * 2);
     for (int i = 0; i < source.size(); ++i) {
-        positionSet.insert(source[i].low()[axis]);
-        positionSet.insert(source[i].high()[axis]);
+        position[2 * i]     = source[i].low()[axis];
+        position[2 * i + 1] = source[i].high()[axis];
     }
-    
-    Array<float> position;
-    positionSet.getMembers(position);
-    positionSet.clear();
-    
+    position.sort();
+    int numUnique = 1;
+    for (int i = 1; i < position.size(); ++i) {
+        if (position[i] != position[numUnique - 1]) {
+            position[numUnique] = position[i];
+            ++numUnique;
+        }
+    }
+    position.resize(numUnique);
+
+    // Scratch space for SAHCost, reused for every position
+    Array<Poly> lowArray, highArray, spanArray;
+    lowArray.reserve(source.size());
+    highArray.reserve(source.size());
+    spanArray.reserve(source.size());
+
     int lowestCostIndex = 0;
     float lowestCost = inf();
     //debugPrintf("\nChoosing split:\n");
     for (int i = 0; i < position.size(); ++i) {
-        float cost = SAHCost(axis, position[i], source, bounds.area(), settings);
+        float cost = SAHCost(axis, position[i], source, bounds.area(), settings, lowArray, highArray, spanArray);
         //debugPrintf("  pos = %f, cost = %f\n", position[i], cost);
         if (cost < lowestCost) {
             lowestCost = cost;
@@ -386,9 +530,15 @@ float TriTree::Node::SAHCost(int size, float area, float containingArea) {
 }
 
 
-float TriTree::Node::SAHCost(Vector3::Axis axis, float offset, const Array<Poly>& original, float containingArea, const Settings& settings) {
-    // TODO: pass these arrays in for thread-safing
-    static Array<Poly> lowArray, highArray, spanArray;
+float TriTree::Node::SAHCost
+(Vector3::Axis      axis,
+ float              offset,
+ const Array<Poly>& original,
+ float              containingArea,
+ const Settings&    settings,
+ Array<Poly>&       lowArray,
+ Array<Poly>&       highArray,
+ Array<Poly>&       spanArray) {
     
     lowArray.fastClear();
     highArray.fastClear();
@@ -429,7 +579,13 @@ bool __fastcall TriTree::Node::intersectRay
 
     int firstChild = NONE, secondChild = NONE;
     if (! isLeaf()) {
-        computeTraversalOrder(ray, firstChild, secondChild);
+        if (triTree.m_refit) {
+            // The splitting plane no longer separates the children
+            firstChild  = (ray.direction()[axis] < 0.0f) ? 1 : 0;
+            secondChild = 1 - firstChild;
+        } else {
+            computeTraversalOrder(ray, firstChild, secondChild);
+        }
     }
     
     // Test on the side closer to the ray origin.
@@ -468,7 +624,7 @@ bool __fastcall TriTree::Node::intersectRay
     // Test on the side farther from the ray origin.
     if (secondChild != NONE) {
         
-        if (ray.direction()[axis] != 0.0f) {
+        if ((ray.direction()[axis] != 0.0f) && ! triTree.m_refit) {
             // See if there was an intersection before hitting the splitting plane.  
             // If so, there is no need to look on the far side and recursion terminates. 
             // This test makes about a factor of two improvement in performance.
@@ -490,9 +646,10 @@ bool __fastcall TriTree::Node::intersectRay
 }
 
 
-TriTree::Node::Node(Array<Poly>& originals, const Settings& settings, const MemoryManager::Ref& mm) : 
+TriTree::Node::Node(Array<Poly>& originals, const Settings& settings, const MemoryManager::Ref& mm, Builder* builder, int depth) : 
     bounds(Poly::computeBounds(originals)), 
     splitLocation(0),
+    buildCost(0),
     packedChildAxis(NULL),
     valueArray(NULL) {
     
@@ -503,7 +660,7 @@ TriTree::Node::Node(Array<Poly>& originals, const Settings& settings, const Memo
         return;
     }
     
-    split(originals, settings, mm);
+    split(originals, settings, mm, builder, depth);
     
     debugAssert((valueArray == NULL) ||
                 bounds.contains(valueArray->bounds));
@@ -662,7 +819,112 @@ void TriTree::Node::getStats(Stats& s, int level, int valuesPerNode) const {
 }
 
 
-TriTree::TriTree() : m_root(NULL) {}
+float TriTree::Node::cost(float area, float valueArea, const float childArea[2], const float childCost[2]) const {
+    static const float boxIntersectTime = 5;
+
+    if (area <= 0.0f) {
+        return boxIntersectTime;
+    }
+
+    float c = boxIntersectTime;
+    if (valueArray) {
+        c += SAHCost(valueArray->size, valueArea, area);
+    }
+    if (! isLeaf()) {
+        for (int i = 0; i < 2; ++i) {
+            c += childCost[i] * childArea[i] / area;
+        }
+    }
+    return c;
+}
+
+
+float TriTree::Node::refit
+(const CPUVertexArray& vertexArray,
+ bool                  setBuildCost,
+ float                 maxDegradation,
+ Array<Node*>&         degraded,
+ AABox&                newBounds) {
+
+    const int firstDegraded = degraded.size();
+
+    Vector3 lo = Vector3::inf();
+    Vector3 hi = -Vector3::inf();
+
+    float childCost[2] = {0.0f, 0.0f};
+    float childArea[2] = {0.0f, 0.0f};
+    if (! isLeaf()) {
+        for (int i = 0; i < 2; ++i) {
+            AABox b;
+            childCost[i] = child(i).refit(vertexArray, setBuildCost, maxDegradation, degraded, b);
+            childArea[i] = b.area();
+            lo = lo.min(b.low());
+            hi = hi.max(b.high());
+        }
+    }
+
+    AABox valueBounds;
+    if (valueArray) {
+        Vector3 valueLo = Vector3::inf();
+        Vector3 valueHi = -Vector3::inf();
+        for (int i = 0; i < valueArray->size; ++i) {
+            const Tri& tri = *valueArray->data[i];
+            for (int v = 0; v < 3; ++v) {
+                const Point3& P = tri.position(vertexArray, v);
+                valueLo = valueLo.min(P);
+                valueHi = valueHi.max(P);
+            }
+        }
+        valueBounds = AABox(valueLo, valueHi);
+        lo = lo.min(valueLo);
+        hi = hi.max(valueHi);
+    }
+
+    newBounds = AABox(lo, hi);
+    const float c = cost(newBounds.area(), valueBounds.area(), childArea, childCost);
+
+    if (setBuildCost) {
+        // Leave the tighter bounds of the clipped polys in place
+        buildCost = c;
+    } else {
+        bounds = newBounds;
+        if (valueArray) {
+            valueArray->bounds = valueBounds;
+        }
+
+        if (c > buildCost * maxDegradation) {
+            // Rebuilding this subtree replaces any degraded descendants
+            degraded.resize(firstDegraded);
+            degraded.append(this);
+        }
+    }
+    return c;
+}
+
+
+float TriTree::Node::computeBuildCost(const CPUVertexArray& vertexArray) {
+    Array<Node*> ignore;
+    AABox b;
+    return refit(vertexArray, true, 0.0f, ignore, b);
+}
+
+
+void TriTree::Node::getContents(Array<const Tri*>& triArray, Array<Node*>& nodeArray) {
+    nodeArray.append(this);
+    if (valueArray) {
+        for (int i = 0; i < valueArray->size; ++i) {
+            triArray.append(valueArray->data[i]);
+        }
+    }
+    if (! isLeaf()) {
+        for (int i = 0; i < 2; ++i) {
+            child(i).getContents(triArray, nodeArray);
+        }
+    }
+}
+
+
+TriTree::TriTree() : m_buildTime(0), m_numBuildThreads(0), m_refit(false), m_root(NULL) {}
 
 
 TriTree::~TriTree() {
@@ -680,6 +942,19 @@ TriTree::Stats TriTree::stats(int valuesPerNode) const {
         s.shallowestLeaf = 0;
         s.shallowestNodeOverMin = 0;
     }
+
+    s.buildTime           = m_buildTime;
+    s.numBuildThreads     = m_numBuildThreads;
+    s.numParallelSubtrees = m_subtreeMemoryManager.size();
+    if (m_memoryManager.notNull()) {
+        s.nodeBytes = m_memoryManager.downcast<AreaMemoryManager>()->bytesAllocated();
+        for (int i = 0; i < m_subtreeMemoryManager.size(); ++i) {
+            s.nodeBytes += m_subtreeMemoryManager[i]->bytesAllocated();
+        }
+        for (Table<Node*, AreaMemoryManager::Ref>::Iterator it = m_rebuiltMemoryManager.begin(); it.isValid(); ++it) {
+            s.nodeBytes += it->value->bytesAllocated();
+        }
+    }
     return s;
 }
 
@@ -691,7 +966,37 @@ void TriTree::clear() {
         m_root = NULL;
         m_triArray.fastClear();
         m_memoryManager = NULL;
+        m_subtreeMemoryManager.clear();
+        m_rebuiltMemoryManager.clear();
     }
+    m_buildTime = 0;
+    m_numBuildThreads = 0;
+    m_refit = false;
+}
+
+
+void TriTree::buildTree(Array<Poly>& source, const Settings& settings) {
+    if (source.size() == 0) {
+        return;
+    }
+
+    const RealTime start = System::time();
+
+    m_numBuildThreads = ThreadPool::numThreads();
+    Builder builder(settings, m_numBuildThreads);
+
+    m_memoryManager = AreaMemoryManager::create();
+    m_root = new (m_memoryManager->alloc(sizeof(Node))) 
+        Node(source, settings, m_memoryManager, (m_numBuildThreads > 1) ? &builder : NULL, 0);
+
+    builder.run();
+    m_subtreeMemoryManager.swap(builder.memoryManager);
+
+    m_root->computeBuildCost(m_cpuVertexArray);
+    m_settings = settings;
+    m_refit    = false;
+
+    m_buildTime = float(System::time() - start);
 }
 
 
@@ -715,10 +1020,7 @@ void TriTree::setContents(const Array<Tri>& triArray, const CPUVertexArray& vert
         }
     }
     
-    if (source.size() > 0) {
-        m_memoryManager = AreaMemoryManager::create();
-        m_root = new (m_memoryManager->alloc(sizeof(Node))) Node(source, settings, m_memoryManager);
-    }
+    buildTree(source, settings);
 
     alwaysAssertM(m_triArray.size() == m_triArray.capacity(), "Allocated too much memory for the Tri Array");
     alwaysAssertM(m_cpuVertexArray.vertex.size() == m_cpuVertexArray.vertex.capacity(), "Allocated too much memory for the vertex array");
@@ -733,6 +1035,348 @@ void TriTree::draw(RenderDevice* rd, int level, bool showBoxes, int minNodeSize)
 }
 
 
+#ifdef G3D_SSE
+
+class TriTree::RayPacket {
+public:
+    __m128              origin[3];
+    __m128              direction[3];
+    __m128              invDirection[3];
+
+    /** Current closest hit distance for each ray */
+    union {
+        __m128          distance4;
+        float           distance[4];
+    };
+
+    /** Bit i is set while ray i still needs to be traced */
+    int                 activeMask;
+
+    /** 1 if every ray travels in the positive direction along the axis */
+    int                 positive[3];
+
+    const Ray*          ray[4];
+    Tri::Intersector*   intersector[4];
+
+    /** Returns false if the rays are not in the same octant, or any
+        direction component is zero (which would produce NaNs in the
+        slab test). */
+    bool set(const Ray* r, Tri::Intersector* hit, const float* maxDistance) {
+        for (int a = 0; a < 3; ++a) {
+            const float d = r[0].direction()[a];
+            if (d == 0.0f) {
+                return false;
+            }
+            positive[a] = (d > 0.0f) ? 1 : 0;
+            for (int i = 1; i < 4; ++i) {
+                const float e = r[i].direction()[a];
+                if ((e == 0.0f) || ((e > 0.0f) != (d > 0.0f))) {
+                    return false;
+                }
+            }
+
+            origin[a]       = _mm_setr_ps(r[0].origin()[a], r[1].origin()[a], r[2].origin()[a], r[3].origin()[a]);
+            direction[a]    = _mm_setr_ps(r[0].direction()[a], r[1].direction()[a], r[2].direction()[a], r[3].direction()[a]);
+            invDirection[a] = _mm_setr_ps(r[0].invDirection()[a], r[1].invDirection()[a], r[2].invDirection()[a], r[3].invDirection()[a]);
+        }
+
+        for (int i = 0; i < 4; ++i) {
+            ray[i]         = r + i;
+            intersector[i] = hit + i;
+            distance[i]    = maxDistance[i];
+        }
+        activeMask = 0xF;
+        return true;
+    }
+
+    /** Returns a mask of the rays that may hit \a box before their current
+        distance.  Slightly conservative to tolerate roundoff. */
+    int hits(const AABox& box) const {
+        static const __m128 slack = _mm_set1_ps(1.00001f);
+        __m128 tNear = _mm_setzero_ps();
+        __m128 tFar  = _mm_mul_ps(distance4, slack);
+        for (int a = 0; a < 3; ++a) {
+            const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.low()[a]),  origin[a]), invDirection[a]);
+            const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.high()[a]), origin[a]), invDirection[a]);
+            tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+            tFar  = _mm_min_ps(tFar,  _mm_max_ps(t0, t1));
+        }
+        return _mm_movemask_ps(_mm_cmple_ps(tNear, _mm_mul_ps(tFar, slack))) & activeMask;
+    }
+
+    /** Returns a mask of the rays that may hit \a tri before their
+        current distance, using the same formulation as
+        Tri::Intersector::operator() but without backface culling or
+        alpha testing.  The tolerances are looser than those of
+        Tri::Intersector, which makes the final decision for each
+        candidate. */
+    int mayHit(const Vector3& v0, const Vector3& e1, const Vector3& e2) const {
+        const __m128 e1x = _mm_set1_ps(e1.x), e1y = _mm_set1_ps(e1.y), e1z = _mm_set1_ps(e1.z);
+        const __m128 e2x = _mm_set1_ps(e2.x), e2y = _mm_set1_ps(e2.y), e2z = _mm_set1_ps(e2.z);
+        const __m128& dx = direction[0];
+        const __m128& dy = direction[1];
+        const __m128& dz = direction[2];
+
+        // p = direction x e2
+        const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+        const __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        const __m128 f = _mm_div_ps(_mm_set1_ps(1.0f), a);
+
+        // s = origin - v0
+        const __m128 sx = _mm_sub_ps(origin[0], _mm_set1_ps(v0.x));
+        const __m128 sy = _mm_sub_ps(origin[1], _mm_set1_ps(v0.y));
+        const __m128 sz = _mm_sub_ps(origin[2], _mm_set1_ps(v0.z));
+
+        const __m128 u = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)));
+
+        // q = s x e1
+        const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+
+        const __m128 v = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+        const __m128 t = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+
+        // Tri::Intersector grows triangles by 1e-8 / a
+        const __m128 absF   = _mm_max_ps(f, _mm_sub_ps(_mm_setzero_ps(), f));
+        const __m128 margin = _mm_add_ps(_mm_set1_ps(1e-4f), _mm_mul_ps(absF, _mm_set1_ps(1e-8f)));
+        const __m128 negMargin = _mm_sub_ps(_mm_setzero_ps(), margin);
+
+        __m128 ok = _mm_cmpge_ps(u, negMargin);
+        ok = _mm_and_ps(ok, _mm_cmpge_ps(v, negMargin));
+        ok = _mm_and_ps(ok, _mm_cmple_ps(_mm_add_ps(u, v), _mm_add_ps(_mm_set1_ps(1.0f), margin)));
+        ok = _mm_and_ps(ok, _mm_cmpgt_ps(t, _mm_setzero_ps()));
+        ok = _mm_and_ps(ok, _mm_cmplt_ps(t, _mm_mul_ps(distance4, _mm_set1_ps(1.0001f))));
+
+        return _mm_movemask_ps(ok) & activeMask;
+    }
+};
+
+
+void TriTree::intersectPacket(RayPacket& packet, bool exitOnAnyHit, bool twoSided) const {
+    SmallArray<const Node*, 64> stack;
+    stack.push(m_root);
+
+    while ((stack.size() > 0) && (packet.activeMask != 0)) {
+        const Node* node = stack.pop();
+
+        const int mask = packet.hits(node->bounds);
+        if (mask == 0) {
+            continue;
+        }
+
+        if ((mask & (mask - 1)) == 0) {
+            // Only one ray reaches this subtree, so the packet has lost
+            // coherence.  Trace that ray alone.
+            int i = 0;
+            while ((mask & (1 << i)) == 0) {
+                ++i;
+            }
+            if (node->intersectRay(*this, *packet.ray[i], *packet.intersector[i], packet.distance[i], exitOnAnyHit, twoSided) &&
+                exitOnAnyHit) {
+                packet.activeMask &= ~(1 << i);
+            }
+            continue;
+        }
+
+        const ValueArray* values = node->valueArray;
+        if ((values != NULL) && (values->size > 0) && (packet.hits(values->bounds) != 0)) {
+            for (int v = 0; (v < values->size) && (packet.activeMask != 0); ++v) {
+                const Tri& tri = *values->data[v];
+                const Vector3& v0 = tri.vertex(m_cpuVertexArray, 0).position;
+                const int candidates = packet.mayHit(v0,
+                                                     tri.vertex(m_cpuVertexArray, 1).position - v0,
+                                                     tri.vertex(m_cpuVertexArray, 2).position - v0);
+                if (candidates == 0) {
+                    continue;
+                }
+
+                // Let the Intersector make the exact decision so that
+                // results match intersectRay
+                for (int i = 0; i < 4; ++i) {
+                    if ((candidates & (1 << i)) != 0) {
+                        Tri::Intersector& intersector = *packet.intersector[i];
+                        if (intersector(*packet.ray[i], m_cpuVertexArray, tri, twoSided, packet.distance[i])) {
+                            intersector.primitiveIndex = int(values->data[v] - m_triArray.getCArray());
+                            if (exitOnAnyHit) {
+                                packet.activeMask &= ~(1 << i);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        if (! node->isLeaf()) {
+            // Push the far child first so that the near one is visited
+            // first and shrinks the distances
+            const int nearChild = packet.positive[node->splitAxis()] ? 0 : 1;
+            stack.push(&node->child(1 - nearChild));
+            stack.push(&node->child(nearChild));
+        }
+    }
+}
+
+#else
+
+void TriTree::intersectPacket(RayPacket& packet, bool exitOnAnyHit, bool twoSided) const {
+    (void)packet;
+    (void)exitOnAnyHit;
+    (void)twoSided;
+    alwaysAssertM(false, "Ray packets require SSE");
+}
+
+#endif
+
+
+void TriTree::intersectRays
+(const Array<Ray>&          rayArray,
+ Array<Tri::Intersector>&   results,
+ Array<float>&              distance,
+ bool                       exitOnAnyHit,
+ bool                       twoSided) const {
+
+    alwaysAssertM(distance.size() == rayArray.size(), "distance must have one element per ray");
+    if (results.size() != rayArray.size()) {
+        results.resize(rayArray.size());
+    }
+
+    if (m_root == NULL) {
+        return;
+    }
+
+    int i = 0;
+
+#   ifdef G3D_SSE
+        RayPacket packet;
+        for (; i + 4 <= rayArray.size(); i += 4) {
+            if (packet.set(rayArray.getCArray() + i, results.getCArray() + i, distance.getCArray() + i)) {
+                intersectPacket(packet, exitOnAnyHit, twoSided);
+                for (int j = 0; j < 4; ++j) {
+                    distance[i + j] = packet.distance[j];
+                }
+            } else {
+                // Incoherent packet
+                for (int j = i; j < i + 4; ++j) {
+                    intersectRay(rayArray[j], results[j], distance[j], exitOnAnyHit, twoSided);
+                }
+            }
+        }
+#   endif
+
+    for (; i < rayArray.size(); ++i) {
+        intersectRay(rayArray[i], results[i], distance[i], exitOnAnyHit, twoSided);
+    }
+}
+
+
+void TriTree::intersectRays
+(const Array<Ray>&          rayArray,
+ Array<Tri::Intersector>&   results,
+ bool                       exitOnAnyHit,
+ bool                       twoSided) const {
+
+    Array<float> distance;
+    distance.resize(rayArray.size());
+    for (int i = 0; i < distance.size(); ++i) {
+        distance[i] = finf();
+    }
+    intersectRays(rayArray, results, distance, exitOnAnyHit, twoSided);
+}
+
+
+void TriTree::rebuild(Node* node) {
+    static const float epsilon = 0.000001f;
+
+    Array<const Tri*> triArray;
+    Array<Node*>      nodeArray;
+    node->getContents(triArray, nodeArray);
+
+    // Tris that were clipped into several nodes appear several times
+    triArray.sort();
+    Array<Poly> source;
+    for (int i = 0; i < triArray.size(); ++i) {
+        if (((i == 0) || (triArray[i] != triArray[i - 1])) && (triArray[i]->area() > epsilon)) {
+            source.append(Poly(m_cpuVertexArray, triArray[i]));
+        }
+    }
+
+    if (source.size() == 0) {
+        // Every Tri is degenerate; keep the refit subtree
+        return;
+    }
+
+    if (node == m_root) {
+        // Replace the entire tree
+        m_root = NULL;
+        m_memoryManager = NULL;
+        m_subtreeMemoryManager.clear();
+        m_rebuiltMemoryManager.clear();
+        buildTree(source, m_settings);
+        return;
+    }
+
+    // Hold the memory of previously rebuilt subtrees within this one
+    // until we're done reading it, and then release it
+    Array<AreaMemoryManager::Ref> oldMemoryManager;
+    for (int i = 0; i < nodeArray.size(); ++i) {
+        AreaMemoryManager::Ref m;
+        Node* key = NULL;
+        if (m_rebuiltMemoryManager.getRemove(nodeArray[i], key, m)) {
+            oldMemoryManager.append(m);
+        }
+    }
+
+    const AreaMemoryManager::Ref mm = AreaMemoryManager::create
+        (max(size_t(4 * 1024), source.size() * (sizeof(Node) + 2 * sizeof(Tri*)) * 4));
+    new (node) Node(source, m_settings, mm);
+    node->computeBuildCost(m_cpuVertexArray);
+    m_rebuiltMemoryManager.set(node, mm);
+}
+
+
+int TriTree::refit(const CPUVertexArray& vertexArray, float maxDegradation) {
+    alwaysAssertM(vertexArray.size() == m_cpuVertexArray.size(), 
+                  "refit() requires the vertices that the tree was built from");
+
+    m_cpuVertexArray.copyFrom(vertexArray);
+    for (int t = 0; t < m_triArray.size(); ++t) {
+        Tri& tri = m_triArray[t];
+        const float a = tri.e1(m_cpuVertexArray).cross(tri.e2(m_cpuVertexArray)).length() * 0.5f;
+        // Preserve the twoSided flag in the sign bit
+        tri.m_area = (tri.m_area < 0.0f) ? -a : a;
+    }
+
+    if (m_root == NULL) {
+        return 0;
+    }
+
+    m_refit = true;
+
+    Array<Node*> degraded;
+    AABox bounds;
+    m_root->refit(m_cpuVertexArray, false, maxDegradation, degraded, bounds);
+    for (int i = 0; i < degraded.size(); ++i) {
+        rebuild(degraded[i]);
+    }
+
+    return degraded.size();
+}
+
+
+int TriTree::refit(const Array<Surface::Ref>& surfaceArray, float maxDegradation) {
+    CPUVertexArray vertexArray;
+    Array<Tri>     triArray;
+    Surface::getTris(surfaceArray, vertexArray, triArray);
+    alwaysAssertM(triArray.size() == m_triArray.size(), 
+                  "refit() requires the surfaces that the tree was built from");
+    return refit(vertexArray, maxDegradation);
+}
+
+
 bool TriTree::intersectRay
 (const Ray&            ray,
  Tri::Intersector&    intersectCallback, 
@@ -0,0 +1,61 @@
+/**
+  \file test/BoundsSurface.h
+
+  Shared by the culling tests.
+
+  \created 2026-10-17
+  \edited  2026-10-17
+*/
+#ifndef BoundsSurface_h
+#define BoundsSurface_h
+
+#include "G3D/G3DAll.h"
+#include "GLG3D/GLG3D.h"
+
+/** Surface with only a pose and bounds, for culling without OpenGL.
+    The box and sphere bound each other. */
+class BoundsSurface : public Surface {
+public:
+    typedef ReferenceCountedPointer<BoundsSurface> Ref;
+
+    CFrame      cframe;
+    AABox       box;
+    Sphere      sphere;
+
+    BoundsSurface(const CFrame& c, const Sphere& s) : cframe(c), sphere(s) {
+        s.getBounds(box);
+    }
+
+    BoundsSurface(const CFrame& c, const AABox& b) : cframe(c), box(b) {
+        b.getBounds(sphere);
+    }
+
+    virtual std::string name() const {
+        return "BoundsSurface";
+    }
+
+    virtual void getCoordinateFrame(CoordinateFrame& c, bool previous = false) const {
+        (void)previous;
+        c = cframe;
+    }
+
+    virtual void getObjectSpaceBoundingBox(AABox& b, bool previous = false) const {
+        (void)previous;
+        b = box;
+    }
+
+    virtual void getObjectSpaceBoundingSphere(Sphere& s, bool previous = false) const {
+        (void)previous;
+        s = sphere;
+    }
+
+    virtual void sendGeometry(RenderDevice* rd) const {
+        (void)rd;
+    }
+
+    virtual void defaultRender(RenderDevice* rd) const {
+        (void)rd;
+    }
+};
+
+#endif
@@ -37,6 +37,12 @@ using G3D::uint8;
 
 // Forward declarations
 void testImageConvert();
+void perfImageConvert();
+
+void testImageResampler();
+void perfImageResampler();
+void testImagePreprocessor();
+void perfImagePreprocessor();
 
 void perfArray();
 void testArray();
@@ -45,6 +51,7 @@ void testSmallArray();
 void testMatrix();
 
 void testFileSystem();
+void perfFileSystem();
 
 void testMatrix3();
 void perfMatrix3();
@@ -95,6 +102,12 @@ void testQuat();
 void perfKDTree();
 void testKDTree();
 
+void perfPointKDTree();
+void testPointKDTree();
+
+void perfTriTree();
+void testTriTree();
+
 void testSphere();
 
 void testAABox();
@@ -107,7 +120,11 @@ void testSystemMemcpy();
 void perfSystemMemset();
 void testSystemMemset();
 
+void perfSystemMalloc();
+void testSystemMalloc();
+
 void testMap2D();
+void perfMap2D();
 
 void testReferenceCount();
 
@@ -132,12 +149,46 @@ void testAdjacency();
 
 void perfTable();
 
+void testFlatTable();
+
 void testAtomicInt32();
 
 void testCoordinateFrame();
 
 void testGThread();
 
+void testThreadPool();
+void perfThreadPool();
+
+void testZoneProfiler();
+void perfZoneProfiler();
+
+void testFrameMemoryManager();
+
+void testParseOBJ();
+void perfParseOBJ();
+
+void testParsePLY();
+void perfParsePLY();
+void testWelder();
+void perfWelder();
+
+void perfArticulatedModel();
+
+void testSurfaceCuller();
+void perfSurfaceCuller();
+void testOcclusionCuller();
+void perfOcclusionCuller();
+
+void testRadixSort();
+void perfRadixSort();
+
+void testLog();
+void perfLog();
+
+void testCrypto();
+void perfCrypto();
+
 void testfilter();
 
 void testAny();
@@ -690,6 +741,7 @@ int main(int argc, char* argv[]) {
 
         perfSystemMemcpy();
         perfSystemMemset();
+        perfSystemMalloc();
 
         // Pause so that we can see the values in the debugger
    //     getch();
@@ -700,12 +752,18 @@ int main(int argc, char* argv[]) {
 
         perfBinaryIO();
 
+        perfFileSystem();
+
         perfTable();
 
         perfHashTrait();
 
         perfKDTree();
 
+        perfPointKDTree();
+
+        perfTriTree();
+
         perfCollisionDetection();
 
         perfQueue();
@@ -716,6 +774,32 @@ int main(int argc, char* argv[]) {
 
         perfPointHashGrid();
 
+        perfThreadPool();
+
+        perfZoneProfiler();
+
+        perfParseOBJ();
+
+        perfParsePLY();
+
+        perfWelder();
+
+        perfSurfaceCuller();
+        perfOcclusionCuller();
+
+        perfRadixSort();
+
+        perfLog();
+
+        perfCrypto();
+
+        perfImageConvert();
+
+        perfImageResampler();
+        perfImagePreprocessor();
+
+        perfMap2D();
+
         measureNormalizationPerformance();
 
         OSWindow::Settings settings;
@@ -739,6 +823,8 @@ int main(int argc, char* argv[]) {
 
         measureRDPushPopPerformance(renderDevice);
 
+        perfArticulatedModel();
+
 #       ifdef G3D_WIN32
             // Pause so that we can see the values in the debugger
 //	        getch();
@@ -775,8 +861,15 @@ int main(int argc, char* argv[]) {
 
     testImageConvert();
 
+    testImageResampler();
+    testImagePreprocessor();
+
     testKDTree();
 
+    testPointKDTree();
+
+    testTriTree();
+
     testLineSegment2D();
 
     testGLight();
@@ -800,6 +893,8 @@ int main(int argc, char* argv[]) {
 
     testTableTable();  
 
+    testFlatTable();
+
     testCoordinateFrame();
 
     testQuat();
@@ -809,6 +904,26 @@ int main(int argc, char* argv[]) {
     testAtomicInt32();
 
     testGThread();
+
+    testThreadPool();
+
+    testZoneProfiler();
+    testFrameMemoryManager();
+
+    testParseOBJ();
+
+    testParsePLY();
+
+    testWelder();
+
+    testSurfaceCuller();
+    testOcclusionCuller();
+
+    testRadixSort();
+
+    testLog();
+
+    testCrypto();
     
     testWeakCache();
     
@@ -816,6 +931,8 @@ int main(int argc, char* argv[]) {
 
     testSystemMemcpy();
 
+    testSystemMalloc();
+
     testuint128();
 
     testQueue();
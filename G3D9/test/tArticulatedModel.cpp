@@ -0,0 +1,110 @@
+#include "G3D/G3DAll.h"
+using G3D::uint8;
+using G3D::uint32;
+using G3D::uint64;
+
+namespace {
+
+/** True if the parts, vertices, and indices of the two models are identical */
+bool sameGeometry(const ArticulatedModel::Ref& a, const ArticulatedModel::Ref& b) {
+
+    class GatherCallback : public ArticulatedModel::PartCallback {
+    public:
+        Array<ArticulatedModel::Part*> part;
+
+        void operator()(ArticulatedModel::Part* p, const CFrame& worldToPartFrame, ArticulatedModel::Ref model, const int treeDepth) {
+            (void)worldToPartFrame; (void)model; (void)treeDepth;
+            part.append(p);
+        }
+    } pa, pb;
+
+    a->forEachPart(pa);
+    b->forEachPart(pb);
+    if (pa.part.size() != pb.part.size()) {
+        return false;
+    }
+
+    for (int p = 0; p < pa.part.size(); ++p) {
+        const ArticulatedModel::Part* x = pa.part[p];
+        const ArticulatedModel::Part* y = pb.part[p];
+        if ((x->name != y->name) || (x->id != y->id) || (x->cframe != y->cframe) ||
+            (x->cpuVertexArray.size() != y->cpuVertexArray.size()) ||
+            (x->meshArray().size() != y->meshArray().size()) ||
+            (memcmp(x->cpuVertexArray.vertex.getCArray(), y->cpuVertexArray.vertex.getCArray(),
+                    sizeof(CPUVertexArray::Vertex) * x->cpuVertexArray.size()) != 0)) {
+            return false;
+        }
+
+        for (int m = 0; m < x->meshArray().size(); ++m) {
+            const ArticulatedModel::Mesh* u = x->meshArray()[m];
+            const ArticulatedModel::Mesh* v = y->meshArray()[m];
+            if ((u->name != v->name) || (u->id != v->id) || (u->twoSided != v->twoSided) ||
+                (u->material.isNull() != v->material.isNull()) ||
+                (u->cpuIndexArray.size() != v->cpuIndexArray.size()) ||
+                (memcmp(u->cpuIndexArray.getCArray(), v->cpuIndexArray.getCArray(), sizeof(int) * u->cpuIndexArray.size()) != 0)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+void removeCacheFiles(const std::string& filename) {
+    std::string base = filename;
+    std::string zipfile;
+    if (FileSystem::inZipfile(base, zipfile)) {
+        base = zipfile + "." + FilePath::baseExt(base);
+    }
+
+    Array<std::string> cacheFile;
+    FileSystem::getFiles(base + ".*.amcache", cacheFile, true);
+    for (int i = 0; i < cacheFile.size(); ++i) {
+        FileSystem::removeFile(cacheFile[i]);
+    }
+}
+
+} // namespace
+
+
+/** Requires an OpenGL context for the materials */
+void perfArticulatedModel() {
+    printf("ArticulatedModel cache performance:\n");
+
+    const char* model[] = {"teapot/teapot.obj", "crate/crate.obj", "ifs/p51-mustang.ifs", 
+                           "3ds/spaceFighter01/spaceFighter01.3ds", "3ds/postsparkasse/furniture.3DS",
+                           "models/dabrovic_sibenik/sibenik.zip/sibenik.obj"};
+    for (int m = 0; m < 6; ++m) {
+        ArticulatedModel::Specification spec;
+        spec.filename = System::findDataFile(model[m], false);
+        if (spec.filename.empty()) {
+            continue;
+        }
+        removeCacheFiles(spec.filename);
+
+        Stopwatch timer;
+        timer.tick();
+        const ArticulatedModel::Ref& cold = ArticulatedModel::create(spec);
+        timer.tock();
+        const RealTime coldTime = timer.elapsedTime();
+
+        // The first cached load writes the cache and the second reads it
+        spec.useCache = true;
+        timer.tick();
+        ArticulatedModel::create(spec);
+        timer.tock();
+        const RealTime writeTime = timer.elapsedTime();
+
+        timer.tick();
+        const ArticulatedModel::Ref& cached = ArticulatedModel::create(spec);
+        timer.tock();
+        const RealTime cachedTime = timer.elapsedTime();
+
+        alwaysAssertM(sameGeometry(cold, cached), std::string("Cached ArticulatedModel differs for ") + model[m]);
+        removeCacheFiles(spec.filename);
+
+        printf("  %-22s cold %7.3f s   writing cache %7.3f s   cached %7.3f s\n",
+               FilePath::baseExt(spec.filename).c_str(), coldTime, writeTime, cachedTime);
+    }
+    printf("\n");
+}
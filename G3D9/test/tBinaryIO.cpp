@@ -169,6 +169,152 @@ static void testCompression() {
 }
 
 
+/** Files large enough to be memory-mapped, in both byte orders */
+static void testMappedBinaryIO() {
+    printf("BinaryInput memory-mapped files\n");
+    const int N = (int)(BinaryInput::MIN_MAPPED_LENGTH / sizeof(float32)) + 1000;
+
+    for (int e = 0; e < 2; ++e) {
+        const G3DEndian endian = (e == 0) ? G3D_LITTLE_ENDIAN : G3D_BIG_ENDIAN;
+        const bool swap = (endian != System::machineEndian());
+
+        {
+            BinaryOutput b("mapped.bin", endian);
+            b.writeUInt32(N);
+            for (int i = 0; i < N; ++i) {
+                b.writeFloat32(i * 0.5f);
+            }
+            b.writeUInt16(7);
+            b.commit();
+        }
+
+        Array<float32> scratch;
+        {
+            BinaryInput b("mapped.bin", endian);
+            debugAssert(b.isMemoryMapped());
+            debugAssert(b.getLength() == 4 + N * 4 + 2);
+
+            const int n = b.readUInt32();
+            debugAssert(n == N);
+            const int64 pos = b.getPosition();
+            const float32* f = b.viewFloat32(n, scratch);
+            debugAssert(b.getPosition() == pos + n * 4);
+            if (swap) {
+                debugAssert(f == scratch.getCArray());
+            } else {
+                // Zero-copy
+                debugAssert((const uint8*)f == b.getCArray() + pos);
+                debugAssert(scratch.size() == 0);
+            }
+            for (int i = 0; i < n; ++i) {
+                debugAssert(f[i] == i * 0.5f);
+            }
+            const uint16 tail = b.readUInt16();
+            debugAssert(tail == 7); (void)tail;
+            debugAssert(! b.hasMore());
+
+            // Random access
+            b.setPosition(4 + 1000 * 4);
+            const float32 x = b.readFloat32();
+            debugAssert(x == 500.0f); (void)x;
+        }
+
+        {
+            BinaryInput b("mapped.bin", endian, false, MemoryMappedFile::RANDOM_ACCESS);
+            b.skip(4);
+            Array<float32> a;
+            b.readFloat32(a, N);
+            for (int i = 0; i < N; ++i) {
+                debugAssert(a[i] == i * 0.5f);
+            }
+        }
+    }
+
+    {
+        // Compressed files are inflated from the mapping
+        BinaryOutput b("mapped.bin", G3D_LITTLE_ENDIAN);
+        Random r(3);
+        for (int i = 0; i < N; ++i) {
+            b.writeInt32(r.bits());
+        }
+        b.compress();
+        b.commit();
+        debugAssert(FileSystem::size("mapped.bin") >= BinaryInput::MIN_MAPPED_LENGTH);
+
+        BinaryInput in("mapped.bin", G3D_LITTLE_ENDIAN, true);
+        debugAssert(! in.isMemoryMapped());
+        Random r2(3);
+        for (int i = 0; i < N; ++i) {
+            const int32 x = in.readInt32();
+            debugAssert(x == (int32)r2.bits()); (void)x;
+        }
+    }
+
+    FileSystem::removeFile("mapped.bin");
+}
+
+
+/** Time to open a large file and sum its contents */
+static void measureLargeFileRead() {
+    const int N = 16 * 1024 * 1024;
+    {
+        BinaryOutput b("perf.bin", G3D_LITTLE_ENDIAN);
+        for (int i = 0; i < N; ++i) {
+            b.writeFloat32(1.0f);
+        }
+        b.commit();
+    }
+
+    Stopwatch timer;
+    float sum = 0;
+
+    timer.tick();
+    {
+        Array<float32> buffer;
+        buffer.resize(N);
+        FILE* file = FileSystem::fopen("perf.bin", "rb");
+        fread(buffer.getCArray(), sizeof(float32), N, file);
+        FileSystem::fclose(file);
+        for (int i = 0; i < N; ++i) {
+            sum += buffer[i];
+        }
+    }
+    timer.tock();
+    const RealTime freadTime = timer.elapsedTime();
+
+    timer.tick();
+    {
+        BinaryInput b("perf.bin", G3D_LITTLE_ENDIAN);
+        Array<float32> a;
+        b.readFloat32(a, N);
+        for (int i = 0; i < N; ++i) {
+            sum += a[i];
+        }
+    }
+    timer.tock();
+    const RealTime readTime = timer.elapsedTime();
+
+    timer.tick();
+    {
+        BinaryInput b("perf.bin", G3D_LITTLE_ENDIAN);
+        Array<float32> scratch;
+        const float32* f = b.viewFloat32(N, scratch);
+        for (int i = 0; i < N; ++i) {
+            sum += f[i];
+        }
+    }
+    timer.tock();
+    const RealTime viewTime = timer.elapsedTime();
+
+    printf("Open and sum 64 MB of float32 (%g):\n", sum);
+    printf("  fread into Array:               %6.1f ms\n", freadTime * 1000);
+    printf("  BinaryInput::readFloat32(Array): %6.1f ms\n", readTime * 1000);
+    printf("  BinaryInput::viewFloat32:        %6.1f ms\n\n", viewTime * 1000);
+
+    FileSystem::removeFile("perf.bin");
+}
+
+
 static void measureSerializerPerformance() {
     Array<uint8> x;
     x.resize(1024);
@@ -241,6 +387,7 @@ static void measureOverhead() {
 void perfBinaryIO() {
     measureOverhead();
     measureSerializerPerformance();
+    measureLargeFileRead();
 }
 
 
@@ -391,4 +538,5 @@ void testBinaryIO() {
     testBasicSerialization();
     testBitSerialization();
     testCompression();
+    testMappedBinaryIO();
 }
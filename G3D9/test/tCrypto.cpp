@@ -0,0 +1,204 @@
+#include "G3D/G3DAll.h"
+
+namespace {
+
+/** Bit-at-a-time CRC with a reversed polynomial, for checking the fast paths */
+uint32 referenceCRC(uint32 polynomial, const uint8* p, size_t n) {
+    uint32 crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < n; ++i) {
+        crc ^= p[i];
+        for (int b = 0; b < 8; ++b) {
+            crc = (crc & 1) ? ((crc >> 1) ^ polynomial) : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
+
+
+void makeData(Array<uint8>& data, int n, int seed) {
+    Random rnd(seed, false);
+    data.resize(n);
+    for (int i = 0; i < n; ++i) {
+        data[i] = uint8(rnd.bits());
+    }
+}
+
+
+void testCRC() {
+    const char* check = "123456789";
+    debugAssert(Crypto::crc32(check, 9) == 0xCBF43926);
+    debugAssert(Crypto::crc32c(check, 9) == 0xE3069283);
+    debugAssert(Crypto::crc32(check, 0) == 0);
+    debugAssert(Crypto::crc32c(check, 0) == 0);
+    (void)check;
+
+    Array<uint8> data;
+    makeData(data, 5000, 1);
+    const uint8* p = data.getCArray();
+
+    // Every alignment and the lengths around the SIMD block sizes
+    for (int offset = 0; offset < 16; ++offset) {
+        for (int n = 0; n < 300; ++n) {
+            debugAssert(Crypto::crc32(p + offset, n) == referenceCRC(0xEDB88320, p + offset, n));
+            debugAssert(Crypto::crc32c(p + offset, n) == referenceCRC(0x82F63B78, p + offset, n));
+        }
+    }
+    debugAssert(Crypto::crc32(p + 3, 4997) == referenceCRC(0xEDB88320, p + 3, 4997));
+    debugAssert(Crypto::crc32c(p + 3, 4997) == referenceCRC(0x82F63B78, p + 3, 4997));
+
+    // Incremental and combined
+    const uint32 whole32  = Crypto::crc32(p, 5000);
+    const uint32 whole32c = Crypto::crc32c(p, 5000);
+    for (int split = 0; split <= 5000; split += 397) {
+        debugAssert(Crypto::crc32(p + split, 5000 - split, Crypto::crc32(p, split)) == whole32);
+        debugAssert(Crypto::crc32c(p + split, 5000 - split, Crypto::crc32c(p, split)) == whole32c);
+        debugAssert(Crypto::crc32Combine(Crypto::crc32(p, split), Crypto::crc32(p + split, 5000 - split), 5000 - split) == whole32);
+        debugAssert(Crypto::crc32cCombine(Crypto::crc32c(p, split), Crypto::crc32c(p + split, 5000 - split), 5000 - split) == whole32c);
+    }
+    (void)whole32;
+    (void)whole32c;
+}
+
+
+void testHash128() {
+    debugAssert(Crypto::hash128(NULL, 0) == Hash128(0, 0));
+
+    Array<uint8> data;
+    makeData(data, 1000, 2);
+    uint8* p = data.getCArray();
+
+    Set<uint64> seen;
+    for (int n = 1; n <= 100; ++n) {
+        const Hash128 h = Crypto::hash128(p, n);
+        debugAssert(h == Crypto::hash128(p, n));
+        debugAssert(Crypto::hash64(p, n) == h.value[0]);
+        debugAssert(Crypto::hash128(p, n, 1) != h);
+        seen.insert(h.value[0]);
+        seen.insert(h.value[1]);
+    }
+    debugAssert(seen.size() == 200);
+
+    // Flipping any bit changes about half of the output bits
+    const Hash128 original = Crypto::hash128(p, 1000);
+    int totalChanged = 0;
+    for (int bit = 0; bit < 8 * 1000; bit += 7) {
+        p[bit / 8] ^= uint8(1 << (bit & 7));
+        const Hash128 h = Crypto::hash128(p, 1000);
+        p[bit / 8] ^= uint8(1 << (bit & 7));
+
+        int changed = 0;
+        for (int w = 0; w < 2; ++w) {
+            uint64 x = h.value[w] ^ original.value[w];
+            while (x != 0) {
+                changed += int(x & 1);
+                x >>= 1;
+            }
+        }
+        debugAssert(changed > 20);
+        totalChanged += changed;
+    }
+    debugAssertM(abs(totalChanged / (8 * 1000 / 7 + 1) - 64) < 4, "Poor avalanche");
+    (void)totalChanged;
+
+    // Serialization
+    BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+    original.serialize(b);
+    BinaryInput bi(b.getCArray(), b.length(), G3D_LITTLE_ENDIAN);
+    debugAssert(Hash128(bi) == original);
+    debugAssert(original.toString().size() == 32);
+}
+
+
+void testParallel() {
+    const int n = Crypto::HASH_CHUNK_SIZE * 5 + 12345;
+    Array<uint8> data;
+    makeData(data, n, 3);
+    const uint8* p = data.getCArray();
+
+    const uint32 crc  = Crypto::crc32(p, n);
+    const uint32 crcc = Crypto::crc32c(p, n);
+    const Hash128 h   = Crypto::parallelHash128(p, n);
+
+    debugAssert(Crypto::parallelCRC32(p, n) == crc);
+    debugAssert(Crypto::parallelCRC32C(p, n) == crcc);
+    debugAssert(Crypto::parallelCRC32(p, n, 1) == crc);
+    debugAssert(Crypto::parallelHash128(p, n, 1) == h);
+    debugAssert(h != Crypto::hash128(p, n));
+
+    // Small inputs are a single chunk
+    debugAssert(Crypto::parallelHash128(p, 1000) == Crypto::hash128(p, 1000));
+    debugAssert(Crypto::parallelHash128(p, Crypto::HASH_CHUNK_SIZE) == Crypto::hash128(p, Crypto::HASH_CHUNK_SIZE));
+    debugAssert(Crypto::parallelHash128(p, 0) == Crypto::hash128(p, 0));
+    debugAssert(Crypto::parallelCRC32(p, 1000) == Crypto::crc32(p, 1000));
+
+    // From memory and from a file, starting partway in
+    {
+        BinaryInput b(p, n, G3D_LITTLE_ENDIAN, false, false);
+        debugAssert(Crypto::parallelHash128(b) == h);
+        debugAssert(b.getPosition() == n);
+        b.setPosition(100);
+        debugAssert(Crypto::parallelCRC32C(b) == Crypto::crc32c(p + 100, n - 100));
+    }
+
+    const std::string filename = "tCrypto.bin";
+    {
+        BinaryOutput b(filename, G3D_LITTLE_ENDIAN);
+        b.writeBytes(p, n);
+        b.commit();
+    }
+    {
+        BinaryInput b(filename, G3D_LITTLE_ENDIAN);
+        debugAssert(Crypto::parallelCRC32(b) == crc);
+        b.reset();
+        debugAssert(Crypto::parallelHash128(b) == h);
+    }
+    FileSystem::removeFile(filename);
+    (void)crc;
+    (void)crcc;
+}
+
+} // namespace
+
+
+void testCrypto() {
+    printf("Crypto ");
+    testCRC();
+    testHash128();
+    testParallel();
+    printf("passed\n");
+}
+
+
+void perfCrypto() {
+    printf("Crypto performance:\n");
+
+    const int n = 64 * 1024 * 1024;
+    Array<uint8> data;
+    makeData(data, n, 4);
+    const uint8* p = data.getCArray();
+
+    Stopwatch timer;
+    volatile uint64 sink = 0;
+
+#   define TIME(name, expr)\
+    {\
+        timer.tick();\
+        sink = uint64(expr);\
+        timer.tock();\
+        printf("  %-34s %8.2f GB/s\n", name, n / timer.elapsedTime() / 1e9);\
+    }
+
+    TIME("Crypto::md5",                 Crypto::md5(p, n)[0]);
+    TIME("superFastHash",               superFastHash(p, n));
+    TIME("Crypto::crc32",               Crypto::crc32(p, n));
+    TIME("Crypto::crc32c",              Crypto::crc32c(p, n));
+    TIME("Crypto::hash128",             Crypto::hash128(p, n).value[0]);
+    TIME("Crypto::parallelCRC32",       Crypto::parallelCRC32(p, n));
+    TIME("Crypto::parallelCRC32C",      Crypto::parallelCRC32C(p, n));
+    TIME("Crypto::parallelHash128",     Crypto::parallelHash128(p, n).value[0]);
+#   undef TIME
+
+    printf("  (SSE4.2: %s, PCLMULQDQ: %s, %d threads)\n\n",
+           System::hasSSE42() ? "yes" : "no", System::hasPCLMUL() ? "yes" : "no", ThreadPool::numThreads());
+    (void)sink;
+}
@@ -1,5 +1,71 @@
 #include "G3D/G3DAll.h"
 
+/** Writes a zipfile whose entries are all stored without compression */
+static void writeStoredZipfile(const std::string& filename, const Array<std::string>& name, const Array<std::string>& contents) {
+    BinaryOutput b(filename, G3D_LITTLE_ENDIAN);
+
+    // 1980-01-01, the earliest zipfile date
+    const uint16 date = (1 << 5) | 1;
+
+    Array<uint32> offset;
+    Array<uint32> crc;
+    for (int i = 0; i < name.size(); ++i) {
+        offset.append(uint32(b.position()));
+        crc.append(Crypto::crc32(contents[i].data(), contents[i].size()));
+
+        // Local header
+        b.writeUInt32(0x04034b50);
+        b.writeUInt16(10);
+        b.writeUInt16(0);
+        b.writeUInt16(0);
+        b.writeUInt16(0);
+        b.writeUInt16(date);
+        b.writeUInt32(crc[i]);
+        b.writeUInt32(uint32(contents[i].size()));
+        b.writeUInt32(uint32(contents[i].size()));
+        b.writeUInt16(uint16(name[i].size()));
+        b.writeUInt16(0);
+        b.writeBytes(name[i].data(), name[i].size());
+        b.writeBytes(contents[i].data(), contents[i].size());
+    }
+
+    const uint32 directoryOffset = uint32(b.position());
+    for (int i = 0; i < name.size(); ++i) {
+        b.writeUInt32(0x02014b50);
+        b.writeUInt16(20);
+        b.writeUInt16(10);
+        b.writeUInt16(0);
+        b.writeUInt16(0);
+        b.writeUInt16(0);
+        b.writeUInt16(date);
+        b.writeUInt32(crc[i]);
+        b.writeUInt32(uint32(contents[i].size()));
+        b.writeUInt32(uint32(contents[i].size()));
+        b.writeUInt16(uint16(name[i].size()));
+        b.writeUInt16(0);
+        b.writeUInt16(0);
+        b.writeUInt16(0);
+        b.writeUInt16(0);
+        b.writeUInt32(0);
+        b.writeUInt32(offset[i]);
+        b.writeBytes(name[i].data(), name[i].size());
+    }
+    const uint32 directorySize = uint32(b.position()) - directoryOffset;
+
+    // End of central directory
+    b.writeUInt32(0x06054b50);
+    b.writeUInt16(0);
+    b.writeUInt16(0);
+    b.writeUInt16(uint16(name.size()));
+    b.writeUInt16(uint16(name.size()));
+    b.writeUInt32(directorySize);
+    b.writeUInt32(directoryOffset);
+    b.writeUInt16(0);
+
+    b.commit();
+}
+
+
 void testFileSystem() {
     printf("FileSystem...");
 
@@ -44,6 +110,110 @@ void testFileSystem() {
     debugAssert(! FileSystem::exists("apiTest.zip/no.txt"));
 
     debugAssert(FileSystem::size("apiTest.zip") == 488);
+    debugAssert(FileSystem::lastModified("nothere") == -1);
+
+    {
+        // Compressed file inside a zipfile
+        BinaryInput zipped("apiTest.zip/Test.txt", G3D_LITTLE_ENDIAN);
+        BinaryInput disk("TestDir/Test.txt", G3D_LITTLE_ENDIAN);
+        debugAssert(zipped.size() == 69);
+        debugAssert(zipped.size() == disk.size());
+        debugAssert(memcmp(zipped.getCArray(), disk.getCArray(), size_t(disk.size())) == 0);
+    }
+
+    {
+        // Uncompressed files are read in place from the mapped zipfile
+        Array<std::string> name, contents;
+        name.append("a.txt", "dir/B.bin");
+        contents.append("hello", std::string(1000, 'x') + "end");
+        writeStoredZipfile("stored.zip", name, contents);
+
+        debugAssert(FileSystem::exists("stored.zip/dir/B.bin"));
+        debugAssert(FileSystem::size("stored.zip/dir/b.bin") == 1003);
+        files.clear();
+        FileSystem::getDirectories("stored.zip/*", files);
+        debugAssert((files.size() == 1) && (files[0] == "dir"));
+
+        {
+            BinaryInput b("stored.zip/dir/B.bin", G3D_LITTLE_ENDIAN);
+            debugAssert(b.size() == 1003);
+            debugAssert(b.readString(1003) == contents[1]);
+        }
+        debugAssert(readWholeFile("stored.zip/a.txt") == "hello");
+        debugAssert(FileSystem::lastModified("stored.zip/a.txt") == FileSystem::lastModified("stored.zip"));
+        debugAssert(FileSystem::lastModified("stored.zip") > 0);
+        debugAssert(FileSystem::lastModified("stored.zip/no.txt") == -1);
+
+        // Release the mapping so that the file can be removed
+        FileSystem::clearCache();
+        FileSystem::removeFile("stored.zip");
+        debugAssert(! FileSystem::exists("stored.zip"));
+    }
+
+    {
+        // A central directory whose name length runs past the end of the file
+        Array<std::string> name, contents;
+        name.append("a.txt");
+        contents.append("hello");
+        writeStoredZipfile("truncated.zip", name, contents);
+
+        std::string data;
+        {
+            BinaryInput in("truncated.zip", G3D_LITTLE_ENDIAN);
+            data.assign((const char*)in.getCArray(), size_t(in.size()));
+        }
+        const size_t directory = data.find("PK\x01\x02");
+        debugAssert(directory != std::string::npos);
+        data[directory + 28] = char(0xFF);
+        data[directory + 29] = char(0xFF);
+        {
+            BinaryOutput out("truncated.zip", G3D_LITTLE_ENDIAN);
+            out.writeBytes(data.data(), data.size());
+            out.commit();
+        }
+        FileSystem::clearCache();
+
+        debugAssert(! FileSystem::exists("truncated.zip/a.txt"));
+
+        FileSystem::clearCache();
+        FileSystem::removeFile("truncated.zip");
+    }
 
     printf("passed\n");
 }
+
+
+void perfFileSystem() {
+    printf("FileSystem performance:\n");
+
+    const int N = 5000;
+    Random r(5);
+    Array<std::string> name, contents;
+    for (int i = 0; i < N; ++i) {
+        name.append(format("asset/%04d.dat", i));
+        contents.append(std::string(r.integer(100, 4000), char('a' + i % 26)));
+    }
+    writeStoredZipfile("perf.zip", name, contents);
+
+    Stopwatch timer;
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 0) {
+            // Cold: the zipfile must be opened and indexed
+            FileSystem::clearCache();
+        }
+
+        int64 total = 0;
+        timer.tick();
+        for (int i = 0; i < N; ++i) {
+            BinaryInput b("perf.zip/" + name[i], G3D_LITTLE_ENDIAN);
+            total += b.readUInt8();
+        }
+        timer.tock();
+        (void)total;
+        printf("  BinaryInput from zipfile (%s): %6.2f us/file\n", (pass == 0) ? "cold" : "warm", timer.elapsedTime() * 1e6 / N);
+    }
+
+    FileSystem::clearCache();
+    FileSystem::removeFile("perf.zip");
+    printf("\n");
+}
@@ -0,0 +1,183 @@
+#include "G3D/G3DAll.h"
+using G3D::uint8;
+using G3D::uint32;
+using G3D::uint64;
+
+namespace {
+
+/** Every key collides */
+class BadHash {
+public:
+    static size_t hashCode(int) {
+        return 7;
+    }
+};
+
+/** Few distinct hash codes, so that insertions displace long clusters */
+class CoarseHash {
+public:
+    static size_t hashCode(int k) {
+        return k / 8;
+    }
+};
+
+}
+
+void testFlatTable() {
+    printf("G3D::FlatTable  ");
+
+    {
+        FlatTable<int, int> t;
+        debugAssert(t.size() == 0);
+        debugAssert(! t.containsKey(1));
+        debugAssert(t.getPointer(1) == NULL);
+        debugAssert(t.begin() == t.end());
+
+        t.set(10, 20);
+        t.set(13, 26);
+        t.set(10, 30);
+        debugAssert(t.size() == 2);
+        debugAssert(t[10] == 30);
+        debugAssert(t[13] == 26);
+
+        int v = 0;
+        debugAssert(t.get(13, v) && (v == 26));
+        debugAssert(! t.get(14, v));
+
+        bool created = false;
+        t.getCreate(14, created) = 28;
+        debugAssert(created);
+        t.getCreate(14, created);
+        debugAssert(! created);
+
+        debugAssert(t.remove(10));
+        debugAssert(! t.remove(10));
+        debugAssert(! t.containsKey(10));
+        debugAssert(t.size() == 2);
+
+        int k = 0;
+        debugAssert(t.getRemove(13, k, v) && (k == 13) && (v == 26));
+        debugAssert(t.size() == 1);
+
+        t.clear();
+        debugAssert(t.size() == 0);
+        debugAssert(! t.containsKey(14));
+    }
+
+    {
+        // Compare against Table under random insertion and removal
+        FlatTable<int, int> flat;
+        Table<int, int>     reference;
+        Random r(1234);
+
+        for (int i = 0; i < 20000; ++i) {
+            const int key = r.integer(0, 3000);
+            if (r.uniform() < 0.6f) {
+                flat.set(key, i);
+                reference.set(key, i);
+            } else {
+                debugAssert(flat.remove(key) == reference.remove(key));
+            }
+        }
+
+        debugAssert(flat.size() == reference.size());
+        debugAssert(flat.debugGetLoad() <= 0.875);
+        for (int key = 0; key <= 3000; ++key) {
+            debugAssert(flat.containsKey(key) == reference.containsKey(key));
+            if (reference.containsKey(key)) {
+                debugAssert(flat[key] == reference[key]);
+            }
+        }
+
+        size_t count = 0;
+        for (FlatTable<int, int>::Iterator it = flat.begin(); it.isValid(); ++it) {
+            debugAssert(reference[it->key] == it->value);
+            ++count;
+        }
+        debugAssert(count == flat.size());
+
+        // Copy construction and assignment
+        FlatTable<int, int> copy(flat);
+        FlatTable<int, int> assigned;
+        assigned.set(-1, -1);
+        assigned = copy;
+        debugAssert(! assigned.containsKey(-1));
+        debugAssert(assigned.size() == flat.size());
+        for (FlatTable<int, int>::Iterator it = flat.begin(); it.isValid(); ++it) {
+            debugAssert(assigned[it->key] == it->value);
+        }
+    }
+
+    {
+        // Degenerate hash function
+        FlatTable<int, std::string, BadHash> t;
+        for (int i = 0; i < 100; ++i) {
+            t.set(i, format("%d", i));
+        }
+        for (int i = 0; i < 100; i += 2) {
+            t.remove(i);
+        }
+        debugAssert(t.size() == 50);
+        for (int i = 0; i < 100; ++i) {
+            debugAssert(t.containsKey(i) == ((i & 1) == 1));
+            if (i & 1) {
+                debugAssert(t[i] == format("%d", i));
+            }
+        }
+    }
+
+    {
+        // Values that own heap storage, moved around by displacement and
+        // removal.  A new value must be freshly constructed, as
+        // PointHashGrid relies on when it sets a new cell's memory manager.
+        const MemoryManager::Ref memoryManager = MemoryManager::create();
+        FlatTable<int, Array<int>, CoarseHash> flat;
+        Table<int, int>                        reference;
+        Random r(99);
+        for (int i = 0; i < 5000; ++i) {
+            const int key = r.integer(0, 400);
+            if (r.uniform() < 0.7f) {
+                bool created = false;
+                Array<int>& a = flat.getCreate(key, created);
+                if (created) {
+                    debugAssert(a.size() == 0);
+                    a.clearAndSetMemoryManager(memoryManager);
+                }
+                a.fastClear();
+                for (int j = 0; j <= key % 13; ++j) {
+                    a.append(key + j);
+                }
+                reference.set(key, key % 13 + 1);
+            } else {
+                debugAssert(flat.remove(key) == reference.remove(key));
+            }
+        }
+        debugAssert(flat.size() == reference.size());
+        for (int key = 0; key <= 400; ++key) {
+            debugAssert(flat.containsKey(key) == reference.containsKey(key));
+            if (reference.containsKey(key)) {
+                const Array<int>& a = flat[key];
+                debugAssert(a.size() == reference[key]);
+                for (int j = 0; j < a.size(); ++j) {
+                    debugAssert(a[j] == key + j);
+                }
+            }
+        }
+    }
+
+    {
+        FlatTable<std::string, int> t;
+        t.setSizeHint(1000);
+        const size_t capacity = t.debugGetNumBuckets();
+        for (int i = 0; i < 800; ++i) {
+            t.set(format("key%d", i), i);
+        }
+        debugAssert(t.debugGetNumBuckets() == capacity);
+        debugAssert(t["key417"] == 417);
+        Array<std::string> keys;
+        t.getKeys(keys);
+        debugAssert(keys.size() == 800);
+    }
+
+    printf("passed\n");
+}
@@ -0,0 +1,108 @@
+#include "G3D/G3DAll.h"
+
+namespace {
+
+class Base : public ReferenceCountedObject {
+public:
+    typedef ReferenceCountedPointer<Base> Ref;
+    int value;
+    Base(int v) : value(v) {}
+};
+
+class DerivedA : public Base {
+public:
+    DerivedA(int v) : Base(v) {}
+};
+
+class DerivedB : public Base {
+public:
+    DerivedB(int v) : Base(v) {}
+};
+
+
+/** Typical per-frame temporaries: a growing array, a table, and a categorized array */
+void simulateFrame(const Array<Base::Ref>& all) {
+    Array<int> a;
+    a.clearAndSetMemoryManager(FrameMemoryManager::current());
+    for (int i = 0; i < 5000; ++i) {
+        a.append(i);
+    }
+    debugAssert(a[4999] == 4999);
+
+    Table<int, int> t;
+    t.clearAndSetMemoryManager(FrameMemoryManager::current());
+    for (int i = 0; i < 100; ++i) {
+        t.set(i, -i);
+    }
+    debugAssert(t[50] == -50);
+
+    Array< Array<Base::Ref> > derived;
+    derived.clearAndSetMemoryManager(FrameMemoryManager::current());
+    categorizeByDerivedType(all, derived, derived.memoryManager());
+    debugAssert(derived.size() == 2);
+    debugAssert(derived[0].memoryManager() == derived.memoryManager());
+    debugAssert(derived[0].size() + derived[1].size() == all.size());
+    debugAssert(derived[0][0]->value == 0);
+    debugAssert(derived[1][0]->value == 1);
+}
+
+} // namespace
+
+
+void testFrameMemoryManager() {
+    printf("FrameMemoryManager ");
+
+    FrameMemoryManager::Ref m = FrameMemoryManager::current();
+    debugAssert(m == FrameMemoryManager::current());
+    debugAssert(m->liveAllocations() == 0);
+
+    {
+        // Alignment, and rewinding once everything is freed
+        void* x = m->alloc(3);
+        void* y = m->alloc(17);
+        debugAssert(((uintptr_t)x & 15) == 0);
+        debugAssert(((uintptr_t)y & 15) == 0);
+        debugAssert((uint8*)y == (uint8*)x + 16);
+        m->free(x);
+        debugAssert(m->liveAllocations() == 1);
+        m->free(y);
+        debugAssert(m->liveAllocations() == 0);
+        void* z = m->alloc(1);
+        debugAssert(z == x);
+        m->free(z);
+        (void)y;
+    }
+
+    {
+        // Larger than a block
+        void* x = m->alloc(1024 * 1024);
+        System::memset(x, 0xFF, 1024 * 1024);
+        m->free(x);
+    }
+
+    Array<Base::Ref> all;
+    for (int i = 0; i < 40; ++i) {
+        if (isEven(i)) {
+            all.append(new DerivedA(i));
+        } else {
+            all.append(new DerivedB(i));
+        }
+    }
+
+    // The first frame may grow the arena; later ones must not touch the heap
+    for (int frame = 0; frame < 4; ++frame) {
+        m->beginFrame();
+        simulateFrame(all);
+        simulateFrame(all);
+        m->endFrame();
+
+        const FrameMemoryManager::Stats& stats = m->lastFrameStats();
+        debugAssert(stats.allocations > 0);
+        debugAssert(stats.peakBytes <= m->capacity());
+        debugAssert((frame == 0) || (stats.heapAllocations == 0));
+        (void)stats;
+    }
+    debugAssert(m->liveAllocations() == 0);
+
+    printf("passed\n");
+}
@@ -58,6 +58,365 @@ static void printBoard(const Color4* b, int S) {
 #define RECAST reinterpret_cast<void*>
 
 
+/** Scalar reference decoder for the formats with row converters */
+static Color4 readPixel(const ImageFormat* format, const uint8* p) {
+    switch (format->code) {
+    case ImageFormat::CODE_L8:
+        {
+            const float L = unorm8::fromBits(p[0]);
+            return Color4(L, L, L, 1.0f);
+        }
+
+    case ImageFormat::CODE_L32F:
+        {
+            float L;
+            System::memcpy(&L, p, sizeof(float));
+            return Color4(L, L, L, 1.0f);
+        }
+
+    case ImageFormat::CODE_RGB8:
+        return Color4(Color3(Color3unorm8(unorm8::fromBits(p[0]), unorm8::fromBits(p[1]), unorm8::fromBits(p[2]))), 1.0f);
+
+    case ImageFormat::CODE_BGR8:
+        return Color4(Color3(Color3unorm8(unorm8::fromBits(p[2]), unorm8::fromBits(p[1]), unorm8::fromBits(p[0]))), 1.0f);
+
+    case ImageFormat::CODE_RGBA8:
+        return Color4(Color4unorm8(unorm8::fromBits(p[0]), unorm8::fromBits(p[1]), unorm8::fromBits(p[2]), unorm8::fromBits(p[3])));
+
+    case ImageFormat::CODE_RGB32F:
+        {
+            Color3 c;
+            System::memcpy(&c, p, sizeof(Color3));
+            return Color4(c, 1.0f);
+        }
+
+    case ImageFormat::CODE_RGBA32F:
+        {
+            Color4 c;
+            System::memcpy(&c, p, sizeof(Color4));
+            return c;
+        }
+
+    default:
+        alwaysAssertM(false, "Unsupported format");
+        return Color4::zero();
+    }
+}
+
+
+/** Scalar reference encoder for the formats with row converters */
+static void writePixel(const ImageFormat* format, const Color4& c, uint8* p) {
+    switch (format->code) {
+    case ImageFormat::CODE_RGB8:
+        {
+            const Color3unorm8 d(c.rgb());
+            System::memcpy(p, &d, 3);
+            break;
+        }
+
+    case ImageFormat::CODE_BGR8:
+        {
+            const Color3unorm8 d(Color3unorm8(c.rgb()).bgr());
+            System::memcpy(p, &d, 3);
+            break;
+        }
+
+    case ImageFormat::CODE_RGBA8:
+        {
+            const Color4unorm8 d(c);
+            System::memcpy(p, &d, 4);
+            break;
+        }
+
+    case ImageFormat::CODE_RGB32F:
+        System::memcpy(p, &c, sizeof(Color3));
+        break;
+
+    case ImageFormat::CODE_RGBA32F:
+        System::memcpy(p, &c, sizeof(Color4));
+        break;
+
+    default:
+        alwaysAssertM(false, "Unsupported format");
+    }
+}
+
+
+static void randomImage(Random& rnd, const ImageFormat* format, int numBytes, Array<uint8>& data) {
+    data.resize(numBytes);
+    if (format->floatingPoint) {
+        float* f = reinterpret_cast<float*>(data.getCArray());
+        for (int i = 0; i < numBytes / 4; ++i) {
+            // Include out-of-range values and exact unorm8 values
+            f[i] = rnd.integer(0, 3) == 0 ? rnd.integer(0, 255) / 255.0f : rnd.uniform(-0.25f, 1.25f);
+        }
+    } else {
+        for (int i = 0; i < numBytes; ++i) {
+            data[i] = uint8(rnd.bits());
+        }
+    }
+}
+
+
+// Malvar-He-Cutler filters as published, named output_input (see ImageFormat_convert.cpp)
+static const float G_GRR[5][5] =
+    {{ 0.0f,  0.0f, -1.0f,  0.0f,  0.0f},
+     { 0.0f,  0.0f,  2.0f,  0.0f,  0.0f},
+     {-1.0f,  2.0f,  4.0f,  2.0f, -1.0f},
+     { 0.0f,  0.0f,  2.0f,  0.0f,  0.0f},
+     { 0.0f,  0.0f, -1.0f,  0.0f,  0.0f}};
+
+static const float R_GRG[5][5] =
+    {{ 0.0f,  0.0f,  0.5f,  0.0f,  0.0f},
+     { 0.0f, -1.0f,  0.0f, -1.0f,  0.0f},
+     {-1.0f,  4.0f,  5.0f,  4.0f, -1.0f},
+     { 0.0f, -1.0f,  0.0f, -1.0f,  0.0f},
+     { 0.0f,  0.0f,  0.5f,  0.0f,  0.0f}};
+
+static const float R_BGG[5][5] =
+    {{ 0.0f,  0.0f, -1.0f,  0.0f,  0.0f},
+     { 0.0f, -1.0f,  4.0f, -1.0f,  0.0f},
+     { 0.5f,  0.0f,  5.0f,  0.0f,  0.5f},
+     { 0.0f, -1.0f,  4.0f, -1.0f,  0.0f},
+     { 0.0f,  0.0f, -1.0f,  0.0f,  0.0f}};
+
+static const float R_BGB[5][5] =
+    {{ 0.0f,  0.0f, -1.5f,  0.0f,  0.0f},
+     { 0.0f,  2.0f,  0.0f,  2.0f,  0.0f},
+     {-1.5f,  0.0f,  6.0f,  0.0f, -1.5f},
+     { 0.0f,  2.0f,  0.0f,  2.0f,  0.0f},
+     { 0.0f,  0.0f, -1.5f,  0.0f,  0.0f}};
+
+
+/** Floating-point 5x5 filter of a Bayer image, wrapping at the boundaries */
+static uint8 applyFilter(const uint8* I, int w, int h, int x, int y, const float filter[5][5]) {
+    float sum = 0.0f;
+    float denom = 0.0f;
+    for (int dy = 0; dy < 5; ++dy) {
+        for (int dx = 0; dx < 5; ++dx) {
+            const float f = filter[dy][dx];
+            sum += f * float(unorm8::fromBits(I[((y + dy + h - 2) % h) * w + (x + dx + w - 2) % w]));
+            denom += f;
+        }
+    }
+    return unorm8(sum / denom).bits();
+}
+
+
+/** Reference demosaic of one pixel of a Bayer image with red samples at (redX, redY) mod 2 */
+static Color3unorm8 referenceMHC(const uint8* I, int w, int h, int redX, int redY, int x, int y) {
+    const uint8 c = I[y * w + x];
+    const bool redRow = ((y - redY) & 1) == 0;
+    const bool redCol = ((x - redX) & 1) == 0;
+    uint8 r, g, b;
+    if (redRow && redCol) {
+        r = c;                                  g = applyFilter(I, w, h, x, y, G_GRR);  b = applyFilter(I, w, h, x, y, R_BGB);
+    } else if (redRow) {
+        r = applyFilter(I, w, h, x, y, R_GRG);  g = c;                                  b = applyFilter(I, w, h, x, y, R_BGG);
+    } else if (redCol) {
+        r = applyFilter(I, w, h, x, y, R_BGG);  g = c;                                  b = applyFilter(I, w, h, x, y, R_GRG);
+    } else {
+        r = applyFilter(I, w, h, x, y, R_BGB);  g = applyFilter(I, w, h, x, y, G_GRR);  b = c;
+    }
+    return Color3unorm8(unorm8::fromBits(r), unorm8::fromBits(g), unorm8::fromBits(b));
+}
+
+
+static const ImageFormat* bayerFormat(int i) {
+    static const ImageFormat* f[] = {ImageFormat::BAYER_RGGB8(), ImageFormat::BAYER_GRBG8(), ImageFormat::BAYER_GBRG8(), ImageFormat::BAYER_BGGR8()};
+    return f[i];
+}
+
+
+/** Compares the demosaicer against the floating-point filters for every
+    layout, and checks that each layout round-trips a smooth image */
+static void testBayer() {
+    Random rnd(3, false);
+    const int size[][2] = {{2, 2}, {6, 4}, {38, 22}, {70, 6}, {600, 200}};
+    for (int layout = 0; layout < 4; ++layout) {
+        const ImageFormat* bayer = bayerFormat(layout);
+        const int redX = layout & 1;
+        const int redY = layout >> 1;
+
+        for (int i = 0; i < int(sizeof(size) / sizeof(size[0])); ++i) {
+            const int W = size[i][0];
+            const int H = size[i][1];
+            for (int options = 0; options < 4; ++options) {
+                const int padBits = (options & 1) ? 64 : 0;
+                const bool invertY = (options & 2) != 0;
+                const int srcStride = W + padBits / 8;
+                const int dstStride = 3 * W + padBits / 8;
+
+                Array<uint8> input;
+                randomImage(rnd, bayer, srcStride * H, input);
+                Array<uint8> packed;
+                packed.resize(W * H);
+                for (int y = 0; y < H; ++y) {
+                    System::memcpy(packed.getCArray() + y * W, input.getCArray() + y * srcStride, W);
+                }
+
+                Array<uint8> output;
+                output.resize(dstStride * H);
+                Array<const void*> in;
+                in.append(input.getCArray());
+                Array<void*> out;
+                out.append(output.getCArray());
+                const bool converted = ImageFormat::convert(in, W, H, bayer, padBits, out, ImageFormat::RGB8(), padBits, invertY);
+                debugAssert(converted);
+                (void)converted;
+
+                for (int y = 0; y < H; ++y) {
+                    const uint8* row = output.getCArray() + (invertY ? (H - 1 - y) : y) * dstStride;
+                    for (int x = 0; x < W; ++x) {
+                        const Color3unorm8 expected = referenceMHC(packed.getCArray(), W, H, redX, redY, x, y);
+                        for (int c = 0; c < 3; ++c) {
+                            // The reference rounds in floating point
+                            debugAssertM(iAbs(int(row[3 * x + c]) - int(expected[c].bits())) <= 1,
+                                format("%s wrong at (%d, %d) of %dx%d", bayer->name().c_str(), x, y, W, H));
+                        }
+                    }
+                }
+
+                // RGBA32F is the same image
+                Array<Color4> color;
+                color.resize(W * H);
+                Array<void*> colorOut;
+                colorOut.append(color.getCArray());
+                ImageFormat::convert(in, W, H, bayer, padBits, colorOut, ImageFormat::RGBA32F(), 0, invertY);
+                for (int y = 0; y < H; ++y) {
+                    for (int x = 0; x < W; ++x) {
+                        const uint8* p = output.getCArray() + y * dstStride + 3 * x;
+                        debugAssert(Color4unorm8(color[x + y * W]) == 
+                                    Color4unorm8(unorm8::fromBits(p[0]), unorm8::fromBits(p[1]), unorm8::fromBits(p[2]), unorm8::one()));
+                    }
+                }
+            }
+        }
+
+        // Round trip a smooth image through the Bayer format
+        const int W = 64;
+        const int H = 32;
+        Array<Color4> color;
+        color.resize(W * H);
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                color[x + y * W] = Color4(0.2f + x * 0.01f, 0.5f, 0.8f - y * 0.01f, 1.0f);
+            }
+        }
+        Array<uint8> mosaic;
+        mosaic.resize(W * H);
+        Array<Color3unorm8> result;
+        result.resize(W * H);
+        Array<const void*> in;
+        in.append(color.getCArray());
+        Array<void*> out;
+        out.append(mosaic.getCArray());
+        ImageFormat::convert(in, W, H, ImageFormat::RGBA32F(), 0, out, bayer, 0);
+        in[0] = mosaic.getCArray();
+        out[0] = result.getCArray();
+        ImageFormat::convert(in, W, H, bayer, 0, out, ImageFormat::RGB8(), 0);
+        for (int y = 2; y < H - 2; ++y) {
+            for (int x = 2; x < W - 2; ++x) {
+                const Color3 error = Color3(result[x + y * W]) - color[x + y * W].rgb();
+                debugAssertM(error.length() < 0.02f, format("%s does not round trip at (%d, %d)", bayer->name().c_str(), x, y));
+                (void)error;
+            }
+        }
+
+        // Mosaic into a padded destination, leaving the padding alone
+        for (int flip = 0; flip < 2; ++flip) {
+            const bool invertY = (flip == 1);
+            const int padBits = 64;
+            const int dstStride = W + padBits / 8;
+            for (int i = 0; i < W * H; ++i) {
+                color[i] = Color4(rnd.uniform(), rnd.uniform(), rnd.uniform(), 1.0f);
+            }
+            Array<uint8> padded;
+            padded.resize(dstStride * H);
+            System::memset(padded.getCArray(), 0xCD, padded.size());
+            in[0] = color.getCArray();
+            out[0] = padded.getCArray();
+            const bool converted = ImageFormat::convert(in, W, H, ImageFormat::RGBA32F(), 0, out, bayer, padBits, invertY);
+            debugAssert(converted);
+            (void)converted;
+
+            for (int y = 0; y < H; ++y) {
+                const uint8* row = padded.getCArray() + y * dstStride;
+                const Color4* src = color.getCArray() + (invertY ? (H - 1 - y) : y) * W;
+                for (int x = 0; x < W; ++x) {
+                    const Color3unorm8 c(src[x].rgb());
+                    const bool redRow = ((y & 1) == redY);
+                    const bool redCol = ((x & 1) == redX);
+                    const unorm8 expected = (redRow && redCol) ? c.r : ((!redRow && !redCol) ? c.b : c.g);
+                    debugAssertM(row[x] == expected.bits(),
+                        format("%s wrong at (%d, %d) with a padded destination", bayer->name().c_str(), x, y));
+                    (void)expected;
+                }
+                for (int x = W; x < dstStride; ++x) {
+                    debugAssertM(row[x] == 0xCD, format("%s wrote into the row padding", bayer->name().c_str()));
+                }
+            }
+        }
+    }
+}
+
+
+/** Compares ImageFormat::convert against readPixel/writePixel for every
+    pair of formats with row converters, at sizes that exercise the SIMD
+    blocks and the scalar tails, with padding and y inversion. */
+static void testConvertRows() {
+    const ImageFormat* formats[] = {ImageFormat::L8(), ImageFormat::L32F(), ImageFormat::RGB8(), ImageFormat::BGR8(),
+                                    ImageFormat::RGBA8(), ImageFormat::RGB32F(), ImageFormat::RGBA32F()};
+    const int numFormats = sizeof(formats) / sizeof(formats[0]);
+    const int width[] = {1, 3, 4, 5, 16, 17, 33, 67, 700};
+    Random rnd(1, false);
+
+    for (int s = 0; s < numFormats; ++s) {
+        for (int d = 2; d < numFormats; ++d) {
+            const ImageFormat* src = formats[s];
+            const ImageFormat* dst = formats[d];
+            if ((src == dst) || ! ImageFormat::conversionAvailable(src, 32, dst, 32, true)) {
+                continue;
+            }
+
+            for (int w = 0; w < int(sizeof(width) / sizeof(width[0])); ++w) {
+                const int W = width[w];
+                const int H = (W > 100) ? 400 : 3;
+                for (int options = 0; options < 4; ++options) {
+                    const int padBits = (options & 1) ? 32 : 0;
+                    const bool invertY = (options & 2) != 0;
+                    const int srcStride = W * src->cpuBitsPerPixel / 8 + padBits / 8;
+                    const int dstStride = W * dst->cpuBitsPerPixel / 8 + padBits / 8;
+
+                    Array<uint8> input;
+                    randomImage(rnd, src, srcStride * H, input);
+                    Array<uint8> output;
+                    output.resize(dstStride * H);
+
+                    Array<const void*> in;
+                    in.append(input.getCArray());
+                    Array<void*> out;
+                    out.append(output.getCArray());
+                    const bool converted = ImageFormat::convert(in, W, H, src, padBits, out, dst, padBits, invertY);
+                    debugAssert(converted);
+                    (void)converted;
+
+                    uint8 expected[16];
+                    for (int y = 0; y < H; ++y) {
+                        const int outY = invertY ? (H - 1 - y) : y;
+                        for (int x = 0; x < W; ++x) {
+                            writePixel(dst, readPixel(src, input.getCArray() + y * srcStride + x * src->cpuBitsPerPixel / 8), expected);
+                            const uint8* actual = output.getCArray() + outY * dstStride + x * dst->cpuBitsPerPixel / 8;
+                            debugAssertM(memcmp(expected, actual, dst->cpuBitsPerPixel / 8) == 0,
+                                format("%s -> %s wrong at (%d, %d) of %dx%d", src->name().c_str(), dst->name().c_str(), x, y, W, H));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
 
 void testImageConvert() {
 
@@ -153,11 +512,81 @@ void testImageConvert() {
 
 
 
+    testConvertRows();
+    testBayer();
+
     printf("passed\n");
 }
 
 
-void perfTest() {
-    printf("ImageFormat::convert performance test is not implemented.");
+void perfImageConvert() {
+    printf("ImageFormat::convert performance (1920x1080):\n");
+
+    const int W = 1920;
+    const int H = 1080;
+    const ImageFormat* pair[][2] = {
+        {ImageFormat::RGB8(),    ImageFormat::RGBA8()},
+        {ImageFormat::BGR8(),    ImageFormat::RGBA8()},
+        {ImageFormat::RGBA8(),   ImageFormat::RGB8()},
+        {ImageFormat::RGB8(),    ImageFormat::BGR8()},
+        {ImageFormat::RGBA8(),   ImageFormat::RGBA32F()},
+        {ImageFormat::RGBA32F(), ImageFormat::RGBA8()},
+        {ImageFormat::RGBA32F(), ImageFormat::RGB8()},
+        {ImageFormat::RGB8(),    ImageFormat::RGB32F()},
+        {ImageFormat::RGB32F(),  ImageFormat::BGR8()}};
+
+    Random rnd(2, false);
+    Stopwatch timer;
+    for (int p = 0; p < int(sizeof(pair) / sizeof(pair[0])); ++p) {
+        const ImageFormat* src = pair[p][0];
+        const ImageFormat* dst = pair[p][1];
+
+        Array<uint8> input;
+        randomImage(rnd, src, W * H * src->cpuBitsPerPixel / 8, input);
+        Array<uint8> output;
+        output.resize(W * H * dst->cpuBitsPerPixel / 8);
+        Array<const void*> in;
+        in.append(input.getCArray());
+        Array<void*> out;
+        out.append(output.getCArray());
+
+        const int trials = 10;
+        timer.tick();
+        for (int t = 0; t < trials; ++t) {
+            ImageFormat::convert(in, W, H, src, 0, out, dst, 0);
+        }
+        timer.tock();
+        printf("  %-8s -> %-8s %7.2f ms\n", src->name().c_str(), dst->name().c_str(), timer.elapsedTime() * 1000 / trials);
+    }
+
+    // 4K camera frames
+    {
+        const int W = 3840;
+        const int H = 2160;
+        Array<uint8> input;
+        randomImage(rnd, ImageFormat::BAYER_RGGB8(), W * H, input);
+        Array<uint8> output;
+        output.resize(W * H * sizeof(Color4));
+        Array<const void*> in;
+        in.append(input.getCArray());
+        Array<void*> out;
+        out.append(output.getCArray());
+
+        for (int layout = 0; layout < 4; ++layout) {
+            for (int d = 0; d < 2; ++d) {
+                const ImageFormat* dst = (d == 0) ? ImageFormat::RGB8() : ImageFormat::RGBA32F();
+                const int trials = 5;
+                timer.tick();
+                for (int t = 0; t < trials; ++t) {
+                    ImageFormat::convert(in, W, H, bayerFormat(layout), 0, out, dst, 0);
+                }
+                timer.tock();
+                printf("  %-11s -> %-7s (3840x2160) %7.1f Mpix/s\n", bayerFormat(layout)->name().c_str(), dst->name().c_str(), 
+                       W * H * trials / (timer.elapsedTime() * 1e6));
+            }
+        }
+    }
 
+    printf("  (SSE2: %s, SSSE3: %s, %d threads)\n\n", System::hasSSE2() ? "yes" : "no", 
+           System::hasSSSE3() ? "yes" : "no", ThreadPool::numThreads());
 }
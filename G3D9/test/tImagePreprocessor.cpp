@@ -0,0 +1,407 @@
+#include "G3D/G3DAll.h"
+
+namespace {
+
+void randomBytes(Array<uint8>& data, int n, int seed) {
+    Random rnd(seed, false);
+    data.resize(n);
+    for (int i = 0; i < n; ++i) {
+        data[i] = uint8(rnd.bits());
+    }
+}
+
+
+/** The lookup table that Texture::Preprocess has always used for 8-bit images */
+void referenceTable(const Color4& modulate, float gamma, uint8 table[4][256]) {
+    for (int c = 0; c < 4; ++c) {
+        for (int i = 0; i < 256; ++i) {
+            const float s = pow((i * modulate[c]) / 255.0f, gamma) * 255;
+            table[c][i] = uint8(iClamp(iRound(s), 0, 255));
+        }
+    }
+}
+
+
+/** The scalar normal map algorithm, one pixel at a time with wrapping */
+void referenceNormalMap(int w, int h, int stride, const uint8* B, const BumpMapPreprocess& preprocess, Color4unorm8* N) {
+    float whiteHeightInPixels = preprocess.zExtentPixels;
+    if (whiteHeightInPixels < 0.0f) {
+        whiteHeightInPixels = max(w, h) * -whiteHeightInPixels;
+    }
+    const float elevationInvScale = 255.0f / whiteHeightInPixels;
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+#           define ELEVATION(DX, DY) ((int)B[(((DX + x + w) % w) + ((DY + y + h) % h) * w) * stride])
+            Vector3 delta;
+            delta.y = -( ELEVATION(-1, -1) * 1 +  ELEVATION( 0, -1) * 2 +  ELEVATION( 1, -1) * 1 +
+                        -ELEVATION(-1,  1) * 1 + -ELEVATION( 0,  1) * 2 + -ELEVATION( 1,  1) * 1);
+            delta.x = -(-ELEVATION(-1, -1) * 1 + ELEVATION( 1, -1) * 1 +
+                        -ELEVATION(-1,  0) * 2 + ELEVATION( 1,  0) * 2 +
+                        -ELEVATION(-1,  1) * 1 + ELEVATION( 1,  1) * 1);
+            delta.z = 4 * 2 * elevationInvScale;
+            delta = delta.direction();
+
+            float H = B[(x + y * w) * stride] / 255.0f;
+            if (preprocess.lowPassFilter) {
+                H = (ELEVATION(-1, -1) + ELEVATION( 0, -1) + ELEVATION(1, -1) +
+                     ELEVATION(-1,  0) + ELEVATION( 0,  0) + ELEVATION(1,  0) +
+                     ELEVATION(-1,  1) + ELEVATION( 0,  1) + ELEVATION(1,  1)) / (255.0f * 9.0f);
+            }
+#           undef ELEVATION
+            if (preprocess.scaleZByNz) {
+                H *= delta.z;
+            }
+
+            delta = delta * 0.5f + Vector3(0.5f, 0.5f, 0.5f);
+            N[x + y * w] = Color4unorm8(unorm8(delta.x), unorm8(delta.y), unorm8(delta.z), unorm8(H));
+        }
+    }
+}
+
+
+/** Min, max, and mean of each RGBA channel of pixels already converted to RGBA32F */
+void referenceStats(const Color4* p, int n, ImagePreprocessor::Stats& stats) {
+    stats.minval = Color4(finf(), finf(), finf(), finf());
+    stats.maxval = -stats.minval;
+    double sum[4] = {0, 0, 0, 0};
+    for (int i = 0; i < n; ++i) {
+        stats.minval = stats.minval.min(p[i]);
+        stats.maxval = stats.maxval.max(p[i]);
+        for (int c = 0; c < 4; ++c) {
+            sum[c] += p[i][c];
+        }
+    }
+    stats.meanval = Color4(float(sum[0] / n), float(sum[1] / n), float(sum[2] / n), float(sum[3] / n));
+}
+
+
+bool near(const Color4& a, const Color4& b, float tolerance) {
+    for (int c = 0; c < 4; ++c) {
+        if (! (fabs(a[c] - b[c]) <= tolerance)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void checkStats(const ImagePreprocessor::Stats& actual, const ImagePreprocessor::Stats& expected) {
+    debugAssert(near(actual.minval, expected.minval, 1e-6f));
+    debugAssert(near(actual.maxval, expected.maxval, 1e-6f));
+    debugAssert(near(actual.meanval, expected.meanval, 1e-4f));
+    (void)actual; (void)expected;
+}
+
+
+/** Each 8-bit layout, adjusted and measured, against the lookup table and per-pixel statistics */
+void testBytes() {
+    const ImageFormat* formats[] = {ImageFormat::R8(), ImageFormat::RG8(), ImageFormat::L8(), ImageFormat::LA8(),
+                                    ImageFormat::RGB8(), ImageFormat::RGBA8()};
+    // Narrow images, odd widths for the SSE2 tails, and one large enough to run in parallel
+    const int size[][2] = {{1, 1}, {7, 3}, {33, 17}, {300, 301}};
+    const Color4 modulate(1.5f, 0.5f, 2.0f, 0.75f);
+    const float gamma = 1.6f;
+
+    uint8 table[4][256];
+    referenceTable(modulate, gamma, table);
+
+    for (int i = 0; i < 6; ++i) {
+        const ImageFormat* format = formats[i];
+        const int channels = format->numComponents;
+        const bool luminance = (format->luminanceBits > 0);
+        debugAssert(ImagePreprocessor::supports(format));
+
+        for (int s = 0; s < 4; ++s) {
+            const int width = size[s][0], height = size[s][1];
+            const int n = width * height;
+            Array<uint8> src;
+            randomBytes(src, n * channels, i + s);
+
+            ImagePreprocessor::Settings settings;
+            ImagePreprocessor::Stats stats;
+
+            // Statistics alone do not make a new image
+            debugAssert(ImagePreprocessor::apply(src.getCArray(), width, height, format, settings, stats).isNull());
+
+            Array<Color4> rgba;
+            rgba.resize(n);
+            for (int p = 0; p < n; ++p) {
+                float v[4] = {0, 0, 0, 1};
+                for (int c = 0; c < channels; ++c) {
+                    v[(luminance && (c == 1)) ? 3 : c] = src[p * channels + c] / 255.0f;
+                }
+                rgba[p] = luminance ? Color4(v[0], v[0], v[0], v[3]) : Color4(v[0], v[1], v[2], v[3]);
+            }
+            ImagePreprocessor::Stats expected;
+            referenceStats(rgba.getCArray(), n, expected);
+            checkStats(stats, expected);
+
+            // Adjusted
+            settings.modulate = modulate;
+            settings.gammaAdjust = gamma;
+            const ImageBuffer::Ref result = ImagePreprocessor::apply(src.getCArray(), width, height, format, settings, stats);
+            debugAssert(result.notNull() && (result->format() == format));
+            const uint8* dst = static_cast<const uint8*>(result->buffer());
+            for (int p = 0; p < n; ++p) {
+                float v[4] = {0, 0, 0, 1};
+                for (int c = 0; c < channels; ++c) {
+                    const int index = (luminance && (c == 1)) ? 3 : c;
+                    debugAssert(dst[p * channels + c] == table[index][src[p * channels + c]]);
+                    v[index] = dst[p * channels + c] / 255.0f;
+                }
+                rgba[p] = luminance ? Color4(v[0], v[0], v[0], v[3]) : Color4(v[0], v[1], v[2], v[3]);
+            }
+            referenceStats(rgba.getCArray(), n, expected);
+            checkStats(stats, expected);
+            (void)dst;
+        }
+    }
+}
+
+
+/** Floating-point images and formats processed through RGBA32F */
+void testFloat() {
+    const int width = 301, height = 257;
+    const int n = width * height;
+    Random rnd(10, false);
+
+    Array<Color4> src;
+    src.resize(n);
+    for (int i = 0; i < n; ++i) {
+        src[i] = Color4(rnd.uniform(-0.5f, 4.0f), rnd.uniform(), rnd.uniform(0.0f, 100.0f), rnd.uniform());
+    }
+
+    ImagePreprocessor::Settings settings;
+    settings.modulate = Color4(2.0f, 0.5f, 1.0f, 1.0f);
+    settings.gammaAdjust = 2.2f;
+    ImagePreprocessor::Stats stats;
+    const ImageBuffer::Ref result = ImagePreprocessor::apply(src.getCArray(), width, height, ImageFormat::RGBA32F(), settings, stats);
+
+    Array<Color4> expected;
+    expected.resize(n);
+    for (int i = 0; i < n; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            const float v = src[i][c] * settings.modulate[c];
+            expected[i][c] = (v > 0.0f) ? pow(v, settings.gammaAdjust) : v;
+        }
+    }
+    debugAssert(memcmp(expected.getCArray(), result->buffer(), n * sizeof(Color4)) == 0);
+
+    ImagePreprocessor::Stats expectedStats;
+    referenceStats(expected.getCArray(), n, expectedStats);
+    debugAssert(near(stats.minval, expectedStats.minval, 0.0f));
+    debugAssert(near(stats.maxval, expectedStats.maxval, 0.0f));
+    debugAssert(near(stats.meanval, expectedStats.meanval, expectedStats.maxval.b * 1e-5f));
+
+    // RGB32F reports alpha 1
+    Array<Color3> rgb;
+    rgb.resize(n);
+    for (int i = 0; i < n; ++i) {
+        rgb[i] = src[i].rgb();
+    }
+    settings = ImagePreprocessor::Settings();
+    ImagePreprocessor::apply(rgb.getCArray(), width, height, ImageFormat::RGB32F(), settings, stats);
+    for (int i = 0; i < n; ++i) {
+        src[i].a = 1.0f;
+    }
+    referenceStats(src.getCArray(), n, expectedStats);
+    debugAssert(near(stats.minval, expectedStats.minval, 0.0f));
+    debugAssert(near(stats.meanval, expectedStats.meanval, 1e-3f));
+
+    // BGR8 has no direct path
+    Array<uint8> bgr;
+    randomBytes(bgr, 3 * 41 * 5, 11);
+    settings.modulate = Color4(0.5f, 1.0f, 1.0f, 1.0f);
+    const ImageBuffer::Ref swizzled = ImagePreprocessor::apply(bgr.getCArray(), 41, 5, ImageFormat::BGR8(), settings, stats);
+    debugAssert(swizzled.notNull() && (swizzled->format() == ImageFormat::BGR8()));
+    const uint8* out = static_cast<const uint8*>(swizzled->buffer());
+    int maxRed = 0;
+    for (int i = 0; i < 41 * 5; ++i) {
+        debugAssert(abs(int(out[3 * i + 2]) - int(bgr[3 * i + 2]) / 2) <= 1);
+        debugAssert(out[3 * i] == bgr[3 * i]);
+        maxRed = max(maxRed, int(out[3 * i + 2]));
+    }
+    debugAssert(fabs(stats.maxval.r - maxRed / 255.0f) <= 1.0f / 255.0f);
+    (void)out; (void)maxRed;
+}
+
+
+void testNormalMap() {
+    const int size[][2] = {{1, 1}, {2, 5}, {37, 20}, {300, 260}};
+    const int channelCount[] = {1, 3, 4};
+    const ImageFormat* formats[] = {ImageFormat::L8(), ImageFormat::RGB8(), ImageFormat::RGBA8()};
+
+    for (int s = 0; s < 4; ++s) {
+        const int width = size[s][0], height = size[s][1];
+        for (int f = 0; f < 3; ++f) {
+            const int channels = channelCount[f];
+            Array<uint8> src;
+            randomBytes(src, width * height * channels, s * 3 + f);
+            // Smooth the heights so that the normals vary gradually
+            for (int i = channels; i < src.size(); ++i) {
+                src[i] = uint8((src[i] + 3 * int(src[i - channels])) / 4);
+            }
+
+            for (int variant = 0; variant < 4; ++variant) {
+                BumpMapPreprocess bump;
+                bump.lowPassFilter = (variant & 1) != 0;
+                bump.scaleZByNz    = (variant & 2) != 0;
+                bump.zExtentPixels = (variant == 3) ? 10.0f : -0.05f;
+
+                Array<Color4unorm8> expected;
+                expected.resize(width * height);
+                referenceNormalMap(width, height, channels, src.getCArray(), bump, expected.getCArray());
+
+                ImagePreprocessor::Settings settings;
+                settings.computeNormalMap = true;
+                settings.bumpMapPreprocess = bump;
+                ImagePreprocessor::Stats stats;
+                const ImageBuffer::Ref normal = ImagePreprocessor::apply(src.getCArray(), width, height, formats[f], settings, stats);
+                debugAssert(normal->format() == ImageFormat::RGBA8());
+                debugAssertM(memcmp(normal->buffer(), expected.getCArray(), width * height * 4) == 0,
+                             "Normal map differs from the scalar algorithm");
+                debugAssert(stats.minval.a <= stats.meanval.a && stats.meanval.a <= stats.maxval.a);
+            }
+
+            // Modulation happens before the normal map, and float heights give the same result
+            uint8 table[4][256];
+            const Color4 modulate(0.8f, 1.0f, 1.0f, 1.0f);
+            referenceTable(modulate, 1.0f, table);
+            Array<uint8> adjusted;
+            Array<float> heights;
+            adjusted.resize(src.size());
+            heights.resize(width * height);
+            for (int i = 0; i < src.size(); ++i) {
+                adjusted[i] = table[0][src[i]];
+            }
+            for (int i = 0; i < width * height; ++i) {
+                heights[i] = adjusted[i * channels] / 255.0f;
+            }
+            Array<Color4unorm8> expected;
+            expected.resize(width * height);
+            referenceNormalMap(width, height, channels, adjusted.getCArray(), BumpMapPreprocess(), expected.getCArray());
+
+            ImagePreprocessor::Settings settings;
+            settings.computeNormalMap = true;
+            settings.modulate = modulate;
+            ImagePreprocessor::Stats stats;
+            ImageBuffer::Ref normal = ImagePreprocessor::apply(src.getCArray(), width, height, formats[f], settings, stats);
+            debugAssert(memcmp(normal->buffer(), expected.getCArray(), width * height * 4) == 0);
+
+            settings.modulate = Color4::one();
+            normal = ImagePreprocessor::apply(heights.getCArray(), width, height, ImageFormat::R32F(), settings, stats);
+            const Color4unorm8* n = static_cast<const Color4unorm8*>(normal->buffer());
+            for (int i = 0; i < width * height; ++i) {
+                debugAssert(abs(int(n[i].r.bits()) - int(expected[i].r.bits())) <= 1);
+                debugAssert(abs(int(n[i].b.bits()) - int(expected[i].b.bits())) <= 1);
+                debugAssert(n[i].a == expected[i].a);
+            }
+            (void)n;
+        }
+    }
+
+    // BumpMap uses the same code
+    Array<uint8> src;
+    randomBytes(src, 64 * 32, 99);
+    Array<Color4unorm8> expected;
+    expected.resize(64 * 32);
+    referenceNormalMap(64, 32, 1, src.getCArray(), BumpMapPreprocess(), expected.getCArray());
+    ImagePreprocessor::Settings settings;
+    settings.computeNormalMap = true;
+    ImagePreprocessor::Stats stats;
+    debugAssert(memcmp(ImagePreprocessor::apply(src.getCArray(), 64, 32, ImageFormat::L8(), settings, stats)->buffer(),
+                               expected.getCArray(), 64 * 32 * 4) == 0);
+}
+
+
+void testUnsupported() {
+    debugAssert(! ImagePreprocessor::supports(ImageFormat::DEPTH24()));
+    uint32 depth[4] = {0, 0, 0, 0};
+    ImagePreprocessor::Settings settings;
+    settings.gammaAdjust = 2.0f;
+    ImagePreprocessor::Stats stats;
+    debugAssert(ImagePreprocessor::apply(depth, 2, 2, ImageFormat::DEPTH24(), settings, stats).isNull());
+    debugAssert(isNaN(stats.meanval.r));
+}
+
+} // namespace
+
+
+void testImagePreprocessor() {
+    printf("ImagePreprocessor ");
+    testBytes();
+    testFloat();
+    testNormalMap();
+    testUnsupported();
+    printf("passed\n");
+}
+
+
+void perfImagePreprocessor() {
+    printf("ImagePreprocessor performance:\n");
+
+    // 8K UHD
+    const int width = 7680, height = 4320, n = width * height;
+    const double mpix = n / 1e6;
+    Array<uint8> src;
+    randomBytes(src, n * 4, 12);
+    Stopwatch timer;
+
+    ImagePreprocessor::Settings settings;
+    ImagePreprocessor::Stats stats;
+
+    // Separate passes over the image, as Texture used to make them
+    {
+        uint8 table[4][256];
+        referenceTable(Color4(2, 2, 2, 1), 1.6f, table);
+        Array<uint8> copy;
+        timer.tick();
+        copy = src;
+        for (int i = 0; i < 4 * n; i += 4) {
+            for (int c = 0; c < 4; ++c) {
+                copy[i + c] = table[c][copy[i + c]];
+            }
+        }
+        Color4unorm8 mn = Color4unorm8::one(), mx = Color4unorm8::zero();
+        uint64 sum[4] = {0, 0, 0, 0};
+        const Color4unorm8* p = reinterpret_cast<const Color4unorm8*>(copy.getCArray());
+        for (int i = 0; i < n; ++i) {
+            mn = mn.min(p[i]);
+            mx = mx.max(p[i]);
+            sum[0] += p[i].r.bits(); sum[1] += p[i].g.bits(); sum[2] += p[i].b.bits(); sum[3] += p[i].a.bits();
+        }
+        timer.tock();
+        printf("  8K RGBA8 modulate + stats, separate passes %8.1f Mpixel/s  (%d)\n", mpix / timer.elapsedTime(), int(sum[0] & 1));
+    }
+
+    settings.modulate = Color4(2, 2, 2, 1);
+    settings.gammaAdjust = 1.6f;
+    timer.tick();
+    ImagePreprocessor::apply(src.getCArray(), width, height, ImageFormat::RGBA8(), settings, stats);
+    timer.tock();
+    printf("  8K RGBA8 modulate + stats, fused           %8.1f Mpixel/s\n", mpix / timer.elapsedTime());
+
+    settings = ImagePreprocessor::Settings();
+    timer.tick();
+    ImagePreprocessor::apply(src.getCArray(), width, height, ImageFormat::RGBA8(), settings, stats);
+    timer.tock();
+    printf("  8K RGBA8 stats                             %8.1f Mpixel/s\n", mpix / timer.elapsedTime());
+
+    {
+        Array<Color4unorm8> normal;
+        normal.resize(n);
+        timer.tick();
+        referenceNormalMap(width, height, 4, src.getCArray(), BumpMapPreprocess(), normal.getCArray());
+        timer.tock();
+        printf("  8K RGBA8 normal map, scalar                %8.1f Mpixel/s\n", mpix / timer.elapsedTime());
+    }
+
+    settings.computeNormalMap = true;
+    timer.tick();
+    ImagePreprocessor::apply(src.getCArray(), width, height, ImageFormat::RGBA8(), settings, stats);
+    timer.tock();
+    printf("  8K RGBA8 normal map + stats, fused         %8.1f Mpixel/s\n", mpix / timer.elapsedTime());
+
+    printf("  (%d threads)\n\n", ThreadPool::numThreads());
+}
@@ -0,0 +1,241 @@
+#include "G3D/G3DAll.h"
+
+namespace {
+
+ImageBuffer::Ref randomImage(int width, int height, const ImageFormat* format, int seed) {
+    Random rnd(seed, false);
+    const ImageBuffer::Ref image = ImageBuffer::create(width, height, format);
+    uint8* p = static_cast<uint8*>(image->buffer());
+    for (int i = 0; i < image->size(); ++i) {
+        p[i] = uint8(rnd.bits());
+    }
+    if (format->code == ImageFormat::CODE_RGBA32F) {
+        Color4* c = static_cast<Color4*>(image->buffer());
+        for (int i = 0; i < width * height; ++i) {
+            c[i] = Color4(rnd.uniform(), rnd.uniform(), rnd.uniform(), rnd.uniform());
+        }
+    }
+    return image;
+}
+
+
+ImageBuffer::Ref constantImage(int width, int height, const Color4unorm8& c) {
+    const ImageBuffer::Ref image = ImageBuffer::create(width, height, ImageFormat::RGBA8());
+    Color4unorm8* p = static_cast<Color4unorm8*>(image->buffer());
+    for (int i = 0; i < width * height; ++i) {
+        p[i] = c;
+    }
+    return image;
+}
+
+
+bool near(const Color4unorm8& a, const Color4unorm8& b, int tolerance) {
+    return (abs(int(a.r.bits()) - int(b.r.bits())) <= tolerance) &&
+        (abs(int(a.g.bits()) - int(b.g.bits())) <= tolerance) &&
+        (abs(int(a.b.bits()) - int(b.b.bits())) <= tolerance) &&
+        (abs(int(a.a.bits()) - int(b.a.bits())) <= tolerance);
+}
+
+
+/** Every filter reproduces a constant image at any scale */
+void testConstant() {
+    const Color4unorm8 c(unorm8::fromBits(100), unorm8::fromBits(150), unorm8::fromBits(200), unorm8::fromBits(77));
+    const ImageBuffer::Ref src = constantImage(37, 23, c);
+
+    for (int f = 0; f < 3; ++f) {
+        ImageResampler::Settings settings;
+        settings.filter = ImageResampler::Filter(ImageResampler::Filter::Value(f));
+
+        const int size[][2] = {{13, 41}, {74, 46}, {1, 1}, {37, 23}, {5, 200}};
+        for (int s = 0; s < 5; ++s) {
+            const ImageBuffer::Ref dst = ImageResampler::resample(src, size[s][0], size[s][1], settings);
+            debugAssert(dst.notNull());
+            debugAssert((dst->width() == size[s][0]) && (dst->height() == size[s][1]));
+            debugAssert(dst->format() == src->format());
+            const Color4unorm8* p = static_cast<const Color4unorm8*>(dst->buffer());
+            for (int i = 0; i < dst->width() * dst->height(); ++i) {
+                debugAssertM(near(p[i], c, 1), "Constant image changed by resampling");
+            }
+            (void)p;
+        }
+    }
+}
+
+
+/** 2:1 box filtering of a linear image is exactly the 2x2 average */
+void testBox() {
+    const ImageBuffer::Ref src = randomImage(16, 10, ImageFormat::RGBA32F(), 1);
+    ImageResampler::Settings settings;
+    settings.filter = ImageResampler::Filter::BOX;
+    const ImageBuffer::Ref dst = ImageResampler::resample(src, 8, 5, settings);
+
+    const Color4* s = static_cast<const Color4*>(src->buffer());
+    const Color4* d = static_cast<const Color4*>(dst->buffer());
+    for (int y = 0; y < 5; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            const Color4& expected =
+                (s[2 * x + 2 * y * 16] + s[2 * x + 1 + 2 * y * 16] +
+                 s[2 * x + (2 * y + 1) * 16] + s[2 * x + 1 + (2 * y + 1) * 16]) * 0.25f;
+            const Color4 error = d[x + y * 8] - expected;
+            debugAssert(max(max(fabs(error.r), fabs(error.g)), max(fabs(error.b), fabs(error.a))) < 1e-5f);
+            (void)error;
+        }
+    }
+    (void)s; (void)d;
+}
+
+
+/** Minifying a black and white checkerboard gives the sRGB code for half intensity */
+void testGamma() {
+    const ImageBuffer::Ref src = ImageBuffer::create(16, 16, ImageFormat::RGB8());
+    Color3unorm8* p = static_cast<Color3unorm8*>(src->buffer());
+    for (int y = 0; y < 16; ++y) {
+        for (int x = 0; x < 16; ++x) {
+            p[x + y * 16] = ((x + y) & 1) ? Color3unorm8::one() : Color3unorm8::zero();
+        }
+    }
+
+    ImageResampler::Settings settings;
+    settings.filter = ImageResampler::Filter::BOX;
+    for (int gamma = 0; gamma < 2; ++gamma) {
+        settings.gammaCorrect = (gamma == 1);
+        const ImageBuffer::Ref dst = ImageResampler::resample(src, 8, 8, settings);
+        const int expected = settings.gammaCorrect ? 188 : 128;
+        const Color3unorm8* d = static_cast<const Color3unorm8*>(dst->buffer());
+        for (int i = 0; i < 64; ++i) {
+            debugAssert(abs(int(d[i].r.bits()) - expected) <= 1);
+            debugAssert((d[i].r == d[i].g) && (d[i].r == d[i].b));
+        }
+        (void)d; (void)expected;
+    }
+
+    // SRGB8 is always decoded
+    settings.gammaCorrect = false;
+    const ImageBuffer::Ref srgb = ImageBuffer::create(16, 16, ImageFormat::SRGB8());
+    System::memcpy(srgb->buffer(), src->buffer(), src->size());
+    const ImageBuffer::Ref dst = ImageResampler::resample(srgb, 8, 8, settings);
+    debugAssert(abs(int(static_cast<const Color3unorm8*>(dst->buffer())[0].r.bits()) - 188) <= 1);
+}
+
+
+void testMipChain() {
+    const Color4unorm8 c(unorm8::fromBits(10), unorm8::fromBits(20), unorm8::fromBits(250), unorm8::fromBits(255));
+    const ImageBuffer::Ref src = constantImage(37, 10, c);
+    Array<ImageBuffer::Ref> levels;
+    ImageResampler::mipChain(src, levels);
+
+    const int size[][2] = {{37, 10}, {18, 5}, {9, 2}, {4, 1}, {2, 1}, {1, 1}};
+    debugAssert(levels.size() == 6);
+    debugAssert(levels[0] == src);
+    for (int i = 0; i < levels.size(); ++i) {
+        debugAssert((levels[i]->width() == size[i][0]) && (levels[i]->height() == size[i][1]));
+        debugAssert(near(*static_cast<const Color4unorm8*>(levels[i]->buffer()), c, 1));
+    }
+    (void)size;
+
+    // Each level matches resampling the previous one, up to rounding to 8 bits
+    const ImageBuffer::Ref image = randomImage(64, 32, ImageFormat::RGBA8(), 2);
+    ImageResampler::mipChain(image, levels);
+    debugAssert(levels.size() == 7);
+    const ImageBuffer::Ref half = ImageResampler::resample(image, 32, 16);
+    debugAssert(memcmp(half->buffer(), levels[1]->buffer(), half->size()) == 0);
+    const ImageBuffer::Ref quarter = ImageResampler::resample(levels[1], 16, 8);
+    const Color4unorm8* a = static_cast<const Color4unorm8*>(quarter->buffer());
+    const Color4unorm8* b = static_cast<const Color4unorm8*>(levels[2]->buffer());
+    for (int i = 0; i < 16 * 8; ++i) {
+        debugAssert(near(a[i], b[i], 2));
+    }
+    (void)a; (void)b;
+
+    // A 1x1 image is its own chain
+    ImageResampler::mipChain(constantImage(1, 1, c), levels);
+    debugAssert(levels.size() == 1);
+}
+
+
+/** Padded rows give the same pixels as packed rows */
+void testPadding() {
+    const int srcWidth = 13, srcHeight = 7, srcPad = 5;
+    const int dstWidth = 9, dstHeight = 4, dstPad = 3;
+    const ImageBuffer::Ref packed = randomImage(srcWidth, srcHeight, ImageFormat::RGB8(), 3);
+    const ImageBuffer::Ref expected = ImageResampler::resample(packed, dstWidth, dstHeight);
+
+    Array<uint8> src, dst;
+    src.resize((srcWidth * 3 + srcPad) * srcHeight);
+    dst.resize((dstWidth * 3 + dstPad) * dstHeight);
+    for (int y = 0; y < srcHeight; ++y) {
+        System::memcpy(src.getCArray() + y * (srcWidth * 3 + srcPad),
+                       static_cast<const uint8*>(packed->buffer()) + y * srcWidth * 3, srcWidth * 3);
+    }
+    System::memset(dst.getCArray(), 0xCD, dst.size());
+
+    const bool ok = ImageResampler::resample(src.getCArray(), srcWidth, srcHeight, srcPad * 8, ImageFormat::RGB8(),
+                                             dst.getCArray(), dstWidth, dstHeight, dstPad * 8);
+    debugAssert(ok);
+    (void)ok;
+    for (int y = 0; y < dstHeight; ++y) {
+        const uint8* row = dst.getCArray() + y * (dstWidth * 3 + dstPad);
+        debugAssert(memcmp(row, static_cast<const uint8*>(expected->buffer()) + y * dstWidth * 3, dstWidth * 3) == 0);
+        for (int i = 0; i < dstPad; ++i) {
+            debugAssertM(row[dstWidth * 3 + i] == 0xCD, "Wrote into row padding");
+        }
+        (void)row;
+    }
+}
+
+
+void testUnsupported() {
+    const ImageFormat* format = ImageFormat::DEPTH24();
+    debugAssert(! ImageResampler::supports(format));
+    debugAssert(ImageResampler::supports(ImageFormat::RGBA8()));
+    debugAssert(ImageResampler::supports(ImageFormat::RGB32F()));
+    debugAssert(ImageResampler::supports(ImageFormat::SRGB8()));
+
+    const ImageBuffer::Ref src = ImageBuffer::create(4, 4, format);
+    debugAssert(ImageResampler::resample(src, 2, 2).isNull());
+    Array<ImageBuffer::Ref> levels;
+    ImageResampler::mipChain(src, levels);
+    debugAssert(levels.size() == 0);
+}
+
+} // namespace
+
+
+void testImageResampler() {
+    printf("ImageResampler ");
+    testConstant();
+    testBox();
+    testGamma();
+    testMipChain();
+    testPadding();
+    testUnsupported();
+    printf("passed\n");
+}
+
+
+void perfImageResampler() {
+    printf("ImageResampler performance:\n");
+
+    // 8K UHD
+    const int width = 7680, height = 4320;
+    const ImageBuffer::Ref src = randomImage(width, height, ImageFormat::RGBA8(), 4);
+    const double mpix = width * height / 1e6;
+    Stopwatch timer;
+
+    for (int f = 0; f < 3; ++f) {
+        ImageResampler::Settings settings;
+        settings.filter = ImageResampler::Filter(ImageResampler::Filter::Value(f));
+        timer.tick();
+        const ImageBuffer::Ref dst = ImageResampler::resample(src, width / 2, height / 2, settings);
+        timer.tock();
+        printf("  8K RGBA8 half size, %-9s %8.1f Mpixel/s\n", settings.filter.toString(), mpix / timer.elapsedTime());
+    }
+
+    Array<ImageBuffer::Ref> levels;
+    timer.tick();
+    ImageResampler::mipChain(src, levels);
+    timer.tock();
+    printf("  8K RGBA8 MIP chain, %2d levels %8.1f Mpixel/s\n", levels.size(), mpix / timer.elapsedTime());
+
+    printf("  (%d threads)\n\n", ThreadPool::numThreads());
+}
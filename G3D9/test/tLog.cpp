@@ -0,0 +1,158 @@
+#include "G3D/G3DAll.h"
+
+namespace {
+
+/** Logs numbered lines from one of several threads */
+class LogProducer : public GThread {
+public:
+    Log*        log;
+    int         id;
+    int         count;
+
+    LogProducer(Log* l, int i, int n) : GThread("LogProducer"), log(l), id(i), count(n) {}
+
+protected:
+
+    virtual void threadMain() {
+        for (int i = 0; i < count; ++i) {
+            log->printf("thread %d message %d: the quick brown fox jumps over the lazy dog\n", id, i);
+        }
+    }
+};
+
+
+/** Runs numThreads LogProducers to completion and returns the elapsed time */
+RealTime produce(Log* log, int numThreads, int count) {
+    Array<LogProducer*> thread;
+    for (int t = 0; t < numThreads; ++t) {
+        thread.append(new LogProducer(log, t, count));
+    }
+
+    const RealTime start = System::time();
+    for (int t = 0; t < numThreads; ++t) {
+        thread[t]->start();
+    }
+    for (int t = 0; t < numThreads; ++t) {
+        thread[t]->waitForCompletion();
+    }
+    log->flush();
+    const RealTime elapsed = System::time() - start;
+
+    thread.deleteAll();
+    return elapsed;
+}
+
+
+/** Checks that every message in \a filename is intact and that each
+    thread's messages are in order */
+void checkOutput(const std::string& filename, int numThreads, int count) {
+    Array<std::string> line = stringSplit(readWholeFile(filename), '\n');
+    Array<int> next;
+    next.resize(numThreads);
+    for (int t = 0; t < numThreads; ++t) {
+        next[t] = 0;
+    }
+
+    int numMessages = 0;
+    for (int i = 0; i < line.size(); ++i) {
+        if (! beginsWith(line[i], "thread ")) {
+            continue;
+        }
+        int id = -1, m = -1;
+        char tail[100];
+        const int numRead = sscanf(line[i].c_str(), "thread %d message %d: %99[^\n]", &id, &m, tail);
+        alwaysAssertM((numRead == 3) && (id >= 0) && (id < numThreads), "Interleaved log line: " + line[i]);
+        alwaysAssertM(std::string(tail) == "the quick brown fox jumps over the lazy dog", "Interleaved log line: " + line[i]);
+        alwaysAssertM(m == next[id], "Out of order log line: " + line[i]);
+        ++next[id];
+        ++numMessages;
+    }
+    alwaysAssertM(numMessages == numThreads * count, "Missing log lines");
+}
+
+} // namespace
+
+
+void testLog() {
+    printf("Log ");
+
+    const std::string filename = "tLog-async.txt";
+    const int numThreads = 8;
+    const int count = 2000;
+    {
+        Log log(filename);
+        // A small queue, so that producers wait for the writer
+        log.setAsynchronous(true, 16 * 1024);
+        debugAssert(log.asynchronous());
+
+        produce(&log, numThreads, count);
+
+        // Messages that span several records, and one larger than the queue
+        const std::string longLine(300, 'x');
+        log.println(longLine);
+        const std::string hugeLine(100000, 'y');
+        log.println(hugeLine);
+        log.section("End");
+        // Empty messages occupy no records
+        log.print("");
+        log.printf("%s", "");
+        log.flush();
+
+        const std::string& s = readWholeFile(filename);
+        debugAssert(s.find(longLine + "\n") != std::string::npos);
+        debugAssert(s.find(hugeLine + "\n") != std::string::npos);
+        debugAssert(s.find("###    End    ###") != std::string::npos);
+
+        log.setAsynchronous(false);
+        debugAssert(! log.asynchronous());
+        log.println("synchronous");
+        debugAssert(endsWith(readWholeFile(filename), "synchronous\n"));
+    }
+    checkOutput(filename, numThreads, count);
+    debugAssert(readWholeFile(filename).find("Closing log file") != std::string::npos);
+    FileSystem::removeFile(filename);
+
+    {
+        // Leave asynchronous mode while other threads are logging.  No
+        // message may be lost or split, in either mode.
+        Log log(filename);
+        log.setAsynchronous(true, 16 * 1024);
+        Array<LogProducer*> thread;
+        for (int t = 0; t < numThreads; ++t) {
+            thread.append(new LogProducer(&log, t, count));
+            thread.last()->start();
+        }
+        System::sleep(0.002);
+        log.setAsynchronous(false);
+        for (int t = 0; t < numThreads; ++t) {
+            thread[t]->waitForCompletion();
+        }
+        thread.deleteAll();
+    }
+    checkOutput(filename, numThreads, count);
+    FileSystem::removeFile(filename);
+
+    printf("passed\n");
+}
+
+
+void perfLog() {
+    printf("Log performance:\n");
+
+    const int numThreads = 8;
+    const int count = 20000;
+    for (int asynchronous = 0; asynchronous < 2; ++asynchronous) {
+        const std::string filename = "tLog-perf.txt";
+        RealTime elapsed = 0;
+        {
+            Log log(filename);
+            log.setAsynchronous(asynchronous != 0);
+            elapsed = produce(&log, numThreads, count);
+        }
+        FileSystem::removeFile(filename);
+
+        printf("  %s, %d threads: %9.0f messages/s\n", asynchronous ? "Asynchronous" : "Synchronous ",
+               numThreads, numThreads * count / elapsed);
+    }
+    printf("\n");
+}
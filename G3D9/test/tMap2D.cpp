@@ -1,4 +1,10 @@
 #include "G3D/Map2D.h"
+#include "G3D/Image1.h"
+#include "G3D/Image3.h"
+#include "G3D/Image4.h"
+#include "G3D/Random.h"
+#include "G3D/Stopwatch.h"
+#include "G3D/ThreadPool.h"
 
 using namespace G3D;
 
@@ -42,6 +48,270 @@ void testBicubic() {
 }
 
 
+namespace {
+
+/** Positions covering the image and a border of 3 pixels around it */
+void randomPositions(int width, int height, int n, Array<Vector2>& pos) {
+    Random rnd(n, false);
+    pos.resize(n);
+    for (int i = 0; i < n; ++i) {
+        pos[i] = Vector2(rnd.uniform(-3.0f, width + 3.0f), rnd.uniform(-3.0f, height + 3.0f));
+    }
+    // Exact integers and the far edges
+    pos[0] = Vector2(0, 0);
+    pos[1] = Vector2(float(width - 1), float(height - 1));
+    pos[2] = Vector2(2.0f, 1.0f);
+}
+
+
+Image3::Ref randomImage3(int width, int height) {
+    Random rnd(width * height, false);
+    Image3::Ref im = Image3::createEmpty(width, height);
+    for (int i = 0; i < width * height; ++i) {
+        im->getCArray()[i] = Color3(rnd.uniform(), rnd.uniform(), rnd.uniform());
+    }
+    return im;
+}
+
+
+Image1::Ref randomImage1(int width, int height) {
+    Random rnd(width + height, false);
+    Image1::Ref im = Image1::createEmpty(width, height);
+    for (int i = 0; i < width * height; ++i) {
+        im->getCArray()[i] = Color1(rnd.uniform());
+    }
+    return im;
+}
+
+
+bool near(const Color3& a, const Color3& b, float tolerance) {
+    return (fabs(a.r - b.r) <= tolerance) && (fabs(a.g - b.g) <= tolerance) && (fabs(a.b - b.b) <= tolerance);
+}
+
+
+/** The SIMD batch gives exactly the single-sample results for every wrap mode and batch size */
+void testBatchFloat() {
+    const Image3::Ref im3 = randomImage3(37, 23);
+    const Image1::Ref im1 = randomImage1(37, 23);
+    Image4::Ref im4 = Image4::createEmpty(37, 23);
+    for (int i = 0; i < 37 * 23; ++i) {
+        im4->getCArray()[i] = Color4(im3->getCArray()[i], im1->getCArray()[i].value);
+    }
+
+    const WrapMode wrap[] = {WrapMode::CLAMP, WrapMode::TILE, WrapMode::ZERO};
+    const int size[] = {0, 1, 3, 4, 1001, 20003};
+    for (int w = 0; w < 3; ++w) {
+        for (int s = 0; s < 6; ++s) {
+            Array<Vector2> pos;
+            randomPositions(37, 23, max(3, size[s]), pos);
+            pos.resize(size[s]);
+
+            Array<Color3> r3;
+            Array<Color1> r1;
+            Array<Color4> r4;
+            im3->bilinear(pos, r3, wrap[w]);
+            im1->bilinear(pos, r1, wrap[w]);
+            im4->bilinear(pos, r4, wrap[w]);
+            debugAssert((r3.size() == pos.size()) && (r1.size() == pos.size()) && (r4.size() == pos.size()));
+            for (int i = 0; i < pos.size(); ++i) {
+                debugAssertM(r3[i] == im3->bilinear(pos[i], wrap[w]), "Batch bilinear differs from bilinear");
+                debugAssert(r1[i].value == im1->bilinear(pos[i], wrap[w]).value);
+                debugAssert(r4[i] == im4->bilinear(pos[i], wrap[w]));
+            }
+
+            im3->bicubic(pos, r3, wrap[w]);
+            im1->bicubic(pos, r1, wrap[w]);
+            for (int i = 0; i < pos.size(); ++i) {
+                debugAssertM(near(r3[i], im3->bicubic(pos[i], wrap[w]), 1e-5f), "Batch bicubic differs from bicubic");
+                debugAssert(fabs(r1[i].value - im1->bicubic(pos[i], wrap[w]).value) <= 1e-5f);
+            }
+        }
+    }
+
+    // The image's own wrap mode and the pointer version
+    im3->setWrapMode(WrapMode::TILE);
+    Array<Vector2> pos;
+    randomPositions(37, 23, 9, pos);
+    Color3 r[9];
+    im3->bilinear(pos.getCArray(), r, 9);
+    for (int i = 0; i < 9; ++i) {
+        debugAssert(r[i] == im3->bilinear(pos[i]));
+    }
+}
+
+
+/** Types without a SIMD kernel, and float32 with its float64 Compute type */
+void testBatchGeneric() {
+    typedef Map2D<uint8> ByteMap;
+    typedef Map2D<float> FloatMap;
+    ByteMap::Ref bytes = ByteMap::create(19, 11, WrapMode::CLAMP);
+    FloatMap::Ref floats = FloatMap::create(19, 11, WrapMode::CLAMP);
+    Random rnd(5, false);
+    for (int i = 0; i < 19 * 11; ++i) {
+        bytes->getCArray()[i] = uint8(rnd.bits());
+        floats->getCArray()[i] = rnd.uniform();
+    }
+
+    const WrapMode wrap[] = {WrapMode::CLAMP, WrapMode::TILE, WrapMode::ZERO};
+    Array<Vector2> pos;
+    randomPositions(19, 11, 9001, pos);
+    for (int w = 0; w < 3; ++w) {
+        Array<float> b;
+        Array<double> f;
+        bytes->bilinear(pos, b, wrap[w]);
+        floats->bilinear(pos, f, wrap[w]);
+        for (int i = 0; i < pos.size(); ++i) {
+            debugAssert(b[i] == bytes->bilinear(pos[i], wrap[w]));
+            debugAssert(fabs(f[i] - floats->bilinear(pos[i], wrap[w])) <= 1e-6);
+        }
+
+        bytes->bicubic(pos, b, wrap[w]);
+        floats->bicubic(pos, f, wrap[w]);
+        for (int i = 0; i < pos.size(); ++i) {
+            debugAssert(fabs(b[i] - bytes->bicubic(pos[i], wrap[w])) <= 1e-3f);
+            debugAssert(fabs(f[i] - floats->bicubic(pos[i], wrap[w])) <= 1e-5);
+        }
+    }
+}
+
+
+class Scale {
+public:
+    float s;
+    explicit Scale(float s) : s(s) {}
+    void operator()(int x, int y, Color3& c) const {
+        (void)x; (void)y;
+        c *= s;
+    }
+};
+
+
+/** Copies each pixel to an array indexed by position */
+class Gather {
+public:
+    Color3* dst;
+    int width;
+    Gather(Color3* dst, int width) : dst(dst), width(width) {}
+    void operator()(int x, int y, const Color3& c) const {
+        dst[x + y * width] = c;
+    }
+};
+
+
+class Luminance {
+public:
+    Color1 operator()(const Color3& c) const {
+        return Color1(c.r * 0.25f + c.g * 0.5f + c.b * 0.25f);
+    }
+};
+
+
+void testForEachPixel() {
+    // Tall enough that several tasks run
+    const int width = 301, height = 200;
+    const Image3::Ref original = randomImage3(width, height);
+    Image3::Ref im = randomImage3(width, height);
+
+    im->setChanged(false);
+    im->forEachPixel(Scale(2.0f));
+    debugAssert(im->changed());
+    for (int i = 0; i < width * height; ++i) {
+        debugAssert(im->getCArray()[i] == original->getCArray()[i] * 2.0f);
+    }
+
+    Array<Color3> copy;
+    copy.resize(width * height);
+    const Image3::Ref& constIm = original;
+    static_cast<const Map2D<Color3, Color3>&>(*constIm).forEachPixel(Gather(copy.getCArray(), width));
+    debugAssert(memcmp(copy.getCArray(), original->getCArray(), sizeof(Color3) * width * height) == 0);
+
+    Image1::Ref lum = Image1::createEmpty(1, 1);
+    lum->map(*original, Luminance());
+    debugAssert((lum->width() == width) && (lum->height() == height));
+    for (int i = 0; i < width * height; ++i) {
+        debugAssert(lum->getCArray()[i].value == Luminance()(original->getCArray()[i]).value);
+    }
+}
+
+} // namespace
+
+
 void testMap2D() {
     testBicubic();
+    testBatchFloat();
+    testBatchGeneric();
+    testForEachPixel();
+}
+
+
+namespace {
+
+template<class Image, class Value>
+void perfSampling(const char* name, const typename Image::Ref& im, const Array<Vector2>& pos) {
+    Array<Value> result;
+    result.resize(pos.size());
+    const double msamples = pos.size() / 1e6;
+    Stopwatch timer;
+
+    timer.tick();
+    for (int i = 0; i < pos.size(); ++i) {
+        result[i] = im->bilinear(pos[i]);
+    }
+    timer.tock();
+    const double scalarBilinear = msamples / timer.elapsedTime();
+
+    timer.tick();
+    im->bilinear(pos, result);
+    timer.tock();
+    const double batchBilinear = msamples / timer.elapsedTime();
+
+    timer.tick();
+    for (int i = 0; i < pos.size(); ++i) {
+        result[i] = im->bicubic(pos[i]);
+    }
+    timer.tock();
+    const double scalarBicubic = msamples / timer.elapsedTime();
+
+    timer.tick();
+    im->bicubic(pos, result);
+    timer.tock();
+    const double batchBicubic = msamples / timer.elapsedTime();
+
+    printf("  %s bilinear  %7.1f -> %7.1f Msample/s\n", name, scalarBilinear, batchBilinear);
+    printf("  %s bicubic   %7.1f -> %7.1f Msample/s\n", name, scalarBicubic, batchBicubic);
+}
+
+} // namespace
+
+
+void perfMap2D() {
+    printf("Map2D performance (single sample -> batch):\n");
+
+    const int width = 2048, height = 2048;
+    const Image3::Ref im3 = randomImage3(width, height);
+    const Image1::Ref im1 = randomImage1(width, height);
+    im3->setWrapMode(WrapMode::CLAMP);
+    im1->setWrapMode(WrapMode::CLAMP);
+
+    Array<Vector2> pos;
+    randomPositions(width, height, 1 << 22, pos);
+
+    perfSampling<Image3, Color3>("Image3", im3, pos);
+    perfSampling<Image1, Color1>("Image1", im1, pos);
+
+    Stopwatch timer;
+    timer.tick();
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            im3->get(x, y) *= 1.01f;
+        }
+    }
+    timer.tock();
+    const double serial = width * height / 1e6 / timer.elapsedTime();
+
+    timer.tick();
+    im3->forEachPixel(Scale(1.01f));
+    timer.tock();
+    printf("  Image3 scale pixels %7.1f -> %7.1f Mpixel/s with forEachPixel\n", serial, width * height / 1e6 / timer.elapsedTime());
+    printf("  (%d threads)\n\n", ThreadPool::numThreads());
 }
@@ -0,0 +1,223 @@
+#include "G3D/G3DAll.h"
+#include "GLG3D/GLG3D.h"
+#include "BoundsSurface.h"
+
+namespace {
+
+GCamera makeCamera() {
+    GCamera camera;
+    camera.setFieldOfView(toRadians(90), GCamera::HORIZONTAL);
+    camera.setNearPlaneZ(-0.1f);
+    camera.setFarPlaneZ(-1000.0f);
+    return camera;
+}
+
+
+/** Appends the two triangles of the rectangle at z spanning [x0, x1] x [y0, y1] */
+void addRect(Array<Vector3>& vertex, Array<int>& index, float x0, float x1, float y0, float y1, float z) {
+    const int v = vertex.size();
+    vertex.append(Vector3(x0, y0, z), Vector3(x1, y0, z), Vector3(x1, y1, z), Vector3(x0, y1, z));
+    index.append(v, v + 1, v + 2);
+    index.append(v, v + 2, v + 3);
+}
+
+
+/** True if the segment from the camera to p passes through a triangle */
+bool blocked(const Point3& eye, const Point3& p, const Array<Vector3>& vertex, const Array<int>& index) {
+    const Vector3& d = p - eye;
+    const float distance = d.length();
+    const Ray& ray = Ray::fromOriginAndDirection(eye, d / distance);
+    for (int i = 0; i < index.size(); i += 3) {
+        const Vector3& a = vertex[index[i]];
+        const Vector3& b = vertex[index[i + 1]];
+        const Vector3& c = vertex[index[i + 2]];
+        const float t = min(ray.intersectionTime(a, b, c), ray.intersectionTime(a, c, b));
+        if (t < distance) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void testWall() {
+    const GCamera& camera = makeCamera();
+    const Rect2D viewport = Rect2D::xywh(0, 0, 800, 400);
+
+    Array<Vector3> vertex;
+    Array<int> index;
+    addRect(vertex, index, -5, 5, -20, 20, -10);
+
+    OcclusionCuller occlusion(128, 64);
+    occlusion.setCamera(camera, viewport);
+    occlusion.rasterizeOccluders(vertex, index);
+    debugAssert(occlusion.numOccluderTriangles() == 2);
+
+    // The wall is conservatively at or beyond its true depth, and the
+    // sky beside it is empty
+    const float center = occlusion.depth(occlusion.width() / 2, occlusion.height() / 2);
+    debugAssert(center >= 10.0f && center < 10.1f);
+    debugAssert(occlusion.depth(0, occlusion.height() / 2) == finf());
+    (void)center;
+
+    // Each hierarchy level bounds the one below it
+    for (int L = 1; L < occlusion.numLevels(); ++L) {
+        const int w = max(occlusion.width() >> L, 1);
+        const int h = max(occlusion.height() >> L, 1);
+        const int childW = max(occlusion.width() >> (L - 1), 1);
+        const int childH = max(occlusion.height() >> (L - 1), 1);
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                const float d = occlusion.depth(x, y, L);
+                for (int cy = 2 * y; cy < iMin(2 * y + 2, childH); ++cy) {
+                    for (int cx = 2 * x; cx < iMin(2 * x + 2, childW); ++cx) {
+                        debugAssert(d >= occlusion.depth(cx, cy, L - 1));
+                    }
+                }
+                (void)d;
+            }
+        }
+    }
+
+    // Behind the wall
+    debugAssert(occlusion.isOccluded(AABox(Point3(-1, -1, -21), Point3(1, 1, -19))));
+    debugAssert(occlusion.isOccluded(AABox(Point3(-4, -10, -100), Point3(4, 10, -50))));
+
+    // In front of the wall, straddling it, beside it, and crossing the near plane
+    debugAssert(! occlusion.isOccluded(AABox(Point3(-1, -1, -6), Point3(1, 1, -4))));
+    debugAssert(! occlusion.isOccluded(AABox(Point3(-1, -1, -12), Point3(1, 1, -8))));
+    debugAssert(! occlusion.isOccluded(AABox(Point3(9, -1, -21), Point3(11, 1, -19))));
+    debugAssert(! occlusion.isOccluded(AABox(Point3(14, -1, -21), Point3(16, 1, -19))));
+    debugAssert(! occlusion.isOccluded(AABox(Point3(-1, -1, -21), Point3(1, 1, 1))));
+
+    // Surface interface
+    Array<Surface::Ref> surfaceArray;
+    surfaceArray.append(new BoundsSurface(CFrame(Vector3(0, 0, -20)), AABox(Point3(-1, -1, -1), Point3(1, 1, 1))));
+    surfaceArray.append(new BoundsSurface(CFrame(Vector3(0, 0, -5)),  AABox(Point3(-1, -1, -1), Point3(1, 1, 1))));
+    surfaceArray.append(new BoundsSurface(CFrame(Vector3(15, 0, -20)), AABox(Point3(-1, -1, -1), Point3(1, 1, 1))));
+    occlusion.cull(surfaceArray);
+    debugAssert(surfaceArray.size() == 2);
+
+    // A new camera clears the buffer
+    occlusion.setCamera(camera, viewport);
+    debugAssert(! occlusion.isOccluded(AABox(Point3(-1, -1, -21), Point3(1, 1, -19))));
+}
+
+
+/** Every box reported as occluded must have all of its visible sample points hidden by a triangle */
+void testRandomConservative() {
+    Random rnd(1, false);
+    GCamera camera = makeCamera();
+    camera.setCoordinateFrame(CFrame::fromXYZYPRDegrees(0, 0, 0, 10, -5));
+    const Rect2D viewport = Rect2D::xywh(0, 0, 640, 480);
+    const Point3& eye = camera.coordinateFrame().translation;
+
+    Array<Vector3> vertex;
+    Array<int> index;
+    for (int i = 0; i < 30; ++i) {
+        const float x = rnd.uniform(-30, 30);
+        const float y = rnd.uniform(-20, 20);
+        const float z = rnd.uniform(-40, -5);
+        addRect(vertex, index, x, x + rnd.uniform(2, 20), y, y + rnd.uniform(2, 20), z);
+    }
+    // Some tilted and near-clipped triangles
+    for (int i = 0; i < 20; ++i) {
+        const Vector3 c(rnd.uniform(-20, 20), rnd.uniform(-20, 20), rnd.uniform(-30, 2));
+        vertex.append(c + Vector3::random(rnd) * 10, c + Vector3::random(rnd) * 10, c + Vector3::random(rnd) * 10);
+        index.append(vertex.size() - 3, vertex.size() - 2, vertex.size() - 1);
+    }
+
+    OcclusionCuller occlusion(256, 128);
+    occlusion.setCamera(camera, viewport);
+    occlusion.rasterizeOccluders(vertex, index);
+
+    Array<Plane> clipPlanes;
+    camera.getClipPlanes(viewport, clipPlanes);
+
+    int numOccluded = 0;
+    for (int b = 0; b < 2000; ++b) {
+        const Point3 lo(rnd.uniform(-60, 60), rnd.uniform(-40, 40), rnd.uniform(-80, -1));
+        const AABox box(lo, lo + Vector3(rnd.uniform(0.1f, 4), rnd.uniform(0.1f, 4), rnd.uniform(0.1f, 4)));
+        if (! occlusion.isOccluded(box)) {
+            continue;
+        }
+        ++numOccluded;
+
+        // Sample the surface of the box
+        for (int s = 0; s < 200; ++s) {
+            Point3 p(rnd.uniform(box.low().x, box.high().x), rnd.uniform(box.low().y, box.high().y), rnd.uniform(box.low().z, box.high().z));
+            const int axis = rnd.integer(0, 2);
+            p[axis] = (rnd.integer(0, 1) == 0) ? box.low()[axis] : box.high()[axis];
+            if (s < 8) {
+                p = box.corner(s);
+            }
+
+            bool inFrustum = true;
+            for (int c = 0; c < clipPlanes.size(); ++c) {
+                inFrustum = inFrustum && clipPlanes[c].halfSpaceContains(p);
+            }
+            alwaysAssertM(! inFrustum || blocked(eye, p, vertex, index), "OcclusionCuller culled a visible box");
+        }
+    }
+    debugAssert(numOccluded > 100);
+    (void)numOccluded;
+}
+
+} // namespace
+
+
+void testOcclusionCuller() {
+    printf("OcclusionCuller ");
+    testWall();
+    testRandomConservative();
+    printf("passed\n");
+}
+
+
+void perfOcclusionCuller() {
+    printf("OcclusionCuller performance:\n");
+
+    Random rnd(1, false);
+    const GCamera& camera = makeCamera();
+    const Rect2D viewport = Rect2D::xywh(0, 0, 1280, 720);
+
+    // A city block of walls, and objects among them
+    Array<Vector3> vertex;
+    Array<int> index;
+    for (int i = 0; i < 500; ++i) {
+        const float x = rnd.uniform(-200, 200);
+        const float z = rnd.uniform(-400, -10);
+        addRect(vertex, index, x, x + rnd.uniform(5, 40), -10, rnd.uniform(5, 40), z);
+    }
+
+    Array<AABox> box;
+    for (int i = 0; i < 50000; ++i) {
+        const Point3 lo(rnd.uniform(-200, 200), rnd.uniform(-10, 10), rnd.uniform(-400, -10));
+        box.append(AABox(lo, lo + Vector3(2, 2, 2)));
+    }
+
+    OcclusionCuller occlusion(256, 128);
+    const int trials = 20;
+    Stopwatch timer;
+
+    timer.tick();
+    for (int t = 0; t < trials; ++t) {
+        occlusion.setCamera(camera, viewport);
+        occlusion.rasterizeOccluders(vertex, index);
+    }
+    timer.tock();
+    printf("  Rasterize %d occluder triangles at %dx%d: %6.3f ms\n", index.size() / 3, occlusion.width(), occlusion.height(),
+           1000 * timer.elapsedTime() / trials);
+
+    int numOccluded = 0;
+    timer.tick();
+    for (int t = 0; t < trials; ++t) {
+        numOccluded = 0;
+        for (int i = 0; i < box.size(); ++i) {
+            numOccluded += occlusion.isOccluded(box[i]) ? 1 : 0;
+        }
+    }
+    timer.tock();
+    printf("  Test %d boxes (%d occluded):  %6.3f ms\n", box.size(), numOccluded, 1000 * timer.elapsedTime() / trials);
+    printf("\n");
+}
@@ -0,0 +1,259 @@
+#include "G3D/G3DAll.h"
+using G3D::uint8;
+using G3D::uint32;
+using G3D::uint64;
+
+namespace {
+
+/** An OBJ text with every record type, several groups and materials,
+    relative indices, comments, and mixed line endings */
+std::string makeTestOBJ(int numQuads) {
+    std::string s = "# test\nmtllib tParseOBJ.mtl\n";
+    Random r(101, false);
+    const char* material[] = {"red", "green", "blue"};
+
+    for (int q = 0; q < numQuads; ++q) {
+        if (q % 97 == 0) {
+            s += format("g group%d\n", (q / 97) % 5);
+        }
+        if (q % 41 == 0) {
+            s += format("usemtl %s\r\n", material[(q / 41) % 3]);
+        }
+
+        for (int i = 0; i < 4; ++i) {
+            s += format("v %.7g %f %e\n", r.uniform(-1e4f, 1e4f), r.uniform(-1, 1), r.uniform(-1e-3f, 1e-3f));
+            s += format("vt %g %g\nvn 0 1 0\n", r.uniform(), r.uniform());
+        }
+
+        if (q % 3 == 0) {
+            // Relative indices
+            s += "f -4/-4/-4 -3/-3/-3 -2/-2/-2 -1/-1/-1\n";
+        } else if (q % 3 == 1) {
+            const int b = q * 4 + 1;
+            s += format("f %d/%d/%d %d/%d/%d %d/%d/%d\n\n", b, b, b, b + 1, b + 1, b + 1, b + 2, b + 2, b + 2);
+        } else {
+            const int b = q * 4 + 1;
+            s += format("f %d//%d %d//%d   %d//%d # comment\r\n", b, b, b + 2, b + 2, b + 3, b + 3);
+        }
+    }
+
+    return s;
+}
+
+
+bool sameIndex(const ParseOBJ::Index& a, const ParseOBJ::Index& b) {
+    return (a.vertex == b.vertex) && (a.texCoord == b.texCoord) && (a.normal == b.normal);
+}
+
+
+template<class T>
+bool sameArray(const Array<T>& a, const Array<T>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (int i = 0; i < a.size(); ++i) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/** Returns true if two parses produced the same data */
+bool sameParse(const ParseOBJ& a, const ParseOBJ& b) {
+    if (! sameArray(a.vertexArray, b.vertexArray) || ! sameArray(a.texCoordArray, b.texCoordArray) ||
+        ! sameArray(a.normalArray, b.normalArray) || (a.groupTable.size() != b.groupTable.size())) {
+        return false;
+    }
+
+    for (ParseOBJ::GroupTable::Iterator git = a.groupTable.begin(); git.hasMore(); ++git) {
+        if (! b.groupTable.containsKey(git->key)) {
+            return false;
+        }
+        const ParseOBJ::Group::Ref& ga = git->value;
+        const ParseOBJ::Group::Ref& gb = b.groupTable[git->key];
+        if (ga->meshTable.size() != gb->meshTable.size()) {
+            return false;
+        }
+
+        // The materials are different objects in the two parses, so match by name
+        for (ParseOBJ::MeshTable::Iterator mit = ga->meshTable.begin(); mit.hasMore(); ++mit) {
+            ParseOBJ::Mesh::Ref mb;
+            for (ParseOBJ::MeshTable::Iterator it = gb->meshTable.begin(); it.hasMore(); ++it) {
+                if (it->key->name == mit->key->name) {
+                    mb = it->value;
+                }
+            }
+            if (mb.isNull()) {
+                return false;
+            }
+
+            const Array<ParseOBJ::Face>& fa = mit->value->faceArray;
+            const Array<ParseOBJ::Face>& fb = mb->faceArray;
+            if (fa.size() != fb.size()) {
+                return false;
+            }
+            for (int f = 0; f < fa.size(); ++f) {
+                if (fa[f].size() != fb[f].size()) {
+                    return false;
+                }
+                for (int i = 0; i < fa[f].size(); ++i) {
+                    if (! sameIndex(fa[f][i], fb[f][i])) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+int countFaces(const ParseOBJ& p) {
+    int n = 0;
+    for (ParseOBJ::GroupTable::Iterator git = p.groupTable.begin(); git.hasMore(); ++git) {
+        for (ParseOBJ::MeshTable::Iterator mit = git->value->meshTable.begin(); mit.hasMore(); ++mit) {
+            n += mit->value->faceArray.size();
+        }
+    }
+    return n;
+}
+
+
+void testNumbers() {
+    Random r(7, false);
+    std::string s;
+    Array<float> expected;
+    const char* fmt[] = {"%.9g", "%f", "%e", "%.3E", "%.15f", "%+.2f"};
+    for (int i = 0; i < 600; ++i) {
+        const double x = r.uniform(-1, 1) * pow(10.0, r.integer(-12, 12));
+        const std::string& t = format(fmt[i % 6], x);
+        s += "vt " + t + " 0\n";
+        expected.append((float)strtod(t.c_str(), NULL));
+    }
+    s += "vt 0.12345678901234567890123 -00012.5\nvt 1e0 .5\n";
+    expected.append(0.12345679f);
+    expected.append(1.0f);
+
+    ParseOBJ p;
+    p.parse(s.c_str(), s.size(), ".");
+    debugAssert(p.texCoordArray.size() == expected.size());
+    for (int i = 0; i < expected.size(); ++i) {
+        // Allow for double rounding through double precision
+        debugAssert(fuzzyEq(p.texCoordArray[i].x, expected[i]) ||
+                    (abs(p.texCoordArray[i].x - expected[i]) <= abs(expected[i]) * 1e-7f));
+    }
+    debugAssert(p.texCoordArray[600].y == -12.5f);
+    debugAssert(p.texCoordArray[601].y == 0.5f);
+}
+
+} // namespace
+
+
+void testParseOBJ() {
+    printf("ParseOBJ ");
+
+    writeWholeFile("tParseOBJ.mtl", "newmtl red\nKd 1 0 0\nnewmtl green\nKd 0 1 0\nnewmtl blue\nKd 0 0 1\n");
+
+    testNumbers();
+
+    {
+        // Faces after a group command belong to that group
+        const std::string s = "v 0 0 0\nv 1 0 0\nv 0 1 0\ng a\nf 1 2 3\ng b\nf 1 2 3\nf 3 2 1\n";
+        ParseOBJ p;
+        p.parse(s.c_str(), s.size(), ".");
+        debugAssert(p.groupTable.size() == 2);
+        debugAssert(countFaces(p) == 3);
+        debugAssert(p.groupTable["b"]->meshTable.size() == 1);
+        ParseOBJ::MeshTable::Iterator it = p.groupTable["b"]->meshTable.begin();
+        debugAssert(it->value->faceArray.size() == 2);
+    }
+
+    {
+        // The parallel parse, which needs at least two MIN_CHUNK_LENGTH chunks,
+        // must match the serial one exactly
+        const std::string& s = makeTestOBJ(20000);
+        debugAssert(s.size() > 3 * 1024 * 1024);
+
+        ParseOBJ serial;
+        serial.parse(s.c_str(), s.size(), ".", 1);
+        debugAssert(serial.vertexArray.size() == 80000);
+        debugAssert(serial.groupTable.size() == 5);
+        debugAssert(countFaces(serial) == 20000);
+
+        ParseOBJ parallel;
+        parallel.parse(s.c_str(), s.size(), ".", 4);
+        debugAssert(sameParse(serial, parallel));
+    }
+
+    {
+        // Errors report the line in the whole file
+        std::string s = makeTestOBJ(20000);
+        int line = 1;
+        for (size_t i = 0; i < s.size() * 3 / 4; ++i) {
+            if (s[i] == '\n') {
+                ++line;
+            }
+        }
+        const size_t lineStart = s.rfind('\n', s.size() * 3 / 4) + 1;
+        s.insert(lineStart, "g \n");
+
+        bool threw = false;
+        try {
+            ParseOBJ p;
+            p.parse(s.c_str(), s.size(), ".", 4);
+        } catch (const ParseError& e) {
+            threw = true;
+            debugAssertM(e.line == line + 1, format("Error reported on line %d instead of %d", e.line, line + 1));
+        }
+        debugAssert(threw);
+    }
+
+    FileSystem::removeFile("tParseOBJ.mtl");
+
+    printf("passed\n");
+}
+
+
+void perfParseOBJ() {
+    printf("ParseOBJ performance:\n");
+
+    // A height field with 10M triangles
+    const int N = 2237;
+    std::string s;
+    {
+        s.reserve(size_t(N) * N * 70);
+        char line[100];
+        for (int y = 0; y < N; ++y) {
+            for (int x = 0; x < N; ++x) {
+                const int n = sprintf(line, "v %f %f %f\nvt %f %f\n", x * 0.01f, sin(x * 0.1f) * cos(y * 0.1f), y * 0.01f,
+                                      float(x) / N, float(y) / N);
+                s.append(line, n);
+            }
+        }
+        for (int y = 0; y < N - 1; ++y) {
+            for (int x = 0; x < N - 1; ++x) {
+                const int a = y * N + x + 1;
+                const int n = sprintf(line, "f %d/%d %d/%d %d/%d\nf %d/%d %d/%d %d/%d\n",
+                                      a, a, a + N, a + N, a + 1, a + 1,
+                                      a + 1, a + 1, a + N, a + N, a + N + 1, a + N + 1);
+                s.append(line, n);
+            }
+        }
+    }
+    printf("  %d triangles, %.0f MB of text\n", 2 * (N - 1) * (N - 1), s.size() / (1024.0 * 1024.0));
+
+    for (int parallel = 0; parallel < 2; ++parallel) {
+        Stopwatch timer;
+        timer.tick();
+        {
+            ParseOBJ p;
+            p.parse(s.c_str(), s.size(), ".", parallel ? ThreadPool::NUM_CORES : 1);
+            timer.tock();
+        }
+        printf("  %-34s %6.2f s\n", parallel ? format("parallel (%d threads):", ThreadPool::numThreads()).c_str() : "serial:",
+               timer.elapsedTime());
+    }
+    printf("\n");
+}
@@ -0,0 +1,240 @@
+#include "G3D/G3DAll.h"
+using G3D::uint8;
+using G3D::uint32;
+using G3D::uint64;
+
+namespace {
+
+enum Layout {
+    /** float x, y, z and a list of uchar, int */
+    PACKED,
+
+    /** Mixed scalar vertex types, and face properties around the index list */
+    MIXED,
+
+    /** PACKED with tristrips instead of faces */
+    TRISTRIP
+};
+
+/** Vertex v has position (v, 2v, -v) and face f is (f, f + 1, f + 2) or,
+    every third face, a quad */
+void makePLY(BinaryOutput& b, Layout layout, int numVertices, int numFaces) {
+    std::string header = "ply\n";
+    header += (b.endian() == G3D_LITTLE_ENDIAN) ? "format binary_little_endian 1.0\n" : "format binary_big_endian 1.0\n";
+    header += "comment tParsePLY\ncomment consecutive comments\n";
+    header += format("element vertex %d\n", numVertices);
+    if (layout == MIXED) {
+        header += "property double x\nproperty uchar red\nproperty short y\nproperty float z\n";
+    } else {
+        header += "property float x\nproperty float y\nproperty float z\n";
+    }
+    if (layout == TRISTRIP) {
+        header += format("element tristrips %d\nproperty list uchar int vertex_indices\n", numFaces);
+    } else if (layout == MIXED) {
+        header += format("element face %d\nproperty uchar flags\nproperty list uchar int vertex_index\nproperty int id\n", numFaces);
+    } else {
+        header += format("element face %d\nproperty list uchar int vertex_index\n", numFaces);
+    }
+    header += "end_header\n";
+    b.writeBytes(header.c_str(), header.size());
+
+    for (int v = 0; v < numVertices; ++v) {
+        if (layout == MIXED) {
+            b.writeFloat64(v);
+            b.writeUInt8(uint8(v));
+            b.writeInt16(int16(2 * v));
+            b.writeFloat32(float(-v));
+        } else {
+            b.writeFloat32(float(v));
+            b.writeFloat32(float(2 * v));
+            b.writeFloat32(float(-v));
+        }
+    }
+
+    for (int f = 0; f < numFaces; ++f) {
+        if (layout == MIXED) {
+            b.writeUInt8(7);
+        }
+        const int n = (f % 3 == 0) ? 4 : 3;
+        b.writeUInt8(uint8(n));
+        for (int i = 0; i < n; ++i) {
+            b.writeInt32((layout == TRISTRIP) && (i == 3) ? -1 : (f + i) % numVertices);
+        }
+        if (layout == MIXED) {
+            b.writeInt32(f);
+        }
+    }
+}
+
+
+/** Checks the data for vertices [start, start + n) and faces [start, start + n) of a makePLY file */
+void checkVertices(const ParsePLY& ply, const float* data, int start, int n, Layout layout) {
+    const int N = ply.vertexProperty.size();
+    const int y = (layout == MIXED) ? 2 : 1;
+    const int z = N - 1;
+    for (int v = 0; v < n; ++v) {
+        const int i = start + v;
+        debugAssert(data[v * N] == float(i));
+        debugAssert(data[v * N + y] == float((layout == MIXED) ? int16(2 * i) : 2 * i));
+        debugAssert(data[v * N + z] == float(-i));
+        if (layout == MIXED) {
+            debugAssert(data[v * N + 1] == float(uint8(i)));
+        }
+        (void)i; (void)y; (void)z;
+    }
+}
+
+
+template<class List>
+void checkFaces(const List* list, int start, int n, int numVertices, bool triStrip) {
+    for (int j = 0; j < n; ++j) {
+        const int f = start + j;
+        const int len = (f % 3 == 0) ? 4 : 3;
+        debugAssert(list[j].size() == len);
+        for (int i = 0; i < len; ++i) {
+            const int expected = (triStrip && (i == 3)) ? -1 : (f + i) % numVertices;
+            debugAssert(list[j][i] == expected);
+            (void)expected;
+        }
+    }
+}
+
+
+void testLayout(Layout layout, G3DEndian endian) {
+    const int numVertices = 1000;
+    const int numFaces = 3000;
+    BinaryOutput b("<memory>", endian);
+    makePLY(b, layout, numVertices, numFaces);
+
+    {
+        // Whole file
+        BinaryInput bi(b.getCArray(), b.size(), G3D_LITTLE_ENDIAN);
+        ParsePLY ply;
+        ply.parse(bi);
+        debugAssert(bi.endian() == G3D_LITTLE_ENDIAN);
+        debugAssert(! bi.hasMore());
+        debugAssert(ply.numVertices == numVertices);
+        checkVertices(ply, ply.vertexData, 0, numVertices, layout);
+        if (layout == TRISTRIP) {
+            debugAssert(ply.numTriStrips == numFaces);
+            checkFaces(ply.triStripArray, 0, numFaces, numVertices, true);
+        } else {
+            debugAssert(ply.numFaces == numFaces);
+            checkFaces(ply.faceArray, 0, numFaces, numVertices, false);
+        }
+
+        // Parsing again with the same object starts over
+        bi.reset();
+        ply.parse(bi);
+        debugAssert(ply.vertexProperty.size() == ((layout == MIXED) ? 4 : 3));
+    }
+
+    {
+        // Streaming in uneven batches
+        BinaryInput bi(b.getCArray(), b.size(), G3D_LITTLE_ENDIAN);
+        ParsePLY ply;
+        ply.parseHeader(bi);
+        debugAssert(ply.vertexData == NULL);
+
+        Array<float> vertex;
+        int start = 0;
+        for (int n = ply.readVertexBatch(bi, vertex, 333); n > 0; n = ply.readVertexBatch(bi, vertex, 333)) {
+            debugAssert(vertex.size() == n * ply.vertexProperty.size());
+            checkVertices(ply, vertex.getCArray(), start, n, layout);
+            start += n;
+        }
+        debugAssert(start == numVertices);
+
+        start = 0;
+        if (layout == TRISTRIP) {
+            Array<ParsePLY::TriStrip> triStrip;
+            for (int n = ply.readTriStripBatch(bi, triStrip, 701); n > 0; n = ply.readTriStripBatch(bi, triStrip, 701)) {
+                checkFaces(triStrip.getCArray(), start, n, numVertices, true);
+                start += n;
+            }
+        } else {
+            Array<ParsePLY::Face> face;
+            for (int n = ply.readFaceBatch(bi, face, 701); n > 0; n = ply.readFaceBatch(bi, face, 701)) {
+                checkFaces(face.getCArray(), start, n, numVertices, false);
+                start += n;
+            }
+        }
+        debugAssert(start == numFaces);
+        debugAssert(! bi.hasMore());
+    }
+}
+
+} // namespace
+
+
+void testParsePLY() {
+    printf("ParsePLY ");
+
+    testLayout(PACKED,   G3D_LITTLE_ENDIAN);
+    testLayout(PACKED,   G3D_BIG_ENDIAN);
+    testLayout(MIXED,    G3D_LITTLE_ENDIAN);
+    testLayout(MIXED,    G3D_BIG_ENDIAN);
+    testLayout(TRISTRIP, G3D_LITTLE_ENDIAN);
+    testLayout(TRISTRIP, G3D_BIG_ENDIAN);
+
+    {
+        // A truncated face list is an error, not a crash
+        BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+        makePLY(b, PACKED, 100, 100);
+        BinaryInput bi(b.getCArray(), b.size() - 5, G3D_LITTLE_ENDIAN);
+        bool threw = false;
+        try {
+            ParsePLY ply;
+            ply.parse(bi);
+        } catch (const ParseError&) {
+            threw = true;
+        }
+        debugAssert(threw);
+    }
+
+    printf("passed\n");
+}
+
+
+void perfParsePLY() {
+    printf("ParsePLY performance:\n");
+
+    const int numVertices = 2000000;
+    const int numFaces = 2 * numVertices;
+    const Layout layout[] = {PACKED, PACKED, MIXED};
+    const G3DEndian endian[] = {G3D_LITTLE_ENDIAN, G3D_BIG_ENDIAN, G3D_LITTLE_ENDIAN};
+    const char* name[] = {"float xyz, uchar/int faces:", "  big-endian:", "mixed types, extra face props:"};
+
+    for (int i = 0; i < 3; ++i) {
+        BinaryOutput b("<memory>", endian[i]);
+        makePLY(b, layout[i], numVertices, numFaces);
+        BinaryInput bi(b.getCArray(), b.size(), G3D_LITTLE_ENDIAN, false, false);
+
+        Stopwatch timer;
+        timer.tick();
+        {
+            ParsePLY ply;
+            ply.parse(bi);
+        }
+        timer.tock();
+        printf("  %-32s %6.1f MB/s\n", name[i], b.size() / (timer.elapsedTime() * 1024 * 1024));
+
+        if (i == 0) {
+            // Reusing the batch arrays avoids constructing millions of
+            // Faces, which otherwise dominates
+            bi.reset();
+            timer.tick();
+            {
+                ParsePLY ply;
+                ply.parseHeader(bi);
+                Array<float> vertex;
+                while (ply.readVertexBatch(bi, vertex, 100000) > 0) {}
+                Array<ParsePLY::Face> face;
+                while (ply.readFaceBatch(bi, face, 100000) > 0) {}
+            }
+            timer.tock();
+            printf("  %-32s %6.1f MB/s\n", "  streamed in batches:", b.size() / (timer.elapsedTime() * 1024 * 1024));
+        }
+    }
+    printf("\n");
+}
@@ -0,0 +1,200 @@
+#include "G3D/G3DAll.h"
+using G3D::uint8;
+using G3D::uint32;
+using G3D::uint64;
+
+namespace {
+
+class CountCallback {
+public:
+    int     count;
+    float   maxDistanceSquared;
+
+    CountCallback() : count(0), maxDistanceSquared(0) {}
+
+    void operator()(const Vector3& v, float distanceSquared) {
+        (void)v;
+        ++count;
+        maxDistanceSquared = max(maxDistanceSquared, distanceSquared);
+    }
+};
+
+
+/** Squared distances from Q to every point, sorted */
+void bruteForceDistances(const Array<Vector3>& point, const Vector3& Q, Array<float>& d2) {
+    d2.fastClear();
+    for (int i = 0; i < point.size(); ++i) {
+        d2.append((point[i] - Q).squaredLength());
+    }
+    d2.sort();
+}
+
+
+void checkQueries(const PointKDTree<Vector3>& tree, const Array<Vector3>& point, Random& r) {
+    Array<float>   expected;
+    Array<Vector3> members;
+    Array<float>   d2;
+
+    for (int q = 0; q < 100; ++q) {
+        const Vector3 Q(r.uniform(-1, 11), r.uniform(-1, 11), r.uniform(-1, 11));
+        bruteForceDistances(point, Q, expected);
+
+        const int k = r.integer(1, 20);
+        tree.kNearest(Q, k, members, d2);
+        debugAssert(members.size() == k);
+        debugAssert(d2.size() == k);
+        for (int i = 0; i < k; ++i) {
+            debugAssert(d2[i] == expected[i]);
+            debugAssert(d2[i] == (members[i] - Q).squaredLength());
+        }
+
+        // Limited radius
+        const float radius = r.uniform(0.0f, 2.0f);
+        tree.kNearest(Q, k, members, d2, radius);
+        int numInRadius = 0;
+        while ((numInRadius < expected.size()) && (expected[numInRadius] <= square(radius))) {
+            ++numInRadius;
+        }
+        debugAssert(members.size() == min(k, numInRadius));
+
+        CountCallback callback;
+        tree.forEachMemberInSphere(Sphere(Q, radius), callback);
+        debugAssert(callback.count == numInRadius);
+        debugAssert(callback.maxDistanceSquared <= square(radius));
+
+        members.fastClear();
+        tree.getIntersectingMembers(Sphere(Q, radius), members);
+        debugAssert(members.size() == numInRadius);
+    }
+}
+
+} // namespace
+
+
+void testPointKDTree() {
+    printf("G3D::PointKDTree ");
+
+    Random r(1138);
+    Array<Vector3> point;
+    for (int i = 0; i < 5000; ++i) {
+        point.append(Vector3(r.uniform(0, 10), r.uniform(0, 10), r.uniform(0, 10)));
+    }
+
+    PointKDTree<Vector3> tree;
+
+    {
+        // Empty tree
+        Array<Vector3> members;
+        tree.kNearest(Vector3::zero(), 3, members);
+        debugAssert(members.size() == 0);
+    }
+
+    tree.insert(point);
+    tree.balance();
+    debugAssert(tree.isCompact());
+    checkQueries(tree, point, r);
+
+    {
+        // Fewer members than requested
+        Array<Vector3> members;
+        PointKDTree<Vector3> small;
+        small.insert(Vector3(1, 0, 0));
+        small.insert(Vector3(2, 0, 0));
+        small.balance();
+        small.kNearest(Vector3::zero(), 5, members);
+        debugAssert(members.size() == 2);
+        debugAssert(members[0] == Vector3(1, 0, 0));
+    }
+
+    // Modifying the tree falls back to the pointer-based nodes
+    tree.remove(point.last());
+    point.pop();
+    debugAssert(! tree.isCompact());
+    checkQueries(tree, point, r);
+
+    tree.compact();
+    debugAssert(tree.isCompact());
+    checkQueries(tree, point, r);
+
+    {
+        PointKDTree<Vector3> copy(tree);
+        debugAssert(copy.isCompact());
+        checkQueries(copy, point, r);
+    }
+
+    printf("passed\n");
+}
+
+
+void perfPointKDTree() {
+    printf("PointKDTree Performance:\n");
+
+    const int N = 1000000;
+    const int M = 100000;
+    const int k = 8;
+
+    Random r(7);
+    Array<Vector3> point;
+    point.resize(N);
+    for (int i = 0; i < N; ++i) {
+        point[i] = Vector3(r.uniform(), r.uniform(), r.uniform());
+    }
+
+    Array<Vector3> query;
+    query.resize(M);
+    for (int i = 0; i < M; ++i) {
+        query[i] = Vector3(r.uniform(), r.uniform(), r.uniform());
+    }
+
+    // Expect about 2k points within the radius
+    const float radius = pow(2.0f * k / (N * 4.0f / 3.0f * pif()), 1.0f / 3.0f);
+
+    PointKDTree<Vector3> tree;
+    Stopwatch timer;
+    timer.tick();
+    tree.insert(point);
+    tree.balance();
+    timer.tock();
+    printf("  balance(%d points):          %8.3f s\n", N, timer.elapsedTime());
+
+    for (int layout = 0; layout < 2; ++layout) {
+        if (layout == 0) {
+            // Any modification discards the compact layout
+            tree.update(point[0]);
+            debugAssert(! tree.isCompact());
+        } else {
+            tree.compact();
+        }
+        const char* name = (layout == 0) ? "pointer" : "compact";
+
+        Array<Vector3> members;
+        Array<float>   d2;
+        int            total = 0;
+
+        timer.tick();
+        for (int i = 0; i < M; ++i) {
+            members.fastClear();
+            tree.getIntersectingMembers(Sphere(query[i], radius), members);
+            total += members.size();
+        }
+        timer.tock();
+        printf("  %s getIntersectingMembers: %8.3f us/query (%.1f points)\n",
+               name, timer.elapsedTime() * 1e6 / M, (float)total / M);
+
+        CountCallback callback;
+        timer.tick();
+        for (int i = 0; i < M; ++i) {
+            tree.forEachMemberInSphere(Sphere(query[i], radius), callback);
+        }
+        timer.tock();
+        printf("  %s forEachMemberInSphere:  %8.3f us/query\n", name, timer.elapsedTime() * 1e6 / M);
+
+        timer.tick();
+        for (int i = 0; i < M; ++i) {
+            tree.kNearest(query[i], k, members, d2);
+        }
+        timer.tock();
+        printf("  %s kNearest(k = %d):        %8.3f us/query\n", name, k, timer.elapsedTime() * 1e6 / M);
+    }
+    printf("\n");
+}
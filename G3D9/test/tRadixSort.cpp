@@ -0,0 +1,286 @@
+#include "G3D/G3DAll.h"
+#include "GLG3D/GLG3D.h"
+#include <algorithm>
+
+namespace {
+
+/** Surface with only a position, for sorting without OpenGL */
+class PointSurface : public Surface {
+public:
+    Point3      position;
+    uint32      material;
+
+    PointSurface(const Point3& p, uint32 m = 0) : position(p), material(m) {}
+
+    virtual std::string name() const {
+        return "PointSurface";
+    }
+
+    virtual void getCoordinateFrame(CoordinateFrame& c, bool previous = false) const {
+        c = CFrame(position);
+    }
+
+    virtual void getObjectSpaceBoundingBox(AABox& b, bool previous = false) const {
+        b = AABox(Point3::zero());
+    }
+
+    virtual void getObjectSpaceBoundingSphere(Sphere& s, bool previous = false) const {
+        s = Sphere(Point3::zero(), 0.5f);
+    }
+
+    virtual uint32 materialSortKey() const {
+        return material;
+    }
+
+    virtual void sendGeometry(RenderDevice* rd) const {}
+
+    virtual void defaultRender(RenderDevice* rd) const {}
+};
+
+
+/** A second derived type */
+class OtherPointSurface : public PointSurface {
+public:
+    OtherPointSurface(const Point3& p, uint32 m = 0) : PointSurface(p, m) {}
+};
+
+
+bool lessKey(const SortKey& a, const SortKey& b) {
+    return a.key < b.key;
+}
+
+
+void makeSurfaces(Random& rnd, int n, Array<Surface::Ref>& surfaceArray) {
+    surfaceArray.fastClear();
+    for (int i = 0; i < n; ++i) {
+        const Point3 p(rnd.uniform(-100, 100), rnd.uniform(-100, 100), rnd.uniform(-100, 100));
+        const uint32 material = rnd.integer(0, 15);
+        if (rnd.integer(0, 3) == 0) {
+            surfaceArray.append(new OtherPointSurface(p, material));
+        } else {
+            surfaceArray.append(new PointSurface(p, material));
+        }
+    }
+}
+
+
+/** The comparison sort that Surface::sortFrontToBack used before radixSort, for comparison */
+class RefSorter {
+public:
+    float           sortKey;
+    Surface::Ref    model;
+
+    RefSorter() {}
+
+    RefSorter(const Surface::Ref& m, const Vector3& axis) : model(m) {
+        Sphere s;
+        CFrame c;
+        m->getCoordinateFrame(c, false);
+        m->getObjectSpaceBoundingSphere(s, false);
+        sortKey = axis.dot(c.pointToWorldSpace(s.center));
+    }
+
+    inline bool operator>(const RefSorter& s) const {
+        return sortKey > s.sortKey;
+    }
+
+    inline bool operator<(const RefSorter& s) const {
+        return sortKey < s.sortKey;
+    }
+};
+
+
+void comparisonSortFrontToBack(Array<Surface::Ref>& surface, const Vector3& wsLook) {
+    Array<RefSorter> sorter;
+    sorter.reserve(surface.size());
+    for (int m = 0; m < surface.size(); ++m) {
+        sorter.append(RefSorter(surface[m], wsLook));
+    }
+    sorter.sort(SORT_INCREASING);
+    for (int m = 0; m < sorter.size(); ++m) {
+        surface[m] = sorter[m].model;
+    }
+}
+
+
+float depth(const Surface::Ref& s) {
+    return -s.downcast<PointSurface>()->position.z;
+}
+
+
+void testKeys() {
+    // Floats
+    const float f[] = {-finf(), -1e30f, -2.5f, -1.0f, -1e-30f, -0.0f, 0.0f, 1e-30f, 1.0f, 2.5f, 1e30f, finf()};
+    for (int i = 1; i < int(sizeof(f) / sizeof(f[0])); ++i) {
+        debugAssert(floatSortKey(f[i - 1]) < floatSortKey(f[i]));
+    }
+
+    Random rnd(1, false);
+    for (int trial = 0; trial < 6; ++trial) {
+        const int n = (trial == 0) ? 0 : (trial == 1) ? 1 : (trial == 2) ? 50 : 20000;
+
+        Array<SortKey> a;
+        for (int i = 0; i < n; ++i) {
+            uint64 k = 0;
+            switch (trial) {
+            case 3:
+                // Full 64-bit keys
+                k = (uint64(uint32(rnd.bits())) << 32) | uint32(rnd.bits());
+                break;
+            case 4:
+                // Few distinct keys, to check stability
+                k = rnd.integer(0, 10);
+                break;
+            default:
+                k = floatSortKey(rnd.uniform(-100, 100)) | (uint64(rnd.integer(0, 3)) << 48);
+            }
+            a.append(SortKey(k, i));
+        }
+
+        std::vector<SortKey> expected(a.getCArray(), a.getCArray() + a.size());
+        std::stable_sort(expected.begin(), expected.end(), lessKey);
+
+        radixSort(a);
+        for (int i = 0; i < n; ++i) {
+            debugAssert(a[i].key == expected[i].key);
+            debugAssert(a[i].index == expected[i].index);
+        }
+    }
+}
+
+
+void testSurfaceSort() {
+    Random rnd(2, false);
+    const Vector3 look(0, 0, -1);
+
+    Array<Surface::Ref> surfaceArray;
+    makeSurfaces(rnd, 1000, surfaceArray);
+    const Array<Surface::Ref> original = surfaceArray;
+
+    Surface::sortFrontToBack(surfaceArray, look);
+    debugAssert(surfaceArray.size() == original.size());
+    for (int i = 1; i < surfaceArray.size(); ++i) {
+        debugAssert(depth(surfaceArray[i - 1]) <= depth(surfaceArray[i]));
+    }
+
+    for (int groupByMaterial = 0; groupByMaterial < 2; ++groupByMaterial) {
+        surfaceArray = original;
+        Array<int> typeStart;
+        Surface::sortByDerivedType(surfaceArray, look, typeStart, groupByMaterial != 0);
+
+        // Same elements, each exactly once
+        Set<Surface*> all;
+        for (int i = 0; i < surfaceArray.size(); ++i) {
+            all.insert(surfaceArray[i].pointer());
+        }
+        debugAssert(all.size() == original.size());
+
+        debugAssert(typeStart.size() == 3);
+        debugAssert(typeStart[0] == 0 && typeStart.last() == surfaceArray.size());
+        for (int t = 0; t < typeStart.size() - 1; ++t) {
+            const std::type_info& type = typeid(*surfaceArray[typeStart[t]]);
+            for (int i = typeStart[t]; i < typeStart[t + 1]; ++i) {
+                debugAssert(typeid(*surfaceArray[i]) == type);
+                if (i > typeStart[t]) {
+                    const Surface::Ref& a = surfaceArray[i - 1];
+                    const Surface::Ref& b = surfaceArray[i];
+                    if (groupByMaterial) {
+                        debugAssert((a->materialSortKey() < b->materialSortKey()) ||
+                                    ((a->materialSortKey() == b->materialSortKey()) && (depth(a) <= depth(b))));
+                    } else {
+                        debugAssert(depth(a) <= depth(b));
+                    }
+                }
+            }
+        }
+    }
+
+    // The group containing the nearest surface comes first
+    surfaceArray = original;
+    Surface::sortFrontToBack(surfaceArray, look);
+    const std::type_info& nearestType = typeid(*surfaceArray[0]);
+    surfaceArray = original;
+    Array<int> typeStart;
+    Surface::sortByDerivedType(surfaceArray, look, typeStart);
+    debugAssert(typeid(*surfaceArray[0]) == nearestType);
+    (void)nearestType;
+}
+
+} // namespace
+
+
+void testRadixSort() {
+    printf("radixSort ");
+    testKeys();
+    testSurfaceSort();
+    printf("passed\n");
+}
+
+
+void perfRadixSort() {
+    printf("radixSort performance:\n");
+    Random rnd(3, false);
+    const Vector3 look(0, 0, -1);
+    Stopwatch timer;
+
+    for (int n = 10000; n <= 1000000; n *= 10) {
+        Array<SortKey> original;
+        original.resize(n);
+        for (int i = 0; i < n; ++i) {
+            original[i] = SortKey(floatSortKey(rnd.uniform(-100, 100)) | (uint64(rnd.integer(0, 7)) << 48), i);
+        }
+
+        Array<SortKey> a = original;
+        timer.tick();
+        a.sort(SORT_INCREASING);
+        timer.tock();
+        const float comparisonTime = float(timer.elapsedTime());
+
+        a = original;
+        timer.tick();
+        radixSort(a);
+        timer.tock();
+        const float radixTime = float(timer.elapsedTime());
+
+        printf("  %7d keys:     Array::sort %8.3f ms, radixSort %8.3f ms\n", n, comparisonTime * 1000, radixTime * 1000);
+    }
+
+    for (int n = 10000; n <= 1000000; n *= 10) {
+        Array<Surface::Ref> original;
+        makeSurfaces(rnd, n, original);
+
+        Array<Surface::Ref> surfaceArray = original;
+        timer.tick();
+        comparisonSortFrontToBack(surfaceArray, look);
+        timer.tock();
+        const float comparisonTime = float(timer.elapsedTime());
+
+        surfaceArray = original;
+        timer.tick();
+        Surface::sortFrontToBack(surfaceArray, look);
+        timer.tock();
+        const float frontToBackTime = float(timer.elapsedTime());
+
+        surfaceArray = original;
+        Array< Array<Surface::Ref> > derivedTable;
+        timer.tick();
+        Surface::sortFrontToBack(surfaceArray, look);
+        categorizeByDerivedType(surfaceArray, derivedTable);
+        timer.tock();
+        const float categorizeTime = float(timer.elapsedTime());
+
+        surfaceArray = original;
+        Array<int> typeStart;
+        timer.tick();
+        Surface::sortByDerivedType(surfaceArray, look, typeStart, true);
+        timer.tock();
+        const float derivedTime = float(timer.elapsedTime());
+
+        printf("  %7d surfaces:\n", n);
+        printf("    comparison sort                                 %8.3f ms\n", comparisonTime * 1000);
+        printf("    sortFrontToBack                                 %8.3f ms\n", frontToBackTime * 1000);
+        printf("    sortFrontToBack + categorizeByDerivedType       %8.3f ms\n", categorizeTime * 1000);
+        printf("    sortByDerivedType (with materials)              %8.3f ms\n", derivedTime * 1000);
+    }
+    printf("\n");
+}
@@ -0,0 +1,200 @@
+#include "G3D/G3DAll.h"
+#include "GLG3D/GLG3D.h"
+#include "BoundsSurface.h"
+
+namespace {
+
+/** Small spheres scattered in a cube of side \a size around the origin */
+void makeScene(Array<Surface::Ref>& surfaceArray, int n, float size, Random& rnd) {
+    surfaceArray.fastClear();
+    for (int i = 0; i < n; ++i) {
+        const CFrame c(Matrix3::fromAxisAngle(Vector3::random(rnd), rnd.uniform(0, pif())),
+                       Vector3(rnd.uniform(-0.5f, 0.5f), rnd.uniform(-0.5f, 0.5f), rnd.uniform(-0.5f, 0.5f)) * size);
+        const Sphere s(Vector3(rnd.uniform(-1, 1), rnd.uniform(-1, 1), rnd.uniform(-1, 1)), rnd.uniform(0.1f, 3.0f));
+        surfaceArray.append(new BoundsSurface(c, s));
+    }
+}
+
+
+/** The indices of the Surfaces that are not culled by Plane::distance, which is the test that SurfaceCuller matches */
+void referenceCull(const Array<Surface::Ref>& surfaceArray, const Array<Plane>& clipPlanes, Array<int>& visibleIndex) {
+    visibleIndex.fastClear();
+    for (int i = 0; i < surfaceArray.size(); ++i) {
+        CFrame c;
+        Sphere s;
+        surfaceArray[i]->getCoordinateFrame(c);
+        surfaceArray[i]->getObjectSpaceBoundingSphere(s);
+        s = c.toWorldSpace(s);
+
+        bool culled = false;
+        for (int p = 0; (p < clipPlanes.size()) && ! culled; ++p) {
+            culled = (s.radius < finf()) && (clipPlanes[p].distance(s.center) < -s.radius);
+        }
+        if (! culled) {
+            visibleIndex.append(i);
+        }
+    }
+}
+
+
+void checkCull(SurfaceCuller& culler, const Array<Plane>& clipPlanes) {
+    Array<int> expected, actual;
+    referenceCull(culler.surfaceArray(), clipPlanes, expected);
+    culler.cull(clipPlanes, actual);
+    actual.sort();
+    alwaysAssertM(expected.size() == actual.size(), format("SurfaceCuller kept %d surfaces instead of %d", actual.size(), expected.size()));
+    for (int i = 0; i < expected.size(); ++i) {
+        alwaysAssertM(expected[i] == actual[i], "SurfaceCuller kept the wrong surfaces");
+    }
+}
+
+
+GCamera randomCamera(Random& rnd, float size) {
+    GCamera camera;
+    camera.setFarPlaneZ(-size);
+    camera.setFieldOfView(rnd.uniform(0.3f, 1.5f), GCamera::HORIZONTAL);
+    camera.setCoordinateFrame(CFrame::fromXYZYPRDegrees(rnd.uniform(-size, size) * 0.5f, rnd.uniform(-size, size) * 0.5f, rnd.uniform(-size, size) * 0.5f,
+                                                        rnd.uniform(0, 360), rnd.uniform(-90, 90)));
+    return camera;
+}
+
+} // namespace
+
+
+void testSurfaceCuller() {
+    printf("SurfaceCuller ");
+
+    Random rnd(1234, false);
+    const Rect2D viewport = Rect2D::xywh(0, 0, 640, 400);
+    const float size = 200;
+
+    Array<Surface::Ref> surfaceArray;
+    makeScene(surfaceArray, 3001, size, rnd);
+
+    // An infinite surface is never culled
+    surfaceArray[17] = new BoundsSurface(CFrame(), Sphere(Point3::zero(), finf()));
+
+    SurfaceCuller culler;
+    culler.setSurfaceArray(surfaceArray);
+    debugAssert(culler.size() == surfaceArray.size());
+
+    Array<Plane> clipPlanes;
+    for (int i = 0; i < 20; ++i) {
+        randomCamera(rnd, size).getClipPlanes(viewport, clipPlanes);
+        checkCull(culler, clipPlanes);
+    }
+
+    // With no planes, every surface is visible and the padding after
+    // the last one is not reported
+    clipPlanes.clear();
+    checkCull(culler, clipPlanes);
+
+    // Animate a few surfaces in place, replace a few more, and make sure the bounds follow
+    for (int i = 0; i < 40; ++i) {
+        const int s = rnd.integer(0, surfaceArray.size() - 1);
+        if (isEven(i)) {
+            const BoundsSurface::Ref& b = surfaceArray[s].downcast<BoundsSurface>();
+            b->cframe.translation += Vector3::random(rnd) * size * 0.5f;
+            culler.setDirty(s);
+        } else {
+            surfaceArray[s] = new BoundsSurface(CFrame(Vector3::random(rnd) * size * 0.5f), Sphere(Point3::zero(), 1.0f));
+        }
+    }
+    culler.setSurfaceArray(surfaceArray);
+    for (int i = 0; i < 20; ++i) {
+        randomCamera(rnd, size).getClipPlanes(viewport, clipPlanes);
+        checkCull(culler, clipPlanes);
+    }
+
+    // Scattering a third of the surfaces loosens the clusters enough to reorder them
+    for (int s = 0; s < surfaceArray.size(); s += 3) {
+        surfaceArray[s] = new BoundsSurface(CFrame(Vector3::random(rnd) * size * 0.3f), Sphere(Point3::zero(), 2.0f));
+    }
+    culler.setSurfaceArray(surfaceArray);
+    for (int i = 0; i < 20; ++i) {
+        randomCamera(rnd, size).getClipPlanes(viewport, clipPlanes);
+        checkCull(culler, clipPlanes);
+    }
+
+    // A different number of surfaces, and the Surface::Ref overload
+    surfaceArray.resize(5);
+    culler.setSurfaceArray(surfaceArray);
+    const GCamera& camera = randomCamera(rnd, size);
+    Array<Surface::Ref> visible, expected;
+    culler.cull(camera, viewport, visible);
+    Surface::cull(camera, viewport, surfaceArray, expected);
+    debugAssert(visible.size() <= surfaceArray.size());
+
+    surfaceArray.clear();
+    culler.setSurfaceArray(surfaceArray);
+    culler.cull(camera, viewport, visible);
+    debugAssert(visible.size() == 0);
+
+    printf("passed\n");
+}
+
+
+void perfSurfaceCuller() {
+    printf("SurfaceCuller performance:\n");
+
+    Random rnd(1234, false);
+    const Rect2D viewport = Rect2D::xywh(0, 0, 1280, 720);
+    const float size = 2000;
+    const int N = 60000;
+
+    Array<Surface::Ref> surfaceArray;
+    makeScene(surfaceArray, N, size, rnd);
+
+    Array<GCamera> camera;
+    for (int i = 0; i < 50; ++i) {
+        camera.append(randomCamera(rnd, size));
+    }
+
+    Array<Surface::Ref> visible;
+    Stopwatch timer;
+    int numVisible = 0;
+
+    timer.tick();
+    for (int i = 0; i < camera.size(); ++i) {
+        Surface::cull(camera[i], viewport, surfaceArray, visible);
+        numVisible += visible.size();
+    }
+    timer.tock();
+    const RealTime reference = timer.elapsedTime() / camera.size();
+    printf("  %d surfaces, %.1f%% visible\n", N, 100.0f * numVisible / (camera.size() * N));
+    printf("  Surface::cull                  %6.2f ms/frame\n", reference * 1000);
+
+    SurfaceCuller culler;
+    timer.tick();
+    culler.setSurfaceArray(surfaceArray);
+    culler.cull(camera[0], viewport, visible);
+    timer.tock();
+    printf("  SurfaceCuller first frame      %6.2f ms\n", timer.elapsedTime() * 1000);
+
+    timer.tick();
+    for (int i = 0; i < camera.size(); ++i) {
+        culler.setSurfaceArray(surfaceArray);
+        culler.cull(camera[i], viewport, visible);
+    }
+    timer.tock();
+    const RealTime steady = timer.elapsedTime() / camera.size();
+    printf("  SurfaceCuller static scene     %6.2f ms/frame (%.1fx)\n", steady * 1000, reference / steady);
+
+    // 5% of the surfaces move every frame.  Only time the culler.
+    RealTime animated = 0;
+    for (int i = 0; i < camera.size(); ++i) {
+        for (int j = 0; j < N / 20; ++j) {
+            const int s = rnd.integer(0, N - 1);
+            surfaceArray[s].downcast<BoundsSurface>()->cframe.translation += Vector3(0.1f, 0, 0);
+            culler.setDirty(s);
+        }
+        timer.tick();
+        culler.setSurfaceArray(surfaceArray);
+        culler.cull(camera[i], viewport, visible);
+        timer.tock();
+        animated += timer.elapsedTime();
+    }
+    animated /= camera.size();
+    printf("  SurfaceCuller 5%% animated      %6.2f ms/frame (%.1fx)\n", animated * 1000, reference / animated);
+    printf("\n");
+}
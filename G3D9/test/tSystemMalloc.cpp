@@ -0,0 +1,192 @@
+#include "G3D/G3DAll.h"
+using G3D::uint8;
+using G3D::uint32;
+using G3D::uint64;
+
+namespace {
+
+/** Allocates, fills, checks, and frees random blocks.  Half of the blocks
+    are left in handoff for another thread to free. */
+class MallocWorker : public GThread {
+public:
+    int             seed;
+    int             iterations;
+    int             maxSize;
+    bool            useSystemMalloc;
+    bool            verify;
+
+    /** Blocks allocated by this thread that another thread must free */
+    Array<void*>    handoff;
+    Array<int>      handoffSize;
+
+    bool            ok;
+
+    MallocWorker(int s, int n, int m, bool sys, bool v) :
+        GThread("MallocWorker"), seed(s), iterations(n), maxSize(m), useSystemMalloc(sys), verify(v), ok(true) {}
+
+    void* alloc(size_t bytes) {
+        return useSystemMalloc ? System::malloc(bytes) : ::malloc(bytes);
+    }
+
+    void release(void* p) {
+        if (useSystemMalloc) {
+            System::free(p);
+        } else {
+            ::free(p);
+        }
+    }
+
+    virtual void threadMain() {
+        const int numSlots = 512;
+        void* slot[numSlots];
+        int   size[numSlots];
+        for (int i = 0; i < numSlots; ++i) {
+            slot[i] = NULL;
+            size[i] = 0;
+        }
+
+        Random r(seed, false);
+        for (int i = 0; i < iterations; ++i) {
+            const int s = r.integer(0, numSlots - 1);
+            if (slot[s] != NULL) {
+                if (verify && (((uint8*)slot[s])[size[s] - 1] != uint8(s))) {
+                    ok = false;
+                }
+                if (verify && (handoff.size() < 1000) && r.integer(0, 1)) {
+                    handoff.append(slot[s]);
+                    handoffSize.append(size[s]);
+                } else {
+                    release(slot[s]);
+                }
+            }
+            size[s] = r.integer(1, maxSize);
+            slot[s] = alloc(size[s]);
+            if (verify) {
+                System::memset(slot[s], uint8(s), size[s]);
+            }
+        }
+
+        for (int i = 0; i < numSlots; ++i) {
+            if (slot[i] != NULL) {
+                release(slot[i]);
+            }
+        }
+    }
+};
+
+}
+
+
+void testSystemMalloc() {
+    printf("System::malloc ");
+
+    {
+        // Every size up to and just beyond the pooled range
+        Array<void*> block;
+        for (int bytes = 0; bytes < 5000; ++bytes) {
+            uint8* p = (uint8*)System::malloc(bytes);
+            debugAssert(p != NULL);
+            if (bytes <= 4096) {
+                debugAssertM(((uintptr_t)p & 15) == 0, "Pooled blocks must be 16-byte aligned");
+            }
+            System::memset(p, 0xCD, bytes);
+            block.append(p);
+        }
+        for (int bytes = 0; bytes < block.size(); ++bytes) {
+            uint8* p = (uint8*)block[bytes];
+            for (int i = 0; i < bytes; ++i) {
+                debugAssert(p[i] == 0xCD);
+            }
+            System::free(p);
+        }
+    }
+
+    {
+        // realloc preserves contents across size classes and into the heap
+        int* p = (int*)System::malloc(sizeof(int));
+        *p = 0;
+        for (int n = 2; n < 3000; n = n * 3 / 2 + 1) {
+            p = (int*)System::realloc(p, n * sizeof(int));
+            for (int i = 0; i < n / 2; ++i) {
+                debugAssert(p[i] == i);
+            }
+            for (int i = 0; i < n; ++i) {
+                p[i] = i;
+            }
+        }
+        System::free(p);
+
+        int* z = (int*)System::calloc(100, sizeof(int));
+        for (int i = 0; i < 100; ++i) {
+            debugAssert(z[i] == 0);
+        }
+        System::free(z);
+    }
+
+    {
+        // Several threads at once, with blocks freed by a thread other than
+        // the one that allocated them
+        Array<MallocWorker*> worker;
+        for (int t = 0; t < 4; ++t) {
+            worker.append(new MallocWorker(t + 1, 100000, 600, true, true));
+            worker.last()->start();
+        }
+        for (int t = 0; t < worker.size(); ++t) {
+            worker[t]->waitForCompletion();
+            debugAssert(worker[t]->ok);
+        }
+
+        for (int t = 0; t < worker.size(); ++t) {
+            MallocWorker* w = worker[t];
+            for (int i = 0; i < w->handoff.size(); ++i) {
+                // The whole block was filled with one value
+                const uint8* p = (const uint8*)w->handoff[i];
+                debugAssert(p[0] == p[w->handoffSize[i] - 1]);
+                System::free(w->handoff[i]);
+            }
+            delete w;
+        }
+    }
+
+    debugAssert(System::mallocStatus() != "");
+
+    printf("passed\n");
+}
+
+
+void perfSystemMalloc() {
+    printf("System::malloc performance:\n");
+
+    const int iterations = 2000000;
+    const int sizes[] = {64, 512, 4096};
+
+    for (int numThreads = 1; numThreads <= 4; numThreads *= 2) {
+        for (int s = 0; s < 3; ++s) {
+            RealTime elapsed[2];
+            for (int sys = 0; sys < 2; ++sys) {
+                Array<MallocWorker*> worker;
+                for (int t = 0; t < numThreads; ++t) {
+                    worker.append(new MallocWorker(t + 1, iterations / numThreads, sizes[s], sys == 1, false));
+                }
+
+                Stopwatch timer;
+                timer.tick();
+                for (int t = 0; t < worker.size(); ++t) {
+                    worker[t]->start();
+                }
+                for (int t = 0; t < worker.size(); ++t) {
+                    worker[t]->waitForCompletion();
+                }
+                timer.tock();
+                elapsed[sys] = timer.elapsedTime();
+                worker.deleteAll();
+            }
+
+            printf("  %d threads, 1-%4d bytes:  ::malloc %6.1f ns/op   System::malloc %6.1f ns/op\n",
+                   numThreads, sizes[s], elapsed[0] * 1e9 / iterations, elapsed[1] * 1e9 / iterations);
+        }
+    }
+
+    printf("  %s\n", System::mallocStatus().c_str());
+    printf("\n");
+}
@@ -219,6 +219,7 @@ void testTable() {
 template<class K, class V>
 void perfTest(const char* description, const K* keys, const V* vals, int M) {
     uint64 tableSet = 0, tableGet = 0, tableRemove = 0;
+    uint64 flatSet = 0, flatGet = 0, flatRemove = 0;
     uint64 mapSet = 0, mapGet = 0, mapRemove = 0;
 #   ifdef HAS_HASH_MAP
     uint64 hashMapSet = 0, hashMapGet = 0, hashMapRemove = 0;
@@ -262,6 +263,28 @@ void perfTest(const char* description, const K* keys, const V* vals, int M) {
 
         /////////////////////////////////
 
+        {FlatTable<K, V> t;
+        System::beginCycleCount(flatSet);
+        for (int i = 0; i < M; ++i) {
+            t.set(keys[i], vals[i]);
+        }
+        System::endCycleCount(flatSet);
+        
+        System::beginCycleCount(flatGet);
+        for (int i = 0; i < M; ++i) {
+            v=t[keys[i]];
+        }
+        System::endCycleCount(flatGet);
+
+        System::beginCycleCount(flatRemove);
+        for (int i = 0; i < M; ++i) {
+            t.remove(keys[i]);
+        }
+        System::endCycleCount(flatRemove);
+        }
+
+        /////////////////////////////////
+
         {std::map<K, V> t;
         System::beginCycleCount(mapSet);
         for (int i = 0; i < M; ++i) {
@@ -315,6 +338,14 @@ void perfTest(const char* description, const K* keys, const V* vals, int M) {
     }
     tableRemove -= overhead;
 
+    flatSet -= overhead;
+    if (flatGet < overhead) {
+        flatGet = 0;
+    } else {
+        flatGet -= overhead;
+    }
+    flatRemove -= overhead;
+
     mapSet -= overhead;
     mapGet -= overhead;
     mapRemove -= overhead;
@@ -328,6 +359,8 @@ void perfTest(const char* description, const K* keys, const V* vals, int M) {
     printf("Table         %9.1f  %9.1f  %9.1f   %s\n", 
            (float)tableSet / N, (float)tableGet / N, (float)tableRemove / N,
            G3Dwin ? " ok " : "FAIL"); 
+    printf("FlatTable     %9.1f  %9.1f  %9.1f\n", 
+           (float)flatSet / N, (float)flatGet / N, (float)flatRemove / N); 
 #   ifdef HAS_HASH_MAP
     printf("hash_map      %9.1f  %9.1f  %9.1f\n", (float)hashMapSet / N, (float)hashMapGet / N, (float)hashMapRemove / N); 
 #   endif
@@ -380,4 +413,18 @@ void perfTable() {
         }
         perfTest<std::string, std::string>("string, string", keys, vals, M);
     }
+
+    {
+        // Large enough that the tables do not fit in cache
+        const int L = 200000;
+        Array<int> keys;
+        Array<int> vals;
+        keys.resize(L);
+        vals.resize(L);
+        for (int i = 0; i < L; ++i) {
+            keys[i] = i * 7919;
+            vals[i] = i;
+        }
+        perfTest<int, int>("int,int (200k)", keys.getCArray(), vals.getCArray(), L);
+    }
 }
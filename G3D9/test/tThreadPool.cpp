@@ -0,0 +1,206 @@
+#include "G3D/G3DAll.h"
+using G3D::uint8;
+using G3D::uint32;
+using G3D::uint64;
+
+namespace {
+
+class Counter {
+public:
+    Array<int>      visits;
+    int             width;
+    AtomicInt32     maxThreadID;
+
+    Counter(int w, int h) : width(w), maxThreadID(0) {
+        visits.resize(w * h);
+        System::memset(visits.getCArray(), 0, sizeof(int) * visits.size());
+    }
+
+    void visit(int x, int y) {
+        ++visits[x + y * width];
+    }
+
+    void visitWithID(int x, int y, int threadID) {
+        ++visits[x + y * width];
+        int old = maxThreadID.value();
+        while ((threadID > old) && (maxThreadID.compareAndSet(old, threadID) != old)) {
+            old = maxThreadID.value();
+        }
+    }
+
+    void visit1D(int i, int threadID) {
+        (void)threadID;
+        ++visits[i];
+    }
+
+    /** Runs a parallel loop from inside a parallel loop */
+    void nested(int i, int threadID) {
+        (void)threadID;
+        Counter inner(4, 1);
+        ThreadPool::parallelFor(0, 4, &inner, &Counter::visit1D);
+        for (int j = 0; j < 4; ++j) {
+            debugAssert(inner.visits[j] == 1);
+        }
+        ++visits[i];
+    }
+
+    bool allVisitedOnce() const {
+        for (int i = 0; i < visits.size(); ++i) {
+            if (visits[i] != 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+
+/** Rows near the top of the image are much more expensive than those at
+    the bottom, like a ray cast of a scene with all geometry in the sky. */
+class Unbalanced {
+public:
+    int             height;
+    Array<float>    result;
+
+    Unbalanced(int w, int h) : height(h) {
+        result.resize(w * h);
+    }
+
+    void shade(int x, int y) {
+        const int iterations = (y < height / 8) ? 2000 : 10;
+        float s = 0.0f;
+        for (int i = 0; i < iterations; ++i) {
+            s += sin(s + float(x ^ i));
+        }
+        result[x + y * (result.size() / height)] = s;
+    }
+};
+
+
+/** Reference implementation of the GThread::runConcurrently2D
+    behavior before it used ThreadPool: one new thread per call and
+    interlaced rows. */
+class InterlacedWorker : public GThread {
+public:
+    Unbalanced*     object;
+    int             first;
+    int             stride;
+    int             width;
+
+    InterlacedWorker(Unbalanced* o, int f, int s, int w) :
+        GThread("InterlacedWorker"), object(o), first(f), stride(s), width(w) {}
+
+    virtual void threadMain() {
+        for (int y = first; y < object->height; y += stride) {
+            for (int x = 0; x < width; ++x) {
+                object->shade(x, y);
+            }
+        }
+    }
+};
+
+} // namespace
+
+
+void testThreadPool() {
+    printf("G3D::ThreadPool ");
+
+    {
+        Counter c(97, 53);
+        ThreadPool::parallelFor2D(Vector2int32(0, 0), Vector2int32(97, 53), &c, &Counter::visit, Vector2int32(8, 5));
+        debugAssert(c.allVisitedOnce());
+    }
+
+    {
+        // Subregion, with a thread limit
+        Counter c(10, 10);
+        ThreadPool::parallelFor2D(Vector2int32(2, 3), Vector2int32(10, 10), &c, &Counter::visitWithID, Vector2int32(1, 1), 2);
+        for (int y = 0; y < 10; ++y) {
+            for (int x = 0; x < 10; ++x) {
+                debugAssert(c.visits[x + y * 10] == (((x >= 2) && (y >= 3)) ? 1 : 0));
+            }
+        }
+        debugAssert(c.maxThreadID.value() < 2);
+    }
+
+    {
+        Counter c(10001, 1);
+        ThreadPool::parallelFor(0, 10001, &c, &Counter::visit1D, 7);
+        debugAssert(c.allVisitedOnce());
+    }
+
+    {
+        // Empty range
+        Counter c(1, 1);
+        ThreadPool::parallelFor(5, 5, &c, &Counter::visit1D);
+        debugAssert(c.visits[0] == 0);
+    }
+
+    {
+        Counter c(64, 1);
+        ThreadPool::parallelFor(0, 64, &c, &Counter::nested);
+        debugAssert(c.allVisitedOnce());
+    }
+
+    {
+        Counter c(31, 17);
+        GThread::runConcurrently2D(Vector2int32(0, 0), Vector2int32(31, 17), &c, &Counter::visitWithID);
+        debugAssert(c.allVisitedOnce());
+        debugAssert(c.maxThreadID.value() < ThreadPool::numThreads());
+    }
+
+    printf("passed\n");
+}
+
+
+void perfThreadPool() {
+    printf("ThreadPool Performance:\n");
+
+    const int w = 128;
+    const int h = 128;
+    const int N = 10;
+
+    {
+        Unbalanced u(w, h);
+        const int numThreads = System::numCores();
+        const RealTime start = System::time();
+        for (int i = 0; i < N; ++i) {
+            ThreadSet threadSet;
+            for (int t = 0; t < numThreads; ++t) {
+                threadSet.insert(new InterlacedWorker(&u, t, numThreads, w));
+            }
+            threadSet.start(USE_CURRENT_THREAD);
+            threadSet.waitForCompletion();
+        }
+        printf("  Per-call threads, interlaced rows:  %6.2f ms/frame\n", 1000.0 * (System::time() - start) / N);
+    }
+
+    {
+        Unbalanced u(w, h);
+        const RealTime start = System::time();
+        for (int i = 0; i < N; ++i) {
+            GThread::runConcurrently2D(Vector2int32(0, 0), Vector2int32(w, h), &u, &Unbalanced::shade);
+        }
+        printf("  GThread::runConcurrently2D:         %6.2f ms/frame\n", 1000.0 * (System::time() - start) / N);
+    }
+
+    {
+        Unbalanced u(w, h);
+        const RealTime start = System::time();
+        for (int i = 0; i < N; ++i) {
+            ThreadPool::parallelFor2D(Vector2int32(0, 0), Vector2int32(w, h), &u, &Unbalanced::shade, Vector2int32(32, 4));
+        }
+        printf("  ThreadPool::parallelFor2D (32x4):   %6.2f ms/frame\n", 1000.0 * (System::time() - start) / N);
+    }
+
+    {
+        // Scheduling overhead for an empty loop
+        Counter c(1024, 1);
+        const int M = 1000;
+        const RealTime start = System::time();
+        for (int i = 0; i < M; ++i) {
+            ThreadPool::parallelFor(0, 1024, &c, &Counter::visit1D, 64);
+        }
+        printf("  ThreadPool::parallelFor overhead:   %6.2f us/call\n\n", 1e6 * (System::time() - start) / M);
+    }
+}
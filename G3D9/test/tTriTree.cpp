@@ -0,0 +1,377 @@
+#include "G3D/G3DAll.h"
+using G3D::uint8;
+using G3D::uint32;
+using G3D::uint64;
+
+namespace {
+
+/** Appends the triangles of every part of \a model to triArray, in world space */
+void getTris(const ArticulatedModel::Ref& model, CPUVertexArray& vertexArray, Array<Tri>& triArray) {
+
+    class ExtractTriCallback : public ArticulatedModel::PartCallback {
+    public:
+        CPUVertexArray& vertexArray;
+        Array<Tri>&     triArray;
+
+        ExtractTriCallback(CPUVertexArray& vertexArray, Array<Tri>& triArray) : vertexArray(vertexArray), triArray(triArray) {}
+
+        void operator()(ArticulatedModel::Part* part, const CFrame& worldToPartFrame, ArticulatedModel::Ref model, const int treeDepth) {
+            (void)model;
+            (void)treeDepth;
+            const int offset = vertexArray.size();
+            for (int i = 0; i < part->cpuVertexArray.size(); ++i) {
+                CPUVertexArray::Vertex v = part->cpuVertexArray.vertex[i];
+                v.position = worldToPartFrame.pointToObjectSpace(v.position);
+                vertexArray.vertex.append(v);
+            }
+
+            for (int m = 0; m < part->meshArray().size(); ++m) {
+                const ArticulatedModel::Mesh* mesh = part->meshArray()[m];
+                if (mesh->primitive == PrimitiveType::TRIANGLES) {
+                    const Array<int>& index = mesh->cpuIndexArray;
+                    for (int i = 0; i + 2 < index.size(); i += 3) {
+                        triArray.append(Tri(index[i] + offset, index[i + 1] + offset, index[i + 2] + offset, vertexArray, NULL, mesh->twoSided));
+                    }
+                }
+            }
+        }
+    } callback(vertexArray, triArray);
+
+    model->forEachPart(callback);
+}
+
+
+/** Random triangles with edge lengths of about one in a 10^3 box */
+void makeTriangleSoup(int numTris, CPUVertexArray& vertexArray, Array<Tri>& triArray) {
+    Random r(4);
+    for (int t = 0; t < numTris; ++t) {
+        const Vector3 center(r.uniform(0, 10), r.uniform(0, 10), r.uniform(0, 10));
+        for (int v = 0; v < 3; ++v) {
+            CPUVertexArray::Vertex& vertex = vertexArray.vertex.next();
+            vertex.position  = center + Vector3(r.uniform(-1, 1), r.uniform(-1, 1), r.uniform(-1, 1));
+            vertex.normal    = Vector3::unitY();
+            vertex.tangent   = Vector4::zero();
+            vertex.texCoord0 = Vector2::zero();
+        }
+        triArray.append(Tri(3 * t, 3 * t + 1, 3 * t + 2, vertexArray));
+    }
+}
+
+
+/** Rays from a pinhole camera at \a eye looking at \a target, ordered in
+    2x2 pixel blocks so that each packet of four is coherent. */
+void makePrimaryRays(const Point3& eye, const Point3& target, int width, int height, Array<Ray>& rayArray) {
+    CFrame frame = CFrame::fromXYZYPRDegrees(eye.x, eye.y, eye.z);
+    frame.lookAt(target);
+
+    rayArray.fastClear();
+    for (int y = 0; y < height; y += 2) {
+        for (int x = 0; x < width; x += 2) {
+            for (int i = 0; i < 4; ++i) {
+                const float px = ((x + (i & 1)) + 0.5f) / width  - 0.5f;
+                const float py = ((y + (i >> 1)) + 0.5f) / height - 0.5f;
+                rayArray.append(Ray::fromOriginAndDirection(eye, frame.vectorToWorldSpace(Vector3(px, -py, -1.0f)).direction()));
+            }
+        }
+    }
+}
+
+
+void checkAgainstSingleRays(const TriTree& tree, const Array<Ray>& rayArray, bool exitOnAnyHit, bool twoSided) {
+    Array<Tri::Intersector> packetHit;
+    Array<float>            packetDistance;
+    packetDistance.resize(rayArray.size());
+    for (int i = 0; i < rayArray.size(); ++i) {
+        // Exercise both bounded and unbounded rays
+        packetDistance[i] = (i % 3 == 0) ? 12.0f : finf();
+    }
+    tree.intersectRays(rayArray, packetHit, packetDistance, exitOnAnyHit, twoSided);
+    debugAssert(packetHit.size() == rayArray.size());
+
+    for (int i = 0; i < rayArray.size(); ++i) {
+        Tri::Intersector hit;
+        float distance = (i % 3 == 0) ? 12.0f : finf();
+        const bool found = tree.intersectRay(rayArray[i], hit, distance, exitOnAnyHit, twoSided);
+
+        debugAssert(found == (packetHit[i].tri != NULL));
+        if (found && ! exitOnAnyHit) {
+            debugAssert(distance == packetDistance[i]);
+            debugAssert(hit.tri == packetHit[i].tri);
+            debugAssert(hit.primitiveIndex == packetHit[i].primitiveIndex);
+        }
+    }
+}
+
+
+/** Moves the vertices as if the soup were a deforming character, by a
+    displacement that varies smoothly over space */
+void animate(const CPUVertexArray& rest, float t, CPUVertexArray& vertexArray) {
+    vertexArray.copyFrom(rest);
+    for (int i = 0; i < vertexArray.size(); ++i) {
+        Point3& P = vertexArray.vertex[i].position;
+        P += Vector3(sin(P.y * 0.7f + t), 0.5f * sin(P.z * 0.3f + 2.0f * t), cos(P.x * 0.5f + t)) * t;
+    }
+}
+
+
+/** Checks that \a refitTree gives the same hits as a new tree built from vertexArray */
+void checkRefit(const TriTree& refitTree, const Array<Tri>& triArray, const CPUVertexArray& vertexArray, const Array<Ray>& rayArray) {
+    TriTree fresh;
+    fresh.setContents(triArray, vertexArray);
+
+    Array<Tri::Intersector> expected, actual;
+    Array<float> expectedDistance, actualDistance;
+    expectedDistance.resize(rayArray.size());
+    actualDistance.resize(rayArray.size());
+    for (int i = 0; i < rayArray.size(); ++i) {
+        expectedDistance[i] = actualDistance[i] = finf();
+    }
+    fresh.intersectRays(rayArray, expected, expectedDistance);
+    refitTree.intersectRays(rayArray, actual, actualDistance);
+    for (int i = 0; i < rayArray.size(); ++i) {
+        debugAssert(expected[i].primitiveIndex == actual[i].primitiveIndex);
+        debugAssert(expectedDistance[i] == actualDistance[i]);
+    }
+    checkAgainstSingleRays(refitTree, rayArray, false, false);
+    checkAgainstSingleRays(refitTree, rayArray, true, false);
+}
+
+} // namespace
+
+
+void testTriTree() {
+    printf("G3D::TriTree::intersectRays ");
+
+    CPUVertexArray vertexArray;
+    Array<Tri>     triArray;
+    makeTriangleSoup(3000, vertexArray, triArray);
+
+    TriTree tree;
+    tree.setContents(triArray, vertexArray);
+
+    Array<Ray> rayArray;
+    makePrimaryRays(Point3(5, 5, 25), Point3(5, 5, 5), 64, 64, rayArray);
+
+    // Incoherent rays, including some with zero direction components
+    Random r(9);
+    for (int i = 0; i < 1001; ++i) {
+        Vector3 d = Vector3::random(r);
+        if (i % 10 == 0) {
+            d.x = 0.0f;
+        }
+        rayArray.append(Ray::fromOriginAndDirection(Point3(r.uniform(0, 10), r.uniform(0, 10), r.uniform(0, 10)), d.direction()));
+    }
+
+    for (int twoSided = 0; twoSided < 2; ++twoSided) {
+        for (int exitOnAnyHit = 0; exitOnAnyHit < 2; ++exitOnAnyHit) {
+            checkAgainstSingleRays(tree, rayArray, exitOnAnyHit != 0, twoSided != 0);
+        }
+    }
+
+    {
+        // The binned and accurate SAH builders must find the same hits as the default
+        // tree.  Each tree has its own copy of the Tris, so compare indices.
+        TriTree::Settings settings;
+        settings.algorithm = TriTree::SAH;
+        settings.accurateSAHCountThreshold = 20;
+        TriTree sahTree;
+        sahTree.setContents(triArray, vertexArray, settings);
+        debugAssert(sahTree.stats(settings.valuesPerLeaf).numTris >= triArray.size());
+        debugAssert(sahTree.stats(settings.valuesPerLeaf).nodeBytes > 0);
+
+        Array<Tri::Intersector> expected, actual;
+        Array<float> expectedDistance, actualDistance;
+        expectedDistance.resize(rayArray.size());
+        actualDistance.resize(rayArray.size());
+        for (int i = 0; i < rayArray.size(); ++i) {
+            expectedDistance[i] = actualDistance[i] = finf();
+        }
+        tree.intersectRays(rayArray, expected, expectedDistance);
+        sahTree.intersectRays(rayArray, actual, actualDistance);
+        for (int i = 0; i < rayArray.size(); ++i) {
+            debugAssert(expected[i].primitiveIndex == actual[i].primitiveIndex);
+            debugAssert(expectedDistance[i] == actualDistance[i]);
+        }
+        checkAgainstSingleRays(sahTree, rayArray, false, false);
+    }
+
+    {
+        // Refit without rebuilding, then with rebuilding
+        TriTree::Settings settings;
+        settings.algorithm = TriTree::SAH;
+        TriTree animated;
+        animated.setContents(triArray, vertexArray, settings);
+        CPUVertexArray moved;
+
+        animate(vertexArray, 0.5f, moved);
+        debugAssert(animated.refit(moved, finf()) == 0);
+        checkRefit(animated, triArray, moved, rayArray);
+
+        animate(vertexArray, 1.0f, moved);
+        debugAssert(animated.refit(moved, 1.0f) > 0);
+        checkRefit(animated, triArray, moved, rayArray);
+
+        // Rebuilding subtrees that were already rebuilt
+        animate(vertexArray, 1.5f, moved);
+        animated.refit(moved, 1.0f);
+        checkRefit(animated, triArray, moved, rayArray);
+    }
+
+    {
+        // Empty tree
+        TriTree empty;
+        Array<Tri::Intersector> hit;
+        empty.intersectRays(rayArray, hit);
+        debugAssert(hit.size() == rayArray.size());
+        debugAssert(hit[0].tri == NULL);
+    }
+
+    printf("passed\n");
+}
+
+
+static void perfTriTree(const std::string& name, const CPUVertexArray& vertexArray, const Array<Tri>& triArray) {
+    TriTree tree;
+    tree.setContents(triArray, vertexArray);
+
+    AABox bounds;
+    if (triArray.size() > 0) {
+        triArray[0].getBounds(vertexArray, bounds);
+        for (int i = 1; i < triArray.size(); ++i) {
+            AABox b;
+            triArray[i].getBounds(vertexArray, b);
+            bounds.merge(b);
+        }
+    }
+
+    const Point3 target = bounds.center();
+    const Point3 eye    = target + Vector3(0.3f, 0.4f, 1.0f).direction() * bounds.extent().length();
+
+    Array<Ray> primary;
+    makePrimaryRays(eye, target, 512, 512, primary);
+
+    Array<Tri::Intersector> hit;
+    hit.resize(primary.size());
+    Array<float> distance;
+    distance.resize(primary.size());
+
+    Stopwatch timer;
+
+    timer.tick();
+    for (int i = 0; i < primary.size(); ++i) {
+        distance[i] = finf();
+        tree.intersectRay(primary[i], hit[i], distance[i]);
+    }
+    timer.tock();
+    const double singlePrimary = primary.size() / timer.elapsedTime();
+
+    // Shadow rays from each hit toward a light above the scene
+    const Point3 light = target + Vector3(0.0f, bounds.extent().length(), 0.0f);
+    Array<Ray>   shadow;
+    Array<float> shadowDistance;
+    for (int i = 0; i < primary.size(); ++i) {
+        if (hit[i].tri != NULL) {
+            const Point3 X = primary[i].origin() + primary[i].direction() * distance[i];
+            const Vector3 w = light - X;
+            shadow.append(Ray::fromOriginAndDirection(X + w.direction() * 1e-3f, w.direction()));
+            shadowDistance.append(w.length());
+        }
+    }
+
+    for (int i = 0; i < primary.size(); ++i) {
+        hit[i] = Tri::Intersector();
+        distance[i] = finf();
+    }
+    timer.tick();
+    tree.intersectRays(primary, hit, distance);
+    timer.tock();
+    const double packetPrimary = primary.size() / timer.elapsedTime();
+
+    Array<Tri::Intersector> shadowHit;
+    shadowHit.resize(shadow.size());
+    Array<float> d;
+    d.copyFrom(shadowDistance);
+
+    timer.tick();
+    for (int i = 0; i < shadow.size(); ++i) {
+        tree.intersectRay(shadow[i], shadowHit[i], d[i], true);
+    }
+    timer.tock();
+    const double singleShadow = shadow.size() / timer.elapsedTime();
+
+    d.copyFrom(shadowDistance);
+    shadowHit.fastClear();
+    timer.tick();
+    tree.intersectRays(shadow, shadowHit, d, true);
+    timer.tock();
+    const double packetShadow = shadow.size() / timer.elapsedTime();
+
+    printf("  %-22s %7d tris  primary %6.2f -> %6.2f Mrays/s   shadow %6.2f -> %6.2f Mrays/s\n",
+           name.c_str(), triArray.size(),
+           singlePrimary / 1e6, packetPrimary / 1e6, singleShadow / 1e6, packetShadow / 1e6);
+}
+
+
+/** The triangle soup overlaps so much that SAH builds are slow, so
+    this is only run on the models. */
+static void perfTriTreeBuild(const std::string& name, const CPUVertexArray& vertexArray, const Array<Tri>& triArray) {
+    for (int a = 0; a < 2; ++a) {
+        TriTree::Settings settings;
+        settings.algorithm = (a == 0) ? TriTree::MEAN_EXTENT : TriTree::SAH;
+
+        TriTree tree;
+        tree.setContents(triArray, vertexArray, settings);
+        const TriTree::Stats& s = tree.stats(settings.valuesPerLeaf);
+        printf("  %-22s %7d tris  %-12s %8.3f s  %d threads  %3d subtrees  %6.1f MB  depth %d\n",
+               name.c_str(), triArray.size(), TriTree::algorithmName(settings.algorithm),
+               s.buildTime, s.numBuildThreads, s.numParallelSubtrees, s.nodeBytes / 1e6, s.depth);
+    }
+}
+
+
+static void perfTriTreeRefit(const std::string& name, const CPUVertexArray& vertexArray, const Array<Tri>& triArray) {
+    TriTree tree;
+    tree.setContents(triArray, vertexArray);
+    const float buildTime = tree.stats(TriTree::Settings().valuesPerLeaf).buildTime;
+
+    CPUVertexArray moved;
+    const int N = 10;
+    int numRebuilt = 0;
+    RealTime refitTime = 0;
+    for (int i = 1; i <= N; ++i) {
+        animate(vertexArray, 0.05f * i, moved);
+        const RealTime start = System::time();
+        numRebuilt += tree.refit(moved);
+        refitTime += System::time() - start;
+    }
+    printf("  %-22s %7d tris  setContents %8.3f s  refit %8.3f s (%.1f subtrees rebuilt)\n",
+           name.c_str(), triArray.size(), buildTime, refitTime / N, float(numRebuilt) / N);
+}
+
+
+void perfTriTree() {
+    printf("TriTree performance (build; intersectRay -> intersectRays):\n");
+
+    {
+        CPUVertexArray vertexArray;
+        Array<Tri>     triArray;
+        makeTriangleSoup(100000, vertexArray, triArray);
+        perfTriTree("triangle soup", vertexArray, triArray);
+        perfTriTreeRefit("triangle soup", vertexArray, triArray);
+    }
+
+    const char* model[] = {"3ds/spaceFighter01/spaceFighter01.3ds", "3ds/postsparkasse/furniture.3DS", "ifs/p51-mustang.ifs"};
+    for (int m = 0; m < 3; ++m) {
+        const std::string& filename = System::findDataFile(model[m], false);
+        if (filename.empty()) {
+            continue;
+        }
+        CPUVertexArray vertexArray;
+        Array<Tri>     triArray;
+        getTris(ArticulatedModel::fromFile(filename), vertexArray, triArray);
+        perfTriTreeBuild(FilePath::baseExt(filename), vertexArray, triArray);
+        perfTriTree(FilePath::baseExt(filename), vertexArray, triArray);
+        perfTriTreeRefit(FilePath::baseExt(filename), vertexArray, triArray);
+    }
+    printf("\n");
+}
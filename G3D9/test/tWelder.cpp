@@ -0,0 +1,359 @@
+#include "G3D/G3DAll.h"
+using G3D::uint8;
+using G3D::uint32;
+using G3D::uint64;
+
+namespace {
+
+/** Vertex stored in the reference implementation's grids */
+class RefVNTi {
+public:
+    Vector3         vertex;
+    Vector3         normal;
+    Vector2         texCoord;
+    int             index;
+
+    RefVNTi() : index(0) {}
+    RefVNTi(const Vector3& v, const Vector3& n, const Vector2& t, int i) : vertex(v), normal(n), texCoord(t), index(i) {}
+};
+
+} // namespace
+
+template <> struct HashTrait<RefVNTi> {
+    static size_t hashCode(const RefVNTi& k) { return static_cast<size_t>(k.vertex.hashCode()); }
+};
+template<> struct EqualsTrait<RefVNTi> {
+    static bool equals(const RefVNTi& a, const RefVNTi& b) { return a.vertex == b.vertex; }
+};
+template<> struct PositionTrait<RefVNTi> {
+    static void getPosition(const RefVNTi& v, G3D::Vector3& p) { p = v.vertex; }
+};
+
+namespace {
+
+/** The original PointHashGrid implementation of Welder::weld, which the
+    optimized one must match exactly */
+void referenceWeld
+(Array<Vector3>&     vertexArray,
+ Array<Vector2>&     texCoordArray,
+ Array<Vector3>&     normalArray,
+ Array<Array<int>*>& indexArrayArray,
+ const Welder::Settings& settings) {
+
+    const float vertexWeldRadius    = settings.vertexWeldRadius;
+    const float normalWeldRadius2   = square(settings.normalWeldRadius);
+    const float texCoordWeldRadius2 = square(settings.textureWeldRadius);
+    const bool hasTexCoords = (texCoordArray.size() > 0);
+    if (! hasTexCoords) {
+        texCoordArray.resize(vertexArray.size());
+    }
+
+    Array<Vector3> vertex;
+    Array<Vector2> texCoord;
+    for (int t = 0; t < indexArrayArray.size(); ++t) {
+        if (indexArrayArray[t] != NULL) {
+            const Array<int>& triList = *(indexArrayArray[t]);
+            for (int v = 0; v < triList.size(); ++v) {
+                vertex.append(vertexArray[triList[v]]);
+                texCoord.append(texCoordArray[triList[v]]);
+            }
+        }
+    }
+    vertexArray.fastClear();
+    normalArray.fastClear();
+    texCoordArray.fastClear();
+
+    Array<Vector3> faceNormal;
+    for (int v = 0; v < vertex.size(); v += 3) {
+        const Vector3& n = ((vertex[v + 1] - vertex[v]).cross((vertex[v + 2] - vertex[v]) * 256.0f)).directionOrZero();
+        faceNormal.append(n, n, n);
+    }
+
+    Array<Vector3> normal;
+    if (settings.normalSmoothingAngle <= 0) {
+        normal = faceNormal;
+    } else {
+        const float cosThresholdAngle = (float)cos(settings.normalSmoothingAngle);
+        PointHashGrid<RefVNTi> grid((vertexWeldRadius > 0) ? vertexWeldRadius : 1.0f);
+        for (int v = 0; v < vertex.size(); ++v) {
+            grid.insert(RefVNTi(vertex[v], faceNormal[v], Vector2(), v));
+        }
+
+        normal.resize(vertex.size());
+        for (int v = 0; v < vertex.size(); ++v) {
+            const Vector3& original = faceNormal[v];
+            Vector3 sum;
+            for (PointHashGrid<RefVNTi>::SphereIterator it = grid.beginSphereIntersection(Sphere(vertex[v], vertexWeldRadius)); it.isValid(); ++it) {
+                // The original grouped equal positions with a Table when the radius is zero
+                if ((vertexWeldRadius > 0) || (memcmp(&it->vertex, &vertex[v], sizeof(Vector3)) == 0)) {
+                    const Vector3& N = it->normal;
+                    if (N.dot(original) > cosThresholdAngle) {
+                        sum += (N * 256.0f);
+                    }
+                }
+            }
+            const Vector3& average = sum.directionOrZero();
+            normal[v] = (average.isZero() || (original.dot(average) < 0)) ? original : average;
+        }
+    }
+
+    PointHashGrid<RefVNTi> weldGrid(max(vertexWeldRadius, 0.1f));
+    int u = 0;
+    for (int t = 0; t < indexArrayArray.size(); ++t) {
+        if (indexArrayArray[t] == NULL) {
+            continue;
+        }
+        Array<int>& triList = *(indexArrayArray[t]);
+        for (int v = 0; v < triList.size(); ++v, ++u) {
+            const Vector3& n = normal[u];
+            int index = -1;
+            for (PointHashGrid<RefVNTi>::SphereIterator it = weldGrid.beginSphereIntersection(Sphere(vertex[u], vertexWeldRadius));
+                 it.isValid() && (index == -1); ++it) {
+                if ((n.isZero() || ((n - it->normal).squaredLength() <= normalWeldRadius2)) &&
+                    ((texCoord[u] - it->texCoord).squaredLength() <= texCoordWeldRadius2)) {
+                    index = it->index;
+                }
+            }
+            if (index == -1) {
+                index = vertexArray.size();
+                vertexArray.append(vertex[u]);
+                normalArray.append(n);
+                texCoordArray.append(texCoord[u]);
+                weldGrid.insert(RefVNTi(vertex[u], n, texCoord[u], index));
+            }
+            triList[v] = index;
+        }
+    }
+
+    if (! hasTexCoords) {
+        texCoordArray.resize(0);
+    }
+}
+
+
+/** An indexed mesh */
+class WeldMesh {
+public:
+    Array<Vector3>      vertex;
+    Array<Vector2>      texCoord;
+    Array<Vector3>      normal;
+    Array<int>          index;
+};
+
+
+template<class T>
+bool sameArray(const Array<T>& a, const Array<T>& b) {
+    return (a.size() == b.size()) && ((a.size() == 0) || (memcmp(a.getCArray(), b.getCArray(), sizeof(T) * a.size()) == 0));
+}
+
+
+/** Welds \a mesh with both implementations and returns true if they produce identical results */
+bool weldMatchesReference(const WeldMesh& mesh, const Welder::Settings& settings, RealTime& referenceTime, RealTime& weldTime) {
+    WeldMesh a = mesh, b = mesh;
+    Array<Array<int>*> aIndex, bIndex;
+    aIndex.append(&a.index);
+    bIndex.append(&b.index);
+
+    Stopwatch timer;
+    timer.tick();
+    referenceWeld(a.vertex, a.texCoord, a.normal, aIndex, settings);
+    timer.tock();
+    referenceTime = timer.elapsedTime();
+
+    timer.tick();
+    Welder::weld(b.vertex, b.texCoord, b.normal, bIndex, settings);
+    timer.tock();
+    weldTime = timer.elapsedTime();
+
+    return sameArray(a.vertex, b.vertex) && sameArray(a.texCoord, b.texCoord) &&
+        sameArray(a.normal, b.normal) && sameArray(a.index, b.index);
+}
+
+
+bool weldMatchesReference(const WeldMesh& mesh, const Welder::Settings& settings) {
+    RealTime ignore0, ignore1;
+    return weldMatchesReference(mesh, settings, ignore0, ignore1);
+}
+
+
+/** A height field of N x N quads with every triangle's vertices
+    duplicated, optionally jittered by up to \a jitter, in random order */
+void makeSoup(WeldMesh& mesh, int N, float jitter, bool texCoords, Random& rnd) {
+    Array<int> quad;
+    for (int i = 0; i < N * N; ++i) {
+        quad.append(i);
+    }
+    for (int i = quad.size() - 1; i > 0; --i) {
+        std::swap(quad[i], quad[rnd.integer(0, i)]);
+    }
+
+    for (int q = 0; q < quad.size(); ++q) {
+        const int x = quad[q] % N;
+        const int y = quad[q] / N;
+        const int corner[6][2] = {{0, 0}, {0, 1}, {1, 0}, {1, 0}, {0, 1}, {1, 1}};
+        for (int c = 0; c < 6; ++c) {
+            const float u = float(x + corner[c][0]);
+            const float v = float(y + corner[c][1]);
+            mesh.index.append(mesh.vertex.size());
+            mesh.vertex.append(Vector3(u, sin(u * 0.3f) * cos(v * 0.2f) * 3.0f, v) +
+                               Vector3(rnd.uniform(-1, 1), rnd.uniform(-1, 1), rnd.uniform(-1, 1)) * jitter);
+            if (texCoords) {
+                mesh.texCoord.append(Vector2(u, v) / float(N));
+            }
+        }
+    }
+}
+
+
+/** Loads the triangles of every part of a model as one mesh */
+void loadModel(const std::string& filename, WeldMesh& mesh) {
+
+    class ExtractMeshCallback : public ArticulatedModel::PartCallback {
+    public:
+        WeldMesh&       mesh;
+
+        ExtractMeshCallback(WeldMesh& mesh) : mesh(mesh) {}
+
+        void operator()(ArticulatedModel::Part* part, const CFrame& worldToPartFrame, ArticulatedModel::Ref model, const int treeDepth) {
+            (void)model;
+            (void)treeDepth;
+            const int offset = mesh.vertex.size();
+            for (int i = 0; i < part->cpuVertexArray.size(); ++i) {
+                const CPUVertexArray::Vertex& v = part->cpuVertexArray.vertex[i];
+                mesh.vertex.append(worldToPartFrame.pointToObjectSpace(v.position));
+                mesh.texCoord.append(v.texCoord0);
+            }
+
+            for (int m = 0; m < part->meshArray().size(); ++m) {
+                const ArticulatedModel::Mesh* am = part->meshArray()[m];
+                if (am->primitive == PrimitiveType::TRIANGLES) {
+                    for (int i = 0; i + 2 < am->cpuIndexArray.size(); i += 3) {
+                        for (int j = 0; j < 3; ++j) {
+                            mesh.index.append(am->cpuIndexArray[i + j] + offset);
+                        }
+                    }
+                }
+            }
+        }
+    } callback(mesh);
+
+    ArticulatedModel::fromFile(filename)->forEachPart(callback);
+}
+
+} // namespace
+
+
+void testWelder() {
+    printf("Welder ");
+
+    Random rnd(1, false);
+
+    {
+        // Exact duplicates, with and without texture coordinates
+        WeldMesh mesh;
+        makeSoup(mesh, 20, 0.0f, true, rnd);
+        debugAssert(weldMatchesReference(mesh, Welder::Settings()));
+
+        Welder::Settings settings;
+        settings.vertexWeldRadius = 0;
+        debugAssert(weldMatchesReference(mesh, settings));
+
+        mesh.texCoord.clear();
+        debugAssert(weldMatchesReference(mesh, settings));
+
+        // Every duplicated vertex of a smooth height field collapses
+        Array<Array<int>*> index;
+        index.append(&mesh.index);
+        Welder::weld(mesh.vertex, mesh.texCoord, mesh.normal, index, Welder::Settings());
+        debugAssert(mesh.vertex.size() == 21 * 21);
+        debugAssert(mesh.normal.size() == mesh.vertex.size());
+        debugAssert(mesh.index.size() == 20 * 20 * 6);
+    }
+
+    {
+        // Jitter on the order of the weld radius, so that ties and cell
+        // boundaries matter
+        const float radius[] = {0.0001f, 0.05f, 0.3f, 2.0f};
+        for (int r = 0; r < 4; ++r) {
+            WeldMesh mesh;
+            makeSoup(mesh, 16, radius[r], true, rnd);
+
+            Welder::Settings settings;
+            settings.vertexWeldRadius  = radius[r];
+            settings.textureWeldRadius = 0.02f;
+            debugAssert(weldMatchesReference(mesh, settings));
+
+            settings.normalSmoothingAngle = 0;
+            debugAssert(weldMatchesReference(mesh, settings));
+
+            settings.normalSmoothingAngle = toRadians(180);
+            settings.normalWeldRadius     = 2.0f;
+            mesh.texCoord.clear();
+            debugAssert(weldMatchesReference(mesh, settings));
+        }
+    }
+
+    {
+        // Degenerate triangles and a mesh far from the origin
+        WeldMesh mesh;
+        makeSoup(mesh, 10, 0.01f, false, rnd);
+        for (int i = 0; i < mesh.vertex.size(); ++i) {
+            mesh.vertex[i] += Vector3(1e5f, -3e4f, 0);
+        }
+        for (int i = 0; i < 30; ++i) {
+            mesh.index.append(mesh.index[i / 3]);
+        }
+
+        Welder::Settings settings;
+        settings.vertexWeldRadius = 0.02f;
+        debugAssert(weldMatchesReference(mesh, settings));
+    }
+
+    {
+        // Empty
+        WeldMesh mesh;
+        debugAssert(weldMatchesReference(mesh, Welder::Settings()));
+    }
+
+    printf("passed\n");
+}
+
+
+void perfWelder() {
+    printf("Welder performance:\n");
+
+    const char* model[] = {"ifs/cow.ifs", "ifs/p51-mustang.ifs", "3ds/spaceFighter01/spaceFighter01.3ds", "3ds/postsparkasse/furniture.3DS"};
+    for (int m = 0; m < 4; ++m) {
+        const std::string& filename = System::findDataFile(model[m], false);
+        if (filename.empty()) {
+            continue;
+        }
+
+        WeldMesh mesh;
+        loadModel(filename, mesh);
+
+        RealTime referenceTime, weldTime;
+        const bool same = weldMatchesReference(mesh, Welder::Settings(), referenceTime, weldTime);
+        (void)same;
+        debugAssertM(same, "Welder::weld does not match the reference implementation");
+        printf("  %-22s %7d tris  PointHashGrid %7.3f s  Welder %7.3f s\n", FilePath::baseExt(filename).c_str(),
+               mesh.index.size() / 3, referenceTime, weldTime);
+    }
+
+    {
+        // Large jittered soup
+        Random rnd(3, false);
+        WeldMesh mesh;
+        makeSoup(mesh, 200, 0.001f, true, rnd);
+
+        Welder::Settings settings;
+        settings.vertexWeldRadius = 0.01f;
+        RealTime referenceTime, weldTime;
+        const bool same = weldMatchesReference(mesh, settings, referenceTime, weldTime);
+        (void)same;
+        debugAssertM(same, "Welder::weld does not match the reference implementation");
+        printf("  %-22s %7d tris  PointHashGrid %7.3f s  Welder %7.3f s\n", "jittered soup",
+               mesh.index.size() / 3, referenceTime, weldTime);
+    }
+    printf("\n");
+}
@@ -0,0 +1,220 @@
+#include "G3D/G3DAll.h"
+using G3D::uint8;
+using G3D::uint32;
+using G3D::uint64;
+
+namespace {
+
+class ZoneBody {
+public:
+    AtomicInt32     calls;
+
+    ZoneBody() : calls(0) {}
+
+    void visit(int i, int threadID) {
+        (void)i; (void)threadID;
+        G3D_PROFILE_ZONE("tZoneProfiler body");
+        calls.increment();
+    }
+};
+
+
+G3D_DEFINE_PROFILE_ZONE(threadZone, "tZoneProfiler thread");
+
+void zoneThreadMain(void*) {
+    ZoneProfiler::setThreadName("tZoneProfiler thread");
+    G3D_PROFILE_ZONE_ID(threadZone);
+}
+
+
+/** Sum of count over all nodes for the named zone */
+int totalCount(const Array<ZoneProfiler::Statistics>& stats, const std::string& name) {
+    int count = 0;
+    for (int i = 0; i < stats.size(); ++i) {
+        if (stats[i].name == name) {
+            count += stats[i].count;
+        }
+    }
+    return count;
+}
+
+
+int countOccurrences(const std::string& s, const std::string& pattern) {
+    int count = 0;
+    for (size_t i = s.find(pattern); i != std::string::npos; i = s.find(pattern, i + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+} // namespace
+
+
+void testZoneProfiler() {
+    printf("ZoneProfiler ");
+
+    const int outer = ZoneProfiler::registerZone("tZoneProfiler outer");
+    const int inner = ZoneProfiler::registerZone("tZoneProfiler inner");
+    debugAssert(outer != inner);
+    debugAssert(ZoneProfiler::registerZone("tZoneProfiler outer") == outer);
+    debugAssert(ZoneProfiler::zoneName(inner) == "tZoneProfiler inner");
+
+    const bool wasEnabled = ZoneProfiler::enabled();
+    ZoneProfiler::setEnabled(true);
+    ZoneProfiler::clear();
+
+    {
+        // Nesting
+        for (int i = 0; i < 10; ++i) {
+            ZoneProfiler::Scope a(outer);
+            for (int j = 0; j < 3; ++j) {
+                ZoneProfiler::Scope b(inner);
+                System::sleep(0.001);
+            }
+        }
+
+        Array<ZoneProfiler::Statistics> stats;
+        ZoneProfiler::getStatistics(stats);
+        debugAssert(stats.size() == 2);
+        debugAssert(stats[0].zone == outer && stats[0].depth == 0 && stats[0].parent == -1);
+        debugAssert(stats[0].count == 10);
+        debugAssert(stats[1].zone == inner && stats[1].depth == 1 && stats[1].parent == 0);
+        debugAssert(stats[1].count == 30);
+        debugAssert(stats[0].totalTime >= stats[1].totalTime);
+        debugAssert(stats[1].totalTime >= 30 * 0.0005);
+        debugAssert(fuzzyEq(stats[0].selfTime, stats[0].totalTime - stats[1].totalTime));
+    }
+
+    {
+        // Work between two children belongs to the parent
+        ZoneProfiler::clear();
+        {
+            ZoneProfiler::Scope a(outer);
+            { ZoneProfiler::Scope b(inner); }
+            System::sleep(0.005);
+            { ZoneProfiler::Scope b(inner); }
+        }
+
+        Array<ZoneProfiler::Statistics> stats;
+        ZoneProfiler::getStatistics(stats);
+        debugAssert(stats.size() == 2);
+        debugAssert(stats[1].count == 2);
+        debugAssert(stats[1].totalTime < 0.001);
+        debugAssert(stats[0].selfTime >= 0.004);
+    }
+
+    {
+        // Multiple threads
+        ZoneProfiler::clear();
+        ZoneBody body;
+        ThreadPool::parallelFor(0, 100, &body, &ZoneBody::visit);
+        GThreadRef thread = GThread::create("tZoneProfiler", zoneThreadMain);
+        thread->start();
+        thread->waitForCompletion();
+
+        Array<ZoneProfiler::Statistics> stats;
+        ZoneProfiler::getStatistics(stats);
+        debugAssert(totalCount(stats, "tZoneProfiler body") == 100);
+        debugAssert(totalCount(stats, "tZoneProfiler thread") == 1);
+
+        const std::string& trace = ZoneProfiler::chromeTrace();
+        debugAssert(beginsWith(trace, "{"));
+        debugAssert(countOccurrences(trace, "\"ph\":\"B\"") == countOccurrences(trace, "\"ph\":\"E\""));
+        debugAssert(countOccurrences(trace, "\"name\":\"tZoneProfiler body\"") == 200);
+        debugAssert(countOccurrences(trace, "\"args\":{\"name\":\"tZoneProfiler thread\"}") == 1);
+    }
+
+    {
+        // Threads that exit pass their buffers on, so running threads
+        // one after another does not add buffers
+        ZoneProfiler::clear();
+        for (int i = 0; i < 2; ++i) {
+            GThreadRef thread = GThread::create("tZoneProfiler", zoneThreadMain);
+            thread->start();
+            thread->waitForCompletion();
+        }
+        const int before = countOccurrences(ZoneProfiler::chromeTrace(), "\"ph\":\"M\"");
+        for (int i = 0; i < 10; ++i) {
+            GThreadRef thread = GThread::create("tZoneProfiler", zoneThreadMain);
+            thread->start();
+            thread->waitForCompletion();
+        }
+        const std::string& trace = ZoneProfiler::chromeTrace();
+        debugAssert(countOccurrences(trace, "\"ph\":\"M\"") == before);
+        // Only the most recent thread's events remain in the reused buffer
+        debugAssert(countOccurrences(trace, "\"args\":{\"name\":\"tZoneProfiler thread\"}") == 1);
+        debugAssert(countOccurrences(trace, "\"name\":\"tZoneProfiler thread\"") == 3);
+        (void)before;
+    }
+
+    {
+        // Overflowing the ring buffer keeps the newest events
+        ZoneProfiler::clear();
+        for (int i = 0; i < ZoneProfiler::EVENTS_PER_THREAD; ++i) {
+            ZoneProfiler::Scope a(outer);
+        }
+        Array<ZoneProfiler::Statistics> stats;
+        ZoneProfiler::getStatistics(stats);
+        debugAssert(totalCount(stats, "tZoneProfiler outer") == ZoneProfiler::EVENTS_PER_THREAD / 2);
+    }
+
+    {
+        // Nothing is recorded while disabled
+        ZoneProfiler::clear();
+        ZoneProfiler::setEnabled(false);
+        {
+            ZoneProfiler::Scope a(outer);
+        }
+        Array<ZoneProfiler::Statistics> stats;
+        ZoneProfiler::getStatistics(stats);
+        debugAssert(stats.size() == 0);
+    }
+
+    ZoneProfiler::setEnabled(wasEnabled);
+    printf("passed\n");
+}
+
+
+void perfZoneProfiler() {
+    printf("ZoneProfiler performance:\n");
+
+    const int N = 5000000;
+    const int zone = ZoneProfiler::registerZone("perfZoneProfiler");
+    const bool wasEnabled = ZoneProfiler::enabled();
+
+    for (int e = 0; e < 2; ++e) {
+        ZoneProfiler::setEnabled(e == 1);
+
+        Stopwatch timer;
+        timer.tick();
+        for (int i = 0; i < N; ++i) {
+            ZoneProfiler::Scope scope(zone);
+        }
+        timer.tock();
+        printf("  %-8s %6.1f ns/zone\n", (e == 1) ? "enabled" : "disabled", timer.elapsedTime() * 1e9 / N);
+
+        timer.tick();
+        for (int i = 0; i < N; ++i) {
+            G3D_PROFILE_ZONE("perfZoneProfiler");
+        }
+        timer.tock();
+        printf("  %-8s %6.1f ns/zone (G3D_PROFILE_ZONE)\n", (e == 1) ? "enabled" : "disabled", timer.elapsedTime() * 1e9 / N);
+        ZoneProfiler::clear();
+    }
+
+    {
+        // Each enabled zone reads the time stamp counter twice, which
+        // dominates on virtual machines that trap rdtsc
+        Stopwatch timer;
+        timer.tick();
+        for (int i = 0; i < N; ++i) {
+            System::getCycleCount();
+        }
+        timer.tock();
+        printf("  (System::getCycleCount %6.1f ns/call)\n", timer.elapsedTime() * 1e9 / N);
+    }
+
+    ZoneProfiler::setEnabled(wasEnabled);
+    ZoneProfiler::clear();
+    printf("\n");
+}